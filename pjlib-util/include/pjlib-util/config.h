@@ -124,6 +124,10 @@
  * response without any answer section. These responses can be put in 
  * the cache too to minimize message round-trip.
  *
+ * For NXDOMAIN and empty (NODATA) responses carrying SOA record in the
+ * authority section, the life-time is taken from the SOA record instead,
+ * as described in RFC 2308 section 5 (limited by PJ_DNS_RESOLVER_MAX_TTL).
+ *
  * Default: 60 (one minute).
  *
  * @see PJ_DNS_RESOLVER_MAX_TTL
@@ -132,6 +136,47 @@
 #   define PJ_DNS_RESOLVER_INVALID_TTL		    60
 #endif
 
+/**
+ * Maximum number of responses kept in the resolver response cache. When
+ * the cache is full, the least recently used response will be evicted to
+ * make room for the new one. Entries added with pj_dns_resolver_add_entry()
+ * without TTL are never evicted and are not counted. If the value is zero,
+ * the number of cached responses is not limited.
+ *
+ * Default: 0 (no limit)
+ */
+#ifndef PJ_DNS_RESOLVER_MAX_CACHE_COUNT
+#   define PJ_DNS_RESOLVER_MAX_CACHE_COUNT	    0
+#endif
+
+/**
+ * The duration, in seconds, in which an expired response in the resolver
+ * response cache may still be returned to application, while the resolver
+ * refreshes the response in the background. During this period, transient
+ * failures (e.g: timeout or server failure) when refreshing the response
+ * will not remove the expired response from the cache. If the value is
+ * zero, expired responses will never be returned.
+ *
+ * Default: 0 (disabled)
+ */
+#ifndef PJ_DNS_RESOLVER_MAX_STALE
+#   define PJ_DNS_RESOLVER_MAX_STALE		    0
+#endif
+
+/**
+ * Prefetch threshold, in percent of the TTL of the cached response. When
+ * a cached response is picked up and its remaining TTL is less than this
+ * percentage of the original TTL, the resolver will refresh the response
+ * in the background, so that the response will not expire while it is
+ * still being used. If the value is zero, cached responses will not be
+ * prefetched.
+ *
+ * Default: 0 (disabled)
+ */
+#ifndef PJ_DNS_RESOLVER_PREFETCH_PCT
+#   define PJ_DNS_RESOLVER_PREFETCH_PCT		    0
+#endif
+
 /**
  * The interval on which nameservers which are known to be good to be 
  * probed again to determine whether they are still good. Note that
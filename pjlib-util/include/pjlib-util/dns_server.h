@@ -36,6 +36,10 @@ PJ_BEGIN_DECL
  * This contains a simple but fully working DNS server implementation, 
  * mostly for testing purposes. It supports serving various DNS resource 
  * records such as SRV, CNAME, A, and AAAA.
+ *
+ * The records may be loaded from a zone file, and the server can be
+ * configured to delay or drop the answers, which makes it usable as a
+ * local stand-in for real DNS servers when benchmarking the resolver.
  */
 
 /**
@@ -43,6 +47,18 @@ PJ_BEGIN_DECL
  */
 typedef struct pj_dns_server pj_dns_server;
 
+/**
+ * DNS server statistics.
+ */
+typedef struct pj_dns_server_stat
+{
+    unsigned	rx;	    /**< Number of queries received.		    */
+    unsigned	tx;	    /**< Number of answers sent.		    */
+    unsigned	dropped;    /**< Number of queries dropped to simulate
+				 packet loss.				    */
+    unsigned	nxdomain;   /**< Number of NXDOMAIN answers.		    */
+} pj_dns_server_stat;
+
 /**
  * Create the DNS server instance. The instance will run immediately.
  *
@@ -104,6 +120,69 @@ PJ_DECL(pj_status_t) pj_dns_server_del_rec(pj_dns_server *srv,
 					   pj_dns_type type,
 					   const pj_str_t *name);
 
+/**
+ * Add resource records from a zone in master file format (RFC 1035).
+ * Each line contains one record in the form of
+ * "name [ttl] [IN] type rdata", where a line starting with blank uses
+ * the name of the previous record, "@" means the origin, and names not
+ * ending with dot are relative to the origin. The $ORIGIN and $TTL
+ * directives are supported, as are comments starting with ';'.
+ * Multi-line records are not supported.
+ *
+ * Supported types are A, AAAA, CNAME, NS, PTR, SRV, and NAPTR. Unlike
+ * #pj_dns_server_add_rec(), several records with the same name and type
+ * may be added.
+ *
+ * @param srv	    The DNS server instance.
+ * @param zone	    The zone text. The buffer must remain valid for as long
+ *		    as the server is running.
+ * @param p_count   Optional pointer to receive the number of records added.
+ * @return	    PJ_SUCCESS on success or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_dns_server_parse_zone(pj_dns_server *srv,
+					      const pj_str_t *zone,
+					      unsigned *p_count);
+
+/**
+ * Add resource records from a zone file. See #pj_dns_server_parse_zone()
+ * for the supported format.
+ *
+ * @param srv	    The DNS server instance.
+ * @param filename  The zone file name.
+ * @param p_count   Optional pointer to receive the number of records added.
+ * @return	    PJ_SUCCESS on success or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_dns_server_load_zone(pj_dns_server *srv,
+					     const char *filename,
+					     unsigned *p_count);
+
+/**
+ * Set the delay and loss to be applied to the answers, to simulate the
+ * network path to a real DNS server.
+ *
+ * @param srv	    The DNS server instance.
+ * @param timer_heap Timer heap to schedule delayed answers. It may be NULL
+ *		    if both delay and jitter are zero.
+ * @param delay	    Minimum delay of the answers, in msec.
+ * @param jitter    Maximum random delay to be added, in msec.
+ * @param loss	    Percentage of queries to be dropped (0-100).
+ * @return	    PJ_SUCCESS on success or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_dns_server_set_impairment(pj_dns_server *srv,
+						  pj_timer_heap_t *timer_heap,
+						  unsigned delay,
+						  unsigned jitter,
+						  unsigned loss);
+
+/**
+ * Get the server statistics.
+ *
+ * @param srv	    The DNS server instance.
+ * @param stat	    Pointer to receive the statistics.
+ */
+PJ_DECL(void) pj_dns_server_get_stat(pj_dns_server *srv,
+				     pj_dns_server_stat *stat);
+
 
 
 /**
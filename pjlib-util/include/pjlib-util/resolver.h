@@ -69,6 +69,17 @@ PJ_BEGIN_DECL
  * Response caching can be  disabled by setting the maximum TTL value of the 
  * resolver to zero.
  *
+ * Negative responses (NXDOMAIN and responses without answer) are cached
+ * according to the SOA record in the authority section, as described in
+ * RFC 2308. The number of cached responses can be limited, in which case
+ * the least recently used responses will be evicted from the cache.
+ *
+ * Optionally, the resolver can refresh a cached response in the background
+ * shortly before it expires, and keep returning the expired response for
+ * a while when the refresh fails or takes longer, so that the application
+ * rarely needs to wait for the nameserver. See #pj_dns_settings for more
+ * info.
+ *
  * \subsection PJ_DNS_RESOLVER_FEATURES_PARALLEL Parallel and Backup Name Servers
  *
  * When the resolver is configured with multiple nameservers, initially the
@@ -128,23 +139,23 @@ PJ_BEGIN_DECL
  * Current implementation mainly suffers from a growing memory problem,
  * which mainly is caused by the response caching. Although there is only
  * one cache entry per {query, name} combination, these cache entry will
- * never get deleted since there is no timer is created to invalidate these
- * entries. So the more unique names being queried by application, there more
- * enties will be created in the response cache.
+ * only get deleted when they are looked up after they expire, since there
+ * is no timer is created to invalidate these entries. So the more unique
+ * names being queried by application, there more enties will be created in
+ * the response cache.
  *
  * Note that a single response entry will occupy about 600-700 bytes of 
  * pool memory (the PJ_DNS_RESOLVER_RES_BUF_SIZE value plus internal
  * structure). 
  *
  * Application can work around this problem by doing one of these:
+ *  - limit the number of cached responses with
+ *    PJ_DNS_RESOLVER_MAX_CACHE_COUNT.
  *  - disable caching by setting PJ_DNS_RESOLVER_MAX_TTL and 
  *    PJ_DNS_RESOLVER_INVALID_TTL to zero.
  *  - periodically query #pj_dns_resolver_get_cached_count() and destroy-
  *    recreate the resolver to recycle the memory used by the resolver.
  *
- * Note that future improvement may solve this problem by introducing 
- * expiration timer to the cached entries.
- *
  *
  * \section PJ_DNS_RESOLVER_REFERENCE Reference
  *
@@ -196,6 +207,9 @@ typedef struct pj_dns_settings
 				     value is zero, caching is disabled.    */
     unsigned	good_ns_ttl;	/**< See #PJ_DNS_RESOLVER_GOOD_NS_TTL	    */
     unsigned	bad_ns_ttl;	/**< See #PJ_DNS_RESOLVER_BAD_NS_TTL	    */
+    unsigned	cache_max_count;/**< See #PJ_DNS_RESOLVER_MAX_CACHE_COUNT  */
+    unsigned	cache_max_stale;/**< See #PJ_DNS_RESOLVER_MAX_STALE	    */
+    unsigned	cache_prefetch;	/**< See #PJ_DNS_RESOLVER_PREFETCH_PCT	    */
 } pj_dns_settings;
 
 
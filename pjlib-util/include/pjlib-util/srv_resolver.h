@@ -99,10 +99,12 @@ typedef enum pj_dns_srv_option
     PJ_DNS_SRV_FALLBACK_AAAA	= 2,
 
     /**
-     * Specify if the resolver should try to resolve with DNS AAAA
-     * resolution first of each targets in the DNS SRV record. If
-     * this option is not specified, the SRV resolver will query
-     * the DNS A record for the target instead.
+     * Specify if the resolver should also resolve each target in the
+     * DNS SRV record with DNS AAAA resolution. The DNS A and AAAA
+     * queries for all targets are started in parallel, and the IPv6
+     * addresses are returned in \a addr6 field of the record entries.
+     * If this option is not specified, the SRV resolver will only query
+     * the DNS A record for the target.
      */
     PJ_DNS_SRV_RESOLVE_AAAA	= 4
 
@@ -133,6 +135,13 @@ typedef struct pj_dns_srv_record
 	/** The host address. */
 	pj_dns_a_record		server;
 
+	/** Number of IPv6 addresses, only set when the resolution was
+	 *  started with PJ_DNS_SRV_RESOLVE_AAAA option. */
+	unsigned		addr6_count;
+
+	/** IPv6 addresses of the host. */
+	pj_in6_addr		addr6[PJ_DNS_MAX_IP_IN_A_REC];
+
     } entry[PJ_DNS_SRV_MAX_ADDR];
 
 } pj_dns_srv_record;
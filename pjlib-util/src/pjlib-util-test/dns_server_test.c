@@ -0,0 +1,372 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+#include <pjlib-util.h>
+#include <pjlib.h>
+
+#if INCLUDE_DNS_SERVER_TEST
+
+#define THIS_FILE   "dns_server_test.c"
+#define PORT	    5555
+
+static pj_pool_t *pool;
+static pj_timer_heap_t *timer_heap;
+static pj_ioqueue_t *ioqueue;
+static pj_dns_server *server;
+static pj_dns_resolver *resolver;
+
+static struct query_result
+{
+    pj_bool_t		     done;
+    pj_status_t		     status;
+    pj_dns_parsed_packet    *pkt;
+} result;
+
+
+/* Valid zone, exercising the syntax supported by the parser */
+static const char *valid_zone =
+    "; Test zone\n"
+    "$ORIGIN example.com.\n"
+    "$TTL 300\n"
+    "@			IN A	10.0.0.10\n"
+    "sip			IN A	10.0.0.1   ; first address\n"
+    "			IN A	10.0.0.2\n"
+    "sip		60	IN AAAA	2001:db8::1\n"
+    "www			CNAME	sip\n"
+    "_sip._udp	3600	IN SRV	0 10 5060 sip\n"
+    "_sip._udp		IN SRV	1 0 5060 backup.other.test.\n"
+    "@			NAPTR	10 50 \"s\" \"SIP+D2U\" \"\" _sip._udp\n"
+    "\n"
+    "$ORIGIN other.test.\n"
+    "backup		IN 120 A	10.0.0.3\r\n";
+
+/* Number of records in valid_zone */
+#define VALID_ZONE_COUNT    9
+
+/* Malformed zones, each with the expected error and the number of records
+ * which precede the error.
+ */
+static struct malformed_zone
+{
+    const char	*title;
+    const char	*zone;
+    pj_status_t	 status;
+    unsigned	 count;
+} malformed_zones[] =
+{
+    {
+	"unsupported record type",
+	"a.example.com. IN A 10.0.0.1\n"
+	"b.example.com. IN MX 10 mail.example.com.\n",
+	PJ_ENOTSUP, 1
+    },
+    {
+	"invalid IPv4 address",
+	"a.example.com. IN A 10.0.0\n",
+	PJ_EINVAL, 0
+    },
+    {
+	"invalid IPv6 address",
+	"a.example.com. IN AAAA 2001:db8::zz\n",
+	PJ_EINVAL, 0
+    },
+    {
+	"missing SRV fields",
+	"_sip._udp.example.com. IN SRV 0 10 5060\n",
+	PJ_ENOTSUP, 0
+    },
+    {
+	"missing record type",
+	"a.example.com. 300 IN\n",
+	PJ_EINVAL, 0
+    },
+    {
+	"blank owner without previous record",
+	"	IN A 10.0.0.1\n",
+	PJ_EINVAL, 0
+    },
+    {
+	"unsupported directive",
+	"$INCLUDE other.zone\n",
+	PJ_ENOTSUP, 0
+    },
+};
+
+
+static void query_cb(void *user_data, pj_status_t status,
+		     pj_dns_parsed_packet *response)
+{
+    PJ_UNUSED_ARG(user_data);
+
+    result.status = status;
+    if (response)
+	pj_dns_packet_dup(pool, response, 0, &result.pkt);
+    result.done = PJ_TRUE;
+}
+
+/* Send a query to the server, and wait for the response */
+static pj_status_t query(const char *name, int type)
+{
+    pj_str_t n = pj_str((char*)name);
+    pj_time_val timeout, now;
+    pj_status_t status;
+
+    pj_bzero(&result, sizeof(result));
+    status = pj_dns_resolver_start_query(resolver, &n, type, 0, &query_cb,
+					 NULL, NULL);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    pj_gettickcount(&timeout);
+    timeout.sec += 5;
+    do {
+	pj_time_val delay = {0, 10};
+	pj_ioqueue_poll(ioqueue, &delay);
+	pj_timer_heap_poll(timer_heap, NULL);
+	pj_gettickcount(&now);
+    } while (!result.done && PJ_TIME_VAL_LT(now, timeout));
+
+    if (!result.done)
+	return PJ_ETIMEDOUT;
+    if (result.status == PJ_SUCCESS && result.pkt == NULL)
+	return PJ_EBUG;
+    return result.status;
+}
+
+/* Find answer of the specified type and name */
+static const pj_dns_parsed_rr *find_ans(const char *name, int type,
+					unsigned skip)
+{
+    unsigned i;
+
+    for (i=0; i<result.pkt->hdr.anscount; ++i) {
+	const pj_dns_parsed_rr *rr = &result.pkt->ans[i];
+
+	if (rr->type == type && pj_stricmp2(&rr->name, name)==0 &&
+	    skip-- == 0)
+	{
+	    return rr;
+	}
+    }
+    return NULL;
+}
+
+static pj_bool_t is_ipv4(const pj_dns_parsed_rr *rr, const char *addr)
+{
+    pj_str_t tmp;
+
+    return rr && rr->rdata.a.ip_addr.s_addr ==
+		 pj_inet_addr(pj_cstr(&tmp, addr)).s_addr;
+}
+
+
+static int valid_zone_test(void)
+{
+    const pj_dns_parsed_rr *rr;
+    pj_str_t zone;
+    unsigned count;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  valid zone test"));
+
+    zone = pj_str((char*)valid_zone);
+    status = pj_dns_server_parse_zone(server, &zone, &count);
+    if (status != PJ_SUCCESS || count != VALID_ZONE_COUNT) {
+	PJ_LOG(3,(THIS_FILE, "    error: status=%d, count=%d", status,
+		  count));
+	return -100;
+    }
+
+    /* "@" is the origin, and $TTL applies */
+    if (query("example.com", PJ_DNS_TYPE_A) != PJ_SUCCESS)
+	return -110;
+    rr = find_ans("example.com", PJ_DNS_TYPE_A, 0);
+    if (!is_ipv4(rr, "10.0.0.10") || rr->ttl != 300)
+	return -120;
+
+    /* Both records of "sip", the second one has blank owner */
+    if (query("sip.example.com", PJ_DNS_TYPE_A) != PJ_SUCCESS)
+	return -130;
+    if (!is_ipv4(find_ans("sip.example.com", PJ_DNS_TYPE_A, 0),
+		 "10.0.0.1") ||
+	!is_ipv4(find_ans("sip.example.com", PJ_DNS_TYPE_A, 1),
+		 "10.0.0.2"))
+    {
+	return -140;
+    }
+
+    /* AAAA with explicit TTL */
+    if (query("sip.example.com", PJ_DNS_TYPE_AAAA) != PJ_SUCCESS)
+	return -150;
+    rr = find_ans("sip.example.com", PJ_DNS_TYPE_AAAA, 0);
+    if (!rr || rr->ttl != 60 || rr->rdata.aaaa.ip_addr.s6_addr[0] != 0x20 ||
+	rr->rdata.aaaa.ip_addr.s6_addr[15] != 1)
+    {
+	return -160;
+    }
+
+    /* CNAME is followed */
+    if (query("www.example.com", PJ_DNS_TYPE_A) != PJ_SUCCESS)
+	return -170;
+    rr = find_ans("www.example.com", PJ_DNS_TYPE_CNAME, 0);
+    if (!rr || pj_stricmp2(&rr->rdata.cname.name, "sip.example.com") != 0)
+	return -180;
+    if (!is_ipv4(find_ans("sip.example.com", PJ_DNS_TYPE_A, 0), "10.0.0.1"))
+	return -190;
+
+    /* SRV targets, relative and absolute */
+    if (query("_sip._udp.example.com", PJ_DNS_TYPE_SRV) != PJ_SUCCESS)
+	return -200;
+    rr = find_ans("_sip._udp.example.com", PJ_DNS_TYPE_SRV, 0);
+    if (!rr || rr->ttl != 3600 || rr->rdata.srv.prio != 0 ||
+	rr->rdata.srv.weight != 10 || rr->rdata.srv.port != 5060 ||
+	pj_stricmp2(&rr->rdata.srv.target, "sip.example.com") != 0)
+    {
+	return -210;
+    }
+    rr = find_ans("_sip._udp.example.com", PJ_DNS_TYPE_SRV, 1);
+    if (!rr || rr->rdata.srv.prio != 1 ||
+	pj_stricmp2(&rr->rdata.srv.target, "backup.other.test") != 0)
+    {
+	return -220;
+    }
+
+    /* $ORIGIN change, with TTL before the class and CR at end of line */
+    if (query("backup.other.test", PJ_DNS_TYPE_A) != PJ_SUCCESS)
+	return -230;
+    rr = find_ans("backup.other.test", PJ_DNS_TYPE_A, 0);
+    if (!is_ipv4(rr, "10.0.0.3") || rr->ttl != 120)
+	return -240;
+
+    /* Unknown name is NXDOMAIN, while existing name without record of
+     * the type is NODATA.
+     */
+    if (query("www.other.test", PJ_DNS_TYPE_A) !=
+	    PJ_STATUS_FROM_DNS_RCODE(PJ_DNS_RCODE_NXDOMAIN))
+    {
+	return -250;
+    }
+    if (query("backup.other.test", PJ_DNS_TYPE_SRV) != PJ_SUCCESS ||
+	result.pkt->hdr.anscount != 0)
+    {
+	return -260;
+    }
+
+    return 0;
+}
+
+
+static int malformed_zone_test(void)
+{
+    unsigned i;
+
+    PJ_LOG(3,(THIS_FILE, "  malformed zone test"));
+
+    for (i=0; i<PJ_ARRAY_SIZE(malformed_zones); ++i) {
+	pj_str_t zone;
+	unsigned count = 0xFFFF;
+	pj_status_t status;
+
+	PJ_LOG(3,(THIS_FILE, "   %s", malformed_zones[i].title));
+
+	zone = pj_str((char*)malformed_zones[i].zone);
+	status = pj_dns_server_parse_zone(server, &zone, &count);
+	if (status != malformed_zones[i].status)
+	    return -300 - i*10;
+	if (count != malformed_zones[i].count)
+	    return -305 - i*10;
+    }
+
+    /* Loading a missing file must fail */
+    if (pj_dns_server_load_zone(server, "no-such-file.zone", NULL) ==
+	    PJ_SUCCESS)
+    {
+	return -400;
+    }
+
+    return 0;
+}
+
+
+int dns_server_test(void)
+{
+    pj_str_t ns = pj_str("127.0.0.1");
+    pj_uint16_t port = PORT;
+    pj_status_t status;
+    int rc;
+
+    pool = pj_pool_create(mem, "dnssrvtest", 4000, 4000, NULL);
+
+    status = pj_timer_heap_create(pool, 16, &timer_heap);
+    if (status != PJ_SUCCESS) {
+	rc = -10;
+	goto on_return;
+    }
+
+    status = pj_ioqueue_create(pool, 16, &ioqueue);
+    if (status != PJ_SUCCESS) {
+	rc = -20;
+	goto on_return;
+    }
+
+    status = pj_dns_server_create(mem, ioqueue, pj_AF_INET(), PORT, 0,
+				  &server);
+    if (status != PJ_SUCCESS) {
+	app_perror("  error creating DNS server", status);
+	rc = -30;
+	goto on_return;
+    }
+
+    status = pj_dns_resolver_create(mem, NULL, 0, timer_heap, ioqueue,
+				    &resolver);
+    if (status != PJ_SUCCESS) {
+	rc = -40;
+	goto on_return;
+    }
+    pj_dns_resolver_set_ns(resolver, 1, &ns, &port);
+
+    rc = valid_zone_test();
+    if (rc == 0)
+	rc = malformed_zone_test();
+
+on_return:
+    if (resolver) {
+	pj_dns_resolver_destroy(resolver, PJ_FALSE);
+	resolver = NULL;
+    }
+    if (server) {
+	pj_dns_server_destroy(server);
+	server = NULL;
+    }
+    if (ioqueue) {
+	pj_ioqueue_destroy(ioqueue);
+	ioqueue = NULL;
+    }
+    if (timer_heap) {
+	pj_timer_heap_destroy(timer_heap);
+	timer_heap = NULL;
+    }
+    pj_pool_release(pool);
+    return rc;
+}
+
+#else
+int dns_server_test_dummy;
+#endif	/* INCLUDE_DNS_SERVER_TEST */
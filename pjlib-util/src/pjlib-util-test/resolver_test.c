@@ -227,6 +227,18 @@ static int print_rr(pj_uint8_t *pkt, int size, pj_uint8_t *pos,
 	p += (len + 8);
 	size -= (len + 8);
 
+    } else if (rr->data) {
+
+	/* Other types are written from the raw rdata */
+	if (size < rr->rdlength + 2)
+	    return -1;
+
+	write16(p, rr->rdlength);
+	pj_memcpy(p+2, rr->data, rr->rdlength);
+
+	p += (rr->rdlength + 2);
+	size -= (rr->rdlength + 2);
+
     } else {
 	pj_assert(!"Not supported");
 	return -1;
@@ -1367,6 +1379,282 @@ static int srv_resolver_many_test(void)
 }
 
 
+////////////////////////////////////////////////////////////////////////////
+/* Cache test: negative caching, stale entries and cache size limit */
+#define DOMAIN4	    "domain4.com"
+#define IP_ADDR4    0x03040506
+
+static pj_status_t cache_status;
+
+/* Reply NXDOMAIN with SOA record in the authority section */
+static void action4_1(const pj_dns_parsed_packet *pkt,
+		      pj_dns_parsed_packet **p_res)
+{
+    pj_dns_parsed_packet *res;
+    pj_uint8_t *soa;
+
+    res = PJ_POOL_ZALLOC_T(pool, pj_dns_parsed_packet);
+
+    res->q = PJ_POOL_ZALLOC_T(pool, pj_dns_parsed_query);
+    res->hdr.qdcount = 1;
+    res->q[0].type = pkt->q[0].type;
+    res->q[0].dnsclass = pkt->q[0].dnsclass;
+    res->q[0].name = pkt->q[0].name;
+
+    res->hdr.flags = PJ_DNS_SET_RCODE(PJ_DNS_RCODE_NXDOMAIN);
+
+    /* Root MNAME and RNAME, followed by five 32bit fields with
+     * MINIMUM (the negative caching TTL) set to 2 seconds.
+     */
+    soa = (pj_uint8_t*) pj_pool_zalloc(pool, 22);
+    write32(soa+18, 2);
+
+    res->ns = PJ_POOL_ZALLOC_T(pool, pj_dns_parsed_rr);
+    res->hdr.nscount = 1;
+    res->ns[0].type = PJ_DNS_TYPE_SOA;
+    res->ns[0].dnsclass = 1;
+    res->ns[0].ttl = 3600;
+    res->ns[0].name = pj_str(DOMAIN4);
+    res->ns[0].rdlength = 22;
+    res->ns[0].data = soa;
+
+    *p_res = res;
+}
+
+/* Reply with one A record with TTL 1 second */
+static void action4_2(const pj_dns_parsed_packet *pkt,
+		      pj_dns_parsed_packet **p_res)
+{
+    pj_dns_parsed_packet *res;
+
+    res = PJ_POOL_ZALLOC_T(pool, pj_dns_parsed_packet);
+
+    res->q = PJ_POOL_ZALLOC_T(pool, pj_dns_parsed_query);
+    res->hdr.qdcount = 1;
+    res->q[0].type = pkt->q[0].type;
+    res->q[0].dnsclass = pkt->q[0].dnsclass;
+    res->q[0].name = pkt->q[0].name;
+
+    res->ans = PJ_POOL_ZALLOC_T(pool, pj_dns_parsed_rr);
+    res->hdr.anscount = 1;
+    res->ans[0].type = PJ_DNS_TYPE_A;
+    res->ans[0].dnsclass = 1;
+    res->ans[0].ttl = 1;
+    res->ans[0].name = res->q[0].name;
+    res->ans[0].rdata.a.ip_addr.s_addr = IP_ADDR4;
+
+    *p_res = res;
+}
+
+static void dns_callback_4(void *user_data,
+			   pj_status_t status,
+			   pj_dns_parsed_packet *resp)
+{
+    PJ_UNUSED_ARG(user_data);
+    PJ_UNUSED_ARG(resp);
+
+    cache_status = status;
+    pj_sem_post(sem);
+}
+
+static void add_a_entry(const char *name, pj_bool_t set_ttl)
+{
+    pj_dns_parsed_packet pkt;
+    pj_dns_parsed_query q;
+    pj_dns_parsed_rr ans;
+
+    pj_bzero(&pkt, sizeof(pkt));
+    pj_bzero(&q, sizeof(q));
+    pj_bzero(&ans, sizeof(ans));
+
+    pkt.hdr.flags = PJ_DNS_SET_QR(1);
+    pkt.hdr.qdcount = 1;
+    pkt.q = &q;
+    q.type = PJ_DNS_TYPE_A;
+    q.dnsclass = 1;
+    q.name = pj_str((char*)name);
+
+    pkt.hdr.anscount = 1;
+    pkt.ans = &ans;
+    ans.type = PJ_DNS_TYPE_A;
+    ans.dnsclass = 1;
+    ans.ttl = 3600;
+    ans.name = q.name;
+    ans.rdata.a.ip_addr.s_addr = IP_ADDR4;
+
+    pj_dns_resolver_add_entry(resolver, &pkt, set_ttl);
+}
+
+/* Start query and return the status if it completes synchronously from
+ * the cache, or -1 if query had to be sent to the server.
+ */
+static pj_status_t cache_query(const char *name)
+{
+    pj_str_t n = pj_str((char*)name);
+    pj_status_t status;
+
+    cache_status = -1;
+    status = pj_dns_resolver_start_query(resolver, &n, PJ_DNS_TYPE_A, 0,
+					 &dns_callback_4, NULL, NULL);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    if (cache_status != -1) {
+	pj_sem_wait(sem);
+	return cache_status;
+    }
+
+    /* Resolver updates the cache after the callback returns */
+    pj_sem_wait(sem);
+    pj_thread_sleep(100);
+    return -1;
+}
+
+static int cache_test(void)
+{
+    pj_dns_settings orig_set;
+    unsigned pkt_count;
+    int rc = 0;
+
+    pj_dns_resolver_get_settings(resolver, &orig_set);
+
+    /* Negative caching */
+    PJ_LOG(3,(THIS_FILE, "  negative response caching test"));
+
+    g_server[0].action = ACTION_CB;
+    g_server[0].action_cb = &action4_1;
+    g_server[1].action = ACTION_CB;
+    g_server[1].action_cb = &action4_1;
+
+    if (cache_query("nx." DOMAIN4) != -1 ||
+	cache_status != PJ_STATUS_FROM_DNS_RCODE(PJ_DNS_RCODE_NXDOMAIN))
+    {
+	rc = -1400;
+	goto on_return;
+    }
+
+    pkt_count = g_server[0].pkt_count + g_server[1].pkt_count;
+
+    /* Must be served from the cache */
+    if (cache_query("nx." DOMAIN4) !=
+	    PJ_STATUS_FROM_DNS_RCODE(PJ_DNS_RCODE_NXDOMAIN) ||
+	g_server[0].pkt_count + g_server[1].pkt_count != pkt_count)
+    {
+	rc = -1410;
+	goto on_return;
+    }
+
+    /* Must expire after SOA MINIMUM rather than the SOA TTL */
+    pj_thread_sleep(2500);
+
+    if (cache_query("nx." DOMAIN4) != -1) {
+	rc = -1420;
+	goto on_return;
+    }
+
+    /* Stale entries */
+    PJ_LOG(3,(THIS_FILE, "  stale response test"));
+
+    set = orig_set;
+    set.cache_max_stale = 10;
+    pj_dns_resolver_set_settings(resolver, &set);
+
+    g_server[0].action_cb = &action4_2;
+    g_server[1].action_cb = &action4_2;
+
+    if (cache_query("stale." DOMAIN4) != -1 || cache_status != PJ_SUCCESS) {
+	rc = -1430;
+	goto on_return;
+    }
+
+    /* Let the entry expire and make the servers fail */
+    pj_thread_sleep(1500);
+
+    g_server[0].action = PJ_DNS_RCODE_SERVFAIL;
+    g_server[1].action = PJ_DNS_RCODE_SERVFAIL;
+
+    pkt_count = g_server[0].pkt_count + g_server[1].pkt_count;
+
+    /* Expired entry must be served immediately and refreshed */
+    if (cache_query("stale." DOMAIN4) != PJ_SUCCESS) {
+	rc = -1440;
+	goto on_return;
+    }
+
+    pj_thread_sleep(500);
+
+    if (g_server[0].pkt_count + g_server[1].pkt_count == pkt_count) {
+	rc = -1450;
+	goto on_return;
+    }
+
+    /* Failed refresh must not remove the stale entry */
+    if (cache_query("stale." DOMAIN4) != PJ_SUCCESS) {
+	rc = -1460;
+	goto on_return;
+    }
+
+    /* Cache size limit. Older entries from previous tests are evicted
+     * as soon as new entries are added, but permanent entries are neither
+     * evicted nor counted.
+     */
+    PJ_LOG(3,(THIS_FILE, "  cache size limit test"));
+
+    set = orig_set;
+    set.cache_max_count = 2;
+    pj_dns_resolver_set_settings(resolver, &set);
+
+    g_server[0].action = PJ_DNS_RCODE_NXDOMAIN;
+    g_server[1].action = PJ_DNS_RCODE_NXDOMAIN;
+
+    add_a_entry("static." DOMAIN4, PJ_FALSE);
+    add_a_entry("lru1." DOMAIN4, PJ_TRUE);
+    add_a_entry("lru2." DOMAIN4, PJ_TRUE);
+
+    /* Touch the first entry so the second one becomes the oldest */
+    if (cache_query("lru1." DOMAIN4) != PJ_SUCCESS) {
+	rc = -1470;
+	goto on_return;
+    }
+
+    add_a_entry("lru3." DOMAIN4, PJ_TRUE);
+
+    if (pj_dns_resolver_get_cached_count(resolver) != 3) {
+	rc = -1480;
+	goto on_return;
+    }
+
+    if (cache_query("lru1." DOMAIN4) != PJ_SUCCESS ||
+	cache_query("lru3." DOMAIN4) != PJ_SUCCESS)
+    {
+	rc = -1490;
+	goto on_return;
+    }
+
+    if (cache_query("lru2." DOMAIN4) != -1) {
+	rc = -1500;
+	goto on_return;
+    }
+
+    /* Fill the cache with more entries, the permanent entry must stay */
+    add_a_entry("lru4." DOMAIN4, PJ_TRUE);
+    add_a_entry("lru5." DOMAIN4, PJ_TRUE);
+    add_a_entry("lru6." DOMAIN4, PJ_TRUE);
+
+    if (pj_dns_resolver_get_cached_count(resolver) != 3 ||
+	cache_query("static." DOMAIN4) != PJ_SUCCESS)
+    {
+	rc = -1510;
+	goto on_return;
+    }
+
+on_return:
+    set = orig_set;
+    pj_dns_resolver_set_settings(resolver, &set);
+    return rc;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////
 
 
@@ -1394,6 +1682,10 @@ int resolver_test(void)
     srv_resolver_fallback_test();
     srv_resolver_many_test();
 
+    rc = cache_test();
+    if (rc != 0)
+	goto on_error;
+
     destroy();
     return 0;
 
@@ -89,6 +89,10 @@ static int test_inner(void)
     DO_TEST(resolver_test());
 #endif
 
+#if INCLUDE_DNS_SERVER_TEST
+    DO_TEST(dns_server_test());
+#endif
+
 #if INCLUDE_HTTP_CLIENT_TEST
     DO_TEST(http_client_test());
 #endif
@@ -24,6 +24,7 @@
 #define INCLUDE_ENCRYPTION_TEST	    1
 #define INCLUDE_STUN_TEST	    1
 #define INCLUDE_RESOLVER_TEST	    1
+#define INCLUDE_DNS_SERVER_TEST	    1
 #define INCLUDE_HTTP_CLIENT_TEST    1
 
 extern int xml_test(void);
@@ -33,6 +34,7 @@ extern int encryption_benchmark();
 extern int stun_test();
 extern int test_main(void);
 extern int resolver_test(void);
+extern int dns_server_test(void);
 extern int http_client_test();
 
 extern void app_perror(const char *title, pj_status_t rc);
@@ -21,15 +21,23 @@
 #include <pjlib-util/errno.h>
 #include <pj/activesock.h>
 #include <pj/assert.h>
+#include <pj/ctype.h>
+#include <pj/file_access.h>
+#include <pj/file_io.h>
 #include <pj/list.h>
+#include <pj/lock.h>
 #include <pj/log.h>
 #include <pj/pool.h>
+#include <pj/rand.h>
 #include <pj/string.h>
+#include <pj/timer.h>
 
 #define THIS_FILE   "dns_server.c"
 #define MAX_ANS	    16
 #define MAX_PKT	    1500
 #define MAX_LABEL   32
+#define MAX_TOKEN   16
+#define DEFAULT_TTL 3600
 
 struct label_tab
 {
@@ -48,13 +56,37 @@ struct rr
 };
 
 
+/* Answer waiting to be sent */
+struct tx_pkt
+{
+    pj_ioqueue_op_key_t	 send_key;
+    struct tx_pkt	*prev;
+    struct tx_pkt	*next;
+    pj_pool_t		*pool;
+    pj_dns_server	*srv;
+    pj_timer_entry	 timer;
+    pj_sockaddr		 dst_addr;
+    int			 addr_len;
+    pj_ssize_t		 len;
+    pj_uint8_t		 buf[MAX_PKT];
+};
+
 struct pj_dns_server
 {
     pj_pool_t		*pool;
     pj_pool_factory	*pf;
     pj_activesock_t	*asock;
-    pj_ioqueue_op_key_t	 send_key;
+    pj_lock_t		*lock;
     struct rr		 rr_list;
+    struct tx_pkt	 delayed_list;
+
+    /* Impairments */
+    pj_timer_heap_t	*timer_heap;
+    unsigned		 delay;
+    unsigned		 jitter;
+    unsigned		 loss;
+
+    pj_dns_server_stat	 stat;
 };
 
 
@@ -64,6 +96,9 @@ static pj_bool_t on_data_recvfrom(pj_activesock_t *asock,
 				  const pj_sockaddr_t *src_addr,
 				  int addr_len,
 				  pj_status_t status);
+static pj_bool_t on_data_sent(pj_activesock_t *asock,
+			      pj_ioqueue_op_key_t *send_key,
+			      pj_ssize_t sent);
 
 
 PJ_DEF(pj_status_t) pj_dns_server_create( pj_pool_factory *pf,
@@ -87,21 +122,25 @@ PJ_DEF(pj_status_t) pj_dns_server_create( pj_pool_factory *pf,
     srv->pool = pool;
     srv->pf = pf;
     pj_list_init(&srv->rr_list);
+    pj_list_init(&srv->delayed_list);
 
     pj_bzero(&sock_addr, sizeof(sock_addr));
     sock_addr.addr.sa_family = (pj_uint16_t)af;
     pj_sockaddr_set_port(&sock_addr, (pj_uint16_t)port);
     
+    status = pj_lock_create_simple_mutex(pool, "dnsserver", &srv->lock);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
     pj_bzero(&sock_cb, sizeof(sock_cb));
     sock_cb.on_data_recvfrom = &on_data_recvfrom;
+    sock_cb.on_data_sent = &on_data_sent;
 
     status = pj_activesock_create_udp(pool, &sock_addr, NULL, ioqueue,
 				      &sock_cb, srv, &srv->asock, NULL);
     if (status != PJ_SUCCESS)
 	goto on_error;
 
-    pj_ioqueue_op_key_init(&srv->send_key, sizeof(srv->send_key));
-
     status = pj_activesock_start_recvfrom(srv->asock, pool, MAX_PKT, 0);
     if (status != PJ_SUCCESS)
 	goto on_error;
@@ -124,6 +163,20 @@ PJ_DEF(pj_status_t) pj_dns_server_destroy(pj_dns_server *srv)
 	srv->asock = NULL;
     }
 
+    /* Drop answers which are still delayed */
+    while (!pj_list_empty(&srv->delayed_list)) {
+	struct tx_pkt *tx = srv->delayed_list.next;
+
+	pj_timer_heap_cancel(srv->timer_heap, &tx->timer);
+	pj_list_erase(tx);
+	pj_pool_release(tx->pool);
+    }
+
+    if (srv->lock) {
+	pj_lock_destroy(srv->lock);
+	srv->lock = NULL;
+    }
+
     if (srv->pool) {
 	pj_pool_t *pool = srv->pool;
 	srv->pool = NULL;
@@ -155,6 +208,20 @@ static struct rr* find_rr( pj_dns_server *srv,
 }
 
 
+/* Check if there is any record with the specified name */
+static pj_bool_t has_name(pj_dns_server *srv, const pj_str_t *name)
+{
+    struct rr *r;
+
+    for (r=srv->rr_list.next; r!=&srv->rr_list; r=r->next) {
+	if (pj_stricmp(&r->rec.name, name)==0)
+	    return PJ_TRUE;
+    }
+
+    return PJ_FALSE;
+}
+
+
 PJ_DEF(pj_status_t) pj_dns_server_add_rec( pj_dns_server *srv,
 					   unsigned count,
 					   const pj_dns_parsed_rr rr_param[])
@@ -163,12 +230,18 @@ PJ_DEF(pj_status_t) pj_dns_server_add_rec( pj_dns_server *srv,
 
     PJ_ASSERT_RETURN(srv && count && rr_param, PJ_EINVAL);
 
+    pj_lock_acquire(srv->lock);
+
     for (i=0; i<count; ++i) {
 	struct rr *rr;
 
-	PJ_ASSERT_RETURN(find_rr(srv, rr_param[i].dnsclass, rr_param[i].type,
-				 &rr_param[i].name) == NULL,
-			 PJ_EEXISTS);
+	if (find_rr(srv, rr_param[i].dnsclass, rr_param[i].type,
+		    &rr_param[i].name) != NULL)
+	{
+	    pj_lock_release(srv->lock);
+	    pj_assert(!"Record already exists");
+	    return PJ_EEXISTS;
+	}
 
 	rr = (struct rr*) PJ_POOL_ZALLOC_T(srv->pool, struct rr);
 	pj_memcpy(&rr->rec, &rr_param[i], sizeof(pj_dns_parsed_rr));
@@ -176,6 +249,8 @@ PJ_DEF(pj_status_t) pj_dns_server_add_rec( pj_dns_server *srv,
 	pj_list_push_back(&srv->rr_list, rr);
     }
 
+    pj_lock_release(srv->lock);
+
     return PJ_SUCCESS;
 }
 
@@ -189,16 +264,375 @@ PJ_DEF(pj_status_t) pj_dns_server_del_rec( pj_dns_server *srv,
 
     PJ_ASSERT_RETURN(srv && type && name, PJ_EINVAL);
 
+    pj_lock_acquire(srv->lock);
+
     rr = find_rr(srv, dns_class, type, name);
-    if (!rr)
+    if (!rr) {
+	pj_lock_release(srv->lock);
 	return PJ_ENOTFOUND;
+    }
 
     pj_list_erase(rr);
 
+    pj_lock_release(srv->lock);
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Zone file parsing.
+ */
+
+/* Zone parser state */
+struct zone_parser
+{
+    pj_pool_t	*pool;
+    unsigned	 line;
+    pj_str_t	 origin;
+    pj_uint32_t	 ttl;
+    pj_str_t	 last_name;
+};
+
+/* Split a line into tokens, handling quoted strings and comments. */
+static unsigned tokenize(char *p, char *end, pj_str_t tokens[])
+{
+    unsigned cnt = 0;
+
+    while (p != end && cnt < MAX_TOKEN) {
+	if (pj_isspace(*p)) {
+	    ++p;
+	} else if (*p == ';') {
+	    break;
+	} else if (*p == '"') {
+	    tokens[cnt].ptr = ++p;
+	    while (p != end && *p != '"')
+		++p;
+	    tokens[cnt].slen = p - tokens[cnt].ptr;
+	    ++cnt;
+	    if (p != end)
+		++p;
+	} else {
+	    tokens[cnt].ptr = p;
+	    while (p != end && !pj_isspace(*p) && *p != ';')
+		++p;
+	    tokens[cnt].slen = p - tokens[cnt].ptr;
+	    ++cnt;
+	}
+    }
+
+    return cnt;
+}
+
+/* Make a fully qualified name, without the trailing dot. */
+static void zone_name(struct zone_parser *zp, const pj_str_t *token,
+		      pj_str_t *name)
+{
+    if (token->slen == 1 && *token->ptr == '@') {
+	*name = zp->origin;
+    } else if (token->ptr[token->slen-1] == '.') {
+	name->ptr = token->ptr;
+	name->slen = token->slen - 1;
+	pj_strdup(zp->pool, name, name);
+    } else if (zp->origin.slen == 0) {
+	pj_strdup(zp->pool, name, token);
+    } else {
+	name->ptr = (char*) pj_pool_alloc(zp->pool,
+					  token->slen + zp->origin.slen + 1);
+	pj_memcpy(name->ptr, token->ptr, token->slen);
+	name->ptr[token->slen] = '.';
+	pj_memcpy(name->ptr + token->slen + 1, zp->origin.ptr,
+		  zp->origin.slen);
+	name->slen = token->slen + zp->origin.slen + 1;
+    }
+}
+
+/* Check if the token is all digits */
+static pj_bool_t is_number(const pj_str_t *token)
+{
+    pj_ssize_t i;
+
+    for (i=0; i<token->slen; ++i) {
+	if (!pj_isdigit(token->ptr[i]))
+	    return PJ_FALSE;
+    }
+    return token->slen != 0;
+}
+
+/* Encode NAPTR rdata, which is served as raw data. */
+static pj_status_t encode_naptr(struct zone_parser *zp,
+				const pj_str_t tokens[],
+				pj_dns_parsed_rr *rr)
+{
+    pj_uint8_t *p;
+    pj_str_t repl;
+    unsigned i, len;
+
+    zone_name(zp, &tokens[5], &repl);
+
+    /* order, pref, flags, services, regexp, replacement */
+    len = 4 + 3 + (unsigned)(tokens[2].slen + tokens[3].slen +
+			     tokens[4].slen) + (unsigned)repl.slen + 2;
+    p = (pj_uint8_t*) pj_pool_alloc(zp->pool, len);
+    rr->data = p;
+
+    p[0] = (pj_uint8_t)(pj_strtoul(&tokens[0]) >> 8);
+    p[1] = (pj_uint8_t)(pj_strtoul(&tokens[0]) & 0xFF);
+    p[2] = (pj_uint8_t)(pj_strtoul(&tokens[1]) >> 8);
+    p[3] = (pj_uint8_t)(pj_strtoul(&tokens[1]) & 0xFF);
+    p += 4;
+
+    for (i=2; i<5; ++i) {
+	if (tokens[i].slen > 255)
+	    return PJ_ETOOBIG;
+	*p++ = (pj_uint8_t)tokens[i].slen;
+	pj_memcpy(p, tokens[i].ptr, tokens[i].slen);
+	p += tokens[i].slen;
+    }
+
+    /* Replacement domain name, never compressed */
+    if (repl.slen) {
+	const char *label = repl.ptr, *end = repl.ptr + repl.slen;
+
+	while (label < end) {
+	    const char *dot = label;
+
+	    while (dot < end && *dot != '.')
+		++dot;
+	    if (dot - label > 63)
+		return PJ_ETOOBIG;
+	    *p++ = (pj_uint8_t)(dot - label);
+	    pj_memcpy(p, label, dot - label);
+	    p += (dot - label);
+	    label = dot + 1;
+	}
+    }
+    *p++ = 0;
+
+    rr->rdlength = (pj_uint16_t)(p - (pj_uint8_t*)rr->data);
+    return PJ_SUCCESS;
+}
+
+/* Parse one zone line into resource record. Returns PJ_EPENDING if the
+ * line contains no record.
+ */
+static pj_status_t parse_zone_line(struct zone_parser *zp,
+				   char *line, char *end,
+				   pj_dns_parsed_rr *rr)
+{
+    pj_str_t tokens[MAX_TOKEN];
+    unsigned cnt, i = 0;
+    pj_str_t type;
+
+    cnt = tokenize(line, end, tokens);
+    if (cnt == 0)
+	return PJ_EPENDING;
+
+    /* Directives */
+    if (pj_stricmp2(&tokens[0], "$ORIGIN")==0 && cnt >= 2) {
+	zp->origin.slen = 0;
+	zone_name(zp, &tokens[1], &zp->origin);
+	return PJ_EPENDING;
+    } else if (pj_stricmp2(&tokens[0], "$TTL")==0 && cnt >= 2) {
+	zp->ttl = pj_strtoul(&tokens[1]);
+	return PJ_EPENDING;
+    } else if (*tokens[0].ptr == '$') {
+	return PJ_ENOTSUP;
+    }
+
+    pj_bzero(rr, sizeof(*rr));
+    rr->dnsclass = PJ_DNS_CLASS_IN;
+    rr->ttl = zp->ttl;
+
+    /* Owner name, or the previous one if the line starts with blank */
+    if (pj_isspace(*line)) {
+	if (zp->last_name.slen == 0)
+	    return PJ_EINVAL;
+	rr->name = zp->last_name;
+    } else {
+	zone_name(zp, &tokens[0], &rr->name);
+	zp->last_name = rr->name;
+	++i;
+    }
+
+    /* Optional TTL and class, in any order */
+    for (; i < cnt; ++i) {
+	if (is_number(&tokens[i]))
+	    rr->ttl = pj_strtoul(&tokens[i]);
+	else if (pj_stricmp2(&tokens[i], "IN")==0)
+	    continue;
+	else
+	    break;
+    }
+
+    if (i == cnt)
+	return PJ_EINVAL;
+
+    type = tokens[i++];
+    cnt -= i;
+
+    if (pj_stricmp2(&type, "A")==0 && cnt >= 1) {
+	rr->type = PJ_DNS_TYPE_A;
+	if (pj_inet_pton(pj_AF_INET(), &tokens[i],
+			 &rr->rdata.a.ip_addr) != PJ_SUCCESS)
+	{
+	    return PJ_EINVAL;
+	}
+
+    } else if (pj_stricmp2(&type, "AAAA")==0 && cnt >= 1) {
+	rr->type = PJ_DNS_TYPE_AAAA;
+	if (pj_inet_pton(pj_AF_INET6(), &tokens[i],
+			 &rr->rdata.aaaa.ip_addr) != PJ_SUCCESS)
+	{
+	    return PJ_EINVAL;
+	}
+
+    } else if (pj_stricmp2(&type, "CNAME")==0 && cnt >= 1) {
+	rr->type = PJ_DNS_TYPE_CNAME;
+	zone_name(zp, &tokens[i], &rr->rdata.cname.name);
+
+    } else if (pj_stricmp2(&type, "NS")==0 && cnt >= 1) {
+	rr->type = PJ_DNS_TYPE_NS;
+	zone_name(zp, &tokens[i], &rr->rdata.ns.name);
+
+    } else if (pj_stricmp2(&type, "PTR")==0 && cnt >= 1) {
+	rr->type = PJ_DNS_TYPE_PTR;
+	zone_name(zp, &tokens[i], &rr->rdata.ptr.name);
+
+    } else if (pj_stricmp2(&type, "SRV")==0 && cnt >= 4) {
+	rr->type = PJ_DNS_TYPE_SRV;
+	rr->rdata.srv.prio = (pj_uint16_t)pj_strtoul(&tokens[i]);
+	rr->rdata.srv.weight = (pj_uint16_t)pj_strtoul(&tokens[i+1]);
+	rr->rdata.srv.port = (pj_uint16_t)pj_strtoul(&tokens[i+2]);
+	zone_name(zp, &tokens[i+3], &rr->rdata.srv.target);
+
+    } else if (pj_stricmp2(&type, "NAPTR")==0 && cnt >= 6) {
+	rr->type = PJ_DNS_TYPE_NAPTR;
+	return encode_naptr(zp, &tokens[i], rr);
+
+    } else {
+	return PJ_ENOTSUP;
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pj_dns_server_parse_zone(pj_dns_server *srv,
+					     const pj_str_t *zone,
+					     unsigned *p_count)
+{
+    struct zone_parser zp;
+    char *line, *end;
+    unsigned count = 0;
+    pj_status_t status = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(srv && zone, PJ_EINVAL);
+
+    pj_bzero(&zp, sizeof(zp));
+    zp.pool = srv->pool;
+    zp.ttl = DEFAULT_TTL;
+
+    pj_lock_acquire(srv->lock);
+
+    end = zone->ptr + zone->slen;
+    for (line = zone->ptr; line < end; ) {
+	char *eol = line;
+	pj_dns_parsed_rr rec;
+
+	while (eol < end && *eol != '\n')
+	    ++eol;
+
+	++zp.line;
+	status = parse_zone_line(&zp, line, eol, &rec);
+	if (status == PJ_SUCCESS) {
+	    struct rr *rr;
+
+	    rr = (struct rr*) PJ_POOL_ZALLOC_T(srv->pool, struct rr);
+	    pj_memcpy(&rr->rec, &rec, sizeof(pj_dns_parsed_rr));
+	    pj_list_push_back(&srv->rr_list, rr);
+	    ++count;
+	} else if (status != PJ_EPENDING) {
+	    PJ_PERROR(3,(THIS_FILE, status, "Error in zone line %d: %.*s",
+			 zp.line, (int)(eol-line), line));
+	    break;
+	}
+
+	status = PJ_SUCCESS;
+	line = eol + 1;
+    }
+
+    pj_lock_release(srv->lock);
+
+    if (p_count)
+	*p_count = count;
+
+    return status;
+}
+
+
+PJ_DEF(pj_status_t) pj_dns_server_load_zone(pj_dns_server *srv,
+					    const char *filename,
+					    unsigned *p_count)
+{
+    pj_oshandle_t fd;
+    pj_off_t size;
+    pj_ssize_t len;
+    pj_str_t zone;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(srv && filename, PJ_EINVAL);
+
+    size = pj_file_size(filename);
+    if (size < 0)
+	return PJ_ENOTFOUND;
+
+    status = pj_file_open(srv->pool, filename, PJ_O_RDONLY, &fd);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    /* The buffer is kept since the records point to it */
+    zone.ptr = (char*) pj_pool_alloc(srv->pool, (pj_size_t)size + 1);
+    len = (pj_ssize_t)size;
+    status = pj_file_read(fd, zone.ptr, &len);
+    pj_file_close(fd);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    zone.slen = len;
+    return pj_dns_server_parse_zone(srv, &zone, p_count);
+}
+
+
+PJ_DEF(pj_status_t) pj_dns_server_set_impairment(pj_dns_server *srv,
+						 pj_timer_heap_t *timer_heap,
+						 unsigned delay,
+						 unsigned jitter,
+						 unsigned loss)
+{
+    PJ_ASSERT_RETURN(srv && loss <= 100, PJ_EINVAL);
+    PJ_ASSERT_RETURN(timer_heap || (delay == 0 && jitter == 0), PJ_EINVAL);
+
+    pj_lock_acquire(srv->lock);
+    srv->timer_heap = timer_heap;
+    srv->delay = delay;
+    srv->jitter = jitter;
+    srv->loss = loss;
+    pj_lock_release(srv->lock);
+
     return PJ_SUCCESS;
 }
 
 
+PJ_DEF(void) pj_dns_server_get_stat(pj_dns_server *srv,
+				    pj_dns_server_stat *stat)
+{
+    pj_lock_acquire(srv->lock);
+    pj_memcpy(stat, &srv->stat, sizeof(*stat));
+    pj_lock_release(srv->lock);
+}
+
+
 static void write16(pj_uint8_t *p, pj_uint16_t val)
 {
     p[0] = (pj_uint8_t)(val >> 8);
@@ -311,6 +745,20 @@ static int print_rr(pj_uint8_t *pkt, int size, pj_uint8_t *pos,
 	p += 6;
 	size -= 6;
 
+    } else if (rr->type == PJ_DNS_TYPE_AAAA) {
+
+	if (size < 18)
+	    return -1;
+
+	/* RDLEN is 16 */
+	write16(p, 16);
+
+	/* Address */
+	pj_memcpy(p+2, &rr->rdata.aaaa.ip_addr, 16);
+
+	p += 18;
+	size -= 18;
+
     } else if (rr->type == PJ_DNS_TYPE_CNAME ||
 	       rr->type == PJ_DNS_TYPE_NS ||
 	       rr->type == PJ_DNS_TYPE_PTR) {
@@ -347,6 +795,18 @@ static int print_rr(pj_uint8_t *pkt, int size, pj_uint8_t *pos,
 	p += (len + 8);
 	size -= (len + 8);
 
+    } else if (rr->data) {
+
+	/* Raw resource data */
+	if (size < rr->rdlength + 2)
+	    return -1;
+
+	write16(p, rr->rdlength);
+	pj_memcpy(p+2, rr->data, rr->rdlength);
+
+	p += (rr->rdlength + 2);
+	size -= (rr->rdlength + 2);
+
     } else {
 	pj_assert(!"Not supported");
 	return -1;
@@ -436,6 +896,73 @@ static int print_packet(const pj_dns_parsed_packet *rec, pj_uint8_t *pkt,
 }
 
 
+/* Add all records with the specified name and type to the section. */
+static void add_records(pj_dns_server *srv, unsigned type,
+			const pj_str_t *name, pj_dns_parsed_rr *sect,
+			pj_uint16_t *count)
+{
+    struct rr *r;
+
+    for (r=srv->rr_list.next; r!=&srv->rr_list && *count<MAX_ANS; r=r->next) {
+	if (r->rec.dnsclass == PJ_DNS_CLASS_IN && r->rec.type == type &&
+	    pj_stricmp(&r->rec.name, name)==0)
+	{
+	    pj_memcpy(&sect[*count], &r->rec, sizeof(pj_dns_parsed_rr));
+	    ++(*count);
+	}
+    }
+}
+
+
+/* Send the answer. */
+static void send_answer(struct tx_pkt *tx)
+{
+    pj_status_t status;
+
+    status = pj_activesock_sendto(tx->srv->asock, &tx->send_key, tx->buf,
+				  &tx->len, 0, &tx->dst_addr, tx->addr_len);
+    if (status == PJ_EPENDING) {
+	/* Pool will be released by on_data_sent() */
+	return;
+    }
+
+    if (status != PJ_SUCCESS) {
+	PJ_LOG(4,(THIS_FILE, "Error sending answer, status=%d", status));
+    }
+
+    pj_pool_release(tx->pool);
+}
+
+
+/* Timer callback to send delayed answer. */
+static void on_delay_timer(pj_timer_heap_t *th, pj_timer_entry *entry)
+{
+    struct tx_pkt *tx = (struct tx_pkt*) entry->user_data;
+
+    PJ_UNUSED_ARG(th);
+
+    pj_lock_acquire(tx->srv->lock);
+    pj_list_erase(tx);
+    pj_lock_release(tx->srv->lock);
+
+    send_answer(tx);
+}
+
+
+static pj_bool_t on_data_sent(pj_activesock_t *asock,
+			      pj_ioqueue_op_key_t *send_key,
+			      pj_ssize_t sent)
+{
+    struct tx_pkt *tx = (struct tx_pkt*) send_key;
+
+    PJ_UNUSED_ARG(asock);
+    PJ_UNUSED_ARG(sent);
+
+    pj_pool_release(tx->pool);
+    return PJ_TRUE;
+}
+
+
 static pj_bool_t on_data_recvfrom(pj_activesock_t *asock,
 				  void *data,
 				  pj_size_t size,
@@ -447,8 +974,8 @@ static pj_bool_t on_data_recvfrom(pj_activesock_t *asock,
     pj_pool_t *pool;
     pj_dns_parsed_packet *req;
     pj_dns_parsed_packet ans;
-    struct rr *rr;
-    pj_ssize_t pkt_len;
+    struct tx_pkt *tx;
+    pj_time_val delay;
     unsigned i;
 
     if (status != PJ_SUCCESS)
@@ -462,93 +989,118 @@ static pj_bool_t on_data_recvfrom(pj_activesock_t *asock,
 	char addrinfo[PJ_INET6_ADDRSTRLEN+10];
 	pj_sockaddr_print(src_addr, addrinfo, sizeof(addrinfo), 3);
 	PJ_LOG(4,(THIS_FILE, "Error parsing query from %s", addrinfo));
-	goto on_return;
+	pj_pool_release(pool);
+	return PJ_TRUE;
+    }
+
+    pj_lock_acquire(srv->lock);
+
+    ++srv->stat.rx;
+
+    /* Simulate packet loss */
+    if (srv->loss && (unsigned)(pj_rand() % 100) < srv->loss) {
+	++srv->stat.dropped;
+	pj_lock_release(srv->lock);
+	pj_pool_release(pool);
+	return PJ_TRUE;
     }
 
     /* Init answer */
     pj_bzero(&ans, sizeof(ans));
     ans.hdr.id = req->hdr.id;
+    ans.hdr.flags = PJ_DNS_SET_QR(1) | PJ_DNS_SET_AA(1);
     ans.hdr.qdcount = 1;
     ans.q = (pj_dns_parsed_query*) PJ_POOL_ALLOC_T(pool, pj_dns_parsed_query);
     pj_memcpy(ans.q, req->q, sizeof(pj_dns_parsed_query));
 
     if (req->hdr.qdcount != 1) {
-	ans.hdr.flags = PJ_DNS_SET_RCODE(PJ_DNS_RCODE_FORMERR);
+	ans.hdr.flags |= PJ_DNS_SET_RCODE(PJ_DNS_RCODE_FORMERR);
 	goto send_pkt;
     }
 
     if (req->q[0].dnsclass != PJ_DNS_CLASS_IN) {
-	ans.hdr.flags = PJ_DNS_SET_RCODE(PJ_DNS_RCODE_NOTIMPL);
+	ans.hdr.flags |= PJ_DNS_SET_RCODE(PJ_DNS_RCODE_NOTIMPL);
 	goto send_pkt;
     }
 
-    /* Find the record */
-    rr = find_rr(srv, req->q->dnsclass, req->q->type, &req->q->name);
-    if (rr == NULL) {
-	ans.hdr.flags = PJ_DNS_SET_RCODE(PJ_DNS_RCODE_NXDOMAIN);
-	goto send_pkt;
-    }
-
-    /* Init answer record */
-    ans.hdr.anscount = 0;
+    /* Find the records */
     ans.ans = (pj_dns_parsed_rr*)
 	      pj_pool_calloc(pool, MAX_ANS, sizeof(pj_dns_parsed_rr));
+    add_records(srv, req->q->type, &req->q->name, ans.ans,
+		&ans.hdr.anscount);
 
-    /* DNS SRV query needs special treatment since it returns multiple
-     * records
+    /* If the name is an alias, answer with the canonical name and the
+     * records of the canonical name.
      */
-    if (req->q->type == PJ_DNS_TYPE_SRV) {
-	struct rr *r;
-
-	r = srv->rr_list.next;
-	while (r != &srv->rr_list) {
-	    if (r->rec.dnsclass == req->q->dnsclass && 
-		r->rec.type == PJ_DNS_TYPE_SRV && 
-		pj_stricmp(&r->rec.name, &req->q->name)==0 &&
-		ans.hdr.anscount < MAX_ANS)
-	    {
-		pj_memcpy(&ans.ans[ans.hdr.anscount], &r->rec,
-			  sizeof(pj_dns_parsed_rr));
-		++ans.hdr.anscount;
-	    }
-	    r = r->next;
+    if (ans.hdr.anscount == 0 && req->q->type != PJ_DNS_TYPE_CNAME) {
+	add_records(srv, PJ_DNS_TYPE_CNAME, &req->q->name, ans.ans,
+		    &ans.hdr.anscount);
+	if (ans.hdr.anscount) {
+	    add_records(srv, req->q->type, &ans.ans[0].rdata.cname.name,
+			ans.ans, &ans.hdr.anscount);
 	}
-    } else {
-	/* Otherwise just copy directly from the server record */
-	pj_memcpy(&ans.ans[ans.hdr.anscount], &rr->rec,
-			  sizeof(pj_dns_parsed_rr));
-	++ans.hdr.anscount;
-    }
-
-    /* For each CNAME entry, add A entry */
-    for (i=0; i<ans.hdr.anscount && ans.hdr.anscount < MAX_ANS; ++i) {
-	if (ans.ans[i].type == PJ_DNS_TYPE_CNAME) {
-	    struct rr *r;
-
-	    r = find_rr(srv, ans.ans[i].dnsclass, PJ_DNS_TYPE_A,
-		        &ans.ans[i].name);
-	    pj_memcpy(&ans.ans[ans.hdr.anscount], &r->rec,
-			      sizeof(pj_dns_parsed_rr));
-	    ++ans.hdr.anscount;
+    }
+
+    if (ans.hdr.anscount == 0) {
+	/* No data if the name exists, otherwise no such domain */
+	if (!has_name(srv, &req->q->name)) {
+	    ans.hdr.flags |= PJ_DNS_SET_RCODE(PJ_DNS_RCODE_NXDOMAIN);
+	    ++srv->stat.nxdomain;
+	}
+	goto send_pkt;
+    }
+
+    /* Add the addresses of SRV targets as additional records */
+    ans.arr = (pj_dns_parsed_rr*)
+	      pj_pool_calloc(pool, MAX_ANS, sizeof(pj_dns_parsed_rr));
+    for (i=0; i<ans.hdr.anscount; ++i) {
+	if (ans.ans[i].type == PJ_DNS_TYPE_SRV) {
+	    add_records(srv, PJ_DNS_TYPE_A, &ans.ans[i].rdata.srv.target,
+			ans.arr, &ans.hdr.arcount);
+	    add_records(srv, PJ_DNS_TYPE_AAAA, &ans.ans[i].rdata.srv.target,
+			ans.arr, &ans.hdr.arcount);
 	}
     }
 
 send_pkt:
-    pkt_len = print_packet(&ans, (pj_uint8_t*)data, MAX_PKT);
-    if (pkt_len < 1) {
+    tx = PJ_POOL_ZALLOC_T(pool, struct tx_pkt);
+    tx->pool = pool;
+    tx->srv = srv;
+    pj_ioqueue_op_key_init(&tx->send_key, sizeof(tx->send_key));
+    pj_sockaddr_cp(&tx->dst_addr, src_addr);
+    tx->addr_len = addr_len;
+
+    tx->len = print_packet(&ans, tx->buf, MAX_PKT);
+    if (tx->len < 1) {
+	pj_lock_release(srv->lock);
 	PJ_LOG(4,(THIS_FILE, "Error: answer too large"));
-	goto on_return;
+	pj_pool_release(pool);
+	return PJ_TRUE;
     }
 
-    status = pj_activesock_sendto(srv->asock, &srv->send_key, data, &pkt_len,
-				  0, src_addr, addr_len);
-    if (status != PJ_SUCCESS && status != PJ_EPENDING) {
-	PJ_LOG(4,(THIS_FILE, "Error sending answer, status=%d", status));
-	goto on_return;
+    ++srv->stat.tx;
+
+    /* Simulate network latency */
+    delay.sec = 0;
+    delay.msec = srv->delay;
+    if (srv->jitter)
+	delay.msec += pj_rand() % (srv->jitter + 1);
+
+    if (delay.msec) {
+	pj_time_val_normalize(&delay);
+	pj_timer_entry_init(&tx->timer, 0, tx, &on_delay_timer);
+	status = pj_timer_heap_schedule(srv->timer_heap, &tx->timer, &delay);
+	if (status == PJ_SUCCESS)
+	    pj_list_push_back(&srv->delayed_list, tx);
+	pj_lock_release(srv->lock);
+
+	if (status != PJ_SUCCESS)
+	    send_answer(tx);
+    } else {
+	pj_lock_release(srv->lock);
+	send_answer(tx);
     }
 
-on_return:
-    pj_pool_release(pool);
     return PJ_TRUE;
 }
 
@@ -156,8 +156,18 @@ struct cached_res
     struct res_key	     key;	    /**< Resource key.		    */
     pj_hash_entry_buf	     hbuf;	    /**< Hash buffer		    */
     pj_time_val		     expiry_time;   /**< Expiration time.	    */
+    pj_uint32_t		     ttl;	    /**< Original TTL, in seconds.  */
     pj_dns_parsed_packet    *pkt;	    /**< The response packet.	    */
     unsigned		     ref_cnt;	    /**< Reference counter.	    */
+    pj_bool_t		     permanent;	    /**< Added by app, never expires
+						 nor evicted.		    */
+};
+
+
+/* Cached response list head, ordered from the least recently used. */
+struct cache_head
+{
+    PJ_DECL_LIST_MEMBER(struct cached_res);
 };
 
 
@@ -199,6 +209,12 @@ struct pj_dns_resolver
     /* Hash table for cached response */
     pj_hash_table_t	*hrescache;	/**< Cached response in hash table  */
 
+    /* Cached response in LRU order, for limiting the cache size. Permanent
+     * entries are not in the list.
+     */
+    struct cache_head	 cache_lru;
+    unsigned		 cache_lru_cnt;	/**< Number of entries in the list. */
+
     /* Pending asynchronous query, hashed by transaction ID. */
     pj_hash_table_t	*hquerybyid;
 
@@ -291,6 +307,9 @@ PJ_DEF(void) pj_dns_settings_default(pj_dns_settings *s)
     s->cache_max_ttl = PJ_DNS_RESOLVER_MAX_TTL;
     s->good_ns_ttl = PJ_DNS_RESOLVER_GOOD_NS_TTL;
     s->bad_ns_ttl = PJ_DNS_RESOLVER_BAD_NS_TTL;
+    s->cache_max_count = PJ_DNS_RESOLVER_MAX_CACHE_COUNT;
+    s->cache_max_stale = PJ_DNS_RESOLVER_MAX_STALE;
+    s->cache_prefetch = PJ_DNS_RESOLVER_PREFETCH_PCT;
 }
 
 
@@ -354,6 +373,7 @@ PJ_DEF(pj_status_t) pj_dns_resolver_create( pj_pool_factory *pf,
 
     /* Response cache hash table */
     resv->hrescache = pj_hash_create(pool, RES_HASH_TABLE_SIZE);
+    pj_list_init(&resv->cache_lru);
 
     /* Query hash table and free list. */
     resv->hquerybyid = pj_hash_create(pool, Q_HASH_TABLE_SIZE);
@@ -731,6 +751,107 @@ static void free_entry(pj_dns_resolver *resolver, struct cached_res *cache)
     pj_pool_release(cache->pool);
 }
 
+/* Remove cached entry from the cache, and free it if it is not being used
+ * (by callback).
+ */
+static void remove_entry(pj_dns_resolver *resolver, struct cached_res *cache,
+			 pj_uint32_t hval)
+{
+    /* Remove the entry before releasing its pool (see ticket #1710) */
+    pj_hash_set(NULL, resolver->hrescache, &cache->key, sizeof(cache->key),
+		hval, NULL);
+    if (!cache->permanent) {
+	pj_list_erase(cache);
+	--resolver->cache_lru_cnt;
+    }
+
+    if (--cache->ref_cnt <= 0)
+	free_entry(resolver, cache);
+}
+
+/* Check if an expired cached entry may still be returned */
+static pj_bool_t is_stale_usable(pj_dns_resolver *resolver,
+				 const struct cached_res *cache,
+				 const pj_time_val *now)
+{
+    pj_time_val stale_time;
+
+    if (resolver->settings.cache_max_stale == 0)
+	return PJ_FALSE;
+
+    stale_time = cache->expiry_time;
+    stale_time.sec += resolver->settings.cache_max_stale;
+    return PJ_TIME_VAL_GT(stale_time, *now);
+}
+
+
+/*
+ * Create and transmit new query for the specified resource key.
+ * This must be called with resolver mutex held.
+ */
+static pj_status_t start_new_query(pj_dns_resolver *resolver,
+				   const struct res_key *key,
+				   unsigned options,
+				   pj_dns_callback *cb,
+				   void *user_data,
+				   pj_dns_async_query **p_query)
+{
+    pj_dns_async_query *q;
+    pj_status_t status;
+
+    q = alloc_qnode(resolver, options, user_data, cb);
+
+    /* Save the ID and key */
+    /* TODO: dnsext-forgery-resilient: randomize id for security */
+    q->id = resolver->last_id++;
+    if (resolver->last_id == 0)
+	resolver->last_id = 1;
+    pj_memcpy(&q->key, key, sizeof(struct res_key));
+
+    /* Send the query */
+    status = transmit_query(resolver, q);
+    if (status != PJ_SUCCESS) {
+	pj_list_push_back(&resolver->query_free_nodes, q);
+	return status;
+    }
+
+    /* Add query entry to the hash tables */
+    pj_hash_set_np(resolver->hquerybyid, &q->id, sizeof(q->id), 
+		   0, q->hbufid, q);
+    pj_hash_set_np(resolver->hquerybyres, &q->key, sizeof(q->key),
+		   0, q->hbufkey, q);
+
+    if (p_query)
+	*p_query = q;
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Refresh cached response in the background, unless there is already
+ * pending query for the same resource. The cache will be updated when
+ * the response arrives. This must be called with resolver mutex held.
+ */
+static void refresh_entry(pj_dns_resolver *resolver,
+			  const struct res_key *key)
+{
+    pj_status_t status;
+
+    if (pj_hash_get(resolver->hquerybyres, key, sizeof(*key), NULL))
+	return;
+
+    PJ_LOG(5,(resolver->name.ptr, "Refreshing cached DNS %s record for %s",
+	      pj_dns_get_type_name(key->qtype), key->name));
+
+    status = start_new_query(resolver, key, 0, NULL, NULL, NULL);
+    if (status != PJ_SUCCESS) {
+	PJ_PERROR(4,(resolver->name.ptr, status,
+		     "Failed refreshing DNS %s record for %s",
+		     pj_dns_get_type_name(key->qtype), key->name));
+    }
+}
+
 
 /*
  * Create and start asynchronous DNS query for a single resource.
@@ -780,16 +901,36 @@ PJ_DEF(pj_status_t) pj_dns_resolver_start_query( pj_dns_resolver *resolver,
     					      sizeof(key), &hval);
     if (cache) {
 	/* We've found a cached entry. */
+	pj_bool_t expired = !PJ_TIME_VAL_GT(cache->expiry_time, now);
 
-	/* Check for expiration */
-	if (PJ_TIME_VAL_GT(cache->expiry_time, now)) {
+	/* Check for expiration. Expired entry may still be used while it
+	 * is being refreshed.
+	 */
+	if (!expired || is_stale_usable(resolver, cache, &now)) {
+	    long ttl = (long)(cache->expiry_time.sec - now.sec);
 
 	    /* Log */
 	    PJ_LOG(5,(resolver->name.ptr, 
-		      "Picked up DNS %s record for %.*s from cache, ttl=%d",
+		      "Picked up %sDNS %s record for %.*s from cache, ttl=%d",
+		      (expired? "expired " : ""),
 		      pj_dns_get_type_name(type),
 		      (int)name->slen, name->ptr,
-		      (int)(cache->expiry_time.sec - now.sec)));
+		      (int)ttl));
+
+	    /* Refresh the entry if it has expired or is about to expire */
+	    if (expired ||
+		(resolver->settings.cache_prefetch &&
+		 ttl * 100 <= (long)cache->ttl * 
+			      (long)resolver->settings.cache_prefetch))
+	    {
+		refresh_entry(resolver, &key);
+	    }
+
+	    /* Mark the entry as the most recently used */
+	    if (!cache->permanent) {
+		pj_list_erase(cache);
+		pj_list_push_back(&resolver->cache_lru, cache);
+	    }
 
 	    /* Map DNS Rcode in the response into PJLIB status name space */
 	    status = PJ_DNS_GET_RCODE(cache->pkt->hdr.flags);
@@ -826,14 +967,10 @@ PJ_DEF(pj_status_t) pj_dns_resolver_start_query( pj_dns_resolver *resolver,
 	}
 
 	/* At this point, we have a cached entry, but this entry has expired.
-	 * Remove this entry from the cached list.
+	 * Remove this entry from the cached list, and also free the cache,
+	 * if it is not being used (by callback).
 	 */
-	pj_hash_set(NULL, resolver->hrescache, &key, sizeof(key), 0, NULL);
-
-	/* Also free the cache, if it is not being used (by callback). */
-	cache->ref_cnt--;
-	if (cache->ref_cnt <= 0)
-	    free_entry(resolver, cache);
+	remove_entry(resolver, cache, hval);
 
 	/* Must continue with creating a query now */
     }
@@ -859,30 +996,7 @@ PJ_DEF(pj_status_t) pj_dns_resolver_start_query( pj_dns_resolver *resolver,
     } 
 
     /* There's no pending query to the same key, initiate a new one. */
-    q = alloc_qnode(resolver, options, user_data, cb);
-
-    /* Save the ID and key */
-    /* TODO: dnsext-forgery-resilient: randomize id for security */
-    q->id = resolver->last_id++;
-    if (resolver->last_id == 0)
-	resolver->last_id = 1;
-    pj_memcpy(&q->key, &key, sizeof(struct res_key));
-
-    /* Send the query */
-    status = transmit_query(resolver, q);
-    if (status != PJ_SUCCESS) {
-	pj_list_push_back(&resolver->query_free_nodes, q);
-	goto on_return;
-    }
-
-    /* Add query entry to the hash tables */
-    pj_hash_set_np(resolver->hquerybyid, &q->id, sizeof(q->id), 
-		   0, q->hbufid, q);
-    pj_hash_set_np(resolver->hquerybyres, &q->key, sizeof(q->key),
-		   0, q->hbufkey, q);
-
-    if (p_query)
-	*p_query = q;
+    status = start_new_query(resolver, &key, options, cb, user_data, p_query);
 
 on_return:
     pj_mutex_unlock(resolver->mutex);
@@ -1183,6 +1297,40 @@ static void report_nameserver_status(pj_dns_resolver *resolver,
 }
 
 
+/* Get the negative caching TTL from the SOA record in the authority
+ * section, as described in RFC 2308 section 5. Returns PJ_FALSE if the
+ * response doesn't contain SOA record.
+ */
+static pj_bool_t get_negative_ttl(const pj_dns_parsed_packet *pkt,
+				  pj_uint32_t *ttl)
+{
+    unsigned i;
+
+    for (i=0; i<pkt->hdr.nscount; ++i) {
+	const pj_dns_parsed_rr *rr = &pkt->ns[i];
+	pj_uint32_t minimum;
+
+	/* SOA rdata is not parsed, but MINIMUM is always the last 32bit
+	 * field of the rdata, regardless of name compression in MNAME
+	 * and RNAME.
+	 */
+	if (rr->type != PJ_DNS_TYPE_SOA || rr->data == NULL ||
+	    rr->rdlength < 22)
+	{
+	    continue;
+	}
+
+	pj_memcpy(&minimum, (const pj_uint8_t*)rr->data + rr->rdlength - 4, 4);
+	minimum = pj_ntohl(minimum);
+
+	*ttl = (rr->ttl < minimum) ? rr->ttl : minimum;
+	return PJ_TRUE;
+    }
+
+    return PJ_FALSE;
+}
+
+
 /* Update response cache */
 static void update_res_cache(pj_dns_resolver *resolver,
 			     const struct res_key *key,
@@ -1193,16 +1341,30 @@ static void update_res_cache(pj_dns_resolver *resolver,
     struct cached_res *cache;
     pj_uint32_t hval=0, ttl;
 
+    /* NXDOMAIN and NODATA responses are authoritative negative answers,
+     * while other failures (e.g: SERVFAIL, REFUSED) are transient, so
+     * don't let them replace cached entry that may still be used.
+     */
+    if (status != PJ_SUCCESS && status != PJLIB_UTIL_EDNS_NXDOMAIN) {
+	pj_time_val now;
+
+	cache = (struct cached_res *) pj_hash_get(resolver->hrescache, key, 
+						  sizeof(*key), &hval);
+	pj_gettimeofday(&now);
+	if (cache && is_stale_usable(resolver, cache, &now)) {
+	    PJ_LOG(5,(resolver->name.ptr, "Keeping cached DNS %s record for "
+		      "%s after transient failure",
+		      pj_dns_get_type_name(key->qtype), key->name));
+	    return;
+	}
+    }
+
     /* If status is unsuccessful, clear the same entry from the cache */
     if (status != PJ_SUCCESS) {
 	cache = (struct cached_res *) pj_hash_get(resolver->hrescache, key, 
 						  sizeof(*key), &hval);
-	/* Remove the entry before releasing its pool (see ticket #1710) */
-	pj_hash_set(NULL, resolver->hrescache, key, sizeof(*key), hval, NULL);
-	
-	/* Free the entry */
-	if (cache && --cache->ref_cnt <= 0)
-	    free_entry(resolver, cache);
+	if (cache)
+	    remove_entry(resolver, cache, hval);
     }
 
 
@@ -1211,9 +1373,15 @@ static void update_res_cache(pj_dns_resolver *resolver,
 	if (pkt->hdr.anscount == 0 || status != PJ_SUCCESS) {
 	    /* If we don't have answers for the name, then give a different
 	     * ttl value (note: PJ_DNS_RESOLVER_INVALID_TTL may be zero, 
-	     * which means that invalid names won't be kept in the cache)
+	     * which means that invalid names won't be kept in the cache),
+	     * unless the server tells how long the negative answer may be
+	     * cached (RFC 2308).
 	     */
-	    ttl = PJ_DNS_RESOLVER_INVALID_TTL;
+	    if ((status != PJ_SUCCESS && status != PJLIB_UTIL_EDNS_NXDOMAIN) ||
+		!get_negative_ttl(pkt, &ttl))
+	    {
+		ttl = PJ_DNS_RESOLVER_INVALID_TTL;
+	    }
 
 	} else {
 	    /* Otherwise get the minimum TTL from the answers */
@@ -1236,12 +1404,8 @@ static void update_res_cache(pj_dns_resolver *resolver,
     if (ttl == 0) {
 	cache = (struct cached_res *) pj_hash_get(resolver->hrescache, key, 
 						  sizeof(*key), &hval);
-	/* Remove the entry before releasing its pool (see ticket #1710) */
-	pj_hash_set(NULL, resolver->hrescache, key, sizeof(*key), hval, NULL);
-
-	/* Free the entry */
-	if (cache && --cache->ref_cnt <= 0)
-	    free_entry(resolver, cache);
+	if (cache)
+	    remove_entry(resolver, cache, hval);
 	return;
     }
 
@@ -1251,15 +1415,19 @@ static void update_res_cache(pj_dns_resolver *resolver,
     if (cache == NULL) {
 	cache = alloc_entry(resolver);
     } else if (cache->ref_cnt > 1) {
-	/* When cache entry is being used by callback (to app), just decrement
-	 * ref_cnt so it will be freed after the callback returns and allocate
-	 * new entry.
+	/* When cache entry is being used by callback (to app), just remove
+	 * it from the cache so it will be freed after the callback returns
+	 * and allocate new entry.
 	 */
-	cache->ref_cnt--;
+	remove_entry(resolver, cache, hval);
 	cache = alloc_entry(resolver);
     } else {
 	/* Remove the entry before resetting its pool (see ticket #1710) */
 	pj_hash_set(NULL, resolver->hrescache, key, sizeof(*key), hval, NULL);
+	if (!cache->permanent) {
+	    pj_list_erase(cache);
+	    --resolver->cache_lru_cnt;
+	}
 
 	/* Reset cache to avoid bloated cache pool */
 	reset_entry(&cache);
@@ -1279,9 +1447,11 @@ static void update_res_cache(pj_dns_resolver *resolver,
     if (set_expiry) {
 	pj_gettimeofday(&cache->expiry_time);
 	cache->expiry_time.sec += ttl;
+	cache->ttl = ttl;
     } else {
 	cache->expiry_time.sec = 0x7FFFFFFFL;
 	cache->expiry_time.msec = 0;
+	cache->ttl = 0;
     }
 
     /* Copy key to the cached response */
@@ -1291,6 +1461,27 @@ static void update_res_cache(pj_dns_resolver *resolver,
     pj_hash_set_np(resolver->hrescache, &cache->key, sizeof(*key), hval,
 		   cache->hbuf, cache);
 
+    /* This is now the most recently used entry. Permanent entries are
+     * never evicted, so they are kept out of the LRU list.
+     */
+    cache->permanent = !set_expiry;
+    if (cache->permanent) {
+	pj_list_init(cache);
+	return;
+    }
+    pj_list_push_back(&resolver->cache_lru, cache);
+    ++resolver->cache_lru_cnt;
+
+    /* Evict the least recently used entries when the cache is full */
+    while (resolver->settings.cache_max_count &&
+	   resolver->cache_lru_cnt > resolver->settings.cache_max_count)
+    {
+	struct cached_res *lru = resolver->cache_lru.next;
+
+	PJ_LOG(5,(resolver->name.ptr, "Evicting cached DNS %s record for %s",
+		  pj_dns_get_type_name(lru->key.qtype), lru->key.name));
+	remove_entry(resolver, lru, 0);
+    }
 }
 
 
@@ -37,12 +37,24 @@ struct common
     pj_dns_type		     type;	    /**< Type of this structure.*/
 };
 
+struct srv_target;
+
+/* User data for DNS AAAA query of a target */
+struct srv_target_aaaa
+{
+    struct common	    common;
+    struct srv_target	   *srv;
+};
+
 struct srv_target
 {
     struct common	    common;
+    struct srv_target_aaaa  common_aaaa;
     pj_dns_srv_async_query *parent;
     pj_str_t		    target_name;
     pj_dns_async_query	   *q_a;
+    pj_dns_async_query	   *q_aaaa;
+    unsigned		    pending;
     char		    target_buf[PJ_MAX_HOSTNAME];
     pj_str_t		    cname;
     char		    cname_buf[PJ_MAX_HOSTNAME];
@@ -52,6 +64,8 @@ struct srv_target
     unsigned		    sum;
     unsigned		    addr_cnt;
     pj_in_addr		    addr[ADDR_MAX_COUNT];
+    unsigned		    addr6_cnt;
+    pj_in6_addr		    addr6[ADDR_MAX_COUNT];
 };
 
 struct pj_dns_srv_async_query
@@ -178,6 +192,11 @@ PJ_DEF(pj_status_t) pj_dns_srv_cancel_query(pj_dns_srv_async_query *query,
 	    srv->q_a = NULL;
 	    has_pending = PJ_TRUE;
 	}
+	if (srv->q_aaaa) {
+	    pj_dns_resolver_cancel_query(srv->q_aaaa, PJ_FALSE);
+	    srv->q_aaaa = NULL;
+	    has_pending = PJ_TRUE;
+	}
     }
 
     if (has_pending && notify && query->cb) {
@@ -322,22 +341,35 @@ static void build_server_entries(pj_dns_srv_async_query *query_job,
 	pj_dns_parsed_rr *rr = &response->arr[i];
 	unsigned j;
 
-	if (rr->type != PJ_DNS_TYPE_A)
+	if (rr->type != PJ_DNS_TYPE_A &&
+	    (rr->type != PJ_DNS_TYPE_AAAA ||
+	     (query_job->option & PJ_DNS_SRV_RESOLVE_AAAA) == 0))
+	{
 	    continue;
+	}
 
 	/* Yippeaiyee!! There is an "A" record! 
 	 * Update the IP address of the corresponding SRV record.
 	 */
 	for (j=0; j<query_job->srv_cnt; ++j) {
-	    if (pj_stricmp(&rr->name, &query_job->srv[j].target_name)==0) {
-		unsigned cnt = query_job->srv[j].addr_cnt;
-		query_job->srv[j].addr[cnt].s_addr = rr->rdata.a.ip_addr.s_addr;
-		/* Only increment host_resolved once per SRV record */
-		if (query_job->srv[j].addr_cnt == 0)
-		    ++query_job->host_resolved;
-		++query_job->srv[j].addr_cnt;
-		break;
+	    struct srv_target *srv = &query_job->srv[j];
+
+	    if (pj_stricmp(&rr->name, &srv->target_name)!=0)
+		continue;
+
+	    /* Only increment host_resolved once per SRV record */
+	    if (srv->addr_cnt == 0 && srv->addr6_cnt == 0)
+		++query_job->host_resolved;
+
+	    if (rr->type == PJ_DNS_TYPE_A) {
+		if (srv->addr_cnt < ADDR_MAX_COUNT)
+		    srv->addr[srv->addr_cnt++].s_addr = 
+			rr->rdata.a.ip_addr.s_addr;
+	    } else {
+		if (srv->addr6_cnt < ADDR_MAX_COUNT)
+		    srv->addr6[srv->addr6_cnt++] = rr->rdata.aaaa.ip_addr;
 	    }
+	    break;
 	}
 
 	/* Not valid message; SRV entry might have been deleted in
@@ -361,7 +393,11 @@ static void build_server_entries(pj_dns_srv_async_query *query_job,
     for (i=0; i<query_job->srv_cnt; ++i) {
 	pj_in_addr addr;
 
-	if (query_job->srv[i].addr_cnt != 0) {
+	pj_in6_addr addr6;
+
+	if (query_job->srv[i].addr_cnt != 0 ||
+	    query_job->srv[i].addr6_cnt != 0)
+	{
 	    /* IP address already resolved */
 	    continue;
 	}
@@ -369,6 +405,12 @@ static void build_server_entries(pj_dns_srv_async_query *query_job,
 	if (pj_inet_aton(&query_job->srv[i].target_name, &addr) != 0) {
 	    query_job->srv[i].addr[query_job->srv[i].addr_cnt++] = addr;
 	    ++query_job->host_resolved;
+	} else if ((query_job->option & PJ_DNS_SRV_RESOLVE_AAAA) &&
+		   pj_inet_pton(pj_AF_INET6(), &query_job->srv[i].target_name,
+				&addr6) == PJ_SUCCESS)
+	{
+	    query_job->srv[i].addr6[query_job->srv[i].addr6_cnt++] = addr6;
+	    ++query_job->host_resolved;
 	}
     }
 
@@ -402,38 +444,107 @@ static void build_server_entries(pj_dns_srv_async_query *query_job,
 }
 
 
-/* Start DNS A record queries for all SRV records in the query_job structure */
+/* Start DNS A record queries for all SRV records in the query_job structure.
+ * When PJ_DNS_SRV_RESOLVE_AAAA option is set, DNS AAAA queries are started
+ * alongside, so all targets are resolved for both address families in
+ * parallel.
+ */
 static pj_status_t resolve_hostnames(pj_dns_srv_async_query *query_job)
 {
+    pj_bool_t has_aaaa = (query_job->option & PJ_DNS_SRV_RESOLVE_AAAA) != 0;
     unsigned i;
     pj_status_t err=PJ_SUCCESS, status;
 
     query_job->dns_state = PJ_DNS_TYPE_A;
+
+    /* Initialize the targets first, as the callback may be called
+     * immediately if the response is found in the cache.
+     */
     for (i=0; i<query_job->srv_cnt; ++i) {
 	struct srv_target *srv = &query_job->srv[i];
 
+	srv->common.type = PJ_DNS_TYPE_A;
+	srv->common_aaaa.common.type = PJ_DNS_TYPE_AAAA;
+	srv->common_aaaa.srv = srv;
+	srv->parent = query_job;
+	srv->pending = 0;
+
+	if (srv->addr_cnt == 0 && srv->addr6_cnt == 0)
+	    srv->pending = has_aaaa ? 2 : 1;
+    }
+
+    for (i=0; i<query_job->srv_cnt; ++i) {
+	struct srv_target *srv = &query_job->srv[i];
+
+	if (srv->pending == 0)
+	    continue;
+
 	PJ_LOG(5, (query_job->objname, 
-		   "Starting async DNS A query_job for %.*s",
+		   "Starting async DNS A%s query_job for %.*s",
+		   (has_aaaa ? "/AAAA" : ""),
 		   (int)srv->target_name.slen, 
 		   srv->target_name.ptr));
 
-	srv->common.type = PJ_DNS_TYPE_A;
-	srv->parent = query_job;
-
 	status = pj_dns_resolver_start_query(query_job->resolver,
 					     &srv->target_name,
 					     PJ_DNS_TYPE_A, 0,
 					     &dns_callback,
-					     srv, &srv->q_a);
+					     &srv->common, &srv->q_a);
 	if (status != PJ_SUCCESS) {
-	    query_job->host_resolved++;
 	    err = status;
+	    if (--srv->pending == 0)
+		query_job->host_resolved++;
+	}
+
+	if (!has_aaaa)
+	    continue;
+
+	status = pj_dns_resolver_start_query(query_job->resolver,
+					     &srv->target_name,
+					     PJ_DNS_TYPE_AAAA, 0,
+					     &dns_callback,
+					     &srv->common_aaaa, &srv->q_aaaa);
+	if (status != PJ_SUCCESS) {
+	    err = status;
+	    if (--srv->pending == 0)
+		query_job->host_resolved++;
 	}
     }
     
     return (query_job->host_resolved == query_job->srv_cnt) ? err : PJ_SUCCESS;
 }
 
+
+/* Save DNS AAAA records in the response to the target. */
+static void save_aaaa_response(pj_dns_srv_async_query *query_job,
+			       struct srv_target *srv,
+			       const pj_dns_parsed_packet *pkt)
+{
+    unsigned i;
+
+    /* Any CNAME records have been followed by the nameserver, so take
+     * all AAAA records in the answer.
+     */
+    for (i=0; i<pkt->hdr.anscount && srv->addr6_cnt < ADDR_MAX_COUNT; ++i) {
+	const pj_dns_parsed_rr *rr = &pkt->ans[i];
+	char addr[PJ_INET6_ADDRSTRLEN];
+
+	if (rr->type != PJ_DNS_TYPE_AAAA)
+	    continue;
+
+	srv->addr6[srv->addr6_cnt++] = rr->rdata.aaaa.ip_addr;
+
+	PJ_LOG(5,(query_job->objname, 
+		  "DNS AAAA for %.*s: %s",
+		  (int)srv->target_name.slen, 
+		  srv->target_name.ptr,
+		  pj_inet_ntop2(pj_AF_INET6(), &rr->rdata.aaaa.ip_addr,
+				addr, sizeof(addr))));
+    }
+
+    PJ_UNUSED_ARG(query_job);
+}
+
 /* 
  * This callback is called by PJLIB-UTIL DNS resolver when asynchronous
  * query_job has completed (successfully or with error).
@@ -453,6 +564,9 @@ static void dns_callback(void *user_data,
     } else if (common->type == PJ_DNS_TYPE_A) {
 	srv = (struct srv_target*) common;
 	query_job = srv->parent;
+    } else if (common->type == PJ_DNS_TYPE_AAAA) {
+	srv = ((struct srv_target_aaaa*) common)->srv;
+	query_job = srv->parent;
     } else {
 	pj_assert(!"Unexpected user data!");
 	return;
@@ -532,6 +646,30 @@ static void dns_callback(void *user_data,
 	    return;
 	}
 
+    } else if (query_job->dns_state == PJ_DNS_TYPE_A &&
+	       common->type == PJ_DNS_TYPE_AAAA)
+    {
+	/* Clear the outstanding job */
+	srv->q_aaaa = NULL;
+
+	if (status==PJ_SUCCESS && pkt->hdr.anscount != 0) {
+	    save_aaaa_response(query_job, srv, pkt);
+
+	} else if (status != PJ_SUCCESS) {
+	    char errmsg[PJ_ERR_MSG_SIZE];
+
+	    /* Only update last error if there's no address at all */
+	    if (srv->addr_cnt == 0)
+		query_job->last_error = status;
+
+	    pj_strerror(status, errmsg, sizeof(errmsg));
+	    PJ_LOG(5,(query_job->objname, 
+		      "DNS AAAA record resolution failed: %s", errmsg));
+	}
+
+	if (--srv->pending == 0)
+	    ++query_job->host_resolved;
+
     } else if (query_job->dns_state == PJ_DNS_TYPE_A) {
 
 	/* Clear the outstanding job */
@@ -543,10 +681,15 @@ static void dns_callback(void *user_data,
 
 	    /* Parse response */
 	    status = pj_dns_parse_a_response(pkt, &rec);
-	    if (status != PJ_SUCCESS)
-		goto on_error;
-
-	    pj_assert(rec.addr_count != 0);
+	    if (status != PJ_SUCCESS) {
+		/* Only fail when there's no AAAA result to use */
+		if (srv->q_aaaa == NULL && srv->addr6_cnt == 0)
+		    goto on_error;
+
+		query_job->last_error = status;
+		rec.addr_count = 0;
+		rec.alias.slen = 0;
+	    }
 
 	    /* Update CNAME alias, if present. */
 	    if (rec.alias.slen) {
@@ -558,7 +701,7 @@ static void dns_callback(void *user_data,
 	    }
 
 	    /* Update IP address of the corresponding hostname or CNAME */
-	    if (srv->addr_cnt < ADDR_MAX_COUNT) {
+	    if (rec.addr_count != 0 && srv->addr_cnt < ADDR_MAX_COUNT) {
 		srv->addr[srv->addr_cnt++].s_addr = rec.addr[0].s_addr;
 
 		PJ_LOG(5,(query_job->objname, 
@@ -584,7 +727,8 @@ static void dns_callback(void *user_data,
 	    char errmsg[PJ_ERR_MSG_SIZE];
 
 	    /* Update last error */
-	    query_job->last_error = status;
+	    if (srv->addr6_cnt == 0)
+		query_job->last_error = status;
 
 	    /* Log error */
 	    pj_strerror(status, errmsg, sizeof(errmsg));
@@ -592,7 +736,8 @@ static void dns_callback(void *user_data,
 		      errmsg));
 	}
 
-	++query_job->host_resolved;
+	if (--srv->pending == 0)
+	    ++query_job->host_resolved;
 
     } else {
 	pj_assert(!"Unexpected state!");
@@ -626,7 +771,12 @@ static void dns_callback(void *user_data,
 		++srv_rec.entry[srv_rec.count].server.addr_count;
 	    }
 
-	    if (srv->addr_cnt > 0) {
+	    srv_rec.entry[srv_rec.count].addr6_count = srv->addr6_cnt;
+	    for (j=0; j<srv->addr6_cnt; ++j) {
+		srv_rec.entry[srv_rec.count].addr6[j] = srv->addr6[j];
+	    }
+
+	    if (srv->addr_cnt > 0 || srv->addr6_cnt > 0) {
 		++srv_rec.count;
 		if (srv_rec.count == PJ_DNS_SRV_MAX_ADDR)
 		    break;
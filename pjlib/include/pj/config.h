@@ -858,6 +858,20 @@
 #endif
 
 
+/**
+ * Number of worker threads used by secure sockets to run the handshake
+ * crypto off the ioqueue polling threads, when the secure socket enables
+ * asynchronous handshake (see \a async_handshake field of
+ * #pj_ssl_sock_param). The worker threads are shared by all secure
+ * sockets and are only started when the first such socket is created.
+ *
+ * Default: 2
+ */
+#ifndef PJ_SSL_SOCK_HANDSHAKE_THREAD_CNT
+#  define PJ_SSL_SOCK_HANDSHAKE_THREAD_CNT    2
+#endif
+
+
 /**
  * Disable WSAECONNRESET error for UDP sockets on Win32 platforms. See
  * https://trac.pjsip.org/repos/ticket/1197.
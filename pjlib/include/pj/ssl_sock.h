@@ -749,6 +749,23 @@ typedef struct pj_ssl_sock_param
      */
     pj_bool_t qos_ignore_error;
 
+    /**
+     * Specify whether the handshake crypto (key exchange, signature and
+     * certificate verification) should be performed by the secure socket
+     * handshake worker threads instead of the ioqueue thread that delivers
+     * the handshake data. When enabled, the ioqueue thread only queues the
+     * handshake step and is free to serve other sockets, and the handshake
+     * result is reported back via the timer heap, so the \a timer_heap
+     * field must be set and polled by the same threads that poll the
+     * ioqueue. The number of worker threads is configured by
+     * #PJ_SSL_SOCK_HANDSHAKE_THREAD_CNT.
+     *
+     * This setting is ignored when the timer heap is not specified, when
+     * threading is disabled, or when the backend does not support it.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t async_handshake;
 
 } pj_ssl_sock_param;
 
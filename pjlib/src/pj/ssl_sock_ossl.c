@@ -27,6 +27,7 @@
 #include <pj/math.h>
 #include <pj/os.h>
 #include <pj/pool.h>
+#include <pj/pool_buf.h>
 #include <pj/string.h>
 #include <pj/timer.h>
 
@@ -51,6 +52,12 @@
 #include <openssl/x509v3.h>
 
 
+/* SSL_CIPHER is opaque since OpenSSL 1.1.0 */
+#if OPENSSL_VERSION_NUMBER < 0x10001000L
+#  define SSL_CIPHER_get_id(c)	((c)->id)
+#endif
+
+
 #ifdef _MSC_VER
 #  pragma comment( lib, "libeay32")
 #  pragma comment( lib, "ssleay32")
@@ -76,6 +83,40 @@ enum timer_id
     TIMER_CLOSE
 };
 
+/*
+ * Asynchronous handshake job states.
+ */
+enum hs_job_state
+{
+    HS_JOB_IDLE,	/* No handshake step outstanding.		    */
+    HS_JOB_QUEUED,	/* Waiting in the queue for a worker thread.	    */
+    HS_JOB_RUNNING,	/* A worker thread is running the handshake step.   */
+    HS_JOB_DONE		/* Result is waiting to be picked up by the timer.  */
+};
+
+/*
+ * Structure of asynchronous handshake job. Each SSL socket has one job,
+ * which is queued to the handshake worker threads whenever the handshake
+ * needs to make progress, see queue_handshake().
+ */
+typedef struct hs_job_t
+{
+    PJ_DECL_LIST_MEMBER(struct hs_job_t);
+    pj_ssl_sock_t	 *ssock;
+    enum hs_job_state	  state;
+    pj_bool_t		  active;   /* asynchronous handshake in progress   */
+    pj_bool_t		  rerun;    /* new data arrived while running	    */
+    pj_bool_t		  waiting;  /* cancel_handshake_job() is waiting   */
+    pj_bool_t		  closing;  /* socket closed, destroy on last ref   */
+    unsigned		  ref;	    /* held by queued job and result timer  */
+    pj_mutex_t		 *lock;	    /* serializes SSL instance access of
+				       handshake step and its completion   */
+    BIO			 *rx_bio;   /* incoming data queued while active    */
+    pj_sem_t		 *done_sem; /* posted when a waited job finishes   */
+    pj_status_t		  status;   /* result of the last handshake step    */
+    pj_timer_entry	  timer;    /* to resume on the polling thread	    */
+} hs_job_t;
+
 /*
  * Structure of SSL socket read buffer.
  */
@@ -167,6 +208,9 @@ struct pj_ssl_sock_t
     write_data_t	  send_pending;	/* list of pending write to network */
     pj_lock_t		 *write_mutex;	/* protect write BIO and send_buf   */
 
+    pj_bool_t		  async_hs;	/* handshake runs on worker threads */
+    hs_job_t		  hs_job;
+
     SSL_CTX		 *ossl_ctx;
     SSL			 *ossl_ssl;
     BIO			 *ossl_rbio;
@@ -189,6 +233,19 @@ struct pj_ssl_cert_t
 static write_data_t* alloc_send_data(pj_ssl_sock_t *ssock, pj_size_t len);
 static void free_send_data(pj_ssl_sock_t *ssock, write_data_t *wdata);
 static pj_status_t flush_delayed_send(pj_ssl_sock_t *ssock);
+static pj_status_t handshake_step(pj_ssl_sock_t *ssock);
+static pj_status_t flush_write_bio(pj_ssl_sock_t *ssock,
+				   pj_ioqueue_op_key_t *send_key,
+				   pj_size_t orig_len,
+				   unsigned flags);
+static void ssl_sock_destroy(pj_ssl_sock_t *ssock);
+static pj_bool_t asock_on_data_read(pj_activesock_t *asock,
+				    void *data,
+				    pj_size_t size,
+				    pj_status_t status,
+				    pj_size_t *remainder);
+static pj_bool_t on_handshake_complete(pj_ssl_sock_t *ssock, 
+				       pj_status_t status);
 
 /*
  *******************************************************************
@@ -346,7 +403,7 @@ static pj_status_t init_openssl(void)
 	    SSL_CIPHER *c;
 	    c = sk_SSL_CIPHER_value(sk_cipher,i);
 	    openssl_ciphers[i].id = (pj_ssl_cipher)
-				    (pj_uint32_t)c->id & 0x00FFFFFF;
+				    (pj_uint32_t)SSL_CIPHER_get_id(c) & 0x00FFFFFF;
 	    openssl_ciphers[i].name = SSL_CIPHER_get_name(c);
 	}
 
@@ -370,6 +427,551 @@ static void shutdown_openssl(void)
 }
 
 
+/*
+ *******************************************************************
+ * Asynchronous handshake worker threads.
+ *******************************************************************
+ */
+
+#if defined(PJ_HAS_THREADS) && PJ_HAS_THREADS!=0 && \
+    PJ_SSL_SOCK_HANDSHAKE_THREAD_CNT > 0
+
+/* Handshake worker threads, shared by all SSL sockets that enable
+ * asynchronous handshake. The workers only run the handshake crypto,
+ * everything else (flushing the write BIO, state changes and callbacks)
+ * is resumed on the thread polling the timer heap of the SSL socket.
+ */
+static struct hs_workers_t
+{
+    pj_pool_t		 *pool;
+    pj_mutex_t		 *mutex;    /* protects the queue and job states   */
+    pj_sem_t		 *sem;
+    pj_bool_t		  quit;
+    unsigned		  thread_cnt;
+    pj_thread_t		 *thread[PJ_SSL_SOCK_HANDSHAKE_THREAD_CNT];
+    hs_job_t		  queue;
+    char		  pool_buf[1024 + 512*PJ_SSL_SOCK_HANDSHAKE_THREAD_CNT];
+} hs_workers;
+
+
+/* Move the data queued by queue_handshake_data() to the read BIO of the
+ * SSL instance. Must be called with the handshake workers mutex held, by
+ * the owner of the handshake lock.
+ */
+static void move_handshake_data(hs_job_t *job)
+{
+    char *data;
+    long len;
+
+    len = BIO_get_mem_data(job->rx_bio, &data);
+    if (len > 0) {
+	BIO_write(job->ssock->ossl_rbio, data, (int)len);
+	(void)BIO_reset(job->rx_bio);
+    }
+}
+
+
+/* Release a reference of the handshake job, and destroy the socket if it
+ * has been closed meanwhile.
+ */
+static void release_handshake_job(pj_ssl_sock_t *ssock)
+{
+    hs_job_t *job = &ssock->hs_job;
+    pj_bool_t destroy;
+
+    pj_mutex_lock(hs_workers.mutex);
+    pj_assert(job->ref > 0);
+    destroy = (--job->ref == 0 && job->closing);
+    pj_mutex_unlock(hs_workers.mutex);
+
+    if (destroy)
+	ssl_sock_destroy(ssock);
+}
+
+
+static int hs_worker_thread(void *arg)
+{
+    PJ_UNUSED_ARG(arg);
+
+    for (;;) {
+	hs_job_t *job;
+	pj_ssl_sock_t *ssock;
+	pj_status_t status;
+	pj_bool_t rerun;
+
+	pj_sem_wait(hs_workers.sem);
+
+	pj_mutex_lock(hs_workers.mutex);
+	if (hs_workers.quit) {
+	    pj_mutex_unlock(hs_workers.mutex);
+	    break;
+	}
+	if (pj_list_empty(&hs_workers.queue)) {
+	    /* Job has been cancelled */
+	    pj_mutex_unlock(hs_workers.mutex);
+	    continue;
+	}
+	job = hs_workers.queue.next;
+	pj_list_erase(job);
+	job->state = HS_JOB_RUNNING;
+	job->rerun = PJ_FALSE;
+	ssock = job->ssock;
+	pj_mutex_unlock(hs_workers.mutex);
+
+	do {
+	    pj_bool_t active, release = PJ_FALSE;
+
+	    /* Only the handshake lock is held while running the step, the
+	     * ioqueue threads queue incoming data to the job meanwhile.
+	     */
+	    pj_mutex_lock(job->lock);
+	    pj_mutex_lock(hs_workers.mutex);
+	    active = job->active;
+	    if (active)
+		move_handshake_data(job);
+	    pj_mutex_unlock(hs_workers.mutex);
+
+	    /* Handshake may have been completed while the job was waiting
+	     * for the lock, the SSL instance then belongs to the socket.
+	     */
+	    status = active? handshake_step(ssock) : PJ_EPENDING;
+	    pj_mutex_unlock(job->lock);
+
+	    pj_mutex_lock(hs_workers.mutex);
+
+	    /* More handshake data may have arrived while we were busy,
+	     * unless the job is being cancelled.
+	     */
+	    rerun = (active && job->rerun && status == PJ_EPENDING &&
+		     !job->waiting);
+	    job->rerun = PJ_FALSE;
+
+	    if (!rerun) {
+		job->status = status;
+		job->state = HS_JOB_DONE;
+
+		/* Wake up cancel_handshake_job(), which takes over the
+		 * reference and also cancels the timer below. The job must
+		 * not be touched afterwards.
+		 */
+		if (job->waiting) {
+		    job->waiting = PJ_FALSE;
+		    pj_sem_post(job->done_sem);
+		    pj_mutex_unlock(hs_workers.mutex);
+		    break;
+		}
+
+		/* Resume on the polling thread, the reference is passed to
+		 * the timer, unless the timer of the previous result hasn't
+		 * been picked up yet (it holds its own reference).
+		 */
+		if (active && job->timer.id == 0) {
+		    pj_time_val delay = {0, 0};
+
+		    job->timer.id = 1;
+		    if (pj_timer_heap_schedule(ssock->param.timer_heap,
+					       &job->timer, &delay) != 0)
+		    {
+			job->timer.id = 0;
+			release = PJ_TRUE;
+			PJ_LOG(1,(ssock->pool->obj_name,
+				  "Failed to schedule handshake result"));
+		    }
+		} else {
+		    release = PJ_TRUE;
+		}
+	    }
+
+	    pj_mutex_unlock(hs_workers.mutex);
+
+	    if (release)
+		release_handshake_job(ssock);
+	} while (rerun);
+    }
+
+    return 0;
+}
+
+
+/* Stop handshake worker threads, called by pj_shutdown() */
+static void hs_workers_shutdown(void)
+{
+    unsigned i;
+
+    if (hs_workers.pool == NULL)
+	return;
+
+    pj_mutex_lock(hs_workers.mutex);
+    hs_workers.quit = PJ_TRUE;
+    pj_mutex_unlock(hs_workers.mutex);
+
+    for (i = 0; i < hs_workers.thread_cnt; ++i)
+	pj_sem_post(hs_workers.sem);
+
+    for (i = 0; i < hs_workers.thread_cnt; ++i) {
+	pj_thread_join(hs_workers.thread[i]);
+	pj_thread_destroy(hs_workers.thread[i]);
+	hs_workers.thread[i] = NULL;
+    }
+    hs_workers.thread_cnt = 0;
+
+    pj_sem_destroy(hs_workers.sem);
+    pj_mutex_destroy(hs_workers.mutex);
+    pj_pool_release(hs_workers.pool);
+    hs_workers.pool = NULL;
+}
+
+
+/* Start handshake worker threads, if they are not started yet. Must be
+ * called inside the pjlib critical section, as several sockets may be
+ * created at the same time.
+ */
+static pj_status_t hs_workers_start(void)
+{
+    unsigned i;
+    pj_status_t status;
+
+    if (hs_workers.pool)
+	return PJ_SUCCESS;
+
+    /* The workers live until pj_shutdown(), so the pool must not depend
+     * on any pool factory owned by application.
+     */
+    hs_workers.pool = pj_pool_create_on_buf("sslhs", hs_workers.pool_buf,
+					    sizeof(hs_workers.pool_buf));
+    if (!hs_workers.pool)
+	return PJ_ENOMEM;
+
+    hs_workers.quit = PJ_FALSE;
+    pj_list_init(&hs_workers.queue);
+
+    status = pj_mutex_create_simple(hs_workers.pool, "sslhs",
+				    &hs_workers.mutex);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    status = pj_sem_create(hs_workers.pool, "sslhs", 0,
+			   PJ_SSL_SOCK_HANDSHAKE_THREAD_CNT * 1024,
+			   &hs_workers.sem);
+    if (status != PJ_SUCCESS) {
+	pj_mutex_destroy(hs_workers.mutex);
+	goto on_error;
+    }
+
+    for (i = 0; i < PJ_SSL_SOCK_HANDSHAKE_THREAD_CNT; ++i) {
+	status = pj_thread_create(hs_workers.pool, "sslhs%p",
+				  &hs_worker_thread, NULL, 0, 0,
+				  &hs_workers.thread[i]);
+	if (status != PJ_SUCCESS) {
+	    hs_workers_shutdown();
+	    return status;
+	}
+	++hs_workers.thread_cnt;
+    }
+
+    pj_atexit(&hs_workers_shutdown);
+    return PJ_SUCCESS;
+
+on_error:
+    pj_pool_release(hs_workers.pool);
+    hs_workers.pool = NULL;
+    return status;
+}
+
+
+/* Start the handshake worker threads and prepare the job of the socket */
+static pj_status_t hs_workers_init(pj_ssl_sock_t *ssock)
+{
+    hs_job_t *job = &ssock->hs_job;
+    pj_status_t status;
+
+    status = pj_sem_create(ssock->pool, ssock->pool->obj_name, 0, 1,
+			   &job->done_sem);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    status = pj_mutex_create_simple(ssock->pool, ssock->pool->obj_name,
+				    &job->lock);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    job->rx_bio = BIO_new(BIO_s_mem());
+    if (job->rx_bio == NULL) {
+	status = PJ_ENOMEM;
+	goto on_error;
+    }
+
+    pj_enter_critical_section();
+    status = hs_workers_start();
+    pj_leave_critical_section();
+
+    if (status == PJ_SUCCESS)
+	return PJ_SUCCESS;
+
+on_error:
+    if (job->rx_bio) {
+	BIO_free(job->rx_bio);
+	job->rx_bio = NULL;
+    }
+    if (job->lock) {
+	pj_mutex_destroy(job->lock);
+	job->lock = NULL;
+    }
+    pj_sem_destroy(job->done_sem);
+    job->done_sem = NULL;
+    return status;
+}
+
+
+/* Timer callback to resume the handshake on the polling thread */
+static void on_handshake_job_done(pj_timer_heap_t *th, pj_timer_entry *te)
+{
+    pj_ssl_sock_t *ssock = (pj_ssl_sock_t*)te->user_data;
+    hs_job_t *job = &ssock->hs_job;
+    pj_status_t status = PJ_EPENDING;
+    pj_bool_t closing;
+
+    PJ_UNUSED_ARG(th);
+
+    pj_mutex_lock(hs_workers.mutex);
+    te->id = 0;
+    if (job->state == HS_JOB_DONE) {
+	job->state = HS_JOB_IDLE;
+	status = job->status;
+    }
+    closing = job->closing;
+    pj_mutex_unlock(hs_workers.mutex);
+
+    /* If the handshake lock is busy, a worker thread is running another
+     * step, it will reschedule this timer once done. Never wait for it,
+     * this may well be an ioqueue polling thread.
+     */
+    if (!closing && ssock->ssl_state == SSL_STATE_HANDSHAKING &&
+	pj_mutex_trylock(job->lock) == PJ_SUCCESS)
+    {
+	pj_status_t flush_status;
+
+	/* Flush whatever handshake data has been generated so far */
+	flush_status = flush_write_bio(ssock, &ssock->handshake_op_key, 0, 0);
+	if (flush_status != PJ_SUCCESS && flush_status != PJ_EPENDING)
+	    status = flush_status;
+
+	/* Once completed, incoming data goes to the SSL instance again */
+	if (status != PJ_EPENDING) {
+	    pj_mutex_lock(hs_workers.mutex);
+	    if (job->state == HS_JOB_QUEUED) {
+		pj_list_erase(job);
+		job->state = HS_JOB_IDLE;
+		--job->ref;
+	    }
+	    move_handshake_data(job);
+	    job->active = PJ_FALSE;
+	    pj_mutex_unlock(hs_workers.mutex);
+	}
+
+	if (status == PJ_SUCCESS)
+	    ssock->ssl_state = SSL_STATE_ESTABLISHED;
+
+	pj_mutex_unlock(job->lock);
+
+	if (status != PJ_EPENDING && on_handshake_complete(ssock, status) &&
+	    ssock->ssl_state == SSL_STATE_ESTABLISHED && ssock->read_started)
+	{
+	    pj_bool_t pending;
+
+	    /* Application data may have arrived along with the last
+	     * handshake message, the ioqueue won't signal it again.
+	     */
+	    pj_lock_acquire(ssock->write_mutex);
+	    pending = (BIO_pending(ssock->ossl_rbio) > 0 ||
+		       SSL_pending(ssock->ossl_ssl) > 0);
+	    pj_lock_release(ssock->write_mutex);
+
+	    if (pending) {
+		pj_size_t remainder = 0;
+
+		/* Don't let stale errors fail the SSL_read() */
+		ERR_clear_error();
+		asock_on_data_read(ssock->asock, ssock->asock_rbuf[0], 0,
+				   PJ_SUCCESS, &remainder);
+	    }
+	}
+    }
+
+    /* Release the reference held by this timer */
+    release_handshake_job(ssock);
+}
+
+
+/* Queue a handshake step to the worker threads */
+static pj_status_t queue_handshake(pj_ssl_sock_t *ssock)
+{
+    hs_job_t *job = &ssock->hs_job;
+
+    pj_mutex_lock(hs_workers.mutex);
+    if (!job->active) {
+	/* Handshake has just been completed by on_handshake_job_done() */
+	pj_mutex_unlock(hs_workers.mutex);
+	return PJ_EPENDING;
+    }
+
+    switch (job->state) {
+    case HS_JOB_IDLE:
+    case HS_JOB_DONE:
+	/* The queued job holds a reference until its result is picked
+	 * up, or the job is cancelled.
+	 */
+	++job->ref;
+	job->state = HS_JOB_QUEUED;
+	pj_list_push_back(&hs_workers.queue, job);
+	pj_sem_post(hs_workers.sem);
+	break;
+    case HS_JOB_RUNNING:
+	job->rerun = PJ_TRUE;
+	break;
+    case HS_JOB_QUEUED:
+	break;
+    }
+    pj_mutex_unlock(hs_workers.mutex);
+
+    return PJ_EPENDING;
+}
+
+
+/* Queue incoming data to the job while the asynchronous handshake is in
+ * progress, so the ioqueue thread never waits for a worker thread running
+ * the handshake on the SSL instance. Returns PJ_FALSE if the data should
+ * be written to the read BIO directly.
+ */
+static pj_bool_t queue_handshake_data(pj_ssl_sock_t *ssock,
+				      const void *data,
+				      pj_size_t size,
+				      pj_size_t *nwritten)
+{
+    hs_job_t *job = &ssock->hs_job;
+    pj_bool_t queued = PJ_FALSE;
+
+    if (!ssock->async_hs)
+	return PJ_FALSE;
+
+    pj_mutex_lock(hs_workers.mutex);
+    if (job->active) {
+	*nwritten = BIO_write(job->rx_bio, data, (int)size);
+	queued = PJ_TRUE;
+    }
+    pj_mutex_unlock(hs_workers.mutex);
+
+    return queued;
+}
+
+
+/* Cancel any outstanding handshake job, waiting for the worker thread
+ * if it is currently running the job.
+ */
+static void cancel_handshake_job(pj_ssl_sock_t *ssock)
+{
+    hs_job_t *job = &ssock->hs_job;
+
+    if (!ssock->async_hs)
+	return;
+
+    pj_mutex_lock(hs_workers.mutex);
+    if (job->state == HS_JOB_QUEUED) {
+	pj_list_erase(job);
+	--job->ref;
+    }
+
+    if (job->state == HS_JOB_RUNNING) {
+	job->waiting = PJ_TRUE;
+	pj_mutex_unlock(hs_workers.mutex);
+	pj_sem_wait(job->done_sem);
+	pj_mutex_lock(hs_workers.mutex);
+	--job->ref;
+    }
+
+    /* A timer callback already in progress keeps its reference */
+    if (job->timer.id != 0) {
+	if (pj_timer_heap_cancel(ssock->param.timer_heap, &job->timer) > 0)
+	    --job->ref;
+	job->timer.id = 0;
+    }
+    job->state = HS_JOB_IDLE;
+    job->active = PJ_FALSE;
+    job->rerun = PJ_FALSE;
+    (void)BIO_reset(job->rx_bio);
+    pj_mutex_unlock(hs_workers.mutex);
+
+    /* Make sure on_handshake_job_done() has got off the SSL instance */
+    pj_mutex_lock(job->lock);
+    pj_mutex_unlock(job->lock);
+}
+
+
+/* Defer destroying the socket while the handshake job is still referenced,
+ * release_handshake_job() will destroy it.
+ */
+static pj_bool_t defer_destroy(pj_ssl_sock_t *ssock)
+{
+    hs_job_t *job = &ssock->hs_job;
+    pj_bool_t deferred;
+
+    if (!ssock->async_hs)
+	return PJ_FALSE;
+
+    pj_mutex_lock(hs_workers.mutex);
+    deferred = (job->ref > 0);
+    job->closing = deferred;
+    pj_mutex_unlock(hs_workers.mutex);
+
+    return deferred;
+}
+
+#else	/* PJ_HAS_THREADS */
+
+static pj_status_t hs_workers_init(pj_ssl_sock_t *ssock)
+{
+    PJ_UNUSED_ARG(ssock);
+    return PJ_ENOTSUP;
+}
+
+static void on_handshake_job_done(pj_timer_heap_t *th, pj_timer_entry *te)
+{
+    PJ_UNUSED_ARG(th);
+    PJ_UNUSED_ARG(te);
+}
+
+static pj_status_t queue_handshake(pj_ssl_sock_t *ssock)
+{
+    PJ_UNUSED_ARG(ssock);
+    return PJ_ENOTSUP;
+}
+
+static pj_bool_t queue_handshake_data(pj_ssl_sock_t *ssock,
+				      const void *data,
+				      pj_size_t size,
+				      pj_size_t *nwritten)
+{
+    PJ_UNUSED_ARG(ssock);
+    PJ_UNUSED_ARG(data);
+    PJ_UNUSED_ARG(size);
+    PJ_UNUSED_ARG(nwritten);
+    return PJ_FALSE;
+}
+
+static void cancel_handshake_job(pj_ssl_sock_t *ssock)
+{
+    PJ_UNUSED_ARG(ssock);
+}
+
+static pj_bool_t defer_destroy(pj_ssl_sock_t *ssock)
+{
+    PJ_UNUSED_ARG(ssock);
+    return PJ_FALSE;
+}
+
+#endif	/* PJ_HAS_THREADS */
+
+
 /* SSL password callback. */
 static int password_cb(char *buf, int num, int rwflag, void *user_data)
 {
@@ -684,6 +1286,9 @@ static void destroy_ssl(pj_ssl_sock_t *ssock)
 /* Reset SSL socket state */
 static void reset_ssl_sock_state(pj_ssl_sock_t *ssock)
 {
+    /* Make sure no worker thread is touching the SSL instance */
+    cancel_handshake_job(ssock);
+
     ssock->ssl_state = SSL_STATE_NULL;
 
     destroy_ssl(ssock);
@@ -732,7 +1337,7 @@ static pj_status_t set_cipher_list(pj_ssl_sock_t *ssock)
 	    SSL_CIPHER *c;
 	    c = sk_SSL_CIPHER_value(sk_cipher, j);
 	    if (ssock->param.ciphers[i] == (pj_ssl_cipher)
-					   ((pj_uint32_t)c->id & 0x00FFFFFF))
+				((pj_uint32_t)SSL_CIPHER_get_id(c) & 0x00FFFFFF))
 	    {
 		const char *c_name;
 
@@ -1370,42 +1975,71 @@ static void on_timer(pj_timer_heap_t *th, struct pj_timer_entry *te)
 }
 
 
-/* Asynchronouse handshake */
-static pj_status_t do_handshake(pj_ssl_sock_t *ssock)
+/* Perform one SSL handshake step. This may be called by handshake worker
+ * thread, so it must not touch anything but the SSL instance. Note that
+ * SSL_get_error() inspects the error queue of the calling thread, so the
+ * result must be evaluated here too. Caller must serialize access to the
+ * SSL instance, i.e: hold the write mutex, or the handshake lock of the
+ * job while asynchronous handshake is in progress.
+ */
+static pj_status_t handshake_step(pj_ssl_sock_t *ssock)
 {
-    pj_status_t status;
+    pj_status_t status = PJ_EPENDING;
     int err;
 
-    /* Perform SSL handshake */
-    pj_lock_acquire(ssock->write_mutex);
     err = SSL_do_handshake(ssock->ossl_ssl);
-    pj_lock_release(ssock->write_mutex);
-
-    /* SSL_do_handshake() may put some pending data into SSL write BIO, 
-     * flush it if any.
-     */
-    status = flush_write_bio(ssock, &ssock->handshake_op_key, 0, 0);
-    if (status != PJ_SUCCESS && status != PJ_EPENDING) {
-	return status;
-    }
-
     if (err < 0) {
 	err = SSL_get_error(ssock->ossl_ssl, err);
 	if (err != SSL_ERROR_NONE && err != SSL_ERROR_WANT_READ) 
 	{
 	    /* Handshake fails */
 	    status = STATUS_FROM_SSL_ERR(ssock, err);
-	    return status;
 	}
     }
 
     /* Check if handshake has been completed */
-    if (SSL_is_init_finished(ssock->ossl_ssl)) {
-	ssock->ssl_state = SSL_STATE_ESTABLISHED;
-	return PJ_SUCCESS;
+    if (status == PJ_EPENDING && SSL_is_init_finished(ssock->ossl_ssl))
+	status = PJ_SUCCESS;
+
+    return status;
+}
+
+
+/* Complete SSL handshake step with the specified result */
+static pj_status_t finish_handshake_step(pj_ssl_sock_t *ssock,
+					 pj_status_t status)
+{
+    pj_status_t flush_status;
+
+    /* SSL_do_handshake() may put some pending data into SSL write BIO, 
+     * flush it if any.
+     */
+    flush_status = flush_write_bio(ssock, &ssock->handshake_op_key, 0, 0);
+    if (flush_status != PJ_SUCCESS && flush_status != PJ_EPENDING) {
+	return flush_status;
     }
 
-    return PJ_EPENDING;
+    if (status == PJ_SUCCESS)
+	ssock->ssl_state = SSL_STATE_ESTABLISHED;
+
+    return status;
+}
+
+
+/* Asynchronouse handshake */
+static pj_status_t do_handshake(pj_ssl_sock_t *ssock)
+{
+    pj_status_t status;
+
+    /* Offload the initial handshake crypto to the worker threads */
+    if (ssock->async_hs && ssock->ssl_state == SSL_STATE_HANDSHAKING)
+	return queue_handshake(ssock);
+
+    pj_lock_acquire(ssock->write_mutex);
+    status = handshake_step(ssock);
+    pj_lock_release(ssock->write_mutex);
+
+    return finish_handshake_step(ssock, status);
 }
 
 
@@ -1427,8 +2061,15 @@ static pj_bool_t asock_on_data_read (pj_activesock_t *asock,
 
     /* Socket error or closed */
     if (data && size > 0) {
-	/* Consume the whole data */
-	nwritten = BIO_write(ssock->ossl_rbio, data, (int)size);
+	/* Consume the whole data. While asynchronous handshake is running,
+	 * the data is queued to the handshake job instead, otherwise let's
+	 * protect the read BIO with write mutex.
+	 */
+	if (!queue_handshake_data(ssock, data, size, &nwritten)) {
+	    pj_lock_acquire(ssock->write_mutex);
+	    nwritten = BIO_write(ssock->ossl_rbio, data, (int)size);
+	    pj_lock_release(ssock->write_mutex);
+	}
 	if (nwritten < size) {
 	    status = GET_SSL_STATUS(ssock);
 	    goto on_error;
@@ -1734,6 +2375,7 @@ static pj_bool_t asock_on_accept_complete (pj_activesock_t *asock,
 
     /* Start SSL handshake */
     ssock->ssl_state = SSL_STATE_HANDSHAKING;
+    ssock->hs_job.active = ssock->async_hs;
     SSL_set_accept_state(ssock->ossl_ssl);
     status = do_handshake(ssock);
 
@@ -1816,6 +2458,7 @@ static pj_bool_t asock_on_connect_complete (pj_activesock_t *asock,
 
     /* Start SSL handshake */
     ssock->ssl_state = SSL_STATE_HANDSHAKING;
+    ssock->hs_job.active = ssock->async_hs;
     SSL_set_connect_state(ssock->ossl_ssl);
 
     status = do_handshake(ssock);
@@ -1991,6 +2634,9 @@ PJ_DEF(pj_status_t) pj_ssl_sock_create (pj_pool_t *pool,
     pj_timer_entry_init(&ssock->timer, 0, ssock, &on_timer);
     pj_ioqueue_op_key_init(&ssock->handshake_op_key,
 			   sizeof(pj_ioqueue_op_key_t));
+    ssock->hs_job.ssock = ssock;
+    pj_timer_entry_init(&ssock->hs_job.timer, 0, ssock,
+			&on_handshake_job_done);
 
     /* Create secure socket mutex */
     status = pj_lock_create_recursive_mutex(pool, pool->obj_name,
@@ -2014,6 +2660,18 @@ PJ_DEF(pj_status_t) pj_ssl_sock_create (pj_pool_t *pool,
     pj_strdup_with_null(pool, &ssock->param.server_name, 
 			&param->server_name);
 
+    /* Asynchronous handshake requires the timer heap to resume the
+     * handshake on the polling thread.
+     */
+    if (param->async_handshake && param->timer_heap) {
+	if (hs_workers_init(ssock) == PJ_SUCCESS) {
+	    ssock->async_hs = PJ_TRUE;
+	} else {
+	    PJ_LOG(4,(pool->obj_name, "Asynchronous handshake is not "
+		      "available, handshake will be done synchronously"));
+	}
+    }
+
     /* Finally */
     *p_ssock = ssock;
 
@@ -2027,11 +2685,9 @@ PJ_DEF(pj_status_t) pj_ssl_sock_create (pj_pool_t *pool,
  */
 PJ_DEF(pj_status_t) pj_ssl_sock_close(pj_ssl_sock_t *ssock)
 {
-    pj_pool_t *pool;
-
     PJ_ASSERT_RETURN(ssock, PJ_EINVAL);
 
-    if (!ssock->pool)
+    if (!ssock->pool || ssock->hs_job.closing)
 	return PJ_SUCCESS;
 
     if (ssock->timer.id != TIMER_NONE) {
@@ -2040,14 +2696,34 @@ PJ_DEF(pj_status_t) pj_ssl_sock_close(pj_ssl_sock_t *ssock)
     }
 
     reset_ssl_sock_state(ssock);
+
+    /* The handshake result timer may be running, it will destroy the
+     * socket when it is done.
+     */
+    if (!defer_destroy(ssock))
+	ssl_sock_destroy(ssock);
+
+    return PJ_SUCCESS;
+}
+
+
+/* Release the resources of the closed secure socket */
+static void ssl_sock_destroy(pj_ssl_sock_t *ssock)
+{
+    pj_pool_t *pool;
+
     pj_lock_destroy(ssock->write_mutex);
+    if (ssock->hs_job.done_sem)
+	pj_sem_destroy(ssock->hs_job.done_sem);
+    if (ssock->hs_job.lock)
+	pj_mutex_destroy(ssock->hs_job.lock);
+    if (ssock->hs_job.rx_bio)
+	BIO_free(ssock->hs_job.rx_bio);
     
     pool = ssock->pool;
     ssock->pool = NULL;
     if (pool)
 	pj_pool_release(pool);
-
-    return PJ_SUCCESS;
 }
 
 
@@ -2098,7 +2774,7 @@ PJ_DEF(pj_status_t) pj_ssl_sock_get_info (pj_ssl_sock_t *ssock,
 
 	/* Current cipher */
 	cipher = SSL_get_current_cipher(ssock->ossl_ssl);
-	info->cipher = (cipher->id & 0x00FFFFFF);
+	info->cipher = (SSL_CIPHER_get_id(cipher) & 0x00FFFFFF);
 
 	/* Remote address */
 	pj_sockaddr_cp(&info->remote_addr, &ssock->rem_addr);
@@ -31,6 +31,7 @@
 #include <pjmedia/clock.h>
 #include <pjmedia/codec.h>
 #include <pjmedia/conference.h>
+#include <pjmedia/conf_group.h>
 #include <pjmedia/converter.h>
 #include <pjmedia/delaybuf.h>
 #include <pjmedia/echo.h>
@@ -39,11 +40,13 @@
 #include <pjmedia/errno.h>
 #include <pjmedia/event.h>
 #include <pjmedia/frame.h>
+#include <pjmedia/frame_pool.h>
 #include <pjmedia/format.h>
 #include <pjmedia/g711.h>
 #include <pjmedia/jbuf.h>
 #include <pjmedia/master_port.h>
 #include <pjmedia/mem_port.h>
+#include <pjmedia/mixer.h>
 #include <pjmedia/null_port.h>
 #include <pjmedia/plc.h>
 #include <pjmedia/port.h>
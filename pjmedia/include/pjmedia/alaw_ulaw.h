@@ -140,21 +140,18 @@ PJ_DECL(unsigned char) pjmedia_ulaw2alaw(unsigned char uval);
 #endif
 
 /**
- * Encode 16-bit linear PCM data to 8-bit U-Law data.
+ * Encode 16-bit linear PCM data to 8-bit U-Law data. This and the other
+ * block conversion functions below use SSE2, AVX2 or NEON instructions
+ * when #PJMEDIA_HAS_SIMD and #PJMEDIA_HAS_ALAW_ULAW_TABLE are enabled,
+ * following the implementation selected with pjmedia_mix_set_impl().
+ * The results are the same as the sample conversion macros above.
  *
  * @param dst	    Destination buffer for 8-bit U-Law data.
  * @param src	    Source, 16-bit linear PCM data.
  * @param count	    Number of samples.
  */
-PJ_INLINE(void) pjmedia_ulaw_encode(pj_uint8_t *dst, const pj_int16_t *src, 
-				    pj_size_t count)
-{
-    const pj_int16_t *end = src + count;
-    
-    while (src < end) {
-	*dst++ = pjmedia_linear2ulaw(*src++);
-    }
-}
+PJ_DECL(void) pjmedia_ulaw_encode(pj_uint8_t *dst, const pj_int16_t *src, 
+				  pj_size_t count);
 
 /**
  * Encode 16-bit linear PCM data to 8-bit A-Law data.
@@ -163,15 +160,8 @@ PJ_INLINE(void) pjmedia_ulaw_encode(pj_uint8_t *dst, const pj_int16_t *src,
  * @param src	    Source, 16-bit linear PCM data.
  * @param count	    Number of samples.
  */
-PJ_INLINE(void) pjmedia_alaw_encode(pj_uint8_t *dst, const pj_int16_t *src, 
-				    pj_size_t count)
-{
-    const pj_int16_t *end = src + count;
-    
-    while (src < end) {
-	*dst++ = pjmedia_linear2alaw(*src++);
-    }
-}
+PJ_DECL(void) pjmedia_alaw_encode(pj_uint8_t *dst, const pj_int16_t *src, 
+				  pj_size_t count);
 
 /**
  * Decode 8-bit U-Law data to 16-bit linear PCM data.
@@ -180,15 +170,8 @@ PJ_INLINE(void) pjmedia_alaw_encode(pj_uint8_t *dst, const pj_int16_t *src,
  * @param src	    Source, 8-bit U-Law data.
  * @param len	    Encoded frame/source length in bytes.
  */
-PJ_INLINE(void) pjmedia_ulaw_decode(pj_int16_t *dst, const pj_uint8_t *src, 
-				    pj_size_t len)
-{
-    const pj_uint8_t *end = src + len;
-    
-    while (src < end) {
-	*dst++ = pjmedia_ulaw2linear(*src++);
-    }
-}
+PJ_DECL(void) pjmedia_ulaw_decode(pj_int16_t *dst, const pj_uint8_t *src, 
+				  pj_size_t len);
 
 /**
  * Decode 8-bit A-Law data to 16-bit linear PCM data.
@@ -197,15 +180,55 @@ PJ_INLINE(void) pjmedia_ulaw_decode(pj_int16_t *dst, const pj_uint8_t *src,
  * @param src	    Source, 8-bit A-Law data.
  * @param len	    Encoded frame/source length in bytes.
  */
-PJ_INLINE(void) pjmedia_alaw_decode(pj_int16_t *dst, const pj_uint8_t *src, 
-				    pj_size_t len)
+PJ_DECL(void) pjmedia_alaw_decode(pj_int16_t *dst, const pj_uint8_t *src, 
+				  pj_size_t len);
+
+/**
+ * G.711 companding law.
+ */
+typedef enum pjmedia_g711_law
 {
-    const pj_uint8_t *end = src + len;
-    
-    while (src < end) {
-	*dst++ = pjmedia_alaw2linear(*src++);
-    }
-}
+    /** U-Law (PCMU). */
+    PJMEDIA_G711_ULAW,
+
+    /** A-Law (PCMA). */
+    PJMEDIA_G711_ALAW
+
+} pjmedia_g711_law;
+
+/**
+ * Encode one frame of 16-bit linear PCM data for each of many streams in
+ * one call. This saves the per call overhead when an application handles
+ * the frames of many streams at once, e.g. in each clock tick of a media
+ * server.
+ *
+ * @param law	    The companding law.
+ * @param dst	    Array of destination buffers, one for each stream.
+ * @param src	    Array of source buffers, one for each stream.
+ * @param stream_cnt Number of streams.
+ * @param count	    Number of samples in each frame.
+ */
+PJ_DECL(void) pjmedia_g711_encode_batch(pjmedia_g711_law law,
+					pj_uint8_t *const dst[],
+					const pj_int16_t *const src[],
+					unsigned stream_cnt,
+					pj_size_t count);
+
+/**
+ * Decode one frame of 8-bit G.711 data for each of many streams in one
+ * call.
+ *
+ * @param law	    The companding law.
+ * @param dst	    Array of destination buffers, one for each stream.
+ * @param src	    Array of source buffers, one for each stream.
+ * @param stream_cnt Number of streams.
+ * @param len	    Length of each encoded frame, in bytes.
+ */
+PJ_DECL(void) pjmedia_g711_decode_batch(pjmedia_g711_law law,
+					pj_int16_t *const dst[],
+					const pj_uint8_t *const src[],
+					unsigned stream_cnt,
+					pj_size_t len);
 
 PJ_END_DECL
 
@@ -0,0 +1,262 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJMEDIA_CONF_GROUP_H__
+#define __PJMEDIA_CONF_GROUP_H__
+
+
+/**
+ * @file conf_group.h
+ * @brief Group of conference bridges sharing one clock.
+ */
+#include <pjmedia/conference.h>
+
+/**
+ * @defgroup PJMEDIA_CONF_GROUP Conference Bridge Group
+ * @ingroup PJMEDIA_PORT
+ * @brief Sharded conference bridges driven by one clock
+ * @{
+ *
+ * A conference bridge group spreads the ports over several independent
+ * conference bridges (the shards), which are driven by one clock. Each
+ * shard has its own mutex and mixing loop, and the shards are processed
+ * in parallel by the group's worker threads, so ports in different
+ * shards never contend with each other. This suits applications with
+ * many independent calls or conferences, which would otherwise all
+ * serialize through one bridge.
+ *
+ * Each port is added with an affinity value, normally an identifier of
+ * the conference the port belongs to. Ports with the same affinity are
+ * placed in the same shard, and each new affinity is placed in the least
+ * loaded shard. Ports in different shards can still be connected: the
+ * group then creates a link, a pair of ports that carries the signal of
+ * the source port to the other shard, with one frame of extra latency.
+ *
+ * Slot numbers of the group are different from the slot numbers of the
+ * shards. Use #pjmedia_conf_group_get_conf() to get the shard and slot of
+ * a port, to use the other conference bridge functions on it (such as
+ * level adjustment).
+ */
+
+PJ_BEGIN_DECL
+
+/**
+ * Opaque type for conference bridge group.
+ */
+typedef struct pjmedia_conf_group pjmedia_conf_group;
+
+
+/**
+ * Conference bridge group creation parameters. Application should
+ * initialize this structure with #pjmedia_conf_group_param_default().
+ */
+typedef struct pjmedia_conf_group_param
+{
+    /**
+     * Number of shards.
+     *
+     * Default: 4
+     */
+    unsigned		shard_cnt;
+
+    /**
+     * Parameters of each shard. The \a max_slots is the number of slots
+     * of each shard, including its port zero and the link ports. The
+     * \a options always include PJMEDIA_CONF_NO_DEVICE.
+     */
+    pjmedia_conf_param	conf_param;
+
+    /**
+     * Number of worker threads to create to process the shards in
+     * parallel with the clock thread.
+     *
+     * Default: 0
+     */
+    unsigned		worker_threads;
+
+    /**
+     * Do not create a clock. Application must then call
+     * #pjmedia_conf_group_tick() periodically, for example from a
+     * pjmedia_clock or a sound device callback.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t		no_clock;
+
+} pjmedia_conf_group_param;
+
+
+/**
+ * Initialize conference bridge group creation parameters with the
+ * default values.
+ *
+ * @param param		    The parameters to be initialized.
+ */
+PJ_DECL(void) pjmedia_conf_group_param_default(pjmedia_conf_group_param *param);
+
+
+/**
+ * Create conference bridge group. Unless \a no_clock is set, the group
+ * clock is started immediately.
+ *
+ * @param pool		    Pool to allocate the group and the shards.
+ * @param param		    The group parameters.
+ * @param p_group	    Pointer to receive the group instance.
+ *
+ * @return		    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_conf_group_create(pj_pool_t *pool,
+				const pjmedia_conf_group_param *param,
+				pjmedia_conf_group **p_group);
+
+
+/**
+ * Destroy conference bridge group, and all of its shards.
+ *
+ * @param group		    The group.
+ *
+ * @return		    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_conf_group_destroy(pjmedia_conf_group *group);
+
+
+/**
+ * Add a port to the group.
+ *
+ * @param group		    The group.
+ * @param pool		    Pool to allocate buffers for this port.
+ * @param port		    The port.
+ * @param name		    Optional name for the port.
+ * @param affinity	    Ports with the same affinity are placed in the
+ *			    same shard. Zero means the port has no affinity,
+ *			    and it is placed in the least loaded shard.
+ * @param p_slot	    Optional pointer to receive the slot number of
+ *			    the port in the group.
+ *
+ * @return		    PJ_SUCCESS on success, or PJ_ETOOMANY if the
+ *			    shard is full.
+ */
+PJ_DECL(pj_status_t) pjmedia_conf_group_add_port(pjmedia_conf_group *group,
+						 pj_pool_t *pool,
+						 pjmedia_port *port,
+						 const pj_str_t *name,
+						 pj_uint32_t affinity,
+						 unsigned *p_slot);
+
+
+/**
+ * Remove a port from the group, together with its connections.
+ *
+ * @param group		    The group.
+ * @param slot		    The slot number of the port in the group.
+ *
+ * @return		    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_conf_group_remove_port(pjmedia_conf_group *group,
+						    unsigned slot);
+
+
+/**
+ * Connect one port to another, creating a link between the shards if
+ * the ports are in different shards.
+ *
+ * A link lets the shards run at the same time by playing the frame
+ * written in one tick at the next tick, so the signal carried across
+ * shards is delayed by one more frame (samples_per_frame of the
+ * conference parameter) than the signal between ports in the same
+ * shard. Use the same affinity for ports that need the lowest latency
+ * between them.
+ *
+ * @param group		    The group.
+ * @param src_slot	    Source slot.
+ * @param sink_slot	    Sink slot.
+ *
+ * @return		    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_conf_group_connect_port(pjmedia_conf_group *group,
+						     unsigned src_slot,
+						     unsigned sink_slot);
+
+
+/**
+ * Disconnect one port from another, and remove the link between the
+ * shards when it is no longer used.
+ *
+ * @param group		    The group.
+ * @param src_slot	    Source slot.
+ * @param sink_slot	    Sink slot.
+ *
+ * @return		    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_conf_group_disconnect_port(
+						    pjmedia_conf_group *group,
+						    unsigned src_slot,
+						    unsigned sink_slot);
+
+
+/**
+ * Get the shard and the slot number in the shard of a port.
+ *
+ * @param group		    The group.
+ * @param slot		    The slot number of the port in the group.
+ * @param p_conf	    Pointer to receive the shard.
+ * @param p_conf_slot	    Optional pointer to receive the slot number of
+ *			    the port in the shard.
+ *
+ * @return		    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_conf_group_get_conf(pjmedia_conf_group *group,
+						 unsigned slot,
+						 pjmedia_conf **p_conf,
+						 unsigned *p_conf_slot);
+
+
+/**
+ * Get the number of links between shards currently in use.
+ *
+ * @param group		    The group.
+ *
+ * @return		    Number of links.
+ */
+PJ_DECL(unsigned) pjmedia_conf_group_get_link_count(pjmedia_conf_group *group);
+
+
+/**
+ * Run one clock tick of all shards. This is only needed when the group
+ * was created with \a no_clock, otherwise the group clock calls this.
+ * The function returns after all shards have been processed.
+ *
+ * @param group		    The group.
+ * @param ts		    Timestamp of the tick, in samples.
+ *
+ * @return		    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_conf_group_tick(pjmedia_conf_group *group,
+					     const pj_timestamp *ts);
+
+
+PJ_END_DECL
+
+
+/**
+ * @}
+ */
+
+
+#endif	/* __PJMEDIA_CONF_GROUP_H__ */
@@ -39,6 +39,13 @@
  *
  * Some more information about the media flow when conference bridge is
  * used is described in http://www.pjsip.org/trac/wiki/media-flow .
+ *
+ * The clock tick of the bridge doesn't hold the bridge mutex while mixing.
+ * Ports added or removed, connections made or removed, and port settings
+ * and levels changed while a tick is running are queued, and take effect
+ * when the tick ends, so these functions never wait for the mixing and
+ * never delay it. Until then, #pjmedia_conf_get_port_info() still reports
+ * the connections and settings that the running tick uses.
  */
 
 PJ_BEGIN_DECL
@@ -96,6 +103,97 @@ enum pjmedia_conf_option
 };
 
 
+/**
+ * Conference bridge creation parameters, to be specified when creating
+ * the bridge with #pjmedia_conf_create2(). Application should initialize
+ * this structure with #pjmedia_conf_param_default().
+ */
+typedef struct pjmedia_conf_param
+{
+    /**
+     * Maximum number of slots/ports, including port zero.
+     */
+    unsigned	max_slots;
+
+    /**
+     * Sampling rate of the bridge.
+     */
+    unsigned	sampling_rate;
+
+    /**
+     * Number of channels.
+     *
+     * Default: 1
+     */
+    unsigned	channel_count;
+
+    /**
+     * Number of samples per frame.
+     */
+    unsigned	samples_per_frame;
+
+    /**
+     * Number of bits per sample. Only 16 is supported.
+     *
+     * Default: 16
+     */
+    unsigned	bits_per_sample;
+
+    /**
+     * Bitmask options, constructed from #pjmedia_conf_option.
+     *
+     * Default: 0
+     */
+    unsigned	options;
+
+    /**
+     * Number of worker threads to create to process the ports in parallel
+     * with the clock thread (the thread calling get_frame() of port zero).
+     * When this is non-zero, on every clock tick the frames of all ports
+     * are first read in parallel, then the frames for all ports are mixed
+     * and written in parallel. Since get_frame() and put_frame() of the
+     * ports may then be called from a worker thread, the ports must not
+     * call the conference bridge API from inside these callbacks.
+     *
+     * Zero means all ports are processed by the clock thread.
+     *
+     * Default: PJMEDIA_CONF_WORKER_THREADS
+     */
+    unsigned	worker_threads;
+
+    /**
+     * Maximum number of active speakers. When this is non-zero, on every
+     * clock tick the bridge only mixes the signal of this many of the
+     * loudest ports (the active speakers), and the other ports are not
+     * heard. The active speakers are mixed once into a shared sum, and
+     * each port gets that sum, minus its own signal if it is one of the
+     * active speakers. This makes the cost of mixing proportional to the
+     * number of ports rather than to the number of connections, which
+     * makes large conferences possible. The selection favors the current
+     * active speakers (see #PJMEDIA_CONF_SPEAKER_HYSTERESIS), so that
+     * they don't change too often.
+     *
+     * Ports that are not connected to all active speakers get their own
+     * mix of the active speakers that they are connected to.
+     *
+     * Zero means every port is mixed.
+     *
+     * Default: PJMEDIA_CONF_ACTIVE_SPEAKERS
+     */
+    unsigned	active_speakers;
+
+} pjmedia_conf_param;
+
+
+/**
+ * Initialize conference bridge creation parameters with the default
+ * values.
+ *
+ * @param param		    The parameters to be initialized.
+ */
+PJ_DECL(void) pjmedia_conf_param_default(pjmedia_conf_param *param);
+
+
 /**
  * Create conference bridge with the specified parameters. The sampling rate,
  * samples per frame, and bits per sample will be used for the internal
@@ -162,6 +260,23 @@ PJ_DECL(pj_status_t) pjmedia_conf_create( pj_pool_t *pool,
 					  pjmedia_conf **p_conf );
 
 
+/**
+ * Create conference bridge with the specified parameters. This is the
+ * same as #pjmedia_conf_create(), but it also allows the bridge to use
+ * worker threads to process the ports in parallel.
+ *
+ * @param pool		    Pool to use to allocate the bridge and
+ *			    additional buffers for the sound device.
+ * @param param		    The bridge parameters.
+ * @param p_conf	    Pointer to receive the conference bridge instance.
+ *
+ * @return		    PJ_SUCCESS if conference bridge can be created.
+ */
+PJ_DECL(pj_status_t) pjmedia_conf_create2( pj_pool_t *pool,
+					   const pjmedia_conf_param *param,
+					   pjmedia_conf **p_conf );
+
+
 /**
  * Destroy conference bridge.
  *
@@ -351,7 +466,11 @@ PJ_DECL(unsigned) pjmedia_conf_get_connect_count(pjmedia_conf *conf);
 
 
 /**
- * Remove the specified port from the conference bridge.
+ * Remove the specified port from the conference bridge. If the clock
+ * tick is running, this function waits until the tick ends, so that the
+ * port may be destroyed as soon as the function returns. The exception
+ * is when it is called from the tick itself, e.g: from the callback of
+ * a port, in which case the port is removed when the tick ends.
  *
  * @param conf		The conference bridge.
  * @param slot		The port index to be removed.
@@ -436,6 +555,24 @@ PJ_DECL(pj_status_t) pjmedia_conf_get_signal_level(pjmedia_conf *conf,
 						   unsigned *rx_level);
 
 
+/**
+ * Get the current active speakers, when the bridge was created with
+ * \a active_speakers setting in #pjmedia_conf_param. The slots are
+ * returned in ascending order.
+ *
+ * @param conf		The conference bridge.
+ * @param slots		Array to receive the slot numbers of the active
+ *			speakers.
+ * @param count		On input, the maximum number of elements in the
+ *			array. On output, the number of active speakers.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_conf_get_active_speakers(pjmedia_conf *conf,
+						      unsigned slots[],
+						      unsigned *count);
+
+
 /**
  * Adjust the level of signal received from the specified port.
  * Application may adjust the level to make signal received from the port
@@ -74,6 +74,54 @@
 #   define PJMEDIA_CONF_SWITCH_BOARD_BUF_SIZE    PJMEDIA_MAX_MTU
 #endif
 
+/**
+ * Default number of worker threads of the conference bridge, used to
+ * read, mix and write the ports in parallel with the clock thread. See
+ * \a worker_threads in #pjmedia_conf_param. The audio switchboard
+ * ignores this setting.
+ *
+ * Default: 0 (all ports are processed by the clock thread)
+ */
+#ifndef PJMEDIA_CONF_WORKER_THREADS
+#   define PJMEDIA_CONF_WORKER_THREADS	    0
+#endif
+
+/**
+ * Default maximum number of active speakers of the conference bridge. See
+ * \a active_speakers in #pjmedia_conf_param. The audio switchboard
+ * ignores this setting.
+ *
+ * Default: 0 (every port is mixed)
+ */
+#ifndef PJMEDIA_CONF_ACTIVE_SPEAKERS
+#   define PJMEDIA_CONF_ACTIVE_SPEAKERS	    0
+#endif
+
+/**
+ * Hysteresis of the active speaker selection of the conference bridge,
+ * in the signal level unit of #pjmedia_conf_get_signal_level(). A port
+ * replaces an active speaker only when its level is larger than the
+ * level of the active speaker plus this value.
+ *
+ * Default: 12
+ */
+#ifndef PJMEDIA_CONF_SPEAKER_HYSTERESIS
+#   define PJMEDIA_CONF_SPEAKER_HYSTERESIS    12
+#endif
+
+/**
+ * Enable SIMD (SSE2, AVX2 or NEON) implementations of the audio sample
+ * processing primitives, such as the mixing primitives used by the
+ * conference bridge. The implementation is selected at run-time based
+ * on the CPU features, falling back to portable C code. Set this to zero
+ * to build only the portable C code.
+ *
+ * Default: 1
+ */
+#ifndef PJMEDIA_HAS_SIMD
+#   define PJMEDIA_HAS_SIMD		    1
+#endif
+
 
 /*
  * Types of sound stream backends.
@@ -360,6 +408,21 @@
 #endif
 
 
+/**
+ * Enable the polyphase sample rate converter in the libresample backend.
+ * It is used instead of libresample when the conversion ratio is small,
+ * such as between 8, 16, 32 and 48 KHz, and the frame holds a whole
+ * number of filter periods. The filter bank is computed when the resample
+ * session is created, and the filtering uses SSE2, AVX2 or NEON when
+ * #PJMEDIA_HAS_SIMD is enabled.
+ *
+ * Default: 1
+ */
+#ifndef PJMEDIA_HAS_POLYPHASE_RESAMPLE
+#   define PJMEDIA_HAS_POLYPHASE_RESAMPLE   1
+#endif
+
+
 /**
  * Specify whether libsamplerate, when used, should be linked statically
  * into the application. This option is only useful for Visual Studio
@@ -561,6 +624,20 @@
 #   define PJMEDIA_STREAM_VAD_SUSPEND_MSEC	600
 #endif
 
+/**
+ * Adapt the audio stream latency with time-stretching instead of
+ * discarding frames. When enabled, the jitter buffer is set to
+ * time-stretching mode (see #pjmedia_jbuf_set_stretch()), and the stream
+ * shrinks or expands the decoded audio with WSOLA as recommended by the
+ * jitter buffer, so latency can be reduced on good networks and raised
+ * on bad ones without audible gaps.
+ *
+ * Default: 0
+ */
+#ifndef PJMEDIA_STREAM_TIME_STRETCH
+#   define PJMEDIA_STREAM_TIME_STRETCH		0
+#endif
+
 /**
  * Perform RTP payload type checking in the stream. Normally the peer
  * MUST send RTP with payload type as we specified in our SDP. Certain
@@ -1220,6 +1297,19 @@
 #endif
 
 
+/**
+ * Percentage of packet arrivals that the jitter buffer delay should cover
+ * in time-stretching mode (see #pjmedia_jbuf_set_stretch()). The target
+ * delay is the smallest one which covers this percentage of the packet
+ * inter-arrival times in the arrival histogram.
+ *
+ * Default: 95
+ */
+#ifndef PJMEDIA_JBUF_STRETCH_QUANTILE
+#   define PJMEDIA_JBUF_STRETCH_QUANTILE	    95
+#endif
+
+
 /**
  * Video stream will discard old picture from the jitter buffer as soon as
  * new picture is received, to reduce latency.
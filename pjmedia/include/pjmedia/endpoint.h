@@ -38,6 +38,7 @@
  */
 
 #include <pjmedia/codec.h>
+#include <pjmedia/jbuf.h>
 #include <pjmedia/sdp.h>
 #include <pjmedia/transport.h>
 
@@ -186,6 +187,17 @@ PJ_DECL(pj_pool_t*) pjmedia_endpt_create_pool( pjmedia_endpt *endpt,
 PJ_DECL(pjmedia_codec_mgr*) pjmedia_endpt_get_codec_mgr(pjmedia_endpt *endpt);
 
 
+/**
+ * Get the frame storage shared by the jitter buffers of the streams
+ * created with this media endpoint (see #pjmedia_jbuf_create2()).
+ *
+ * @param endpt		The media endpoint instance.
+ *
+ * @return		The shared jitter buffer slab.
+ */
+PJ_DECL(pjmedia_jb_slab*) pjmedia_endpt_get_jb_slab(pjmedia_endpt *endpt);
+
+
 /**
  * Create a SDP session description that describes the endpoint
  * capability.
@@ -0,0 +1,154 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJMEDIA_FRAME_POOL_H__
+#define __PJMEDIA_FRAME_POOL_H__
+
+
+/**
+ * @file frame_pool.h
+ * @brief Pool of reference counted frame buffers.
+ */
+#include <pjmedia/types.h>
+
+/**
+ * @defgroup PJMEDIA_FRAME_POOL Frame Buffer Pool
+ * @ingroup PJMEDIA_FRAME_OP
+ * @brief Reference counted frame buffers
+ * @{
+ *
+ * A frame buffer holds the payload of one frame, and is reference
+ * counted, so that a frame can be passed along several media ports
+ * without copying the payload: a port that doesn't modify the frame
+ * only adds a reference, and the buffer is returned to its pool when
+ * the last reference is released. Frame buffers have a fixed capacity,
+ * and are reused once they are returned, so the pool never frees any
+ * memory until it is destroyed.
+ *
+ * The payload of a frame buffer must not be modified once it has been
+ * passed to another port, since the other holders of the reference may
+ * still read it.
+ *
+ * See #pjmedia_port_get_frame_buf() and #pjmedia_port_put_frame_buf()
+ * for passing frame buffers between media ports.
+ */
+
+PJ_BEGIN_DECL
+
+/** Opaque declaration for frame buffer pool. */
+typedef struct pjmedia_frame_pool pjmedia_frame_pool;
+
+/**
+ * Reference counted frame buffer.
+ */
+typedef struct pjmedia_frame_buf
+{
+    /** Pointer to the payload. */
+    void		*buf;
+
+    /** Capacity of the payload buffer, in bytes. */
+    pj_size_t		 size;
+
+    /** The pool which owns this buffer. */
+    pjmedia_frame_pool	*fpool;
+
+    /** Number of references, managed by the pool. */
+    pj_atomic_t		*ref_cnt;
+
+    /** Next free buffer in the pool, managed by the pool. */
+    struct pjmedia_frame_buf *next;
+
+    /** Next buffer allocated by the pool, managed by the pool. */
+    struct pjmedia_frame_buf *next_alloc;
+
+} pjmedia_frame_buf;
+
+
+/**
+ * Create a frame buffer pool. Buffers are allocated as they are needed.
+ *
+ * @param pool		Pool to allocate the frame pool. The buffers are
+ *			allocated from a new pool of the same pool factory.
+ * @param name		Optional name for the frame pool.
+ * @param buf_size	Capacity of each buffer, in bytes.
+ * @param max_cnt	Maximum number of buffers, or zero for no limit.
+ * @param p_fpool	Pointer to receive the frame pool.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_frame_pool_create(pj_pool_t *pool,
+					       const char *name,
+					       pj_size_t buf_size,
+					       unsigned max_cnt,
+					       pjmedia_frame_pool **p_fpool);
+
+/**
+ * Get the capacity of the buffers of the pool.
+ *
+ * @param fpool		The frame pool.
+ *
+ * @return		Capacity of each buffer, in bytes.
+ */
+PJ_DECL(pj_size_t) pjmedia_frame_pool_get_buf_size(pjmedia_frame_pool *fpool);
+
+/**
+ * Get a buffer from the pool. The returned buffer has one reference,
+ * which belongs to the caller.
+ *
+ * @param fpool		The frame pool.
+ * @param p_fbuf	Pointer to receive the buffer.
+ *
+ * @return		PJ_SUCCESS on success, or PJ_ETOOMANY if the
+ *			maximum number of buffers are in use.
+ */
+PJ_DECL(pj_status_t) pjmedia_frame_pool_alloc(pjmedia_frame_pool *fpool,
+					      pjmedia_frame_buf **p_fbuf);
+
+/**
+ * Destroy the frame pool. All buffers must have been released.
+ *
+ * @param fpool		The frame pool.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_frame_pool_destroy(pjmedia_frame_pool *fpool);
+
+/**
+ * Add a reference to a frame buffer.
+ *
+ * @param fbuf		The frame buffer.
+ */
+PJ_DECL(void) pjmedia_frame_buf_add_ref(pjmedia_frame_buf *fbuf);
+
+/**
+ * Release a reference to a frame buffer. The buffer is returned to its
+ * pool when the last reference is released.
+ *
+ * @param fbuf		The frame buffer.
+ */
+PJ_DECL(void) pjmedia_frame_buf_dec_ref(pjmedia_frame_buf *fbuf);
+
+
+PJ_END_DECL
+
+/**
+ * @}
+ */
+
+#endif	/* __PJMEDIA_FRAME_POOL_H__ */
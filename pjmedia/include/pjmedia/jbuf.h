@@ -93,6 +93,33 @@ typedef enum pjmedia_jb_discard_algo
 } pjmedia_jb_discard_algo;
 
 
+/**
+ * Playout operations recommended by the jitter buffer in time-stretching
+ * mode, see #pjmedia_jbuf_set_stretch().
+ */
+typedef enum pjmedia_jb_stretch_op
+{
+    /**
+     * Get and play the next frame normally.
+     */
+    PJMEDIA_JB_STRETCH_NONE	   = 0,
+
+    /**
+     * The latency is higher than needed. Get two frames and play them in
+     * about one frame time, e.g: by compressing them with WSOLA.
+     */
+    PJMEDIA_JB_STRETCH_SHRINK	   = 1,
+
+    /**
+     * The latency is lower than needed. Don't get any frame, and play a
+     * synthetic frame instead, e.g: by expanding the previous frames with
+     * WSOLA.
+     */
+    PJMEDIA_JB_STRETCH_EXPAND	   = 2
+
+} pjmedia_jb_stretch_op;
+
+
 /**
  * This structure describes jitter buffer state.
  */
@@ -131,6 +158,74 @@ typedef struct pjmedia_jb_state
  */
 typedef struct pjmedia_jbuf pjmedia_jbuf;
 
+/**
+ * Opaque declaration for the frame storage shared by jitter buffers.
+ */
+typedef struct pjmedia_jb_slab pjmedia_jb_slab;
+
+
+/**
+ * This structure describes the memory use of a shared jitter buffer
+ * slab.
+ */
+typedef struct pjmedia_jb_slab_info
+{
+    pj_size_t	used;		    /**< Bytes holding frames.		    */
+    pj_size_t	capacity;	    /**< Bytes allocated for frames.	    */
+} pjmedia_jb_slab_info;
+
+
+/**
+ * The largest frame that can be kept in a shared jitter buffer slab, in
+ * bytes.
+ */
+#define PJMEDIA_JB_SLAB_MAX_FRAME	16384
+
+
+/**
+ * Create frame storage to be shared by jitter buffers, see
+ * #pjmedia_jbuf_create2(). The storage holds the frames which are in the
+ * jitter buffers at the moment, in chunks of a few sizes which are
+ * reused once the frames leave the buffers, so the memory follows the
+ * total number of buffered frames rather than the capacity of every
+ * jitter buffer. The slab may be used by jitter buffers of different
+ * threads, and is protected by its own lock.
+ *
+ * The media endpoint owns a slab, which is used by the audio and video
+ * streams (see #pjmedia_endpt_get_jb_slab()).
+ *
+ * @param pool		Pool to allocate the slab. The frames are
+ *			allocated from a new pool of the same pool factory.
+ * @param p_slab	Pointer to receive the slab.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_jb_slab_create(pj_pool_t *pool,
+					    pjmedia_jb_slab **p_slab);
+
+
+/**
+ * Get the memory use of the slab.
+ *
+ * @param slab		The slab.
+ * @param info		Buffer to receive the information.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_jb_slab_get_info(pjmedia_jb_slab *slab,
+					      pjmedia_jb_slab_info *info);
+
+
+/**
+ * Destroy the slab. All jitter buffers using it must have been
+ * destroyed.
+ *
+ * @param slab		The slab.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_jb_slab_destroy(pjmedia_jb_slab *slab);
+
 
 /**
  * Create an adaptive jitter buffer according to the specification. If
@@ -139,8 +234,15 @@ typedef struct pjmedia_jbuf pjmedia_jbuf;
  * if application wants to alter the discard algorithm, which the default
  * PJMEDIA_JB_DISCARD_PROGRESSIVE, it may call #pjmedia_jbuf_set_discard().
  *
- * This function may allocate large chunk of memory to keep the frames in 
- * the buffer.
+ * The frames of a large jitter buffer are stored taking only their
+ * actual length, and the storage grows with the number of frames kept in
+ * the buffer, up to max_count frames of frame_size bytes. Storage which
+ * hasn't reached its maximum size is allocated from a separate pool of
+ * the same pool factory, so the jitter buffer must be destroyed with
+ * #pjmedia_jbuf_destroy(). A small jitter buffer allocates room for
+ * max_count frames of frame_size bytes right away. Use
+ * #pjmedia_jbuf_create2() to keep the frames in storage shared with
+ * other jitter buffers instead.
  *
  * @param pool		The pool to allocate memory.
  * @param name		Name to identify the jitter buffer for logging
@@ -167,6 +269,36 @@ PJ_DECL(pj_status_t) pjmedia_jbuf_create(pj_pool_t *pool,
 					 unsigned max_count,
 					 pjmedia_jbuf **p_jb);
 
+/**
+ * Create an adaptive jitter buffer which keeps its frames in a slab
+ * shared with other jitter buffers, so it only holds memory for the
+ * frames which are in the buffer. The jitter buffer must be destroyed
+ * with #pjmedia_jbuf_destroy(), before the slab is destroyed. If
+ * frame_size is larger than PJMEDIA_JB_SLAB_MAX_FRAME, the jitter buffer
+ * keeps its own storage as with #pjmedia_jbuf_create().
+ *
+ * @param pool		The pool to allocate memory.
+ * @param name		Name to identify the jitter buffer for logging
+ *			purpose.
+ * @param frame_size	The maximum size of each frame, in bytes.
+ * @param ptime		Indication of frame duration, used to calculate 
+ *			the interval between jitter recalculation.
+ * @param max_count	Maximum number of frames that can be kept in the
+ *			jitter buffer.
+ * @param slab		The shared slab, or NULL to have the jitter buffer
+ *			keep its own storage.
+ * @param p_jb		Pointer to receive jitter buffer instance.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_jbuf_create2(pj_pool_t *pool,
+					  const pj_str_t *name,
+					  unsigned frame_size,
+					  unsigned ptime,
+					  unsigned max_count,
+					  pjmedia_jb_slab *slab,
+					  pjmedia_jbuf **p_jb);
+
 /**
  * Set the jitter buffer to fixed delay mode. The default behavior
  * is to adapt the delay with actual packet delay.
@@ -217,7 +349,50 @@ PJ_DECL(pj_status_t) pjmedia_jbuf_set_discard(pjmedia_jbuf *jb,
 
 
 /**
- * Destroy jitter buffer instance.
+ * Enable or disable the time-stretching adaptive mode. In this mode, the
+ * jitter buffer keeps a histogram of the packet inter-arrival times,
+ * measured against the frame sequence numbers (which the stream derives
+ * from the RTP timestamps), and sets the prefetch to the smallest delay
+ * which covers PJMEDIA_JBUF_STRETCH_QUANTILE percent of the arrivals,
+ * within the minimum and maximum prefetch of the adaptive mode.
+ *
+ * The jitter buffer doesn't discard frames to reduce the latency in this
+ * mode. Instead, application must call #pjmedia_jbuf_get_stretch_op()
+ * once every frame interval, before getting the frames for the interval,
+ * and shrink or expand the playout as recommended. Frames are still
+ * discarded when the jitter buffer is full.
+ *
+ * Disabling the mode restores the discard algorithm which was used before
+ * the mode was enabled, or which was set with #pjmedia_jbuf_set_discard()
+ * or #pjmedia_jbuf_set_fixed() while the mode was enabled.
+ *
+ * @param jb		The jitter buffer.
+ * @param enabled	PJ_TRUE to enable time-stretching mode.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_jbuf_set_stretch(pjmedia_jbuf *jb,
+					      pj_bool_t enabled);
+
+
+/**
+ * Get the playout operation recommended for the current frame interval
+ * in time-stretching mode. This must be called exactly once every frame
+ * interval, as it also advances the playout clock that the jitter buffer
+ * uses to measure the packet arrival times.
+ *
+ * @param jb		The jitter buffer.
+ *
+ * @return		The recommended operation, or PJMEDIA_JB_STRETCH_NONE
+ *			if time-stretching mode is not enabled.
+ */
+PJ_DECL(pjmedia_jb_stretch_op) pjmedia_jbuf_get_stretch_op(pjmedia_jbuf *jb);
+
+
+/**
+ * Destroy jitter buffer instance, releasing the frame storage which is
+ * not allocated from the pool given to #pjmedia_jbuf_create(), and giving
+ * the frames in a shared slab back to the slab.
  *
  * @param jb		The jitter buffer.
  *
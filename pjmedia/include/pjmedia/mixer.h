@@ -0,0 +1,204 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJMEDIA_MIXER_H__
+#define __PJMEDIA_MIXER_H__
+
+/**
+ * @file mixer.h
+ * @brief Audio mixing primitives.
+ */
+#include <pjmedia/types.h>
+
+/**
+ * @defgroup PJMED_MIXER Audio Mixing Primitives
+ * @ingroup PJMEDIA_FRAME_OP
+ * @brief Vectorized sample accumulation, gain and level computation
+ * @{
+ *
+ * This section describes the sample level primitives used by the
+ * \ref PJMEDIA_CONF to mix audio signals. Each primitive has a portable
+ * C implementation and, when #PJMEDIA_HAS_SIMD is enabled, SSE2, AVX2 or
+ * NEON implementations. The fastest implementation supported by the CPU
+ * is selected at run-time, and all implementations produce bit-exact
+ * results. The selection also applies to the G.711 block conversions and
+ * to the polyphase resampler.
+ *
+ * Gain values are expressed the same way as the conference bridge
+ * level adjustment: 128 means no adjustment, 64 halves the signal and
+ * 256 doubles it.
+ */
+
+PJ_BEGIN_DECL
+
+
+/**
+ * Implementations of the mixing primitives.
+ */
+typedef enum pjmedia_mix_impl
+{
+    /** Select the fastest implementation supported by the CPU. */
+    PJMEDIA_MIX_IMPL_AUTO,
+
+    /** Portable C implementation. */
+    PJMEDIA_MIX_IMPL_SCALAR,
+
+    /** x86 SSE2 implementation. */
+    PJMEDIA_MIX_IMPL_SSE2,
+
+    /** x86 AVX2 implementation. */
+    PJMEDIA_MIX_IMPL_AVX2,
+
+    /** ARM NEON implementation. */
+    PJMEDIA_MIX_IMPL_NEON
+
+} pjmedia_mix_impl;
+
+
+/**
+ * Select the implementation of the mixing primitives. This is normally
+ * not needed since the best implementation is selected automatically,
+ * but it is useful to compare implementations, e.g. for benchmarking.
+ *
+ * @param impl		The implementation.
+ *
+ * @return		PJ_SUCCESS, or PJ_ENOTSUP if the implementation
+ *			is not available in this build or on this CPU.
+ */
+PJ_DECL(pj_status_t) pjmedia_mix_set_impl(pjmedia_mix_impl impl);
+
+
+/**
+ * Get the implementation of the mixing primitives currently in use.
+ *
+ * @return		The implementation, never PJMEDIA_MIX_IMPL_AUTO.
+ */
+PJ_DECL(pjmedia_mix_impl) pjmedia_mix_get_impl(void);
+
+
+/**
+ * Get the name of the implementation.
+ *
+ * @param impl		The implementation.
+ *
+ * @return		The name, e.g. "sse2".
+ */
+PJ_DECL(const char*) pjmedia_mix_impl_name(pjmedia_mix_impl impl);
+
+
+/**
+ * Widen 16bit samples into a 32bit mixing buffer.
+ *
+ * @param dst		The mixing buffer.
+ * @param src		The samples.
+ * @param count		Number of samples.
+ */
+PJ_DECL(void) pjmedia_mix_copy(pj_int32_t *dst, const pj_int16_t *src,
+			       unsigned count);
+
+
+/**
+ * Add 16bit samples to a 32bit mixing buffer, and get the smallest and
+ * largest value of the mixing buffer after the addition. The caller can
+ * use these to detect that the mixed signal will clip when converted
+ * back to 16bit.
+ *
+ * @param dst		The mixing buffer.
+ * @param src		The samples to add.
+ * @param count		Number of samples.
+ * @param p_min		Optional pointer to receive the smallest value.
+ * @param p_max		Optional pointer to receive the largest value.
+ */
+PJ_DECL(void) pjmedia_mix_add(pj_int32_t *dst, const pj_int16_t *src,
+			      unsigned count, pj_int32_t *p_min,
+			      pj_int32_t *p_max);
+
+
+/**
+ * Subtract 16bit samples from a 32bit mixing buffer and store the result
+ * in another mixing buffer, and get the smallest and largest value of
+ * the result. This is used to remove the signal of a port from a mix
+ * that it contributed to. The destination may point to the same memory
+ * as the source mixing buffer.
+ *
+ * @param dst		The resulting mixing buffer.
+ * @param sum		The source mixing buffer.
+ * @param src		The samples to subtract.
+ * @param count		Number of samples.
+ * @param p_min		Optional pointer to receive the smallest value.
+ * @param p_max		Optional pointer to receive the largest value.
+ */
+PJ_DECL(void) pjmedia_mix_sub(pj_int32_t *dst, const pj_int32_t *sum,
+			      const pj_int16_t *src, unsigned count,
+			      pj_int32_t *p_min, pj_int32_t *p_max);
+
+
+/**
+ * Convert a 32bit mixing buffer to 16bit samples, applying a gain and
+ * saturating the result, and calculate the sum of the absolute values
+ * of the resulting samples. The destination may point to the same
+ * memory as the source.
+ *
+ * @param dst		The 16bit samples.
+ * @param src		The mixing buffer.
+ * @param count		Number of samples.
+ * @param gain		The gain, 128 for none.
+ *
+ * @return		The sum of the absolute sample values.
+ */
+PJ_DECL(pj_uint32_t) pjmedia_mix_adjust(pj_int16_t *dst,
+					const pj_int32_t *src,
+					unsigned count, unsigned gain);
+
+
+/**
+ * Apply a gain to 16bit samples in place, saturating the result, and
+ * calculate the sum of the absolute values of the resulting samples.
+ *
+ * @param buf		The samples.
+ * @param count		Number of samples.
+ * @param gain		The gain, 128 for none.
+ *
+ * @return		The sum of the absolute sample values.
+ */
+PJ_DECL(pj_uint32_t) pjmedia_mix_adjust_samples(pj_int16_t *buf,
+						unsigned count,
+						unsigned gain);
+
+
+/**
+ * Calculate the sum of the absolute values of 16bit samples. Dividing
+ * the result by \a count gives the average signal level.
+ *
+ * @param buf		The samples.
+ * @param count		Number of samples.
+ *
+ * @return		The sum of the absolute sample values.
+ */
+PJ_DECL(pj_uint32_t) pjmedia_mix_level(const pj_int16_t *buf,
+				       unsigned count);
+
+
+PJ_END_DECL
+
+/**
+ * @}
+ */
+
+#endif	/* __PJMEDIA_MIXER_H__ */
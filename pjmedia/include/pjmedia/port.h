@@ -28,6 +28,7 @@
 #include <pjmedia/event.h>
 #include <pjmedia/format.h>
 #include <pjmedia/frame.h>
+#include <pjmedia/frame_pool.h>
 #include <pjmedia/signatures.h>
 #include <pj/assert.h>
 #include <pj/os.h>
@@ -399,6 +400,25 @@ typedef struct pjmedia_port
      */
     pj_status_t (*on_destroy)(struct pjmedia_port *this_port);
 
+    /**
+     * Optional sink interface which takes the frame by reference.
+     * This should only be called by #pjmedia_port_put_frame_buf().
+     * A port which forwards frames to another port should only set this
+     * when that port takes references too, as callers may allocate a
+     * frame buffer for ports that set it.
+     */
+    pj_status_t (*put_frame_buf)(struct pjmedia_port *this_port,
+				 pjmedia_frame *frame,
+				 pjmedia_frame_buf *fbuf);
+
+    /**
+     * Optional source interface which returns the frame by reference.
+     * This should only be called by #pjmedia_port_get_frame_buf().
+     */
+    pj_status_t (*get_frame_buf)(struct pjmedia_port *this_port,
+				 pjmedia_frame *frame,
+				 pjmedia_frame_buf **p_fbuf);
+
 } pjmedia_port;
 
 
@@ -478,6 +498,44 @@ PJ_DECL(pj_status_t) pjmedia_port_get_frame( pjmedia_port *port,
 PJ_DECL(pj_status_t) pjmedia_port_put_frame( pjmedia_port *port,
 					     pjmedia_frame *frame );
 
+/**
+ * Get a frame from the port by reference, when the port supports it.
+ * On return, the frame points to the payload of the frame buffer, and
+ * the caller owns one reference to the buffer, which it must release
+ * with #pjmedia_frame_buf_dec_ref(). The buffer is NULL when the frame
+ * has no payload.
+ *
+ * @param port	    The media port.
+ * @param frame	    Frame to receive the frame information.
+ * @param p_fbuf    Pointer to receive the frame buffer.
+ *
+ * @return	    PJ_SUCCESS on success, PJ_ENOTSUP if the port doesn't
+ *		    support getting frames by reference (application should
+ *		    then use #pjmedia_port_get_frame()), or the appropriate
+ *		    error code.
+ */
+PJ_DECL(pj_status_t) pjmedia_port_get_frame_buf( pjmedia_port *port,
+						 pjmedia_frame *frame,
+						 pjmedia_frame_buf **p_fbuf );
+
+/**
+ * Put a frame to the port by reference. The frame must point to the
+ * payload of the frame buffer, and the payload must not be modified
+ * afterwards. The port adds its own reference to the buffer if it keeps
+ * the frame, so the caller still owns its reference. If the port doesn't
+ * support frames by reference, this is the same as
+ * #pjmedia_port_put_frame().
+ *
+ * @param port	    The media port.
+ * @param frame	    Frame to the put to the port.
+ * @param fbuf	    The frame buffer containing the payload.
+ *
+ * @return	    PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjmedia_port_put_frame_buf( pjmedia_port *port,
+						 pjmedia_frame *frame,
+						 pjmedia_frame_buf *fbuf );
+
 /**
  * Destroy port (and subsequent downstream ports)
  *
@@ -298,3 +298,668 @@ PJ_DEF(unsigned char) pjmedia_ulaw2alaw(
 
 #endif	/* PJMEDIA_HAS_ALAW_ULAW_TABLE */
 
+
+
+/*****************************************************************************
+ * Block conversions.
+ *
+ * The SIMD implementations compute the same values as the conversion
+ * tables, so they are only used when the tables are enabled.
+ */
+#include <pjmedia/mixer.h>
+
+#if defined(PJMEDIA_HAS_ALAW_ULAW_TABLE) && PJMEDIA_HAS_ALAW_ULAW_TABLE!=0 \
+    && PJMEDIA_HAS_SIMD
+#   if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#	define HAS_SSE2		1
+#	define HAS_AVX2		1
+#	define TARGET_SSE2	__attribute__((target("sse2")))
+#	define TARGET_AVX2	__attribute__((target("avx2")))
+#	include <immintrin.h>
+#   elif defined(_MSC_VER) && \
+	 (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#	define HAS_SSE2		1
+#	define HAS_AVX2		1
+#	define TARGET_SSE2
+#	define TARGET_AVX2
+#	include <immintrin.h>
+#   endif
+#   if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#	define HAS_NEON		1
+#	include <arm_neon.h>
+#   endif
+#endif
+
+#ifndef HAS_SSE2
+#   define HAS_SSE2	0
+#   define HAS_AVX2	0
+#endif
+#ifndef HAS_NEON
+#   define HAS_NEON	0
+#endif
+
+/* Largest U-Law magnitude before the bias, and the bias, both for the
+ * 14-bit magnitude.
+ */
+#define ULAW_CLIP	8159
+#define ULAW_BIAS	33
+
+
+/* Block conversions of an implementation. */
+struct g711_ops
+{
+    void (*encode)(pjmedia_g711_law, pj_uint8_t*, const pj_int16_t*,
+		   pj_size_t);
+    void (*decode)(pjmedia_g711_law, pj_int16_t*, const pj_uint8_t*,
+		   pj_size_t);
+};
+
+
+/*
+ * Portable C implementation, also used for the remaining samples of the
+ * SIMD implementations.
+ */
+static void encode_c(pjmedia_g711_law law, pj_uint8_t *dst,
+		     const pj_int16_t *src, pj_size_t count)
+{
+    pj_size_t i;
+
+    if (law == PJMEDIA_G711_ALAW) {
+	for (i=0; i<count; ++i)
+	    dst[i] = pjmedia_linear2alaw(src[i]);
+    } else {
+	for (i=0; i<count; ++i)
+	    dst[i] = pjmedia_linear2ulaw(src[i]);
+    }
+}
+
+static void decode_c(pjmedia_g711_law law, pj_int16_t *dst,
+		     const pj_uint8_t *src, pj_size_t len)
+{
+    pj_size_t i;
+
+    if (law == PJMEDIA_G711_ALAW) {
+	for (i=0; i<len; ++i)
+	    dst[i] = (pj_int16_t) pjmedia_alaw2linear(src[i]);
+    } else {
+	for (i=0; i<len; ++i)
+	    dst[i] = (pj_int16_t) pjmedia_ulaw2linear(src[i]);
+    }
+}
+
+static const struct g711_ops ops_c =
+{
+    &encode_c,
+    &decode_c
+};
+
+
+#if HAS_SSE2
+/*
+ * SSE2 implementation. There are no per lane shifts for 16bit values, so
+ * the conversions go through float: the encoders take the segment and the
+ * mantissa from the exponent and the leading mantissa bits of the
+ * magnitude converted to float, and the decoders build the float from the
+ * segment and the mantissa.
+ */
+
+/* Exponent and the four leading mantissa bits of the float value of each
+ * lane, which must be positive.
+ */
+TARGET_SSE2
+PJ_INLINE(__m128i) sse2_float_bits(__m128i v)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo, hi;
+
+    lo = _mm_castps_si128(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)));
+    hi = _mm_castps_si128(_mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero)));
+    return _mm_packs_epi32(_mm_srli_epi32(lo, 19), _mm_srli_epi32(hi, 19));
+}
+
+TARGET_SSE2
+PJ_INLINE(__m128i) sse2_linear2ulaw(__m128i x)
+{
+    __m128i neg = _mm_srai_epi16(x, 15);
+    __m128i v = _mm_srai_epi16(x, 2);
+    __m128i uval, mask;
+
+    /* Biased 14-bit magnitude, at least 0x21 */
+    v = _mm_sub_epi16(_mm_xor_si128(v, neg), neg);
+    v = _mm_min_epi16(v, _mm_set1_epi16(ULAW_CLIP));
+    v = _mm_add_epi16(v, _mm_set1_epi16(ULAW_BIAS));
+    v = _mm_min_epi16(v, _mm_set1_epi16(0x1FFF));
+
+    /* The segment is the exponent less 5 */
+    uval = _mm_sub_epi16(sse2_float_bits(v), _mm_set1_epi16((127+5) << 4));
+
+    mask = _mm_xor_si128(_mm_set1_epi16(0xFF),
+			 _mm_and_si128(neg, _mm_set1_epi16(0x80)));
+    return _mm_xor_si128(uval, mask);
+}
+
+TARGET_SSE2
+PJ_INLINE(__m128i) sse2_linear2alaw(__m128i x)
+{
+    __m128i neg = _mm_srai_epi16(x, 15);
+    __m128i v = _mm_and_si128(x, _mm_set1_epi16((short)0xFFFC));
+    __m128i small, aval, mask;
+
+    /* 13-bit magnitude */
+    v = _mm_sub_epi16(_mm_xor_si128(v, neg), neg);
+    v = _mm_srli_epi16(v, 3);
+    v = _mm_min_epi16(v, _mm_set1_epi16(0xFFF));
+
+    /* The segment is the exponent less 4. The first segment has the same
+     * step as the second, so its values are moved to the second segment
+     * and the segment number corrected afterwards.
+     */
+    small = _mm_cmplt_epi16(v, _mm_set1_epi16(0x20));
+    v = _mm_add_epi16(v, _mm_and_si128(small, _mm_set1_epi16(0x20)));
+    aval = _mm_sub_epi16(sse2_float_bits(v), _mm_set1_epi16((127+4) << 4));
+    aval = _mm_sub_epi16(aval, _mm_and_si128(small, _mm_set1_epi16(0x10)));
+
+    mask = _mm_xor_si128(_mm_set1_epi16(0xD5),
+			 _mm_and_si128(neg, _mm_set1_epi16(0x80)));
+    return _mm_xor_si128(aval, mask);
+}
+
+/* Value of (33 + 2 * mantissa) << (segment + 2), for the segment and the
+ * mantissa in the lower 7 bits of each lane, built as float.
+ */
+TARGET_SSE2
+PJ_INLINE(__m128i) sse2_segment_value(__m128i w)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i base = _mm_set1_epi32(((127+7) << 23) | (1 << 18));
+    __m128i lo, hi;
+
+    lo = _mm_add_epi32(_mm_slli_epi32(_mm_unpacklo_epi16(w, zero), 19), base);
+    hi = _mm_add_epi32(_mm_slli_epi32(_mm_unpackhi_epi16(w, zero), 19), base);
+    return _mm_packs_epi32(_mm_cvttps_epi32(_mm_castsi128_ps(lo)),
+			   _mm_cvttps_epi32(_mm_castsi128_ps(hi)));
+}
+
+TARGET_SSE2
+PJ_INLINE(__m128i) sse2_ulaw2linear(__m128i u)
+{
+    __m128i t, s;
+
+    u = _mm_xor_si128(u, _mm_set1_epi16(0xFF));
+    t = sse2_segment_value(_mm_and_si128(u, _mm_set1_epi16(0x7F)));
+    t = _mm_sub_epi16(t, _mm_set1_epi16(0x84));
+
+    /* Negate if the sign bit is set */
+    s = _mm_cmpeq_epi16(_mm_and_si128(u, _mm_set1_epi16(0x80)),
+			_mm_set1_epi16(0x80));
+    return _mm_sub_epi16(_mm_xor_si128(t, s), s);
+}
+
+TARGET_SSE2
+PJ_INLINE(__m128i) sse2_alaw2linear(__m128i a)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i first, t, s;
+
+    /* The first segment has the step of the second segment, without its
+     * offset.
+     */
+    a = _mm_xor_si128(a, _mm_set1_epi16(0x55));
+    first = _mm_cmpeq_epi16(_mm_and_si128(a, _mm_set1_epi16(0x70)), zero);
+    t = _mm_or_si128(_mm_and_si128(a, _mm_set1_epi16(0x7F)),
+		     _mm_and_si128(first, _mm_set1_epi16(0x10)));
+    t = sse2_segment_value(t);
+    t = _mm_sub_epi16(t, _mm_and_si128(first, _mm_set1_epi16(0x100)));
+
+    /* Negate if the sign bit is clear */
+    s = _mm_cmpeq_epi16(_mm_and_si128(a, _mm_set1_epi16(0x80)), zero);
+    return _mm_sub_epi16(_mm_xor_si128(t, s), s);
+}
+
+TARGET_SSE2
+static void encode_sse2(pjmedia_g711_law law, pj_uint8_t *dst,
+			const pj_int16_t *src, pj_size_t count)
+{
+    pj_size_t i;
+
+    for (i=0; i+16<=count; i+=16) {
+	__m128i x0 = _mm_loadu_si128((const __m128i*)(src+i));
+	__m128i x1 = _mm_loadu_si128((const __m128i*)(src+i+8));
+
+	if (law == PJMEDIA_G711_ALAW) {
+	    x0 = sse2_linear2alaw(x0);
+	    x1 = sse2_linear2alaw(x1);
+	} else {
+	    x0 = sse2_linear2ulaw(x0);
+	    x1 = sse2_linear2ulaw(x1);
+	}
+	_mm_storeu_si128((__m128i*)(dst+i), _mm_packus_epi16(x0, x1));
+    }
+
+    encode_c(law, dst+i, src+i, count-i);
+}
+
+TARGET_SSE2
+static void decode_sse2(pjmedia_g711_law law, pj_int16_t *dst,
+			const pj_uint8_t *src, pj_size_t len)
+{
+    const __m128i zero = _mm_setzero_si128();
+    pj_size_t i;
+
+    for (i=0; i+16<=len; i+=16) {
+	__m128i b = _mm_loadu_si128((const __m128i*)(src+i));
+	__m128i x0 = _mm_unpacklo_epi8(b, zero);
+	__m128i x1 = _mm_unpackhi_epi8(b, zero);
+
+	if (law == PJMEDIA_G711_ALAW) {
+	    x0 = sse2_alaw2linear(x0);
+	    x1 = sse2_alaw2linear(x1);
+	} else {
+	    x0 = sse2_ulaw2linear(x0);
+	    x1 = sse2_ulaw2linear(x1);
+	}
+	_mm_storeu_si128((__m128i*)(dst+i), x0);
+	_mm_storeu_si128((__m128i*)(dst+i+8), x1);
+    }
+
+    decode_c(law, dst+i, src+i, len-i);
+}
+
+static const struct g711_ops ops_sse2 =
+{
+    &encode_sse2,
+    &decode_sse2
+};
+
+#endif	/* HAS_SSE2 */
+
+
+#if HAS_AVX2
+/*
+ * AVX2 implementation, the same as the SSE2 implementation on 16 samples
+ * at a time.
+ */
+
+/* Unpacking and packing both work within the 128bit lanes, so the order
+ * of the samples is kept.
+ */
+TARGET_AVX2
+PJ_INLINE(__m256i) avx2_float_bits(__m256i v)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i lo, hi;
+
+    lo = _mm256_castps_si256(_mm256_cvtepi32_ps(
+				_mm256_unpacklo_epi16(v, zero)));
+    hi = _mm256_castps_si256(_mm256_cvtepi32_ps(
+				_mm256_unpackhi_epi16(v, zero)));
+    return _mm256_packs_epi32(_mm256_srli_epi32(lo, 19),
+			      _mm256_srli_epi32(hi, 19));
+}
+
+TARGET_AVX2
+PJ_INLINE(__m256i) avx2_linear2ulaw(__m256i x)
+{
+    __m256i neg = _mm256_srai_epi16(x, 15);
+    __m256i v = _mm256_srai_epi16(x, 2);
+    __m256i uval, mask;
+
+    v = _mm256_sub_epi16(_mm256_xor_si256(v, neg), neg);
+    v = _mm256_min_epi16(v, _mm256_set1_epi16(ULAW_CLIP));
+    v = _mm256_add_epi16(v, _mm256_set1_epi16(ULAW_BIAS));
+    v = _mm256_min_epi16(v, _mm256_set1_epi16(0x1FFF));
+
+    uval = _mm256_sub_epi16(avx2_float_bits(v),
+			    _mm256_set1_epi16((127+5) << 4));
+
+    mask = _mm256_xor_si256(_mm256_set1_epi16(0xFF),
+			    _mm256_and_si256(neg, _mm256_set1_epi16(0x80)));
+    return _mm256_xor_si256(uval, mask);
+}
+
+TARGET_AVX2
+PJ_INLINE(__m256i) avx2_linear2alaw(__m256i x)
+{
+    __m256i neg = _mm256_srai_epi16(x, 15);
+    __m256i v = _mm256_and_si256(x, _mm256_set1_epi16((short)0xFFFC));
+    __m256i small, aval, mask;
+
+    v = _mm256_sub_epi16(_mm256_xor_si256(v, neg), neg);
+    v = _mm256_srli_epi16(v, 3);
+    v = _mm256_min_epi16(v, _mm256_set1_epi16(0xFFF));
+
+    small = _mm256_cmpgt_epi16(_mm256_set1_epi16(0x20), v);
+    v = _mm256_add_epi16(v, _mm256_and_si256(small,
+					     _mm256_set1_epi16(0x20)));
+    aval = _mm256_sub_epi16(avx2_float_bits(v),
+			    _mm256_set1_epi16((127+4) << 4));
+    aval = _mm256_sub_epi16(aval, _mm256_and_si256(small,
+						   _mm256_set1_epi16(0x10)));
+
+    mask = _mm256_xor_si256(_mm256_set1_epi16(0xD5),
+			    _mm256_and_si256(neg, _mm256_set1_epi16(0x80)));
+    return _mm256_xor_si256(aval, mask);
+}
+
+TARGET_AVX2
+PJ_INLINE(__m256i) avx2_segment_value(__m256i w)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i base = _mm256_set1_epi32(((127+7) << 23) | (1 << 18));
+    __m256i lo, hi;
+
+    lo = _mm256_add_epi32(_mm256_slli_epi32(_mm256_unpacklo_epi16(w, zero),
+					    19), base);
+    hi = _mm256_add_epi32(_mm256_slli_epi32(_mm256_unpackhi_epi16(w, zero),
+					    19), base);
+    return _mm256_packs_epi32(_mm256_cvttps_epi32(_mm256_castsi256_ps(lo)),
+			      _mm256_cvttps_epi32(_mm256_castsi256_ps(hi)));
+}
+
+TARGET_AVX2
+PJ_INLINE(__m256i) avx2_ulaw2linear(__m256i u)
+{
+    __m256i t, s;
+
+    u = _mm256_xor_si256(u, _mm256_set1_epi16(0xFF));
+    t = avx2_segment_value(_mm256_and_si256(u, _mm256_set1_epi16(0x7F)));
+    t = _mm256_sub_epi16(t, _mm256_set1_epi16(0x84));
+
+    s = _mm256_cmpeq_epi16(_mm256_and_si256(u, _mm256_set1_epi16(0x80)),
+			   _mm256_set1_epi16(0x80));
+    return _mm256_sub_epi16(_mm256_xor_si256(t, s), s);
+}
+
+TARGET_AVX2
+PJ_INLINE(__m256i) avx2_alaw2linear(__m256i a)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i first, t, s;
+
+    a = _mm256_xor_si256(a, _mm256_set1_epi16(0x55));
+    first = _mm256_cmpeq_epi16(_mm256_and_si256(a, _mm256_set1_epi16(0x70)),
+			       zero);
+    t = _mm256_or_si256(_mm256_and_si256(a, _mm256_set1_epi16(0x7F)),
+			_mm256_and_si256(first, _mm256_set1_epi16(0x10)));
+    t = avx2_segment_value(t);
+    t = _mm256_sub_epi16(t, _mm256_and_si256(first,
+					     _mm256_set1_epi16(0x100)));
+
+    s = _mm256_cmpeq_epi16(_mm256_and_si256(a, _mm256_set1_epi16(0x80)),
+			   zero);
+    return _mm256_sub_epi16(_mm256_xor_si256(t, s), s);
+}
+
+TARGET_AVX2
+static void encode_avx2(pjmedia_g711_law law, pj_uint8_t *dst,
+			const pj_int16_t *src, pj_size_t count)
+{
+    pj_size_t i;
+
+    for (i=0; i+32<=count; i+=32) {
+	__m256i x0 = _mm256_loadu_si256((const __m256i*)(src+i));
+	__m256i x1 = _mm256_loadu_si256((const __m256i*)(src+i+16));
+
+	if (law == PJMEDIA_G711_ALAW) {
+	    x0 = avx2_linear2alaw(x0);
+	    x1 = avx2_linear2alaw(x1);
+	} else {
+	    x0 = avx2_linear2ulaw(x0);
+	    x1 = avx2_linear2ulaw(x1);
+	}
+
+	/* Packing works within the 128bit lanes, restore the order */
+	x0 = _mm256_permute4x64_epi64(_mm256_packus_epi16(x0, x1),
+				      _MM_SHUFFLE(3, 1, 2, 0));
+	_mm256_storeu_si256((__m256i*)(dst+i), x0);
+    }
+
+    encode_c(law, dst+i, src+i, count-i);
+}
+
+TARGET_AVX2
+static void decode_avx2(pjmedia_g711_law law, pj_int16_t *dst,
+			const pj_uint8_t *src, pj_size_t len)
+{
+    pj_size_t i;
+
+    for (i=0; i+16<=len; i+=16) {
+	__m256i x = _mm256_cvtepu8_epi16(
+			_mm_loadu_si128((const __m128i*)(src+i)));
+
+	if (law == PJMEDIA_G711_ALAW)
+	    x = avx2_alaw2linear(x);
+	else
+	    x = avx2_ulaw2linear(x);
+	_mm256_storeu_si256((__m256i*)(dst+i), x);
+    }
+
+    decode_c(law, dst+i, src+i, len-i);
+}
+
+static const struct g711_ops ops_avx2 =
+{
+    &encode_avx2,
+    &decode_avx2
+};
+
+#endif	/* HAS_AVX2 */
+
+
+#if HAS_NEON
+/*
+ * NEON implementation, using the per lane shifts and leading zero count.
+ */
+
+static uint16x8_t neon_linear2ulaw(int16x8_t x)
+{
+    uint16x8_t neg = vreinterpretq_u16_s16(vshrq_n_s16(x, 15));
+    int16x8_t m = vabsq_s16(vshrq_n_s16(x, 2));
+    uint16x8_t v, seg, uval, mask;
+
+    m = vminq_s16(m, vdupq_n_s16(ULAW_CLIP));
+    m = vaddq_s16(m, vdupq_n_s16(ULAW_BIAS));
+    v = vminq_u16(vreinterpretq_u16_s16(m), vdupq_n_u16(0x1FFF));
+
+    /* The segment is the bit length less 6 */
+    seg = vqsubq_u16(vsubq_u16(vdupq_n_u16(16), vclzq_u16(v)),
+		     vdupq_n_u16(6));
+
+    uval = vshlq_u16(v, vnegq_s16(vreinterpretq_s16_u16(
+				vaddq_u16(seg, vdupq_n_u16(1)))));
+    uval = vorrq_u16(vshlq_n_u16(seg, 4),
+		     vandq_u16(uval, vdupq_n_u16(0xF)));
+    mask = veorq_u16(vdupq_n_u16(0xFF), vandq_u16(neg, vdupq_n_u16(0x80)));
+    return veorq_u16(uval, mask);
+}
+
+static uint16x8_t neon_linear2alaw(int16x8_t x)
+{
+    int16x8_t neg = vshrq_n_s16(x, 15);
+    int16x8_t m = vandq_s16(x, vdupq_n_s16((short)0xFFFC));
+    uint16x8_t v, seg, sh, aval, mask;
+
+    m = vsubq_s16(veorq_s16(m, neg), neg);
+    v = vshrq_n_u16(vreinterpretq_u16_s16(m), 3);
+    v = vminq_u16(v, vdupq_n_u16(0xFFF));
+
+    /* The segment is the bit length less 5, the shift is at least 1 */
+    seg = vqsubq_u16(vsubq_u16(vdupq_n_u16(16), vclzq_u16(v)),
+		     vdupq_n_u16(5));
+    sh = vmaxq_u16(seg, vdupq_n_u16(1));
+
+    aval = vshlq_u16(v, vnegq_s16(vreinterpretq_s16_u16(sh)));
+    aval = vorrq_u16(vshlq_n_u16(seg, 4),
+		     vandq_u16(aval, vdupq_n_u16(0xF)));
+    mask = veorq_u16(vdupq_n_u16(0xD5),
+		     vandq_u16(vreinterpretq_u16_s16(neg), vdupq_n_u16(0x80)));
+    return veorq_u16(aval, mask);
+}
+
+static int16x8_t neon_ulaw2linear(uint16x8_t u)
+{
+    uint16x8_t t, e;
+    int16x8_t r, s;
+
+    u = veorq_u16(u, vdupq_n_u16(0xFF));
+    e = vandq_u16(vshrq_n_u16(u, 4), vdupq_n_u16(7));
+    t = vaddq_u16(vshlq_n_u16(vandq_u16(u, vdupq_n_u16(0xF)), 3),
+		  vdupq_n_u16(0x84));
+    t = vshlq_u16(t, vreinterpretq_s16_u16(e));
+    r = vsubq_s16(vreinterpretq_s16_u16(t), vdupq_n_s16(0x84));
+
+    s = vreinterpretq_s16_u16(vtstq_u16(u, vdupq_n_u16(0x80)));
+    return vsubq_s16(veorq_s16(r, s), s);
+}
+
+static int16x8_t neon_alaw2linear(uint16x8_t a)
+{
+    uint16x8_t seg, t;
+    int16x8_t s;
+
+    a = veorq_u16(a, vdupq_n_u16(0x55));
+    seg = vandq_u16(vshrq_n_u16(a, 4), vdupq_n_u16(7));
+    t = vaddq_u16(vshlq_n_u16(vandq_u16(a, vdupq_n_u16(0xF)), 4),
+		  vdupq_n_u16(0x108));
+    t = vsubq_u16(t, vandq_u16(vceqq_u16(seg, vdupq_n_u16(0)),
+			       vdupq_n_u16(0x100)));
+    t = vshlq_u16(t, vreinterpretq_s16_u16(vqsubq_u16(seg,
+						      vdupq_n_u16(1))));
+
+    s = vreinterpretq_s16_u16(vceqq_u16(vandq_u16(a, vdupq_n_u16(0x80)),
+					vdupq_n_u16(0)));
+    return vsubq_s16(veorq_s16(vreinterpretq_s16_u16(t), s), s);
+}
+
+static void encode_neon(pjmedia_g711_law law, pj_uint8_t *dst,
+			const pj_int16_t *src, pj_size_t count)
+{
+    pj_size_t i;
+
+    for (i=0; i+16<=count; i+=16) {
+	int16x8_t x0 = vld1q_s16(src+i);
+	int16x8_t x1 = vld1q_s16(src+i+8);
+	uint16x8_t y0, y1;
+
+	if (law == PJMEDIA_G711_ALAW) {
+	    y0 = neon_linear2alaw(x0);
+	    y1 = neon_linear2alaw(x1);
+	} else {
+	    y0 = neon_linear2ulaw(x0);
+	    y1 = neon_linear2ulaw(x1);
+	}
+	vst1q_u8(dst+i, vcombine_u8(vmovn_u16(y0), vmovn_u16(y1)));
+    }
+
+    encode_c(law, dst+i, src+i, count-i);
+}
+
+static void decode_neon(pjmedia_g711_law law, pj_int16_t *dst,
+			const pj_uint8_t *src, pj_size_t len)
+{
+    pj_size_t i;
+
+    for (i=0; i+16<=len; i+=16) {
+	uint8x16_t b = vld1q_u8(src+i);
+	uint16x8_t x0 = vmovl_u8(vget_low_u8(b));
+	uint16x8_t x1 = vmovl_u8(vget_high_u8(b));
+
+	if (law == PJMEDIA_G711_ALAW) {
+	    vst1q_s16(dst+i, neon_alaw2linear(x0));
+	    vst1q_s16(dst+i+8, neon_alaw2linear(x1));
+	} else {
+	    vst1q_s16(dst+i, neon_ulaw2linear(x0));
+	    vst1q_s16(dst+i+8, neon_ulaw2linear(x1));
+	}
+    }
+
+    decode_c(law, dst+i, src+i, len-i);
+}
+
+static const struct g711_ops ops_neon =
+{
+    &encode_neon,
+    &decode_neon
+};
+
+#endif	/* HAS_NEON */
+
+
+/* Get the conversions of the implementation selected for the mixing
+ * primitives, which is known to be supported by the CPU.
+ */
+static const struct g711_ops *get_g711_ops(void)
+{
+    switch (pjmedia_mix_get_impl()) {
+#if HAS_SSE2
+    case PJMEDIA_MIX_IMPL_SSE2:
+	return &ops_sse2;
+#endif
+#if HAS_AVX2
+    case PJMEDIA_MIX_IMPL_AVX2:
+	return &ops_avx2;
+#endif
+#if HAS_NEON
+    case PJMEDIA_MIX_IMPL_NEON:
+	return &ops_neon;
+#endif
+    default:
+	return &ops_c;
+    }
+}
+
+
+PJ_DEF(void) pjmedia_ulaw_encode(pj_uint8_t *dst, const pj_int16_t *src,
+				 pj_size_t count)
+{
+    (*get_g711_ops()->encode)(PJMEDIA_G711_ULAW, dst, src, count);
+}
+
+
+PJ_DEF(void) pjmedia_alaw_encode(pj_uint8_t *dst, const pj_int16_t *src,
+				 pj_size_t count)
+{
+    (*get_g711_ops()->encode)(PJMEDIA_G711_ALAW, dst, src, count);
+}
+
+
+PJ_DEF(void) pjmedia_ulaw_decode(pj_int16_t *dst, const pj_uint8_t *src,
+				 pj_size_t len)
+{
+    (*get_g711_ops()->decode)(PJMEDIA_G711_ULAW, dst, src, len);
+}
+
+
+PJ_DEF(void) pjmedia_alaw_decode(pj_int16_t *dst, const pj_uint8_t *src,
+				 pj_size_t len)
+{
+    (*get_g711_ops()->decode)(PJMEDIA_G711_ALAW, dst, src, len);
+}
+
+
+PJ_DEF(void) pjmedia_g711_encode_batch(pjmedia_g711_law law,
+				       pj_uint8_t *const dst[],
+				       const pj_int16_t *const src[],
+				       unsigned stream_cnt,
+				       pj_size_t count)
+{
+    const struct g711_ops *ops = get_g711_ops();
+    unsigned i;
+
+    for (i=0; i<stream_cnt; ++i)
+	(*ops->encode)(law, dst[i], src[i], count);
+}
+
+
+PJ_DEF(void) pjmedia_g711_decode_batch(pjmedia_g711_law law,
+				       pj_int16_t *const dst[],
+				       const pj_uint8_t *const src[],
+				       unsigned stream_cnt,
+				       pj_size_t len)
+{
+    const struct g711_ops *ops = get_g711_ops();
+    unsigned i;
+
+    for (i=0; i<stream_cnt; ++i)
+	(*ops->decode)(law, dst[i], src[i], len);
+}
@@ -48,6 +48,24 @@ static pj_status_t get_frame(pjmedia_port *this_port,
 }
 
 
+static pj_status_t put_frame_buf(pjmedia_port *this_port,
+				 pjmedia_frame *frame,
+				 pjmedia_frame_buf *fbuf)
+{
+    struct bidir_port *p = (struct bidir_port*)this_port;
+    return pjmedia_port_put_frame_buf(p->put_port, frame, fbuf);
+}
+
+
+static pj_status_t get_frame_buf(pjmedia_port *this_port,
+				 pjmedia_frame *frame,
+				 pjmedia_frame_buf **p_fbuf)
+{
+    struct bidir_port *p = (struct bidir_port*)this_port;
+    return pjmedia_port_get_frame_buf(p->get_port, frame, p_fbuf);
+}
+
+
 PJ_DEF(pj_status_t) pjmedia_bidirectional_port_create( pj_pool_t *pool,
 						       pjmedia_port *get_port,
 						       pjmedia_port *put_port,
@@ -71,6 +89,14 @@ PJ_DEF(pj_status_t) pjmedia_bidirectional_port_create( pj_pool_t *pool,
     port->base.get_frame = &get_frame;
     port->base.put_frame = &put_frame;
 
+    /* Only pass references when the other end takes them, so that the
+     * callers don't prepare frame buffers for nothing.
+     */
+    if (get_port->get_frame_buf)
+	port->base.get_frame_buf = &get_frame_buf;
+    if (put_port->put_frame_buf)
+	port->base.put_frame_buf = &put_frame_buf;
+
     *p_port = &port->base;
 
     return PJ_SUCCESS;
@@ -0,0 +1,997 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pjmedia/conf_group.h>
+#include <pjmedia/clock.h>
+#include <pjmedia/errno.h>
+#include <pj/assert.h>
+#include <pj/hash.h>
+#include <pj/list.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+
+
+#define THIS_FILE	"conf_group.c"
+
+#define LINK_SIGNATURE	PJMEDIA_SIG_PORT_CONF_LINK
+#define INVALID_SLOT	((unsigned)-1)
+
+
+/*
+ * A shard of the group.
+ */
+struct shard
+{
+    pjmedia_conf	*conf;		/**< The conference bridge.	    */
+    pjmedia_port	*master_port;	/**< Port zero of the bridge.	    */
+    pj_int16_t		*buf;		/**< Frame buffer for the tick.	    */
+};
+
+
+/*
+ * Placement of ports with the same affinity.
+ */
+struct affinity
+{
+    PJ_DECL_LIST_MEMBER(struct affinity);
+    pj_uint32_t		 value;		/**< The affinity.		    */
+    unsigned		 shard;		/**< Shard of the ports.	    */
+    unsigned		 ref_cnt;	/**< Number of ports.		    */
+    pj_hash_entry_buf	 hbuf;		/**< Hash table entry.		    */
+};
+
+
+/*
+ * Group slot.
+ */
+struct slot_info
+{
+    pj_bool_t		 used;		/**< Slot is in use.		    */
+    struct affinity	*affinity;	/**< Affinity, or NULL.		    */
+};
+
+
+/*
+ * A link carries the signal of a port to another shard. The tx port
+ * listens to the source port in the source shard, and the rx port plays
+ * it in the destination shard. The frame written in a tick is read in
+ * the next tick, so the shards can run at the same time. The source
+ * shard mixes directly to a frame buffer, which the link keeps by
+ * reference until the destination shard reads it.
+ */
+struct link
+{
+    PJ_DECL_LIST_MEMBER(struct link);
+    pj_pool_t		*pool;		/**< Pool of the link.		    */
+    pjmedia_conf_group	*group;		/**< The group.			    */
+    unsigned		 src_slot;	/**< Source port, in the group.	    */
+    unsigned		 dst_shard;	/**< Destination shard.		    */
+    unsigned		 ref_cnt;	/**< Number of connections.	    */
+    pjmedia_port	 tx_port;	/**< Port in the source shard.	    */
+    pjmedia_port	 rx_port;	/**< Port in the destination shard. */
+    unsigned		 tx_slot;	/**< Slot of tx_port.		    */
+    unsigned		 rx_slot;	/**< Slot of rx_port.		    */
+    pjmedia_frame_buf	*fbuf[2];	/**< Frames, by tick parity.	    */
+    pj_size_t		 size[2];	/**< Size of the frames.	    */
+};
+
+
+/*
+ * Connection between ports in different shards.
+ */
+struct cross_conn
+{
+    PJ_DECL_LIST_MEMBER(struct cross_conn);
+    unsigned		 src_slot;	/**< Source port, in the group.	    */
+    unsigned		 sink_slot;	/**< Sink port, in the group.	    */
+    struct link		*link;		/**< The link used.		    */
+};
+
+
+/*
+ * Conference bridge group.
+ */
+struct pjmedia_conf_group
+{
+    pj_pool_t		*pool;		/**< Pool.			    */
+    pj_mutex_t		*mutex;		/**< Protects placement and links.  */
+    pjmedia_conf_param	 conf_param;	/**< Shard parameters.		    */
+    unsigned		 shard_cnt;	/**< Number of shards.		    */
+    struct shard	*shards;	/**< Shards.			    */
+    struct slot_info	*slots;		/**< Group slots.		    */
+    pjmedia_frame_pool	*frame_pool;	/**< Frames copied to the links.    */
+
+    pj_hash_table_t	*affinity_ht;	/**< Affinity to placement.	    */
+    struct affinity	 free_affinity;	/**< Unused affinity entries.	    */
+    struct link		 links;		/**< Links in use.		    */
+    struct cross_conn	 conns;		/**< Connections across shards.	    */
+    struct cross_conn	 free_conns;	/**< Unused connection entries.	    */
+
+    pjmedia_clock	*clock;		/**< Group clock, if any.	    */
+    pj_uint32_t		 tick_cnt;	/**< Ticks so far.		    */
+    pj_timestamp	 tick_ts;	/**< Timestamp of the tick.	    */
+
+    /* Worker threads, see conference.c */
+    unsigned		 worker_cnt;	/**< Number of worker threads.	    */
+    pj_thread_t		**workers;	/**< Worker threads.		    */
+    pj_sem_t		*job_sem;	/**< Signals workers to start.	    */
+    pj_sem_t		*done_sem;	/**< Signals a worker is done.	    */
+    pj_atomic_t		*job_idx;	/**< Next shard to process.	    */
+    pj_bool_t		 quit;		/**< Workers must quit.		    */
+};
+
+
+/* Group slot number of a port */
+#define GROUP_SLOT(group, shard, slot) \
+	    ((shard) * (group)->conf_param.max_slots + (slot))
+#define SHARD_OF(group, gslot)	((gslot) / (group)->conf_param.max_slots)
+#define SLOT_OF(group, gslot)	((gslot) % (group)->conf_param.max_slots)
+
+
+static void clock_callback(const pj_timestamp *ts, void *user_data);
+static int worker_thread(void *arg);
+
+
+/*
+ * Store a frame in the link, replacing the frame of the previous tick
+ * with the same parity if it was not read.
+ */
+static void link_store(struct link *link, pjmedia_frame_buf *fbuf,
+		       pj_size_t size)
+{
+    unsigned idx = link->group->tick_cnt & 1;
+
+    if (link->fbuf[idx])
+	pjmedia_frame_buf_dec_ref(link->fbuf[idx]);
+    link->fbuf[idx] = fbuf;
+    link->size[idx] = size;
+}
+
+
+/*
+ * Take the frame of the previous tick from the link.
+ */
+static pjmedia_frame_buf *link_take(struct link *link, pj_size_t *size)
+{
+    unsigned idx = (link->group->tick_cnt & 1) ^ 1;
+    pjmedia_frame_buf *fbuf = link->fbuf[idx];
+
+    link->fbuf[idx] = NULL;
+    *size = link->size[idx];
+    return fbuf;
+}
+
+
+/*
+ * Link tx port callbacks, called by the source shard.
+ */
+static pj_status_t link_put_frame(pjmedia_port *this_port,
+				  pjmedia_frame *frame)
+{
+    struct link *link = (struct link*) this_port->port_data.pdata;
+    pjmedia_frame_pool *fpool = link->group->frame_pool;
+    pjmedia_frame_buf *fbuf = NULL;
+
+    if (frame->type == PJMEDIA_FRAME_TYPE_AUDIO &&
+	frame->size <= pjmedia_frame_pool_get_buf_size(fpool) &&
+	pjmedia_frame_pool_alloc(fpool, &fbuf) == PJ_SUCCESS)
+    {
+	pj_memcpy(fbuf->buf, frame->buf, frame->size);
+    }
+    link_store(link, fbuf, frame->size);
+
+    return PJ_SUCCESS;
+}
+
+static pj_status_t link_put_frame_buf(pjmedia_port *this_port,
+				      pjmedia_frame *frame,
+				      pjmedia_frame_buf *fbuf)
+{
+    struct link *link = (struct link*) this_port->port_data.pdata;
+
+    if (frame->type == PJMEDIA_FRAME_TYPE_AUDIO) {
+	pjmedia_frame_buf_add_ref(fbuf);
+	link_store(link, fbuf, frame->size);
+    } else {
+	link_store(link, NULL, 0);
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Link rx port callbacks, called by the destination shard.
+ */
+static pj_status_t link_get_frame(pjmedia_port *this_port,
+				  pjmedia_frame *frame)
+{
+    struct link *link = (struct link*) this_port->port_data.pdata;
+    pjmedia_frame_buf *fbuf;
+    pj_size_t size;
+
+    fbuf = link_take(link, &size);
+    if (fbuf) {
+	pj_memcpy(frame->buf, fbuf->buf, size);
+	frame->type = PJMEDIA_FRAME_TYPE_AUDIO;
+	frame->size = size;
+	pjmedia_frame_buf_dec_ref(fbuf);
+    } else {
+	frame->type = PJMEDIA_FRAME_TYPE_NONE;
+	frame->size = 0;
+    }
+
+    return PJ_SUCCESS;
+}
+
+static pj_status_t link_get_frame_buf(pjmedia_port *this_port,
+				      pjmedia_frame *frame,
+				      pjmedia_frame_buf **p_fbuf)
+{
+    struct link *link = (struct link*) this_port->port_data.pdata;
+    pj_size_t size;
+
+    /* The reference of the link is given to the caller */
+    *p_fbuf = link_take(link, &size);
+    if (*p_fbuf) {
+	frame->type = PJMEDIA_FRAME_TYPE_AUDIO;
+	frame->buf = (*p_fbuf)->buf;
+	frame->size = size;
+    } else {
+	frame->type = PJMEDIA_FRAME_TYPE_NONE;
+	frame->size = 0;
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(void) pjmedia_conf_group_param_default(pjmedia_conf_group_param *param)
+{
+    pj_bzero(param, sizeof(*param));
+    param->shard_cnt = 4;
+    pjmedia_conf_param_default(&param->conf_param);
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_conf_group_create(pj_pool_t *pool,
+				const pjmedia_conf_group_param *param,
+				pjmedia_conf_group **p_group)
+{
+    pjmedia_conf_group *group;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pool && param && p_group, PJ_EINVAL);
+    PJ_ASSERT_RETURN(param->shard_cnt > 0 &&
+		     param->conf_param.max_slots > 1, PJ_EINVAL);
+
+    group = PJ_POOL_ZALLOC_T(pool, pjmedia_conf_group);
+    group->pool = pool;
+    group->conf_param = param->conf_param;
+    group->conf_param.options |= PJMEDIA_CONF_NO_DEVICE;
+    group->shard_cnt = param->shard_cnt;
+    pj_list_init(&group->free_affinity);
+    pj_list_init(&group->links);
+    pj_list_init(&group->conns);
+    pj_list_init(&group->free_conns);
+
+    group->shards = (struct shard*)
+		    pj_pool_calloc(pool, group->shard_cnt, sizeof(struct shard));
+    group->slots = (struct slot_info*)
+		   pj_pool_calloc(pool, group->shard_cnt *
+				  group->conf_param.max_slots,
+				  sizeof(struct slot_info));
+    group->affinity_ht = pj_hash_create(pool, 255);
+    PJ_ASSERT_RETURN(group->shards && group->slots && group->affinity_ht,
+		     PJ_ENOMEM);
+
+    status = pj_mutex_create_simple(pool, "confgroup", &group->mutex);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    status = pjmedia_frame_pool_create(pool, "cgframe%p",
+				       group->conf_param.samples_per_frame *
+				       sizeof(pj_int16_t), 0,
+				       &group->frame_pool);
+    if (status != PJ_SUCCESS) {
+	pj_mutex_destroy(group->mutex);
+	return status;
+    }
+
+    /* Create the shards */
+    for (i=0; i<group->shard_cnt; ++i) {
+	struct shard *shard = &group->shards[i];
+
+	status = pjmedia_conf_create2(pool, &group->conf_param, &shard->conf);
+	if (status != PJ_SUCCESS) {
+	    pjmedia_conf_group_destroy(group);
+	    return status;
+	}
+
+	shard->master_port = pjmedia_conf_get_master_port(shard->conf);
+	shard->buf = (pj_int16_t*)
+		     pj_pool_alloc(pool, group->conf_param.samples_per_frame *
+					 sizeof(pj_int16_t));
+    }
+
+    /* Create worker threads */
+    if (param->worker_threads) {
+	status = pj_sem_create(pool, "cg_job", 0, param->worker_threads,
+			       &group->job_sem);
+	if (status == PJ_SUCCESS)
+	    status = pj_sem_create(pool, "cg_done", 0, param->worker_threads,
+				   &group->done_sem);
+	if (status == PJ_SUCCESS)
+	    status = pj_atomic_create(pool, 0, &group->job_idx);
+	if (status != PJ_SUCCESS) {
+	    pjmedia_conf_group_destroy(group);
+	    return status;
+	}
+
+	group->workers = (pj_thread_t**)
+			 pj_pool_calloc(pool, param->worker_threads,
+					sizeof(pj_thread_t*));
+	for (i=0; i<param->worker_threads; ++i) {
+	    status = pj_thread_create(pool, "cg_worker", &worker_thread,
+				      group, 0, 0, &group->workers[i]);
+	    if (status != PJ_SUCCESS) {
+		pjmedia_conf_group_destroy(group);
+		return status;
+	    }
+	    ++group->worker_cnt;
+	}
+    }
+
+    /* Create and start the clock */
+    if (!param->no_clock) {
+	status = pjmedia_clock_create(pool,
+				      group->conf_param.sampling_rate,
+				      group->conf_param.channel_count,
+				      group->conf_param.samples_per_frame,
+				      0, &clock_callback, group,
+				      &group->clock);
+	if (status == PJ_SUCCESS)
+	    status = pjmedia_clock_start(group->clock);
+	if (status != PJ_SUCCESS) {
+	    pjmedia_conf_group_destroy(group);
+	    return status;
+	}
+    }
+
+    PJ_LOG(4,(THIS_FILE, "Conference bridge group created: %d shards of %d "
+	      "slots, %d worker threads", group->shard_cnt,
+	      group->conf_param.max_slots, group->worker_cnt));
+
+    *p_group = group;
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Move a link from the group to the list of links to free. The links
+ * are freed with free_links() once the group mutex is released.
+ */
+static void unlink_link(struct link *link, struct link *dead)
+{
+    pj_list_erase(link);
+    pj_list_push_back(dead, link);
+}
+
+
+/*
+ * Remove the ports of the links from the shards and free the links.
+ * Removing a port waits for the running tick of its shard to end, so
+ * this must not be called with the group mutex held.
+ */
+static void free_links(pjmedia_conf_group *group, struct link *dead)
+{
+    while (!pj_list_empty(dead)) {
+	struct link *link = dead->next;
+	struct shard *src_shard = &group->shards[SHARD_OF(group,
+							  link->src_slot)];
+	struct shard *dst_shard = &group->shards[link->dst_shard];
+
+	pj_list_erase(link);
+
+	if (link->rx_slot != INVALID_SLOT)
+	    pjmedia_conf_remove_port(dst_shard->conf, link->rx_slot);
+	pjmedia_conf_remove_port(src_shard->conf, link->tx_slot);
+	if (link->fbuf[0])
+	    pjmedia_frame_buf_dec_ref(link->fbuf[0]);
+	if (link->fbuf[1])
+	    pjmedia_frame_buf_dec_ref(link->fbuf[1]);
+	pj_pool_release(link->pool);
+    }
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_conf_group_destroy(pjmedia_conf_group *group)
+{
+    unsigned i;
+
+    PJ_ASSERT_RETURN(group, PJ_EINVAL);
+
+    if (group->clock) {
+	pjmedia_clock_destroy(group->clock);
+	group->clock = NULL;
+    }
+
+    /* Stop worker threads */
+    if (group->worker_cnt) {
+	group->quit = PJ_TRUE;
+	for (i=0; i<group->worker_cnt; ++i)
+	    pj_sem_post(group->job_sem);
+	for (i=0; i<group->worker_cnt; ++i) {
+	    pj_thread_join(group->workers[i]);
+	    pj_thread_destroy(group->workers[i]);
+	}
+	group->worker_cnt = 0;
+    }
+    if (group->job_idx) {
+	pj_atomic_destroy(group->job_idx);
+	group->job_idx = NULL;
+    }
+    if (group->done_sem) {
+	pj_sem_destroy(group->done_sem);
+	group->done_sem = NULL;
+    }
+    if (group->job_sem) {
+	pj_sem_destroy(group->job_sem);
+	group->job_sem = NULL;
+    }
+
+    /* Destroy links */
+    free_links(group, &group->links);
+
+    /* Destroy shards */
+    for (i=0; i<group->shard_cnt; ++i) {
+	if (group->shards[i].conf) {
+	    pjmedia_conf_destroy(group->shards[i].conf);
+	    group->shards[i].conf = NULL;
+	}
+    }
+
+    if (group->frame_pool) {
+	pjmedia_frame_pool_destroy(group->frame_pool);
+	group->frame_pool = NULL;
+    }
+
+    if (group->mutex) {
+	pj_mutex_destroy(group->mutex);
+	group->mutex = NULL;
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Find the least loaded shard with a free slot.
+ */
+static int find_shard(pjmedia_conf_group *group)
+{
+    unsigned i, best_cnt = group->conf_param.max_slots;
+    int best = -1;
+
+    for (i=0; i<group->shard_cnt; ++i) {
+	unsigned cnt = pjmedia_conf_get_port_count(group->shards[i].conf);
+
+	if (cnt < best_cnt) {
+	    best_cnt = cnt;
+	    best = i;
+	}
+    }
+
+    return best;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_conf_group_add_port(pjmedia_conf_group *group,
+						pj_pool_t *pool,
+						pjmedia_port *port,
+						const pj_str_t *name,
+						pj_uint32_t affinity,
+						unsigned *p_slot)
+{
+    struct affinity *aff = NULL;
+    pj_uint32_t hval = 0;
+    struct shard *shard;
+    int shard_idx;
+    unsigned slot, gslot;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(group && pool && port, PJ_EINVAL);
+
+    pj_mutex_lock(group->mutex);
+
+    /* Find the shard of the affinity, or the least loaded shard */
+    if (affinity) {
+	aff = (struct affinity*)
+	      pj_hash_get(group->affinity_ht, &affinity, sizeof(affinity),
+			  &hval);
+    }
+
+    if (aff) {
+	shard_idx = aff->shard;
+	if (pjmedia_conf_get_port_count(group->shards[shard_idx].conf) >=
+	    group->conf_param.max_slots)
+	{
+	    pj_mutex_unlock(group->mutex);
+	    return PJ_ETOOMANY;
+	}
+    } else {
+	shard_idx = find_shard(group);
+	if (shard_idx < 0) {
+	    pj_mutex_unlock(group->mutex);
+	    return PJ_ETOOMANY;
+	}
+    }
+
+    shard = &group->shards[shard_idx];
+    status = pjmedia_conf_add_port(shard->conf, pool, port, name, &slot);
+    if (status != PJ_SUCCESS) {
+	pj_mutex_unlock(group->mutex);
+	return status;
+    }
+
+    /* Register new affinity */
+    if (affinity && !aff) {
+	if (!pj_list_empty(&group->free_affinity)) {
+	    aff = group->free_affinity.next;
+	    pj_list_erase(aff);
+	} else {
+	    aff = PJ_POOL_ZALLOC_T(group->pool, struct affinity);
+	}
+	aff->value = affinity;
+	aff->shard = shard_idx;
+	aff->ref_cnt = 0;
+	pj_hash_set_np(group->affinity_ht, &aff->value, sizeof(aff->value),
+		       hval, aff->hbuf, aff);
+    }
+    if (aff)
+	++aff->ref_cnt;
+
+    gslot = GROUP_SLOT(group, shard_idx, slot);
+    group->slots[gslot].used = PJ_TRUE;
+    group->slots[gslot].affinity = aff;
+
+    pj_mutex_unlock(group->mutex);
+
+    PJ_LOG(5,(THIS_FILE, "Port %d placed in shard %d slot %d (affinity %u)",
+	      gslot, shard_idx, slot, affinity));
+
+    if (p_slot)
+	*p_slot = gslot;
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Remove a connection across shards. The link is moved to the dead list
+ * when it is no longer used.
+ */
+static void remove_cross_conn(pjmedia_conf_group *group,
+			      struct cross_conn *conn,
+			      struct link *dead)
+{
+    struct link *link = conn->link;
+    struct shard *dst_shard = &group->shards[link->dst_shard];
+
+    pjmedia_conf_disconnect_port(dst_shard->conf, link->rx_slot,
+				 SLOT_OF(group, conn->sink_slot));
+
+    pj_list_erase(conn);
+    pj_list_push_back(&group->free_conns, conn);
+
+    if (--link->ref_cnt == 0)
+	unlink_link(link, dead);
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_conf_group_remove_port(pjmedia_conf_group *group,
+						   unsigned slot)
+{
+    struct cross_conn *conn;
+    struct affinity *aff;
+    struct link dead;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(group, PJ_EINVAL);
+    PJ_ASSERT_RETURN(slot < group->shard_cnt * group->conf_param.max_slots,
+		     PJ_EINVAL);
+
+    pj_list_init(&dead);
+
+    pj_mutex_lock(group->mutex);
+
+    if (!group->slots[slot].used) {
+	pj_mutex_unlock(group->mutex);
+	return PJ_EINVAL;
+    }
+
+    /* Remove connections to other shards */
+    conn = group->conns.next;
+    while (conn != &group->conns) {
+	struct cross_conn *next = conn->next;
+
+	if (conn->src_slot == slot || conn->sink_slot == slot)
+	    remove_cross_conn(group, conn, &dead);
+	conn = next;
+    }
+
+    /* Release the affinity */
+    aff = group->slots[slot].affinity;
+    if (aff && --aff->ref_cnt == 0) {
+	pj_hash_set_np(group->affinity_ht, &aff->value, sizeof(aff->value),
+		       0, aff->hbuf, NULL);
+	pj_list_push_back(&group->free_affinity, aff);
+    }
+
+    group->slots[slot].used = PJ_FALSE;
+    group->slots[slot].affinity = NULL;
+
+    pj_mutex_unlock(group->mutex);
+
+    /* Removing the ports waits for the tick of the shards */
+    free_links(group, &dead);
+    status = pjmedia_conf_remove_port(group->shards[SHARD_OF(group,slot)].conf,
+				      SLOT_OF(group, slot));
+
+    return status;
+}
+
+
+/*
+ * Find or create the link from a port to a shard.
+ */
+static pj_status_t get_link(pjmedia_conf_group *group, unsigned src_slot,
+			    unsigned dst_shard, struct link *dead,
+			    struct link **p_link)
+{
+    struct shard *src = &group->shards[SHARD_OF(group, src_slot)];
+    struct shard *dst = &group->shards[dst_shard];
+    const pjmedia_conf_param *cp = &group->conf_param;
+    pj_str_t name;
+    struct link *link;
+    pj_pool_t *pool;
+    pj_status_t status;
+
+    for (link=group->links.next; link!=&group->links; link=link->next) {
+	if (link->src_slot == src_slot && link->dst_shard == dst_shard) {
+	    *p_link = link;
+	    return PJ_SUCCESS;
+	}
+    }
+
+    /* Both shards need a free slot */
+    if (pjmedia_conf_get_port_count(src->conf) >= cp->max_slots ||
+	pjmedia_conf_get_port_count(dst->conf) >= cp->max_slots)
+    {
+	return PJ_ETOOMANY;
+    }
+
+    /* Links come and go with the calls, so each has its own pool */
+    pool = pj_pool_create(group->pool->factory, "cglink%p", 1000, 1000,
+			  NULL);
+    if (!pool)
+	return PJ_ENOMEM;
+
+    link = PJ_POOL_ZALLOC_T(pool, struct link);
+    link->pool = pool;
+    link->group = group;
+    link->src_slot = src_slot;
+    link->dst_shard = dst_shard;
+    link->rx_slot = INVALID_SLOT;
+
+    name = pj_str(pool->obj_name);
+    pjmedia_port_info_init(&link->tx_port.info, &name, LINK_SIGNATURE,
+			   cp->sampling_rate, cp->channel_count,
+			   cp->bits_per_sample, cp->samples_per_frame);
+    link->tx_port.port_data.pdata = link;
+    link->tx_port.put_frame = &link_put_frame;
+    link->tx_port.put_frame_buf = &link_put_frame_buf;
+
+    pjmedia_port_info_init(&link->rx_port.info, &name, LINK_SIGNATURE,
+			   cp->sampling_rate, cp->channel_count,
+			   cp->bits_per_sample, cp->samples_per_frame);
+    link->rx_port.port_data.pdata = link;
+    link->rx_port.get_frame = &link_get_frame;
+    link->rx_port.get_frame_buf = &link_get_frame_buf;
+
+    status = pjmedia_conf_add_port(src->conf, pool, &link->tx_port, &name,
+				   &link->tx_slot);
+    if (status != PJ_SUCCESS) {
+	pj_pool_release(pool);
+	return status;
+    }
+
+    status = pjmedia_conf_add_port(dst->conf, pool, &link->rx_port, &name,
+				   &link->rx_slot);
+    if (status != PJ_SUCCESS) {
+	/* The tx port is removed when the group mutex is released */
+	link->rx_slot = INVALID_SLOT;
+	pj_list_push_back(dead, link);
+	return status;
+    }
+
+    pjmedia_conf_connect_port(src->conf, SLOT_OF(group, src_slot),
+			      link->tx_slot, 0);
+
+    pj_list_push_back(&group->links, link);
+
+    PJ_LOG(5,(THIS_FILE, "Link created from port %d to shard %d",
+	      src_slot, dst_shard));
+
+    *p_link = link;
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_conf_group_connect_port(pjmedia_conf_group *group,
+						    unsigned src_slot,
+						    unsigned sink_slot)
+{
+    unsigned src_shard, dst_shard;
+    struct cross_conn *conn;
+    struct link *link, dead;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(group, PJ_EINVAL);
+    PJ_ASSERT_RETURN(src_slot < group->shard_cnt*group->conf_param.max_slots &&
+		     sink_slot < group->shard_cnt*group->conf_param.max_slots,
+		     PJ_EINVAL);
+
+    pj_list_init(&dead);
+
+    pj_mutex_lock(group->mutex);
+
+    if (!group->slots[src_slot].used || !group->slots[sink_slot].used) {
+	pj_mutex_unlock(group->mutex);
+	return PJ_EINVAL;
+    }
+
+    src_shard = SHARD_OF(group, src_slot);
+    dst_shard = SHARD_OF(group, sink_slot);
+
+    /* Same shard, connect directly */
+    if (src_shard == dst_shard) {
+	status = pjmedia_conf_connect_port(group->shards[src_shard].conf,
+					   SLOT_OF(group, src_slot),
+					   SLOT_OF(group, sink_slot), 0);
+	pj_mutex_unlock(group->mutex);
+	return status;
+    }
+
+    /* Check if connection has been made */
+    for (conn=group->conns.next; conn!=&group->conns; conn=conn->next) {
+	if (conn->src_slot == src_slot && conn->sink_slot == sink_slot) {
+	    pj_mutex_unlock(group->mutex);
+	    return PJ_SUCCESS;
+	}
+    }
+
+    status = get_link(group, src_slot, dst_shard, &dead, &link);
+    if (status != PJ_SUCCESS) {
+	pj_mutex_unlock(group->mutex);
+	free_links(group, &dead);
+	return status;
+    }
+
+    status = pjmedia_conf_connect_port(group->shards[dst_shard].conf,
+				       link->rx_slot,
+				       SLOT_OF(group, sink_slot), 0);
+    if (status != PJ_SUCCESS) {
+	if (link->ref_cnt == 0)
+	    unlink_link(link, &dead);
+	pj_mutex_unlock(group->mutex);
+	free_links(group, &dead);
+	return status;
+    }
+
+    if (!pj_list_empty(&group->free_conns)) {
+	conn = group->free_conns.next;
+	pj_list_erase(conn);
+    } else {
+	conn = PJ_POOL_ZALLOC_T(group->pool, struct cross_conn);
+    }
+    conn->src_slot = src_slot;
+    conn->sink_slot = sink_slot;
+    conn->link = link;
+    pj_list_push_back(&group->conns, conn);
+    ++link->ref_cnt;
+
+    pj_mutex_unlock(group->mutex);
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_conf_group_disconnect_port(
+						    pjmedia_conf_group *group,
+						    unsigned src_slot,
+						    unsigned sink_slot)
+{
+    unsigned src_shard, dst_shard;
+    struct cross_conn *conn;
+    struct link dead;
+    pj_status_t status = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(group, PJ_EINVAL);
+    PJ_ASSERT_RETURN(src_slot < group->shard_cnt*group->conf_param.max_slots &&
+		     sink_slot < group->shard_cnt*group->conf_param.max_slots,
+		     PJ_EINVAL);
+
+    pj_list_init(&dead);
+
+    pj_mutex_lock(group->mutex);
+
+    if (!group->slots[src_slot].used || !group->slots[sink_slot].used) {
+	pj_mutex_unlock(group->mutex);
+	return PJ_EINVAL;
+    }
+
+    src_shard = SHARD_OF(group, src_slot);
+    dst_shard = SHARD_OF(group, sink_slot);
+
+    if (src_shard == dst_shard) {
+	status = pjmedia_conf_disconnect_port(group->shards[src_shard].conf,
+					      SLOT_OF(group, src_slot),
+					      SLOT_OF(group, sink_slot));
+    } else {
+	for (conn=group->conns.next; conn!=&group->conns; conn=conn->next) {
+	    if (conn->src_slot == src_slot && conn->sink_slot == sink_slot) {
+		remove_cross_conn(group, conn, &dead);
+		break;
+	    }
+	}
+    }
+
+    pj_mutex_unlock(group->mutex);
+
+    free_links(group, &dead);
+
+    return status;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_conf_group_get_conf(pjmedia_conf_group *group,
+						unsigned slot,
+						pjmedia_conf **p_conf,
+						unsigned *p_conf_slot)
+{
+    PJ_ASSERT_RETURN(group && p_conf, PJ_EINVAL);
+    PJ_ASSERT_RETURN(slot < group->shard_cnt * group->conf_param.max_slots,
+		     PJ_EINVAL);
+
+    if (!group->slots[slot].used)
+	return PJ_EINVAL;
+
+    *p_conf = group->shards[SHARD_OF(group, slot)].conf;
+    if (p_conf_slot)
+	*p_conf_slot = SLOT_OF(group, slot);
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(unsigned) pjmedia_conf_group_get_link_count(pjmedia_conf_group *group)
+{
+    unsigned cnt;
+
+    PJ_ASSERT_RETURN(group, 0);
+
+    pj_mutex_lock(group->mutex);
+    cnt = (unsigned) pj_list_size(&group->links);
+    pj_mutex_unlock(group->mutex);
+
+    return cnt;
+}
+
+
+/*
+ * Run one tick of a shard.
+ */
+static void tick_shard(pjmedia_conf_group *group, unsigned idx)
+{
+    struct shard *shard = &group->shards[idx];
+    pjmedia_frame frame;
+
+    frame.type = PJMEDIA_FRAME_TYPE_AUDIO;
+    frame.buf = shard->buf;
+    frame.size = group->conf_param.samples_per_frame * sizeof(pj_int16_t);
+    frame.timestamp = group->tick_ts;
+    frame.bit_info = 0;
+
+    pjmedia_port_get_frame(shard->master_port, &frame);
+}
+
+
+/*
+ * Pick and run shards until all shards are processed.
+ */
+static void run_jobs(pjmedia_conf_group *group)
+{
+    for (;;) {
+	unsigned idx = (unsigned)pj_atomic_inc_and_get(group->job_idx) - 1;
+
+	if (idx >= group->shard_cnt)
+	    break;
+
+	tick_shard(group, idx);
+    }
+}
+
+
+static int worker_thread(void *arg)
+{
+    pjmedia_conf_group *group = (pjmedia_conf_group*) arg;
+
+    for (;;) {
+	pj_sem_wait(group->job_sem);
+	if (group->quit)
+	    break;
+
+	run_jobs(group);
+	pj_sem_post(group->done_sem);
+    }
+
+    return 0;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_conf_group_tick(pjmedia_conf_group *group,
+					    const pj_timestamp *ts)
+{
+    unsigned i;
+
+    PJ_ASSERT_RETURN(group && ts, PJ_EINVAL);
+
+    group->tick_ts = *ts;
+
+    if (group->worker_cnt == 0) {
+	for (i=0; i<group->shard_cnt; ++i)
+	    tick_shard(group, i);
+    } else {
+	/* Wake up the workers and help them */
+	pj_atomic_set(group->job_idx, 0);
+	for (i=0; i<group->worker_cnt; ++i)
+	    pj_sem_post(group->job_sem);
+
+	run_jobs(group);
+
+	/* Wait until all workers are done */
+	for (i=0; i<group->worker_cnt; ++i)
+	    pj_sem_wait(group->done_sem);
+    }
+
+    /* Frames written to links in this tick are read in the next one */
+    ++group->tick_cnt;
+
+    return PJ_SUCCESS;
+}
+
+
+static void clock_callback(const pj_timestamp *ts, void *user_data)
+{
+    pjmedia_conf_group_tick((pjmedia_conf_group*)user_data, ts);
+}
@@ -277,6 +277,36 @@ PJ_DEF(pj_status_t) pjmedia_conf_create( pj_pool_t *pool,
 }
 
 
+/*
+ * Initialize conference bridge parameters.
+ */
+PJ_DEF(void) pjmedia_conf_param_default(pjmedia_conf_param *param)
+{
+    pj_bzero(param, sizeof(*param));
+    param->channel_count = 1;
+    param->bits_per_sample = 16;
+    param->worker_threads = PJMEDIA_CONF_WORKER_THREADS;
+}
+
+
+/*
+ * Create conference bridge with the specified parameters. The switchboard
+ * has no mixing to parallelize, so the worker threads setting is ignored.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_create2( pj_pool_t *pool,
+					  const pjmedia_conf_param *param,
+					  pjmedia_conf **p_conf )
+{
+    PJ_ASSERT_RETURN(pool && param && p_conf, PJ_EINVAL);
+
+    return pjmedia_conf_create(pool, param->max_slots, param->sampling_rate,
+			       param->channel_count,
+			       param->samples_per_frame,
+			       param->bits_per_sample, param->options,
+			       p_conf);
+}
+
+
 /*
  * Pause sound device.
  */
@@ -21,6 +21,7 @@
 #include <pjmedia/alaw_ulaw.h>
 #include <pjmedia/delaybuf.h>
 #include <pjmedia/errno.h>
+#include <pjmedia/mixer.h>
 #include <pjmedia/port.h>
 #include <pjmedia/resample.h>
 #include <pjmedia/silencedet.h>
@@ -28,7 +29,9 @@
 #include <pjmedia/stereo.h>
 #include <pj/array.h>
 #include <pj/assert.h>
+#include <pj/list.h>
 #include <pj/log.h>
+#include <pj/os.h>
 #include <pj/pool.h>
 #include <pj/string.h>
 
@@ -114,6 +117,8 @@ struct conf_port
     unsigned		 listener_cnt;	/**< Number of listeners.	    */
     SLOT_TYPE		*listener_slots;/**< Array of listeners.	    */
     unsigned		 transmitter_cnt;/**<Number of transmitters.	    */
+    SLOT_TYPE		*transmitter_slots;/**< Array of transmitters,
+					     sorted by slot number.	    */
 
     /* Shortcut for port info. */
     unsigned		 clock_rate;	/**< Port's clock rate.		    */
@@ -151,6 +156,24 @@ struct conf_port
     unsigned		 rx_buf_cap;	/**< Max size, in samples	    */
     unsigned		 rx_buf_count;	/**< # of samples in the buf.	    */
 
+    /* RX frame is the frame received from this port in the current clock
+     * tick, at bridge's clock rate, after the RX level adjustment. It is
+     * filled in the read phase of the clock tick, and mixed to the mix
+     * buffer of the listeners in the write phase. When the port gives
+     * the frame by reference, the RX frame points to the frame buffer,
+     * which is held until the next read phase.
+     */
+    pj_int16_t		*rx_frame;	/**< The RX frame.		    */
+    pj_int16_t		*rx_frame_buf;	/**< Own buffer for the RX frame.   */
+    pjmedia_frame_buf	*rx_fbuf;	/**< RX frame held by reference.    */
+    pj_bool_t		 rx_frame_ok;	/**< RX frame has audio this tick.  */
+
+    /* Active speaker selection: the RX level with slow decay, so that
+     * short pauses don't change the active speakers.
+     */
+    unsigned		 speaker_level;	/**< Level for speaker selection.   */
+    pj_bool_t		 active_speaker;/**< Is an active speaker.	    */
+
     /* Mix buf is a temporary buffer used to mix all signal received
      * by this port from all other ports. The mixed signal will be 
      * automatically adjusted to the appropriate level whenever
@@ -163,6 +186,8 @@ struct conf_port
     int			 mix_adj;	/**< Adjustment level for mix_buf.  */
     int			 last_mix_adj;	/**< Last adjustment level.	    */
     pj_int32_t		*mix_buf;	/**< Total sum of signal.	    */
+    pjmedia_frame_type	 tx_frame_type;	/**< Type of the last frame written
+					     to the port.		    */
 
     /* Tx buffer is a temporary buffer to be used when there's mismatch 
      * between port's clock rate or ptime with conference's sample rate
@@ -217,6 +242,34 @@ struct conf_port
 };
 
 
+/*
+ * Operations on the ports and connections, which are queued while the
+ * clock tick is running.
+ */
+enum op_type
+{
+    OP_ADD_PORT,
+    OP_REMOVE_PORT,
+    OP_CONNECT_PORTS,
+    OP_DISCONNECT_PORTS,
+    OP_CONFIGURE_PORT,
+    OP_ADJUST_RX_LEVEL,
+    OP_ADJUST_TX_LEVEL
+};
+
+struct conf_op
+{
+    PJ_DECL_LIST_MEMBER(struct conf_op);
+    enum op_type	 type;		/**< Operation type.		    */
+    unsigned		 src;		/**< Port, or source port.	    */
+    unsigned		 sink;		/**< Sink port.			    */
+    struct conf_port	*port;		/**< Port to add.		    */
+    pjmedia_port_op	 tx;		/**< TX setting to set.		    */
+    pjmedia_port_op	 rx;		/**< RX setting to set.		    */
+    int			 level;		/**< Normalized level to set.	    */
+};
+
+
 /*
  * Conference bridge.
  */
@@ -235,6 +288,53 @@ struct pjmedia_conf
     unsigned		  channel_count;/**< Number of channels (1=mono).   */
     unsigned		  samples_per_frame;	/**< Samples per frame.	    */
     unsigned		  bits_per_sample;	/**< Bits per sample.	    */
+
+    /* Parallel processing of the ports. When there are worker threads,
+     * each phase of the clock tick is split into jobs of job_chunk slots,
+     * which are picked by the clock thread and the workers until all
+     * slots have been processed. The clock thread then waits until all
+     * workers are done before starting the next phase.
+     */
+    unsigned		  worker_cnt;	/**< Number of worker threads.	    */
+    pj_thread_t		**workers;	/**< Worker threads.		    */
+    pj_sem_t		 *job_sem;	/**< Signals workers to start.	    */
+    pj_sem_t		 *done_sem;	/**< Signals a worker is done.	    */
+    pj_atomic_t		 *job_idx;	/**< Next job to pick.		    */
+    unsigned		  job_chunk;	/**< Slots per job.		    */
+    void		(*job_cb)(pjmedia_conf*, unsigned);
+					/**< Phase being run.		    */
+    pj_bool_t		  quit;		/**< Workers must quit.		    */
+    pj_timestamp	  tick_ts;	/**< Timestamp of the clock tick.   */
+
+    /* Operation queue. The clock tick doesn't hold the mutex while mixing,
+     * so the changes made while the tick is running are queued, and
+     * applied when the tick ends. The functions of the API see the slots
+     * through slot_used, which already includes the queued changes.
+     */
+    pj_pool_t		 *pool;		/**< Pool for the queue entries.    */
+    pj_bool_t		 *slot_used;	/**< Slots taken, incl. queued.	    */
+    unsigned		  used_cnt;	/**< Number of slots taken.	    */
+    struct conf_op	  op_queue;	/**< Queued operations.		    */
+    struct conf_op	  op_free;	/**< Unused queue entries.	    */
+    pj_bool_t		  in_tick;	/**< Clock tick is running.	    */
+    pj_thread_t		 *tick_thread;	/**< Thread running the tick.	    */
+    unsigned		  tick_waiters;	/**< Threads waiting for tick end.  */
+    pj_sem_t		 *tick_sem;	/**< Signals the end of the tick.   */
+
+    /* Active speaker mixing. The frames of the active speakers are mixed
+     * once to speaker_sum, which the ports get instead of mixing all their
+     * transmitters.
+     */
+    unsigned		  active_max;	/**< Max active speakers, 0: all.   */
+    unsigned		  active_cnt;	/**< Current active speakers.	    */
+    SLOT_TYPE		 *active_slots;	/**< Active speakers, sorted.	    */
+    unsigned		 *active_score;	/**< Selection scores.		    */
+    pj_int32_t		 *speaker_sum;	/**< Sum of active speakers.	    */
+    pj_int32_t		  sum_min;	/**< Smallest value in speaker_sum. */
+    pj_int32_t		  sum_max;	/**< Largest value in speaker_sum.  */
+
+    /* Frames for the ports which take their frames by reference. */
+    pjmedia_frame_pool	 *frame_pool;	/**< Pool of frame buffers.	    */
 };
 
 
@@ -247,6 +347,7 @@ static pj_status_t get_frame_pasv(pjmedia_port *this_port,
 				  pjmedia_frame *frame);
 static pj_status_t destroy_port(pjmedia_port *this_port);
 static pj_status_t destroy_port_pasv(pjmedia_port *this_port);
+static int worker_thread(void *arg);
 
 
 /*
@@ -282,6 +383,12 @@ static pj_status_t create_conf_port( pj_pool_t *pool,
 					  conf->max_ports * sizeof(SLOT_TYPE));
     PJ_ASSERT_RETURN(conf_port->listener_slots, PJ_ENOMEM);
 
+    /* Create transmitter array */
+    conf_port->transmitter_slots = (SLOT_TYPE*)
+				   pj_pool_zalloc(pool,
+					  conf->max_ports * sizeof(SLOT_TYPE));
+    PJ_ASSERT_RETURN(conf_port->transmitter_slots, PJ_ENOMEM);
+
     /* Save some port's infos, for convenience. */
     if (port) {
 	pjmedia_audio_format_detail *afd;
@@ -404,6 +511,13 @@ static pj_status_t create_conf_port( pj_pool_t *pool,
     PJ_ASSERT_RETURN(conf_port->mix_buf, PJ_ENOMEM);
     conf_port->last_mix_adj = NORMAL_LEVEL;
 
+    /* Create RX frame. */
+    conf_port->rx_frame_buf = (pj_int16_t*)
+			      pj_pool_zalloc(pool, conf->samples_per_frame *
+					       sizeof(conf_port->rx_frame[0]));
+    PJ_ASSERT_RETURN(conf_port->rx_frame_buf, PJ_ENOMEM);
+    conf_port->rx_frame = conf_port->rx_frame_buf;
+
 
     /* Done */
     *p_conf_port = conf_port;
@@ -411,6 +525,19 @@ static pj_status_t create_conf_port( pj_pool_t *pool,
 }
 
 
+/*
+ * Release the RX frame held by reference, if any.
+ */
+static void release_rx_frame(struct conf_port *cport)
+{
+    if (cport->rx_fbuf) {
+	pjmedia_frame_buf_dec_ref(cport->rx_fbuf);
+	cport->rx_fbuf = NULL;
+	cport->rx_frame = cport->rx_frame_buf;
+    }
+}
+
+
 /*
  * Add passive port.
  */
@@ -513,10 +640,25 @@ static pj_status_t create_sound_port( pj_pool_t *pool,
      /* Add the port to the bridge */
     conf->ports[0] = conf_port;
     conf->port_cnt++;
+    conf->slot_used[0] = PJ_TRUE;
+    conf->used_cnt++;
 
     return PJ_SUCCESS;
 }
 
+/*
+ * Initialize conference bridge parameters.
+ */
+PJ_DEF(void) pjmedia_conf_param_default(pjmedia_conf_param *param)
+{
+    pj_bzero(param, sizeof(*param));
+    param->channel_count = 1;
+    param->bits_per_sample = 16;
+    param->worker_threads = PJMEDIA_CONF_WORKER_THREADS;
+    param->active_speakers = PJMEDIA_CONF_ACTIVE_SPEAKERS;
+}
+
+
 /*
  * Create conference bridge.
  */
@@ -528,11 +670,43 @@ PJ_DEF(pj_status_t) pjmedia_conf_create( pj_pool_t *pool,
 					 unsigned bits_per_sample,
 					 unsigned options,
 					 pjmedia_conf **p_conf )
+{
+    pjmedia_conf_param param;
+
+    pjmedia_conf_param_default(&param);
+    param.max_slots = max_ports;
+    param.sampling_rate = clock_rate;
+    param.channel_count = channel_count;
+    param.samples_per_frame = samples_per_frame;
+    param.bits_per_sample = bits_per_sample;
+    param.options = options;
+
+    return pjmedia_conf_create2(pool, &param, p_conf);
+}
+
+
+/*
+ * Create conference bridge with the specified parameters.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_create2( pj_pool_t *pool,
+					  const pjmedia_conf_param *param,
+					  pjmedia_conf **p_conf )
 {
     pjmedia_conf *conf;
     const pj_str_t name = { "Conf", 4 };
+    unsigned max_ports, clock_rate, channel_count;
+    unsigned samples_per_frame, bits_per_sample;
+    unsigned i;
     pj_status_t status;
 
+    PJ_ASSERT_RETURN(pool && param && p_conf, PJ_EINVAL);
+
+    max_ports = param->max_slots;
+    clock_rate = param->sampling_rate;
+    channel_count = param->channel_count;
+    samples_per_frame = param->samples_per_frame;
+    bits_per_sample = param->bits_per_sample;
+
     /* Can only accept 16bits per sample, for now.. */
     PJ_ASSERT_RETURN(bits_per_sample == 16, PJ_EINVAL);
 
@@ -547,7 +721,15 @@ PJ_DEF(pj_status_t) pjmedia_conf_create( pj_pool_t *pool,
 		  pj_pool_zalloc(pool, max_ports*sizeof(void*));
     PJ_ASSERT_RETURN(conf->ports, PJ_ENOMEM);
 
-    conf->options = options;
+    conf->slot_used = (pj_bool_t*)
+		      pj_pool_zalloc(pool, max_ports*sizeof(pj_bool_t));
+    PJ_ASSERT_RETURN(conf->slot_used, PJ_ENOMEM);
+
+    conf->pool = pool;
+    pj_list_init(&conf->op_queue);
+    pj_list_init(&conf->op_free);
+
+    conf->options = param->options;
     conf->max_ports = max_ports;
     conf->clock_rate = clock_rate;
     conf->channel_count = channel_count;
@@ -585,6 +767,78 @@ PJ_DEF(pj_status_t) pjmedia_conf_create( pj_pool_t *pool,
 	return status;
     }
 
+    /* Create semaphore to wait for the end of the clock tick. */
+    status = pj_sem_create(pool, "conf_tick", 0, max_ports, &conf->tick_sem);
+    if (status != PJ_SUCCESS) {
+	pjmedia_conf_destroy(conf);
+	return status;
+    }
+
+    /* Create pool of frame buffers. */
+    status = pjmedia_frame_pool_create(pool, "conf_frm%p",
+				       samples_per_frame * BYTES_PER_SAMPLE,
+				       0, &conf->frame_pool);
+    if (status != PJ_SUCCESS) {
+	pjmedia_conf_destroy(conf);
+	return status;
+    }
+
+    /* Create active speaker mixing buffers. */
+    if (param->active_speakers) {
+	conf->active_max = param->active_speakers;
+	conf->active_slots = (SLOT_TYPE*)
+			     pj_pool_calloc(pool, conf->active_max,
+					    sizeof(SLOT_TYPE));
+	conf->active_score = (unsigned*)
+			     pj_pool_calloc(pool, conf->active_max,
+					    sizeof(unsigned));
+	conf->speaker_sum = (pj_int32_t*)
+			    pj_pool_calloc(pool, samples_per_frame,
+					   sizeof(pj_int32_t));
+	PJ_ASSERT_RETURN(conf->active_slots && conf->active_score &&
+			 conf->speaker_sum, PJ_ENOMEM);
+    }
+
+    /* Create worker threads. */
+    if (param->worker_threads) {
+	status = pj_sem_create(pool, "conf_job", 0, param->worker_threads,
+			       &conf->job_sem);
+	if (status == PJ_SUCCESS)
+	    status = pj_sem_create(pool, "conf_done", 0,
+				   param->worker_threads, &conf->done_sem);
+	if (status == PJ_SUCCESS)
+	    status = pj_atomic_create(pool, 0, &conf->job_idx);
+	if (status != PJ_SUCCESS) {
+	    pjmedia_conf_destroy(conf);
+	    return status;
+	}
+
+	/* Small jobs balance the load better, but each costs an atomic
+	 * operation to pick.
+	 */
+	conf->job_chunk = max_ports / ((param->worker_threads + 1) * 4);
+	if (conf->job_chunk == 0)
+	    conf->job_chunk = 1;
+
+	conf->workers = (pj_thread_t**)
+			pj_pool_zalloc(pool, param->worker_threads *
+					     sizeof(pj_thread_t*));
+	PJ_ASSERT_RETURN(conf->workers, PJ_ENOMEM);
+
+	for (i=0; i<param->worker_threads; ++i) {
+	    status = pj_thread_create(pool, "conf_worker", &worker_thread,
+				      conf, 0, 0, &conf->workers[i]);
+	    if (status != PJ_SUCCESS) {
+		pjmedia_conf_destroy(conf);
+		return status;
+	    }
+	    ++conf->worker_cnt;
+	}
+
+	PJ_LOG(5,(THIS_FILE, "Conference bridge uses %d worker threads",
+		  conf->worker_cnt));
+    }
+
     /* If sound device was created, connect sound device to the
      * master port.
      */
@@ -655,6 +909,41 @@ PJ_DEF(pj_status_t) pjmedia_conf_destroy( pjmedia_conf *conf )
 	    pjmedia_delay_buf_destroy(cport->delay_buf);
 	    cport->delay_buf = NULL;
 	}
+	release_rx_frame(cport);
+    }
+
+    /* Stop worker threads */
+    if (conf->worker_cnt) {
+	conf->quit = PJ_TRUE;
+	for (i=0; i<conf->worker_cnt; ++i)
+	    pj_sem_post(conf->job_sem);
+	for (i=0; i<conf->worker_cnt; ++i) {
+	    pj_thread_join(conf->workers[i]);
+	    pj_thread_destroy(conf->workers[i]);
+	}
+	conf->worker_cnt = 0;
+    }
+    if (conf->job_idx) {
+	pj_atomic_destroy(conf->job_idx);
+	conf->job_idx = NULL;
+    }
+    if (conf->done_sem) {
+	pj_sem_destroy(conf->done_sem);
+	conf->done_sem = NULL;
+    }
+    if (conf->job_sem) {
+	pj_sem_destroy(conf->job_sem);
+	conf->job_sem = NULL;
+    }
+
+    if (conf->tick_sem) {
+	pj_sem_destroy(conf->tick_sem);
+	conf->tick_sem = NULL;
+    }
+
+    if (conf->frame_pool) {
+	pjmedia_frame_pool_destroy(conf->frame_pool);
+	conf->frame_pool = NULL;
     }
 
     /* Destroy mutex */
@@ -730,207 +1019,427 @@ PJ_DEF(pj_status_t) pjmedia_conf_set_port0_name(pjmedia_conf *conf,
 }
 
 /*
- * Add stream port to the conference bridge.
+ * Check if the calling thread is running the clock tick.
  */
-PJ_DEF(pj_status_t) pjmedia_conf_add_port( pjmedia_conf *conf,
-					   pj_pool_t *pool,
-					   pjmedia_port *strm_port,
-					   const pj_str_t *port_name,
-					   unsigned *p_port )
+static pj_bool_t is_tick_thread(pjmedia_conf *conf)
 {
-    struct conf_port *conf_port;
-    unsigned index;
-    pj_status_t status;
-
-    PJ_ASSERT_RETURN(conf && pool && strm_port, PJ_EINVAL);
-
-    /* If port_name is not specified, use the port's name */
-    if (!port_name)
-	port_name = &strm_port->info.name;
-
-    /* For this version of PJMEDIA, channel(s) number MUST be:
-     * - same between port & conference bridge.
-     * - monochannel on port or conference bridge.
-     */
-    if (PJMEDIA_PIA_CCNT(&strm_port->info) != conf->channel_count &&
-	(PJMEDIA_PIA_CCNT(&strm_port->info) != 1 &&
-	 conf->channel_count != 1))
-    {
-	pj_assert(!"Number of channels mismatch");
-	return PJMEDIA_ENCCHANNEL;
-    }
+    pj_thread_t *this_thread = pj_thread_this();
+    unsigned i;
 
-    pj_mutex_lock(conf->mutex);
+    if (this_thread == conf->tick_thread)
+	return PJ_TRUE;
 
-    if (conf->port_cnt >= conf->max_ports) {
-	pj_assert(!"Too many ports");
-	pj_mutex_unlock(conf->mutex);
-	return PJ_ETOOMANY;
+    for (i=0; i<conf->worker_cnt; ++i) {
+	if (this_thread == conf->workers[i])
+	    return PJ_TRUE;
     }
 
-    /* Find empty port in the conference bridge. */
-    for (index=0; index < conf->max_ports; ++index) {
-	if (conf->ports[index] == NULL)
-	    break;
-    }
+    return PJ_FALSE;
+}
 
-    pj_assert(index != conf->max_ports);
 
-    /* Create conf port structure. */
-    status = create_conf_port(pool, conf, strm_port, port_name, &conf_port);
-    if (status != PJ_SUCCESS) {
-	pj_mutex_unlock(conf->mutex);
-	return status;
-    }
+/*
+ * Put a new port in its slot.
+ */
+static void op_add_port(pjmedia_conf *conf, unsigned slot,
+			struct conf_port *conf_port)
+{
+    pj_assert(conf->ports[slot] == NULL);
 
-    /* Put the port. */
-    conf->ports[index] = conf_port;
+    conf->ports[slot] = conf_port;
     conf->port_cnt++;
-
-    /* Done. */
-    if (p_port) {
-	*p_port = index;
-    }
-
-    pj_mutex_unlock(conf->mutex);
-
-    return PJ_SUCCESS;
 }
 
 
 /*
- * Add passive port.
+ * Make the connection between two ports.
  */
-PJ_DEF(pj_status_t) pjmedia_conf_add_passive_port( pjmedia_conf *conf,
-						   pj_pool_t *pool,
-						   const pj_str_t *name,
-						   unsigned clock_rate,
-						   unsigned channel_count,
-						   unsigned samples_per_frame,
-						   unsigned bits_per_sample,
-						   unsigned options,
-						   unsigned *p_slot,
-						   pjmedia_port **p_port )
+static void op_connect_ports(pjmedia_conf *conf, unsigned src_slot,
+			     unsigned sink_slot)
 {
-    struct conf_port *conf_port;
-    pjmedia_port *port;
-    unsigned index;
-    pj_str_t tmp;
-    pj_status_t status;
-
-    PJ_LOG(1, (THIS_FILE, "This API has been deprecated since 1.3 and will "
-			  "be removed in the future release!"));
+    struct conf_port *src_port, *dst_port;
+    SLOT_TYPE slot = (SLOT_TYPE)src_slot;
+    unsigned i;
 
-    PJ_ASSERT_RETURN(conf && pool, PJ_EINVAL);
+    src_port = conf->ports[src_slot];
+    dst_port = conf->ports[sink_slot];
+    pj_assert(src_port && dst_port);
 
-    /* For this version of PJMEDIA, channel(s) number MUST be:
-     * - same between port & conference bridge.
-     * - monochannel on port or conference bridge.
-     */
-    if (channel_count != conf->channel_count && 
-	(channel_count != 1 && conf->channel_count != 1)) 
-    {
-	pj_assert(!"Number of channels mismatch");
-	return PJMEDIA_ENCCHANNEL;
+    /* Check if connection has been made */
+    for (i=0; i<src_port->listener_cnt; ++i) {
+	if (src_port->listener_slots[i] == sink_slot)
+	    return;
     }
 
-    /* For this version, options must be zero */
-    PJ_ASSERT_RETURN(options == 0, PJ_EINVAL);
-    PJ_UNUSED_ARG(options);
-
-    pj_mutex_lock(conf->mutex);
-
-    if (conf->port_cnt >= conf->max_ports) {
-	pj_assert(!"Too many ports");
-	pj_mutex_unlock(conf->mutex);
-	return PJ_ETOOMANY;
-    }
+    src_port->listener_slots[src_port->listener_cnt] = sink_slot;
 
-    /* Find empty port in the conference bridge. */
-    for (index=0; index < conf->max_ports; ++index) {
-	if (conf->ports[index] == NULL)
+    /* Keep the transmitters sorted, so that the signals are mixed in
+     * the order the ports are read.
+     */
+    for (i=0; i<dst_port->transmitter_cnt; ++i) {
+	if (dst_port->transmitter_slots[i] > src_slot)
 	    break;
     }
+    pj_array_insert(dst_port->transmitter_slots, sizeof(SLOT_TYPE),
+		    dst_port->transmitter_cnt, i, &slot);
+
+    ++conf->connect_cnt;
+    ++src_port->listener_cnt;
+    ++dst_port->transmitter_cnt;
+
+    PJ_LOG(4,(THIS_FILE,"Port %d (%.*s) transmitting to port %d (%.*s)",
+	      src_slot,
+	      (int)src_port->name.slen,
+	      src_port->name.ptr,
+	      sink_slot,
+	      (int)dst_port->name.slen,
+	      dst_port->name.ptr));
+}
 
-    pj_assert(index != conf->max_ports);
 
-    if (name == NULL) {
-	name = &tmp;
+/*
+ * Remove a port from the transmitters of another port.
+ */
+static void remove_transmitter(struct conf_port *dst_port,
+			       unsigned src_slot)
+{
+    unsigned i;
 
-	tmp.ptr = (char*) pj_pool_alloc(pool, 32);
-	tmp.slen = pj_ansi_snprintf(tmp.ptr, 32, "ConfPort#%d", index);
+    for (i=0; i<dst_port->transmitter_cnt; ++i) {
+	if (dst_port->transmitter_slots[i] == src_slot) {
+	    pj_array_erase(dst_port->transmitter_slots, sizeof(SLOT_TYPE),
+			   dst_port->transmitter_cnt, i);
+	    --dst_port->transmitter_cnt;
+	    return;
+	}
     }
 
-    /* Create and initialize the media port structure. */
-    port = PJ_POOL_ZALLOC_T(pool, pjmedia_port);
-    PJ_ASSERT_RETURN(port, PJ_ENOMEM);
-    
-    pjmedia_port_info_init(&port->info, name, SIGNATURE_PORT,
-			   clock_rate, channel_count, bits_per_sample,
-			   samples_per_frame);
-
-    port->port_data.pdata = conf;
-    port->port_data.ldata = index;
-
-    port->get_frame = &get_frame_pasv;
-    port->put_frame = &put_frame;
-    port->on_destroy = &destroy_port_pasv;
-
-    
-    /* Create conf port structure. */
-    status = create_pasv_port(conf, pool, name, port, &conf_port);
-    if (status != PJ_SUCCESS) {
-	pj_mutex_unlock(conf->mutex);
-	return status;
-    }
+    pj_assert(!"Transmitter not found");
+}
 
 
-    /* Put the port. */
-    conf->ports[index] = conf_port;
-    conf->port_cnt++;
+/*
+ * Remove the connection between two ports.
+ */
+static void op_disconnect_ports(pjmedia_conf *conf, unsigned src_slot,
+				unsigned sink_slot)
+{
+    struct conf_port *src_port, *dst_port;
+    unsigned i;
 
-    /* Done. */
-    if (p_slot)
-	*p_slot = index;
-    if (p_port)
-	*p_port = port;
+    src_port = conf->ports[src_slot];
+    dst_port = conf->ports[sink_slot];
+    pj_assert(src_port && dst_port);
 
-    pj_mutex_unlock(conf->mutex);
+    /* Check if connection has been made */
+    for (i=0; i<src_port->listener_cnt; ++i) {
+	if (src_port->listener_slots[i] == sink_slot)
+	    break;
+    }
 
-    return PJ_SUCCESS;
+    if (i == src_port->listener_cnt)
+	return;
+
+    pj_assert(src_port->listener_cnt > 0 && 
+	      src_port->listener_cnt < conf->max_ports);
+    pj_assert(dst_port->transmitter_cnt > 0 && 
+	      dst_port->transmitter_cnt < conf->max_ports);
+    pj_array_erase(src_port->listener_slots, sizeof(SLOT_TYPE), 
+		   src_port->listener_cnt, i);
+    remove_transmitter(dst_port, src_slot);
+    --conf->connect_cnt;
+    --src_port->listener_cnt;
+
+    PJ_LOG(4,(THIS_FILE,
+	      "Port %d (%.*s) stop transmitting to port %d (%.*s)",
+	      src_slot,
+	      (int)src_port->name.slen,
+	      src_port->name.ptr,
+	      sink_slot,
+	      (int)dst_port->name.slen,
+	      dst_port->name.ptr));
+
+    /* if source port is passive port and has no listener, reset delaybuf */
+    if (src_port->delay_buf && src_port->listener_cnt == 0)
+	pjmedia_delay_buf_reset(src_port->delay_buf);
 }
 
 
-
 /*
- * Change TX and RX settings for the port.
+ * Remove a port from its slot, together with its connections.
  */
-PJ_DEF(pj_status_t) pjmedia_conf_configure_port( pjmedia_conf *conf,
-						  unsigned slot,
-						  pjmedia_port_op tx,
-						  pjmedia_port_op rx)
+static void op_remove_port(pjmedia_conf *conf, unsigned port)
 {
     struct conf_port *conf_port;
+    unsigned i;
 
-    /* Check arguments */
-    PJ_ASSERT_RETURN(conf && slot<conf->max_ports, PJ_EINVAL);
+    conf_port = conf->ports[port];
+    pj_assert(conf_port);
 
-    pj_mutex_lock(conf->mutex);
+    conf_port->tx_setting = PJMEDIA_PORT_DISABLE;
+    conf_port->rx_setting = PJMEDIA_PORT_DISABLE;
+    release_rx_frame(conf_port);
 
-    /* Port must be valid. */
-    conf_port = conf->ports[slot];
-    if (conf_port == NULL) {
-	pj_mutex_unlock(conf->mutex);
-	return PJ_EINVAL;
+    /* Remove this port from transmit array of other ports. */
+    for (i=0; i<conf->max_ports; ++i) {
+	unsigned j;
+	struct conf_port *src_port;
+
+	src_port = conf->ports[i];
+
+	if (!src_port)
+	    continue;
+
+	if (src_port->listener_cnt == 0)
+	    continue;
+
+	for (j=0; j<src_port->listener_cnt; ++j) {
+	    if (src_port->listener_slots[j] == port) {
+		pj_array_erase(src_port->listener_slots, sizeof(SLOT_TYPE),
+			       src_port->listener_cnt, j);
+		pj_assert(conf->connect_cnt > 0);
+		--conf->connect_cnt;
+		--src_port->listener_cnt;
+		break;
+	    }
+	}
     }
 
-    conf_port = conf->ports[slot];
+    /* Update transmitter_cnt of ports we're transmitting to */
+    while (conf_port->listener_cnt) {
+	unsigned dst_slot;
+	struct conf_port *dst_port;
+
+	dst_slot = conf_port->listener_slots[conf_port->listener_cnt-1];
+	dst_port = conf->ports[dst_slot];
+	remove_transmitter(dst_port, port);
+	--conf_port->listener_cnt;
+	pj_assert(conf->connect_cnt > 0);
+	--conf->connect_cnt;
+    }
+
+    /* Remove the port from the active speakers. */
+    if (conf_port->active_speaker) {
+	for (i=0; i<conf->active_cnt; ++i) {
+	    if (conf->active_slots[i] == port) {
+		pj_array_erase(conf->active_slots, sizeof(SLOT_TYPE),
+			       conf->active_cnt, i);
+		--conf->active_cnt;
+		break;
+	    }
+	}
+	conf_port->active_speaker = PJ_FALSE;
+    }
+
+    /* Destroy pjmedia port if this conf port is passive port,
+     * i.e: has delay buf.
+     */
+    if (conf_port->delay_buf) {
+	pjmedia_port_destroy(conf_port->port);
+	conf_port->port = NULL;
+    }
+
+    /* Remove the port. */
+    conf->ports[port] = NULL;
+    --conf->port_cnt;
+}
+
+
+/*
+ * Change the TX and RX settings of a port.
+ */
+static void op_configure_port(pjmedia_conf *conf, unsigned slot,
+			      pjmedia_port_op tx, pjmedia_port_op rx)
+{
+    struct conf_port *conf_port = conf->ports[slot];
+
+    pj_assert(conf_port);
 
     if (tx != PJMEDIA_PORT_NO_CHANGE)
 	conf_port->tx_setting = tx;
 
     if (rx != PJMEDIA_PORT_NO_CHANGE)
 	conf_port->rx_setting = rx;
+}
+
+
+/*
+ * Apply all queued operations. Mutex must be held.
+ */
+static void handle_op_queue(pjmedia_conf *conf)
+{
+    while (!pj_list_empty(&conf->op_queue)) {
+	struct conf_op *op = conf->op_queue.next;
+
+	switch (op->type) {
+	case OP_ADD_PORT:
+	    op_add_port(conf, op->src, op->port);
+	    break;
+	case OP_REMOVE_PORT:
+	    op_remove_port(conf, op->src);
+	    break;
+	case OP_CONNECT_PORTS:
+	    op_connect_ports(conf, op->src, op->sink);
+	    break;
+	case OP_DISCONNECT_PORTS:
+	    op_disconnect_ports(conf, op->src, op->sink);
+	    break;
+	case OP_CONFIGURE_PORT:
+	    op_configure_port(conf, op->src, op->tx, op->rx);
+	    break;
+	case OP_ADJUST_RX_LEVEL:
+	    conf->ports[op->src]->rx_adj_level = op->level;
+	    break;
+	case OP_ADJUST_TX_LEVEL:
+	    conf->ports[op->src]->tx_adj_level = op->level;
+	    break;
+	}
+
+	pj_list_erase(op);
+	pj_list_push_back(&conf->op_free, op);
+    }
+}
+
+
+/*
+ * Get a queue entry for an operation on the port. Mutex must be held.
+ */
+static struct conf_op *alloc_op(pjmedia_conf *conf, enum op_type type,
+				unsigned src)
+{
+    struct conf_op *op;
+
+    if (!pj_list_empty(&conf->op_free)) {
+	op = conf->op_free.next;
+	pj_list_erase(op);
+    } else {
+	op = PJ_POOL_ZALLOC_T(conf->pool, struct conf_op);
+    }
+
+    op->type = type;
+    op->src = src;
+    op->sink = 0;
+    op->port = NULL;
+    op->tx = op->rx = PJMEDIA_PORT_NO_CHANGE;
+    op->level = NORMAL_LEVEL;
+
+    return op;
+}
+
+
+/*
+ * Queue the operation, and apply it right away if the clock tick is not
+ * running. Mutex must be held.
+ */
+static void push_op(pjmedia_conf *conf, struct conf_op *op)
+{
+    pj_list_push_back(&conf->op_queue, op);
+
+    if (!conf->in_tick)
+	handle_op_queue(conf);
+}
+
+
+/*
+ * Queue an operation on the ports. Mutex must be held.
+ */
+static void queue_op(pjmedia_conf *conf, enum op_type type,
+		     unsigned src, unsigned sink, struct conf_port *port)
+{
+    struct conf_op *op = alloc_op(conf, type, src);
+
+    op->sink = sink;
+    op->port = port;
+    push_op(conf, op);
+}
+
+
+/*
+ * Get the port in the slot as seen by the API, i.e. including the port
+ * whose addition is still queued. Mutex must be held.
+ */
+static struct conf_port *get_conf_port(pjmedia_conf *conf, unsigned slot)
+{
+    struct conf_op *op;
+
+    if (!conf->slot_used[slot])
+	return NULL;
+
+    /* The slot may have been emptied and reused during the tick, so the
+     * latest queued addition wins.
+     */
+    for (op=conf->op_queue.prev; op!=&conf->op_queue; op=op->prev) {
+	if (op->type == OP_ADD_PORT && op->src == slot)
+	    return op->port;
+    }
+
+    return conf->ports[slot];
+}
+
+
+/*
+ * Add stream port to the conference bridge.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_add_port( pjmedia_conf *conf,
+					   pj_pool_t *pool,
+					   pjmedia_port *strm_port,
+					   const pj_str_t *port_name,
+					   unsigned *p_port )
+{
+    struct conf_port *conf_port;
+    unsigned index;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(conf && pool && strm_port, PJ_EINVAL);
+
+    /* If port_name is not specified, use the port's name */
+    if (!port_name)
+	port_name = &strm_port->info.name;
+
+    /* For this version of PJMEDIA, channel(s) number MUST be:
+     * - same between port & conference bridge.
+     * - monochannel on port or conference bridge.
+     */
+    if (PJMEDIA_PIA_CCNT(&strm_port->info) != conf->channel_count &&
+	(PJMEDIA_PIA_CCNT(&strm_port->info) != 1 &&
+	 conf->channel_count != 1))
+    {
+	pj_assert(!"Number of channels mismatch");
+	return PJMEDIA_ENCCHANNEL;
+    }
+
+    pj_mutex_lock(conf->mutex);
+
+    if (conf->used_cnt >= conf->max_ports) {
+	pj_assert(!"Too many ports");
+	pj_mutex_unlock(conf->mutex);
+	return PJ_ETOOMANY;
+    }
+
+    /* Find empty port in the conference bridge. */
+    for (index=0; index < conf->max_ports; ++index) {
+	if (!conf->slot_used[index])
+	    break;
+    }
+
+    pj_assert(index != conf->max_ports);
+
+    /* Create conf port structure. */
+    status = create_conf_port(pool, conf, strm_port, port_name, &conf_port);
+    if (status != PJ_SUCCESS) {
+	pj_mutex_unlock(conf->mutex);
+	return status;
+    }
+
+    /* Put the port. */
+    conf->slot_used[index] = PJ_TRUE;
+    conf->used_cnt++;
+    queue_op(conf, OP_ADD_PORT, index, 0, conf_port);
+
+    /* Done. */
+    if (p_port) {
+	*p_port = index;
+    }
 
     pj_mutex_unlock(conf->mutex);
 
@@ -938,6 +1447,145 @@ PJ_DEF(pj_status_t) pjmedia_conf_configure_port( pjmedia_conf *conf,
 }
 
 
+/*
+ * Add passive port.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_add_passive_port( pjmedia_conf *conf,
+						   pj_pool_t *pool,
+						   const pj_str_t *name,
+						   unsigned clock_rate,
+						   unsigned channel_count,
+						   unsigned samples_per_frame,
+						   unsigned bits_per_sample,
+						   unsigned options,
+						   unsigned *p_slot,
+						   pjmedia_port **p_port )
+{
+    struct conf_port *conf_port;
+    pjmedia_port *port;
+    unsigned index;
+    pj_str_t tmp;
+    pj_status_t status;
+
+    PJ_LOG(1, (THIS_FILE, "This API has been deprecated since 1.3 and will "
+			  "be removed in the future release!"));
+
+    PJ_ASSERT_RETURN(conf && pool, PJ_EINVAL);
+
+    /* For this version of PJMEDIA, channel(s) number MUST be:
+     * - same between port & conference bridge.
+     * - monochannel on port or conference bridge.
+     */
+    if (channel_count != conf->channel_count && 
+	(channel_count != 1 && conf->channel_count != 1)) 
+    {
+	pj_assert(!"Number of channels mismatch");
+	return PJMEDIA_ENCCHANNEL;
+    }
+
+    /* For this version, options must be zero */
+    PJ_ASSERT_RETURN(options == 0, PJ_EINVAL);
+    PJ_UNUSED_ARG(options);
+
+    pj_mutex_lock(conf->mutex);
+
+    if (conf->used_cnt >= conf->max_ports) {
+	pj_assert(!"Too many ports");
+	pj_mutex_unlock(conf->mutex);
+	return PJ_ETOOMANY;
+    }
+
+    /* Find empty port in the conference bridge. */
+    for (index=0; index < conf->max_ports; ++index) {
+	if (!conf->slot_used[index])
+	    break;
+    }
+
+    pj_assert(index != conf->max_ports);
+
+    if (name == NULL) {
+	name = &tmp;
+
+	tmp.ptr = (char*) pj_pool_alloc(pool, 32);
+	tmp.slen = pj_ansi_snprintf(tmp.ptr, 32, "ConfPort#%d", index);
+    }
+
+    /* Create and initialize the media port structure. */
+    port = PJ_POOL_ZALLOC_T(pool, pjmedia_port);
+    PJ_ASSERT_RETURN(port, PJ_ENOMEM);
+    
+    pjmedia_port_info_init(&port->info, name, SIGNATURE_PORT,
+			   clock_rate, channel_count, bits_per_sample,
+			   samples_per_frame);
+
+    port->port_data.pdata = conf;
+    port->port_data.ldata = index;
+
+    port->get_frame = &get_frame_pasv;
+    port->put_frame = &put_frame;
+    port->on_destroy = &destroy_port_pasv;
+
+    
+    /* Create conf port structure. */
+    status = create_pasv_port(conf, pool, name, port, &conf_port);
+    if (status != PJ_SUCCESS) {
+	pj_mutex_unlock(conf->mutex);
+	return status;
+    }
+
+
+    /* Put the port. */
+    conf->slot_used[index] = PJ_TRUE;
+    conf->used_cnt++;
+    queue_op(conf, OP_ADD_PORT, index, 0, conf_port);
+
+    /* Done. */
+    if (p_slot)
+	*p_slot = index;
+    if (p_port)
+	*p_port = port;
+
+    pj_mutex_unlock(conf->mutex);
+
+    return PJ_SUCCESS;
+}
+
+
+
+/*
+ * Change TX and RX settings for the port.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_configure_port( pjmedia_conf *conf,
+						  unsigned slot,
+						  pjmedia_port_op tx,
+						  pjmedia_port_op rx)
+{
+    struct conf_op *op;
+
+    /* Check arguments */
+    PJ_ASSERT_RETURN(conf && slot<conf->max_ports, PJ_EINVAL);
+
+    pj_mutex_lock(conf->mutex);
+
+    /* Port must be valid. */
+    if (!conf->slot_used[slot]) {
+	pj_mutex_unlock(conf->mutex);
+	return PJ_EINVAL;
+    }
+
+    op = alloc_op(conf, OP_CONFIGURE_PORT, slot);
+    op->tx = tx;
+    op->rx = rx;
+    push_op(conf, op);
+
+    pj_mutex_unlock(conf->mutex);
+
+    return PJ_SUCCESS;
+}
+
+
+
+
 /*
  * Connect port.
  */
@@ -946,9 +1594,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_connect_port( pjmedia_conf *conf,
 					       unsigned sink_slot,
 					       int level )
 {
-    struct conf_port *src_port, *dst_port;
     pj_bool_t start_sound = PJ_FALSE;
-    unsigned i;
 
     /* Check arguments */
     PJ_ASSERT_RETURN(conf && src_slot<conf->max_ports && 
@@ -960,36 +1606,15 @@ PJ_DEF(pj_status_t) pjmedia_conf_connect_port( pjmedia_conf *conf,
     pj_mutex_lock(conf->mutex);
 
     /* Ports must be valid. */
-    src_port = conf->ports[src_slot];
-    dst_port = conf->ports[sink_slot];
-    if (!src_port || !dst_port) {
+    if (!conf->slot_used[src_slot] || !conf->slot_used[sink_slot]) {
 	pj_mutex_unlock(conf->mutex);
 	return PJ_EINVAL;
     }
 
-    /* Check if connection has been made */
-    for (i=0; i<src_port->listener_cnt; ++i) {
-	if (src_port->listener_slots[i] == sink_slot)
-	    break;
-    }
-
-    if (i == src_port->listener_cnt) {
-	src_port->listener_slots[src_port->listener_cnt] = sink_slot;
-	++conf->connect_cnt;
-	++src_port->listener_cnt;
-	++dst_port->transmitter_cnt;
+    if (conf->connect_cnt == 0)
+	start_sound = PJ_TRUE;
 
-	if (conf->connect_cnt == 1)
-	    start_sound = 1;
-
-	PJ_LOG(4,(THIS_FILE,"Port %d (%.*s) transmitting to port %d (%.*s)",
-		  src_slot,
-		  (int)src_port->name.slen,
-		  src_port->name.ptr,
-		  sink_slot,
-		  (int)dst_port->name.slen,
-		  dst_port->name.ptr));
-    }
+    queue_op(conf, OP_CONNECT_PORTS, src_slot, sink_slot, NULL);
 
     pj_mutex_unlock(conf->mutex);
 
@@ -1010,8 +1635,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_disconnect_port( pjmedia_conf *conf,
 						  unsigned src_slot,
 						  unsigned sink_slot )
 {
-    struct conf_port *src_port, *dst_port;
-    unsigned i;
+    pj_bool_t stop_sound;
 
     /* Check arguments */
     PJ_ASSERT_RETURN(conf && src_slot<conf->max_ports && 
@@ -1020,47 +1644,18 @@ PJ_DEF(pj_status_t) pjmedia_conf_disconnect_port( pjmedia_conf *conf,
     pj_mutex_lock(conf->mutex);
 
     /* Ports must be valid. */
-    src_port = conf->ports[src_slot];
-    dst_port = conf->ports[sink_slot];
-    if (!src_port || !dst_port) {
+    if (!conf->slot_used[src_slot] || !conf->slot_used[sink_slot]) {
 	pj_mutex_unlock(conf->mutex);
 	return PJ_EINVAL;
     }
 
-    /* Check if connection has been made */
-    for (i=0; i<src_port->listener_cnt; ++i) {
-	if (src_port->listener_slots[i] == sink_slot)
-	    break;
-    }
-
-    if (i != src_port->listener_cnt) {
-	pj_assert(src_port->listener_cnt > 0 && 
-		  src_port->listener_cnt < conf->max_ports);
-	pj_assert(dst_port->transmitter_cnt > 0 && 
-		  dst_port->transmitter_cnt < conf->max_ports);
-	pj_array_erase(src_port->listener_slots, sizeof(SLOT_TYPE), 
-		       src_port->listener_cnt, i);
-	--conf->connect_cnt;
-	--src_port->listener_cnt;
-	--dst_port->transmitter_cnt;
+    queue_op(conf, OP_DISCONNECT_PORTS, src_slot, sink_slot, NULL);
 
-	PJ_LOG(4,(THIS_FILE,
-		  "Port %d (%.*s) stop transmitting to port %d (%.*s)",
-		  src_slot,
-		  (int)src_port->name.slen,
-		  src_port->name.ptr,
-		  sink_slot,
-		  (int)dst_port->name.slen,
-		  dst_port->name.ptr));
-
-	/* if source port is passive port and has no listener, reset delaybuf */
-	if (src_port->delay_buf && src_port->listener_cnt == 0)
-	    pjmedia_delay_buf_reset(src_port->delay_buf);
-    }
+    stop_sound = (conf->connect_cnt == 0);
 
     pj_mutex_unlock(conf->mutex);
 
-    if (conf->connect_cnt == 0) {
+    if (stop_sound) {
 	pause_sound(conf);
     }
 
@@ -1072,7 +1667,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_disconnect_port( pjmedia_conf *conf,
  */
 PJ_DEF(unsigned) pjmedia_conf_get_port_count(pjmedia_conf *conf)
 {
-    return conf->port_cnt;
+    return conf->used_cnt;
 }
 
 /*
@@ -1090,84 +1685,41 @@ PJ_DEF(unsigned) pjmedia_conf_get_connect_count(pjmedia_conf *conf)
 PJ_DEF(pj_status_t) pjmedia_conf_remove_port( pjmedia_conf *conf,
 					      unsigned port )
 {
-    struct conf_port *conf_port;
-    unsigned i;
+    pj_bool_t stop_sound;
 
     /* Check arguments */
     PJ_ASSERT_RETURN(conf && port < conf->max_ports, PJ_EINVAL);
 
-    /* Suspend the sound devices.
-     * Don't want to remove port while port is being accessed by sound
-     * device's threads!
-     */
-
     pj_mutex_lock(conf->mutex);
 
     /* Port must be valid. */
-    conf_port = conf->ports[port];
-    if (conf_port == NULL) {
+    if (!conf->slot_used[port]) {
 	pj_mutex_unlock(conf->mutex);
 	return PJ_EINVAL;
     }
 
-    conf_port->tx_setting = PJMEDIA_PORT_DISABLE;
-    conf_port->rx_setting = PJMEDIA_PORT_DISABLE;
-
-    /* Remove this port from transmit array of other ports. */
-    for (i=0; i<conf->max_ports; ++i) {
-	unsigned j;
-	struct conf_port *src_port;
-
-	src_port = conf->ports[i];
-
-	if (!src_port)
-	    continue;
-
-	if (src_port->listener_cnt == 0)
-	    continue;
-
-	for (j=0; j<src_port->listener_cnt; ++j) {
-	    if (src_port->listener_slots[j] == port) {
-		pj_array_erase(src_port->listener_slots, sizeof(SLOT_TYPE),
-			       src_port->listener_cnt, j);
-		pj_assert(conf->connect_cnt > 0);
-		--conf->connect_cnt;
-		--src_port->listener_cnt;
-		break;
-	    }
-	}
-    }
+    conf->slot_used[port] = PJ_FALSE;
+    conf->used_cnt--;
+    queue_op(conf, OP_REMOVE_PORT, port, 0, NULL);
 
-    /* Update transmitter_cnt of ports we're transmitting to */
-    while (conf_port->listener_cnt) {
-	unsigned dst_slot;
-	struct conf_port *dst_port;
-
-	dst_slot = conf_port->listener_slots[conf_port->listener_cnt-1];
-	dst_port = conf->ports[dst_slot];
-	--dst_port->transmitter_cnt;
-	--conf_port->listener_cnt;
-	pj_assert(conf->connect_cnt > 0);
-	--conf->connect_cnt;
-    }
-
-    /* Destroy pjmedia port if this conf port is passive port,
-     * i.e: has delay buf.
+    /* The running clock tick may still be using the port, so wait until
+     * the tick ends and the port is removed, as the application may
+     * destroy the port as soon as we return. Don't wait if we're called
+     * from the tick itself (e.g: by the callback of a port).
      */
-    if (conf_port->delay_buf) {
-	pjmedia_port_destroy(conf_port->port);
-	conf_port->port = NULL;
+    if (conf->in_tick && !is_tick_thread(conf)) {
+	++conf->tick_waiters;
+	pj_mutex_unlock(conf->mutex);
+	pj_sem_wait(conf->tick_sem);
+	pj_mutex_lock(conf->mutex);
     }
 
-    /* Remove the port. */
-    conf->ports[port] = NULL;
-    --conf->port_cnt;
+    stop_sound = (conf->connect_cnt == 0);
 
     pj_mutex_unlock(conf->mutex);
 
-
     /* Stop sound if there's no connection. */
-    if (conf->connect_cnt == 0) {
+    if (stop_sound) {
 	pause_sound(conf);
     }
 
@@ -1190,7 +1742,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_enum_ports( pjmedia_conf *conf,
     pj_mutex_lock(conf->mutex);
 
     for (i=0; i<conf->max_ports && count<*p_count; ++i) {
-	if (!conf->ports[i])
+	if (!conf->slot_used[i])
 	    continue;
 
 	ports[count++] = i;
@@ -1219,7 +1771,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_get_port_info( pjmedia_conf *conf,
     pj_mutex_lock(conf->mutex);
 
     /* Port must be valid. */
-    conf_port = conf->ports[slot];
+    conf_port = get_conf_port(conf, slot);
     if (conf_port == NULL) {
 	pj_mutex_unlock(conf->mutex);
 	return PJ_EINVAL;
@@ -1258,7 +1810,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_get_ports_info(pjmedia_conf *conf,
     pj_mutex_lock(conf->mutex);
 
     for (i=0; i<conf->max_ports && count<*size; ++i) {
-	if (!conf->ports[i])
+	if (!conf->slot_used[i])
 	    continue;
 
 	pjmedia_conf_get_port_info(conf, i, &info[count]);
@@ -1290,7 +1842,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_get_signal_level( pjmedia_conf *conf,
     pj_mutex_lock(conf->mutex);
 
     /* Port must be valid. */
-    conf_port = conf->ports[slot];
+    conf_port = get_conf_port(conf, slot);
     if (conf_port == NULL) {
 	pj_mutex_unlock(conf->mutex);
 	return PJ_EINVAL;
@@ -1310,6 +1862,30 @@ PJ_DEF(pj_status_t) pjmedia_conf_get_signal_level( pjmedia_conf *conf,
 }
 
 
+/*
+ * Get the active speakers.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_get_active_speakers(pjmedia_conf *conf,
+						     unsigned slots[],
+						     unsigned *count)
+{
+    unsigned i, active_cnt;
+
+    /* Check arguments */
+    PJ_ASSERT_RETURN(conf && slots && count, PJ_EINVAL);
+
+    /* The speakers are selected by the clock tick without the mutex, so
+     * this may mix the selections of two consecutive ticks.
+     */
+    active_cnt = conf->active_cnt;
+    for (i=0; i<active_cnt && i<*count; ++i)
+	slots[i] = conf->active_slots[i];
+    *count = i;
+
+    return PJ_SUCCESS;
+}
+
+
 /*
  * Adjust RX level of individual port.
  */
@@ -1317,7 +1893,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_adjust_rx_level( pjmedia_conf *conf,
 						  unsigned slot,
 						  int adj_level )
 {
-    struct conf_port *conf_port;
+    struct conf_op *op;
 
     /* Check arguments */
     PJ_ASSERT_RETURN(conf && slot<conf->max_ports, PJ_EINVAL);
@@ -1332,14 +1908,15 @@ PJ_DEF(pj_status_t) pjmedia_conf_adjust_rx_level( pjmedia_conf *conf,
     pj_mutex_lock(conf->mutex);
 
     /* Port must be valid. */
-    conf_port = conf->ports[slot];
-    if (conf_port == NULL) {
+    if (!conf->slot_used[slot]) {
 	pj_mutex_unlock(conf->mutex);
 	return PJ_EINVAL;
     }
 
     /* Set normalized adjustment level. */
-    conf_port->rx_adj_level = adj_level + NORMAL_LEVEL;
+    op = alloc_op(conf, OP_ADJUST_RX_LEVEL, slot);
+    op->level = adj_level + NORMAL_LEVEL;
+    push_op(conf, op);
 
     /* Unlock mutex */
     pj_mutex_unlock(conf->mutex);
@@ -1355,7 +1932,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_adjust_tx_level( pjmedia_conf *conf,
 						  unsigned slot,
 						  int adj_level )
 {
-    struct conf_port *conf_port;
+    struct conf_op *op;
 
     /* Check arguments */
     PJ_ASSERT_RETURN(conf && slot<conf->max_ports, PJ_EINVAL);
@@ -1370,14 +1947,15 @@ PJ_DEF(pj_status_t) pjmedia_conf_adjust_tx_level( pjmedia_conf *conf,
     pj_mutex_lock(conf->mutex);
 
     /* Port must be valid. */
-    conf_port = conf->ports[slot];
-    if (conf_port == NULL) {
+    if (!conf->slot_used[slot]) {
 	pj_mutex_unlock(conf->mutex);
 	return PJ_EINVAL;
     }
 
     /* Set normalized adjustment level. */
-    conf_port->tx_adj_level = adj_level + NORMAL_LEVEL;
+    op = alloc_op(conf, OP_ADJUST_TX_LEVEL, slot);
+    op->level = adj_level + NORMAL_LEVEL;
+    push_op(conf, op);
 
     /* Unlock mutex */
     pj_mutex_unlock(conf->mutex);
@@ -1387,12 +1965,18 @@ PJ_DEF(pj_status_t) pjmedia_conf_adjust_tx_level( pjmedia_conf *conf,
 
 
 /*
- * Read from port.
+ * Read from port. The frame is read to the buffer in \a p_frame, unless
+ * the port gives it by reference: \a p_fbuf then receives the reference,
+ * and \a p_frame the samples in the frame buffer.
  */
 static pj_status_t read_port( pjmedia_conf *conf,
-			      struct conf_port *cport, pj_int16_t *frame,
-			      pj_size_t count, pjmedia_frame_type *type )
+			      struct conf_port *cport, pj_int16_t **p_frame,
+			      pj_size_t count, pjmedia_frame_type *type,
+			      pjmedia_frame_buf **p_fbuf )
 {
+    pj_int16_t *frame = *p_frame;
+
+    *p_fbuf = NULL;
 
     pj_assert(count == conf->samples_per_frame);
 
@@ -1407,6 +1991,7 @@ static pj_status_t read_port( pjmedia_conf *conf,
      */
     if (cport->rx_buf_cap == 0) {
 	pjmedia_frame f;
+	pjmedia_frame_buf *fbuf;
 	pj_status_t status;
 
 	f.buf = frame;
@@ -1416,7 +2001,17 @@ static pj_status_t read_port( pjmedia_conf *conf,
 		   (int)cport->name.slen, cport->name.ptr,
 		   count));
 
-	status = pjmedia_port_get_frame(cport->port, &f);
+	status = pjmedia_port_get_frame_buf(cport->port, &f, &fbuf);
+	if (status == PJ_ENOTSUP) {
+	    status = pjmedia_port_get_frame(cport->port, &f);
+	} else if (fbuf) {
+	    if (status == PJ_SUCCESS && f.type == PJMEDIA_FRAME_TYPE_AUDIO) {
+		*p_frame = (pj_int16_t*) f.buf;
+		*p_fbuf = fbuf;
+	    } else {
+		pjmedia_frame_buf_dec_ref(fbuf);
+	    }
+	}
 
 	*type = f.type;
 
@@ -1545,7 +2140,9 @@ static pj_status_t write_port(pjmedia_conf *conf, struct conf_port *cport,
 			      pjmedia_frame_type *frm_type)
 {
     pj_int16_t *buf;
-    unsigned j, ts;
+    pjmedia_frame_buf *fbuf;
+    pj_bool_t same_format;
+    unsigned ts;
     pj_status_t status;
     pj_int32_t adj_level;
     pj_int32_t tx_level;
@@ -1604,6 +2201,21 @@ static pj_status_t write_port(pjmedia_conf *conf, struct conf_port *cport,
     cport->tx_heart_beat = 0;
 
     buf = (pj_int16_t*) cport->mix_buf;
+    fbuf = NULL;
+
+    /* If the port has the same clock_rate and samples_per_frame and
+     * number of channels as the conference bridge, and it takes frames
+     * by reference, the mixed samples are converted directly to a frame
+     * buffer which is then given to the port.
+     */
+    same_format = (cport->clock_rate == conf->clock_rate &&
+		   cport->samples_per_frame == conf->samples_per_frame &&
+		   cport->channel_count == conf->channel_count);
+    if (same_format && cport->port && cport->port->put_frame_buf &&
+	pjmedia_frame_pool_alloc(conf->frame_pool, &fbuf) == PJ_SUCCESS)
+    {
+	buf = (pj_int16_t*) fbuf->buf;
+    }
 
     /* If there are sources in the mix buffer, convert the mixed samples
      * from 32bit to 16bit in the mixed samples itself. This is possible 
@@ -1630,31 +2242,11 @@ static pj_status_t write_port(pjmedia_conf *conf, struct conf_port *cport,
     adj_level = cport->tx_adj_level * cport->mix_adj;
     adj_level >>= 7;
 
-    tx_level = 0;
-
-    if (adj_level != NORMAL_LEVEL) {
-	for (j=0; j<conf->samples_per_frame; ++j) {
-	    pj_int32_t itemp = cport->mix_buf[j];
-
-	    /* Adjust the level */
-	    /*itemp = itemp * adj_level / NORMAL_LEVEL;*/
-	    itemp = (itemp * adj_level) >> 7;
-
-	    /* Clip the signal if it's too loud */
-	    if (itemp > MAX_LEVEL) itemp = MAX_LEVEL;
-	    else if (itemp < MIN_LEVEL) itemp = MIN_LEVEL;
-
-	    /* Put back in the buffer. */
-	    buf[j] = (pj_int16_t) itemp;
-
-	    tx_level += (buf[j]>=0? buf[j] : -buf[j]);
-	}
-    } else {
-	for (j=0; j<conf->samples_per_frame; ++j) {
-	    buf[j] = (pj_int16_t) cport->mix_buf[j];
-	    tx_level += (buf[j]>=0? buf[j] : -buf[j]);
-	}
-    }
+    /* Adjust the level, clip the signal if it's too loud, and put it
+     * back in the buffer.
+     */
+    tx_level = pjmedia_mix_adjust(buf, cport->mix_buf, conf->samples_per_frame,
+				  adj_level);
 
     tx_level /= conf->samples_per_frame;
 
@@ -1667,10 +2259,7 @@ static pj_status_t write_port(pjmedia_conf *conf, struct conf_port *cport,
      * number of channels as the conference bridge, transmit the 
      * frame as is.
      */
-    if (cport->clock_rate == conf->clock_rate &&
-	cport->samples_per_frame == conf->samples_per_frame &&
-	cport->channel_count == conf->channel_count)
-    {
+    if (same_format) {
 	if (cport->port != NULL) {
 	    pjmedia_frame frame;
 
@@ -1686,7 +2275,10 @@ static pj_status_t write_port(pjmedia_conf *conf, struct conf_port *cport,
 			       (int)cport->name.slen, cport->name.ptr,
 			       frame.size / BYTES_PER_SAMPLE));
 
-	    return pjmedia_port_put_frame(cport->port, &frame);
+	    status = pjmedia_port_put_frame_buf(cport->port, &frame, fbuf);
+	    if (fbuf)
+		pjmedia_frame_buf_dec_ref(fbuf);
+	    return status;
 	} else
 	    return PJ_SUCCESS;
     }
@@ -1778,216 +2370,239 @@ static pj_status_t write_port(pjmedia_conf *conf, struct conf_port *cport,
 
 
 /*
- * Player callback.
+ * Read phase of the clock tick: get the frame from the port in the slot
+ * to its RX frame.
  */
-static pj_status_t get_frame(pjmedia_port *this_port, 
-			     pjmedia_frame *frame)
+static void read_slot(pjmedia_conf *conf, unsigned slot)
 {
-    pjmedia_conf *conf = (pjmedia_conf*) this_port->port_data.pdata;
-    pjmedia_frame_type speaker_frame_type = PJMEDIA_FRAME_TYPE_NONE;
-    unsigned ci, cj, i, j;
-    pj_int16_t *p_in;
-    
-    TRACE_((THIS_FILE, "- clock -"));
-
-    /* Check that correct size is specified. */
-    pj_assert(frame->size == conf->samples_per_frame *
-			     conf->bits_per_sample / 8);
+    struct conf_port *conf_port = conf->ports[slot];
+    pj_int32_t level = 0;
 
-    /* Must lock mutex */
-    pj_mutex_lock(conf->mutex);
+    /* Skip empty port. */
+    if (!conf_port)
+	return;
 
-    /* Reset port source count. We will only reset port's mix
-     * buffer when we have someone transmitting to it.
-     */
-    for (i=0, ci=0; i<conf->max_ports && ci < conf->port_cnt; ++i) {
-	struct conf_port *conf_port = conf->ports[i];
+    conf_port->rx_frame_ok = PJ_FALSE;
 
-	/* Skip empty port. */
-	if (!conf_port)
-	    continue;
+    /* The frame of the previous tick is no longer needed */
+    release_rx_frame(conf_port);
 
-	/* Var "ci" is to count how many ports have been visited so far. */
-	++ci;
+    /* Skip if we're not allowed to receive from this port. */
+    if (conf_port->rx_setting == PJMEDIA_PORT_DISABLE) {
+	conf_port->rx_level = 0;
+	return;
+    }
 
-	/* Reset buffer (only necessary if the port has transmitter) and
-	 * reset auto adjustment level for mixed signal.
-	 */
-	conf_port->mix_adj = NORMAL_LEVEL;
-	if (conf_port->transmitter_cnt) {
-	    pj_bzero(conf_port->mix_buf,
-		     conf->samples_per_frame*sizeof(conf_port->mix_buf[0]));
-	}
+    /* Also skip if this port doesn't have listeners. */
+    if (conf_port->listener_cnt == 0) {
+	conf_port->rx_level = 0;
+	return;
     }
 
-    /* Get frames from all ports, and "mix" the signal 
-     * to mix_buf of all listeners of the port.
+    /* Get frame from this port.
+     * For passive ports, get the frame from the delay_buf.
+     * For other ports, get the frame from the port. 
      */
-    for (i=0, ci=0; i < conf->max_ports && ci < conf->port_cnt; ++i) {
-	struct conf_port *conf_port = conf->ports[i];
-	pj_int32_t level = 0;
+    if (conf_port->delay_buf != NULL) {
+	pj_status_t status;
+    
+	status = pjmedia_delay_buf_get(conf_port->delay_buf,
+				       conf_port->rx_frame);
+	if (status != PJ_SUCCESS)
+	    return;
 
-	/* Skip empty port. */
-	if (!conf_port)
-	    continue;
+    } else {
 
-	/* Var "ci" is to count how many ports have been visited so far. */
-	++ci;
+	pj_status_t status;
+	pjmedia_frame_type frame_type;
+	pj_int16_t *frame = conf_port->rx_frame;
+	pjmedia_frame_buf *fbuf;
 
-	/* Skip if we're not allowed to receive from this port. */
-	if (conf_port->rx_setting == PJMEDIA_PORT_DISABLE) {
-	    conf_port->rx_level = 0;
-	    continue;
+	status = read_port(conf, conf_port, &frame,
+			   conf->samples_per_frame, &frame_type, &fbuf);
+	
+	if (status != PJ_SUCCESS) {
+	    /* bennylp: why do we need this????
+	     * Also see comments on similar issue with write_port().
+	    PJ_LOG(4,(THIS_FILE, "Port %.*s get_frame() returned %d. "
+				 "Port is now disabled",
+				 (int)conf_port->name.slen,
+				 conf_port->name.ptr,
+				 status));
+	    conf_port->rx_setting = PJMEDIA_PORT_DISABLE;
+	     */
+	    return;
 	}
 
-	/* Also skip if this port doesn't have listeners. */
-	if (conf_port->listener_cnt == 0) {
-	    conf_port->rx_level = 0;
-	    continue;
+	/* Check that the port is not removed when we call get_frame() */
+	if (conf->ports[slot] == NULL) {
+	    if (fbuf)
+		pjmedia_frame_buf_dec_ref(fbuf);
+	    return;
 	}
 
-	/* Get frame from this port.
-	 * For passive ports, get the frame from the delay_buf.
-	 * For other ports, get the frame from the port. 
-	 */
-	if (conf_port->delay_buf != NULL) {
-	    pj_status_t status;
-	
-	    status = pjmedia_delay_buf_get(conf_port->delay_buf,
-				  (pj_int16_t*)frame->buf);
-	    if (status != PJ_SUCCESS)
-		continue;
+	/* Ignore if we didn't get any frame */
+	if (frame_type != PJMEDIA_FRAME_TYPE_AUDIO)
+	    return;
 
-	} else {
+	/* Mix the frame given by reference without copying it */
+	if (fbuf) {
+	    conf_port->rx_fbuf = fbuf;
+	    conf_port->rx_frame = frame;
+	}
+    }
 
-	    pj_status_t status;
-	    pjmedia_frame_type frame_type;
+    /* Adjust the RX level from this port
+     * and calculate the average level at the same time.
+     */
+    if (conf_port->rx_adj_level != NORMAL_LEVEL) {
+	/* Other holders may read the frame buffer, adjust a copy */
+	if (conf_port->rx_fbuf) {
+	    pjmedia_copy_samples(conf_port->rx_frame_buf,
+				 conf_port->rx_frame,
+				 conf->samples_per_frame);
+	    release_rx_frame(conf_port);
+	}
 
-	    status = read_port(conf, conf_port, (pj_int16_t*)frame->buf, 
-			       conf->samples_per_frame, &frame_type);
-	    
-	    if (status != PJ_SUCCESS) {
-		/* bennylp: why do we need this????
-		 * Also see comments on similar issue with write_port().
-		PJ_LOG(4,(THIS_FILE, "Port %.*s get_frame() returned %d. "
-				     "Port is now disabled",
-				     (int)conf_port->name.slen,
-				     conf_port->name.ptr,
-				     status));
-		conf_port->rx_setting = PJMEDIA_PORT_DISABLE;
-		 */
-		continue;
-	    }
+	level = pjmedia_mix_adjust_samples(conf_port->rx_frame,
+					   conf->samples_per_frame,
+					   conf_port->rx_adj_level);
+    } else {
+	level = pjmedia_mix_level(conf_port->rx_frame,
+				  conf->samples_per_frame);
+    }
 
-	    /* Check that the port is not removed when we call get_frame() */
-	    if (conf->ports[i] == NULL)
-		continue;
+    level /= conf->samples_per_frame;
 
-	    /* Ignore if we didn't get any frame */
-	    if (frame_type != PJMEDIA_FRAME_TYPE_AUDIO)
-		continue;
-	}
+    /* Convert level to 8bit complement ulaw */
+    level = pjmedia_linear2ulaw(level) ^ 0xff;
 
-	p_in = (pj_int16_t*) frame->buf;
+    /* Put this level to port's last RX level. */
+    conf_port->rx_level = level;
 
-	/* Adjust the RX level from this port
-	 * and calculate the average level at the same time.
-	 */
-	if (conf_port->rx_adj_level != NORMAL_LEVEL) {
-	    for (j=0; j<conf->samples_per_frame; ++j) {
-		/* For the level adjustment, we need to store the sample to
-		 * a temporary 32bit integer value to avoid overflowing the
-		 * 16bit sample storage.
-		 */
-		pj_int32_t itemp;
+    // Ticket #671: Skipping very low audio signal may cause noise 
+    // to be generated in the remote end by some hardphones.
+    /* Skip processing frame if level is zero */
+    //if (level == 0)
+    //    return;
 
-		itemp = p_in[j];
-		/*itemp = itemp * adj / NORMAL_LEVEL;*/
-		/* bad code (signed/unsigned badness):
-		 *  itemp = (itemp * conf_port->rx_adj_level) >> 7;
-		 */
-		itemp *= conf_port->rx_adj_level;
-		itemp >>= 7;
+    conf_port->rx_frame_ok = PJ_TRUE;
+}
 
-		/* Clip the signal if it's too loud */
-		if (itemp > MAX_LEVEL) itemp = MAX_LEVEL;
-		else if (itemp < MIN_LEVEL) itemp = MIN_LEVEL;
 
-		p_in[j] = (pj_int16_t) itemp;
-		level += (p_in[j]>=0? p_in[j] : -p_in[j]);
-	    }
-	} else {
-	    for (j=0; j<conf->samples_per_frame; ++j) {
-		level += (p_in[j]>=0? p_in[j] : -p_in[j]);
-	    }
-	}
+/*
+ * Set the level adjustment of the mix buffer if the mixed signal
+ * overflows.
+ */
+static void check_overflow(struct conf_port *listener,
+			   pj_int32_t vmin, pj_int32_t vmax)
+{
+    if (IS_OVERFLOW(vmax) || IS_OVERFLOW(vmin)) {
+	/* The largest overflowed sample needs the most adjustment. */
+	pj_int32_t peak = (vmax > -vmin) ? vmax : -vmin;
+
+	/* NORMAL_LEVEL * MAX_LEVEL / peak; */
+	int tmp_adj = (MAX_LEVEL<<7) / peak;
 
-	level /= conf->samples_per_frame;
+	if (tmp_adj<listener->mix_adj)
+	    listener->mix_adj = tmp_adj;
+    }
+}
 
-	/* Convert level to 8bit complement ulaw */
-	level = pjmedia_linear2ulaw(level) ^ 0xff;
 
-	/* Put this level to port's last RX level. */
-	conf_port->rx_level = level;
+/*
+ * Mix the frames received from the transmitters of the port to its
+ * mix buffer.
+ */
+static void mix_port(pjmedia_conf *conf, struct conf_port *listener)
+{
+    unsigned i, mixed = 0;
 
-	// Ticket #671: Skipping very low audio signal may cause noise 
-	// to be generated in the remote end by some hardphones.
-	/* Skip processing frame if level is zero */
-	//if (level == 0)
-	//    continue;
+    /* Reset auto adjustment level for mixed signal. */
+    listener->mix_adj = NORMAL_LEVEL;
 
-	/* Add the signal to all listeners. */
-	for (cj=0; cj < conf_port->listener_cnt; ++cj) 
-	{
-	    struct conf_port *listener;
-	    pj_int32_t *mix_buf;
-	    unsigned k;
+    /* Nothing to do if nobody is transmitting to this port or if the
+     * port doesn't want to receive audio.
+     */
+    if (listener->transmitter_cnt == 0)
+	return;
 
-	    listener = conf->ports[conf_port->listener_slots[cj]];
+    if (listener->tx_setting == PJMEDIA_PORT_ENABLE) {
+	for (i=0; i < listener->transmitter_cnt; ++i) {
+	    struct conf_port *conf_port;
 
-	    /* Skip if this listener doesn't want to receive audio */
-	    if (listener->tx_setting != PJMEDIA_PORT_ENABLE)
+	    conf_port = conf->ports[listener->transmitter_slots[i]];
+	    if (!conf_port->rx_frame_ok)
 		continue;
 
-	    mix_buf = listener->mix_buf;
+	    if (mixed == 0) {
+		/* First signal:
+		 * just copy the samples to the mix buffer
+		 * no mixing and level adjustment needed
+		 */
+		pjmedia_mix_copy(listener->mix_buf, conf_port->rx_frame,
+				 conf->samples_per_frame);
+	    } else {
+		pj_int32_t vmin, vmax;
 
-	    if (listener->transmitter_cnt > 1) {
 		/* Mixing signals,
 		 * and calculate appropriate level adjustment if there is
 		 * any overflowed level in the mixed signal.
 		 */
-		for (k=0; k < conf->samples_per_frame; ++k) {
-		    mix_buf[k] += p_in[k];
-		    /* Check if normalization adjustment needed. */
-		    if (IS_OVERFLOW(mix_buf[k])) {
-			/* NORMAL_LEVEL * MAX_LEVEL / mix_buf[k]; */
-			int tmp_adj = (MAX_LEVEL<<7) / mix_buf[k];
-			if (tmp_adj<0) tmp_adj = -tmp_adj;
-
-			if (tmp_adj<listener->mix_adj)
-			    listener->mix_adj = tmp_adj;
-
-		    } /* if any overflow in the mixed signals */
-		} /* loop mixing signals */
-	    } else {
-		/* Only 1 transmitter:
-		 * just copy the samples to the mix buffer
-		 * no mixing and level adjustment needed
-		 */
-		for (k=0; k<conf->samples_per_frame; ++k) {
-		    mix_buf[k] = p_in[k];
-		}
+		pjmedia_mix_add(listener->mix_buf, conf_port->rx_frame,
+				conf->samples_per_frame, &vmin, &vmax);
+
+		/* Check if normalization adjustment needed. */
+		check_overflow(listener, vmin, vmax);
 	    }
-	} /* loop the listeners of conf port */
-    } /* loop of all conf ports */
+	    ++mixed;
+	} /* loop the transmitters of the port */
+    }
+
+    if (mixed == 0) {
+	pj_bzero(listener->mix_buf,
+		 conf->samples_per_frame*sizeof(listener->mix_buf[0]));
+    }
+}
+
+
+/*
+ * Check if a port is one of the transmitters of another port.
+ */
+static pj_bool_t has_transmitter(const struct conf_port *listener,
+				 unsigned slot)
+{
+    unsigned lo = 0, hi = listener->transmitter_cnt;
+
+    /* Transmitters are sorted */
+    while (lo < hi) {
+	unsigned mid = (lo + hi) / 2;
+
+	if (listener->transmitter_slots[mid] == slot)
+	    return PJ_TRUE;
+	else if (listener->transmitter_slots[mid] < slot)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+
+    return PJ_FALSE;
+}
+
+
+/*
+ * Select the loudest ports as the active speakers, and mix them to the
+ * speaker sum. This runs between the read and the write phase.
+ */
+static void select_speakers(pjmedia_conf *conf)
+{
+    SLOT_TYPE *slots = conf->active_slots;
+    unsigned *score = conf->active_score;
+    unsigned i, j, ci, cnt = 0;
 
-    /* Time for all ports to transmit whetever they have in their
-     * buffer. 
-     */
     for (i=0, ci=0; i<conf->max_ports && ci<conf->port_cnt; ++i) {
 	struct conf_port *conf_port = conf->ports[i];
-	pjmedia_frame_type frm_type;
-	pj_status_t status;
+	unsigned level, port_score;
 
 	if (!conf_port)
 	    continue;
@@ -1995,32 +2610,329 @@ static pj_status_t get_frame(pjmedia_port *this_port,
 	/* Var "ci" is to count how many ports have been visited. */
 	++ci;
 
-	status = write_port( conf, conf_port, &frame->timestamp,
-			     &frm_type);
-	if (status != PJ_SUCCESS) {
-	    /* bennylp: why do we need this????
-	       One thing for sure, put_frame()/write_port() may return
-	       non-successfull status on Win32 if there's temporary glitch
-	       on network interface, so disabling the port here does not
-	       sound like a good idea.
+	/* Follow rising level immediately, and falling level slowly */
+	level = conf_port->rx_frame_ok ? conf_port->rx_level : 0;
+	if (level >= conf_port->speaker_level)
+	    conf_port->speaker_level = level;
+	else
+	    conf_port->speaker_level -= (conf_port->speaker_level-level+7)/8;
 
-	    PJ_LOG(4,(THIS_FILE, "Port %.*s put_frame() returned %d. "
-				 "Port is now disabled",
-				 (int)conf_port->name.slen,
-				 conf_port->name.ptr,
-				 status));
-	    conf_port->tx_setting = PJMEDIA_PORT_DISABLE;
-	    */
+	/* Current speakers need to be beaten by a margin */
+	port_score = conf_port->speaker_level;
+	if (conf_port->active_speaker)
+	    port_score += PJMEDIA_CONF_SPEAKER_HYSTERESIS;
+	conf_port->active_speaker = PJ_FALSE;
+
+	if (!conf_port->rx_frame_ok)
 	    continue;
+
+	/* Insert to the list of the loudest ports, sorted by score */
+	if (cnt == conf->active_max) {
+	    if (port_score <= score[cnt-1])
+		continue;
+	    --cnt;
+	}
+	for (j=cnt; j>0 && score[j-1] < port_score; --j) {
+	    score[j] = score[j-1];
+	    slots[j] = slots[j-1];
+	}
+	score[j] = port_score;
+	slots[j] = i;
+	++cnt;
+    }
+
+    /* Sort the speakers by slot, to mix them in the order they are read */
+    for (i=1; i<cnt; ++i) {
+	SLOT_TYPE slot = slots[i];
+
+	for (j=i; j>0 && slots[j-1] > slot; --j)
+	    slots[j] = slots[j-1];
+	slots[j] = slot;
+    }
+
+    conf->active_cnt = cnt;
+    conf->sum_min = conf->sum_max = 0;
+    for (i=0; i<cnt; ++i) {
+	struct conf_port *conf_port = conf->ports[slots[i]];
+
+	conf_port->active_speaker = PJ_TRUE;
+	if (i == 0) {
+	    pjmedia_mix_copy(conf->speaker_sum, conf_port->rx_frame,
+			     conf->samples_per_frame);
+	} else {
+	    pjmedia_mix_add(conf->speaker_sum, conf_port->rx_frame,
+			    conf->samples_per_frame,
+			    &conf->sum_min, &conf->sum_max);
+	}
+    }
+}
+
+
+/*
+ * Mix the active speakers heard by the port to its mix buffer.
+ */
+static void mix_port_active(pjmedia_conf *conf, struct conf_port *listener)
+{
+    unsigned i, heard = 0, mixed = 0;
+    pj_int32_t vmin, vmax;
+
+    /* Reset auto adjustment level for mixed signal. */
+    listener->mix_adj = NORMAL_LEVEL;
+
+    if (listener->transmitter_cnt == 0)
+	return;
+
+    if (listener->tx_setting == PJMEDIA_PORT_ENABLE) {
+	for (i=0; i<conf->active_cnt; ++i) {
+	    if (has_transmitter(listener, conf->active_slots[i]))
+		++heard;
 	}
+    }
+
+    if (heard == 0) {
+	pj_bzero(listener->mix_buf,
+		 conf->samples_per_frame*sizeof(listener->mix_buf[0]));
+	return;
+    }
+
+    if (heard == conf->active_cnt) {
+	/* Hears all active speakers, use the sum. */
+	pj_memcpy(listener->mix_buf, conf->speaker_sum,
+		  conf->samples_per_frame*sizeof(listener->mix_buf[0]));
+	check_overflow(listener, conf->sum_min, conf->sum_max);
+	return;
+    }
 
-	/* Set the type of frame to be returned to sound playback
-	 * device.
+    if (heard == conf->active_cnt-1 && listener->active_speaker) {
+	/* Probably hears all other active speakers, unless it hears
+	 * itself and misses another one. If so, remove its own signal
+	 * from the sum.
 	 */
-	if (i == 0)
-	    speaker_frame_type = frm_type;
+	for (i=0; i<conf->active_cnt; ++i) {
+	    struct conf_port *speaker = conf->ports[conf->active_slots[i]];
+
+	    if (speaker == listener)
+		continue;
+	    if (!has_transmitter(listener, conf->active_slots[i]))
+		break;
+	}
+
+	if (i == conf->active_cnt) {
+	    pjmedia_mix_sub(listener->mix_buf, conf->speaker_sum,
+			    listener->rx_frame, conf->samples_per_frame,
+			    &vmin, &vmax);
+	    check_overflow(listener, vmin, vmax);
+	    return;
+	}
+    }
+
+    /* Mix the active speakers it hears */
+    for (i=0; i<conf->active_cnt; ++i) {
+	unsigned slot = conf->active_slots[i];
+
+	if (!has_transmitter(listener, slot))
+	    continue;
+
+	if (mixed == 0) {
+	    pjmedia_mix_copy(listener->mix_buf, conf->ports[slot]->rx_frame,
+			     conf->samples_per_frame);
+	} else {
+	    pjmedia_mix_add(listener->mix_buf, conf->ports[slot]->rx_frame,
+			    conf->samples_per_frame, &vmin, &vmax);
+	    check_overflow(listener, vmin, vmax);
+	}
+	++mixed;
+    }
+}
+
+
+/*
+ * Write phase of the clock tick: mix the signal for the port in the slot
+ * and transmit it to the port.
+ */
+static void write_slot(pjmedia_conf *conf, unsigned slot)
+{
+    struct conf_port *conf_port = conf->ports[slot];
+    pjmedia_frame_type frm_type;
+    pj_status_t status;
+
+    if (!conf_port)
+	return;
+
+    if (conf->active_max)
+	mix_port_active(conf, conf_port);
+    else
+	mix_port(conf, conf_port);
+
+    status = write_port( conf, conf_port, &conf->tick_ts, &frm_type);
+    if (status != PJ_SUCCESS) {
+	/* bennylp: why do we need this????
+	   One thing for sure, put_frame()/write_port() may return
+	   non-successfull status on Win32 if there's temporary glitch
+	   on network interface, so disabling the port here does not
+	   sound like a good idea.
+
+	PJ_LOG(4,(THIS_FILE, "Port %.*s put_frame() returned %d. "
+			     "Port is now disabled",
+			     (int)conf_port->name.slen,
+			     conf_port->name.ptr,
+			     status));
+	conf_port->tx_setting = PJMEDIA_PORT_DISABLE;
+	*/
+	frm_type = PJMEDIA_FRAME_TYPE_NONE;
+    }
+
+    conf_port->tx_frame_type = frm_type;
+}
+
+
+/*
+ * Pick and run jobs of the current phase until all slots are processed.
+ */
+static void run_jobs(pjmedia_conf *conf)
+{
+    for (;;) {
+	unsigned i, start, end;
+
+	start = (unsigned)(pj_atomic_inc_and_get(conf->job_idx) - 1) *
+		conf->job_chunk;
+	if (start >= conf->max_ports)
+	    break;
+
+	end = start + conf->job_chunk;
+	if (end > conf->max_ports)
+	    end = conf->max_ports;
+
+	for (i=start; i<end; ++i)
+	    (*conf->job_cb)(conf, i);
+    }
+}
+
+
+/*
+ * Worker thread.
+ */
+static int worker_thread(void *arg)
+{
+    pjmedia_conf *conf = (pjmedia_conf*) arg;
+
+    for (;;) {
+	pj_sem_wait(conf->job_sem);
+	if (conf->quit)
+	    break;
+
+	run_jobs(conf);
+	pj_sem_post(conf->done_sem);
+    }
+
+    return 0;
+}
+
+
+/*
+ * Run a phase of the clock tick for all slots, and return when all slots
+ * have been processed.
+ */
+static void run_phase(pjmedia_conf *conf,
+		      void (*cb)(pjmedia_conf*, unsigned))
+{
+    unsigned i, ci;
+
+    if (conf->worker_cnt == 0) {
+	for (i=0, ci=0; i<conf->max_ports && ci<conf->port_cnt; ++i) {
+	    if (!conf->ports[i])
+		continue;
+
+	    /* Var "ci" is to count how many ports have been visited. */
+	    ++ci;
+
+	    (*cb)(conf, i);
+	}
+	return;
     }
 
+    /* Wake up the workers and help them */
+    conf->job_cb = cb;
+    pj_atomic_set(conf->job_idx, 0);
+    for (i=0; i<conf->worker_cnt; ++i)
+	pj_sem_post(conf->job_sem);
+
+    run_jobs(conf);
+
+    /* Wait until all workers are done */
+    for (i=0; i<conf->worker_cnt; ++i)
+	pj_sem_wait(conf->done_sem);
+}
+
+
+/*
+ * End the clock tick, and apply the operations queued while it was
+ * running.
+ */
+static void end_tick(pjmedia_conf *conf)
+{
+    unsigned waiters;
+
+    pj_mutex_lock(conf->mutex);
+
+    handle_op_queue(conf);
+    conf->in_tick = PJ_FALSE;
+    conf->tick_thread = NULL;
+
+    waiters = conf->tick_waiters;
+    conf->tick_waiters = 0;
+
+    pj_mutex_unlock(conf->mutex);
+
+    while (waiters--)
+	pj_sem_post(conf->tick_sem);
+}
+
+
+/*
+ * Player callback.
+ */
+static pj_status_t get_frame(pjmedia_port *this_port, 
+			     pjmedia_frame *frame)
+{
+    pjmedia_conf *conf = (pjmedia_conf*) this_port->port_data.pdata;
+    pjmedia_frame_type speaker_frame_type;
+    
+    TRACE_((THIS_FILE, "- clock -"));
+
+    /* Check that correct size is specified. */
+    pj_assert(frame->size == conf->samples_per_frame *
+			     conf->bits_per_sample / 8);
+
+    /* The mutex is only held at the start and the end of the tick, and
+     * not while mixing, so the functions of the API never wait for the
+     * mixing to finish.
+     */
+    pj_mutex_lock(conf->mutex);
+    conf->in_tick = PJ_TRUE;
+    conf->tick_thread = pj_thread_this();
+    pj_mutex_unlock(conf->mutex);
+
+    conf->tick_ts = frame->timestamp;
+
+    /* Get frames from all ports. */
+    run_phase(conf, &read_slot);
+
+    /* Select the active speakers. */
+    if (conf->active_max)
+	select_speakers(conf);
+
+    /* Time for all ports to "mix" the signal from their transmitters
+     * and transmit whetever they have in their buffer. The frames of
+     * all ports must have been read before any port can start mixing.
+     */
+    run_phase(conf, &write_slot);
+
+    /* Set the type of frame to be returned to sound playback
+     * device.
+     */
+    speaker_frame_type = conf->ports[0]->tx_frame_type;
+
     /* Return sound playback frame. */
     if (conf->ports[0]->tx_level) {
 	TRACE_((THIS_FILE, "write to audio, count=%d", 
@@ -2036,7 +2948,7 @@ static pj_status_t get_frame(pjmedia_port *this_port,
     /* MUST set frame type */
     frame->type = speaker_frame_type;
 
-    pj_mutex_unlock(conf->mutex);
+    end_tick(conf);
 
 #ifdef REC_FILE
     if (fhnd_rec == NULL)
@@ -82,6 +82,9 @@ struct pjmedia_endpt
     /** Codec manager. */
     pjmedia_codec_mgr	  codec_mgr;
 
+    /** Frame storage shared by the jitter buffers of the streams. */
+    pjmedia_jb_slab	 *jb_slab;
+
     /** IOqueue instance. */
     pj_ioqueue_t 	 *ioqueue;
 
@@ -145,6 +148,11 @@ PJ_DEF(pj_status_t) pjmedia_endpt_create(pj_pool_factory *pf,
     if (status != PJ_SUCCESS)
 	goto on_error;
 
+    /* Create frame storage for the jitter buffers. */
+    status = pjmedia_jb_slab_create(endpt->pool, &endpt->jb_slab);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
     /* Initialize exit callback list. */
     pj_list_init(&endpt->exit_cb_list);
 
@@ -189,6 +197,9 @@ on_error:
     if (endpt->ioqueue && endpt->own_ioqueue)
 	pj_ioqueue_destroy(endpt->ioqueue);
 
+    if (endpt->jb_slab)
+	pjmedia_jb_slab_destroy(endpt->jb_slab);
+
     pjmedia_codec_mgr_destroy(&endpt->codec_mgr);
     pjmedia_aud_subsys_shutdown();
     pj_pool_release(pool);
@@ -203,6 +214,14 @@ PJ_DEF(pjmedia_codec_mgr*) pjmedia_endpt_get_codec_mgr(pjmedia_endpt *endpt)
     return &endpt->codec_mgr;
 }
 
+/**
+ * Get the jitter buffer frame storage.
+ */
+PJ_DEF(pjmedia_jb_slab*) pjmedia_endpt_get_jb_slab(pjmedia_endpt *endpt)
+{
+    return endpt->jb_slab;
+}
+
 /**
  * Deinitialize media endpoint.
  */
@@ -230,6 +249,8 @@ PJ_DEF(pj_status_t) pjmedia_endpt_destroy (pjmedia_endpt *endpt)
 	ecb = ecb->next;
     }
 
+    pjmedia_jb_slab_destroy(endpt->jb_slab);
+
     pj_pool_release (endpt->pool);
 
     return PJ_SUCCESS;
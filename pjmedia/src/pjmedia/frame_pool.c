@@ -0,0 +1,173 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pjmedia/frame_pool.h>
+#include <pjmedia/errno.h>
+#include <pj/assert.h>
+#include <pj/lock.h>
+#include <pj/os.h>
+#include <pj/log.h>
+#include <pj/pool.h>
+
+#define THIS_FILE	"frame_pool.c"
+
+
+struct pjmedia_frame_pool
+{
+    pj_pool_t		*pool;		/**< Pool to allocate buffers.	    */
+    pj_lock_t		*lock;		/**< Protects the free list.	    */
+    pj_size_t		 buf_size;	/**< Capacity of each buffer.	    */
+    unsigned		 max_cnt;	/**< Maximum buffers, 0: no limit.  */
+    unsigned		 buf_cnt;	/**< Buffers allocated so far.	    */
+    pjmedia_frame_buf	*free_list;	/**< Buffers not in use.	    */
+    pjmedia_frame_buf	*alloc_list;	/**< All buffers.		    */
+};
+
+
+PJ_DEF(pj_status_t) pjmedia_frame_pool_create(pj_pool_t *pool,
+					      const char *name,
+					      pj_size_t buf_size,
+					      unsigned max_cnt,
+					      pjmedia_frame_pool **p_fpool)
+{
+    pjmedia_frame_pool *fpool;
+    pj_pool_t *own_pool;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pool && buf_size && p_fpool, PJ_EINVAL);
+
+    if (!name)
+	name = "fpool%p";
+
+    own_pool = pj_pool_create(pool->factory, name, buf_size * 4 + 256,
+			      buf_size * 4, NULL);
+    PJ_ASSERT_RETURN(own_pool, PJ_ENOMEM);
+
+    fpool = PJ_POOL_ZALLOC_T(own_pool, pjmedia_frame_pool);
+    fpool->pool = own_pool;
+    fpool->buf_size = buf_size;
+    fpool->max_cnt = max_cnt;
+
+    status = pj_lock_create_simple_mutex(own_pool, own_pool->obj_name,
+					 &fpool->lock);
+    if (status != PJ_SUCCESS) {
+	pj_pool_release(own_pool);
+	return status;
+    }
+
+    *p_fpool = fpool;
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_size_t) pjmedia_frame_pool_get_buf_size(pjmedia_frame_pool *fpool)
+{
+    return fpool->buf_size;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_frame_pool_alloc(pjmedia_frame_pool *fpool,
+					     pjmedia_frame_buf **p_fbuf)
+{
+    pjmedia_frame_buf *fbuf;
+
+    PJ_ASSERT_RETURN(fpool && p_fbuf, PJ_EINVAL);
+
+    pj_lock_acquire(fpool->lock);
+
+    fbuf = fpool->free_list;
+    if (fbuf) {
+	fpool->free_list = fbuf->next;
+	pj_atomic_set(fbuf->ref_cnt, 1);
+    } else if (fpool->max_cnt == 0 || fpool->buf_cnt < fpool->max_cnt) {
+	pj_status_t status;
+
+	fbuf = PJ_POOL_ZALLOC_T(fpool->pool, pjmedia_frame_buf);
+	status = pj_atomic_create(fpool->pool, 1, &fbuf->ref_cnt);
+	if (status != PJ_SUCCESS) {
+	    pj_lock_release(fpool->lock);
+	    return status;
+	}
+	fbuf->buf = pj_pool_alloc(fpool->pool, fpool->buf_size);
+	fbuf->size = fpool->buf_size;
+	fbuf->fpool = fpool;
+	fbuf->next_alloc = fpool->alloc_list;
+	fpool->alloc_list = fbuf;
+	++fpool->buf_cnt;
+    } else {
+	pj_lock_release(fpool->lock);
+	return PJ_ETOOMANY;
+    }
+
+    fbuf->next = NULL;
+
+    pj_lock_release(fpool->lock);
+
+    *p_fbuf = fbuf;
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_frame_pool_destroy(pjmedia_frame_pool *fpool)
+{
+    unsigned free_cnt = 0;
+    pjmedia_frame_buf *fbuf;
+
+    PJ_ASSERT_RETURN(fpool, PJ_EINVAL);
+
+    for (fbuf=fpool->free_list; fbuf; fbuf=fbuf->next)
+	++free_cnt;
+
+    if (free_cnt != fpool->buf_cnt) {
+	PJ_LOG(4,(THIS_FILE, "Frame pool %s destroyed with %d buffers in use",
+		  fpool->pool->obj_name, fpool->buf_cnt - free_cnt));
+    }
+
+    for (fbuf=fpool->alloc_list; fbuf; fbuf=fbuf->next_alloc)
+	pj_atomic_destroy(fbuf->ref_cnt);
+
+    pj_lock_destroy(fpool->lock);
+    pj_pool_release(fpool->pool);
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(void) pjmedia_frame_buf_add_ref(pjmedia_frame_buf *fbuf)
+{
+    pj_atomic_inc(fbuf->ref_cnt);
+}
+
+
+PJ_DEF(void) pjmedia_frame_buf_dec_ref(pjmedia_frame_buf *fbuf)
+{
+    pjmedia_frame_pool *fpool = fbuf->fpool;
+    pj_atomic_value_t ref_cnt;
+
+    ref_cnt = pj_atomic_dec_and_get(fbuf->ref_cnt);
+    pj_assert(ref_cnt >= 0);
+
+    /* Only the last holder touches the free list */
+    if (ref_cnt == 0) {
+	pj_lock_acquire(fpool->lock);
+	fbuf->next = fpool->free_list;
+	fpool->free_list = fbuf;
+	pj_lock_release(fpool->lock);
+    }
+}
@@ -24,6 +24,7 @@
 #include <pjmedia/errno.h>
 #include <pj/pool.h>
 #include <pj/assert.h>
+#include <pj/lock.h>
 #include <pj/log.h>
 #include <pj/math.h>
 #include <pj/string.h>
@@ -52,21 +53,134 @@
 #define STA_DISC_SAFE_SHRINKING_DIFF	1
 
 
-/* Struct of JB internal buffer, represented in a circular buffer containing
- * frame content, frame type, frame length, and frame bit info.
+/* Number of bins of the inter-arrival time histogram used in
+ * time-stretching mode, the last bin also counts longer times, in frames.
+ */
+#define IAT_HIST_SIZE		64
+
+/* Final forgetting factor of the inter-arrival time histogram, in Q15.
+ * It starts at zero so the first arrivals build the histogram quickly,
+ * and approaches this value (0.9993) as more packets arrive.
+ */
+#define IAT_FORGET_FACTOR	32745
+
+
+/* Number of frames of the maximum size which fit in the initial slab.
+ * The slab grows as needed, up to the maximum count of the jitter buffer,
+ * so the memory used follows the actual jitter rather than the worst case.
+ */
+#define JB_INIT_SLAB_FRAMES	4
+
+/* Slabs up to this size, such as the ones of audio streams, are allocated
+ * at their maximum size together with the frame slots, and each frame in
+ * the buffer has a fixed place in it, as records and growing would cost
+ * more than they save.
+ */
+#define JB_FIXED_SLAB_MAX	16384
+
+/* Slot without payload */
+#define JB_NO_PAYLOAD		((pj_uint32_t)-1)
+
+/* Payload records are aligned to this size */
+#define JB_REC_ALIGN(len)	(((len) + 7) & ~7)
+
+/* Flag in the record size of records whose frame has left the buffer */
+#define JB_REC_RELEASED		1
+
+/* Room for the pool header when creating the slab pool */
+#define JB_SLAB_POOL_OVERHEAD	256
+
+/* Chunks of a shared slab are allocated in blocks of about this size */
+#define JB_CHUNK_BLOCK_SIZE	4096
+
+
+/* Chunk sizes of a shared slab. Each size is about 1.5 times the previous
+ * one, so a frame leaves at most a third of its chunk unused.
+ */
+static const unsigned jb_chunk_size[] =
+{
+    32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072,
+    4096, 6144, 8192, 12288, PJMEDIA_JB_SLAB_MAX_FRAME
+};
+
+#define JB_CHUNK_CLASS_CNT	PJ_ARRAY_SIZE(jb_chunk_size)
+
+
+/* A free chunk of a shared slab. */
+typedef struct jb_chunk
+{
+    struct jb_chunk *next;		/**< next free chunk of the size    */
+} jb_chunk;
+
+
+/* Frame storage shared by jitter buffers. Chunks are never given back to
+ * the pool, they are kept in a free list of their size for the next
+ * frames.
+ */
+struct pjmedia_jb_slab
+{
+    pj_pool_t	    *pool;		/**< pool of the chunks		    */
+    pj_lock_t	    *lock;		/**< protects the free lists	    */
+    jb_chunk	    *free_list[JB_CHUNK_CLASS_CNT];
+					/**< free chunks, by size	    */
+    pj_size_t	     used;		/**< bytes of chunks in use	    */
+    pj_size_t	     capacity;		/**< bytes of chunks allocated	    */
+};
+
+
+/* A frame slot of the framelist. */
+typedef struct jb_slot
+{
+    pj_uint32_t	     ts;		/**< timestamp			    */
+    pj_uint32_t	     bit_info;		/**< frame bit info		    */
+    pj_uint32_t	     offset;		/**< payload record in the slab	    */
+    pj_uint32_t	     len;		/**< frame length		    */
+    int		     type;		/**< frame type			    */
+} jb_slot;
+
+
+/* Header of a payload record in the slab. */
+typedef struct jb_rec
+{
+    pj_uint32_t	     size;		/**< record size, including header  */
+    pj_uint32_t	     pos;		/**< slot of the frame		    */
+} jb_rec;
+
+
+/* Struct of JB internal buffer. The frame slots are kept in a circular
+ * buffer with a power of two size, and the frame contents are stored
+ * back to back in a slab, in arrival order, taking only their actual
+ * length. Records of frames which have left the buffer are reclaimed
+ * from the front of the slab, and the slab is compacted when its end
+ * is reached. Until it reaches its maximum size, the slab has its own
+ * pool, which is replaced when the slab grows, so the memory of the
+ * smaller slab is given back. A small slab is instead a ring of max_count
+ * frames of the maximum size, without records. When a shared slab is
+ * used, each frame content has its own chunk of the shared slab, and
+ * the offset of the slot is the size class of the chunk.
  */
 typedef struct jb_framelist_t
 {
     /* Settings */
     unsigned	     frame_size;	/**< maximum size of frame	    */
     unsigned	     max_count;		/**< maximum number of frames	    */
+    pj_pool_t	    *pool;		/**< pool of the framelist	    */
+    pj_pool_t	    *slab_pool;		/**< pool of the slab, if it may
+					     still grow			    */
+    pjmedia_jb_slab *shared;		/**< shared slab, if any	    */
 
     /* Buffers */
-    char	    *content;		/**< frame content array	    */
-    int		    *frame_type;	/**< frame type array		    */
-    pj_size_t	    *content_len;	/**< frame length array		    */
-    pj_uint32_t	    *bit_info;		/**< frame bit info array	    */
-    pj_uint32_t	    *ts;		/**< timestamp array		    */
+    jb_slot	    *slot;		/**< frame slots		    */
+    unsigned	     slot_mask;		/**< number of slots - 1	    */
+    char	    *slab;		/**< frame contents		    */
+    unsigned	     slab_size;		/**< current size of slab	    */
+    unsigned	     slab_max;		/**< maximum size of slab	    */
+    unsigned	     slab_head;		/**< oldest record in the slab	    */
+    unsigned	     slab_tail;		/**< end of the last record	    */
+    unsigned	     slab_live;		/**< bytes of records in use	    */
+    pj_bool_t	     slab_fixed;	/**< frames have a fixed place	    */
+    char	   **chunk;		/**< frame contents in the shared
+					     slab, by slot		    */
 
     /* States */
     unsigned	     head;		/**< index of head, pointed frame
@@ -76,6 +190,8 @@ typedef struct jb_framelist_t
     unsigned	     discarded_num;	/**< current number of discarded
 					     frames.			    */
     int		     origin;		/**< original index of flist_head   */
+    unsigned	     slab_ring_head;	/**< place of the head frame in a
+					     fixed slab			    */
 
 } jb_framelist_t;
 
@@ -135,6 +251,23 @@ struct pjmedia_jbuf
     unsigned	    jb_discard_dist;	/**< Distance from jb_discard_ref
 					     to perform discard (in frm)    */
 
+    /* Time-stretching mode */
+    pj_bool_t	    jb_stretch;		/**< Time-stretching mode enabled   */
+    discard_algo    jb_stretch_saved_algo;
+					/**< Discard algorithm to restore
+					     when the mode is disabled	    */
+    unsigned	    jb_tick;		/**< Playout clock, in frames	    */
+    pj_bool_t	    jb_arr_valid;	/**< Last arrival is known	    */
+    unsigned	    jb_arr_tick;	/**< Playout clock at last arrival  */
+    int		    jb_arr_seq;		/**< Seq # of last arrival	    */
+    pj_uint32_t	   *jb_iat_hist;	/**< Inter-arrival time probability
+					     in frames, in Q30, allocated
+					     when the mode is enabled	    */
+    unsigned	    jb_iat_forget;	/**< Histogram forgetting factor,
+					     in Q15			    */
+    int		    jb_filt_level;	/**< Filtered buffer level, in
+					     frames in Q8		    */
+
     /* Statistics */
     pj_math_stat    jb_delay;		/**< Delay statistics of jitter buffer
 					     (in ms)			    */
@@ -177,37 +310,212 @@ static pj_status_t jb_framelist_reset(jb_framelist_t *framelist);
 static unsigned jb_framelist_remove_head(jb_framelist_t *framelist,
 					 unsigned count);
 
+PJ_DEF(pj_status_t) pjmedia_jb_slab_create(pj_pool_t *pool,
+					   pjmedia_jb_slab **p_slab)
+{
+    pjmedia_jb_slab *slab;
+    pj_pool_t *own_pool;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pool && p_slab, PJ_EINVAL);
+
+    own_pool = pj_pool_create(pool->factory, "jbshared%p",
+			      JB_CHUNK_BLOCK_SIZE * 4, JB_CHUNK_BLOCK_SIZE * 4,
+			      NULL);
+    PJ_ASSERT_RETURN(own_pool, PJ_ENOMEM);
+
+    slab = PJ_POOL_ZALLOC_T(own_pool, pjmedia_jb_slab);
+    slab->pool = own_pool;
+
+    status = pj_lock_create_simple_mutex(own_pool, own_pool->obj_name,
+					 &slab->lock);
+    if (status != PJ_SUCCESS) {
+	pj_pool_release(own_pool);
+	return status;
+    }
+
+    *p_slab = slab;
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_jb_slab_get_info(pjmedia_jb_slab *slab,
+					     pjmedia_jb_slab_info *info)
+{
+    PJ_ASSERT_RETURN(slab && info, PJ_EINVAL);
+
+    pj_lock_acquire(slab->lock);
+    info->used = slab->used;
+    info->capacity = slab->capacity;
+    pj_lock_release(slab->lock);
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_jb_slab_destroy(pjmedia_jb_slab *slab)
+{
+    PJ_ASSERT_RETURN(slab, PJ_EINVAL);
+
+    if (slab->used) {
+	PJ_LOG(4,(THIS_FILE, "Jitter buffer slab %s destroyed with %u bytes "
+		  "in use", slab->pool->obj_name, (unsigned)slab->used));
+    }
+
+    pj_lock_destroy(slab->lock);
+    pj_pool_release(slab->pool);
+
+    return PJ_SUCCESS;
+}
+
+
+/* Get the size class of the chunk for a frame */
+static unsigned jb_chunk_class(unsigned len)
+{
+    unsigned cls = 0;
+
+    while (jb_chunk_size[cls] < len)
+	++cls;
+
+    return cls;
+}
+
+/* Get a chunk of the size class from the shared slab */
+static char* jb_chunk_alloc(pjmedia_jb_slab *slab, unsigned cls)
+{
+    unsigned size = jb_chunk_size[cls];
+    jb_chunk *chunk;
+
+    pj_lock_acquire(slab->lock);
+
+    chunk = slab->free_list[cls];
+    if (!chunk) {
+	/* Allocate a block of chunks of the size */
+	unsigned i, cnt = PJ_MAX(JB_CHUNK_BLOCK_SIZE / size, 1);
+	char *block = (char*) pj_pool_alloc(slab->pool, size * cnt);
+
+	if (!block) {
+	    pj_lock_release(slab->lock);
+	    return NULL;
+	}
+	for (i = cnt - 1; i > 0; --i) {
+	    chunk = (jb_chunk*)(block + i * size);
+	    chunk->next = slab->free_list[cls];
+	    slab->free_list[cls] = chunk;
+	}
+	slab->capacity += size * cnt;
+	chunk = (jb_chunk*)block;
+    } else {
+	slab->free_list[cls] = chunk->next;
+    }
+    slab->used += size;
+
+    pj_lock_release(slab->lock);
+
+    return (char*)chunk;
+}
+
+/* Give a chunk back to the shared slab */
+static void jb_chunk_free(pjmedia_jb_slab *slab, unsigned cls, char *buf)
+{
+    jb_chunk *chunk = (jb_chunk*)buf;
+
+    pj_lock_acquire(slab->lock);
+    chunk->next = slab->free_list[cls];
+    slab->free_list[cls] = chunk;
+    slab->used -= jb_chunk_size[cls];
+    pj_lock_release(slab->lock);
+}
+
+
+/* Allocate a slab of the specified size. A slab that may still grow
+ * gets its own pool, so it can be given back when it's replaced, while
+ * the slab of the maximum size is allocated from the framelist pool.
+ */
+static char* jb_slab_create(jb_framelist_t *framelist, unsigned slab_size,
+			    pj_pool_t **p_slab_pool)
+{
+    pj_pool_t *pool = framelist->pool;
+
+    *p_slab_pool = NULL;
+    if (slab_size < framelist->slab_max) {
+	pool = pj_pool_create(framelist->pool->factory, "jbslab%p",
+			      slab_size + JB_SLAB_POOL_OVERHEAD, slab_size,
+			      NULL);
+	if (!pool)
+	    return NULL;
+	*p_slab_pool = pool;
+    }
+
+    return (char*) pj_pool_alloc(pool, slab_size);
+}
+
 static pj_status_t jb_framelist_init( pj_pool_t *pool,
 				      jb_framelist_t *framelist,
 				      unsigned frame_size,
-				      unsigned max_count)
+				      unsigned max_count,
+				      pjmedia_jb_slab *shared)
 {
+    unsigned slot_cnt, slot_size, rec_size;
+
     PJ_ASSERT_RETURN(pool && framelist, PJ_EINVAL);
 
     pj_bzero(framelist, sizeof(jb_framelist_t));
 
     framelist->frame_size   = frame_size;
     framelist->max_count    = max_count;
-    framelist->content	    = (char*)
-			      pj_pool_alloc(pool,
-					    framelist->frame_size*
-					    framelist->max_count);
-    framelist->frame_type   = (int*)
-			      pj_pool_alloc(pool,
-					    sizeof(framelist->frame_type[0])*
-					    framelist->max_count);
-    framelist->content_len  = (pj_size_t*)
-			      pj_pool_alloc(pool,
-					    sizeof(framelist->content_len[0])*
-					    framelist->max_count);
-    framelist->bit_info	    = (pj_uint32_t*)
-			      pj_pool_alloc(pool,
-					    sizeof(framelist->bit_info[0])*
-					    framelist->max_count);
-    framelist->ts	    = (pj_uint32_t*)
-			      pj_pool_alloc(pool,
-					    sizeof(framelist->ts[0])*
-					    framelist->max_count);
+    framelist->pool	    = pool;
+
+    /* Round the slots up to a power of two, so the ring position is just
+     * masked.
+     */
+    slot_cnt = 1;
+    while (slot_cnt < max_count)
+	slot_cnt <<= 1;
+    framelist->slot_mask    = slot_cnt - 1;
+    slot_size		    = JB_REC_ALIGN(sizeof(jb_slot) * slot_cnt);
+
+    /* The slab can hold max_count frames of the maximum size. A small
+     * slab is allocated right away with the slots, a larger one starts
+     * with room for a few frames. With a shared slab, there are only the
+     * slots and their chunk pointers.
+     */
+    rec_size = JB_REC_ALIGN(frame_size) + sizeof(jb_rec);
+    framelist->slab_max	    = rec_size * max_count;
+
+    if (shared && frame_size <= PJMEDIA_JB_SLAB_MAX_FRAME) {
+	unsigned i;
+
+	framelist->shared   = shared;
+	framelist->slot	    = (jb_slot*)
+			      pj_pool_alloc(pool, slot_size +
+						  slot_cnt * sizeof(char*));
+	if (!framelist->slot)
+	    return PJ_ENOMEM;
+	framelist->chunk    = (char**)((char*)framelist->slot + slot_size);
+	for (i = 0; i < slot_cnt; ++i) {
+	    framelist->slot[i].offset = JB_NO_PAYLOAD;
+	    framelist->chunk[i] = NULL;
+	}
+	return jb_framelist_reset(framelist);
+
+    } else if (framelist->slab_max <= JB_FIXED_SLAB_MAX) {
+	framelist->slab_fixed = PJ_TRUE;
+	framelist->slab_max = frame_size * max_count;
+	framelist->slot	    = (jb_slot*)
+			      pj_pool_alloc(pool, slot_size +
+						  framelist->slab_max);
+	framelist->slab_size= framelist->slab_max;
+	framelist->slab	    = (char*)framelist->slot + slot_size;
+    } else {
+	framelist->slot	    = (jb_slot*) pj_pool_alloc(pool, slot_size);
+	framelist->slab_size= PJ_MIN(framelist->slab_max,
+				     rec_size * JB_INIT_SLAB_FRAMES);
+	framelist->slab	    = jb_slab_create(framelist, framelist->slab_size,
+					     &framelist->slab_pool);
+    }
+    if (!framelist->slot || !framelist->slab)
+	return PJ_ENOMEM;
 
     return jb_framelist_reset(framelist);
 
@@ -215,34 +523,179 @@ static pj_status_t jb_framelist_init( pj_pool_t *pool,
 
 static pj_status_t jb_framelist_destroy(jb_framelist_t *framelist)
 {
-    PJ_UNUSED_ARG(framelist);
+    /* Give the frames back to the shared slab */
+    if (framelist->shared) {
+	jb_framelist_reset(framelist);
+	framelist->shared = NULL;
+    }
+
+    if (framelist->slab_pool) {
+	pj_pool_release(framelist->slab_pool);
+	framelist->slab_pool = NULL;
+    }
+    framelist->slab = NULL;
     return PJ_SUCCESS;
 }
 
+/* Copy the records in use to the start of dst, which may be the slab
+ * itself, and update the slots.
+ */
+static void jb_slab_move(jb_framelist_t *framelist, char *dst)
+{
+    unsigned pos = framelist->slab_head;
+    unsigned out = 0;
+
+    while (pos < framelist->slab_tail) {
+	jb_rec *rec = (jb_rec*)(framelist->slab + pos);
+	unsigned rec_size = rec->size & ~JB_REC_RELEASED;
+
+	if ((rec->size & JB_REC_RELEASED) == 0) {
+	    framelist->slot[rec->pos].offset = out;
+	    pj_memmove(dst + out, rec, rec_size);
+	    out += rec_size;
+	}
+	pos += rec_size;
+    }
+
+    framelist->slab = dst;
+    framelist->slab_head = 0;
+    framelist->slab_tail = out;
+}
+
+/* Allocate a payload record for the frame in the slot */
+static pj_uint32_t jb_slab_alloc(jb_framelist_t *framelist,
+				 unsigned slot_pos, unsigned len)
+{
+    unsigned rec_size = JB_REC_ALIGN(len) + sizeof(jb_rec);
+    jb_rec *rec;
+    pj_uint32_t offset;
+
+    if (framelist->slab_size - framelist->slab_tail < rec_size) {
+	/* Grow the slab when it's more than half used, otherwise just
+	 * compact it, so compaction only happens after at least half of
+	 * the slab has been filled again.
+	 */
+	if (framelist->slab_size < framelist->slab_max &&
+	    (framelist->slab_live + rec_size) * 2 > framelist->slab_size)
+	{
+	    unsigned new_size = framelist->slab_size;
+	    pj_pool_t *new_pool;
+	    char *new_slab;
+
+	    while (new_size < (framelist->slab_live + rec_size) * 2)
+		new_size = new_size ? new_size * 2 : rec_size;
+	    new_size = PJ_MIN(new_size, framelist->slab_max);
+
+	    new_slab = jb_slab_create(framelist, new_size, &new_pool);
+	    if (!new_slab)
+		return JB_NO_PAYLOAD;
+	    jb_slab_move(framelist, new_slab);
+	    if (framelist->slab_pool)
+		pj_pool_release(framelist->slab_pool);
+	    framelist->slab_pool = new_pool;
+	    framelist->slab_size = new_size;
+	} else {
+	    jb_slab_move(framelist, framelist->slab);
+	}
+
+	if (framelist->slab_size - framelist->slab_tail < rec_size) {
+	    pj_assert(!"Jitter buffer slab is too small");
+	    return JB_NO_PAYLOAD;
+	}
+    }
+
+    offset = framelist->slab_tail;
+    rec = (jb_rec*)(framelist->slab + offset);
+    rec->size = rec_size;
+    rec->pos = slot_pos;
+    framelist->slab_tail += rec_size;
+    framelist->slab_live += rec_size;
+
+    return offset;
+}
+
+/* Release the payload record of a frame */
+static void jb_slab_release(jb_framelist_t *framelist, pj_uint32_t offset)
+{
+    jb_rec *rec = (jb_rec*)(framelist->slab + offset);
+
+    framelist->slab_live -= rec->size;
+    rec->size |= JB_REC_RELEASED;
+
+    /* Reclaim released records from the front of the slab */
+    while (framelist->slab_head < framelist->slab_tail) {
+	rec = (jb_rec*)(framelist->slab + framelist->slab_head);
+	if ((rec->size & JB_REC_RELEASED) == 0)
+	    break;
+	framelist->slab_head += rec->size & ~JB_REC_RELEASED;
+    }
+    if (framelist->slab_head == framelist->slab_tail)
+	framelist->slab_head = framelist->slab_tail = 0;
+}
+
+/* Get the frame content of a slot */
+PJ_INLINE(char*) jb_slot_payload(jb_framelist_t *framelist,
+				 const jb_slot *slot)
+{
+    if (framelist->shared)
+	return framelist->chunk[slot - framelist->slot];
+    if (framelist->slab_fixed)
+	return framelist->slab + slot->offset;
+    return framelist->slab + slot->offset + sizeof(jb_rec);
+}
+
+/* Empty a slot, releasing its payload */
+PJ_INLINE(void) jb_slot_clear(jb_framelist_t *framelist, jb_slot *slot)
+{
+    if (slot->offset != JB_NO_PAYLOAD) {
+	if (framelist->shared) {
+	    unsigned pos = (unsigned)(slot - framelist->slot);
+
+	    jb_chunk_free(framelist->shared, slot->offset,
+			  framelist->chunk[pos]);
+	    framelist->chunk[pos] = NULL;
+	} else if (!framelist->slab_fixed) {
+	    jb_slab_release(framelist, slot->offset);
+	}
+    }
+
+    slot->type = PJMEDIA_JB_MISSING_FRAME;
+    slot->offset = JB_NO_PAYLOAD;
+    slot->len = 0;
+    slot->bit_info = 0;
+    slot->ts = 0;
+}
+
 static pj_status_t jb_framelist_reset(jb_framelist_t *framelist)
 {
+    unsigned i;
+
     framelist->head = 0;
+    framelist->slab_ring_head = 0;
     framelist->origin = INVALID_OFFSET;
     framelist->size = 0;
     framelist->discarded_num = 0;
 
+    for (i = 0; i <= framelist->slot_mask; ++i) {
+	/* Give the frames back to the shared slab */
+	if (framelist->shared &&
+	    framelist->slot[i].offset != JB_NO_PAYLOAD)
+	{
+	    jb_chunk_free(framelist->shared, framelist->slot[i].offset,
+			  framelist->chunk[i]);
+	    framelist->chunk[i] = NULL;
+	}
 
-    //pj_bzero(framelist->content,
-    //	     framelist->frame_size *
-    //	     framelist->max_count);
-
-    pj_memset(framelist->frame_type,
-	      PJMEDIA_JB_MISSING_FRAME,
-	      sizeof(framelist->frame_type[0]) *
-	      framelist->max_count);
-
-    pj_bzero(framelist->content_len,
-	     sizeof(framelist->content_len[0]) *
-	     framelist->max_count);
+	framelist->slot[i].type = PJMEDIA_JB_MISSING_FRAME;
+	framelist->slot[i].offset = JB_NO_PAYLOAD;
+	framelist->slot[i].len = 0;
+	framelist->slot[i].bit_info = 0;
+	framelist->slot[i].ts = 0;
+    }
 
-    //pj_bzero(framelist->bit_info,
-    //	     sizeof(framelist->bit_info[0]) *
-    //	     framelist->max_count);
+    framelist->slab_head = 0;
+    framelist->slab_tail = 0;
+    framelist->slab_live = 0;
 
     return PJ_SUCCESS;
 }
@@ -276,7 +729,7 @@ static pj_bool_t jb_framelist_get(jb_framelist_t *framelist,
 	pj_bool_t prev_discarded = PJ_FALSE;
 
 	/* Skip discarded frames */
-	while (framelist->frame_type[framelist->head] ==
+	while (framelist->slot[framelist->head].type ==
 	       PJMEDIA_JB_DISCARDED_FRAME)
 	{
 	    jb_framelist_remove_head(framelist, 1);
@@ -285,6 +738,8 @@ static pj_bool_t jb_framelist_get(jb_framelist_t *framelist,
 
 	/* Return the head frame if any */
 	if (framelist->size) {
+	    jb_slot *slot = &framelist->slot[framelist->head];
+
 	    if (prev_discarded) {
 		/* Ticket #1188: when previous frame(s) was discarded, return
 		 * 'missing' frame to trigger PLC to get smoother signal.
@@ -295,32 +750,27 @@ static pj_bool_t jb_framelist_get(jb_framelist_t *framelist,
 		if (bit_info)
 		    *bit_info = 0;
 	    } else {
-		pj_memcpy(frame,
-			  framelist->content +
-			  framelist->head * framelist->frame_size,
-			  framelist->frame_size);
-		*p_type = (pjmedia_jb_frame_type)
-			  framelist->frame_type[framelist->head];
+		if (slot->offset != JB_NO_PAYLOAD) {
+		    pj_memcpy(frame, jb_slot_payload(framelist, slot),
+			      slot->len);
+		}
+		*p_type = (pjmedia_jb_frame_type) slot->type;
 		if (size)
-		    *size   = framelist->content_len[framelist->head];
+		    *size   = slot->len;
 		if (bit_info)
-		    *bit_info = framelist->bit_info[framelist->head];
+		    *bit_info = slot->bit_info;
 	    }
 	    if (ts)
-		*ts = framelist->ts[framelist->head];
+		*ts = slot->ts;
 	    if (seq)
 		*seq = framelist->origin;
 
-	    //pj_bzero(framelist->content +
-	    //	 framelist->head * framelist->frame_size,
-	    //	 framelist->frame_size);
-	    framelist->frame_type[framelist->head] = PJMEDIA_JB_MISSING_FRAME;
-	    framelist->content_len[framelist->head] = 0;
-	    framelist->bit_info[framelist->head] = 0;
-	    framelist->ts[framelist->head] = 0;
+	    jb_slot_clear(framelist, slot);
 
 	    framelist->origin++;
-	    framelist->head = (framelist->head + 1) % framelist->max_count;
+	    framelist->head = (framelist->head + 1) & framelist->slot_mask;
+	    if (++framelist->slab_ring_head == framelist->max_count)
+		framelist->slab_ring_head = 0;
 	    framelist->size--;
 
 	    return PJ_TRUE;
@@ -344,6 +794,7 @@ static pj_bool_t jb_framelist_peek(jb_framelist_t *framelist,
 				   int *seq)
 {
     unsigned pos, idx;
+    jb_slot *slot;
 
     if (offset >= jb_framelist_eff_size(framelist))
 	return PJ_FALSE;
@@ -353,27 +804,29 @@ static pj_bool_t jb_framelist_peek(jb_framelist_t *framelist,
 
     /* Find actual peek position, note there may be discarded frames */
     while (1) {
-	if (framelist->frame_type[pos] != PJMEDIA_JB_DISCARDED_FRAME) {
+	if (framelist->slot[pos].type != PJMEDIA_JB_DISCARDED_FRAME) {
 	    if (idx == 0)
 		break;
 	    else
 		--idx;
 	}
-	pos = (pos + 1) % framelist->max_count;
+	pos = (pos + 1) & framelist->slot_mask;
     }
+    slot = &framelist->slot[pos];
 
     /* Return the frame pointer */
-    if (frame)
-	*frame = framelist->content + pos*framelist->frame_size;
+    if (frame) {
+	*frame = (slot->offset == JB_NO_PAYLOAD) ? NULL :
+		 jb_slot_payload(framelist, slot);
+    }
     if (type)
-	*type = (pjmedia_jb_frame_type)
-		framelist->frame_type[pos];
+	*type = (pjmedia_jb_frame_type) slot->type;
     if (size)
-	*size = framelist->content_len[pos];
+	*size = slot->len;
     if (bit_info)
-	*bit_info = framelist->bit_info[pos];
+	*bit_info = slot->bit_info;
     if (ts)
-	*ts = framelist->ts[pos];
+	*ts = slot->ts;
     if (seq)
 	*seq = framelist->origin + offset;
 
@@ -385,61 +838,30 @@ static pj_bool_t jb_framelist_peek(jb_framelist_t *framelist,
 static unsigned jb_framelist_remove_head(jb_framelist_t *framelist,
 					 unsigned count)
 {
+    unsigned i;
+
     if (count > framelist->size)
 	count = framelist->size;
 
-    if (count) {
-	/* may be done in two steps if overlapping */
-	unsigned step1,step2;
-	unsigned tmp = framelist->head+count;
-	unsigned i;
+    for (i = 0; i < count; ++i) {
+	jb_slot *slot = &framelist->slot[(framelist->head + i) &
+					 framelist->slot_mask];
 
-	if (tmp > framelist->max_count) {
-	    step1 = framelist->max_count - framelist->head;
-	    step2 = count-step1;
-	} else {
-	    step1 = count;
-	    step2 = 0;
-	}
-
-	for (i = framelist->head; i < (framelist->head + step1); ++i) {
-	    if (framelist->frame_type[i] == PJMEDIA_JB_DISCARDED_FRAME) {
-		pj_assert(framelist->discarded_num > 0);
-		framelist->discarded_num--;
-	    }
+	if (slot->type == PJMEDIA_JB_DISCARDED_FRAME) {
+	    pj_assert(framelist->discarded_num > 0);
+	    framelist->discarded_num--;
 	}
-
-	//pj_bzero(framelist->content +
-	//	    framelist->head * framelist->frame_size,
-	//          step1*framelist->frame_size);
-	pj_memset(framelist->frame_type+framelist->head,
-		  PJMEDIA_JB_MISSING_FRAME,
-		  step1*sizeof(framelist->frame_type[0]));
-	pj_bzero(framelist->content_len+framelist->head,
-		 step1*sizeof(framelist->content_len[0]));
-
-	if (step2) {
-	    for (i = 0; i < step2; ++i) {
-		if (framelist->frame_type[i] == PJMEDIA_JB_DISCARDED_FRAME) {
-		    pj_assert(framelist->discarded_num > 0);
-		    framelist->discarded_num--;
-		}
-	    }
-	    //pj_bzero( framelist->content,
-	    //	      step2*framelist->frame_size);
-	    pj_memset(framelist->frame_type,
-		      PJMEDIA_JB_MISSING_FRAME,
-		      step2*sizeof(framelist->frame_type[0]));
-	    pj_bzero (framelist->content_len,
-		      step2*sizeof(framelist->content_len[0]));
-	}
-
-	/* update states */
-	framelist->origin += count;
-	framelist->head = (framelist->head + count) % framelist->max_count;
-	framelist->size -= count;
+	jb_slot_clear(framelist, slot);
     }
 
+    /* update states */
+    framelist->origin += count;
+    framelist->head = (framelist->head + count) & framelist->slot_mask;
+    framelist->slab_ring_head += count;
+    if (framelist->slab_ring_head >= framelist->max_count)
+	framelist->slab_ring_head -= framelist->max_count;
+    framelist->size -= count;
+
     return count;
 }
 
@@ -453,7 +875,7 @@ static pj_status_t jb_framelist_put_at(jb_framelist_t *framelist,
 				       unsigned frame_type)
 {
     int distance;
-    unsigned pos;
+    jb_slot *slot;
     enum { MAX_MISORDER = 100 };
     enum { MAX_DROPOUT = 3000 };
 
@@ -492,29 +914,51 @@ static pj_status_t jb_framelist_put_at(jb_framelist_t *framelist,
 	}
     }
 
-    /* get the slot position */
-    pos = (framelist->head + distance) % framelist->max_count;
+
+    /* get the slot */
+    slot = &framelist->slot[(framelist->head + distance) &
+			    framelist->slot_mask];
 
     /* if the slot is occupied, it must be duplicated frame, ignore it. */
-    if (framelist->frame_type[pos] != PJMEDIA_JB_MISSING_FRAME)
+    if (slot->type != PJMEDIA_JB_MISSING_FRAME)
 	return PJ_EEXISTS;
 
+    /* copy frame content */
+    if (PJMEDIA_JB_NORMAL_FRAME == frame_type && frame_size) {
+	if (framelist->shared) {
+	    unsigned pos = (unsigned)(slot - framelist->slot);
+	    unsigned cls = jb_chunk_class(frame_size);
+
+	    framelist->chunk[pos] = jb_chunk_alloc(framelist->shared, cls);
+	    if (!framelist->chunk[pos])
+		return PJ_ENOMEM;
+	    slot->offset = cls;
+	} else if (framelist->slab_fixed) {
+	    unsigned place = framelist->slab_ring_head + distance;
+
+	    if (place >= framelist->max_count)
+		place -= framelist->max_count;
+	    slot->offset = place * framelist->frame_size;
+	} else {
+	    slot->offset = jb_slab_alloc(framelist,
+					 (unsigned)(slot - framelist->slot),
+					 frame_size);
+	    if (slot->offset == JB_NO_PAYLOAD)
+		return PJ_ENOMEM;
+	}
+	pj_memcpy(jb_slot_payload(framelist, slot), frame, frame_size);
+    }
+
     /* put the frame into the slot */
-    framelist->frame_type[pos] = frame_type;
-    framelist->content_len[pos] = frame_size;
-    framelist->bit_info[pos] = bit_info;
-    framelist->ts[pos] = ts;
+    slot->type = frame_type;
+    slot->len = frame_size;
+    slot->bit_info = bit_info;
+    slot->ts = ts;
 
     /* update framelist size */
     if (framelist->origin + (int)framelist->size <= index)
 	framelist->size = distance + 1;
 
-    if(PJMEDIA_JB_NORMAL_FRAME == frame_type) {
-	/* copy frame content */
-	pj_memcpy(framelist->content + pos * framelist->frame_size,
-		  frame, frame_size);
-    }
-
     return PJ_SUCCESS;
 }
 
@@ -522,18 +966,17 @@ static pj_status_t jb_framelist_put_at(jb_framelist_t *framelist,
 static pj_status_t jb_framelist_discard(jb_framelist_t *framelist,
 				        int index)
 {
-    unsigned pos;
+    jb_slot *slot;
 
     PJ_ASSERT_RETURN(index >= framelist->origin &&
 		     index <  framelist->origin + (int)framelist->size,
 		     PJ_EINVAL);
 
-    /* Get the slot position */
-    pos = (framelist->head + (index - framelist->origin)) %
-	  framelist->max_count;
-
-    /* Discard the frame */
-    framelist->frame_type[pos] = PJMEDIA_JB_DISCARDED_FRAME;
+    /* Discard the frame, its content is not needed anymore */
+    slot = &framelist->slot[(framelist->head + (index - framelist->origin)) &
+			    framelist->slot_mask];
+    jb_slot_clear(framelist, slot);
+    slot->type = PJMEDIA_JB_DISCARDED_FRAME;
     framelist->discarded_num++;
 
     return PJ_SUCCESS;
@@ -554,13 +997,27 @@ PJ_DEF(pj_status_t) pjmedia_jbuf_create(pj_pool_t *pool,
 					unsigned ptime,
 					unsigned max_count,
 					pjmedia_jbuf **p_jb)
+{
+    return pjmedia_jbuf_create2(pool, name, frame_size, ptime, max_count,
+				NULL, p_jb);
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_jbuf_create2(pj_pool_t *pool,
+					 const pj_str_t *name,
+					 unsigned frame_size,
+					 unsigned ptime,
+					 unsigned max_count,
+					 pjmedia_jb_slab *slab,
+					 pjmedia_jbuf **p_jb)
 {
     pjmedia_jbuf *jb;
     pj_status_t status;
 
     jb = PJ_POOL_ZALLOC_T(pool, pjmedia_jbuf);
 
-    status = jb_framelist_init(pool, &jb->jb_framelist, frame_size, max_count);
+    status = jb_framelist_init(pool, &jb->jb_framelist, frame_size, max_count,
+			       slab);
     if (status != PJ_SUCCESS)
 	return status;
 
@@ -629,6 +1086,8 @@ PJ_DEF(pj_status_t) pjmedia_jbuf_set_adaptive( pjmedia_jbuf *jb,
 PJ_DEF(pj_status_t) pjmedia_jbuf_set_discard( pjmedia_jbuf *jb,
 					      pjmedia_jb_discard_algo algo)
 {
+    discard_algo algo_func;
+
     PJ_ASSERT_RETURN(jb, PJ_EINVAL);
     PJ_ASSERT_RETURN(algo >= PJMEDIA_JB_DISCARD_NONE &&
 		     algo <= PJMEDIA_JB_DISCARD_PROGRESSIVE,
@@ -636,16 +1095,55 @@ PJ_DEF(pj_status_t) pjmedia_jbuf_set_discard( pjmedia_jbuf *jb,
 
     switch(algo) {
     case PJMEDIA_JB_DISCARD_PROGRESSIVE:
-	jb->jb_discard_algo = &jbuf_discard_progressive;
+	algo_func = &jbuf_discard_progressive;
 	break;
     case PJMEDIA_JB_DISCARD_STATIC:
-	jb->jb_discard_algo = &jbuf_discard_static;
+	algo_func = &jbuf_discard_static;
 	break;
     default:
-	jb->jb_discard_algo = NULL;
+	algo_func = NULL;
 	break;
     }
 
+    /* Time-stretching mode doesn't discard, the algorithm is used when
+     * the mode is disabled.
+     */
+    if (jb->jb_stretch)
+	jb->jb_stretch_saved_algo = algo_func;
+    else
+	jb->jb_discard_algo = algo_func;
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_jbuf_set_stretch(pjmedia_jbuf *jb,
+					     pj_bool_t enabled)
+{
+    PJ_ASSERT_RETURN(jb, PJ_EINVAL);
+
+    if (enabled && !jb->jb_iat_hist) {
+	jb->jb_iat_hist = (pj_uint32_t*)
+			  pj_pool_alloc(jb->jb_framelist.pool,
+					IAT_HIST_SIZE * sizeof(pj_uint32_t));
+	if (!jb->jb_iat_hist)
+	    return PJ_ENOMEM;
+    }
+
+    if (enabled) {
+	pj_bzero(jb->jb_iat_hist, IAT_HIST_SIZE * sizeof(pj_uint32_t));
+	jb->jb_iat_forget = 0;
+	jb->jb_arr_valid = PJ_FALSE;
+	jb->jb_filt_level = jb->jb_prefetch << 8;
+	if (!jb->jb_stretch) {
+	    jb->jb_stretch_saved_algo = jb->jb_discard_algo;
+	    jb->jb_discard_algo = NULL;
+	}
+    } else if (jb->jb_stretch) {
+	jb->jb_discard_algo = jb->jb_stretch_saved_algo;
+    }
+    jb->jb_stretch = enabled;
+
     return PJ_SUCCESS;
 }
 
@@ -660,6 +1158,8 @@ PJ_DEF(pj_status_t) pjmedia_jbuf_reset(pjmedia_jbuf *jb)
     jb->jb_max_hist_level= 0;
     jb->jb_prefetching   = (jb->jb_prefetch != 0);
     jb->jb_discard_dist  = 0;
+    jb->jb_arr_valid	 = PJ_FALSE;
+    jb->jb_filt_level	 = jb->jb_prefetch << 8;
 
     jb_framelist_reset(&jb->jb_framelist);
 
@@ -721,7 +1221,7 @@ static void jbuf_calculate_jitter(pjmedia_jbuf *jb)
 	    jb->jb_eff_level -= diff;
 
 	    /* Update prefetch based on level */
-	    if (jb->jb_init_prefetch) {
+	    if (jb->jb_init_prefetch && !jb->jb_stretch) {
 		jb->jb_prefetch = jb->jb_eff_level;
 		if (jb->jb_prefetch < jb->jb_min_prefetch)
 		    jb->jb_prefetch = jb->jb_min_prefetch;
@@ -747,7 +1247,7 @@ static void jbuf_calculate_jitter(pjmedia_jbuf *jb)
 				  (int)(jb->jb_max_count*4/5));
 
 	/* Update prefetch based on level */
-	if (jb->jb_init_prefetch) {
+	if (jb->jb_init_prefetch && !jb->jb_stretch) {
 	    jb->jb_prefetch = jb->jb_eff_level;
 	    if (jb->jb_prefetch > jb->jb_max_prefetch)
 		jb->jb_prefetch = jb->jb_max_prefetch;
@@ -899,6 +1399,79 @@ static void jbuf_discard_progressive(pjmedia_jbuf *jb)
 }
 
 
+/* Update the inter-arrival time histogram with a frame that has just
+ * been put, and set the prefetch to cover most of the arrivals. The
+ * inter-arrival time is the number of frame intervals since the previous
+ * arrival, minus the frames which are expected in between, so a frame
+ * that arrives right on time counts as one.
+ */
+static void jbuf_update_iat(pjmedia_jbuf *jb, int frame_seq)
+{
+    enum { MAX_MISORDER = 100 };
+    pj_uint32_t limit, sum;
+    int iat, target;
+    unsigned i;
+
+    if (jb->jb_arr_valid && frame_seq <= jb->jb_arr_seq) {
+	/* Reordered frame, or sequence restart */
+	if (jb->jb_arr_seq - frame_seq >= MAX_MISORDER)
+	    jb->jb_arr_valid = PJ_FALSE;
+	else
+	    return;
+    }
+
+    if (!jb->jb_arr_valid) {
+	jb->jb_arr_valid = PJ_TRUE;
+	jb->jb_arr_tick = jb->jb_tick;
+	jb->jb_arr_seq = frame_seq;
+	return;
+    }
+
+    iat = (int)(jb->jb_tick - jb->jb_arr_tick) -
+	  (frame_seq - jb->jb_arr_seq - 1);
+    if (iat < 0)
+	iat = 0;
+    else if (iat >= IAT_HIST_SIZE)
+	iat = IAT_HIST_SIZE - 1;
+
+    jb->jb_arr_tick = jb->jb_tick;
+    jb->jb_arr_seq = frame_seq;
+
+    /* Age the histogram and add the new arrival */
+    for (i = 0; i < IAT_HIST_SIZE; ++i) {
+	jb->jb_iat_hist[i] = (pj_uint32_t)
+			     (((pj_uint64_t)jb->jb_iat_hist[i] *
+			       jb->jb_iat_forget) >> 15);
+    }
+    jb->jb_iat_hist[iat] += (32768 - jb->jb_iat_forget) << 15;
+    jb->jb_iat_forget += (IAT_FORGET_FACTOR - jb->jb_iat_forget + 3) >> 2;
+    if (jb->jb_iat_forget > IAT_FORGET_FACTOR)
+	jb->jb_iat_forget = IAT_FORGET_FACTOR;
+
+    /* The target delay covers the quantile of the inter-arrival times */
+    limit = (pj_uint32_t)(((pj_uint64_t)PJMEDIA_JBUF_STRETCH_QUANTILE << 30) /
+			  100);
+    sum = 0;
+    for (i = 0; i < IAT_HIST_SIZE - 1; ++i) {
+	sum += jb->jb_iat_hist[i];
+	if (sum >= limit)
+	    break;
+    }
+
+    target = PJ_MAX((int)i, 1);
+    if (target < jb->jb_min_prefetch)
+	target = jb->jb_min_prefetch;
+    if (target > jb->jb_max_prefetch)
+	target = jb->jb_max_prefetch;
+
+    if (target != jb->jb_prefetch) {
+	TRACE__((jb->jb_name.ptr, "JB target delay %d -> %d frames",
+		 jb->jb_prefetch, target));
+	jb->jb_prefetch = target;
+    }
+}
+
+
 PJ_INLINE(void) jbuf_update(pjmedia_jbuf *jb, int oper)
 {
     if(jb->jb_last_op != oper) {
@@ -1016,11 +1589,60 @@ PJ_DEF(void) pjmedia_jbuf_put_frame3(pjmedia_jbuf *jb,
 		jb->jb_prefetching = PJ_FALSE;
 	}
 	jb->jb_level += (new_size > cur_size ? new_size-cur_size : 1);
+	if (jb->jb_stretch)
+	    jbuf_update_iat(jb, frame_seq);
 	jbuf_update(jb, JB_OP_PUT);
     } else
 	jb->jb_discard++;
 }
 
+/*
+ * Get the playout operation for the current frame interval.
+ */
+PJ_DEF(pjmedia_jb_stretch_op) pjmedia_jbuf_get_stretch_op(pjmedia_jbuf *jb)
+{
+    int level, target, alpha, low, high;
+
+    ++jb->jb_tick;
+
+    if (!jb->jb_stretch || jb->jb_prefetching)
+	return PJMEDIA_JB_STRETCH_NONE;
+
+    /* Smooth the buffer level, more slowly for higher targets since the
+     * level is expected to fluctuate more.
+     */
+    level = jb_framelist_eff_size(&jb->jb_framelist);
+    target = jb->jb_prefetch;
+    if (target <= 1)
+	alpha = 251;
+    else if (target <= 3)
+	alpha = 252;
+    else if (target <= 7)
+	alpha = 253;
+    else
+	alpha = 254;
+    jb->jb_filt_level = (jb->jb_filt_level * alpha +
+			 (level << 8) * (256 - alpha)) >> 8;
+
+    /* Keep the filtered level between three quarters of the target and
+     * one frame above that. The filtered level is corrected right away
+     * for the frame added or removed, so the next decision doesn't wait
+     * for the filter to catch up.
+     */
+    low = (target << 8) * 3 / 4;
+    high = PJ_MAX(target << 8, low + 256);
+
+    if (jb->jb_filt_level >= high && level >= 2) {
+	jb->jb_filt_level -= 256;
+	return PJMEDIA_JB_STRETCH_SHRINK;
+    } else if (jb->jb_filt_level < low && level > 0) {
+	jb->jb_filt_level += 256;
+	return PJMEDIA_JB_STRETCH_EXPAND;
+    }
+
+    return PJMEDIA_JB_STRETCH_NONE;
+}
+
 /*
  * Get frame from jitter buffer.
  */
@@ -161,41 +161,48 @@ PJ_DEF(pj_bool_t) pjmedia_master_port_wait( pjmedia_master_port *m,
 }
 
 /*
- * Callback to be called for each clock ticks.
+ * Get a frame from a port and pass it to the other port. The frame is
+ * passed by reference when the source port supports it.
  */
-static void clock_callback(const pj_timestamp *ts, void *user_data)
+static void transfer_frame(pjmedia_master_port *m, pjmedia_port *src,
+			   pjmedia_port *dst, const pj_timestamp *ts)
 {
-    pjmedia_master_port *m = (pjmedia_master_port*) user_data;
     pjmedia_frame frame;
+    pjmedia_frame_buf *fbuf;
     pj_status_t status;
 
-    
-    /* Lock access to ports. */
-    pj_lock_acquire(m->lock);
-
-    /* Get frame from upstream port and pass it to downstream port */
     pj_bzero(&frame, sizeof(frame));
     frame.buf = m->buff;
     frame.size = m->buff_size;
     frame.timestamp.u64 = ts->u64;
 
-    status = pjmedia_port_get_frame(m->u_port, &frame);
+    status = pjmedia_port_get_frame_buf(src, &frame, &fbuf);
+    if (status == PJ_ENOTSUP)
+	status = pjmedia_port_get_frame(src, &frame);
     if (status != PJ_SUCCESS)
 	frame.type = PJMEDIA_FRAME_TYPE_NONE;
 
-    status = pjmedia_port_put_frame(m->d_port, &frame);
+    pjmedia_port_put_frame_buf(dst, &frame, fbuf);
 
-    /* Get frame from downstream port and pass it to upstream port */
-    pj_bzero(&frame, sizeof(frame));
-    frame.buf = m->buff;
-    frame.size = m->buff_size;
-    frame.timestamp.u64 = ts->u64;
+    if (fbuf)
+	pjmedia_frame_buf_dec_ref(fbuf);
+}
 
-    status = pjmedia_port_get_frame(m->d_port, &frame);
-    if (status != PJ_SUCCESS)
-	frame.type = PJMEDIA_FRAME_TYPE_NONE;
+/*
+ * Callback to be called for each clock ticks.
+ */
+static void clock_callback(const pj_timestamp *ts, void *user_data)
+{
+    pjmedia_master_port *m = (pjmedia_master_port*) user_data;
+
+    /* Lock access to ports. */
+    pj_lock_acquire(m->lock);
 
-    status = pjmedia_port_put_frame(m->u_port, &frame);
+    /* Get frame from upstream port and pass it to downstream port */
+    transfer_frame(m, m->u_port, m->d_port, ts);
+
+    /* Get frame from downstream port and pass it to upstream port */
+    transfer_frame(m, m->d_port, m->u_port, ts);
 
     /* Release lock */
     pj_lock_release(m->lock);
@@ -0,0 +1,946 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pjmedia/mixer.h>
+#include <pjmedia/errno.h>
+#include <pj/assert.h>
+#include <pj/log.h>
+
+#define THIS_FILE	"mixer.c"
+
+#define MAX_LEVEL	(32767)
+#define MIN_LEVEL	(-32768)
+
+/*
+ * Determine which SIMD instruction sets can be compiled in.
+ */
+#if PJMEDIA_HAS_SIMD && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#   define HAS_SSE2	1
+#   define HAS_AVX2	1
+#   define TARGET_SSE2	__attribute__((target("sse2")))
+#   define TARGET_AVX2	__attribute__((target("avx2")))
+#   include <immintrin.h>
+#elif PJMEDIA_HAS_SIMD && defined(_MSC_VER) && \
+      (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#   define HAS_SSE2	1
+#   define HAS_AVX2	1
+#   define TARGET_SSE2
+#   define TARGET_AVX2
+#   include <intrin.h>
+#   include <immintrin.h>
+#else
+#   define HAS_SSE2	0
+#   define HAS_AVX2	0
+#endif
+
+#if PJMEDIA_HAS_SIMD && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#   define HAS_NEON	1
+#   include <arm_neon.h>
+#else
+#   define HAS_NEON	0
+#endif
+
+
+/* Mixing primitives of an implementation. */
+struct mix_ops
+{
+    pjmedia_mix_impl impl;
+    void	(*copy)(pj_int32_t*, const pj_int16_t*, unsigned);
+    void	(*add)(pj_int32_t*, const pj_int16_t*, unsigned,
+		       pj_int32_t*, pj_int32_t*);
+    void	(*sub)(pj_int32_t*, const pj_int32_t*, const pj_int16_t*,
+		       unsigned, pj_int32_t*, pj_int32_t*);
+    pj_uint32_t	(*adjust)(pj_int16_t*, const pj_int32_t*, unsigned,
+			  unsigned);
+    pj_uint32_t	(*adjust_samples)(pj_int16_t*, unsigned, unsigned);
+    pj_uint32_t	(*level)(const pj_int16_t*, unsigned);
+};
+
+
+/*****************************************************************************
+ * Portable C implementation, also used for the remaining samples of
+ * the SIMD implementations.
+ */
+static void copy_c(pj_int32_t *dst, const pj_int16_t *src, unsigned count)
+{
+    unsigned i;
+
+    for (i=0; i<count; ++i)
+	dst[i] = src[i];
+}
+
+static void add_c(pj_int32_t *dst, const pj_int16_t *src, unsigned count,
+		  pj_int32_t *p_min, pj_int32_t *p_max)
+{
+    pj_int32_t vmin = *p_min, vmax = *p_max;
+    unsigned i;
+
+    for (i=0; i<count; ++i) {
+	pj_int32_t v = dst[i] + src[i];
+
+	dst[i] = v;
+	if (v < vmin) vmin = v;
+	if (v > vmax) vmax = v;
+    }
+
+    *p_min = vmin;
+    *p_max = vmax;
+}
+
+static void sub_c(pj_int32_t *dst, const pj_int32_t *sum,
+		  const pj_int16_t *src, unsigned count,
+		  pj_int32_t *p_min, pj_int32_t *p_max)
+{
+    pj_int32_t vmin = *p_min, vmax = *p_max;
+    unsigned i;
+
+    for (i=0; i<count; ++i) {
+	pj_int32_t v = sum[i] - src[i];
+
+	dst[i] = v;
+	if (v < vmin) vmin = v;
+	if (v > vmax) vmax = v;
+    }
+
+    *p_min = vmin;
+    *p_max = vmax;
+}
+
+static pj_uint32_t adjust_c(pj_int16_t *dst, const pj_int32_t *src,
+			    unsigned count, unsigned gain)
+{
+    pj_uint32_t level = 0;
+    unsigned i;
+
+    for (i=0; i<count; ++i) {
+	pj_int32_t itemp = src[i];
+
+	/* Adjust the level */
+	if (gain != 128)
+	    itemp = (itemp * (pj_int32_t)gain) >> 7;
+
+	/* Clip the signal if it's too loud */
+	if (itemp > MAX_LEVEL) itemp = MAX_LEVEL;
+	else if (itemp < MIN_LEVEL) itemp = MIN_LEVEL;
+
+	dst[i] = (pj_int16_t)itemp;
+	level += (itemp >= 0 ? itemp : -itemp);
+    }
+
+    return level;
+}
+
+static pj_uint32_t adjust_samples_c(pj_int16_t *buf, unsigned count,
+				    unsigned gain)
+{
+    pj_uint32_t level = 0;
+    unsigned i;
+
+    for (i=0; i<count; ++i) {
+	pj_int32_t itemp = (buf[i] * (pj_int32_t)gain) >> 7;
+
+	if (itemp > MAX_LEVEL) itemp = MAX_LEVEL;
+	else if (itemp < MIN_LEVEL) itemp = MIN_LEVEL;
+
+	buf[i] = (pj_int16_t)itemp;
+	level += (itemp >= 0 ? itemp : -itemp);
+    }
+
+    return level;
+}
+
+static pj_uint32_t level_c(const pj_int16_t *buf, unsigned count)
+{
+    pj_uint32_t level = 0;
+    unsigned i;
+
+    for (i=0; i<count; ++i)
+	level += (buf[i] >= 0 ? buf[i] : -buf[i]);
+
+    return level;
+}
+
+static const struct mix_ops ops_c =
+{
+    PJMEDIA_MIX_IMPL_SCALAR,
+    &copy_c,
+    &add_c,
+    &sub_c,
+    &adjust_c,
+    &adjust_samples_c,
+    &level_c
+};
+
+
+#if HAS_SSE2
+/*****************************************************************************
+ * SSE2 implementation, processing 8 samples at a time.
+ */
+
+/* Sign extend the low and high four 16bit values to 32bit. */
+#define SSE2_WIDEN_LO(x)    _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16)
+#define SSE2_WIDEN_HI(x)    _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16)
+
+/* SSE2 has no 32bit min/max */
+#define SSE2_MIN32(a, b)    sse2_select(_mm_cmplt_epi32(a, b), a, b)
+#define SSE2_MAX32(a, b)    sse2_select(_mm_cmpgt_epi32(a, b), a, b)
+
+TARGET_SSE2
+static __m128i sse2_select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+/* Low 32bit of the products, as SSE2 has no _mm_mullo_epi32(). */
+TARGET_SSE2
+static __m128i sse2_mullo32(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,2,0)),
+			      _mm_shuffle_epi32(odd, _MM_SHUFFLE(0,0,2,0)));
+}
+
+/* Add the absolute values of eight 16bit samples to four 32bit sums.
+ * Multiplying by -1 or +1 with pmaddwd gives |-32768| right.
+ */
+TARGET_SSE2
+static __m128i sse2_abs_sum(__m128i sum, __m128i x)
+{
+    __m128i sign = _mm_or_si128(_mm_srai_epi16(x, 15), _mm_set1_epi16(1));
+    return _mm_add_epi32(sum, _mm_madd_epi16(x, sign));
+}
+
+TARGET_SSE2
+static pj_uint32_t sse2_hsum(__m128i sum)
+{
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1,0,3,2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2,3,0,1)));
+    return (pj_uint32_t)_mm_cvtsi128_si32(sum);
+}
+
+TARGET_SSE2
+static void copy_sse2(pj_int32_t *dst, const pj_int16_t *src, unsigned count)
+{
+    unsigned i;
+
+    for (i=0; i+8 <= count; i+=8) {
+	__m128i x = _mm_loadu_si128((const __m128i*)(src+i));
+
+	_mm_storeu_si128((__m128i*)(dst+i), SSE2_WIDEN_LO(x));
+	_mm_storeu_si128((__m128i*)(dst+i+4), SSE2_WIDEN_HI(x));
+    }
+    copy_c(dst+i, src+i, count-i);
+}
+
+TARGET_SSE2
+static void add_sse2(pj_int32_t *dst, const pj_int16_t *src, unsigned count,
+		     pj_int32_t *p_min, pj_int32_t *p_max)
+{
+    __m128i vmin = _mm_set1_epi32(*p_min);
+    __m128i vmax = _mm_set1_epi32(*p_max);
+    pj_int32_t m[4];
+    unsigned i, j;
+
+    for (i=0; i+8 <= count; i+=8) {
+	__m128i x = _mm_loadu_si128((const __m128i*)(src+i));
+	__m128i lo = _mm_loadu_si128((const __m128i*)(dst+i));
+	__m128i hi = _mm_loadu_si128((const __m128i*)(dst+i+4));
+
+	lo = _mm_add_epi32(lo, SSE2_WIDEN_LO(x));
+	hi = _mm_add_epi32(hi, SSE2_WIDEN_HI(x));
+	_mm_storeu_si128((__m128i*)(dst+i), lo);
+	_mm_storeu_si128((__m128i*)(dst+i+4), hi);
+
+	vmin = SSE2_MIN32(vmin, SSE2_MIN32(lo, hi));
+	vmax = SSE2_MAX32(vmax, SSE2_MAX32(lo, hi));
+    }
+
+    _mm_storeu_si128((__m128i*)m, vmin);
+    for (j=0; j<4; ++j)
+	if (m[j] < *p_min) *p_min = m[j];
+    _mm_storeu_si128((__m128i*)m, vmax);
+    for (j=0; j<4; ++j)
+	if (m[j] > *p_max) *p_max = m[j];
+
+    add_c(dst+i, src+i, count-i, p_min, p_max);
+}
+
+TARGET_SSE2
+static void sub_sse2(pj_int32_t *dst, const pj_int32_t *sum,
+		     const pj_int16_t *src, unsigned count,
+		     pj_int32_t *p_min, pj_int32_t *p_max)
+{
+    __m128i vmin = _mm_set1_epi32(*p_min);
+    __m128i vmax = _mm_set1_epi32(*p_max);
+    pj_int32_t m[4];
+    unsigned i, j;
+
+    for (i=0; i+8 <= count; i+=8) {
+	__m128i x = _mm_loadu_si128((const __m128i*)(src+i));
+	__m128i lo = _mm_loadu_si128((const __m128i*)(sum+i));
+	__m128i hi = _mm_loadu_si128((const __m128i*)(sum+i+4));
+
+	lo = _mm_sub_epi32(lo, SSE2_WIDEN_LO(x));
+	hi = _mm_sub_epi32(hi, SSE2_WIDEN_HI(x));
+	_mm_storeu_si128((__m128i*)(dst+i), lo);
+	_mm_storeu_si128((__m128i*)(dst+i+4), hi);
+
+	vmin = SSE2_MIN32(vmin, SSE2_MIN32(lo, hi));
+	vmax = SSE2_MAX32(vmax, SSE2_MAX32(lo, hi));
+    }
+
+    _mm_storeu_si128((__m128i*)m, vmin);
+    for (j=0; j<4; ++j)
+	if (m[j] < *p_min) *p_min = m[j];
+    _mm_storeu_si128((__m128i*)m, vmax);
+    for (j=0; j<4; ++j)
+	if (m[j] > *p_max) *p_max = m[j];
+
+    sub_c(dst+i, sum+i, src+i, count-i, p_min, p_max);
+}
+
+TARGET_SSE2
+static pj_uint32_t adjust_sse2(pj_int16_t *dst, const pj_int32_t *src,
+			       unsigned count, unsigned gain)
+{
+    __m128i vgain = _mm_set1_epi32(gain);
+    __m128i sum = _mm_setzero_si128();
+    unsigned i;
+
+    /* Both source vectors are loaded before the store, so converting
+     * in place is safe.
+     */
+    for (i=0; i+8 <= count; i+=8) {
+	__m128i lo = _mm_loadu_si128((const __m128i*)(src+i));
+	__m128i hi = _mm_loadu_si128((const __m128i*)(src+i+4));
+	__m128i x;
+
+	if (gain != 128) {
+	    lo = _mm_srai_epi32(sse2_mullo32(lo, vgain), 7);
+	    hi = _mm_srai_epi32(sse2_mullo32(hi, vgain), 7);
+	}
+	x = _mm_packs_epi32(lo, hi);
+	_mm_storeu_si128((__m128i*)(dst+i), x);
+	sum = sse2_abs_sum(sum, x);
+    }
+
+    return sse2_hsum(sum) + adjust_c(dst+i, src+i, count-i, gain);
+}
+
+TARGET_SSE2
+static pj_uint32_t adjust_samples_sse2(pj_int16_t *buf, unsigned count,
+				       unsigned gain)
+{
+    __m128i vgain, sum = _mm_setzero_si128();
+    unsigned i;
+
+    /* The 16x16 bit multiplication needs the gain to fit in 16bit */
+    if (gain > 32767)
+	return adjust_samples_c(buf, count, gain);
+
+    vgain = _mm_set1_epi16((short)gain);
+    for (i=0; i+8 <= count; i+=8) {
+	__m128i x = _mm_loadu_si128((const __m128i*)(buf+i));
+	__m128i plo = _mm_mullo_epi16(x, vgain);
+	__m128i phi = _mm_mulhi_epi16(x, vgain);
+	__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(plo, phi), 7);
+	__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(plo, phi), 7);
+
+	x = _mm_packs_epi32(lo, hi);
+	_mm_storeu_si128((__m128i*)(buf+i), x);
+	sum = sse2_abs_sum(sum, x);
+    }
+
+    return sse2_hsum(sum) + adjust_samples_c(buf+i, count-i, gain);
+}
+
+TARGET_SSE2
+static pj_uint32_t level_sse2(const pj_int16_t *buf, unsigned count)
+{
+    __m128i sum = _mm_setzero_si128();
+    unsigned i;
+
+    for (i=0; i+8 <= count; i+=8)
+	sum = sse2_abs_sum(sum, _mm_loadu_si128((const __m128i*)(buf+i)));
+
+    return sse2_hsum(sum) + level_c(buf+i, count-i);
+}
+
+static const struct mix_ops ops_sse2 =
+{
+    PJMEDIA_MIX_IMPL_SSE2,
+    &copy_sse2,
+    &add_sse2,
+    &sub_sse2,
+    &adjust_sse2,
+    &adjust_samples_sse2,
+    &level_sse2
+};
+
+#endif	/* HAS_SSE2 */
+
+
+#if HAS_AVX2
+/*****************************************************************************
+ * AVX2 implementation, processing 16 samples at a time.
+ */
+
+TARGET_AVX2
+static __m256i avx2_abs_sum(__m256i sum, __m256i x)
+{
+    __m256i sign = _mm256_or_si256(_mm256_srai_epi16(x, 15),
+				   _mm256_set1_epi16(1));
+    return _mm256_add_epi32(sum, _mm256_madd_epi16(x, sign));
+}
+
+TARGET_AVX2
+static pj_uint32_t avx2_hsum(__m256i sum)
+{
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum),
+			      _mm256_extracti128_si256(sum, 1));
+
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1,0,3,2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2,3,0,1)));
+    return (pj_uint32_t)_mm_cvtsi128_si32(s);
+}
+
+/* Saturate two vectors of 32bit values to one vector of 16bit values in
+ * the original order (_mm256_packs_epi32() interleaves the lanes).
+ */
+TARGET_AVX2
+static __m256i avx2_pack32(__m256i lo, __m256i hi)
+{
+    return _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi),
+				    _MM_SHUFFLE(3,1,2,0));
+}
+
+/* Reduce vectors of minimum and maximum values. */
+TARGET_AVX2
+static void avx2_minmax(__m256i vmin, __m256i vmax,
+			pj_int32_t *p_min, pj_int32_t *p_max)
+{
+    __m128i m;
+
+    m = _mm_min_epi32(_mm256_castsi256_si128(vmin),
+		      _mm256_extracti128_si256(vmin, 1));
+    m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1,0,3,2)));
+    m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2,3,0,1)));
+    *p_min = _mm_cvtsi128_si32(m);
+
+    m = _mm_max_epi32(_mm256_castsi256_si128(vmax),
+		      _mm256_extracti128_si256(vmax, 1));
+    m = _mm_max_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1,0,3,2)));
+    m = _mm_max_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2,3,0,1)));
+    *p_max = _mm_cvtsi128_si32(m);
+}
+
+TARGET_AVX2
+static void copy_avx2(pj_int32_t *dst, const pj_int16_t *src, unsigned count)
+{
+    unsigned i;
+
+    for (i=0; i+16 <= count; i+=16) {
+	__m128i lo = _mm_loadu_si128((const __m128i*)(src+i));
+	__m128i hi = _mm_loadu_si128((const __m128i*)(src+i+8));
+
+	_mm256_storeu_si256((__m256i*)(dst+i), _mm256_cvtepi16_epi32(lo));
+	_mm256_storeu_si256((__m256i*)(dst+i+8), _mm256_cvtepi16_epi32(hi));
+    }
+    copy_c(dst+i, src+i, count-i);
+}
+
+TARGET_AVX2
+static void add_avx2(pj_int32_t *dst, const pj_int16_t *src, unsigned count,
+		     pj_int32_t *p_min, pj_int32_t *p_max)
+{
+    __m256i vmin = _mm256_set1_epi32(*p_min);
+    __m256i vmax = _mm256_set1_epi32(*p_max);
+    unsigned i;
+
+    for (i=0; i+16 <= count; i+=16) {
+	__m256i lo = _mm256_loadu_si256((const __m256i*)(dst+i));
+	__m256i hi = _mm256_loadu_si256((const __m256i*)(dst+i+8));
+
+	lo = _mm256_add_epi32(lo, _mm256_cvtepi16_epi32(
+			_mm_loadu_si128((const __m128i*)(src+i))));
+	hi = _mm256_add_epi32(hi, _mm256_cvtepi16_epi32(
+			_mm_loadu_si128((const __m128i*)(src+i+8))));
+	_mm256_storeu_si256((__m256i*)(dst+i), lo);
+	_mm256_storeu_si256((__m256i*)(dst+i+8), hi);
+
+	vmin = _mm256_min_epi32(vmin, _mm256_min_epi32(lo, hi));
+	vmax = _mm256_max_epi32(vmax, _mm256_max_epi32(lo, hi));
+    }
+
+    avx2_minmax(vmin, vmax, p_min, p_max);
+
+    add_c(dst+i, src+i, count-i, p_min, p_max);
+}
+
+TARGET_AVX2
+static void sub_avx2(pj_int32_t *dst, const pj_int32_t *sum,
+		     const pj_int16_t *src, unsigned count,
+		     pj_int32_t *p_min, pj_int32_t *p_max)
+{
+    __m256i vmin = _mm256_set1_epi32(*p_min);
+    __m256i vmax = _mm256_set1_epi32(*p_max);
+    unsigned i;
+
+    for (i=0; i+16 <= count; i+=16) {
+	__m256i lo = _mm256_loadu_si256((const __m256i*)(sum+i));
+	__m256i hi = _mm256_loadu_si256((const __m256i*)(sum+i+8));
+
+	lo = _mm256_sub_epi32(lo, _mm256_cvtepi16_epi32(
+			_mm_loadu_si128((const __m128i*)(src+i))));
+	hi = _mm256_sub_epi32(hi, _mm256_cvtepi16_epi32(
+			_mm_loadu_si128((const __m128i*)(src+i+8))));
+	_mm256_storeu_si256((__m256i*)(dst+i), lo);
+	_mm256_storeu_si256((__m256i*)(dst+i+8), hi);
+
+	vmin = _mm256_min_epi32(vmin, _mm256_min_epi32(lo, hi));
+	vmax = _mm256_max_epi32(vmax, _mm256_max_epi32(lo, hi));
+    }
+
+    avx2_minmax(vmin, vmax, p_min, p_max);
+
+    sub_c(dst+i, sum+i, src+i, count-i, p_min, p_max);
+}
+
+TARGET_AVX2
+static pj_uint32_t adjust_avx2(pj_int16_t *dst, const pj_int32_t *src,
+			       unsigned count, unsigned gain)
+{
+    __m256i vgain = _mm256_set1_epi32(gain);
+    __m256i sum = _mm256_setzero_si256();
+    unsigned i;
+
+    for (i=0; i+16 <= count; i+=16) {
+	__m256i lo = _mm256_loadu_si256((const __m256i*)(src+i));
+	__m256i hi = _mm256_loadu_si256((const __m256i*)(src+i+8));
+	__m256i x;
+
+	if (gain != 128) {
+	    lo = _mm256_srai_epi32(_mm256_mullo_epi32(lo, vgain), 7);
+	    hi = _mm256_srai_epi32(_mm256_mullo_epi32(hi, vgain), 7);
+	}
+	x = avx2_pack32(lo, hi);
+	_mm256_storeu_si256((__m256i*)(dst+i), x);
+	sum = avx2_abs_sum(sum, x);
+    }
+
+    return avx2_hsum(sum) + adjust_c(dst+i, src+i, count-i, gain);
+}
+
+TARGET_AVX2
+static pj_uint32_t adjust_samples_avx2(pj_int16_t *buf, unsigned count,
+				       unsigned gain)
+{
+    __m256i vgain, sum = _mm256_setzero_si256();
+    unsigned i;
+
+    if (gain > 32767)
+	return adjust_samples_c(buf, count, gain);
+
+    vgain = _mm256_set1_epi16((short)gain);
+    for (i=0; i+16 <= count; i+=16) {
+	__m256i x = _mm256_loadu_si256((const __m256i*)(buf+i));
+	__m256i plo = _mm256_mullo_epi16(x, vgain);
+	__m256i phi = _mm256_mulhi_epi16(x, vgain);
+	__m256i lo = _mm256_srai_epi32(_mm256_unpacklo_epi16(plo, phi), 7);
+	__m256i hi = _mm256_srai_epi32(_mm256_unpackhi_epi16(plo, phi), 7);
+
+	/* Unpack and pack both work within 128bit lanes, so packing
+	 * without the permutation restores the original order.
+	 */
+	x = _mm256_packs_epi32(lo, hi);
+	_mm256_storeu_si256((__m256i*)(buf+i), x);
+	sum = avx2_abs_sum(sum, x);
+    }
+
+    return avx2_hsum(sum) + adjust_samples_c(buf+i, count-i, gain);
+}
+
+TARGET_AVX2
+static pj_uint32_t level_avx2(const pj_int16_t *buf, unsigned count)
+{
+    __m256i sum = _mm256_setzero_si256();
+    unsigned i;
+
+    for (i=0; i+16 <= count; i+=16)
+	sum = avx2_abs_sum(sum, _mm256_loadu_si256((const __m256i*)(buf+i)));
+
+    return avx2_hsum(sum) + level_c(buf+i, count-i);
+}
+
+static const struct mix_ops ops_avx2 =
+{
+    PJMEDIA_MIX_IMPL_AVX2,
+    &copy_avx2,
+    &add_avx2,
+    &sub_avx2,
+    &adjust_avx2,
+    &adjust_samples_avx2,
+    &level_avx2
+};
+
+#endif	/* HAS_AVX2 */
+
+
+#if HAS_NEON
+/*****************************************************************************
+ * NEON implementation, processing 8 samples at a time.
+ */
+
+static pj_uint32_t neon_hsum(int32x4_t sum)
+{
+    int32x2_t s = vadd_s32(vget_low_s32(sum), vget_high_s32(sum));
+    return (pj_uint32_t)vget_lane_s32(vpadd_s32(s, s), 0);
+}
+
+/* Add the absolute values of eight 16bit samples to four 32bit sums.
+ * The absolute difference to zero is widened, so |-32768| is right.
+ */
+static int32x4_t neon_abs_sum(int32x4_t sum, int16x8_t x)
+{
+    int16x4_t zero = vdup_n_s16(0);
+
+    sum = vabal_s16(sum, vget_low_s16(x), zero);
+    return vabal_s16(sum, vget_high_s16(x), zero);
+}
+
+static void copy_neon(pj_int32_t *dst, const pj_int16_t *src, unsigned count)
+{
+    unsigned i;
+
+    for (i=0; i+8 <= count; i+=8) {
+	int16x8_t x = vld1q_s16(src+i);
+
+	vst1q_s32(dst+i, vmovl_s16(vget_low_s16(x)));
+	vst1q_s32(dst+i+4, vmovl_s16(vget_high_s16(x)));
+    }
+    copy_c(dst+i, src+i, count-i);
+}
+
+static void add_neon(pj_int32_t *dst, const pj_int16_t *src, unsigned count,
+		     pj_int32_t *p_min, pj_int32_t *p_max)
+{
+    int32x4_t vmin = vdupq_n_s32(*p_min);
+    int32x4_t vmax = vdupq_n_s32(*p_max);
+    int32x2_t m;
+    unsigned i;
+
+    for (i=0; i+8 <= count; i+=8) {
+	int16x8_t x = vld1q_s16(src+i);
+	int32x4_t lo = vaddw_s16(vld1q_s32(dst+i), vget_low_s16(x));
+	int32x4_t hi = vaddw_s16(vld1q_s32(dst+i+4), vget_high_s16(x));
+
+	vst1q_s32(dst+i, lo);
+	vst1q_s32(dst+i+4, hi);
+	vmin = vminq_s32(vmin, vminq_s32(lo, hi));
+	vmax = vmaxq_s32(vmax, vmaxq_s32(lo, hi));
+    }
+
+    m = vmin_s32(vget_low_s32(vmin), vget_high_s32(vmin));
+    *p_min = vget_lane_s32(vpmin_s32(m, m), 0);
+    m = vmax_s32(vget_low_s32(vmax), vget_high_s32(vmax));
+    *p_max = vget_lane_s32(vpmax_s32(m, m), 0);
+
+    add_c(dst+i, src+i, count-i, p_min, p_max);
+}
+
+static void sub_neon(pj_int32_t *dst, const pj_int32_t *sum,
+		     const pj_int16_t *src, unsigned count,
+		     pj_int32_t *p_min, pj_int32_t *p_max)
+{
+    int32x4_t vmin = vdupq_n_s32(*p_min);
+    int32x4_t vmax = vdupq_n_s32(*p_max);
+    int32x2_t m;
+    unsigned i;
+
+    for (i=0; i+8 <= count; i+=8) {
+	int16x8_t x = vld1q_s16(src+i);
+	int32x4_t lo = vsubw_s16(vld1q_s32(sum+i), vget_low_s16(x));
+	int32x4_t hi = vsubw_s16(vld1q_s32(sum+i+4), vget_high_s16(x));
+
+	vst1q_s32(dst+i, lo);
+	vst1q_s32(dst+i+4, hi);
+	vmin = vminq_s32(vmin, vminq_s32(lo, hi));
+	vmax = vmaxq_s32(vmax, vmaxq_s32(lo, hi));
+    }
+
+    m = vmin_s32(vget_low_s32(vmin), vget_high_s32(vmin));
+    *p_min = vget_lane_s32(vpmin_s32(m, m), 0);
+    m = vmax_s32(vget_low_s32(vmax), vget_high_s32(vmax));
+    *p_max = vget_lane_s32(vpmax_s32(m, m), 0);
+
+    sub_c(dst+i, sum+i, src+i, count-i, p_min, p_max);
+}
+
+static pj_uint32_t adjust_neon(pj_int16_t *dst, const pj_int32_t *src,
+			       unsigned count, unsigned gain)
+{
+    int32x4_t vgain = vdupq_n_s32((pj_int32_t)gain);
+    int32x4_t sum = vdupq_n_s32(0);
+    unsigned i;
+
+    for (i=0; i+8 <= count; i+=8) {
+	int32x4_t lo = vld1q_s32(src+i);
+	int32x4_t hi = vld1q_s32(src+i+4);
+	int16x8_t x;
+
+	if (gain != 128) {
+	    lo = vshrq_n_s32(vmulq_s32(lo, vgain), 7);
+	    hi = vshrq_n_s32(vmulq_s32(hi, vgain), 7);
+	}
+	x = vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi));
+	vst1q_s16(dst+i, x);
+	sum = neon_abs_sum(sum, x);
+    }
+
+    return neon_hsum(sum) + adjust_c(dst+i, src+i, count-i, gain);
+}
+
+static pj_uint32_t adjust_samples_neon(pj_int16_t *buf, unsigned count,
+				       unsigned gain)
+{
+    int16x4_t vgain;
+    int32x4_t sum = vdupq_n_s32(0);
+    unsigned i;
+
+    if (gain > 32767)
+	return adjust_samples_c(buf, count, gain);
+
+    vgain = vdup_n_s16((pj_int16_t)gain);
+    for (i=0; i+8 <= count; i+=8) {
+	int16x8_t x = vld1q_s16(buf+i);
+	int32x4_t lo = vshrq_n_s32(vmull_s16(vget_low_s16(x), vgain), 7);
+	int32x4_t hi = vshrq_n_s32(vmull_s16(vget_high_s16(x), vgain), 7);
+
+	x = vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi));
+	vst1q_s16(buf+i, x);
+	sum = neon_abs_sum(sum, x);
+    }
+
+    return neon_hsum(sum) + adjust_samples_c(buf+i, count-i, gain);
+}
+
+static pj_uint32_t level_neon(const pj_int16_t *buf, unsigned count)
+{
+    int32x4_t sum = vdupq_n_s32(0);
+    unsigned i;
+
+    for (i=0; i+8 <= count; i+=8)
+	sum = neon_abs_sum(sum, vld1q_s16(buf+i));
+
+    return neon_hsum(sum) + level_c(buf+i, count-i);
+}
+
+static const struct mix_ops ops_neon =
+{
+    PJMEDIA_MIX_IMPL_NEON,
+    &copy_neon,
+    &add_neon,
+    &sub_neon,
+    &adjust_neon,
+    &adjust_samples_neon,
+    &level_neon
+};
+
+#endif	/* HAS_NEON */
+
+
+/*****************************************************************************
+ * Run-time selection.
+ */
+
+/* The implementation in use. Selecting it is idempotent, so a race
+ * between the first callers is harmless.
+ */
+static const struct mix_ops *mix_ops;
+
+/* Get the primitives of the implementation, or NULL if the implementation
+ * is not available.
+ */
+static const struct mix_ops *get_impl_ops(pjmedia_mix_impl impl)
+{
+    switch (impl) {
+    case PJMEDIA_MIX_IMPL_SCALAR:
+	return &ops_c;
+
+#if HAS_SSE2
+    case PJMEDIA_MIX_IMPL_SSE2:
+#  if defined(__GNUC__) && !defined(__x86_64__)
+	__builtin_cpu_init();
+	if (!__builtin_cpu_supports("sse2"))
+	    return NULL;
+#  endif
+	return &ops_sse2;
+#endif
+
+#if HAS_AVX2
+    case PJMEDIA_MIX_IMPL_AVX2:
+#  if defined(__GNUC__)
+	__builtin_cpu_init();
+	if (!__builtin_cpu_supports("avx2"))
+	    return NULL;
+#  else
+	{
+	    int info[4];
+
+	    /* AVX2 and OS support for saving the YMM registers */
+	    __cpuid(info, 1);
+	    if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6)
+		return NULL;
+	    __cpuidex(info, 7, 0);
+	    if ((info[1] & (1 << 5)) == 0)
+		return NULL;
+	}
+#  endif
+	return &ops_avx2;
+#endif
+
+#if HAS_NEON
+    case PJMEDIA_MIX_IMPL_NEON:
+	return &ops_neon;
+#endif
+
+    default:
+	return NULL;
+    }
+}
+
+static const struct mix_ops *get_ops(void)
+{
+    if (mix_ops == NULL) {
+	static const pjmedia_mix_impl prefs[] =
+	{
+	    PJMEDIA_MIX_IMPL_AVX2,
+	    PJMEDIA_MIX_IMPL_NEON,
+	    PJMEDIA_MIX_IMPL_SSE2,
+	    PJMEDIA_MIX_IMPL_SCALAR
+	};
+	const struct mix_ops *ops = NULL;
+	unsigned i;
+
+	for (i=0; ops==NULL; ++i)
+	    ops = get_impl_ops(prefs[i]);
+
+	PJ_LOG(5,(THIS_FILE, "Using %s mixing primitives",
+		  pjmedia_mix_impl_name(ops->impl)));
+	mix_ops = ops;
+    }
+
+    return mix_ops;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_mix_set_impl(pjmedia_mix_impl impl)
+{
+    const struct mix_ops *ops;
+
+    if (impl == PJMEDIA_MIX_IMPL_AUTO) {
+	mix_ops = NULL;
+	get_ops();
+	return PJ_SUCCESS;
+    }
+
+    ops = get_impl_ops(impl);
+    if (ops == NULL)
+	return PJ_ENOTSUP;
+
+    mix_ops = ops;
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pjmedia_mix_impl) pjmedia_mix_get_impl(void)
+{
+    return get_ops()->impl;
+}
+
+
+PJ_DEF(const char*) pjmedia_mix_impl_name(pjmedia_mix_impl impl)
+{
+    static const char *names[] =
+    {
+	"auto", "scalar", "sse2", "avx2", "neon"
+    };
+
+    if ((unsigned)impl >= PJ_ARRAY_SIZE(names))
+	return "unknown";
+    return names[impl];
+}
+
+
+PJ_DEF(void) pjmedia_mix_copy(pj_int32_t *dst, const pj_int16_t *src,
+			      unsigned count)
+{
+    (*get_ops()->copy)(dst, src, count);
+}
+
+
+PJ_DEF(void) pjmedia_mix_add(pj_int32_t *dst, const pj_int16_t *src,
+			     unsigned count, pj_int32_t *p_min,
+			     pj_int32_t *p_max)
+{
+    pj_int32_t vmin = 0x7FFFFFFF, vmax = -0x7FFFFFFF-1;
+
+    (*get_ops()->add)(dst, src, count, &vmin, &vmax);
+
+    if (p_min) *p_min = vmin;
+    if (p_max) *p_max = vmax;
+}
+
+
+PJ_DEF(void) pjmedia_mix_sub(pj_int32_t *dst, const pj_int32_t *sum,
+			     const pj_int16_t *src, unsigned count,
+			     pj_int32_t *p_min, pj_int32_t *p_max)
+{
+    pj_int32_t vmin = 0x7FFFFFFF, vmax = -0x7FFFFFFF-1;
+
+    (*get_ops()->sub)(dst, sum, src, count, &vmin, &vmax);
+
+    if (p_min) *p_min = vmin;
+    if (p_max) *p_max = vmax;
+}
+
+
+PJ_DEF(pj_uint32_t) pjmedia_mix_adjust(pj_int16_t *dst,
+				       const pj_int32_t *src,
+				       unsigned count, unsigned gain)
+{
+    return (*get_ops()->adjust)(dst, src, count, gain);
+}
+
+
+PJ_DEF(pj_uint32_t) pjmedia_mix_adjust_samples(pj_int16_t *buf,
+					       unsigned count,
+					       unsigned gain)
+{
+    return (*get_ops()->adjust_samples)(buf, count, gain);
+}
+
+
+PJ_DEF(pj_uint32_t) pjmedia_mix_level(const pj_int16_t *buf, unsigned count)
+{
+    return (*get_ops()->level)(buf, count);
+}
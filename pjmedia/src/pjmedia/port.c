@@ -117,6 +117,41 @@ PJ_DEF(pj_status_t) pjmedia_port_put_frame( pjmedia_port *port,
 	return PJ_EINVALIDOP;
 }
 
+/**
+ * Get a frame from the port by reference.
+ */
+PJ_DEF(pj_status_t) pjmedia_port_get_frame_buf( pjmedia_port *port,
+						pjmedia_frame *frame,
+						pjmedia_frame_buf **p_fbuf )
+{
+    PJ_ASSERT_RETURN(port && frame && p_fbuf, PJ_EINVAL);
+
+    *p_fbuf = NULL;
+
+    if (port->get_frame_buf)
+	return port->get_frame_buf(port, frame, p_fbuf);
+    else
+	return PJ_ENOTSUP;
+}
+
+
+/**
+ * Put a frame to the port by reference.
+ */
+PJ_DEF(pj_status_t) pjmedia_port_put_frame_buf( pjmedia_port *port,
+						pjmedia_frame *frame,
+						pjmedia_frame_buf *fbuf )
+{
+    PJ_ASSERT_RETURN(port && frame, PJ_EINVAL);
+
+    if (port->put_frame_buf && fbuf)
+	return port->put_frame_buf(port, frame, fbuf);
+    else if (port->put_frame)
+	return port->put_frame(port, frame);
+    else
+	return PJ_EINVALIDOP;
+}
+
 /**
  * Destroy port (and subsequent downstream ports)
  */
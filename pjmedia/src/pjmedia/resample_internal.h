@@ -0,0 +1,45 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJMEDIA_RESAMPLE_INTERNAL_H__
+#define __PJMEDIA_RESAMPLE_INTERNAL_H__
+
+#include <pjmedia/types.h>
+
+PJ_BEGIN_DECL
+
+/*
+ * Polyphase sample rate converter, for the rates with small conversion
+ * ratios. Creation returns PJ_ENOTSUP for the other rates.
+ */
+PJ_DECL(pj_status_t) polyphase_resample_create(pj_pool_t *pool,
+					       pj_bool_t high_quality,
+					       pj_bool_t large_filter,
+					       unsigned channel_count,
+					       unsigned rate_in,
+					       unsigned rate_out,
+					       unsigned samples_per_frame,
+					       void **p_state);
+PJ_DECL(void) polyphase_resample_run(void *state,
+				     const pj_int16_t *input,
+				     pj_int16_t *output);
+
+PJ_END_DECL
+
+#endif
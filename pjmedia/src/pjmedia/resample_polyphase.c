@@ -0,0 +1,467 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pjmedia/errno.h>
+#include <pjmedia/frame.h>
+#include <pjmedia/mixer.h>
+#include <pj/assert.h>
+#include <pj/log.h>
+#include <pj/math.h>
+#include <pj/pool.h>
+#include <math.h>
+#include "resample_internal.h"
+
+
+#if defined(PJMEDIA_HAS_POLYPHASE_RESAMPLE) && \
+    PJMEDIA_HAS_POLYPHASE_RESAMPLE!=0
+
+#define THIS_FILE   "resample_polyphase.c"
+
+/*
+ * The conversion from rate_in to rate_out = rate_in * L / M is done by
+ * upsampling by L, low-pass filtering and downsampling by M. Only every
+ * M-th output of the filter is computed, and only from the input samples,
+ * so each output uses one of the L phases of the filter: a filter with
+ * "taps" coefficients, applied to the last "taps" input samples.
+ *
+ * The filter bank is computed when the converter is created, in Q15. The
+ * coefficients of each phase are stored in reverse, so that each output
+ * is the dot product of the phase with contiguous input samples, which
+ * is what the SIMD implementations compute.
+ */
+
+/* Largest L and M. This covers the conversions between 8, 16, 32 and
+ * 48 KHz, and between 11.025, 22.05 and 44.1 KHz.
+ */
+#define MAX_FACTOR	6
+
+/* Filter quality presets */
+static const struct preset
+{
+    unsigned	half_taps;	/* Taps on each side, when not decimating */
+    double	beta;		/* Kaiser window parameter		  */
+    double	rolloff;	/* Cutoff, relative to the lower Nyquist  */
+} presets[] =
+{
+    { 4,  5.0, 0.80 },		/* Low quality				  */
+    { 8,  7.0, 0.86 },		/* High quality, small filter		  */
+    { 16, 8.5, 0.91 }		/* High quality, large filter		  */
+};
+
+
+#if PJMEDIA_HAS_SIMD
+#   if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#	define HAS_SSE2		1
+#	define HAS_AVX2		1
+#	define TARGET_SSE2	__attribute__((target("sse2")))
+#	define TARGET_AVX2	__attribute__((target("avx2")))
+#	include <immintrin.h>
+#   elif defined(_MSC_VER) && \
+	 (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#	define HAS_SSE2		1
+#	define HAS_AVX2		1
+#	define TARGET_SSE2
+#	define TARGET_AVX2
+#	include <immintrin.h>
+#   endif
+#   if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#	define HAS_NEON		1
+#	include <arm_neon.h>
+#   endif
+#endif
+
+#ifndef HAS_SSE2
+#   define HAS_SSE2	0
+#   define HAS_AVX2	0
+#endif
+#ifndef HAS_NEON
+#   define HAS_NEON	0
+#endif
+
+
+/* Filter the input into out_cnt output samples. The taps are a multiple
+ * of 8.
+ */
+typedef void filter_func(pj_int16_t *out, unsigned out_cnt,
+			 const pj_int16_t *in, const pj_int16_t *bank,
+			 unsigned taps, unsigned L, unsigned M);
+
+struct polyphase
+{
+    unsigned	 L, M;		/* Interpolation and decimation factors.    */
+    unsigned	 taps;		/* Taps of each phase.			    */
+    unsigned	 channel_cnt;	/* Channel count.			    */
+    unsigned	 in_cnt;	/* Input samples per frame, per channel.    */
+    unsigned	 out_cnt;	/* Output samples per frame, per channel.   */
+    pj_int16_t	*bank;		/* L phases of taps coefficients.	    */
+    pj_int16_t **buf;		/* History and input of each channel.	    */
+    pj_int16_t	*tmp;		/* Output of one channel, if multichannel.  */
+};
+
+
+/* Round the Q15 sum and saturate it to 16bit */
+PJ_INLINE(pj_int16_t) q15_round(pj_int32_t sum)
+{
+    sum = (sum + (1 << 14)) >> 15;
+    if (sum > 32767)
+	return 32767;
+    if (sum < -32768)
+	return -32768;
+    return (pj_int16_t)sum;
+}
+
+/* Compute the outputs of a frame with the dot product function "dot".
+ * The output n is at n*M of the upsampled signal, i.e. at input i0 and
+ * phase p.
+ */
+#define FILTER_LOOP(dot) \
+	    do { \
+		unsigned n_, i0_ = 0, p_ = 0; \
+		for (n_ = 0; n_ < out_cnt; ++n_) { \
+		    out[n_] = q15_round(dot(in + i0_, bank + p_ * taps, \
+					    taps)); \
+		    p_ += M; \
+		    while (p_ >= L) { \
+			p_ -= L; \
+			++i0_; \
+		    } \
+		} \
+	    } while (0)
+
+
+/*
+ * Portable C implementation.
+ */
+PJ_INLINE(pj_int32_t) dot_c(const pj_int16_t *x, const pj_int16_t *c,
+			    unsigned taps)
+{
+    pj_int32_t sum = 0;
+    unsigned i;
+
+    for (i=0; i<taps; ++i)
+	sum += (pj_int32_t)x[i] * c[i];
+    return sum;
+}
+
+static void filter_c(pj_int16_t *out, unsigned out_cnt,
+		     const pj_int16_t *in, const pj_int16_t *bank,
+		     unsigned taps, unsigned L, unsigned M)
+{
+    FILTER_LOOP(dot_c);
+}
+
+
+#if HAS_SSE2
+TARGET_SSE2
+PJ_INLINE(pj_int32_t) dot_sse2(const pj_int16_t *x, const pj_int16_t *c,
+			       unsigned taps)
+{
+    __m128i acc = _mm_setzero_si128();
+    unsigned i;
+
+    for (i=0; i<taps; i+=8) {
+	acc = _mm_add_epi32(acc, _mm_madd_epi16(
+				_mm_loadu_si128((const __m128i*)(x+i)),
+				_mm_loadu_si128((const __m128i*)(c+i))));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1,0,3,2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2,3,0,1)));
+    return _mm_cvtsi128_si32(acc);
+}
+
+TARGET_SSE2
+static void filter_sse2(pj_int16_t *out, unsigned out_cnt,
+			const pj_int16_t *in, const pj_int16_t *bank,
+			unsigned taps, unsigned L, unsigned M)
+{
+    FILTER_LOOP(dot_sse2);
+}
+#endif	/* HAS_SSE2 */
+
+
+#if HAS_AVX2
+TARGET_AVX2
+PJ_INLINE(pj_int32_t) dot_avx2(const pj_int16_t *x, const pj_int16_t *c,
+			       unsigned taps)
+{
+    __m256i acc8 = _mm256_setzero_si256();
+    __m128i acc;
+    unsigned i;
+
+    for (i=0; i+16<=taps; i+=16) {
+	acc8 = _mm256_add_epi32(acc8, _mm256_madd_epi16(
+				_mm256_loadu_si256((const __m256i*)(x+i)),
+				_mm256_loadu_si256((const __m256i*)(c+i))));
+    }
+    acc = _mm_add_epi32(_mm256_castsi256_si128(acc8),
+			_mm256_extracti128_si256(acc8, 1));
+    if (i < taps) {
+	acc = _mm_add_epi32(acc, _mm_madd_epi16(
+				_mm_loadu_si128((const __m128i*)(x+i)),
+				_mm_loadu_si128((const __m128i*)(c+i))));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1,0,3,2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2,3,0,1)));
+    return _mm_cvtsi128_si32(acc);
+}
+
+TARGET_AVX2
+static void filter_avx2(pj_int16_t *out, unsigned out_cnt,
+			const pj_int16_t *in, const pj_int16_t *bank,
+			unsigned taps, unsigned L, unsigned M)
+{
+    FILTER_LOOP(dot_avx2);
+}
+#endif	/* HAS_AVX2 */
+
+
+#if HAS_NEON
+PJ_INLINE(pj_int32_t) dot_neon(const pj_int16_t *x, const pj_int16_t *c,
+			       unsigned taps)
+{
+    int32x4_t acc = vdupq_n_s32(0);
+    int32x2_t sum;
+    unsigned i;
+
+    for (i=0; i<taps; i+=8) {
+	int16x8_t vx = vld1q_s16(x+i);
+	int16x8_t vc = vld1q_s16(c+i);
+
+	acc = vmlal_s16(acc, vget_low_s16(vx), vget_low_s16(vc));
+	acc = vmlal_s16(acc, vget_high_s16(vx), vget_high_s16(vc));
+    }
+    sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+    sum = vpadd_s32(sum, sum);
+    return vget_lane_s32(sum, 0);
+}
+
+static void filter_neon(pj_int16_t *out, unsigned out_cnt,
+			const pj_int16_t *in, const pj_int16_t *bank,
+			unsigned taps, unsigned L, unsigned M)
+{
+    FILTER_LOOP(dot_neon);
+}
+#endif	/* HAS_NEON */
+
+
+/* Get the filter of the implementation selected for the mixing
+ * primitives, which is known to be supported by the CPU.
+ */
+static filter_func *get_filter(void)
+{
+    switch (pjmedia_mix_get_impl()) {
+#if HAS_SSE2
+    case PJMEDIA_MIX_IMPL_SSE2:
+	return &filter_sse2;
+#endif
+#if HAS_AVX2
+    case PJMEDIA_MIX_IMPL_AVX2:
+	return &filter_avx2;
+#endif
+#if HAS_NEON
+    case PJMEDIA_MIX_IMPL_NEON:
+	return &filter_neon;
+#endif
+    default:
+	return &filter_c;
+    }
+}
+
+
+/* Zeroth order modified Bessel function of the first kind */
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    unsigned k;
+
+    for (k=1; k<50 && term > sum * 1e-12; ++k) {
+	term *= (x / (2.0 * k)) * (x / (2.0 * k));
+	sum += term;
+    }
+    return sum;
+}
+
+/* Compute the filter bank: a Kaiser windowed sinc low-pass filter at the
+ * upsampled rate, split into L phases.
+ */
+static void init_bank(struct polyphase *pp, const struct preset *preset,
+		      pj_pool_t *pool)
+{
+    unsigned len = pp->taps * pp->L;
+    double center = (len - 1) / 2.0;
+    double fc = preset->rolloff * 0.5 / PJ_MAX(pp->L, pp->M);
+    double i0_beta = bessel_i0(preset->beta);
+    double *h;
+    unsigned p, j;
+
+    h = (double*) pj_pool_alloc(pool, len * sizeof(double));
+
+    for (j=0; j<len; ++j) {
+	double t = j - center;
+	double r = t / (len / 2.0);
+	double sinc = (t == 0) ? 1.0 :
+		      sin(2 * PJ_PI * fc * t) / (2 * PJ_PI * fc * t);
+
+	h[j] = 2 * fc * sinc * bessel_i0(preset->beta * sqrt(1 - r*r)) /
+	       i0_beta;
+    }
+
+    /* Normalize each phase to unity gain at DC, so that the phases don't
+     * modulate a constant signal, and store it in reverse.
+     */
+    for (p=0; p<pp->L; ++p) {
+	pj_int16_t *c = pp->bank + p * pp->taps;
+	double sum = 0;
+
+	for (j=0; j<pp->taps; ++j)
+	    sum += h[p + j * pp->L];
+
+	for (j=0; j<pp->taps; ++j) {
+	    double v = floor(h[p + j * pp->L] / sum * 32768.0 + 0.5);
+
+	    if (v > 32767)
+		v = 32767;
+	    else if (v < -32768)
+		v = -32768;
+	    c[pp->taps - 1 - j] = (pj_int16_t)v;
+	}
+    }
+}
+
+
+PJ_DEF(pj_status_t) polyphase_resample_create(pj_pool_t *pool,
+					      pj_bool_t high_quality,
+					      pj_bool_t large_filter,
+					      unsigned channel_count,
+					      unsigned rate_in,
+					      unsigned rate_out,
+					      unsigned samples_per_frame,
+					      void **p_state)
+{
+    const struct preset *preset;
+    struct polyphase *pp;
+    unsigned a, b, L, M, in_cnt, i;
+
+    PJ_ASSERT_RETURN(pool && channel_count && rate_in && rate_out &&
+		     samples_per_frame && p_state, PJ_EINVAL);
+
+    /* Reduce the ratio */
+    a = rate_in;
+    b = rate_out;
+    while (b) {
+	unsigned t = a % b;
+	a = b;
+	b = t;
+    }
+    L = rate_out / a;
+    M = rate_in / a;
+
+    /* The frame must contain a whole number of filter periods */
+    in_cnt = samples_per_frame / channel_count;
+    if (L > MAX_FACTOR || M > MAX_FACTOR ||
+	in_cnt * channel_count != samples_per_frame ||
+	in_cnt % M != 0)
+    {
+	return PJ_ENOTSUP;
+    }
+
+    if (!high_quality)
+	preset = &presets[0];
+    else if (!large_filter)
+	preset = &presets[1];
+    else
+	preset = &presets[2];
+
+    pp = PJ_POOL_ZALLOC_T(pool, struct polyphase);
+    pp->L = L;
+    pp->M = M;
+    pp->channel_cnt = channel_count;
+    pp->in_cnt = in_cnt;
+    pp->out_cnt = in_cnt / M * L;
+
+    /* When decimating, the cutoff is lower, so the filter must be longer
+     * for the same transition width.
+     */
+    pp->taps = 2 * preset->half_taps * ((M + L - 1) / L);
+
+    pp->bank = (pj_int16_t*)
+	       pj_pool_alloc(pool, L * pp->taps * sizeof(pj_int16_t));
+    init_bank(pp, preset, pool);
+
+    pp->buf = (pj_int16_t**)
+	      pj_pool_calloc(pool, channel_count, sizeof(pj_int16_t*));
+    for (i=0; i<channel_count; ++i) {
+	pp->buf[i] = (pj_int16_t*)
+		     pj_pool_calloc(pool, pp->taps - 1 + in_cnt,
+				    sizeof(pj_int16_t));
+    }
+    if (channel_count > 1) {
+	pp->tmp = (pj_int16_t*)
+		  pj_pool_alloc(pool, pp->out_cnt * sizeof(pj_int16_t));
+    }
+
+    *p_state = pp;
+
+    PJ_LOG(5,(THIS_FILE, "polyphase resample created: %u/%u, %u taps, "
+	      "in/out rate=%u/%u", L, M, pp->taps, rate_in, rate_out));
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(void) polyphase_resample_run(void *state,
+				    const pj_int16_t *input,
+				    pj_int16_t *output)
+{
+    struct polyphase *pp = (struct polyphase*) state;
+    filter_func *filter = get_filter();
+    unsigned hist = pp->taps - 1;
+
+    if (pp->channel_cnt == 1) {
+	pjmedia_copy_samples(pp->buf[0] + hist, input, pp->in_cnt);
+	(*filter)(output, pp->out_cnt, pp->buf[0], pp->bank, pp->taps,
+		  pp->L, pp->M);
+	pjmedia_move_samples(pp->buf[0], pp->buf[0] + pp->in_cnt, hist);
+
+    } else {
+	unsigned ch, i;
+
+	for (ch=0; ch<pp->channel_cnt; ++ch) {
+	    pj_int16_t *buf = pp->buf[ch];
+
+	    /* Deinterleave input */
+	    for (i=0; i<pp->in_cnt; ++i)
+		buf[hist + i] = input[i * pp->channel_cnt + ch];
+
+	    (*filter)(pp->tmp, pp->out_cnt, buf, pp->bank, pp->taps,
+		      pp->L, pp->M);
+	    pjmedia_move_samples(buf, buf + pp->in_cnt, hist);
+
+	    /* Reinterleave output */
+	    for (i=0; i<pp->out_cnt; ++i)
+		output[i * pp->channel_cnt + ch] = pp->tmp[i];
+	}
+    }
+}
+
+
+#else	/* PJMEDIA_HAS_POLYPHASE_RESAMPLE */
+
+int pjmedia_resample_polyphase_excluded;
+
+#endif	/* PJMEDIA_HAS_POLYPHASE_RESAMPLE */
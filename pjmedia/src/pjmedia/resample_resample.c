@@ -24,6 +24,7 @@
 #include <pj/assert.h>
 #include <pj/log.h>
 #include <pj/pool.h>
+#include "resample_internal.h"
 
 
 #if PJMEDIA_RESAMPLE_IMP==PJMEDIA_RESAMPLE_LIBRESAMPLE
@@ -49,6 +50,9 @@ struct pjmedia_resample
     /* Buffer for multichannel */
     pj_int16_t **in_buffer;	/* Array of input buffer for each channel.  */
     pj_int16_t  *tmp_buffer;	/* Temporary output buffer for processing.  */
+
+    /* Polyphase resampler, used instead of libresample if not NULL */
+    void	*polyphase;
 };
 
 
@@ -62,6 +66,9 @@ PJ_DEF(pj_status_t) pjmedia_resample_create( pj_pool_t *pool,
 					     pjmedia_resample **p_resample)
 {
     pjmedia_resample *resample;
+#if PJMEDIA_HAS_POLYPHASE_RESAMPLE
+    pj_status_t status;
+#endif
 
     PJ_ASSERT_RETURN(pool && p_resample && rate_in &&
 		     rate_out && samples_per_frame, PJ_EINVAL);
@@ -85,6 +92,19 @@ PJ_DEF(pj_status_t) pjmedia_resample_create( pj_pool_t *pool,
     resample->channel_cnt = channel_count;
     resample->frame_size = samples_per_frame;
 
+#if PJMEDIA_HAS_POLYPHASE_RESAMPLE
+    /* Use the polyphase resampler for the ratios that it supports */
+    status = polyphase_resample_create(pool, high_quality, large_filter,
+				       channel_count, rate_in, rate_out,
+				       samples_per_frame, &resample->polyphase);
+    if (status == PJ_SUCCESS) {
+	*p_resample = resample;
+	return PJ_SUCCESS;
+    } else if (status != PJ_ENOTSUP) {
+	return status;
+    }
+#endif
+
     if (high_quality) {
 	/* This is a bug in xoff calculation, thanks Stephane Lussier
 	 * of Macadamian dot com.
@@ -146,6 +166,11 @@ PJ_DEF(void) pjmedia_resample_run( pjmedia_resample *resample,
 {
     PJ_ASSERT_ON_FAIL(resample, return);
 
+    if (resample->polyphase) {
+	polyphase_resample_run(resample->polyphase, input, output);
+	return;
+    }
+
     /* Okay chaps, here's how we do resampling.
      *
      * The original resample algorithm requires xoff samples *before* the
@@ -23,6 +23,8 @@
 #include <pjmedia/rtcp.h>
 #include <pjmedia/jbuf.h>
 #include <pjmedia/stream_common.h>
+#include <pjmedia/circbuf.h>
+#include <pjmedia/wsola.h>
 #include <pj/array.h>
 #include <pj/assert.h>
 #include <pj/ctype.h>
@@ -152,6 +154,14 @@ struct pjmedia_stream
     char		     jb_last_frm;   /**< Last frame type from jb    */
     unsigned		     jb_last_frm_cnt;/**< Last JB frame type counter*/
 
+#if defined(PJMEDIA_STREAM_TIME_STRETCH) && PJMEDIA_STREAM_TIME_STRETCH!=0
+    pjmedia_wsola	    *tsm_wsola;	    /**< WSOLA for time-stretching,
+						 NULL if not used.	    */
+    pjmedia_circ_buf	    *tsm_buf;	    /**< Decoded samples to play.   */
+    pj_int16_t		    *tsm_frm;	    /**< One decoded frame.	    */
+    pj_bool_t		     tsm_synth;	    /**< Last frame was synthetic.  */
+#endif
+
     pjmedia_rtcp_session     rtcp;	    /**< RTCP for incoming RTP.	    */
 
     pj_uint32_t		     rtcp_last_tx;  /**< RTCP tx time in timestamp  */
@@ -473,29 +483,21 @@ static void send_keep_alive_packet(pjmedia_stream *stream)
  * This callback is called by sound device's player thread when it
  * needs to feed the player with some frames.
  */
-static pj_status_t get_frame( pjmedia_port *port, pjmedia_frame *frame)
+/*
+ * Get frames from the jitter buffer and decode them to the frame buffer,
+ * until we have the required number of samples, or the jitter buffer is
+ * empty. Returns the number of samples in the frame. The jitter buffer
+ * mutex must be held.
+ */
+static unsigned decode_jb_frames(pjmedia_stream *stream,
+				 pjmedia_frame *frame,
+				 unsigned samples_required)
 {
-    pjmedia_stream *stream = (pjmedia_stream*) port->port_data.pdata;
     pjmedia_channel *channel = stream->dec;
-    unsigned samples_count, samples_per_frame, samples_required;
+    unsigned samples_count, samples_per_frame;
     pj_int16_t *p_out_samp;
     pj_status_t status;
 
-
-    /* Return no frame is channel is paused */
-    if (channel->paused) {
-	frame->type = PJMEDIA_FRAME_TYPE_NONE;
-	return PJ_SUCCESS;
-    }
-
-    /* Repeat get frame from the jitter buffer and decode the frame
-     * until we have enough frames according to codec's ptime.
-     */
-
-    /* Lock jitter buffer mutex first */
-    pj_mutex_lock( stream->jb_mutex );
-
-    samples_required = PJMEDIA_PIA_SPF(&stream->port.info);
     samples_per_frame = stream->codec_param.info.frm_ptime *
 			stream->codec_param.info.clock_rate *
 			stream->codec_param.info.channel_cnt /
@@ -687,7 +689,7 @@ static pj_status_t get_frame( pjmedia_port *port, pjmedia_frame *frame)
 					   (unsigned)frame_out.size,
 					   &frame_out);
 	    if (status != 0) {
-		LOGERR_((port->info.name.ptr, "codec decode() error",
+		LOGERR_((stream->port.info.name.ptr, "codec decode() error",
 			 status));
 
 		pjmedia_zero_samples(p_out_samp + samples_count,
@@ -710,6 +712,132 @@ static pj_status_t get_frame( pjmedia_port *port, pjmedia_frame *frame)
     }
 
 
+    return samples_count;
+}
+
+
+#if defined(PJMEDIA_STREAM_TIME_STRETCH) && PJMEDIA_STREAM_TIME_STRETCH!=0
+/*
+ * Decode one frame interval to the time-stretching buffer, shrinking or
+ * expanding the audio as recommended by the jitter buffer. Returns the
+ * number of samples added. The jitter buffer mutex must be held.
+ */
+static unsigned stretch_jb_frames(pjmedia_stream *stream)
+{
+    pjmedia_jb_stretch_op op;
+    pjmedia_frame tmp;
+    unsigned samples_per_frame, i, cnt, added = 0;
+    pj_bool_t all_normal = PJ_TRUE;
+
+    samples_per_frame = stream->codec_param.info.frm_ptime *
+			stream->codec_param.info.clock_rate / 1000;
+
+    op = pjmedia_jbuf_get_stretch_op(stream->jb);
+
+    /* Expand with a synthetic frame, without getting any frame */
+    if (op == PJMEDIA_JB_STRETCH_EXPAND &&
+	stream->jb_last_frm == PJMEDIA_JB_NORMAL_FRAME)
+    {
+	pjmedia_wsola_generate(stream->tsm_wsola, stream->tsm_frm);
+	pjmedia_circ_buf_write(stream->tsm_buf, stream->tsm_frm,
+			       samples_per_frame);
+	stream->tsm_synth = PJ_TRUE;
+	return samples_per_frame;
+    }
+
+    cnt = (op == PJMEDIA_JB_STRETCH_SHRINK ? 2 : 1);
+    for (i = 0; i < cnt; ++i) {
+	unsigned count;
+
+	tmp.buf = stream->tsm_frm;
+	tmp.size = samples_per_frame * BYTES_PER_SAMPLE;
+	count = decode_jb_frames(stream, &tmp, samples_per_frame);
+	if (count == 0)
+	    return added;
+
+	if (stream->jb_last_frm != PJMEDIA_JB_NORMAL_FRAME)
+	    all_normal = PJ_FALSE;
+
+	pjmedia_wsola_save(stream->tsm_wsola, stream->tsm_frm,
+			   stream->tsm_synth);
+	stream->tsm_synth = PJ_FALSE;
+
+	pjmedia_circ_buf_write(stream->tsm_buf, stream->tsm_frm, count);
+	added += count;
+    }
+
+    /* Shrink the two frames to about one frame. WSOLA erases at least
+     * the requested number of samples, up to one frame more.
+     */
+    if (op == PJMEDIA_JB_STRETCH_SHRINK && all_normal) {
+	pj_int16_t *buf1, *buf2;
+	unsigned buf1len, buf2len, erase_cnt;
+
+	erase_cnt = samples_per_frame / 2;
+	pjmedia_circ_buf_get_read_regions(stream->tsm_buf, &buf1, &buf1len,
+					  &buf2, &buf2len);
+	if (pjmedia_wsola_discard(stream->tsm_wsola, buf1, buf1len,
+				  buf2, buf2len, &erase_cnt) == PJ_SUCCESS)
+	{
+	    pjmedia_circ_buf_set_len(stream->tsm_buf,
+				     pjmedia_circ_buf_get_len(stream->tsm_buf)-
+				     erase_cnt);
+	    added -= PJ_MIN(added, erase_cnt);
+	}
+    }
+
+    return added;
+}
+#endif
+
+
+static pj_status_t get_frame( pjmedia_port *port, pjmedia_frame *frame)
+{
+    pjmedia_stream *stream = (pjmedia_stream*) port->port_data.pdata;
+    pjmedia_channel *channel = stream->dec;
+    unsigned samples_count, samples_required;
+
+
+    /* Return no frame is channel is paused */
+    if (channel->paused) {
+	frame->type = PJMEDIA_FRAME_TYPE_NONE;
+	return PJ_SUCCESS;
+    }
+
+    /* Repeat get frame from the jitter buffer and decode the frame
+     * until we have enough frames according to codec's ptime.
+     */
+
+    /* Lock jitter buffer mutex first */
+    pj_mutex_lock( stream->jb_mutex );
+
+    samples_required = PJMEDIA_PIA_SPF(&stream->port.info);
+
+#if defined(PJMEDIA_STREAM_TIME_STRETCH) && PJMEDIA_STREAM_TIME_STRETCH!=0
+    if (stream->tsm_wsola) {
+	/* Fill the time-stretching buffer one frame interval at a time */
+	while (pjmedia_circ_buf_get_len(stream->tsm_buf) < samples_required) {
+	    if (stretch_jb_frames(stream) == 0)
+		break;
+	}
+
+	samples_count = PJ_MIN(pjmedia_circ_buf_get_len(stream->tsm_buf),
+			       samples_required);
+	pjmedia_circ_buf_read(stream->tsm_buf, (pj_int16_t*)frame->buf,
+			      samples_count);
+
+	/* Pad the last partial frame with silence */
+	if (samples_count && samples_count < samples_required) {
+	    pjmedia_zero_samples((pj_int16_t*)frame->buf + samples_count,
+				 samples_required - samples_count);
+	    samples_count = samples_required;
+	}
+    } else
+#endif
+    {
+	samples_count = decode_jb_frames(stream, frame, samples_required);
+    }
+
     /* Unlock jitter buffer mutex. */
     pj_mutex_unlock( stream->jb_mutex );
 
@@ -2241,11 +2369,14 @@ PJ_DEF(pj_status_t) pjmedia_stream_create( pjmedia_endpt *endpt,
 	//jb_init = (jb_min_pre + jb_max_pre) / 2;
 	jb_init = 0;
 
-    /* Create jitter buffer */
-    status = pjmedia_jbuf_create(pool, &stream->port.info.name,
-				 stream->frame_size,
-				 stream->codec_param.info.frm_ptime,
-				 jb_max, &stream->jb);
+    /* Create jitter buffer, keeping the frames in the storage shared by
+     * the streams of the endpoint.
+     */
+    status = pjmedia_jbuf_create2(pool, &stream->port.info.name,
+				  stream->frame_size,
+				  stream->codec_param.info.frm_ptime,
+				  jb_max, pjmedia_endpt_get_jb_slab(endpt),
+				  &stream->jb);
     if (status != PJ_SUCCESS)
 	goto err_cleanup;
 
@@ -2253,6 +2384,32 @@ PJ_DEF(pj_status_t) pjmedia_stream_create( pjmedia_endpt *endpt,
     /* Set up jitter buffer */
     pjmedia_jbuf_set_adaptive( stream->jb, jb_init, jb_min_pre, jb_max_pre);
 
+#if defined(PJMEDIA_STREAM_TIME_STRETCH) && PJMEDIA_STREAM_TIME_STRETCH!=0
+    /* Adapt the latency with time-stretching, for mono audio */
+    if (stream->codec_param.info.channel_cnt == 1) {
+	unsigned tsm_spf = stream->codec_param.info.frm_ptime *
+			   stream->codec_param.info.clock_rate / 1000;
+
+	status = pjmedia_wsola_create(pool,
+				      stream->codec_param.info.clock_rate,
+				      tsm_spf, 1, PJMEDIA_WSOLA_NO_FADING,
+				      &stream->tsm_wsola);
+	if (status != PJ_SUCCESS)
+	    goto err_cleanup;
+
+	status = pjmedia_circ_buf_create(pool,
+					 PJMEDIA_AFD_SPF(afd) + tsm_spf * 3,
+					 &stream->tsm_buf);
+	if (status != PJ_SUCCESS)
+	    goto err_cleanup;
+
+	stream->tsm_frm = (pj_int16_t*)
+			  pj_pool_alloc(pool, tsm_spf * BYTES_PER_SAMPLE);
+
+	pjmedia_jbuf_set_stretch(stream->jb, PJ_TRUE);
+    }
+#endif
+
     /* Create decoder channel: */
 
     status = create_channel( pool, stream, PJMEDIA_DIR_DECODING,
@@ -2523,6 +2680,13 @@ PJ_DEF(pj_status_t) pjmedia_stream_destroy( pjmedia_stream *stream )
     if (stream->jb)
 	pjmedia_jbuf_destroy(stream->jb);
 
+#if defined(PJMEDIA_STREAM_TIME_STRETCH) && PJMEDIA_STREAM_TIME_STRETCH!=0
+    if (stream->tsm_wsola) {
+	pjmedia_wsola_destroy(stream->tsm_wsola);
+	stream->tsm_wsola = NULL;
+    }
+#endif
+
 #if TRACE_JB
     if (TRACE_JB_OPENED(stream)) {
 	pj_file_close(stream->trace_jb_fd);
@@ -1577,11 +1577,14 @@ PJ_DEF(pj_status_t) pjmedia_vid_stream_create(
     stream->rx_frames = pj_pool_calloc(pool, stream->rx_frame_cnt,
                                        sizeof(stream->rx_frames[0]));
 
-    /* Create jitter buffer */
-    status = pjmedia_jbuf_create(pool, &stream->dec->port.info.name,
-                                 PJMEDIA_MAX_MRU,
-				 1000 * vfd_enc->fps.denum / vfd_enc->fps.num,
-				 jb_max, &stream->jb);
+    /* Create jitter buffer, keeping the frames in the storage shared by
+     * the streams of the endpoint.
+     */
+    status = pjmedia_jbuf_create2(pool, &stream->dec->port.info.name,
+				  PJMEDIA_MAX_MRU,
+				  1000 * vfd_enc->fps.denum / vfd_enc->fps.num,
+				  jb_max, pjmedia_endpt_get_jb_slab(endpt),
+				  &stream->jb);
     if (status != PJ_SUCCESS)
 	return status;
 
@@ -0,0 +1,701 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+#include <pjmedia/conf_group.h>
+
+#define THIS_FILE   "conf_test.c"
+
+#define CLOCK_RATE  8000
+#define SPF	    160
+#define PORT_CNT    12
+#define TICKS	    50
+#define SIGNATURE   PJMEDIA_SIG_CLASS_PORT_AUD('C','T')
+
+
+/* Test port: it returns a deterministic signal, or a constant one when
+ * the level is set, and keeps a checksum of the frames which the bridge
+ * writes to it.
+ */
+struct test_port
+{
+    pjmedia_port	 base;
+    unsigned		 id;
+    pj_int16_t		 level;
+    pj_uint32_t		 seed;
+    unsigned		 get_cnt;
+    unsigned		 put_cnt;
+    pj_uint32_t		 checksum;
+    pjmedia_frame_type	 last_type;
+    pj_int16_t		 last_sample;
+    void		(*on_get)(struct test_port*);
+    void		*user_data;
+};
+
+/* Fill the frame with the next frame of the port's signal. */
+static void tp_fill(struct test_port *tp, pjmedia_frame *frame)
+{
+    pj_int16_t *samples = (pj_int16_t*) frame->buf;
+    unsigned i;
+
+    ++tp->get_cnt;
+
+    if (tp->level) {
+	for (i=0; i<SPF; ++i)
+	    samples[i] = tp->level;
+	frame->type = PJMEDIA_FRAME_TYPE_AUDIO;
+	frame->size = SPF * 2;
+	return;
+    }
+
+    /* Every port is silent now and then */
+    if ((tp->get_cnt + tp->id) % 7 == 0) {
+	frame->type = PJMEDIA_FRAME_TYPE_NONE;
+	frame->size = 0;
+	return;
+    }
+
+    for (i=0; i<SPF; ++i) {
+	tp->seed = tp->seed * 1103515245 + 12345;
+	/* Loud ports make the mix overflow */
+	if (tp->id % 3 == 0)
+	    samples[i] = (pj_int16_t)(tp->seed >> 16);
+	else
+	    samples[i] = (pj_int16_t)((pj_int32_t)(tp->seed >> 16) / 16);
+    }
+    frame->type = PJMEDIA_FRAME_TYPE_AUDIO;
+    frame->size = SPF * 2;
+}
+
+/* Add the frame to the checksum of the port. */
+static void tp_sum(struct test_port *tp, const pjmedia_frame *frame)
+{
+    const pj_uint8_t *p = (const pj_uint8_t*) frame->buf;
+    pj_size_t i;
+
+    ++tp->put_cnt;
+    tp->last_type = frame->type;
+    tp->last_sample = 0;
+
+    /* FNV-1a */
+    tp->checksum = (tp->checksum ^ frame->type) * 16777619;
+    if (frame->type != PJMEDIA_FRAME_TYPE_AUDIO)
+	return;
+    tp->last_sample = ((const pj_int16_t*)frame->buf)[SPF-1];
+    for (i=0; i<frame->size; ++i)
+	tp->checksum = (tp->checksum ^ p[i]) * 16777619;
+}
+
+static pj_status_t tp_get_frame(pjmedia_port *this_port,
+				pjmedia_frame *frame)
+{
+    struct test_port *tp = (struct test_port*) this_port;
+
+    if (tp->on_get)
+	(*tp->on_get)(tp);
+    tp_fill(tp, frame);
+    return PJ_SUCCESS;
+}
+
+static pj_status_t tp_put_frame(pjmedia_port *this_port,
+				pjmedia_frame *frame)
+{
+    tp_sum((struct test_port*) this_port, frame);
+    return PJ_SUCCESS;
+}
+
+static struct test_port *create_port(pj_pool_t *pool, unsigned id)
+{
+    struct test_port *tp;
+    char name[16];
+    pj_str_t str_name;
+
+    tp = PJ_POOL_ZALLOC_T(pool, struct test_port);
+    pj_ansi_snprintf(name, sizeof(name), "tp%u", id);
+    pj_strdup2(pool, &str_name, name);
+    pjmedia_port_info_init(&tp->base.info, &str_name, SIGNATURE, CLOCK_RATE,
+			   1, 16, SPF);
+    tp->base.get_frame = &tp_get_frame;
+    tp->base.put_frame = &tp_put_frame;
+    tp->id = id;
+    tp->seed = id * 2654435761u;
+    tp->checksum = 2166136261u;
+
+    return tp;
+}
+
+
+/* Checksums of the frames written to the ports during a run. */
+struct run_result
+{
+    pj_uint32_t	    checksum[PORT_CNT+1];
+    unsigned	    put_cnt[PORT_CNT+1];
+};
+
+/*
+ * Run the bridge for some ticks with the specified number of worker
+ * threads, and get the checksum of what each port has received. Port zero
+ * is driven by this thread, as a sound device would do.
+ */
+static int mix_run(pj_pool_t *pool, unsigned worker_threads,
+		   unsigned active_speakers, struct run_result *res)
+{
+    pjmedia_conf_param param;
+    pjmedia_conf *conf;
+    pjmedia_port *master;
+    struct test_port *tp[PORT_CNT+1];
+    pj_int16_t buf[SPF];
+    unsigned i, j, slot[PORT_CNT+1];
+    int rc = 0;
+    pj_status_t status;
+
+    pjmedia_conf_param_default(&param);
+    param.max_slots = PORT_CNT + 1;
+    param.sampling_rate = CLOCK_RATE;
+    param.channel_count = 1;
+    param.samples_per_frame = SPF;
+    param.bits_per_sample = 16;
+    param.options = PJMEDIA_CONF_NO_DEVICE;
+    param.worker_threads = worker_threads;
+    param.active_speakers = active_speakers;
+
+    status = pjmedia_conf_create2(pool, &param, &conf);
+    if (status != PJ_SUCCESS) {
+	app_perror(status, "  error creating conference bridge");
+	return -10;
+    }
+    master = pjmedia_conf_get_master_port(conf);
+
+    /* Port zero is the local microphone and speaker */
+    tp[0] = create_port(pool, 0);
+    slot[0] = 0;
+
+    for (i=1; i<=PORT_CNT; ++i) {
+	tp[i] = create_port(pool, i);
+	status = pjmedia_conf_add_port(conf, pool, &tp[i]->base, NULL,
+				       &slot[i]);
+	if (status != PJ_SUCCESS) {
+	    rc = -20;
+	    goto on_return;
+	}
+    }
+
+    /* Connect most of the ports to each other, with various levels */
+    for (i=0; i<=PORT_CNT; ++i) {
+	for (j=0; j<=PORT_CNT; ++j) {
+	    if (i == j || (i * 7 + j * 3) % 5 == 0)
+		continue;
+
+	    status = pjmedia_conf_connect_port(conf, slot[i], slot[j], 0);
+	    if (status != PJ_SUCCESS) {
+		rc = -30;
+		goto on_return;
+	    }
+	}
+	pjmedia_conf_adjust_rx_level(conf, slot[i], (int)(i % 4) * 20 - 20);
+	pjmedia_conf_adjust_tx_level(conf, slot[i], (int)(i % 3) * 30 - 30);
+    }
+
+    for (i=0; i<TICKS; ++i) {
+	pjmedia_frame frame;
+
+	frame.buf = buf;
+	tp_fill(tp[0], &frame);
+	if (frame.type == PJMEDIA_FRAME_TYPE_NONE) {
+	    /* Port zero always gets full frames from the sound device */
+	    pjmedia_zero_samples(buf, SPF);
+	    frame.size = SPF * 2;
+	}
+	pjmedia_port_put_frame(master, &frame);
+
+	frame.buf = buf;
+	frame.size = SPF * 2;
+	status = pjmedia_port_get_frame(master, &frame);
+	if (status != PJ_SUCCESS) {
+	    rc = -40;
+	    goto on_return;
+	}
+	tp_sum(tp[0], &frame);
+    }
+
+    for (i=0; i<=PORT_CNT; ++i) {
+	res->checksum[i] = tp[i]->checksum;
+	res->put_cnt[i] = tp[i]->put_cnt;
+    }
+
+on_return:
+    pjmedia_conf_destroy(conf);
+    return rc;
+}
+
+/*
+ * Mixing with worker threads must give exactly the same output as mixing
+ * in the clock thread alone.
+ */
+static int worker_test(pj_pool_t *pool)
+{
+    static const unsigned workers[] = { 1, 2, 3, 5 };
+    static const unsigned speakers[] = { 0, 3 };
+    struct run_result ref, res;
+    unsigned i, j, k;
+    int rc;
+
+    for (k=0; k<PJ_ARRAY_SIZE(speakers); ++k) {
+	PJ_LOG(3,(THIS_FILE, "  worker threads, %u active speakers",
+		  speakers[k]));
+
+	pj_bzero(&ref, sizeof(ref));
+	rc = mix_run(pool, 0, speakers[k], &ref);
+	if (rc != 0)
+	    return rc;
+
+	for (j=0; j<=PORT_CNT; ++j) {
+	    if (ref.put_cnt[j] != TICKS) {
+		PJ_LOG(3,(THIS_FILE, "  error: port %u got %u frames instead "
+			  "of %u", j, ref.put_cnt[j], TICKS));
+		return -90;
+	    }
+	}
+
+	for (i=0; i<PJ_ARRAY_SIZE(workers); ++i) {
+	    pj_bzero(&res, sizeof(res));
+	    rc = mix_run(pool, workers[i], speakers[k], &res);
+	    if (rc != 0)
+		return rc;
+
+	    for (j=0; j<=PORT_CNT; ++j) {
+		if (res.put_cnt[j] != ref.put_cnt[j] ||
+		    res.checksum[j] != ref.checksum[j])
+		{
+		    PJ_LOG(3,(THIS_FILE, "  error: port %u output differs "
+			      "with %u worker threads", j, workers[i]));
+		    return -100;
+		}
+	    }
+	}
+    }
+
+    return 0;
+}
+
+
+/* Check the signal which the port got in the last tick. */
+static int check_signal(struct test_port *tp, int expected)
+{
+    int sample = tp->last_type==PJMEDIA_FRAME_TYPE_AUDIO ? tp->last_sample:0;
+
+    if (sample != expected) {
+	PJ_LOG(3,(THIS_FILE, "  error: port %u got %d instead of %d",
+		  tp->id, sample, expected));
+	return -1;
+    }
+    return 0;
+}
+
+/* Drive one clock tick of a bridge without sound device. */
+static pj_status_t tick_run(pjmedia_conf *conf)
+{
+    pjmedia_port *master = pjmedia_conf_get_master_port(conf);
+    pj_int16_t buf[SPF];
+    pjmedia_frame frame;
+
+    pjmedia_zero_samples(buf, SPF);
+    frame.type = PJMEDIA_FRAME_TYPE_AUDIO;
+    frame.buf = buf;
+    frame.size = SPF * 2;
+    pjmedia_port_put_frame(master, &frame);
+
+    frame.buf = buf;
+    frame.size = SPF * 2;
+    return pjmedia_port_get_frame(master, &frame);
+}
+
+/* Ports of the tick test. */
+enum { TT_A, TT_B, TT_CTL, TT_D, TT_CNT };
+
+struct tick_test
+{
+    pjmedia_conf	*conf;
+    pj_pool_t		*pool;
+    struct test_port	*tp[TT_CNT];
+    unsigned		 slot[TT_CNT];
+    unsigned		 tick;
+    int			 rc;
+};
+
+/*
+ * Called by the bridge while reading the control port, i.e. in the middle
+ * of the clock tick, to change the bridge as a port callback would.
+ */
+static void tick_test_on_get(struct test_port *ctl)
+{
+    struct tick_test *tt = (struct tick_test*) ctl->user_data;
+    pjmedia_conf_port_info info;
+    pj_status_t status;
+
+    ++tt->tick;
+    if (tt->rc)
+	return;
+
+    if (tt->tick == 2) {
+	/* Connect A to B with half the level, and add D which talks to B
+	 * but isn't read yet.
+	 */
+	status = pjmedia_conf_connect_port(tt->conf, tt->slot[TT_A],
+					   tt->slot[TT_B], 0);
+	if (status == PJ_SUCCESS)
+	    status = pjmedia_conf_adjust_rx_level(tt->conf, tt->slot[TT_A],
+						  -64);
+	if (status != PJ_SUCCESS) {
+	    tt->rc = -400;
+	    return;
+	}
+
+	tt->tp[TT_D] = create_port(tt->pool, TT_D);
+	tt->tp[TT_D]->level = 200;
+	status = pjmedia_conf_add_port(tt->conf, tt->pool,
+				       &tt->tp[TT_D]->base, NULL,
+				       &tt->slot[TT_D]);
+	if (status != PJ_SUCCESS) {
+	    tt->rc = -410;
+	    return;
+	}
+
+	/* The slot of the queued port is usable right away */
+	status = pjmedia_conf_connect_port(tt->conf, tt->slot[TT_D],
+					   tt->slot[TT_B], 0);
+	if (status == PJ_SUCCESS) {
+	    status = pjmedia_conf_configure_port(tt->conf, tt->slot[TT_D],
+						 PJMEDIA_PORT_NO_CHANGE,
+						 PJMEDIA_PORT_DISABLE);
+	}
+	if (status == PJ_SUCCESS)
+	    status = pjmedia_conf_get_port_info(tt->conf, tt->slot[TT_D],
+						&info);
+	if (status != PJ_SUCCESS) {
+	    tt->rc = -420;
+	    return;
+	}
+
+	/* The running tick still uses the old connections and levels */
+	status = pjmedia_conf_get_port_info(tt->conf, tt->slot[TT_B], &info);
+	if (status != PJ_SUCCESS || info.transmitter_cnt != 0) {
+	    tt->rc = -430;
+	    return;
+	}
+	status = pjmedia_conf_get_port_info(tt->conf, tt->slot[TT_A], &info);
+	if (status != PJ_SUCCESS || info.rx_adj_level != 0) {
+	    tt->rc = -440;
+	    return;
+	}
+
+    } else if (tt->tick == 4) {
+	/* Start reading D */
+	status = pjmedia_conf_configure_port(tt->conf, tt->slot[TT_D],
+					     PJMEDIA_PORT_NO_CHANGE,
+					     PJMEDIA_PORT_ENABLE);
+	if (status != PJ_SUCCESS) {
+	    tt->rc = -450;
+	    return;
+	}
+
+    } else if (tt->tick == 6) {
+	/* Mute B, and remove D, which then can't be changed anymore */
+	status = pjmedia_conf_configure_port(tt->conf, tt->slot[TT_B],
+					     PJMEDIA_PORT_MUTE,
+					     PJMEDIA_PORT_NO_CHANGE);
+	if (status == PJ_SUCCESS)
+	    status = pjmedia_conf_remove_port(tt->conf, tt->slot[TT_D]);
+	if (status != PJ_SUCCESS) {
+	    tt->rc = -460;
+	    return;
+	}
+	if (pjmedia_conf_configure_port(tt->conf, tt->slot[TT_D],
+					PJMEDIA_PORT_ENABLE,
+					PJMEDIA_PORT_ENABLE) == PJ_SUCCESS ||
+	    pjmedia_conf_adjust_tx_level(tt->conf, tt->slot[TT_D],
+					 0) == PJ_SUCCESS ||
+	    pjmedia_conf_get_port_info(tt->conf, tt->slot[TT_D],
+				       &info) == PJ_SUCCESS)
+	{
+	    tt->rc = -470;
+	    return;
+	}
+    }
+}
+
+/*
+ * Ports, connections, settings and levels changed during the clock tick
+ * take effect when the tick ends.
+ */
+static int tick_test(pj_pool_t *pool)
+{
+    /* What B gets after each tick */
+    static const int expected[] = { 0, 0, 0, 500, 500, 700, 700, 0, 0 };
+    pjmedia_conf_param param;
+    struct tick_test tt;
+    pjmedia_conf_port_info info;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  changes during the clock tick"));
+
+    pj_bzero(&tt, sizeof(tt));
+    tt.pool = pool;
+
+    pjmedia_conf_param_default(&param);
+    param.max_slots = TT_CNT + 1;
+    param.sampling_rate = CLOCK_RATE;
+    param.channel_count = 1;
+    param.samples_per_frame = SPF;
+    param.bits_per_sample = 16;
+    param.options = PJMEDIA_CONF_NO_DEVICE;
+
+    status = pjmedia_conf_create2(pool, &param, &tt.conf);
+    if (status != PJ_SUCCESS) {
+	app_perror(status, "  error creating conference bridge");
+	return -380;
+    }
+
+    /* The control port is read only when it has a listener */
+    for (i=TT_A; i<=TT_CTL; ++i) {
+	tt.tp[i] = create_port(pool, i);
+	status = pjmedia_conf_add_port(tt.conf, pool, &tt.tp[i]->base, NULL,
+				       &tt.slot[i]);
+	if (status != PJ_SUCCESS) {
+	    tt.rc = -390;
+	    goto on_return;
+	}
+    }
+    tt.tp[TT_A]->level = 1000;
+    tt.tp[TT_CTL]->level = 1;
+    tt.tp[TT_CTL]->on_get = &tick_test_on_get;
+    tt.tp[TT_CTL]->user_data = &tt;
+    pjmedia_conf_connect_port(tt.conf, tt.slot[TT_CTL], 0, 0);
+
+    for (i=1; i<PJ_ARRAY_SIZE(expected); ++i) {
+	status = tick_run(tt.conf);
+	if (status != PJ_SUCCESS && tt.rc == 0)
+	    tt.rc = -480;
+	if (tt.rc)
+	    goto on_return;
+
+	if (check_signal(tt.tp[TT_B], expected[i])) {
+	    PJ_LOG(3,(THIS_FILE, "  error: wrong signal after tick %u", i));
+	    tt.rc = -490;
+	    goto on_return;
+	}
+    }
+
+    /* Everything queued has been applied */
+    status = pjmedia_conf_get_port_info(tt.conf, tt.slot[TT_B], &info);
+    if (status != PJ_SUCCESS || info.transmitter_cnt != 1 ||
+	info.tx_setting != PJMEDIA_PORT_MUTE ||
+	pjmedia_conf_get_port_count(tt.conf) != TT_CTL + 2)
+    {
+	tt.rc = -500;
+	goto on_return;
+    }
+    status = pjmedia_conf_get_port_info(tt.conf, tt.slot[TT_A], &info);
+    if (status != PJ_SUCCESS || info.rx_adj_level != -64) {
+	tt.rc = -510;
+	goto on_return;
+    }
+
+on_return:
+    pjmedia_conf_destroy(tt.conf);
+    return tt.rc;
+}
+
+
+/* Run some ticks of the group. */
+static void group_run(pjmedia_conf_group *group, pj_timestamp *ts,
+		      unsigned ticks)
+{
+    while (ticks--) {
+	pjmedia_conf_group_tick(group, ts);
+	ts->u64 += SPF;
+    }
+}
+
+/*
+ * Connect, mix and disconnect ports placed in different shards of a
+ * conference bridge group.
+ */
+static int group_test(pj_pool_t *pool, unsigned worker_threads)
+{
+    enum { A, B, C, D, E, CNT };
+    pjmedia_conf_group_param param;
+    pjmedia_conf_group *group;
+    struct test_port *tp[CNT];
+    pjmedia_conf *conf[CNT];
+    unsigned i, slot[CNT];
+    pj_timestamp ts;
+    int rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  group with %u worker threads", worker_threads));
+
+    pjmedia_conf_group_param_default(&param);
+    param.shard_cnt = 2;
+    param.conf_param.max_slots = 8;
+    param.conf_param.sampling_rate = CLOCK_RATE;
+    param.conf_param.channel_count = 1;
+    param.conf_param.samples_per_frame = SPF;
+    param.conf_param.bits_per_sample = 16;
+    param.worker_threads = worker_threads;
+    param.no_clock = PJ_TRUE;
+
+    status = pjmedia_conf_group_create(pool, &param, &group);
+    if (status != PJ_SUCCESS) {
+	app_perror(status, "  error creating conference bridge group");
+	return -200;
+    }
+
+    /* A and C are in the first conference, B, D and E in the second.
+     * A and E are talking.
+     */
+    for (i=0; i<CNT; ++i) {
+	static const pj_uint32_t affinity[CNT] = { 1, 2, 1, 2, 2 };
+
+	tp[i] = create_port(pool, i);
+	status = pjmedia_conf_group_add_port(group, pool, &tp[i]->base, NULL,
+					     affinity[i], &slot[i]);
+	if (status == PJ_SUCCESS) {
+	    status = pjmedia_conf_group_get_conf(group, slot[i], &conf[i],
+						 NULL);
+	}
+	if (status != PJ_SUCCESS) {
+	    rc = -210;
+	    goto on_return;
+	}
+    }
+    tp[A]->level = 1000;
+    tp[E]->level = 300;
+
+    if (conf[A] != conf[C] || conf[B] != conf[D] || conf[B] != conf[E] ||
+	conf[A] == conf[B])
+    {
+	PJ_LOG(3,(THIS_FILE, "  error: ports are not placed by affinity"));
+	rc = -220;
+	goto on_return;
+    }
+
+    /* A talks to C in its own shard, and to B and D in the other shard,
+     * which share one link.
+     */
+    status = pjmedia_conf_group_connect_port(group, slot[A], slot[C]);
+    if (status != PJ_SUCCESS || pjmedia_conf_group_get_link_count(group)) {
+	rc = -230;
+	goto on_return;
+    }
+    status = pjmedia_conf_group_connect_port(group, slot[A], slot[B]);
+    if (status == PJ_SUCCESS)
+	status = pjmedia_conf_group_connect_port(group, slot[A], slot[D]);
+    if (status != PJ_SUCCESS || pjmedia_conf_group_get_link_count(group)!=1) {
+	rc = -240;
+	goto on_return;
+    }
+
+    /* E talks to B, which then hears both */
+    status = pjmedia_conf_group_connect_port(group, slot[E], slot[B]);
+    if (status != PJ_SUCCESS) {
+	rc = -250;
+	goto on_return;
+    }
+
+    ts.u64 = 0;
+    group_run(group, &ts, 4);
+    if (check_signal(tp[C], 1000) || check_signal(tp[D], 1000) ||
+	check_signal(tp[B], 1300) || check_signal(tp[A], 0))
+    {
+	rc = -260;
+	goto on_return;
+    }
+
+    /* The link stays while D still uses it */
+    status = pjmedia_conf_group_disconnect_port(group, slot[A], slot[B]);
+    if (status != PJ_SUCCESS || pjmedia_conf_group_get_link_count(group)!=1) {
+	rc = -270;
+	goto on_return;
+    }
+    group_run(group, &ts, 4);
+    if (check_signal(tp[B], 300) || check_signal(tp[D], 1000)) {
+	rc = -280;
+	goto on_return;
+    }
+
+    status = pjmedia_conf_group_disconnect_port(group, slot[A], slot[D]);
+    if (status != PJ_SUCCESS || pjmedia_conf_group_get_link_count(group)) {
+	rc = -290;
+	goto on_return;
+    }
+    group_run(group, &ts, 4);
+    if (check_signal(tp[D], 0) || check_signal(tp[C], 1000)) {
+	rc = -300;
+	goto on_return;
+    }
+
+    /* Removing the source removes its links */
+    status = pjmedia_conf_group_connect_port(group, slot[A], slot[B]);
+    if (status != PJ_SUCCESS || pjmedia_conf_group_get_link_count(group)!=1) {
+	rc = -310;
+	goto on_return;
+    }
+    group_run(group, &ts, 4);
+    if (check_signal(tp[B], 1300)) {
+	rc = -320;
+	goto on_return;
+    }
+
+    status = pjmedia_conf_group_remove_port(group, slot[A]);
+    if (status != PJ_SUCCESS || pjmedia_conf_group_get_link_count(group)) {
+	rc = -330;
+	goto on_return;
+    }
+    group_run(group, &ts, 4);
+    if (check_signal(tp[B], 300) || check_signal(tp[C], 0)) {
+	rc = -340;
+	goto on_return;
+    }
+
+on_return:
+    pjmedia_conf_group_destroy(group);
+    return rc;
+}
+
+
+int conf_test(void)
+{
+    pj_pool_t *pool;
+    int rc;
+
+    pool = pj_pool_create(mem, "conftest", 4000, 4000, NULL);
+
+    rc = worker_test(pool);
+    if (rc == 0)
+	rc = tick_test(pool);
+    if (rc == 0)
+	rc = group_test(pool, 0);
+    if (rc == 0)
+	rc = group_test(pool, 2);
+
+    pj_pool_release(pool);
+    return rc;
+}
@@ -0,0 +1,333 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE   "frame_pool_test.c"
+
+#define CLOCK_RATE  8000
+#define SPF	    160
+#define SIGNATURE   PJMEDIA_SIG_CLASS_PORT_AUD('F','P')
+
+
+/* Test port: the source returns its frame buffer by reference, and the
+ * sink remembers the last frame buffer it was given.
+ */
+struct test_port
+{
+    pjmedia_port	 base;
+    pjmedia_frame_buf	*fbuf;
+    void		*last_buf;
+    unsigned		 put_cnt;
+};
+
+static pj_status_t tp_get_frame_buf(pjmedia_port *this_port,
+				    pjmedia_frame *frame,
+				    pjmedia_frame_buf **p_fbuf)
+{
+    struct test_port *tp = (struct test_port*) this_port;
+
+    pjmedia_frame_buf_add_ref(tp->fbuf);
+    frame->type = PJMEDIA_FRAME_TYPE_AUDIO;
+    frame->buf = tp->fbuf->buf;
+    frame->size = SPF * 2;
+    *p_fbuf = tp->fbuf;
+    return PJ_SUCCESS;
+}
+
+static pj_status_t tp_get_frame(pjmedia_port *this_port,
+				pjmedia_frame *frame)
+{
+    struct test_port *tp = (struct test_port*) this_port;
+
+    pj_memcpy(frame->buf, tp->fbuf->buf, SPF * 2);
+    frame->type = PJMEDIA_FRAME_TYPE_AUDIO;
+    frame->size = SPF * 2;
+    return PJ_SUCCESS;
+}
+
+static pj_status_t tp_put_frame_buf(pjmedia_port *this_port,
+				    pjmedia_frame *frame,
+				    pjmedia_frame_buf *fbuf)
+{
+    struct test_port *tp = (struct test_port*) this_port;
+
+    if (frame->type == PJMEDIA_FRAME_TYPE_AUDIO) {
+	if (tp->fbuf)
+	    pjmedia_frame_buf_dec_ref(tp->fbuf);
+	pjmedia_frame_buf_add_ref(fbuf);
+	tp->fbuf = fbuf;
+	tp->last_buf = frame->buf;
+	++tp->put_cnt;
+    }
+    return PJ_SUCCESS;
+}
+
+static pj_status_t tp_put_frame(pjmedia_port *this_port,
+				pjmedia_frame *frame)
+{
+    struct test_port *tp = (struct test_port*) this_port;
+
+    if (frame->type == PJMEDIA_FRAME_TYPE_AUDIO) {
+	tp->last_buf = frame->buf;
+	++tp->put_cnt;
+    }
+    return PJ_SUCCESS;
+}
+
+static void tp_init(struct test_port *tp)
+{
+    pj_str_t name = pj_str("test");
+
+    pj_bzero(tp, sizeof(*tp));
+    pjmedia_port_info_init(&tp->base.info, &name, SIGNATURE, CLOCK_RATE,
+			   1, 16, SPF);
+}
+
+
+/* Allocation, reuse and reference counting */
+static int test_pool(pj_pool_t *pool)
+{
+    pjmedia_frame_pool *fpool;
+    pjmedia_frame_buf *b1, *b2, *b3;
+    pj_status_t status;
+    int rc = 0;
+
+    status = pjmedia_frame_pool_create(pool, NULL, SPF * 2, 2, &fpool);
+    if (status != PJ_SUCCESS)
+	return -10;
+
+    if (pjmedia_frame_pool_alloc(fpool, &b1) != PJ_SUCCESS ||
+	pjmedia_frame_pool_alloc(fpool, &b2) != PJ_SUCCESS)
+    {
+	rc = -20;
+	goto on_return;
+    }
+    if (b1 == b2 || b1->size != SPF * 2 || pj_atomic_get(b1->ref_cnt) != 1) {
+	rc = -30;
+	goto on_return;
+    }
+
+    /* The pool is exhausted */
+    if (pjmedia_frame_pool_alloc(fpool, &b3) != PJ_ETOOMANY) {
+	rc = -40;
+	goto on_return;
+    }
+
+    /* The buffer is returned with the last reference */
+    pjmedia_frame_buf_add_ref(b1);
+    pjmedia_frame_buf_dec_ref(b1);
+    if (pjmedia_frame_pool_alloc(fpool, &b3) != PJ_ETOOMANY) {
+	rc = -50;
+	goto on_return;
+    }
+    pjmedia_frame_buf_dec_ref(b1);
+    if (pjmedia_frame_pool_alloc(fpool, &b3) != PJ_SUCCESS || b3 != b1) {
+	rc = -60;
+	goto on_return;
+    }
+
+    pjmedia_frame_buf_dec_ref(b2);
+    pjmedia_frame_buf_dec_ref(b3);
+
+on_return:
+    pjmedia_frame_pool_destroy(fpool);
+    return rc;
+}
+
+
+/* Frames are passed by reference through the bidirectional port, and
+ * to ports which don't take references.
+ */
+static int test_forward(pj_pool_t *pool)
+{
+    pjmedia_frame_pool *fpool;
+    struct test_port src, ref_sink, sink;
+    pjmedia_port *bidir;
+    pjmedia_frame frame;
+    pjmedia_frame_buf *fbuf;
+    pj_status_t status;
+    int rc = 0;
+
+    status = pjmedia_frame_pool_create(pool, NULL, SPF * 2, 0, &fpool);
+    if (status != PJ_SUCCESS)
+	return -100;
+
+    tp_init(&src);
+    src.base.get_frame = &tp_get_frame;
+    src.base.get_frame_buf = &tp_get_frame_buf;
+    pjmedia_frame_pool_alloc(fpool, &src.fbuf);
+    pj_bzero(src.fbuf->buf, SPF * 2);
+
+    tp_init(&ref_sink);
+    ref_sink.base.put_frame = &tp_put_frame;
+    ref_sink.base.put_frame_buf = &tp_put_frame_buf;
+
+    tp_init(&sink);
+    sink.base.put_frame = &tp_put_frame;
+
+    pjmedia_bidirectional_port_create(pool, &src.base, &ref_sink.base,
+				      &bidir);
+
+    /* Get by reference */
+    pj_bzero(&frame, sizeof(frame));
+    status = pjmedia_port_get_frame_buf(bidir, &frame, &fbuf);
+    if (status != PJ_SUCCESS || fbuf != src.fbuf || frame.buf != fbuf->buf) {
+	rc = -110;
+	goto on_return;
+    }
+
+    /* Put by reference, the sink keeps the same buffer */
+    pjmedia_port_put_frame_buf(bidir, &frame, fbuf);
+    if (ref_sink.fbuf != fbuf || ref_sink.last_buf != fbuf->buf) {
+	rc = -120;
+	goto on_return;
+    }
+
+    /* Put to a port which doesn't take references */
+    pjmedia_port_put_frame_buf(&sink.base, &frame, fbuf);
+    if (sink.put_cnt != 1 || sink.last_buf != fbuf->buf) {
+	rc = -130;
+	goto on_return;
+    }
+    pjmedia_frame_buf_dec_ref(fbuf);
+
+    /* Get from a port which doesn't return references */
+    if (pjmedia_port_get_frame_buf(&sink.base, &frame, &fbuf) != PJ_ENOTSUP
+	|| fbuf != NULL)
+    {
+	rc = -140;
+	goto on_return;
+    }
+
+    /* The bidirectional port only takes references if its sink does */
+    pjmedia_bidirectional_port_create(pool, &src.base, &sink.base, &bidir);
+    if (bidir->put_frame_buf != NULL || bidir->get_frame_buf == NULL) {
+	rc = -150;
+	goto on_return;
+    }
+
+on_return:
+    if (ref_sink.fbuf)
+	pjmedia_frame_buf_dec_ref(ref_sink.fbuf);
+    pjmedia_frame_buf_dec_ref(src.fbuf);
+    pjmedia_frame_pool_destroy(fpool);
+    return rc;
+}
+
+
+/* The conference bridge mixes directly to the frame buffer given to the
+ * ports which take references.
+ */
+static int test_conf(pj_pool_t *pool)
+{
+    pjmedia_frame_pool *fpool;
+    pjmedia_conf *conf;
+    struct test_port src, sink;
+    pjmedia_port *master;
+    pj_int16_t buf[SPF];
+    pjmedia_frame frame;
+    unsigned src_slot, sink_slot, i;
+    pj_status_t status;
+    int rc = 0;
+
+    status = pjmedia_frame_pool_create(pool, NULL, SPF * 2, 0, &fpool);
+    if (status != PJ_SUCCESS)
+	return -200;
+
+    status = pjmedia_conf_create(pool, 4, CLOCK_RATE, 1, SPF, 16,
+				 PJMEDIA_CONF_NO_DEVICE, &conf);
+    if (status != PJ_SUCCESS) {
+	pjmedia_frame_pool_destroy(fpool);
+	return -210;
+    }
+
+    tp_init(&src);
+    src.base.get_frame = &tp_get_frame;
+    src.base.get_frame_buf = &tp_get_frame_buf;
+    pjmedia_frame_pool_alloc(fpool, &src.fbuf);
+    for (i=0; i<SPF; ++i)
+	((pj_int16_t*)src.fbuf->buf)[i] = (pj_int16_t)(i * 100 - 8000);
+
+    tp_init(&sink);
+    sink.base.put_frame = &tp_put_frame;
+    sink.base.put_frame_buf = &tp_put_frame_buf;
+
+    pjmedia_conf_add_port(conf, pool, &src.base, NULL, &src_slot);
+    pjmedia_conf_add_port(conf, pool, &sink.base, NULL, &sink_slot);
+    pjmedia_conf_connect_port(conf, src_slot, sink_slot, 0);
+
+    master = pjmedia_conf_get_master_port(conf);
+    pj_bzero(&frame, sizeof(frame));
+    for (i=0; i<3; ++i) {
+	frame.buf = buf;
+	frame.size = sizeof(buf);
+	pjmedia_port_get_frame(master, &frame);
+    }
+
+    if (sink.put_cnt != 3 || !sink.fbuf || sink.last_buf != sink.fbuf->buf) {
+	rc = -220;
+	goto on_return;
+    }
+    if (pj_memcmp(sink.fbuf->buf, src.fbuf->buf, SPF * 2) != 0) {
+	rc = -230;
+	goto on_return;
+    }
+
+    /* The bridge holds the source frame by reference until the next
+     * tick, instead of copying it.
+     */
+    if (pj_atomic_get(src.fbuf->ref_cnt) != 2) {
+	rc = -240;
+	goto on_return;
+    }
+
+on_return:
+    pjmedia_conf_remove_port(conf, sink_slot);
+    pjmedia_conf_remove_port(conf, src_slot);
+    if (sink.fbuf)
+	pjmedia_frame_buf_dec_ref(sink.fbuf);
+    pjmedia_conf_destroy(conf);
+    pjmedia_frame_buf_dec_ref(src.fbuf);
+    pjmedia_frame_pool_destroy(fpool);
+    return rc;
+}
+
+
+int frame_pool_test(void)
+{
+    pj_pool_t *pool;
+    int rc;
+
+    pool = pj_pool_create(mem, "frame_pool", 4000, 4000, NULL);
+
+    PJ_LOG(3,(THIS_FILE, "  testing frame pool"));
+    rc = test_pool(pool);
+    if (rc == 0) {
+	PJ_LOG(3,(THIS_FILE, "  testing forwarding by reference"));
+	rc = test_forward(pool);
+    }
+    if (rc == 0) {
+	PJ_LOG(3,(THIS_FILE, "  testing conference bridge"));
+	rc = test_conf(pool);
+    }
+
+    pj_pool_release(pool);
+    return rc;
+}
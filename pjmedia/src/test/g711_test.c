@@ -0,0 +1,147 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE   "g711_test.c"
+
+/* All 16bit values, plus some to leave remaining samples after the
+ * vector steps.
+ */
+#define PCM_COUNT   (65536 + 13)
+#define STREAMS	    3
+
+
+/* Compare the block conversions of the implementation against the
+ * per sample conversions, for every input value.
+ */
+static int test_impl(pj_pool_t *pool)
+{
+    pj_int16_t *pcm, *out;
+    pj_uint8_t *law, *codes;
+    pj_uint8_t *bdst[STREAMS];
+    const pj_int16_t *bsrc[STREAMS];
+    pj_int16_t *bpcm[STREAMS];
+    const pj_uint8_t *blaw[STREAMS];
+    unsigned i, len;
+
+    pcm = (pj_int16_t*) pj_pool_alloc(pool, PCM_COUNT * sizeof(pj_int16_t));
+    out = (pj_int16_t*) pj_pool_alloc(pool, PCM_COUNT * sizeof(pj_int16_t));
+    law = (pj_uint8_t*) pj_pool_alloc(pool, PCM_COUNT);
+    codes = (pj_uint8_t*) pj_pool_alloc(pool, 256 + 13);
+
+    for (i=0; i<PCM_COUNT; ++i)
+	pcm[i] = (pj_int16_t)(i & 0xFFFF);
+    for (i=0; i<256+13; ++i)
+	codes[i] = (pj_uint8_t)i;
+
+    /* Encode */
+    pjmedia_ulaw_encode(law, pcm, PCM_COUNT);
+    for (i=0; i<PCM_COUNT; ++i) {
+	if (law[i] != pjmedia_linear2ulaw(pcm[i]))
+	    return -10;
+    }
+
+    pjmedia_alaw_encode(law, pcm, PCM_COUNT);
+    for (i=0; i<PCM_COUNT; ++i) {
+	if (law[i] != pjmedia_linear2alaw(pcm[i]))
+	    return -20;
+    }
+
+    /* Decode */
+    pjmedia_ulaw_decode(out, codes, 256+13);
+    for (i=0; i<256+13; ++i) {
+	if (out[i] != (pj_int16_t)pjmedia_ulaw2linear(codes[i]))
+	    return -30;
+    }
+
+    pjmedia_alaw_decode(out, codes, 256+13);
+    for (i=0; i<256+13; ++i) {
+	if (out[i] != (pj_int16_t)pjmedia_alaw2linear(codes[i]))
+	    return -40;
+    }
+
+    /* Batches of streams with different contents, with lengths that
+     * leave remaining samples after the vector steps.
+     */
+    for (len=0; len<=67; len+=67) {
+	for (i=0; i<STREAMS; ++i) {
+	    bsrc[i] = pcm + i * 20000;
+	    bdst[i] = law + i * 100;
+	    bpcm[i] = out + i * 100;
+	    blaw[i] = codes + i * 70;
+	}
+
+	pjmedia_g711_encode_batch(PJMEDIA_G711_ALAW, bdst, bsrc, STREAMS,
+				  len);
+	for (i=0; i<STREAMS * 100; ++i) {
+	    if (i % 100 < len &&
+		law[i] != pjmedia_linear2alaw(pcm[i/100*20000 + i%100]))
+	    {
+		return -50;
+	    }
+	}
+
+	pjmedia_g711_decode_batch(PJMEDIA_G711_ULAW, bpcm, blaw, STREAMS,
+				  len);
+	for (i=0; i<STREAMS * 100; ++i) {
+	    if (i % 100 < len &&
+		out[i] != (pj_int16_t)
+			  pjmedia_ulaw2linear(codes[i/100*70 + i%100]))
+	    {
+		return -60;
+	    }
+	}
+    }
+
+    return 0;
+}
+
+int g711_test(void)
+{
+    static const pjmedia_mix_impl impls[] =
+    {
+	PJMEDIA_MIX_IMPL_SCALAR,
+	PJMEDIA_MIX_IMPL_SSE2,
+	PJMEDIA_MIX_IMPL_AVX2,
+	PJMEDIA_MIX_IMPL_NEON
+    };
+    pj_pool_t *pool;
+    unsigned i;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "g711", 4000, 4000, NULL);
+
+    for (i=0; i<PJ_ARRAY_SIZE(impls) && rc==0; ++i) {
+	if (pjmedia_mix_set_impl(impls[i]) != PJ_SUCCESS)
+	    continue;
+
+	PJ_LOG(3,(THIS_FILE, "  testing %s", pjmedia_mix_impl_name(impls[i])));
+	rc = test_impl(pool);
+	if (rc != 0) {
+	    PJ_LOG(3,(THIS_FILE, "  %s differs from per sample conversion, "
+		      "rc=%d", pjmedia_mix_impl_name(impls[i]), rc));
+	    rc -= 100 * i;
+	}
+    }
+
+    pjmedia_mix_set_impl(PJMEDIA_MIX_IMPL_AUTO);
+    pj_pool_release(pool);
+    return rc;
+}
@@ -31,6 +31,10 @@
 //#define REPORT
 //#define PRINT_COMMENT
 
+#define BENCH_STREAMS	    50
+#define BENCH_PACKETS	    3000
+#define BENCH_JITTER	    4
+
 typedef struct test_param_t {
     pj_bool_t adaptive;
     unsigned init_prefetch;
@@ -165,6 +169,335 @@ static pj_bool_t process_test_data(char data, pjmedia_jbuf *jb,
     return PJ_TRUE;
 }
 
+#ifdef REPORT
+/* Measure the cost of put/get and the memory of many jitter buffers.
+ * Every frame time one packet arrives, reordered within a window of
+ * BENCH_JITTER packets, and one frame is taken out. The jitter buffers
+ * run side by side, and the memory is the size of the pool blocks in use
+ * by all of them, including the shared slab if any.
+ */
+static void jbuf_bench(const char *title, unsigned frame_size,
+		       unsigned min_len, unsigned max_count,
+		       pj_bool_t shared)
+{
+    pj_str_t jb_name = {"JBBENCH", 7};
+    pj_caching_pool cp;
+    pj_pool_t *pool;
+    pjmedia_jb_slab *slab = NULL;
+    pjmedia_jbuf *jb[BENCH_STREAMS];
+    pj_uint8_t payload[PJMEDIA_MAX_MRU];
+    unsigned order[BENCH_JITTER];
+    pj_timestamp zero, t0, t1, elapsed;
+    pj_size_t mem_used = 0;
+    unsigned seq, ops = 0;
+    unsigned i;
+
+    pj_assert(frame_size <= sizeof(payload));
+    pj_memset(payload, 0x55, frame_size);
+    zero.u64 = elapsed.u64 = 0;
+    pj_srand(0);
+    pj_caching_pool_init(&cp, NULL, 0);
+
+    pool = pj_pool_create(&cp.factory, "JBBENCH", 512, 512, NULL);
+    if (shared)
+	pjmedia_jb_slab_create(pool, &slab);
+    for (i = 0; i < BENCH_STREAMS; ++i) {
+	pjmedia_jbuf_create2(pool, &jb_name, frame_size, JB_PTIME,
+			     max_count, slab, &jb[i]);
+	pjmedia_jbuf_set_adaptive(jb[i], 0, 1, max_count * 4 / 5);
+    }
+
+    for (seq = 0; seq < BENCH_PACKETS; ++seq) {
+	unsigned pos = seq % BENCH_JITTER;
+
+	/* Shuffle the arrival order of the next window */
+	if (pos == 0) {
+	    for (i = 0; i < BENCH_JITTER; ++i)
+		order[i] = i;
+	    for (i = BENCH_JITTER - 1; i > 0; --i) {
+		unsigned j = pj_rand() % (i + 1);
+		unsigned tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	    }
+	}
+
+	pj_get_timestamp(&t0);
+	for (i = 0; i < BENCH_STREAMS; ++i) {
+	    unsigned len = min_len + pj_rand() % (frame_size-min_len+1);
+	    char frame_type;
+	    pj_size_t size;
+
+	    pjmedia_jbuf_put_frame(jb[i], payload, len,
+				   seq - pos + order[pos]);
+	    size = frame_size;
+	    pjmedia_jbuf_get_frame2(jb[i], payload, &size, &frame_type, NULL);
+	    ops += 2;
+	}
+	pj_get_timestamp(&t1);
+
+	pj_sub_timestamp(&t1, &t0);
+	pj_add_timestamp(&elapsed, &t1);
+
+	if (cp.used_size > mem_used)
+	    mem_used = cp.used_size;
+    }
+
+    printf("%s: %u ns/op, %u bytes/jbuf\n", title,
+	   pj_elapsed_nanosec(&zero, &elapsed) / ops,
+	   (unsigned)(mem_used / BENCH_STREAMS));
+
+    for (i = 0; i < BENCH_STREAMS; ++i)
+	pjmedia_jbuf_destroy(jb[i]);
+    if (slab)
+	pjmedia_jb_slab_destroy(slab);
+    pj_pool_release(pool);
+    pj_caching_pool_destroy(&cp);
+}
+#endif
+
+/* Jitter buffers sharing a slab keep their frames intact, and give the
+ * memory back as the frames leave the buffers.
+ */
+static int jbuf_slab_test(void)
+{
+    enum { JB_CNT = 3, FRAME_SIZE = 160, MAX_COUNT = 25 };
+    pj_str_t jb_name = {"JBSLAB", 6};
+    pjmedia_jbuf *jb[JB_CNT], *big_jb;
+    pjmedia_jb_slab *slab;
+    pjmedia_jb_slab_info info;
+    pj_uint8_t frame[FRAME_SIZE];
+    pj_pool_t *pool;
+    unsigned i, seq;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "JBSLAB", 1000, 1000, NULL);
+    if (pjmedia_jb_slab_create(pool, &slab) != PJ_SUCCESS) {
+	pj_pool_release(pool);
+	return -200;
+    }
+
+    for (i = 0; i < JB_CNT; ++i) {
+	pjmedia_jbuf_create2(pool, &jb_name, FRAME_SIZE, JB_PTIME,
+			     MAX_COUNT, slab, &jb[i]);
+	pjmedia_jbuf_set_fixed(jb[i], 0);
+    }
+
+    /* Frames of different sizes, with their buffer and sequence number
+     * as content.
+     */
+    for (seq = 0; seq < 10; ++seq) {
+	for (i = 0; i < JB_CNT; ++i) {
+	    pj_memset(frame, (seq << 2) | i, sizeof(frame));
+	    pjmedia_jbuf_put_frame(jb[i], frame, 20 + seq * 10, seq);
+	}
+    }
+
+    pjmedia_jb_slab_get_info(slab, &info);
+    if (info.used == 0 || info.capacity < info.used) {
+	rc = -210;
+	goto on_return;
+    }
+
+    for (seq = 0; rc == 0 && seq < 10; ++seq) {
+	for (i = 0; i < JB_CNT; ++i) {
+	    char frame_type;
+	    pj_size_t size = sizeof(frame);
+	    unsigned j;
+
+	    pjmedia_jbuf_get_frame2(jb[i], frame, &size, &frame_type, NULL);
+	    if (frame_type != PJMEDIA_JB_NORMAL_FRAME ||
+		size != 20 + seq * 10)
+	    {
+		rc = -220;
+		break;
+	    }
+	    for (j = 0; j < size; ++j) {
+		if (frame[j] != ((seq << 2) | i)) {
+		    rc = -230;
+		    break;
+		}
+	    }
+	}
+    }
+    if (rc != 0)
+	goto on_return;
+
+    pjmedia_jb_slab_get_info(slab, &info);
+    if (info.used != 0) {
+	rc = -240;
+	goto on_return;
+    }
+
+    /* Reset and destroy give the frames back */
+    for (seq = 0; seq < 5; ++seq)
+	pjmedia_jbuf_put_frame(jb[0], frame, FRAME_SIZE, seq);
+    pjmedia_jbuf_reset(jb[0]);
+    pjmedia_jbuf_put_frame(jb[1], frame, FRAME_SIZE, 100);
+    pjmedia_jbuf_destroy(jb[1]);
+    jb[1] = NULL;
+    pjmedia_jb_slab_get_info(slab, &info);
+    if (info.used != 0) {
+	rc = -250;
+	goto on_return;
+    }
+
+    /* Frames larger than the slab chunks are kept by the jitter buffer */
+    pjmedia_jbuf_create2(pool, &jb_name, PJMEDIA_JB_SLAB_MAX_FRAME + 1,
+			 JB_PTIME, 4, slab, &big_jb);
+    pjmedia_jbuf_put_frame(big_jb, frame, FRAME_SIZE, 0);
+    pjmedia_jb_slab_get_info(slab, &info);
+    if (info.used != 0)
+	rc = -260;
+    pjmedia_jbuf_destroy(big_jb);
+
+on_return:
+    for (i = 0; i < JB_CNT; ++i) {
+	if (jb[i])
+	    pjmedia_jbuf_destroy(jb[i]);
+    }
+    pjmedia_jb_slab_destroy(slab);
+    pj_pool_release(pool);
+    return rc;
+}
+
+/* Run the jitter buffer in time-stretching mode, with packets arriving
+ * in bursts of burst frames every burst frame intervals, after an initial
+ * burst of init_cnt frames. Report the latency changes, and the number
+ * of empty GETs during the second half of the run.
+ */
+static void jbuf_stretch_run(pjmedia_jbuf *jb, unsigned burst,
+			     unsigned init_cnt, unsigned tick_cnt,
+			     unsigned *shrink_cnt, unsigned *expand_cnt,
+			     unsigned *late_empty)
+{
+    char frame[1];
+    unsigned seq = 0, tick, i;
+    pjmedia_jb_state state;
+
+    *shrink_cnt = *expand_cnt = *late_empty = 0;
+    frame[0] = 0;
+
+    for (i = 0; i < init_cnt; ++i)
+	pjmedia_jbuf_put_frame(jb, frame, 1, seq++);
+
+    for (tick = 0; tick < tick_cnt; ++tick) {
+	pjmedia_jb_stretch_op op;
+	unsigned get_cnt = 1;
+	char frame_type;
+
+	if (tick % burst == 0) {
+	    for (i = 0; i < burst; ++i)
+		pjmedia_jbuf_put_frame(jb, frame, 1, seq++);
+	}
+
+	op = pjmedia_jbuf_get_stretch_op(jb);
+	if (op == PJMEDIA_JB_STRETCH_SHRINK) {
+	    ++*shrink_cnt;
+	    get_cnt = 2;
+	} else if (op == PJMEDIA_JB_STRETCH_EXPAND) {
+	    ++*expand_cnt;
+	    get_cnt = 0;
+	}
+
+	for (i = 0; i < get_cnt; ++i) {
+	    pjmedia_jbuf_get_frame(jb, frame, &frame_type);
+	    if (tick >= tick_cnt / 2 &&
+		frame_type != PJMEDIA_JB_NORMAL_FRAME)
+	    {
+		++*late_empty;
+	    }
+	}
+    }
+
+    pjmedia_jbuf_get_state(jb, &state);
+    printf("Stretch burst=%u: shrink=%u expand=%u prefetch=%u size=%u "
+	   "discard=%u late empty=%u\n",
+	   burst, *shrink_cnt, *expand_cnt, state.prefetch, state.size,
+	   state.discard, *late_empty);
+}
+
+/* Time-stretching mode shrinks the latency on a good network and raises
+ * it on a bursty one, without discarding frames.
+ */
+static int jbuf_stretch_test(void)
+{
+    pj_str_t jb_name = {"JBSTRETCH", 9};
+    unsigned shrink_cnt, expand_cnt, late_empty;
+    pjmedia_jb_state state;
+    pjmedia_jbuf *jb;
+    pj_pool_t *pool;
+    unsigned i;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "JBSTRETCH", 1000, 1000, NULL);
+
+    /* Good network, starting with 10 frames of latency */
+    pjmedia_jbuf_create(pool, &jb_name, 1, JB_PTIME, JB_BUF_SIZE, &jb);
+    pjmedia_jbuf_set_adaptive(jb, 0, 1, JB_BUF_SIZE * 4 / 5);
+    pjmedia_jbuf_set_stretch(jb, PJ_TRUE);
+
+    jbuf_stretch_run(jb, 1, 10, 1000, &shrink_cnt, &expand_cnt,
+		     &late_empty);
+    pjmedia_jbuf_get_state(jb, &state);
+    if (shrink_cnt < 8 || state.size > 2 || state.discard != 0 ||
+	late_empty != 0)
+    {
+	rc = -100;
+    }
+    pjmedia_jbuf_destroy(jb);
+
+    /* Bursts of five frames */
+    if (rc == 0) {
+	pjmedia_jbuf_create(pool, &jb_name, 1, JB_PTIME, JB_BUF_SIZE, &jb);
+	pjmedia_jbuf_set_adaptive(jb, 0, 1, JB_BUF_SIZE * 4 / 5);
+	pjmedia_jbuf_set_stretch(jb, PJ_TRUE);
+
+	jbuf_stretch_run(jb, 5, 0, 1000, &shrink_cnt, &expand_cnt,
+			 &late_empty);
+	pjmedia_jbuf_get_state(jb, &state);
+	if (expand_cnt == 0 || state.prefetch < 4 || state.discard != 0 ||
+	    late_empty != 0)
+	{
+	    rc = -110;
+	}
+	pjmedia_jbuf_destroy(jb);
+    }
+
+    /* Disabling the mode restores the previous discard algorithm. The
+     * progressive algorithm removes the excess latency of the initial
+     * burst, while without discard algorithm the latency stays.
+     */
+    for (i = 0; rc == 0 && i < 2; ++i) {
+	pjmedia_jb_discard_algo algo = i ? PJMEDIA_JB_DISCARD_NONE :
+					   PJMEDIA_JB_DISCARD_PROGRESSIVE;
+	char frame[1], frame_type;
+	unsigned seq = 0, tick;
+
+	pjmedia_jbuf_create(pool, &jb_name, 1, JB_PTIME, JB_BUF_SIZE, &jb);
+	pjmedia_jbuf_set_adaptive(jb, 0, 1, JB_BUF_SIZE * 4 / 5);
+	pjmedia_jbuf_set_discard(jb, algo);
+	pjmedia_jbuf_set_stretch(jb, PJ_TRUE);
+	pjmedia_jbuf_set_stretch(jb, PJ_FALSE);
+
+	frame[0] = 0;
+	while (seq < 10)
+	    pjmedia_jbuf_put_frame(jb, frame, 1, seq++);
+	for (tick = 0; tick < 1000; ++tick) {
+	    pjmedia_jbuf_put_frame(jb, frame, 1, seq++);
+	    pjmedia_jbuf_get_frame(jb, frame, &frame_type);
+	}
+
+	pjmedia_jbuf_get_state(jb, &state);
+	if ((algo == PJMEDIA_JB_DISCARD_NONE) != (state.size == 10))
+	    rc = -120;
+	pjmedia_jbuf_destroy(jb);
+    }
+
+    pj_pool_release(pool);
+    return rc;
+}
+
 int jbuf_main(void)
 {
     FILE *input;
@@ -200,6 +533,29 @@ int jbuf_main(void)
 	return -1;
     }
 
+#ifdef REPORT
+    jbuf_bench("Audio jbuf (160 bytes x 25)", 160, 160, 25, PJ_FALSE);
+    jbuf_bench("Audio jbuf, shared slab", 160, 160, 25, PJ_TRUE);
+    jbuf_bench("Video jbuf (2000 bytes x 250)", PJMEDIA_MAX_MRU, 100, 250,
+	       PJ_FALSE);
+    jbuf_bench("Video jbuf, shared slab", PJMEDIA_MAX_MRU, 100, 250,
+	       PJ_TRUE);
+#endif
+
+    rc = jbuf_slab_test();
+    if (rc != 0) {
+	printf("! Shared slab test failed, rc=%d\n", rc);
+	fclose(input);
+	return rc;
+    }
+
+    rc = jbuf_stretch_test();
+    if (rc != 0) {
+	printf("! Time-stretching test failed, rc=%d\n", rc);
+	fclose(input);
+	return rc;
+    }
+
     old_log_level = pj_log_get_level();
     pj_log_set_level(5);
 
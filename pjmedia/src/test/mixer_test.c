@@ -0,0 +1,169 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE   "mixer_test.c"
+
+/* Enough for the largest vector step plus the remaining samples */
+#define MAX_COUNT   67
+#define ROUNDS	    200
+
+
+/* Random sample, with extra weight on the extremes */
+static pj_int16_t rand_sample(void)
+{
+    switch (pj_rand() % 8) {
+    case 0:
+	return 32767;
+    case 1:
+	return -32768;
+    default:
+	return (pj_int16_t)(pj_rand() & 0xFFFF);
+    }
+}
+
+/* Compare the implementation against the portable C implementation */
+static int test_impl(pjmedia_mix_impl impl)
+{
+    static const unsigned gains[] = { 0, 1, 64, 127, 128, 129, 200, 255,
+				      1000, 32767, 40000 };
+    pj_int16_t src[MAX_COUNT], out1[MAX_COUNT], out2[MAX_COUNT];
+    pj_int32_t mix1[MAX_COUNT], mix2[MAX_COUNT];
+    pj_int32_t tmp1[MAX_COUNT], tmp2[MAX_COUNT];
+    unsigned round;
+
+    for (round=0; round<ROUNDS; ++round) {
+	unsigned count = round % (MAX_COUNT+1);
+	unsigned gain = gains[round % PJ_ARRAY_SIZE(gains)];
+	pj_int32_t min1, max1, min2, max2;
+	pj_uint32_t lvl1, lvl2;
+	unsigned i, j;
+
+	for (i=0; i<count; ++i) {
+	    src[i] = rand_sample();
+	    mix1[i] = mix2[i] = (pj_int32_t)(pj_rand() % 0x40000) - 0x20000;
+	}
+
+	/* Widen */
+	pjmedia_mix_set_impl(PJMEDIA_MIX_IMPL_SCALAR);
+	pjmedia_mix_copy(mix1, src, count);
+	pjmedia_mix_set_impl(impl);
+	pjmedia_mix_copy(mix2, src, count);
+	if (pj_memcmp(mix1, mix2, count * sizeof(mix1[0])) != 0)
+	    return -10;
+
+	/* Accumulate a few signals */
+	for (j=0; j<4; ++j) {
+	    for (i=0; i<count; ++i)
+		src[i] = rand_sample();
+
+	    pjmedia_mix_set_impl(PJMEDIA_MIX_IMPL_SCALAR);
+	    pjmedia_mix_add(mix1, src, count, &min1, &max1);
+	    pjmedia_mix_set_impl(impl);
+	    pjmedia_mix_add(mix2, src, count, &min2, &max2);
+	    if (pj_memcmp(mix1, mix2, count * sizeof(mix1[0])) != 0)
+		return -20;
+	    if (min1 != min2 || max1 != max2)
+		return -21;
+	}
+
+	/* Remove a signal, out of place and in place */
+	pjmedia_mix_set_impl(PJMEDIA_MIX_IMPL_SCALAR);
+	pjmedia_mix_sub(tmp1, mix1, src, count, &min1, &max1);
+	pjmedia_mix_set_impl(impl);
+	pjmedia_mix_sub(tmp2, mix2, src, count, &min2, &max2);
+	if (pj_memcmp(tmp1, tmp2, count * sizeof(tmp1[0])) != 0)
+	    return -25;
+	if (min1 != min2 || max1 != max2)
+	    return -26;
+
+	pjmedia_mix_sub(mix2, mix2, src, count, NULL, NULL);
+	if (pj_memcmp(tmp1, mix2, count * sizeof(tmp1[0])) != 0)
+	    return -27;
+	pjmedia_mix_set_impl(PJMEDIA_MIX_IMPL_SCALAR);
+	pjmedia_mix_sub(mix1, mix1, src, count, NULL, NULL);
+
+	/* Convert back with gain, in place and out of place. The gain is
+	 * limited so that the 32bit product doesn't overflow.
+	 */
+	pjmedia_mix_set_impl(PJMEDIA_MIX_IMPL_SCALAR);
+	lvl1 = pjmedia_mix_adjust(out1, mix1, count, gain % 8192);
+	pjmedia_mix_set_impl(impl);
+	lvl2 = pjmedia_mix_adjust(out2, mix2, count, gain % 8192);
+	if (lvl1 != lvl2 || pj_memcmp(out1, out2, count * sizeof(out1[0])))
+	    return -30;
+
+	lvl2 = pjmedia_mix_adjust((pj_int16_t*)mix2, mix2, count,
+				  gain % 8192);
+	if (lvl1 != lvl2 || pj_memcmp(out1, mix2, count * sizeof(out1[0])))
+	    return -31;
+
+	/* Gain on 16bit samples */
+	pj_memcpy(out2, out1, count * sizeof(out1[0]));
+	pjmedia_mix_set_impl(PJMEDIA_MIX_IMPL_SCALAR);
+	lvl1 = pjmedia_mix_adjust_samples(out1, count, gain);
+	pjmedia_mix_set_impl(impl);
+	lvl2 = pjmedia_mix_adjust_samples(out2, count, gain);
+	if (lvl1 != lvl2 || pj_memcmp(out1, out2, count * sizeof(out1[0])))
+	    return -40;
+
+	/* Level */
+	pjmedia_mix_set_impl(PJMEDIA_MIX_IMPL_SCALAR);
+	lvl1 = pjmedia_mix_level(src, count);
+	pjmedia_mix_set_impl(impl);
+	lvl2 = pjmedia_mix_level(src, count);
+	if (lvl1 != lvl2)
+	    return -50;
+    }
+
+    return 0;
+}
+
+int mixer_test(void)
+{
+    static const pjmedia_mix_impl impls[] =
+    {
+	PJMEDIA_MIX_IMPL_SSE2,
+	PJMEDIA_MIX_IMPL_AVX2,
+	PJMEDIA_MIX_IMPL_NEON
+    };
+    pjmedia_mix_impl best = pjmedia_mix_get_impl();
+    unsigned i;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  best implementation: %s",
+	      pjmedia_mix_impl_name(best)));
+
+    for (i=0; i<PJ_ARRAY_SIZE(impls) && rc==0; ++i) {
+	if (pjmedia_mix_set_impl(impls[i]) != PJ_SUCCESS)
+	    continue;
+
+	PJ_LOG(3,(THIS_FILE, "  testing %s", pjmedia_mix_impl_name(impls[i])));
+	rc = test_impl(impls[i]);
+	if (rc != 0) {
+	    PJ_LOG(3,(THIS_FILE, "  %s differs from scalar, rc=%d",
+		      pjmedia_mix_impl_name(impls[i]), rc));
+	    rc -= 100 * i;
+	}
+    }
+
+    pjmedia_mix_set_impl(PJMEDIA_MIX_IMPL_AUTO);
+    return rc;
+}
@@ -0,0 +1,179 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+#include <math.h>
+
+#define THIS_FILE   "resample_test.c"
+
+#define PTIME	    20
+#define FRAMES	    10
+#define MAX_SPF	    (48000 * PTIME / 1000 * 2)
+
+
+/* Generate frames of a sine wave, continuing from sample n */
+static void gen_sine(pj_int16_t *buf, unsigned count, unsigned rate,
+		     unsigned freq, unsigned n)
+{
+    unsigned i;
+
+    for (i=0; i<count; ++i) {
+	buf[i] = (pj_int16_t)(16000 * sin(2 * PJ_PI * freq * (n + i) / rate));
+    }
+}
+
+/* Get the RMS level of the output of a sine wave, after the filter has
+ * settled.
+ */
+static double sine_level(pj_pool_t *pool, unsigned rate_in,
+			 unsigned rate_out, unsigned freq)
+{
+    pjmedia_resample *resample;
+    pj_int16_t in[MAX_SPF], out[MAX_SPF];
+    unsigned spf_in = rate_in * PTIME / 1000;
+    unsigned spf_out = rate_out * PTIME / 1000;
+    double sum = 0;
+    unsigned i, j;
+
+    if (pjmedia_resample_create(pool, PJ_TRUE, PJ_TRUE, 1, rate_in,
+				rate_out, spf_in, &resample) != PJ_SUCCESS)
+    {
+	return -1;
+    }
+
+    for (i=0; i<FRAMES; ++i) {
+	gen_sine(in, spf_in, rate_in, freq, i * spf_in);
+	pjmedia_resample_run(resample, in, out);
+	if (i >= FRAMES/2) {
+	    for (j=0; j<spf_out; ++j)
+		sum += (double)out[j] * out[j];
+	}
+    }
+    pjmedia_resample_destroy(resample);
+
+    return sqrt(sum / (spf_out * (FRAMES - FRAMES/2)));
+}
+
+/* Compare the implementation against the portable C implementation, for
+ * all conversions between 8, 16, 32 and 48 KHz.
+ */
+static int test_impl(pj_pool_t *pool, pjmedia_mix_impl impl)
+{
+    static const unsigned rates[] = { 8000, 16000, 32000, 48000 };
+    unsigned i, j, q, ch, f;
+
+    for (i=0; i<PJ_ARRAY_SIZE(rates); ++i) {
+	for (j=0; j<PJ_ARRAY_SIZE(rates); ++j) {
+	    for (q=0; q<3; ++q) {
+		for (ch=1; ch<=2; ++ch) {
+		    pjmedia_resample *r1, *r2;
+		    pj_int16_t in[MAX_SPF], out1[MAX_SPF], out2[MAX_SPF];
+		    unsigned spf_in = rates[i] * PTIME / 1000 * ch;
+		    unsigned spf_out = rates[j] * PTIME / 1000 * ch;
+
+		    if (i == j)
+			continue;
+
+		    if (pjmedia_resample_create(pool, q > 0, q > 1, ch,
+						rates[i], rates[j], spf_in,
+						&r1) != PJ_SUCCESS ||
+			pjmedia_resample_create(pool, q > 0, q > 1, ch,
+						rates[i], rates[j], spf_in,
+						&r2) != PJ_SUCCESS)
+		    {
+			return -10;
+		    }
+
+		    for (f=0; f<3; ++f) {
+			unsigned k;
+
+			for (k=0; k<spf_in; ++k)
+			    in[k] = (pj_int16_t)(pj_rand() & 0xFFFF);
+
+			pjmedia_mix_set_impl(PJMEDIA_MIX_IMPL_SCALAR);
+			pjmedia_resample_run(r1, in, out1);
+			pjmedia_mix_set_impl(impl);
+			pjmedia_resample_run(r2, in, out2);
+			if (pj_memcmp(out1, out2, spf_out * sizeof(out1[0])))
+			    return -20;
+		    }
+
+		    pjmedia_resample_destroy(r1);
+		    pjmedia_resample_destroy(r2);
+		}
+	    }
+	}
+    }
+
+    return 0;
+}
+
+int resample_test(void)
+{
+    static const pjmedia_mix_impl impls[] =
+    {
+	PJMEDIA_MIX_IMPL_SSE2,
+	PJMEDIA_MIX_IMPL_AVX2,
+	PJMEDIA_MIX_IMPL_NEON
+    };
+    pj_pool_t *pool;
+    double ref, lvl;
+    unsigned i;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "resample", 4000, 4000, NULL);
+
+    /* A tone in the pass band keeps its level */
+    ref = 16000 / sqrt(2.0);
+    lvl = sine_level(pool, 8000, 48000, 1000);
+    PJ_LOG(3,(THIS_FILE, "  1 KHz tone, 8 to 48 KHz: %d dB",
+	      (int)(20 * log10(lvl / ref) - 0.5)));
+    if (lvl < ref * 0.9 || lvl > ref * 1.1)
+	rc = -1;
+
+    lvl = sine_level(pool, 48000, 8000, 1000);
+    PJ_LOG(3,(THIS_FILE, "  1 KHz tone, 48 to 8 KHz: %d dB",
+	      (int)(20 * log10(lvl / ref) - 0.5)));
+    if (rc == 0 && (lvl < ref * 0.9 || lvl > ref * 1.1))
+	rc = -2;
+
+    /* A tone above the output Nyquist is removed */
+    lvl = sine_level(pool, 48000, 8000, 6000);
+    PJ_LOG(3,(THIS_FILE, "  6 KHz tone, 48 to 8 KHz: %d dB",
+	      (int)(20 * log10(lvl / ref + 1e-9) - 0.5)));
+    if (rc == 0 && lvl > ref * 0.01)
+	rc = -3;
+
+    for (i=0; i<PJ_ARRAY_SIZE(impls) && rc==0; ++i) {
+	if (pjmedia_mix_set_impl(impls[i]) != PJ_SUCCESS)
+	    continue;
+
+	PJ_LOG(3,(THIS_FILE, "  testing %s", pjmedia_mix_impl_name(impls[i])));
+	rc = test_impl(pool, impls[i]);
+	if (rc != 0) {
+	    PJ_LOG(3,(THIS_FILE, "  %s differs from scalar, rc=%d",
+		      pjmedia_mix_impl_name(impls[i]), rc));
+	    rc -= 100 * i;
+	}
+    }
+
+    pjmedia_mix_set_impl(PJMEDIA_MIX_IMPL_AUTO);
+    pj_pool_release(pool);
+    return rc;
+}
@@ -97,6 +97,21 @@ int test_main(void)
 #if HAS_JBUF_TEST
     DO_TEST(jbuf_main());
 #endif
+#if HAS_MIXER_TEST
+    DO_TEST(mixer_test());
+#endif
+#if HAS_CONF_TEST
+    DO_TEST(conf_test());
+#endif
+#if HAS_G711_TEST
+    DO_TEST(g711_test());
+#endif
+#if HAS_FRAME_POOL_TEST
+    DO_TEST(frame_pool_test());
+#endif
+#if HAS_RESAMPLE_TEST
+    DO_TEST(resample_test());
+#endif
 #if HAS_MIPS_TEST
     DO_TEST(mips_test());
 #endif
@@ -28,6 +28,11 @@
 #define HAS_VID_CODEC_TEST	PJMEDIA_HAS_VIDEO
 #define HAS_SDP_NEG_TEST	1
 #define HAS_JBUF_TEST		1
+#define HAS_MIXER_TEST		1
+#define HAS_CONF_TEST		1
+#define HAS_G711_TEST		1
+#define HAS_FRAME_POOL_TEST	1
+#define HAS_RESAMPLE_TEST	(PJMEDIA_RESAMPLE_IMP!=PJMEDIA_RESAMPLE_NONE)
 #define HAS_MIPS_TEST		1
 #define HAS_CODEC_VECTOR_TEST	1
 
@@ -35,6 +40,11 @@ int session_test(void);
 int rtp_test(void);
 int sdp_test(void);
 int jbuf_main(void);
+int mixer_test(void);
+int conf_test(void);
+int g711_test(void);
+int frame_pool_test(void);
+int resample_test(void);
 int sdp_neg_test(void);
 int mips_test(void);
 int codec_test_vectors(void);
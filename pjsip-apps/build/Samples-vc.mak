@@ -71,6 +71,7 @@ BINDIR = ..\bin\samples\$(TARGET)
 SAMPLES = $(BINDIR)\auddemo.exe \
 	  $(BINDIR)\aectest.exe \
 	  $(BINDIR)\aviplay.exe \
+	  $(BINDIR)\callperf.exe \
 	  $(BINDIR)\clidemo.exe \
 	  $(BINDIR)\confsample.exe \
 	  $(BINDIR)\confbench.exe \
@@ -86,7 +87,9 @@ SAMPLES = $(BINDIR)\auddemo.exe \
 	  $(BINDIR)\playfile.exe \
 	  $(BINDIR)\playsine.exe\
 	  $(BINDIR)\recfile.exe  \
+	  $(BINDIR)\regperf.exe \
 	  $(BINDIR)\resampleplay.exe \
+	  $(BINDIR)\resolvebench.exe \
 	  $(BINDIR)\simpleua.exe \
 	  $(BINDIR)\simple_pjsua.exe \
 	  $(BINDIR)\sipecho.exe \
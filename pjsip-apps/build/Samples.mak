@@ -19,7 +19,9 @@ BINDIR := ../bin/samples/$(TARGET_NAME)
 SAMPLES := auddemo \
 	   aviplay \
 	   aectest \
+	   callperf \
 	   clidemo \
+	   confbench \
 	   confsample \
 	   encdec \
 	   httpdemo \
@@ -33,7 +35,9 @@ SAMPLES := auddemo \
 	   playfile \
 	   playsine \
 	   recfile \
+	   regperf \
 	   resampleplay \
+	   resolvebench \
 	   simpleua \
 	   simple_pjsua \
 	   sipecho \
@@ -70,7 +70,7 @@ pj_bool_t		    app_running	= PJ_FALSE;
  */
 static void ringback_start(pjsua_call_id call_id)
 {
-    if (app_config.no_tones)
+    if (app_config.no_tones || !app_config.call_data)
 	return;
 
     if (app_config.call_data[call_id].ringback_on)
@@ -87,7 +87,7 @@ static void ringback_start(pjsua_call_id call_id)
 
 static void ring_stop(pjsua_call_id call_id)
 {
-    if (app_config.no_tones)
+    if (app_config.no_tones || !app_config.call_data)
 	return;
 
     if (app_config.call_data[call_id].ringback_on) {
@@ -117,7 +117,7 @@ static void ring_stop(pjsua_call_id call_id)
 
 static void ring_start(pjsua_call_id call_id)
 {
-    if (app_config.no_tones)
+    if (app_config.no_tones || !app_config.call_data)
 	return;
 
     if (app_config.call_data[call_id].ring_on)
@@ -181,7 +181,9 @@ static void on_call_state(pjsua_call_id call_id, pjsip_event *e)
 	ring_stop(call_id);
 
 	/* Cancel duration timer, if any */
-	if (app_config.call_data[call_id].timer.id != PJSUA_INVALID_ID) {
+	if (app_config.call_data &&
+	    app_config.call_data[call_id].timer.id != PJSUA_INVALID_ID)
+	{
 	    app_call_data *cd = &app_config.call_data[call_id];
 	    pjsip_endpoint *endpt = pjsua_get_pjsip_endpt();
 
@@ -216,7 +218,8 @@ static void on_call_state(pjsua_call_id call_id, pjsip_event *e)
     } else {
 
 	if (app_config.duration != PJSUA_APP_NO_LIMIT_DURATION && 
-	    call_info.state == PJSIP_INV_STATE_CONFIRMED) 
+	    call_info.state == PJSIP_INV_STATE_CONFIRMED &&
+	    app_config.call_data)
 	{
 	    /* Schedule timer to hangup call after the specified duration */
 	    app_call_data *cd = &app_config.call_data[call_id];
@@ -497,32 +500,30 @@ static void on_call_audio_state(pjsua_call_info *ci, unsigned mi,
 
 	/* Put call in conference with other calls, if desired */
 	if (app_config.auto_conf) {
-	    pjsua_call_id call_ids[PJSUA_MAX_CALLS];
-	    unsigned call_cnt=PJ_ARRAY_SIZE(call_ids);
-	    unsigned i;
+	    pjsua_call_id id, max_id;
 
-	    /* Get all calls, and establish media connection between
+	    /* Walk all calls, and establish media connection between
 	     * this call and other calls.
 	     */
-	    pjsua_enum_calls(call_ids, &call_cnt);
+	    max_id = (pjsua_call_id)pjsua_call_get_max_count();
 
-	    for (i=0; i<call_cnt; ++i) {
-		if (call_ids[i] == ci->id)
+	    for (id=0; id<max_id; ++id) {
+		if (id == ci->id)
 		    continue;
 		
-		if (!pjsua_call_has_media(call_ids[i]))
+		if (!pjsua_call_is_active(id) || !pjsua_call_has_media(id))
 		    continue;
 
 		pjsua_conf_connect(call_conf_slot,
-				   pjsua_call_get_conf_port(call_ids[i]));
-		pjsua_conf_connect(pjsua_call_get_conf_port(call_ids[i]),
+				   pjsua_call_get_conf_port(id));
+		pjsua_conf_connect(pjsua_call_get_conf_port(id),
 		                   call_conf_slot);
 
 		/* Automatically record conversation, if desired */
 		if (app_config.auto_rec && app_config.rec_port !=
 					   PJSUA_INVALID_ID)
 		{
-		    pjsua_conf_connect(pjsua_call_get_conf_port(call_ids[i]), 
+		    pjsua_conf_connect(pjsua_call_get_conf_port(id), 
 				       app_config.rec_port);
 		}
 
@@ -1368,8 +1369,14 @@ static pj_status_t app_init()
     stereo_demo();
 #endif
 
-    /* Initialize calls data */
-    for (i=0; i<PJ_ARRAY_SIZE(app_config.call_data); ++i) {
+    /* Initialize calls data. The table is sized by max_calls, which is
+     * not limited by PJSUA_MAX_CALLS.
+     */
+    app_config.call_data = (app_call_data*)
+			   pj_pool_calloc(app_config.pool,
+					  app_config.cfg.max_calls,
+					  sizeof(app_call_data));
+    for (i=0; i<app_config.cfg.max_calls; ++i) {
 	app_config.call_data[i].timer.id = PJSUA_INVALID_ID;
 	app_config.call_data[i].timer.cb = &call_timeout_callback;
     }
@@ -2011,6 +2018,22 @@ static pj_status_t app_destroy()
 	pjsua_conf_remove_port(app_config.tone_slots[i]);
     }
 
+    /* Cancel duration timers, since the calls data is allocated from the
+     * application pool. Calls that are still disconnecting must not touch
+     * it afterwards.
+     */
+    if (app_config.call_data) {
+	for (i=0; i<app_config.cfg.max_calls; ++i) {
+	    app_call_data *cd = &app_config.call_data[i];
+
+	    if (cd->timer.id != PJSUA_INVALID_ID) {
+		cd->timer.id = PJSUA_INVALID_ID;
+		pjsip_endpt_cancel_timer(pjsua_get_pjsip_endpt(), &cd->timer);
+	    }
+	}
+	app_config.call_data = NULL;
+    }
+
     if (app_config.pool) {
 	pj_pool_release(app_config.pool);
 	app_config.pool = NULL;
@@ -676,22 +676,26 @@ static void get_call_id(pj_cli_dyn_choice_param *param)
     if (param->cnt < param->max_cnt) {
 	char call_id[64];
 	char desc[128];
-	unsigned i, count;
-	pjsua_call_id ids[PJSUA_MAX_CALLS];
+	pjsua_call_id id, max_id;
 	int call = current_call;
 
-	count = PJ_ARRAY_SIZE(ids);
-	pjsua_enum_calls(ids, &count);
+	/* The calls table is sized at run-time, so walk it rather than
+	 * enumerating into a fixed array.
+	 */
+	max_id = (pjsua_call_id)pjsua_call_get_max_count();
 
-	if (count > 1) {
-	    for (i=0; i<count; ++i) {
+	if (pjsua_call_get_count() > 1) {
+	    for (id=0; id<max_id; ++id) {
 		pjsua_call_info call_info;
 
-		if (ids[i] == call)
+		if (!pjsua_call_is_active(id))
+		    continue;
+
+		if (id == call)
 		    return;
 
-		pjsua_call_get_info(ids[i], &call_info);
-		pj_ansi_snprintf(call_id, sizeof(call_id), "%d", ids[i]);
+		pjsua_call_get_info(id, &call_info);
+		pj_ansi_snprintf(call_id, sizeof(call_id), "%d", id);
 		pj_strdup2(param->pool, &param->choice[param->cnt].value, 
 			   call_id);
 		pj_ansi_snprintf(desc, sizeof(desc), "%.*s [%.*s]",
@@ -1767,17 +1771,13 @@ static pj_status_t cmd_transfer_replace_call(pj_cli_cmd_val *cval)
 	pjsip_generic_string_hdr refer_sub;
 	pj_str_t STR_REFER_SUB = { "Refer-Sub", 9 };
 	pj_str_t STR_FALSE = { "false", 5 };
-	pjsua_call_id ids[PJSUA_MAX_CALLS];
 	pjsua_msg_data msg_data;
 	char buf[8] = {0};
 	pj_str_t tmp = pj_str(buf);
-	unsigned count;
 	static const pj_str_t err_invalid_num =
 				    {"Invalid destination call number\n", 32 };
-	count = PJ_ARRAY_SIZE(ids);
-	pjsua_enum_calls(ids, &count);
 
-	if (count <= 1) {
+	if (pjsua_call_get_count() <= 1) {
 	    static const pj_str_t err_no_other_call =
 				    {"There are no other calls\n", 25};
 
@@ -1810,7 +1810,7 @@ static pj_status_t cmd_transfer_replace_call(pj_cli_cmd_val *cval)
 	    return PJ_SUCCESS;
 	}
 
-	if (dst_call >= PJSUA_MAX_CALLS) {
+	if (dst_call < 0 || dst_call >= (int)pjsua_call_get_max_count()) {
 	    pj_cli_sess_write_msg(cval->sess, err_invalid_num.ptr,
 				  err_invalid_num.slen);
 	    return PJ_SUCCESS;
@@ -91,7 +91,7 @@ typedef struct pjsua_app_config
     unsigned		    buddy_cnt;
     pjsua_buddy_config	    buddy_cfg[PJSUA_MAX_BUDDIES];
 
-    app_call_data	    call_data[PJSUA_MAX_CALLS];
+    app_call_data	   *call_data;	/* Sized by cfg.max_calls	*/
 
     pj_pool_t		   *pool;
     /* Compatibility with older pjsua */
@@ -191,7 +191,7 @@ static void usage(void)
     puts  ("");
     puts  ("User Agent options:");
     puts  ("  --auto-answer=code  Automatically answer incoming calls with code (e.g. 200)");
-    puts  ("  --max-calls=N       Maximum number of concurrent calls (default:4, max:255)");
+    puts  ("  --max-calls=N       Maximum number of concurrent calls (default:4)");
     puts  ("  --thread-cnt=N      Number of worker threads (default:1)");
     puts  ("  --duration=SEC      Set maximum call duration (default:no limit)");
     puts  ("  --norefersub        Suppress event subscription when transferring calls");
@@ -1156,13 +1156,12 @@ static pj_status_t parse_args(int argc, char *argv[],
 	    break;
 
 	case OPT_MAX_CALLS:
-	    cfg->cfg.max_calls = my_atoi(pj_optarg);
-	    if (cfg->cfg.max_calls < 1 || cfg->cfg.max_calls > PJSUA_MAX_CALLS) {
-		PJ_LOG(1,(THIS_FILE,"Error: maximum call setting exceeds "
-				    "compile time limit (PJSUA_MAX_CALLS=%d)",
-			  PJSUA_MAX_CALLS));
+	    if (my_atoi(pj_optarg) < 1) {
+		PJ_LOG(1,(THIS_FILE,"Error: invalid maximum call setting "
+				    "(expecting at least 1)"));
 		return -1;
 	    }
+	    cfg->cfg.max_calls = my_atoi(pj_optarg);
 	    break;
 
 #if defined(PJSIP_HAS_TLS_TRANSPORT) && (PJSIP_HAS_TLS_TRANSPORT != 0)
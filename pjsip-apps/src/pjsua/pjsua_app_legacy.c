@@ -1114,16 +1114,12 @@ static void ui_call_transfer_replaces(pj_bool_t no_refersub)
 	pjsip_generic_string_hdr refer_sub;
 	pj_str_t STR_REFER_SUB = { "Refer-Sub", 9 };
 	pj_str_t STR_FALSE = { "false", 5 };
-	pjsua_call_id ids[PJSUA_MAX_CALLS];
+	pjsua_call_id id, max_id;
 	pjsua_call_info ci;
 	pjsua_msg_data msg_data;
 	char buf[128];
-	unsigned i, count;
 
-	count = PJ_ARRAY_SIZE(ids);
-	pjsua_enum_calls(ids, &count);
-
-	if (count <= 1) {
+	if (pjsua_call_get_count() <= 1) {
 	    puts("There are no other calls");
 	    return;
 	}
@@ -1133,15 +1129,19 @@ static void ui_call_transfer_replaces(pj_bool_t no_refersub)
 	       current_call,
 	       (int)ci.remote_info.slen, ci.remote_info.ptr);
 
-	for (i=0; i<count; ++i) {
+	/* The calls table is sized at run-time, so walk it rather than
+	 * enumerating into a fixed array.
+	 */
+	max_id = (pjsua_call_id)pjsua_call_get_max_count();
+	for (id=0; id<max_id; ++id) {
 	    pjsua_call_info call_info;
 
-	    if (ids[i] == call)
+	    if (id == call || !pjsua_call_is_active(id))
 		continue;
 
-	    pjsua_call_get_info(ids[i], &call_info);
+	    pjsua_call_get_info(id, &call_info);
 	    printf("%d  %.*s [%.*s]\n",
-		ids[i],
+		id,
 		(int)call_info.remote_info.slen,
 		call_info.remote_info.ptr,
 		(int)call_info.state_text.slen,
@@ -1166,7 +1166,7 @@ static void ui_call_transfer_replaces(pj_bool_t no_refersub)
 		"as the call being transferred");
 	    return;
 	}
-	if (dst_call >= PJSUA_MAX_CALLS) {
+	if (dst_call < 0 || dst_call >= (int)pjsua_call_get_max_count()) {
 	    puts("Invalid destination call number");
 	    return;
 	}
@@ -1505,7 +1505,7 @@ static void ui_change_online_status()
 static void ui_conf_list()
 {
     unsigned i, count;
-    pjsua_conf_port_id id[PJSUA_MAX_CALLS];
+    pjsua_conf_port_id id[PJSUA_MAX_CONF_PORTS];
 
     printf("Conference ports:\n");
 
@@ -1513,7 +1513,7 @@ static void ui_conf_list()
     pjsua_enum_conf_ports(id, &count);
 
     for (i=0; i<count; ++i) {
-	char txlist[PJSUA_MAX_CALLS*4+10];
+	char txlist[PJSUA_MAX_CONF_PORTS*5+10];
 	unsigned j;
 	pjsua_conf_port_info info;
 
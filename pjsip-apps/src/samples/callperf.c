@@ -0,0 +1,1183 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/**
+ * \page page_pjsip_callperf_c Samples: SIP Call Setup Load Generator
+ *
+ * <b>callperf</b> generates complete INVITE/200/ACK/BYE call flows with
+ * the PJSIP invite session (see \ref PJSIP_INV) and measures the call
+ * setup capacity of PJSIP or other SIP endpoints. Like pjsip-perf and
+ * regperf, it consists of two parts:
+ *  - the server (UAS), which answers every incoming call with an SDP
+ *    answer, optionally after sending 180/Ringing, and
+ *  - the client (UAC), which places calls at a given call rate,
+ *    optionally ramping the rate up (or down) over time, while keeping
+ *    the number of concurrent calls below a limit.
+ *
+ * Both parts can run in a single program with <b>--loopback</b>, which
+ * makes it possible to measure the calls per second (CPS) capacity of
+ * the stack offline, over UDP, TCP or TLS.
+ *
+ * For every call, the client measures the latency of each phase of the
+ * call, and reports the distribution of the latencies (min, average,
+ * p50, p99, p99.9, max) at the end of the test:
+ *  - <b>ring</b>: INVITE sent until the first 18x response is received,
+ *  - <b>setup</b>: INVITE sent until the 2xx response is received,
+ *  - <b>teardown</b>: BYE sent until the 200 response is received.
+ *
+ * This file is pjsip-apps/src/samples/callperf.c
+ *
+ * \includelineno callperf.c
+ */
+
+#include <pjsip.h>
+#include <pjmedia.h>
+#include <pjsip_ua.h>
+#include <pjlib-util.h>
+#include <pjlib.h>
+#include <stdio.h>
+
+#define THIS_FILE	    "callperf.c"
+#define MAX_THREADS	    16
+
+/* Latency histogram: values are in usec, each power of two is split
+ * into HIST_SUB buckets, giving about 6% precision up to ~70 minutes.
+ */
+#define HIST_SUB_BITS	    4
+#define HIST_SUB	    (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS	    ((32 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+
+/* Static SDP, used both as the offer and the answer. The media is never
+ * started, only the SDP negotiation is performed.
+ */
+static char dummy_sdp[] =
+    "v=0\r\n"
+    "o=- 3360842071 3360842071 IN IP4 127.0.0.1\r\n"
+    "s=callperf\r\n"
+    "c=IN IP4 127.0.0.1\r\n"
+    "t=0 0\r\n"
+    "m=audio 4000 RTP/AVP 0 8 101\r\n"
+    "a=rtpmap:0 PCMU/8000\r\n"
+    "a=rtpmap:8 PCMA/8000\r\n"
+    "a=rtpmap:101 telephone-event/8000\r\n"
+    "a=fmtp:101 0-15\r\n"
+    "a=sendrecv\r\n";
+
+
+/* Call phases which latency are measured */
+enum phase
+{
+    PHASE_RING,
+    PHASE_SETUP,
+    PHASE_TEARDOWN,
+    PHASE_CNT
+};
+
+static const char *phase_names[PHASE_CNT] = { "ring", "setup", "teardown" };
+
+
+/* Latency histogram */
+struct histogram
+{
+    pj_uint32_t		 count;
+    pj_uint64_t		 sum;
+    pj_uint32_t		 min;
+    pj_uint32_t		 max;
+    pj_uint32_t		 bucket[HIST_BUCKETS];
+};
+
+
+/* Client call state, attached to the invite session */
+struct call
+{
+    pj_timestamp	 t_invite;
+    pj_timestamp	 t_bye;
+    pj_bool_t		 ringing;
+    pj_bool_t		 bye_sent;
+    pj_timer_entry	 hold_timer;
+};
+
+
+static struct app
+{
+    pj_caching_pool	 cp;
+    pj_pool_t		*pool;
+    pjsip_endpoint	*sip_endpt;
+    pjsip_module	 mod;
+    pjsip_transport_type_e tp_type;
+    pj_str_t		 local_addr;
+    int			 local_port;
+    pj_str_t		 local_uri;
+    pj_str_t		 local_contact;
+    pjmedia_sdp_session	*sdp;
+    int			 log_level;
+
+    pj_bool_t		 thread_quit;
+    unsigned		 thread_count;
+    pj_thread_t		*thread[MAX_THREADS];
+
+    struct {
+	pj_bool_t	 enabled;
+	pj_bool_t	 ringing;
+	pjsip_tls_setting tls;
+	pj_atomic_t	*call_cnt;
+    } server;
+
+    struct {
+	pj_str_t	 dst_uri;
+	pj_bool_t	 loopback;
+	unsigned	 rate;
+	unsigned	 ramp_to;
+	unsigned	 ramp_time;
+	unsigned	 max_calls;
+	unsigned	 count;
+	unsigned	 duration;
+	unsigned	 hold;
+	unsigned	 timeout;
+	unsigned	 interval;
+
+	pj_atomic_t	*active;
+	pj_lock_t	*lock;
+	unsigned	 started;
+	unsigned	 succeeded;
+	unsigned	 failed;
+	unsigned	 fail_codes[700];
+	struct histogram hist[PHASE_CNT];
+    } client;
+} app;
+
+
+static void app_perror(const char *sender, const char *title,
+		       pj_status_t status)
+{
+    char errmsg[PJ_ERR_MSG_SIZE];
+
+    pj_strerror(status, errmsg, sizeof(errmsg));
+    PJ_LOG(1,(sender, "%s: %s [code=%d]", title, errmsg, status));
+}
+
+
+static int my_atoi(const char *s)
+{
+    pj_str_t ss = pj_str((char*)s);
+    return pj_strtoul(&ss);
+}
+
+
+/*****************************************************************************
+ * Latency histogram
+ */
+
+static unsigned hist_index(pj_uint32_t val)
+{
+    unsigned msb, shift;
+
+    if (val < 2 * HIST_SUB)
+	return val;
+
+    for (msb = 31; (val & (1u << msb)) == 0; --msb)
+	;
+    shift = msb - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB + ((val >> shift) - HIST_SUB);
+}
+
+/* Middle value of the bucket */
+static pj_uint32_t hist_value(unsigned idx)
+{
+    unsigned shift;
+
+    if (idx < 2 * HIST_SUB)
+	return idx;
+
+    shift = idx / HIST_SUB - 1;
+    return (((idx % HIST_SUB) + HIST_SUB) << shift) + (1u << shift) / 2;
+}
+
+static void hist_add(struct histogram *h, pj_uint32_t usec)
+{
+    if (h->count == 0 || usec < h->min)
+	h->min = usec;
+    if (usec > h->max)
+	h->max = usec;
+    h->count++;
+    h->sum += usec;
+    h->bucket[hist_index(usec)]++;
+}
+
+/* Get the value at the specified percentile, in 1/10 percent */
+static pj_uint32_t hist_percentile(const struct histogram *h,
+				   unsigned permille)
+{
+    pj_uint64_t target, cum = 0;
+    unsigned i;
+
+    target = ((pj_uint64_t)h->count * permille + 999) / 1000;
+    if (target == 0)
+	target = 1;
+
+    for (i=0; i<HIST_BUCKETS; ++i) {
+	cum += h->bucket[i];
+	if (cum >= target) {
+	    pj_uint32_t val = hist_value(i);
+	    return val < h->min ? h->min : (val > h->max ? h->max : val);
+	}
+    }
+
+    return h->max;
+}
+
+static void hist_print(const char *name, const struct histogram *h)
+{
+#   define MS(v)    (unsigned)((v) / 1000), (unsigned)((v) % 1000)
+
+    if (h->count == 0) {
+	PJ_LOG(3,(THIS_FILE, "  %-9s      no samples", name));
+	return;
+    }
+
+    PJ_LOG(3,(THIS_FILE, "  %-9s %8u  %4u.%03u %4u.%03u %4u.%03u %4u.%03u "
+	      "%4u.%03u %4u.%03u",
+	      name, h->count,
+	      MS(h->min),
+	      MS((pj_uint32_t)(h->sum / h->count)),
+	      MS(hist_percentile(h, 500)),
+	      MS(hist_percentile(h, 990)),
+	      MS(hist_percentile(h, 999)),
+	      MS(h->max)));
+
+#   undef MS
+}
+
+/* Record the elapsed time since start for the phase */
+static void record_latency(enum phase phase, const pj_timestamp *start)
+{
+    pj_timestamp now;
+    pj_uint32_t usec;
+
+    pj_get_timestamp(&now);
+    usec = pj_elapsed_usec(start, &now);
+
+    pj_lock_acquire(app.client.lock);
+    hist_add(&app.client.hist[phase], usec);
+    pj_lock_release(app.client.lock);
+}
+
+
+/*****************************************************************************
+ * Options
+ */
+
+static void usage(void)
+{
+    printf(
+	"Usage:\n"
+	"   callperf [OPTIONS]            -- to start as call server (UAS)\n"
+	"   callperf [OPTIONS] URL        -- to make calls to URL\n"
+	"   callperf [OPTIONS] --loopback -- to make calls to itself\n"
+	"\n"
+	"where:\n"
+	"   URL                     The SIP URL to call.\n"
+	"\n"
+	"Client options:\n"
+	"   --loopback, -l          Call the server running in this program\n"
+	"   --rate=CPS, -r          Set (initial) call rate, in calls per second.\n"
+	"                           Zero means as fast as --max-calls allows\n"
+	"                           [default=10]\n"
+	"   --ramp-to=CPS           Linearly change the call rate to CPS\n"
+	"                           [default: no ramp]\n"
+	"   --ramp-time=SEC         Set the duration of the ramp [default=10]\n"
+	"   --max-calls=N, -m       Set maximum concurrent calls [default=1000]\n"
+	"   --count=N, -c           Stop after N calls [default: no limit]\n"
+	"   --duration=SEC, -d      Stop placing calls after SEC [default=10]\n"
+	"   --hold=MSEC             Set call hold time before sending BYE\n"
+	"                           [default=0]\n"
+	"   --timeout=SEC, -t       Set time to wait for pending calls when\n"
+	"                           finishing [default=32 sec]\n"
+	"   --interval=SEC, -i      Set progress report interval [default=1]\n"
+	"\n"
+	"Server options:\n"
+	"   --ringing               Send 180/Ringing before 200/OK\n"
+	"   --no-server             Don't answer calls, even when URL is\n"
+	"                           specified\n"
+	"   --tls-cert=FILE         Set TLS certificate file\n"
+	"   --tls-key=FILE          Set TLS private key file\n"
+	"   --tls-ca=FILE           Set TLS CA list file\n"
+	"\n"
+	"Client and Server options:\n"
+	"   --transport=TP, -T      Set transport: udp, tcp, or tls\n"
+	"                           [default: udp]\n"
+	"   --local-port=PORT, -p   Set local port [default: 5060]\n"
+	"   --thread-count=N        Set number of worker threads [default=1]\n"
+	"\n"
+	"Misc options:\n"
+	"   --help, -h              Display this screen\n"
+	"   --verbose, -v           Verbose logging (put more than once for even more)\n"
+	);
+}
+
+
+static pj_status_t init_options(int argc, char *argv[])
+{
+    enum { OPT_THREAD_COUNT = 1, OPT_NO_SERVER, OPT_RAMP_TO, OPT_RAMP_TIME,
+	   OPT_HOLD, OPT_RINGING, OPT_TLS_CERT, OPT_TLS_KEY, OPT_TLS_CA };
+    struct pj_getopt_option long_options[] = {
+	{ "local-port",	    1, 0, 'p' },
+	{ "transport",	    1, 0, 'T' },
+	{ "loopback",	    0, 0, 'l' },
+	{ "rate",	    1, 0, 'r' },
+	{ "ramp-to",	    1, 0, OPT_RAMP_TO },
+	{ "ramp-time",	    1, 0, OPT_RAMP_TIME },
+	{ "max-calls",	    1, 0, 'm' },
+	{ "count",	    1, 0, 'c' },
+	{ "duration",	    1, 0, 'd' },
+	{ "hold",	    1, 0, OPT_HOLD },
+	{ "timeout",	    1, 0, 't' },
+	{ "interval",	    1, 0, 'i' },
+	{ "ringing",	    0, 0, OPT_RINGING },
+	{ "no-server",	    0, 0, OPT_NO_SERVER },
+	{ "tls-cert",	    1, 0, OPT_TLS_CERT },
+	{ "tls-key",	    1, 0, OPT_TLS_KEY },
+	{ "tls-ca",	    1, 0, OPT_TLS_CA },
+	{ "thread-count",   1, 0, OPT_THREAD_COUNT },
+	{ "help",	    0, 0, 'h' },
+	{ "verbose",	    0, 0, 'v' },
+	{ NULL, 0, 0, 0 },
+    };
+    pj_bool_t no_server = PJ_FALSE;
+    int c;
+    int option_index;
+
+    app.local_port = 5060;
+    app.tp_type = PJSIP_TRANSPORT_UDP;
+    app.thread_count = 1;
+    app.log_level = 3;
+    pjsip_tls_setting_default(&app.server.tls);
+    app.client.rate = 10;
+    app.client.ramp_time = 10;
+    app.client.max_calls = 1000;
+    app.client.duration = 10;
+    app.client.timeout = 32;
+    app.client.interval = 1;
+
+    pj_optind = 0;
+    while((c=pj_getopt_long(argc,argv, "p:T:lr:m:c:d:t:i:hv",
+			    long_options, &option_index))!=-1)
+    {
+	switch (c) {
+	case 'p':
+	    app.local_port = my_atoi(pj_optarg);
+	    if (app.local_port < 0 || app.local_port > 65535) {
+		PJ_LOG(3,(THIS_FILE, "Invalid --local-port %s", pj_optarg));
+		return -1;
+	    }
+	    break;
+
+	case 'T':
+	    if (pj_ansi_stricmp(pj_optarg, "udp") == 0) {
+		app.tp_type = PJSIP_TRANSPORT_UDP;
+	    } else if (pj_ansi_stricmp(pj_optarg, "tcp") == 0) {
+		app.tp_type = PJSIP_TRANSPORT_TCP;
+	    } else if (pj_ansi_stricmp(pj_optarg, "tls") == 0) {
+#if defined(PJSIP_HAS_TLS_TRANSPORT) && PJSIP_HAS_TLS_TRANSPORT!=0
+		app.tp_type = PJSIP_TRANSPORT_TLS;
+#else
+		PJ_LOG(3,(THIS_FILE, "TLS transport is not available"));
+		return -1;
+#endif
+	    } else {
+		PJ_LOG(3,(THIS_FILE, "Invalid --transport %s", pj_optarg));
+		return -1;
+	    }
+	    break;
+
+	case 'l':
+	    app.client.loopback = PJ_TRUE;
+	    break;
+
+	case 'r':
+	    app.client.rate = my_atoi(pj_optarg);
+	    break;
+
+	case OPT_RAMP_TO:
+	    app.client.ramp_to = my_atoi(pj_optarg);
+	    break;
+
+	case OPT_RAMP_TIME:
+	    app.client.ramp_time = my_atoi(pj_optarg);
+	    break;
+
+	case 'm':
+	    app.client.max_calls = my_atoi(pj_optarg);
+	    if (app.client.max_calls == 0) {
+		PJ_LOG(3,(THIS_FILE, "Invalid --max-calls %s", pj_optarg));
+		return -1;
+	    }
+	    break;
+
+	case 'c':
+	    app.client.count = my_atoi(pj_optarg);
+	    break;
+
+	case 'd':
+	    app.client.duration = my_atoi(pj_optarg);
+	    break;
+
+	case OPT_HOLD:
+	    app.client.hold = my_atoi(pj_optarg);
+	    break;
+
+	case 't':
+	    app.client.timeout = my_atoi(pj_optarg);
+	    if (app.client.timeout == 0 || app.client.timeout > 600) {
+		PJ_LOG(3,(THIS_FILE, "Invalid --timeout %s", pj_optarg));
+		return -1;
+	    }
+	    break;
+
+	case 'i':
+	    app.client.interval = my_atoi(pj_optarg);
+	    if (app.client.interval == 0) {
+		PJ_LOG(3,(THIS_FILE, "Invalid --interval %s", pj_optarg));
+		return -1;
+	    }
+	    break;
+
+	case OPT_RINGING:
+	    app.server.ringing = PJ_TRUE;
+	    break;
+
+	case OPT_NO_SERVER:
+	    no_server = PJ_TRUE;
+	    break;
+
+	case OPT_TLS_CERT:
+	    app.server.tls.cert_file = pj_str(pj_optarg);
+	    break;
+
+	case OPT_TLS_KEY:
+	    app.server.tls.privkey_file = pj_str(pj_optarg);
+	    break;
+
+	case OPT_TLS_CA:
+	    app.server.tls.ca_list_file = pj_str(pj_optarg);
+	    break;
+
+	case OPT_THREAD_COUNT:
+	    app.thread_count = my_atoi(pj_optarg);
+	    if (app.thread_count > MAX_THREADS) {
+		PJ_LOG(3,(THIS_FILE, "Invalid --thread-count %s", pj_optarg));
+		return -1;
+	    }
+	    break;
+
+	case 'h':
+	    usage();
+	    return -1;
+
+	case 'v':
+	    app.log_level++;
+	    break;
+
+	default:
+	    PJ_LOG(1,(THIS_FILE,
+		      "Invalid argument. Use --help to see help"));
+	    return -1;
+	}
+    }
+
+    if (pj_optind != argc) {
+	app.client.dst_uri = pj_str(argv[pj_optind]);
+	pj_optind++;
+    }
+
+    if (pj_optind != argc) {
+	PJ_LOG(1,(THIS_FILE, "Error: unknown options %s", argv[pj_optind]));
+	return -1;
+    }
+
+    if (app.client.loopback && app.client.dst_uri.slen) {
+	PJ_LOG(1,(THIS_FILE, "Error: URL can't be used with --loopback"));
+	return -1;
+    }
+
+    if (app.client.loopback && no_server) {
+	PJ_LOG(1,(THIS_FILE, "Error: --loopback needs the server"));
+	return -1;
+    }
+
+    app.server.enabled = !no_server;
+    return 0;
+}
+
+
+/*****************************************************************************
+ * Server (UAS)
+ */
+
+/* Callback to handle incoming requests outside dialog */
+static pj_bool_t on_rx_request(pjsip_rx_data *rdata)
+{
+    pjsip_dialog *dlg;
+    pjsip_inv_session *inv;
+    pjsip_tx_data *tdata;
+    pj_status_t status;
+
+    if (rdata->msg_info.msg->line.req.method.id != PJSIP_INVITE_METHOD)
+	return PJ_FALSE;
+
+    if (!app.server.enabled) {
+	pjsip_endpt_respond_stateless(app.sip_endpt, rdata,
+				      PJSIP_SC_NOT_IMPLEMENTED, NULL,
+				      NULL, NULL);
+	return PJ_TRUE;
+    }
+
+    status = pjsip_dlg_create_uas(pjsip_ua_instance(), rdata,
+				  &app.local_contact, &dlg);
+    if (status != PJ_SUCCESS) {
+	pjsip_endpt_respond_stateless(app.sip_endpt, rdata,
+				      PJSIP_SC_INTERNAL_SERVER_ERROR, NULL,
+				      NULL, NULL);
+	return PJ_TRUE;
+    }
+
+    status = pjsip_inv_create_uas(dlg, rdata, app.sdp, 0, &inv);
+    if (status != PJ_SUCCESS) {
+	pjsip_dlg_respond(dlg, rdata, PJSIP_SC_INTERNAL_SERVER_ERROR, NULL,
+			  NULL, NULL);
+	return PJ_TRUE;
+    }
+
+    pj_atomic_inc(app.server.call_cnt);
+
+    /* Answer with 180 first if requested, then 200 */
+    if (app.server.ringing) {
+	status = pjsip_inv_initial_answer(inv, rdata, PJSIP_SC_RINGING,
+					  NULL, NULL, &tdata);
+	if (status == PJ_SUCCESS)
+	    status = pjsip_inv_send_msg(inv, tdata);
+	if (status == PJ_SUCCESS)
+	    status = pjsip_inv_answer(inv, PJSIP_SC_OK, NULL, NULL, &tdata);
+    } else {
+	status = pjsip_inv_initial_answer(inv, rdata, PJSIP_SC_OK,
+					  NULL, NULL, &tdata);
+    }
+
+    if (status == PJ_SUCCESS)
+	status = pjsip_inv_send_msg(inv, tdata);
+
+    if (status != PJ_SUCCESS)
+	app_perror(THIS_FILE, "Error answering call", status);
+
+    return PJ_TRUE;
+}
+
+
+/*****************************************************************************
+ * Client (UAC)
+ */
+
+/* Send BYE for the call */
+static void hangup_call(pjsip_inv_session *inv, struct call *call)
+{
+    pjsip_tx_data *tdata;
+    pj_status_t status;
+
+    pj_get_timestamp(&call->t_bye);
+    call->bye_sent = PJ_TRUE;
+
+    status = pjsip_inv_end_session(inv, PJSIP_SC_OK, NULL, &tdata);
+    if (status == PJ_SUCCESS && tdata)
+	status = pjsip_inv_send_msg(inv, tdata);
+
+    if (status != PJ_SUCCESS)
+	app_perror(THIS_FILE, "Error sending BYE", status);
+}
+
+
+/* Hold timer callback, to hangup the call. The dialog session reference
+ * taken when the timer was scheduled keeps the dialog (and the invite
+ * session and call, which are allocated from its pool) alive.
+ */
+static void on_hold_timer(pj_timer_heap_t *th, pj_timer_entry *entry)
+{
+    pjsip_inv_session *inv = (pjsip_inv_session*) entry->user_data;
+    pjsip_dialog *dlg = inv->dlg;
+    struct call *call;
+
+    PJ_UNUSED_ARG(th);
+
+    pjsip_dlg_inc_lock(dlg);
+    call = (struct call*) inv->mod_data[app.mod.id];
+    if (call && inv->state == PJSIP_INV_STATE_CONFIRMED)
+	hangup_call(inv, call);
+    pjsip_dlg_dec_lock(dlg);
+
+    pjsip_dlg_dec_session(dlg, &app.mod);
+}
+
+
+/* Callback to be called when invite session's state has changed */
+static void call_on_state_changed(pjsip_inv_session *inv, pjsip_event *e)
+{
+    struct call *call = (struct call*) inv->mod_data[app.mod.id];
+
+    PJ_UNUSED_ARG(e);
+
+    /* Server calls don't have call state */
+    if (call == NULL) {
+	return;
+    }
+
+    switch (inv->state) {
+    case PJSIP_INV_STATE_EARLY:
+	if (!call->ringing) {
+	    call->ringing = PJ_TRUE;
+	    record_latency(PHASE_RING, &call->t_invite);
+	}
+	break;
+
+    case PJSIP_INV_STATE_CONFIRMED:
+	record_latency(PHASE_SETUP, &call->t_invite);
+
+	if (app.client.hold) {
+	    pj_time_val delay;
+
+	    delay.sec = 0;
+	    delay.msec = app.client.hold;
+	    pj_time_val_normalize(&delay);
+	    pjsip_dlg_inc_session(inv->dlg, &app.mod);
+	    if (pjsip_endpt_schedule_timer(app.sip_endpt, &call->hold_timer,
+					   &delay) == PJ_SUCCESS)
+	    {
+		call->hold_timer.id = PJ_TRUE;
+	    } else {
+		pjsip_dlg_dec_session(inv->dlg, &app.mod);
+		hangup_call(inv, call);
+	    }
+	} else {
+	    hangup_call(inv, call);
+	}
+	break;
+
+    case PJSIP_INV_STATE_DISCONNECTED:
+	if (pj_timer_heap_cancel_if_active(
+		pjsip_endpt_get_timer_heap(app.sip_endpt),
+		&call->hold_timer, PJ_FALSE) > 0)
+	{
+	    pjsip_dlg_dec_session(inv->dlg, &app.mod);
+	}
+
+	if (call->bye_sent) {
+	    record_latency(PHASE_TEARDOWN, &call->t_bye);
+	}
+
+	pj_lock_acquire(app.client.lock);
+	if (call->bye_sent) {
+	    app.client.succeeded++;
+	} else {
+	    unsigned code = inv->cause;
+
+	    app.client.failed++;
+	    if (code < PJ_ARRAY_SIZE(app.client.fail_codes))
+		app.client.fail_codes[code]++;
+	}
+	pj_lock_release(app.client.lock);
+
+	inv->mod_data[app.mod.id] = NULL;
+	pj_atomic_dec(app.client.active);
+	break;
+
+    default:
+	break;
+    }
+}
+
+
+/* Callback to be called when dialog has forked */
+static void call_on_forked(pjsip_inv_session *inv, pjsip_event *e)
+{
+    PJ_UNUSED_ARG(inv);
+    PJ_UNUSED_ARG(e);
+}
+
+
+/* Make one call */
+static pj_status_t make_call(void)
+{
+    pjsip_dialog *dlg;
+    pjsip_inv_session *inv;
+    pjsip_tx_data *tdata;
+    struct call *call;
+    pj_status_t status;
+
+    status = pjsip_dlg_create_uac(pjsip_ua_instance(), &app.local_uri,
+				  &app.local_contact, &app.client.dst_uri,
+				  &app.client.dst_uri, &dlg);
+    if (status != PJ_SUCCESS) {
+	app_perror(THIS_FILE, "Error creating dialog", status);
+	return status;
+    }
+
+    status = pjsip_inv_create_uac(dlg, app.sdp, 0, &inv);
+    if (status != PJ_SUCCESS) {
+	app_perror(THIS_FILE, "Error creating invite session", status);
+	pjsip_dlg_terminate(dlg);
+	return status;
+    }
+
+    call = PJ_POOL_ZALLOC_T(dlg->pool, struct call);
+    pj_timer_entry_init(&call->hold_timer, PJ_FALSE, inv, &on_hold_timer);
+    inv->mod_data[app.mod.id] = call;
+
+    status = pjsip_inv_invite(inv, &tdata);
+    if (status != PJ_SUCCESS) {
+	app_perror(THIS_FILE, "Error creating INVITE", status);
+	inv->mod_data[app.mod.id] = NULL;
+	pjsip_inv_terminate(inv, PJSIP_SC_INTERNAL_SERVER_ERROR, PJ_FALSE);
+	return status;
+    }
+
+    pj_atomic_inc(app.client.active);
+    pj_get_timestamp(&call->t_invite);
+
+    /* On failure the session is disconnected and accounted by
+     * call_on_state_changed().
+     */
+    pjsip_inv_send_msg(inv, tdata);
+
+    return PJ_SUCCESS;
+}
+
+
+/* Number of calls that should have been started after msec, according
+ * to the call rate and the ramp.
+ */
+static pj_uint64_t calls_due(pj_uint64_t msec)
+{
+    pj_int64_t r0 = app.client.rate;
+    pj_int64_t r1 = app.client.ramp_to;
+    pj_int64_t T = (pj_int64_t)app.client.ramp_time * 1000;
+    pj_int64_t t = (pj_int64_t)msec;
+
+    if (r1 == 0 || T == 0)
+	return (pj_uint64_t)(r0 * t / 1000);
+
+    /* Integral of the linear ramp, followed by a constant rate */
+    if (t <= T)
+	return (pj_uint64_t)((r0 * t + (r1 - r0) * t * t / (2 * T)) / 1000);
+
+    return (pj_uint64_t)((r0 * T + (r1 - r0) * T / 2 + r1 * (t - T))
+			 / 1000);
+}
+
+
+/* Current target call rate */
+static unsigned current_rate(pj_uint64_t msec)
+{
+    pj_int64_t r0 = app.client.rate;
+    pj_int64_t r1 = app.client.ramp_to;
+    pj_int64_t T = (pj_int64_t)app.client.ramp_time * 1000;
+
+    if (r1 == 0 || T == 0)
+	return (unsigned)r0;
+    if ((pj_int64_t)msec >= T)
+	return (unsigned)r1;
+    return (unsigned)(r0 + (r1 - r0) * (pj_int64_t)msec / T);
+}
+
+
+static pj_status_t init_client(void)
+{
+    pj_status_t status;
+
+    if (app.client.loopback) {
+	char buf[PJSIP_MAX_URL_SIZE];
+	const char *tp_param = "";
+
+	if (app.tp_type == PJSIP_TRANSPORT_TCP)
+	    tp_param = ";transport=tcp";
+	else if (app.tp_type == PJSIP_TRANSPORT_TLS)
+	    tp_param = ";transport=tls";
+
+	pj_ansi_snprintf(buf, sizeof(buf), "sip:callperf@%.*s:%d%s",
+			 (int)app.local_addr.slen, app.local_addr.ptr,
+			 app.local_port, tp_param);
+	pj_strdup2_with_null(app.pool, &app.client.dst_uri, buf);
+    }
+
+    status = pj_atomic_create(app.pool, 0, &app.client.active);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    return pj_lock_create_simple_mutex(app.pool, "callperf",
+				       &app.client.lock);
+}
+
+
+/* Place calls according to the rate, and report the progress */
+static void run_client(void)
+{
+    pj_time_val start, now, elapsed, end_wait;
+    pj_uint64_t msec;
+    unsigned last_report = 0, last_started = 0;
+    unsigned i;
+
+    pj_gettimeofday(&start);
+
+    for (;;) {
+	pj_time_val timeout = { 0, 1 };
+	pj_uint64_t due;
+	unsigned active;
+
+	pj_gettimeofday(&now);
+	elapsed = now;
+	PJ_TIME_VAL_SUB(elapsed, start);
+	msec = PJ_TIME_VAL_MSEC(elapsed);
+
+	if (msec >= (pj_uint64_t)app.client.duration * 1000)
+	    break;
+	if (app.client.count && app.client.started >= app.client.count)
+	    break;
+
+	due = app.client.rate ? calls_due(msec) : (pj_uint64_t)-1;
+	active = (unsigned)pj_atomic_get(app.client.active);
+
+	while (app.client.started < due &&
+	       active < app.client.max_calls &&
+	       (app.client.count == 0 ||
+		app.client.started < app.client.count))
+	{
+	    if (make_call() != PJ_SUCCESS) {
+		pj_lock_acquire(app.client.lock);
+		app.client.failed++;
+		pj_lock_release(app.client.lock);
+	    }
+	    ++app.client.started;
+	    ++active;
+	}
+
+	if (msec / 1000 >= last_report + app.client.interval) {
+	    unsigned sec = (unsigned)(msec / 1000);
+
+	    PJ_LOG(3,(THIS_FILE, "%4us: target %u CPS, actual %u CPS, "
+		      "active %u, completed %u, failed %u",
+		      sec, app.client.rate ? current_rate(msec) : 0,
+		      (app.client.started - last_started) /
+			(sec - last_report),
+		      (unsigned)pj_atomic_get(app.client.active),
+		      app.client.succeeded, app.client.failed));
+	    last_report = sec;
+	    last_started = app.client.started;
+	}
+
+	if (app.thread_count == 0)
+	    pjsip_endpt_handle_events(app.sip_endpt, &timeout);
+	else
+	    pj_thread_sleep(1);
+    }
+
+    /* Wait for pending calls to complete */
+    pj_gettimeofday(&end_wait);
+    end_wait.sec += app.client.timeout;
+    while (pj_atomic_get(app.client.active) > 0) {
+	pj_time_val timeout = { 0, 10 };
+
+	pj_gettimeofday(&now);
+	if (PJ_TIME_VAL_GTE(now, end_wait)) {
+	    PJ_LOG(1,(THIS_FILE, "Timed out with %d calls still active",
+		      (int)pj_atomic_get(app.client.active)));
+	    break;
+	}
+
+	if (app.thread_count == 0)
+	    pjsip_endpt_handle_events(app.sip_endpt, &timeout);
+	else
+	    pj_thread_sleep(10);
+    }
+
+    pj_gettimeofday(&now);
+    elapsed = now;
+    PJ_TIME_VAL_SUB(elapsed, start);
+    msec = PJ_TIME_VAL_MSEC(elapsed);
+    if (msec == 0)
+	msec = 1;
+
+    PJ_LOG(3,(THIS_FILE, "Total: %u calls in %u.%03us (%u CPS), "
+	      "%u completed, %u failed",
+	      app.client.started, (unsigned)(msec / 1000),
+	      (unsigned)(msec % 1000),
+	      (unsigned)((pj_uint64_t)app.client.started * 1000 / msec),
+	      app.client.succeeded, app.client.failed));
+
+    for (i=0; i<PJ_ARRAY_SIZE(app.client.fail_codes); ++i) {
+	if (app.client.fail_codes[i] == 0)
+	    continue;
+	PJ_LOG(3,(THIS_FILE, "   failed with %d: %u", i,
+		  app.client.fail_codes[i]));
+    }
+
+    PJ_LOG(3,(THIS_FILE, "Latency (msec):"));
+    PJ_LOG(3,(THIS_FILE, "  %-9s %8s  %8s %8s %8s %8s %8s %8s",
+	      "phase", "count", "min", "avg", "p50", "p99", "p99.9",
+	      "max"));
+    for (i=0; i<PHASE_CNT; ++i)
+	hist_print(phase_names[i], &app.client.hist[i]);
+}
+
+
+/*****************************************************************************
+ * Main
+ */
+
+static pj_status_t init_sip(void)
+{
+    pj_sockaddr_in addr;
+    pjsip_inv_callback inv_cb;
+    pj_status_t status;
+
+    status = pj_init();
+    if (status != PJ_SUCCESS) {
+	app_perror(THIS_FILE, "Error initializing pjlib", status);
+	return status;
+    }
+
+    status = pjlib_util_init();
+    PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
+
+    pj_caching_pool_init(&app.cp, &pj_pool_factory_default_policy, 0);
+    app.pool = pj_pool_create(&app.cp.factory, "app", 1000, 1000, NULL);
+
+    status = pjsip_endpt_create(&app.cp.factory, pj_gethostname()->ptr,
+				&app.sip_endpt);
+    PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
+
+    pj_sockaddr_in_init(&addr, NULL, (pj_uint16_t)app.local_port);
+
+    if (app.tp_type == PJSIP_TRANSPORT_UDP) {
+	pjsip_transport *tp;
+
+	status = pjsip_udp_transport_start(app.sip_endpt, &addr, NULL,
+					   app.thread_count ?
+					    app.thread_count : 1,
+					   &tp);
+	if (status == PJ_SUCCESS) {
+	    app.local_addr = tp->local_name.host;
+	    app.local_port = tp->local_name.port;
+	}
+    } else {
+	pjsip_tpfactory *tpf = NULL;
+
+	if (app.tp_type == PJSIP_TRANSPORT_TCP) {
+	    status = pjsip_tcp_transport_start(app.sip_endpt, &addr,
+					       app.thread_count ?
+						app.thread_count : 1,
+					       &tpf);
+	}
+#if defined(PJSIP_HAS_TLS_TRANSPORT) && PJSIP_HAS_TLS_TRANSPORT!=0
+	else {
+	    status = pjsip_tls_transport_start(app.sip_endpt,
+					       &app.server.tls, &addr, NULL,
+					       app.thread_count ?
+						app.thread_count : 1,
+					       &tpf);
+	}
+#endif
+	if (status == PJ_SUCCESS) {
+	    app.local_addr = tpf->addr_name.host;
+	    app.local_port = tpf->addr_name.port;
+	}
+    }
+
+    if (status != PJ_SUCCESS) {
+	app_perror(THIS_FILE, "Unable to start transport", status);
+	return status;
+    }
+
+    {
+	char buf[PJSIP_MAX_URL_SIZE];
+	const char *tp_param = "";
+
+	if (app.tp_type == PJSIP_TRANSPORT_TCP)
+	    tp_param = ";transport=tcp";
+	else if (app.tp_type == PJSIP_TRANSPORT_TLS)
+	    tp_param = ";transport=tls";
+
+	pj_ansi_snprintf(buf, sizeof(buf), "<sip:callperf@%.*s:%d>",
+			 (int)app.local_addr.slen, app.local_addr.ptr,
+			 app.local_port);
+	pj_strdup2_with_null(app.pool, &app.local_uri, buf);
+
+	pj_ansi_snprintf(buf, sizeof(buf), "<sip:callperf@%.*s:%d%s>",
+			 (int)app.local_addr.slen, app.local_addr.ptr,
+			 app.local_port, tp_param);
+	pj_strdup2_with_null(app.pool, &app.local_contact, buf);
+    }
+
+    status = pjsip_tsx_layer_init_module(app.sip_endpt);
+    PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
+
+    status = pjsip_ua_init_module(app.sip_endpt, NULL);
+    PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
+
+    status = pjsip_100rel_init_module(app.sip_endpt);
+    PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
+
+    pj_bzero(&inv_cb, sizeof(inv_cb));
+    inv_cb.on_state_changed = &call_on_state_changed;
+    inv_cb.on_new_session = &call_on_forked;
+    status = pjsip_inv_usage_init(app.sip_endpt, &inv_cb);
+    PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
+
+    /* Module to receive incoming calls and to hold call state */
+    pj_bzero(&app.mod, sizeof(app.mod));
+    app.mod.name = pj_str("mod-callperf");
+    app.mod.id = -1;
+    app.mod.priority = PJSIP_MOD_PRIORITY_APPLICATION;
+    app.mod.on_rx_request = &on_rx_request;
+
+    status = pjsip_endpt_register_module(app.sip_endpt, &app.mod);
+    PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
+
+    status = pjmedia_sdp_parse(app.pool, dummy_sdp, pj_ansi_strlen(dummy_sdp),
+			       &app.sdp);
+    PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
+
+    status = pj_atomic_create(app.pool, 0, &app.server.call_cnt);
+    PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
+
+    return PJ_SUCCESS;
+}
+
+
+static void destroy_app(void)
+{
+    unsigned i;
+
+    app.thread_quit = PJ_TRUE;
+    for (i=0; i<app.thread_count; ++i) {
+	if (app.thread[i]) {
+	    pj_thread_join(app.thread[i]);
+	    pj_thread_destroy(app.thread[i]);
+	    app.thread[i] = NULL;
+	}
+    }
+
+    if (app.sip_endpt) {
+	pjsip_endpt_destroy(app.sip_endpt);
+	app.sip_endpt = NULL;
+    }
+
+    if (app.pool) {
+	pj_pool_release(app.pool);
+	app.pool = NULL;
+	pj_caching_pool_destroy(&app.cp);
+    }
+
+    pj_shutdown();
+}
+
+
+/* Worker thread to poll the endpoint */
+static int worker_thread(void *arg)
+{
+    pj_time_val timeout = { 0, 10 };
+
+    PJ_UNUSED_ARG(arg);
+
+    while (!app.thread_quit) {
+	pjsip_endpt_handle_events(app.sip_endpt, &timeout);
+    }
+
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    unsigned i;
+    pj_status_t status;
+
+    if (init_options(argc, argv) != 0)
+	return 1;
+
+    pj_log_set_level(app.log_level);
+
+    if (init_sip() != PJ_SUCCESS) {
+	destroy_app();
+	return 1;
+    }
+
+    for (i=0; i<app.thread_count; ++i) {
+	status = pj_thread_create(app.pool, "worker%p", &worker_thread,
+				  NULL, 0, 0, &app.thread[i]);
+	if (status != PJ_SUCCESS) {
+	    app_perror(THIS_FILE, "Unable to create thread", status);
+	    destroy_app();
+	    return 1;
+	}
+    }
+
+    if (app.client.dst_uri.slen || app.client.loopback) {
+	if (init_client() != PJ_SUCCESS) {
+	    destroy_app();
+	    return 1;
+	}
+
+	if (app.client.ramp_to) {
+	    PJ_LOG(3,(THIS_FILE, "Calling %.*s, %u to %u CPS in %us, "
+		      "max %u calls, for %us",
+		      (int)app.client.dst_uri.slen, app.client.dst_uri.ptr,
+		      app.client.rate, app.client.ramp_to,
+		      app.client.ramp_time, app.client.max_calls,
+		      app.client.duration));
+	} else {
+	    PJ_LOG(3,(THIS_FILE, "Calling %.*s, %u CPS, max %u calls, "
+		      "for %us",
+		      (int)app.client.dst_uri.slen, app.client.dst_uri.ptr,
+		      app.client.rate, app.client.max_calls,
+		      app.client.duration));
+	}
+
+	run_client();
+
+	if (app.server.enabled) {
+	    PJ_LOG(3,(THIS_FILE, "Server answered %d calls",
+		      (int)pj_atomic_get(app.server.call_cnt)));
+	}
+
+    } else {
+	char line[10];
+
+	PJ_LOG(3,(THIS_FILE, "Call server is listening on %.*s:%d",
+		  (int)app.local_addr.slen, app.local_addr.ptr,
+		  app.local_port));
+	puts("Press <ENTER> to quit");
+	fflush(stdout);
+	if (fgets(line, sizeof(line), stdin) == NULL) {
+	    puts("EOF while reading stdin, will quit now..");
+	}
+    }
+
+    destroy_app();
+    return 0;
+}
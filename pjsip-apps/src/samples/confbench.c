@@ -1,5 +1,5 @@
 /* $Id$ */
-/* 
+/*
  * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
  * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
  *
@@ -15,15 +15,24 @@
  *
  * You should have received a copy of the GNU General Public License
  * along with this program; if not, write to the Free Software
- * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
 
 /**
  * \page page_pjmedia_samples_confbench_c Samples: Benchmarking Conference Bridge
  *
- * Benchmarking pjmedia (conference bridge+resample). For my use only,
- * and it only works in Win32.
+ * Benchmarking pjmedia conference bridge (mixing and resampling).
+ *
+ * The benchmark creates a conference bridge with a number of speakers
+ * (sine wave generators) that are all connected to a number of listeners
+ * (null ports), plus some idle ports. The bridge is then clocked as fast
+ * as possible by calling its get_frame() directly, and the time spent per
+ * tick is reported as a percentage of the real-time budget (the frame
+ * time). This is repeated with each available implementation of the
+ * mixing primitives (see \ref PJMED_MIXER) to compare them. The bridge
+ * can also be run with worker threads, to measure parallel processing,
+ * and with active speaker mixing.
  *
  * This file is pjsip-apps/src/samples/confbench.c
  *
@@ -34,41 +43,35 @@
 #include <pjmedia.h>
 #include <pjlib-util.h>	/* pj_getopt */
 #include <pjlib.h>
+#include <math.h>	/* sin() */
 #include <stdlib.h>	/* atoi() */
 #include <stdio.h>
-#include <windows.h>
 
 /* For logging purpose. */
-#define THIS_FILE   "confsample.c"
-
-
-/* Configurable:
- *   LARGE_SET will create in total of about 232 ports.
- *   HAS_RESAMPLE will activate resampling on about half
- *     the port.
- */
-#define TEST_SET	    LARGE_SET
-#define HAS_RESAMPLE	    0
-
+#define THIS_FILE   "confbench.c"
 
-#define SMALL_SET	    16
-#define LARGE_SET	    100
 
+#define SINE_PTIME	    20
 
-#define PORT_COUNT	    254
-#define CLOCK_RATE	    16000
-#define SAMPLES_PER_FRAME   (CLOCK_RATE/100)
-#if HAS_RESAMPLE
-#  define SINE_CLOCK	    32000
-#else
-#  define SINE_CLOCK	    CLOCK_RATE
+#ifndef M_PI
+#define M_PI  (3.14159265)
 #endif
-#define SINE_PTIME	    20
-#define DURATION	    10
 
-#define SINE_COUNT	    TEST_SET
-#define NULL_COUNT	    TEST_SET
-#define IDLE_COUNT	    32
+
+static struct app
+{
+    /* Settings */
+    unsigned	speaker_cnt;
+    unsigned	listener_cnt;
+    unsigned	idle_cnt;
+    unsigned	clock_rate;
+    unsigned	ptime;
+    pj_bool_t	resample;
+    unsigned	tick_cnt;
+    unsigned	thread_cnt;
+    unsigned	active_cnt;
+    const char *impl;
+} app;
 
 
 static void app_perror(const char *sender, const char *title, pj_status_t status)
@@ -80,57 +83,114 @@ static void app_perror(const char *sender, const char *title, pj_status_t status
 }
 
 
-struct Times
+static void usage(void)
 {
-    FILETIME	    kernel_time;
-    ULARGE_INTEGER  u_kernel_time;
-    FILETIME	    user_time;
-    ULARGE_INTEGER  u_user_time;
-    ULARGE_INTEGER  u_total;
-};
-
-static void process(struct Times *t)
-{
-    pj_memcpy(&t->u_kernel_time, &t->kernel_time, sizeof(FILETIME));
-    pj_memcpy(&t->u_user_time, &t->user_time, sizeof(FILETIME));
-    t->u_total.QuadPart = t->u_kernel_time.QuadPart + t->u_user_time.QuadPart;
+    printf(
+	"Usage:\n"
+	"   confbench [OPTIONS]\n"
+	"\n"
+	"Options:\n"
+	"   --speakers=N, -s       Number of speakers (sine generators) "
+				  "[default: 100]\n"
+	"   --listeners=N, -l      Number of listeners of all speakers "
+				  "[default: 100]\n"
+	"   --idle=N               Number of idle ports [default: 32]\n"
+	"   --clock-rate=HZ, -r    Bridge clock rate [default: 16000]\n"
+	"   --ptime=MSEC, -p       Bridge frame time [default: 10]\n"
+	"   --resample, -R         Run speakers at twice the bridge clock rate\n"
+	"   --ticks=N, -n          Number of bridge ticks to run "
+				  "[default: 2000]\n"
+	"   --impl=NAME, -i        Mixing implementation: auto, scalar, sse2,\n"
+	"                          avx2, neon or all [default: all]\n"
+	"   --threads=N, -t        Number of bridge worker threads "
+				  "[default: 0]\n"
+	"   --active=N, -a         Only mix N active speakers "
+				  "[default: 0, mix all]\n"
+	"   --help, -h             Show this help screen\n"
+	);
 }
 
-static void benchmark(void)
+
+static int init_options(int argc, char *argv[])
 {
-    FILETIME creation_time, exit_time;
-    struct Times start, end;
-    DWORD ts, te;
-    LARGE_INTEGER elapsed;
-    BOOL rc;
-    int i;
-    double pct;
-
-    puts("Test started!"); fflush(stdout);
-
-    ts = GetTickCount();
-    rc = GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time,
-			 &start.kernel_time, &start.user_time);
-    for (i=DURATION; i>0; --i) {
-	printf("\r%d ", i); fflush(stdout);
-	pj_thread_sleep(1000);
+    enum { OPT_IDLE = 1 };
+    struct pj_getopt_option long_options[] = {
+	{ "speakers",	    1, 0, 's' },
+	{ "listeners",	    1, 0, 'l' },
+	{ "idle",	    1, 0, OPT_IDLE },
+	{ "clock-rate",	    1, 0, 'r' },
+	{ "ptime",	    1, 0, 'p' },
+	{ "resample",	    0, 0, 'R' },
+	{ "ticks",	    1, 0, 'n' },
+	{ "impl",	    1, 0, 'i' },
+	{ "threads",	    1, 0, 't' },
+	{ "active",	    1, 0, 'a' },
+	{ "help",	    0, 0, 'h' },
+	{ NULL, 0, 0, 0 },
+    };
+    int c, option_index;
+
+    app.speaker_cnt = 100;
+    app.listener_cnt = 100;
+    app.idle_cnt = 32;
+    app.clock_rate = 16000;
+    app.ptime = 10;
+    app.tick_cnt = 2000;
+    app.impl = "all";
+
+    pj_optind = 0;
+    while ((c=pj_getopt_long(argc, argv, "s:l:r:p:Rn:i:t:a:h",
+			     long_options, &option_index)) != -1)
+    {
+	switch (c) {
+	case 's':
+	    app.speaker_cnt = atoi(pj_optarg);
+	    break;
+	case 'l':
+	    app.listener_cnt = atoi(pj_optarg);
+	    break;
+	case OPT_IDLE:
+	    app.idle_cnt = atoi(pj_optarg);
+	    break;
+	case 'r':
+	    app.clock_rate = atoi(pj_optarg);
+	    break;
+	case 'p':
+	    app.ptime = atoi(pj_optarg);
+	    break;
+	case 'R':
+	    app.resample = PJ_TRUE;
+	    break;
+	case 'n':
+	    app.tick_cnt = atoi(pj_optarg);
+	    break;
+	case 'i':
+	    app.impl = pj_optarg;
+	    break;
+	case 't':
+	    app.thread_cnt = atoi(pj_optarg);
+	    break;
+	case 'a':
+	    app.active_cnt = atoi(pj_optarg);
+	    break;
+	case 'h':
+	    usage();
+	    return 1;
+	default:
+	    usage();
+	    return -1;
+	}
     }
-    rc = GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time,
-			 &end.kernel_time, &end.user_time);
-    te = GetTickCount();
-
-    process(&start);
-    process(&end);
-
-    elapsed.QuadPart = end.u_total.QuadPart - start.u_total.QuadPart;
 
-    pct = elapsed.QuadPart * 100.0 / ((te-ts)*10000.0);
+    if (app.clock_rate < 8000 || app.ptime < 1 || app.tick_cnt < 1) {
+	usage();
+	return -1;
+    }
 
-    printf("CPU usage=%6.4f%%\n", pct); fflush(stdout);
+    return 0;
 }
 
 
-
 /* Struct attached to sine generator */
 typedef struct
 {
@@ -139,7 +199,7 @@ typedef struct
 
 
 /* This callback is called to feed more samples */
-static pj_status_t sine_get_frame( pjmedia_port *port, 
+static pj_status_t sine_get_frame( pjmedia_port *port,
 				   pjmedia_frame *frame)
 {
     port_data *sine = port->port_data.pdata;
@@ -173,9 +233,6 @@ static pj_status_t sine_get_frame( pjmedia_port *port,
     return PJ_SUCCESS;
 }
 
-#ifndef M_PI
-#define M_PI  (3.14159265)
-#endif
 
 /*
  * Create a media port to generate sine wave samples.
@@ -191,7 +248,7 @@ static pj_status_t create_sine_port(pj_pool_t *pool,
     pj_str_t port_name;
     port_data *sine;
 
-    PJ_ASSERT_RETURN(pool && channel_count > 0 && channel_count <= 2, 
+    PJ_ASSERT_RETURN(pool && channel_count > 0 && channel_count <= 2,
 		     PJ_EINVAL);
 
     port = pj_pool_zalloc(pool, sizeof(pjmedia_port));
@@ -200,9 +257,9 @@ static pj_status_t create_sine_port(pj_pool_t *pool,
     /* Fill in port info. */
     port_name = pj_str("sine generator");
     pjmedia_port_info_init(&port->info, &port_name,
-			   12345, sampling_rate, channel_count, 16, 
+			   12345, sampling_rate, channel_count, 16,
 			   sampling_rate * SINE_PTIME / 1000 * channel_count);
-    
+
     /* Set the function to feed frame */
     port->get_frame = &sine_get_frame;
 
@@ -217,7 +274,7 @@ static pj_status_t create_sine_port(pj_pool_t *pool,
     /* initialise sinusoidal wavetable */
     for( i=0; i<count; i++ )
     {
-        sine->samples[i] = (pj_int16_t) (10000.0 * 
+        sine->samples[i] = (pj_int16_t) (10000.0 *
 		sin(((double)i/(double)count) * M_PI * 8.) );
     }
 
@@ -226,19 +283,69 @@ static pj_status_t create_sine_port(pj_pool_t *pool,
     return PJ_SUCCESS;
 }
 
-int main()
+
+/*
+ * Clock the bridge as fast as possible and return the average time per
+ * tick, in nanoseconds.
+ */
+static double benchmark(pjmedia_port *conf_port, pj_int16_t *buf,
+			unsigned samples_per_frame)
 {
+    pjmedia_frame frame;
+    pj_timestamp t0, t1, freq;
+    unsigned i;
+
+    pj_get_timestamp_freq(&freq);
+    pj_bzero(&frame, sizeof(frame));
+
+    /* Warm up */
+    for (i=0; i<50; ++i) {
+	frame.buf = buf;
+	frame.size = samples_per_frame * 2;
+	pjmedia_port_get_frame(conf_port, &frame);
+	frame.timestamp.u64 += samples_per_frame;
+    }
+
+    pj_get_timestamp(&t0);
+    for (i=0; i<app.tick_cnt; ++i) {
+	frame.buf = buf;
+	frame.size = samples_per_frame * 2;
+	pjmedia_port_get_frame(conf_port, &frame);
+	frame.timestamp.u64 += samples_per_frame;
+    }
+    pj_get_timestamp(&t1);
+
+    return (double)(t1.u64 - t0.u64) * 1e9 / (double)freq.u64 /
+	   app.tick_cnt;
+}
+
+
+int main(int argc, char *argv[])
+{
+    static const pjmedia_mix_impl impls[] = {
+	PJMEDIA_MIX_IMPL_SCALAR,
+	PJMEDIA_MIX_IMPL_SSE2,
+	PJMEDIA_MIX_IMPL_AVX2,
+	PJMEDIA_MIX_IMPL_NEON,
+	PJMEDIA_MIX_IMPL_AUTO
+    };
     pj_caching_pool cp;
     pjmedia_endpt *med_endpt;
     pj_pool_t *pool;
+    pjmedia_conf_param conf_param;
     pjmedia_conf *conf;
-    int i;
-    pjmedia_port *sine_port[SINE_COUNT], *null_port, *conf_port;
-    pjmedia_port *nulls[NULL_COUNT];
-    unsigned null_slots[NULL_COUNT];
-    pjmedia_master_port *master_port;
+    pjmedia_port *conf_port;
+    unsigned *listener_slots;
+    unsigned samples_per_frame, sine_clock;
+    pj_int16_t *buf;
+    double base_nsec = 0;
+    unsigned i;
+    int rc;
     pj_status_t status;
 
+    rc = init_options(argc, argv);
+    if (rc != 0)
+	return rc < 0 ? 1 : 0;
 
     pj_log_set_level(3);
 
@@ -247,7 +354,7 @@ int main()
 
     pj_caching_pool_init(&cp, &pj_pool_factory_default_policy, 0);
     pool = pj_pool_create( &cp.factory,	    /* pool factory	    */
-			   "wav",	    /* pool name.	    */
+			   "confbench",	    /* pool name.	    */
 			   4000,	    /* init size	    */
 			   4000,	    /* increment size	    */
 			   NULL		    /* callback on error    */
@@ -256,47 +363,51 @@ int main()
     status = pjmedia_endpt_create(&cp.factory, NULL, 1, &med_endpt);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
 
+    samples_per_frame = app.clock_rate * app.ptime / 1000;
+    sine_clock = app.resample ? app.clock_rate * 2 : app.clock_rate;
 
+    pjmedia_conf_param_default(&conf_param);
+    conf_param.max_slots = app.speaker_cnt + app.listener_cnt +
+			   app.idle_cnt + 1;
+    conf_param.sampling_rate = app.clock_rate;
+    conf_param.samples_per_frame = samples_per_frame;
+    conf_param.options = PJMEDIA_CONF_NO_DEVICE;
+    conf_param.worker_threads = app.thread_cnt;
+    conf_param.active_speakers = app.active_cnt;
 
-    status = pjmedia_conf_create( pool,
-				  PORT_COUNT,
-				  CLOCK_RATE,
-				  1, SAMPLES_PER_FRAME, 16,
-				  PJMEDIA_CONF_NO_DEVICE,
-				  &conf);
+    status = pjmedia_conf_create2(pool, &conf_param, &conf);
     if (status != PJ_SUCCESS) {
 	app_perror(THIS_FILE, "Unable to create conference bridge", status);
 	return 1;
     }
 
-    printf("Resampling is %s\n", (HAS_RESAMPLE?"active":"disabled"));
-
     /* Create Null ports */
-    printf("Creating %d null ports..\n", NULL_COUNT);
-    for (i=0; i<NULL_COUNT; ++i) {
-	status = pjmedia_null_port_create(pool, CLOCK_RATE, 1, SAMPLES_PER_FRAME*2, 16, &nulls[i]);
+    listener_slots = (unsigned*)
+		     pj_pool_calloc(pool, app.listener_cnt + 1,
+				    sizeof(unsigned));
+    for (i=0; i<app.listener_cnt; ++i) {
+	pjmedia_port *null_port;
+
+	status = pjmedia_null_port_create(pool, app.clock_rate, 1,
+					  samples_per_frame, 16, &null_port);
 	PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
 
-	status = pjmedia_conf_add_port(conf, pool, nulls[i], NULL, &null_slots[i]);
+	status = pjmedia_conf_add_port(conf, pool, null_port, NULL,
+				       &listener_slots[i]);
 	PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
     }
 
-    /* Create sine ports. */
-    printf("Creating %d sine generator ports..\n", SINE_COUNT);
-    for (i=0; i<SINE_COUNT; ++i) {
+    /* Create sine ports, each connected to the master port and to all
+     * null ports.
+     */
+    for (i=0; i<app.speaker_cnt; ++i) {
+	pjmedia_port *sine_port;
 	unsigned j, slot;
 
-	/* Load the WAV file to file port. */
-	status = create_sine_port(pool, SINE_CLOCK, 1, &sine_port[i]);
+	status = create_sine_port(pool, sine_clock, 1, &sine_port);
 	PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
 
-	/* Add the file port to conference bridge */
-	status = pjmedia_conf_add_port( conf,		/* The bridge	    */
-					pool,		/* pool		    */
-					sine_port[i],	/* port to connect  */
-					NULL,		/* Use port's name  */
-					&slot		/* ptr for slot #   */
-					);
+	status = pjmedia_conf_add_port(conf, pool, sine_port, NULL, &slot);
 	if (status != PJ_SUCCESS) {
 	    app_perror(THIS_FILE, "Unable to add conference port", status);
 	    return 1;
@@ -305,44 +416,67 @@ int main()
 	status = pjmedia_conf_connect_port(conf, slot, 0, 0);
 	PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
 
-	for (j=0; j<NULL_COUNT; ++j) {
-	    status = pjmedia_conf_connect_port(conf, slot, null_slots[j], 0);
+	for (j=0; j<app.listener_cnt; ++j) {
+	    status = pjmedia_conf_connect_port(conf, slot, listener_slots[j],
+					       0);
 	    PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
 	}
     }
 
     /* Create idle ports */
-    printf("Creating %d idle ports..\n", IDLE_COUNT);
-    for (i=0; i<IDLE_COUNT; ++i) {
+    for (i=0; i<app.idle_cnt; ++i) {
 	pjmedia_port *dummy;
-	status = pjmedia_null_port_create(pool, CLOCK_RATE, 1, SAMPLES_PER_FRAME, 16, &dummy);
+
+	status = pjmedia_null_port_create(pool, app.clock_rate, 1,
+					  samples_per_frame, 16, &dummy);
 	PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
 	status = pjmedia_conf_add_port(conf, pool, dummy, NULL, NULL);
 	PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
     }
 
-    /* Create null port */
-    status = pjmedia_null_port_create(pool, CLOCK_RATE, 1, SAMPLES_PER_FRAME, 16,
-				      &null_port);
-    PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
-
     conf_port = pjmedia_conf_get_master_port(conf);
+    buf = (pj_int16_t*) pj_pool_zalloc(pool, samples_per_frame * 2);
+
+    printf("%u speakers x %u listeners, %u idle ports, %u Hz, %u ms, "
+	   "resampling %s, %u worker threads, %u active speakers\n",
+	   app.speaker_cnt, app.listener_cnt, app.idle_cnt, app.clock_rate,
+	   app.ptime, (app.resample ? "on" : "off"), app.thread_cnt,
+	   app.active_cnt);
+    printf("%-8s %12s %10s %8s\n", "impl", "usec/tick", "CPU", "speedup");
+
+    for (i=0; i<PJ_ARRAY_SIZE(impls); ++i) {
+	const char *name = pjmedia_mix_impl_name(impls[i]);
+	double nsec;
+
+	if (pj_ansi_strcmp(app.impl, "all") != 0 &&
+	    pj_ansi_strcmp(app.impl, name) != 0)
+	{
+	    continue;
+	}
+	/* "auto" is one of the others, only run it when asked */
+	if (impls[i] == PJMEDIA_MIX_IMPL_AUTO &&
+	    pj_ansi_strcmp(app.impl, "all") == 0)
+	{
+	    continue;
+	}
+	if (pjmedia_mix_set_impl(impls[i]) != PJ_SUCCESS)
+	    continue;
 
-    /* Create master port */
-    status = pjmedia_master_port_create(pool, null_port, conf_port, 0, &master_port);
-
-
-    pjmedia_master_port_start(master_port);
-
-    puts("Waiting to settle.."); fflush(stdout);
-    pj_thread_sleep(5000);
-
-
-    benchmark();
+	nsec = benchmark(conf_port, buf, samples_per_frame);
+	if (base_nsec == 0)
+	    base_nsec = nsec;
 
+	printf("%-8s %12.2f %9.2f%% %7.2fx\n",
+	       pjmedia_mix_impl_name(pjmedia_mix_get_impl()), nsec / 1000.0,
+	       nsec / 10000.0 / app.ptime, base_nsec / nsec);
+    }
 
     /* Done. */
+    pjmedia_conf_destroy(conf);
+    pjmedia_endpt_destroy(med_endpt);
+    pj_pool_release(pool);
+    pj_caching_pool_destroy(&cp);
+    pj_shutdown();
+
     return 0;
 }
-
-
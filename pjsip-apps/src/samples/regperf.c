@@ -0,0 +1,632 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/**
+ * \page page_pjsip_regperf_c Samples: Registrar Performance Benchmark
+ *
+ * <b>regperf</b> measures the number of REGISTER requests per second
+ * that can be processed by the PJSIP registrar module (see
+ * \ref PJSIP_REGISTRAR) or by other registrar. Like pjsip-perf, it
+ * consists of two parts:
+ *  - the server, which runs the registrar module, and
+ *  - the client, which registers a number of address of records and
+ *    then refreshes them for several rounds.
+ *
+ * Both parts can run in a single program to measure the performance
+ * when the client and registrar are co-located.
+ *
+ * The first round creates new bindings, while the subsequent rounds only
+ * refresh them, which can be processed statelessly by the registrar when
+ * started with <b>--stateless-refresh</b>.
+ *
+ * This file is pjsip-apps/src/samples/regperf.c
+ *
+ * \includelineno regperf.c
+ */
+
+#include <pjsip.h>
+#include <pjsip_ua.h>
+#include <pjlib-util.h>
+#include <pjlib.h>
+#include <stdio.h>
+
+#define THIS_FILE	    "regperf.c"
+#define DEFAULT_COUNT	    (pjsip_cfg()->tsx.max_count/2>10000?10000:pjsip_cfg()->tsx.max_count/2)
+#define JOB_WINDOW	    1000
+
+
+/* Registration state of a user */
+struct user
+{
+    pj_str_t		 aor;
+    pj_str_t		 contact;
+    pj_str_t		 call_id;
+    pj_int32_t		 cseq;
+};
+
+
+static struct app
+{
+    pj_caching_pool	 cp;
+    pj_pool_t		*pool;
+    pjsip_endpoint	*sip_endpt;
+    pj_str_t		 local_addr;
+    int			 local_port;
+    int			 log_level;
+
+    pj_bool_t		 thread_quit;
+    unsigned		 thread_count;
+    pj_thread_t		*thread[16];
+
+    struct {
+	pj_bool_t	 enabled;
+	pj_bool_t	 stateless_refresh;
+	char		*snapshot;
+	pjsip_registrar	*reg;
+    } server;
+
+    struct {
+	pj_str_t	 dst_uri;
+	pj_str_t	 domain;
+	unsigned	 count;
+	unsigned	 rounds;
+	unsigned	 window;
+	unsigned	 expires;
+	unsigned	 timeout;
+	struct user	*users;
+	pj_atomic_t	*finished;
+	unsigned	 response_codes[800];
+	pj_lock_t	*lock;
+    } client;
+} app;
+
+
+static void app_perror(const char *sender, const char *title,
+		       pj_status_t status)
+{
+    char errmsg[PJ_ERR_MSG_SIZE];
+
+    pj_strerror(status, errmsg, sizeof(errmsg));
+    PJ_LOG(1,(sender, "%s: %s [code=%d]", title, errmsg, status));
+}
+
+
+static int my_atoi(const char *s)
+{
+    pj_str_t ss = pj_str((char*)s);
+    return pj_strtoul(&ss);
+}
+
+
+static void usage(void)
+{
+    printf(
+	"Usage:\n"
+	"   regperf [OPTIONS]        -- to start as registrar\n"
+	"   regperf [OPTIONS] URL    -- to register to URL (possibly itself)\n"
+	"\n"
+	"where:\n"
+	"   URL                     The SIP URL of the registrar.\n"
+	"\n"
+	"Client options:\n"
+	"   --count=N, -c           Set number of address of records to register\n"
+	"                           [default=%d]\n"
+	"   --rounds=N, -r          Set number of rounds; rounds after the first\n"
+	"                           refresh the bindings [default=3]\n"
+	"   --window=COUNT, -w      Set maximum outstanding requests [default: %d]\n"
+	"   --expires=SEC, -e       Set registration interval [default=3600]\n"
+	"   --timeout=SEC, -t       Set client timeout [default=60 sec]\n"
+	"\n"
+	"Server options:\n"
+	"   --stateless-refresh, -s Process refreshes statelessly [default: no]\n"
+	"   --snapshot=FILE         Persist bindings to FILE [default: none]\n"
+	"   --no-server             Don't run the registrar, even when URL is\n"
+	"                           specified\n"
+	"\n"
+	"Client and Server options:\n"
+	"   --local-port=PORT, -p   Set local port [default: 5060]\n"
+	"   --thread-count=N        Set number of worker threads [default=1]\n"
+	"\n"
+	"Misc options:\n"
+	"   --help, -h              Display this screen\n"
+	"   --verbose, -v           Verbose logging (put more than once for even more)\n",
+	DEFAULT_COUNT, JOB_WINDOW);
+}
+
+
+static pj_status_t init_options(int argc, char *argv[])
+{
+    enum { OPT_THREAD_COUNT = 1, OPT_SNAPSHOT, OPT_NO_SERVER };
+    struct pj_getopt_option long_options[] = {
+	{ "local-port",	       1, 0, 'p' },
+	{ "count",	       1, 0, 'c' },
+	{ "rounds",	       1, 0, 'r' },
+	{ "window",	       1, 0, 'w' },
+	{ "expires",	       1, 0, 'e' },
+	{ "timeout",	       1, 0, 't' },
+	{ "stateless-refresh", 0, 0, 's' },
+	{ "snapshot",	       1, 0, OPT_SNAPSHOT },
+	{ "no-server",	       0, 0, OPT_NO_SERVER },
+	{ "thread-count",      1, 0, OPT_THREAD_COUNT },
+	{ "help",	       0, 0, 'h' },
+	{ "verbose",	       0, 0, 'v' },
+	{ NULL, 0, 0, 0 },
+    };
+    pj_bool_t no_server = PJ_FALSE;
+    int c;
+    int option_index;
+
+    app.local_port = 5060;
+    app.thread_count = 1;
+    app.log_level = 3;
+    app.client.count = DEFAULT_COUNT;
+    app.client.rounds = 3;
+    app.client.window = JOB_WINDOW;
+    app.client.expires = 3600;
+    app.client.timeout = 60;
+
+    pj_optind = 0;
+    while((c=pj_getopt_long(argc,argv, "p:c:r:w:e:t:shv",
+			    long_options, &option_index))!=-1)
+    {
+	switch (c) {
+	case 'p':
+	    app.local_port = my_atoi(pj_optarg);
+	    if (app.local_port < 0 || app.local_port > 65535) {
+		PJ_LOG(3,(THIS_FILE, "Invalid --local-port %s", pj_optarg));
+		return -1;
+	    }
+	    break;
+
+	case 'c':
+	    app.client.count = my_atoi(pj_optarg);
+	    if (app.client.count == 0) {
+		PJ_LOG(3,(THIS_FILE, "Invalid --count %s", pj_optarg));
+		return -1;
+	    }
+	    break;
+
+	case 'r':
+	    app.client.rounds = my_atoi(pj_optarg);
+	    if (app.client.rounds == 0) {
+		PJ_LOG(3,(THIS_FILE, "Invalid --rounds %s", pj_optarg));
+		return -1;
+	    }
+	    break;
+
+	case 'w':
+	    app.client.window = my_atoi(pj_optarg);
+	    if (app.client.window == 0) {
+		PJ_LOG(3,(THIS_FILE, "Invalid --window %s", pj_optarg));
+		return -1;
+	    }
+	    break;
+
+	case 'e':
+	    app.client.expires = my_atoi(pj_optarg);
+	    break;
+
+	case 't':
+	    app.client.timeout = my_atoi(pj_optarg);
+	    if (app.client.timeout == 0 || app.client.timeout > 600) {
+		PJ_LOG(3,(THIS_FILE, "Invalid --timeout %s", pj_optarg));
+		return -1;
+	    }
+	    break;
+
+	case 's':
+	    app.server.stateless_refresh = PJ_TRUE;
+	    break;
+
+	case OPT_SNAPSHOT:
+	    app.server.snapshot = pj_optarg;
+	    break;
+
+	case OPT_NO_SERVER:
+	    no_server = PJ_TRUE;
+	    break;
+
+	case OPT_THREAD_COUNT:
+	    app.thread_count = my_atoi(pj_optarg);
+	    if (app.thread_count < 1 || app.thread_count > 16) {
+		PJ_LOG(3,(THIS_FILE, "Invalid --thread-count %s", pj_optarg));
+		return -1;
+	    }
+	    break;
+
+	case 'h':
+	    usage();
+	    return -1;
+
+	case 'v':
+	    app.log_level++;
+	    break;
+
+	default:
+	    PJ_LOG(1,(THIS_FILE,
+		      "Invalid argument. Use --help to see help"));
+	    return -1;
+	}
+    }
+
+    if (pj_optind != argc) {
+	app.client.dst_uri = pj_str(argv[pj_optind]);
+	pj_optind++;
+    }
+
+    if (pj_optind != argc) {
+	PJ_LOG(1,(THIS_FILE, "Error: unknown options %s", argv[pj_optind]));
+	return -1;
+    }
+
+    app.server.enabled = !no_server;
+    return 0;
+}
+
+
+static pj_status_t init_sip(void)
+{
+    pj_sockaddr_in addr;
+    pjsip_transport *tp;
+    pj_status_t status;
+
+    status = pj_init();
+    if (status != PJ_SUCCESS) {
+	app_perror(THIS_FILE, "Error initializing pjlib", status);
+	return status;
+    }
+
+    status = pjlib_util_init();
+    PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
+
+    pj_caching_pool_init(&app.cp, &pj_pool_factory_default_policy, 0);
+    app.pool = pj_pool_create(&app.cp.factory, "app", 1000, 1000, NULL);
+
+    status = pjsip_endpt_create(&app.cp.factory, pj_gethostname()->ptr,
+				&app.sip_endpt);
+    PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
+
+    pj_sockaddr_in_init(&addr, NULL, (pj_uint16_t)app.local_port);
+    status = pjsip_udp_transport_start(app.sip_endpt, &addr, NULL,
+				       app.thread_count, &tp);
+    if (status != PJ_SUCCESS) {
+	app_perror(THIS_FILE, "Unable to start transport", status);
+	return status;
+    }
+    app.local_addr = tp->local_name.host;
+    app.local_port = tp->local_name.port;
+
+    status = pjsip_tsx_layer_init_module(app.sip_endpt);
+    PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
+
+    status = pjsip_ua_init_module(app.sip_endpt, NULL);
+    PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
+
+    if (app.server.enabled) {
+	pjsip_registrar_setting setting;
+
+	pjsip_registrar_setting_default(&setting);
+	setting.stateless_refresh = app.server.stateless_refresh;
+	if (app.server.snapshot)
+	    setting.snapshot_file = pj_str(app.server.snapshot);
+
+	status = pjsip_registrar_create(app.sip_endpt, &setting, NULL,
+					&app.server.reg);
+	if (status != PJ_SUCCESS) {
+	    app_perror(THIS_FILE, "Unable to create registrar", status);
+	    return status;
+	}
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+static void destroy_app(void)
+{
+    unsigned i;
+
+    app.thread_quit = PJ_TRUE;
+    for (i=0; i<app.thread_count; ++i) {
+	if (app.thread[i]) {
+	    pj_thread_join(app.thread[i]);
+	    pj_thread_destroy(app.thread[i]);
+	    app.thread[i] = NULL;
+	}
+    }
+
+    if (app.server.reg) {
+	pjsip_registrar_destroy(app.server.reg);
+	app.server.reg = NULL;
+    }
+
+    if (app.sip_endpt) {
+	pjsip_endpt_destroy(app.sip_endpt);
+	app.sip_endpt = NULL;
+    }
+
+    if (app.pool) {
+	pj_pool_release(app.pool);
+	app.pool = NULL;
+	pj_caching_pool_destroy(&app.cp);
+    }
+
+    pj_shutdown();
+}
+
+
+/* Worker thread to poll the endpoint */
+static int worker_thread(void *arg)
+{
+    pj_time_val timeout = { 0, 10 };
+
+    PJ_UNUSED_ARG(arg);
+
+    while (!app.thread_quit) {
+	pjsip_endpt_handle_events(app.sip_endpt, &timeout);
+    }
+
+    return 0;
+}
+
+
+/* Create the users to be registered */
+static pj_status_t init_users(void)
+{
+    pjsip_sip_uri *dst;
+    pj_str_t tmp;
+    unsigned i;
+    pj_status_t status;
+
+    pj_strdup_with_null(app.pool, &tmp, &app.client.dst_uri);
+    dst = (pjsip_sip_uri*) pjsip_parse_uri(app.pool, tmp.ptr, tmp.slen, 0);
+    if (!dst || (!PJSIP_URI_SCHEME_IS_SIP(dst) &&
+		 !PJSIP_URI_SCHEME_IS_SIPS(dst)))
+    {
+	PJ_LOG(1,(THIS_FILE, "Invalid SIP URI %s", app.client.dst_uri.ptr));
+	return PJ_EINVAL;
+    }
+    app.client.domain = ((pjsip_sip_uri*)pjsip_uri_get_uri(dst))->host;
+
+    app.client.users = (struct user*)
+		       pj_pool_calloc(app.pool, app.client.count,
+				      sizeof(struct user));
+
+    for (i=0; i<app.client.count; ++i) {
+	struct user *u = &app.client.users[i];
+	char buf[128];
+
+	pj_ansi_snprintf(buf, sizeof(buf), "<sip:user%u@%.*s>", i,
+			 (int)app.client.domain.slen, app.client.domain.ptr);
+	pj_strdup2(app.pool, &u->aor, buf);
+
+	pj_ansi_snprintf(buf, sizeof(buf), "<sip:user%u@%.*s:%d>", i,
+			 (int)app.local_addr.slen, app.local_addr.ptr,
+			 app.local_port);
+	pj_strdup2(app.pool, &u->contact, buf);
+
+	pj_ansi_snprintf(buf, sizeof(buf), "regperf-%u-%08x", i, pj_rand());
+	pj_strdup2(app.pool, &u->call_id, buf);
+
+	u->cseq = 1;
+    }
+
+    status = pj_atomic_create(app.pool, 0, &app.client.finished);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    return pj_lock_create_simple_mutex(app.pool, "regperf",
+				       &app.client.lock);
+}
+
+
+/* Callback when REGISTER transaction completes */
+static void tsx_completion_cb(void *token, pjsip_event *event)
+{
+    pjsip_transaction *tsx = event->body.tsx_state.tsx;
+
+    PJ_UNUSED_ARG(token);
+
+    pj_lock_acquire(app.client.lock);
+    if (tsx->status_code >= 200 && tsx->status_code < 800)
+	app.client.response_codes[tsx->status_code]++;
+    pj_lock_release(app.client.lock);
+
+    pj_atomic_inc(app.client.finished);
+}
+
+
+/* Send REGISTER for the user */
+static pj_status_t submit_job(struct user *u)
+{
+    pjsip_tx_data *tdata;
+    pjsip_expires_hdr *h_expires;
+    pj_status_t status;
+
+    status = pjsip_endpt_create_request(app.sip_endpt,
+					pjsip_get_register_method(),
+					&app.client.dst_uri, &u->aor,
+					&u->aor, &u->contact, &u->call_id,
+					u->cseq++, NULL, &tdata);
+    if (status != PJ_SUCCESS) {
+	app_perror(THIS_FILE, "Error creating request", status);
+	return status;
+    }
+
+    h_expires = pjsip_expires_hdr_create(tdata->pool, app.client.expires);
+    pjsip_msg_add_hdr(tdata->msg, (pjsip_hdr*)h_expires);
+
+    return pjsip_endpt_send_request(app.sip_endpt, tdata, -1, NULL,
+				    &tsx_completion_cb);
+}
+
+
+static const char *good_number(char *buf, pj_int32_t val)
+{
+    if (val < 1000) {
+	pj_ansi_sprintf(buf, "%d", val);
+    } else if (val < 1000000) {
+	pj_ansi_sprintf(buf, "%d.%dK",
+			val / 1000,
+			(val % 1000) / 100);
+    } else {
+	pj_ansi_sprintf(buf, "%d.%02dM",
+			val / 1000000,
+			(val % 1000000) / 10000);
+    }
+
+    return buf;
+}
+
+
+/* Run one round of registrations */
+static pj_status_t run_round(unsigned round)
+{
+    pj_time_val start, now, last_progress, elapsed;
+    unsigned submitted = 0, finished, last_finished = 0;
+    unsigned msec, i;
+    char buf[32];
+
+    pj_atomic_set(app.client.finished, 0);
+    pj_bzero(app.client.response_codes, sizeof(app.client.response_codes));
+
+    pj_gettimeofday(&start);
+    last_progress = start;
+
+    for (;;) {
+	pj_time_val timeout = { 0, 0 };
+
+	finished = (unsigned)pj_atomic_get(app.client.finished);
+	if (finished == app.client.count)
+	    break;
+
+	while (submitted < app.client.count &&
+	       submitted - finished < app.client.window)
+	{
+	    if (submit_job(&app.client.users[submitted]) != PJ_SUCCESS)
+		pj_atomic_inc(app.client.finished);
+	    ++submitted;
+	}
+
+	pj_gettimeofday(&now);
+	if (finished != last_finished) {
+	    last_finished = finished;
+	    last_progress = now;
+	} else if (now.sec - last_progress.sec > (long)app.client.timeout) {
+	    PJ_LOG(1,(THIS_FILE, "Round %u timed out with %u of %u "
+		      "requests completed", round, finished,
+		      app.client.count));
+	    return PJ_ETIMEDOUT;
+	}
+
+	pjsip_endpt_handle_events(app.sip_endpt, &timeout);
+    }
+
+    pj_gettimeofday(&now);
+    elapsed = now;
+    PJ_TIME_VAL_SUB(elapsed, start);
+    msec = PJ_TIME_VAL_MSEC(elapsed);
+    if (msec == 0)
+	msec = 1;
+
+    PJ_LOG(3,(THIS_FILE, "Round %u (%s): %u REGISTER in %u.%03us, "
+	      "%s REGISTER/s", round, (round == 1 ? "register" : "refresh"),
+	      app.client.count, msec / 1000, msec % 1000,
+	      good_number(buf, (pj_int32_t)((pj_uint64_t)app.client.count *
+					    1000 / msec))));
+
+    for (i=0; i<PJ_ARRAY_SIZE(app.client.response_codes); ++i) {
+	if (app.client.response_codes[i] == 0)
+	    continue;
+	PJ_LOG(3,(THIS_FILE, "   %d responses: %u", i,
+		  app.client.response_codes[i]));
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+int main(int argc, char *argv[])
+{
+    unsigned i;
+    pj_status_t status;
+
+    if (init_options(argc, argv) != 0)
+	return 1;
+
+    pj_log_set_level(app.log_level);
+
+    if (init_sip() != PJ_SUCCESS) {
+	destroy_app();
+	return 1;
+    }
+
+    for (i=0; i<app.thread_count; ++i) {
+	status = pj_thread_create(app.pool, "worker%p", &worker_thread,
+				  NULL, 0, 0, &app.thread[i]);
+	if (status != PJ_SUCCESS) {
+	    app_perror(THIS_FILE, "Unable to create thread", status);
+	    destroy_app();
+	    return 1;
+	}
+    }
+
+    if (app.client.dst_uri.slen) {
+	if (init_users() != PJ_SUCCESS) {
+	    destroy_app();
+	    return 1;
+	}
+
+	PJ_LOG(3,(THIS_FILE, "Registering %u AORs to %.*s, %u rounds, "
+		  "window %u", app.client.count,
+		  (int)app.client.dst_uri.slen, app.client.dst_uri.ptr,
+		  app.client.rounds, app.client.window));
+
+	for (i=0; i<app.client.rounds; ++i) {
+	    if (run_round(i+1) != PJ_SUCCESS)
+		break;
+	}
+
+	if (app.server.reg) {
+	    unsigned aor_cnt, binding_cnt;
+
+	    pjsip_registrar_get_count(app.server.reg, &aor_cnt,
+				      &binding_cnt);
+	    PJ_LOG(3,(THIS_FILE, "Registrar has %u AORs with %u bindings",
+		      aor_cnt, binding_cnt));
+	}
+
+    } else {
+	char line[10];
+
+	PJ_LOG(3,(THIS_FILE, "Registrar is listening on %.*s:%d",
+		  (int)app.local_addr.slen, app.local_addr.ptr,
+		  app.local_port));
+	puts("Press <ENTER> to quit");
+	fflush(stdout);
+	if (fgets(line, sizeof(line), stdin) == NULL) {
+	    puts("EOF while reading stdin, will quit now..");
+	}
+    }
+
+    destroy_app();
+    return 0;
+}
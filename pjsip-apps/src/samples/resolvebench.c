@@ -0,0 +1,542 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/**
+ * \page page_pjsip_resolvebench_c Samples: SIP Resolver Benchmark
+ *
+ * <b>resolvebench</b> measures the performance of the SIP server
+ * resolution (#pjsip_resolve()) offline. It runs the simple DNS server
+ * of PJLIB-UTIL in the same process as a stand-in for the real DNS
+ * servers, serving the records from a zone file (or a generated zone),
+ * optionally with simulated network latency and packet loss. The
+ * resolver is then driven at the specified rate, and the resolution
+ * latency and the resolver cache hit rate are reported at the end.
+ *
+ * Without zone file, the generated zone contains an SRV record
+ * "_sip._udp.sN.bench" pointing to "hN.bench" and an A record for
+ * "hN.bench", for N from zero to the number of names minus one.
+ *
+ * This file is pjsip-apps/src/samples/resolvebench.c
+ *
+ * \includelineno resolvebench.c
+ */
+
+#include <pjsip.h>
+#include <pjlib-util.h>
+#include <pjlib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define THIS_FILE	    "resolvebench.c"
+#define MAX_TARGETS	    100000
+#define MAX_THREADS	    16
+#define MAX_SAMPLES	    (4*1024*1024)
+
+
+/* A resolution job */
+struct job
+{
+    pj_pool_t	    *pool;
+    pj_timestamp     start;
+};
+
+
+static struct app
+{
+    pj_caching_pool  cp;
+    pj_pool_t	    *pool;
+    pjsip_endpoint  *endpt;
+    pj_dns_server   *dns_srv;
+    pj_lock_t	    *lock;
+
+    /* Settings */
+    const char	    *zone_file;
+    unsigned	     name_count;
+    unsigned	     ttl;
+    pj_bool_t	     use_srv;
+    unsigned	     qps;
+    unsigned	     duration;
+    unsigned	     window;
+    unsigned	     delay;
+    unsigned	     jitter;
+    unsigned	     loss;
+    unsigned	     dns_port;
+    unsigned	     thread_count;
+    int		     log_level;
+
+    /* Targets to resolve */
+    unsigned	     target_cnt;
+    pjsip_host_info *targets;
+
+    /* Worker threads */
+    pj_bool_t	     quit;
+    pj_thread_t	    *threads[MAX_THREADS];
+
+    /* Results */
+    unsigned	     issued;
+    unsigned	     outstanding;
+    unsigned	     completed;
+    unsigned	     failed;
+    unsigned	     sample_cnt;
+    pj_uint32_t	    *samples;	    /* Latency samples, in usec	    */
+} app;
+
+
+static void app_perror(const char *title, pj_status_t status)
+{
+    char errmsg[PJ_ERR_MSG_SIZE];
+
+    pj_strerror(status, errmsg, sizeof(errmsg));
+    PJ_LOG(1,(THIS_FILE, "%s: %s", title, errmsg));
+}
+
+
+static void usage(void)
+{
+    printf(
+	"Usage:\n"
+	"   resolvebench [OPTIONS] [TARGET...]\n"
+	"\n"
+	"where TARGET is host name to resolve, optionally with :port. Without\n"
+	"port, DNS SRV resolution is performed. Targets must be given when\n"
+	"zone file is used, otherwise the names in the generated zone are used.\n"
+	"\n"
+	"Zone options:\n"
+	"   --zone=FILE, -z        Load the records from zone file\n"
+	"   --names=N, -n          Number of names in generated zone [default: 1000]\n"
+	"   --ttl=SEC              TTL of records in generated zone [default: 60]\n"
+	"   --srv                  Resolve generated names with DNS SRV rather\n"
+	"                          than DNS A [default: no]\n"
+	"\n"
+	"DNS server options:\n"
+	"   --delay=MSEC, -d       Delay the answers [default: 0]\n"
+	"   --jitter=MSEC, -j      Add random delay up to this value [default: 0]\n"
+	"   --loss=PCT, -l         Drop this percentage of queries [default: 0]\n"
+	"   --dns-port=PORT        DNS server port [default: 15353]\n"
+	"\n"
+	"Load options:\n"
+	"   --qps=N, -q            Resolutions per second [default: 1000]\n"
+	"   --duration=SEC, -t     Test duration [default: 10]\n"
+	"   --window=N, -w         Maximum outstanding resolutions [default: 1000]\n"
+	"   --thread-count=N       Number of worker threads [default: 1]\n"
+	"   --verbose, -v          Increase log level\n"
+	"   --help, -h             Show this help screen\n"
+	);
+}
+
+
+static int init_options(int argc, char *argv[])
+{
+    enum { OPT_TTL = 1, OPT_SRV, OPT_DNS_PORT, OPT_THREAD_COUNT };
+    struct pj_getopt_option long_options[] = {
+	{ "zone",	    1, 0, 'z' },
+	{ "names",	    1, 0, 'n' },
+	{ "ttl",	    1, 0, OPT_TTL },
+	{ "srv",	    0, 0, OPT_SRV },
+	{ "delay",	    1, 0, 'd' },
+	{ "jitter",	    1, 0, 'j' },
+	{ "loss",	    1, 0, 'l' },
+	{ "dns-port",	    1, 0, OPT_DNS_PORT },
+	{ "qps",	    1, 0, 'q' },
+	{ "duration",	    1, 0, 't' },
+	{ "window",	    1, 0, 'w' },
+	{ "thread-count",   1, 0, OPT_THREAD_COUNT },
+	{ "verbose",	    0, 0, 'v' },
+	{ "help",	    0, 0, 'h' },
+	{ NULL, 0, 0, 0 },
+    };
+    int c, option_index;
+
+    app.name_count = 1000;
+    app.ttl = 60;
+    app.qps = 1000;
+    app.duration = 10;
+    app.window = 1000;
+    app.dns_port = 15353;
+    app.thread_count = 1;
+    app.log_level = 3;
+
+    pj_optind = 0;
+    while ((c=pj_getopt_long(argc, argv, "z:n:d:j:l:q:t:w:vh",
+			     long_options, &option_index)) != -1)
+    {
+	switch (c) {
+	case 'z':
+	    app.zone_file = pj_optarg;
+	    break;
+	case 'n':
+	    app.name_count = atoi(pj_optarg);
+	    if (app.name_count < 1 || app.name_count > MAX_TARGETS) {
+		PJ_LOG(1,(THIS_FILE, "Invalid --names %s", pj_optarg));
+		return -1;
+	    }
+	    break;
+	case OPT_TTL:
+	    app.ttl = atoi(pj_optarg);
+	    break;
+	case OPT_SRV:
+	    app.use_srv = PJ_TRUE;
+	    break;
+	case 'd':
+	    app.delay = atoi(pj_optarg);
+	    break;
+	case 'j':
+	    app.jitter = atoi(pj_optarg);
+	    break;
+	case 'l':
+	    app.loss = atoi(pj_optarg);
+	    if (app.loss > 100) {
+		PJ_LOG(1,(THIS_FILE, "Invalid --loss %s", pj_optarg));
+		return -1;
+	    }
+	    break;
+	case OPT_DNS_PORT:
+	    app.dns_port = atoi(pj_optarg);
+	    break;
+	case 'q':
+	    app.qps = atoi(pj_optarg);
+	    if (app.qps < 1) {
+		PJ_LOG(1,(THIS_FILE, "Invalid --qps %s", pj_optarg));
+		return -1;
+	    }
+	    break;
+	case 't':
+	    app.duration = atoi(pj_optarg);
+	    break;
+	case 'w':
+	    app.window = atoi(pj_optarg);
+	    break;
+	case OPT_THREAD_COUNT:
+	    app.thread_count = atoi(pj_optarg);
+	    if (app.thread_count < 1 || app.thread_count > MAX_THREADS) {
+		PJ_LOG(1,(THIS_FILE, "Invalid --thread-count %s", pj_optarg));
+		return -1;
+	    }
+	    break;
+	case 'v':
+	    app.log_level++;
+	    break;
+	case 'h':
+	    usage();
+	    return -1;
+	default:
+	    PJ_LOG(1,(THIS_FILE, "Invalid argument. Use --help to see help"));
+	    return -1;
+	}
+    }
+
+    /* Targets */
+    if (pj_optind < argc) {
+	int i;
+
+	app.targets = (pjsip_host_info*)
+		      pj_pool_calloc(app.pool, argc - pj_optind,
+				     sizeof(pjsip_host_info));
+	for (i=pj_optind; i<argc; ++i) {
+	    pjsip_host_info *t = &app.targets[app.target_cnt++];
+	    char *colon = strchr(argv[i], ':');
+
+	    t->type = PJSIP_TRANSPORT_UNSPECIFIED;
+	    t->addr.host = pj_str(argv[i]);
+	    if (colon) {
+		t->addr.host.slen = colon - argv[i];
+		t->addr.port = atoi(colon+1);
+	    }
+	}
+    } else if (app.zone_file) {
+	PJ_LOG(1,(THIS_FILE, "Targets must be given with --zone"));
+	return -1;
+    }
+
+    return 0;
+}
+
+
+/* Build the zone when zone file is not given */
+static pj_status_t generate_zone(void)
+{
+    char *buf, *p;
+    unsigned i;
+    pj_str_t zone;
+
+    buf = p = (char*) pj_pool_alloc(app.pool, app.name_count * 128);
+    app.targets = (pjsip_host_info*)
+		  pj_pool_calloc(app.pool, app.name_count,
+				 sizeof(pjsip_host_info));
+
+    for (i=0; i<app.name_count; ++i) {
+	pjsip_host_info *t = &app.targets[i];
+	char name[32];
+	int len;
+
+	len = pj_ansi_sprintf(p,
+			      "_sip._udp.s%u.bench %u IN SRV 0 0 5060 h%u.bench.\n"
+			      "h%u.bench %u IN A 10.%u.%u.%u\n",
+			      i, app.ttl, i, i, app.ttl,
+			      (i >> 16) & 0xFF, (i >> 8) & 0xFF, i & 0xFF);
+	p += len;
+
+	pj_ansi_sprintf(name, "%c%u.bench", (app.use_srv ? 's' : 'h'), i);
+	t->type = PJSIP_TRANSPORT_UNSPECIFIED;
+	pj_strdup2(app.pool, &t->addr.host, name);
+	t->addr.port = app.use_srv ? 0 : 5060;
+    }
+    app.target_cnt = app.name_count;
+
+    zone.ptr = buf;
+    zone.slen = p - buf;
+    return pj_dns_server_parse_zone(app.dns_srv, &zone, NULL);
+}
+
+
+/* Worker thread to poll the endpoint */
+static int worker_thread(void *arg)
+{
+    PJ_UNUSED_ARG(arg);
+
+    while (!app.quit) {
+	pj_time_val timeout = {0, 10};
+	pjsip_endpt_handle_events(app.endpt, &timeout);
+    }
+
+    return 0;
+}
+
+
+/* Called when resolution completes */
+static void resolver_cb(pj_status_t status, void *token,
+			const struct pjsip_server_addresses *addr)
+{
+    struct job *job = (struct job*) token;
+    pj_timestamp now;
+    pj_uint32_t usec;
+
+    PJ_UNUSED_ARG(addr);
+
+    pj_get_timestamp(&now);
+    usec = pj_elapsed_usec(&job->start, &now);
+
+    pj_lock_acquire(app.lock);
+    ++app.completed;
+    --app.outstanding;
+    if (status != PJ_SUCCESS)
+	++app.failed;
+    else if (app.sample_cnt < MAX_SAMPLES)
+	app.samples[app.sample_cnt++] = usec;
+    pj_lock_release(app.lock);
+
+    pjsip_endpt_release_pool(app.endpt, job->pool);
+}
+
+
+/* Start one resolution */
+static void start_job(void)
+{
+    struct job *job;
+    pj_pool_t *pool;
+    unsigned idx;
+
+    pool = pjsip_endpt_create_pool(app.endpt, "job", 512, 512);
+    job = PJ_POOL_ZALLOC_T(pool, struct job);
+    job->pool = pool;
+
+    idx = (unsigned)pj_rand() % app.target_cnt;
+
+    pj_lock_acquire(app.lock);
+    ++app.issued;
+    ++app.outstanding;
+    pj_lock_release(app.lock);
+
+    pj_get_timestamp(&job->start);
+    pjsip_endpt_resolve(app.endpt, pool, &app.targets[idx], job,
+			&resolver_cb);
+}
+
+
+static int cmp_u32(const void *a, const void *b)
+{
+    pj_uint32_t x = *(const pj_uint32_t*)a, y = *(const pj_uint32_t*)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+
+static pj_uint32_t percentile(double pct)
+{
+    unsigned idx;
+
+    if (app.sample_cnt == 0)
+	return 0;
+
+    idx = (unsigned)(app.sample_cnt * pct / 100.0);
+    if (idx >= app.sample_cnt)
+	idx = app.sample_cnt - 1;
+    return app.samples[idx];
+}
+
+
+static void report(unsigned elapsed_msec)
+{
+    pj_dns_server_stat stat;
+    double hit_rate = 0;
+
+    pj_dns_server_get_stat(app.dns_srv, &stat);
+    qsort(app.samples, app.sample_cnt, sizeof(app.samples[0]), &cmp_u32);
+
+    if (app.completed && stat.rx < app.completed)
+	hit_rate = 100.0 * (app.completed - stat.rx) / app.completed;
+
+    printf("Resolutions : %u issued, %u completed, %u failed in %u ms "
+	   "(%u/sec)\n",
+	   app.issued, app.completed, app.failed, elapsed_msec,
+	   (unsigned)(app.completed * 1000.0 / (elapsed_msec ? elapsed_msec:1)));
+    printf("Latency(us) : p50=%u p90=%u p99=%u p99.9=%u max=%u\n",
+	   percentile(50), percentile(90), percentile(99), percentile(99.9),
+	   percentile(100));
+    printf("DNS server  : %u queries, %u answers, %u dropped, "
+	   "%u NXDOMAIN\n",
+	   stat.rx, stat.tx, stat.dropped, stat.nxdomain);
+    printf("Cache       : %.2f queries/resolution, hit rate %.1f%%\n",
+	   (app.completed ? (double)stat.rx / app.completed : 0.0), hit_rate);
+}
+
+
+int main(int argc, char *argv[])
+{
+    pj_dns_resolver *resv;
+    pj_str_t nameserver = pj_str("127.0.0.1");
+    pj_uint16_t port;
+    pj_time_val start, now;
+    unsigned i, elapsed;
+    pj_status_t status;
+
+    pj_init();
+    pjlib_util_init();
+    pj_caching_pool_init(&app.cp, &pj_pool_factory_default_policy, 0);
+    app.pool = pj_pool_create(&app.cp.factory, "app", 4000, 4000, NULL);
+
+    if (init_options(argc, argv) != 0)
+	return 1;
+
+    pj_log_set_level(app.log_level);
+
+    status = pjsip_endpt_create(&app.cp.factory, NULL, &app.endpt);
+    if (status != PJ_SUCCESS) {
+	app_perror("Error creating endpoint", status);
+	return 1;
+    }
+
+    status = pj_lock_create_simple_mutex(app.pool, "app", &app.lock);
+    if (status != PJ_SUCCESS)
+	return 1;
+
+    app.samples = (pj_uint32_t*) malloc(MAX_SAMPLES * sizeof(pj_uint32_t));
+
+    /* DNS server */
+    status = pj_dns_server_create(&app.cp.factory,
+				  pjsip_endpt_get_ioqueue(app.endpt),
+				  pj_AF_INET(), app.dns_port, 0, &app.dns_srv);
+    if (status != PJ_SUCCESS) {
+	app_perror("Error creating DNS server", status);
+	return 1;
+    }
+
+    if (app.zone_file) {
+	unsigned cnt;
+
+	status = pj_dns_server_load_zone(app.dns_srv, app.zone_file, &cnt);
+	if (status == PJ_SUCCESS)
+	    PJ_LOG(3,(THIS_FILE, "%u records loaded from %s", cnt,
+		      app.zone_file));
+    } else {
+	status = generate_zone();
+    }
+    if (status != PJ_SUCCESS) {
+	app_perror("Error loading zone", status);
+	return 1;
+    }
+
+    status = pj_dns_server_set_impairment(app.dns_srv,
+					  pjsip_endpt_get_timer_heap(app.endpt),
+					  app.delay, app.jitter, app.loss);
+    if (status != PJ_SUCCESS) {
+	app_perror("Error setting DNS server impairment", status);
+	return 1;
+    }
+
+    /* Resolver */
+    status = pjsip_endpt_create_resolver(app.endpt, &resv);
+    if (status != PJ_SUCCESS) {
+	app_perror("Error creating resolver", status);
+	return 1;
+    }
+
+    port = (pj_uint16_t)app.dns_port;
+    pj_dns_resolver_set_ns(resv, 1, &nameserver, &port);
+    pjsip_endpt_set_resolver(app.endpt, resv);
+
+    for (i=0; i<app.thread_count; ++i) {
+	pj_thread_create(app.pool, "worker", &worker_thread, NULL, 0, 0,
+			 &app.threads[i]);
+    }
+
+    PJ_LOG(3,(THIS_FILE, "Resolving %u targets at %u/sec for %u seconds..",
+	      app.target_cnt, app.qps, app.duration));
+
+    /* Issue resolutions at the configured rate */
+    pj_gettickcount(&start);
+    do {
+	unsigned due;
+
+	pj_thread_sleep(1);
+	pj_gettickcount(&now);
+	PJ_TIME_VAL_SUB(now, start);
+	elapsed = PJ_TIME_VAL_MSEC(now);
+
+	due = (unsigned)((pj_uint64_t)app.qps * elapsed / 1000);
+	while (app.issued < due && app.outstanding < app.window)
+	    start_job();
+
+    } while (elapsed < app.duration * 1000);
+
+    /* Wait for outstanding resolutions */
+    for (i=0; i<100 && app.outstanding; ++i)
+	pj_thread_sleep(100);
+
+    report(elapsed);
+
+    app.quit = PJ_TRUE;
+    for (i=0; i<app.thread_count; ++i) {
+	if (app.threads[i]) {
+	    pj_thread_join(app.threads[i]);
+	    pj_thread_destroy(app.threads[i]);
+	}
+    }
+
+    pj_dns_server_destroy(app.dns_srv);
+    pjsip_endpt_destroy(app.endpt);
+    pj_lock_destroy(app.lock);
+    free(app.samples);
+    pj_pool_release(app.pool);
+    pj_caching_pool_destroy(&app.cp);
+    pj_shutdown();
+
+    return 0;
+}
@@ -188,6 +188,55 @@ struct pjsip_evsub_user
      */
     void (*on_server_timeout)(pjsip_evsub *sub);
 
+    /**
+     * This callback is called by #pjsip_evsub_hibernate() before the
+     * subscription is destroyed, to let the package or application save
+     * its own state of the subscription into the hibernation record.
+     * The hibernation may still fail after this callback returns, so the
+     * state of the subscription must not be released here (see
+     * \a on_hibernated()).
+     *
+     * This callback is OPTIONAL. If it is not implemented, nothing is
+     * saved besides the module data pointers of the subscription.
+     *
+     * @param sub	The subscription instance.
+     * @param buf	Buffer to write the state to.
+     * @param size	Size of the buffer.
+     *
+     * @return		Number of bytes written, or negative value to
+     *			refuse the hibernation.
+     */
+    int (*on_hibernate)(pjsip_evsub *sub, char *buf, unsigned size);
+
+    /**
+     * This callback is called by #pjsip_evsub_hibernate() once the
+     * hibernation record has been created, just before the subscription
+     * is destroyed, to let the package or application release the
+     * resources of the subscription instance. Module data cleared by
+     * this callback is not saved in the record.
+     *
+     * This callback is OPTIONAL.
+     *
+     * @param sub	The subscription instance.
+     */
+    void (*on_hibernated)(pjsip_evsub *sub);
+
+    /**
+     * This callback is called when a hibernated subscription has been
+     * rehydrated, either because a request has been received in the
+     * dialog, its timer has elapsed, or #pjsip_evsub_rehydrate() has been
+     * called. The subscription is a new instance, with the module data
+     * copied from the hibernated subscription, so application should
+     * update any reference it keeps to the old instance.
+     *
+     * This callback is OPTIONAL.
+     *
+     * @param sub	The new subscription instance.
+     * @param buf	The state saved by on_hibernate().
+     * @param len	Length of the state.
+     */
+    void (*on_rehydrate)(pjsip_evsub *sub, const char *buf, unsigned len);
+
 };
 
 
@@ -490,6 +539,71 @@ PJ_DECL(void) pjsip_evsub_set_mod_data( pjsip_evsub *sub, unsigned mod_id,
 PJ_DECL(void*) pjsip_evsub_get_mod_data( pjsip_evsub *sub, unsigned mod_id );
 
 
+/**
+ * Get the dialog of the event subscription.
+ *
+ * @param sub		The event subscription.
+ *
+ * @return		The dialog.
+ */
+PJ_DECL(pjsip_dialog*) pjsip_evsub_get_dlg( pjsip_evsub *sub );
+
+
+/**
+ * Hibernate an idle subscription. The dialog state, subscription state,
+ * expiration timer and the state saved by \a on_hibernate() callback are
+ * serialized into a compact record, after which the subscription and its
+ * dialog are destroyed (without calling \a on_evsub_state() callback and
+ * without sending any request), releasing their pools.
+ *
+ * The subscription is rehydrated into a new instance when a request is
+ * received in the dialog, when its refresh or timeout timer elapses, or
+ * when #pjsip_evsub_rehydrate() is called, and \a on_rehydrate() callback
+ * will be called with the new instance.
+ *
+ * Only subscription in PENDING or ACTIVE state without pending
+ * transaction, which is the only usage of its dialog, can be hibernated.
+ * Credentials and transport selector of the dialog are not saved, so
+ * application should set them again in \a on_rehydrate() callback if
+ * necessary.
+ *
+ * @param sub		The subscription.
+ *
+ * @return		PJ_SUCCESS if the subscription has been hibernated,
+ *			PJ_EBUSY if it is not idle, or PJ_ETOOBIG if the
+ *			record would exceed PJSIP_EVSUB_HIB_MAX_LEN.
+ */
+PJ_DECL(pj_status_t) pjsip_evsub_hibernate(pjsip_evsub *sub);
+
+
+/**
+ * Rehydrate hibernated subscription, e.g. to send NOTIFY from it. The
+ * subscription is identified by its dialog identification.
+ *
+ * @param call_id	The Call-ID of the dialog.
+ * @param local_tag	The local tag of the dialog.
+ * @param remote_tag	The remote tag of the dialog.
+ * @param p_evsub	Optional pointer to receive the new subscription
+ *			instance.
+ *
+ * @return		PJ_SUCCESS on success, or PJ_ENOTFOUND if no such
+ *			subscription is hibernated (e.g. it has been
+ *			rehydrated by incoming request).
+ */
+PJ_DECL(pj_status_t) pjsip_evsub_rehydrate(const pj_str_t *call_id,
+					   const pj_str_t *local_tag,
+					   const pj_str_t *remote_tag,
+					   pjsip_evsub **p_evsub);
+
+
+/**
+ * Get the number of currently hibernated subscriptions.
+ *
+ * @return		Number of hibernated subscriptions.
+ */
+PJ_DECL(unsigned) pjsip_evsub_get_hibernated_count(void);
+
+
 
 PJ_END_DECL
 
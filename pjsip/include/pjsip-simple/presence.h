@@ -405,6 +405,142 @@ PJ_DECL(pj_status_t) pjsip_pres_parse_xpidf2(char *body, unsigned body_len,
 
 
 
+/**
+ * @see pjsip_presentity
+ */
+typedef struct pjsip_presentity pjsip_presentity;
+
+
+/**
+ * Presentity settings.
+ */
+typedef struct pjsip_presentity_setting
+{
+    /**
+     * Throttle window, in milliseconds. Status changes occurring within
+     * this window after a NOTIFY fan-out are coalesced, and only the
+     * latest status is sent at the end of the window. Zero disables
+     * coalescing.
+     *
+     * Default: PJSIP_PRES_THROTTLE_MSEC
+     */
+    unsigned	    throttle_msec;
+
+    /**
+     * Number of worker threads to send NOTIFY requests to the watchers.
+     * If zero, NOTIFY requests are sent by the thread which triggers the
+     * fan-out, i.e. the thread calling #pjsip_presentity_set_status() or
+     * the timer thread.
+     *
+     * Default: PJSIP_PRES_FANOUT_WORKER_CNT
+     */
+    unsigned	    worker_cnt;
+
+} pjsip_presentity_setting;
+
+
+/**
+ * Initialize presentity setting with default values.
+ *
+ * @param setting	The setting to be initialized.
+ */
+PJ_DECL(void) pjsip_presentity_setting_default(
+				    pjsip_presentity_setting *setting);
+
+
+/**
+ * Create a presentity, which manages the presence status of a single
+ * entity on behalf of all server subscriptions (watchers) to that entity.
+ * When the status changes, the PIDF/X-PIDF document is rendered once and
+ * the encoded body is shared by the NOTIFY requests sent to all watchers,
+ * instead of rendering the document for every watcher as
+ * #pjsip_pres_notify() does.
+ *
+ * @param endpt		The endpoint instance.
+ * @param entity	The entity URI, which will be put in the presence
+ *			documents.
+ * @param setting	Presentity setting, or NULL to use default setting.
+ * @param p_pres	Pointer to receive the presentity.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_presentity_create(pjsip_endpoint *endpt,
+				    const pj_str_t *entity,
+				    const pjsip_presentity_setting *setting,
+				    pjsip_presentity **p_pres);
+
+
+/**
+ * Destroy the presentity. All watchers will be detached from the
+ * presentity, but their subscriptions are not terminated. If the throttle
+ * timer is being processed by another thread, this function waits until
+ * it has finished, so it must not be called with the lock of a watcher
+ * dialog held, nor from the presentity callbacks.
+ *
+ * @param pres		The presentity.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_presentity_destroy(pjsip_presentity *pres);
+
+
+/**
+ * Attach a server subscription created with #pjsip_pres_create_uas() to
+ * the presentity. Once attached, NOTIFY requests created for the
+ * subscription (e.g. with #pjsip_pres_notify()) will contain the status
+ * of the presentity, and NOTIFY requests will be sent to the subscription
+ * whenever the status of the presentity changes while the subscription
+ * is active. The subscription is detached automatically when it is
+ * terminated.
+ *
+ * @param pres		The presentity.
+ * @param sub		The server subscription.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_presentity_add_watcher(pjsip_presentity *pres,
+						  pjsip_evsub *sub);
+
+
+/**
+ * Detach server subscription from the presentity.
+ *
+ * @param pres		The presentity.
+ * @param sub		The server subscription.
+ *
+ * @return		PJ_SUCCESS on success, or PJ_ENOTFOUND if the
+ *			subscription is not attached to the presentity.
+ */
+PJ_DECL(pj_status_t) pjsip_presentity_remove_watcher(pjsip_presentity *pres,
+						     pjsip_evsub *sub);
+
+
+/**
+ * Get the number of watchers attached to the presentity.
+ *
+ * @param pres		The presentity.
+ *
+ * @return		Number of watchers.
+ */
+PJ_DECL(unsigned) pjsip_presentity_get_watcher_count(pjsip_presentity *pres);
+
+
+/**
+ * Set the presence status of the presentity, and send NOTIFY requests to
+ * all active watchers. If the previous fan-out occurred within the
+ * throttle window, the NOTIFY requests will be sent at the end of the
+ * window instead, carrying the latest status set.
+ *
+ * @param pres		The presentity.
+ * @param status	The new status.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_presentity_set_status(pjsip_presentity *pres,
+					    const pjsip_pres_status *status);
+
+
+
 /**
  * @}
  */
@@ -0,0 +1,277 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJSIP_SIP_REGISTRAR_H__
+#define __PJSIP_SIP_REGISTRAR_H__
+
+/**
+ * @file sip_registrar.h
+ * @brief SIP Registrar
+ */
+
+#include <pjsip/sip_types.h>
+#include <pjsip/sip_auth.h>
+
+
+/**
+ * @defgroup PJSIP_REGISTRAR Registrar
+ * @ingroup PJSIP_HIGH_UA
+ * @brief Registrar module with in-memory location service.
+ * @{
+ *
+ * This module implements the registrar behavior described in RFC 3261
+ * Section 10.3. Bindings are kept in memory, in a store which is divided
+ * into several shards, each with its own lock, so that REGISTER requests
+ * for different address of records can be processed in parallel by
+ * multiple worker threads. Expired bindings are removed by timers
+ * scheduled in the endpoint's timer heap.
+ *
+ * Optionally the bindings can be persisted to a snapshot file. Every
+ * binding change is appended to the file, and the file is compacted when
+ * the registrar is created and whenever #pjsip_registrar_save_snapshot()
+ * is called. The bindings are restored from the file when the registrar
+ * is created.
+ *
+ * Application may also enable stateless processing of registration
+ * refreshes, i.e. REGISTER requests that don't add or remove bindings.
+ * Such requests will be answered without creating UAS transaction, which
+ * is considerably cheaper. Retransmissions of these requests are handled
+ * by replaying the response.
+ *
+ * Application must link with <b>pjsip-ua</b> static library to use this
+ * API.
+ */
+
+
+PJ_BEGIN_DECL
+
+/** Typedef for registrar instance. */
+typedef struct pjsip_registrar pjsip_registrar;
+
+
+/**
+ * This structure describes a contact binding of an address of record.
+ */
+typedef struct pjsip_registrar_binding
+{
+    pj_str_t	aor;	    /**< The address of record.			*/
+    pj_str_t	contact;    /**< The contact URI.			*/
+    pj_str_t	call_id;    /**< Call-ID of the last REGISTER request.	*/
+    pj_int32_t	cseq;	    /**< CSeq of the last REGISTER request.	*/
+    int		q1000;	    /**< The "q" value times 1000, or zero if not
+				 specified.				*/
+    unsigned	expires;    /**< Number of seconds until the binding
+				 expires.				*/
+} pjsip_registrar_binding;
+
+
+/**
+ * Registrar callbacks.
+ */
+typedef struct pjsip_registrar_cb
+{
+    /**
+     * Notify application that a binding has been added, or removed either
+     * because of a REGISTER request or because it has expired. This
+     * callback is not called for registration refreshes.
+     *
+     * The callback is called with the lock of the address of record held,
+     * so application must not call registrar API from the callback.
+     *
+     * @param reg	The registrar.
+     * @param binding	The binding.
+     * @param removed	PJ_TRUE if the binding has been removed.
+     */
+    void (*on_binding_changed)(pjsip_registrar *reg,
+			       const pjsip_registrar_binding *binding,
+			       pj_bool_t removed);
+
+} pjsip_registrar_cb;
+
+
+/**
+ * Registrar settings.
+ */
+typedef struct pjsip_registrar_setting
+{
+    /**
+     * If not empty, only REGISTER requests with this host in the
+     * Request-URI will be processed by the registrar.
+     *
+     * Default: empty
+     */
+    pj_str_t	    domain;
+
+    /**
+     * Number of shards in the binding store.
+     *
+     * Default: PJSIP_REGISTRAR_SHARD_COUNT
+     */
+    unsigned	    shard_count;
+
+    /**
+     * Maximum number of contacts per address of record.
+     *
+     * Default: PJSIP_REGISTRAR_MAX_CONTACTS
+     */
+    unsigned	    max_contacts;
+
+    /**
+     * Minimum registration interval.
+     *
+     * Default: PJSIP_REGISTRAR_MIN_EXPIRES
+     */
+    unsigned	    min_expires;
+
+    /**
+     * Maximum registration interval. Longer intervals requested by clients
+     * will be reduced to this value.
+     *
+     * Default: PJSIP_REGISTRAR_MAX_EXPIRES
+     */
+    unsigned	    max_expires;
+
+    /**
+     * Registration interval to use when the request doesn't specify one.
+     *
+     * Default: PJSIP_REGISTRAR_MAX_EXPIRES
+     */
+    unsigned	    default_expires;
+
+    /**
+     * Answer registration refreshes statelessly.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t	    stateless_refresh;
+
+    /**
+     * If not empty, bindings will be persisted to this file.
+     *
+     * Default: empty
+     */
+    pj_str_t	    snapshot_file;
+
+    /**
+     * If set, requests will be authenticated with this server
+     * authentication instance before they are processed.
+     *
+     * Default: NULL
+     */
+    pjsip_auth_srv *auth_srv;
+
+    /**
+     * Module priority.
+     *
+     * Default: PJSIP_MOD_PRIORITY_APPLICATION
+     */
+    int		    priority;
+
+} pjsip_registrar_setting;
+
+
+/**
+ * Initialize registrar setting with default values.
+ *
+ * @param setting   The setting to be initialized.
+ */
+PJ_DECL(void) pjsip_registrar_setting_default(pjsip_registrar_setting *setting);
+
+
+/**
+ * Create the registrar and register it as module to the endpoint. Only
+ * one registrar may be created at a time.
+ *
+ * @param endpt	    The SIP endpoint.
+ * @param setting   Registrar setting, or NULL to use default setting.
+ * @param cb	    Optional callbacks.
+ * @param p_reg	    Pointer to receive the registrar.
+ *
+ * @return	    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_registrar_create(pjsip_endpoint *endpt,
+					    const pjsip_registrar_setting *setting,
+					    const pjsip_registrar_cb *cb,
+					    pjsip_registrar **p_reg);
+
+
+/**
+ * Unregister the registrar module and destroy the binding store. The
+ * snapshot file, if any, will be compacted before it is closed.
+ *
+ * @param reg	    The registrar.
+ *
+ * @return	    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_registrar_destroy(pjsip_registrar *reg);
+
+
+/**
+ * Get the contact bindings of an address of record.
+ *
+ * @param reg	    The registrar.
+ * @param aor	    The address of record, e.g. "sip:alice@example.com".
+ * @param pool	    Pool to allocate the strings of the bindings.
+ * @param count	    On input, the maximum number of bindings to return.
+ *		    On output, the number of bindings returned.
+ * @param bindings  Array to receive the bindings.
+ *
+ * @return	    PJ_SUCCESS on success, or PJ_ENOTFOUND if the address
+ *		    of record has no binding.
+ */
+PJ_DECL(pj_status_t) pjsip_registrar_lookup(pjsip_registrar *reg,
+					    const pj_str_t *aor,
+					    pj_pool_t *pool,
+					    unsigned *count,
+					    pjsip_registrar_binding bindings[]);
+
+
+/**
+ * Get the number of address of records and bindings currently in the
+ * binding store.
+ *
+ * @param reg	    The registrar.
+ * @param aor_cnt   Optional pointer to receive the number of address of
+ *		    records.
+ * @param binding_cnt Optional pointer to receive the number of bindings.
+ */
+PJ_DECL(void) pjsip_registrar_get_count(pjsip_registrar *reg,
+					unsigned *aor_cnt,
+					unsigned *binding_cnt);
+
+
+/**
+ * Rewrite the snapshot file with the current bindings, discarding
+ * records of bindings that have been updated or removed.
+ *
+ * @param reg	    The registrar.
+ *
+ * @return	    PJ_SUCCESS on success, or PJ_EINVALIDOP if snapshot is
+ *		    not enabled.
+ */
+PJ_DECL(pj_status_t) pjsip_registrar_save_snapshot(pjsip_registrar *reg);
+
+
+PJ_END_DECL
+
+/**
+ * @}
+ */
+
+#endif	/* __PJSIP_SIP_REGISTRAR_H__ */
@@ -309,6 +309,12 @@ typedef pj_status_t pjsip_auth_lookup_cred2(
 /** Flag to specify that server is a proxy. */
 #define PJSIP_AUTH_SRV_IS_PROXY	    1
 
+/**
+ * Opaque declaration of server authentication cache. See
+ * #pjsip_auth_srv_set_cache().
+ */
+typedef struct pjsip_auth_srv_cache pjsip_auth_srv_cache;
+
 /**
  * This structure describes server authentication information.
  */
@@ -319,9 +325,67 @@ typedef struct pjsip_auth_srv
     pjsip_auth_lookup_cred  *lookup;	/**< Lookup function.		    */
     pjsip_auth_lookup_cred2 *lookup2;	/**< Lookup function with additional
 					     info in its input param.	    */
+    pjsip_auth_srv_cache    *cache;	/**< Optional cache, see
+					     pjsip_auth_srv_set_cache().    */
 } pjsip_auth_srv;
 
 
+/**
+ * This structure describes the settings of server authentication cache.
+ * Use #pjsip_auth_srv_cache_setting_default() to initialize it.
+ */
+typedef struct pjsip_auth_srv_cache_setting
+{
+    /**
+     * Maximum number of credentials to keep in the cache. The cache keeps
+     * H(A1) of the accounts, so that neither the lookup function nor the
+     * hashing of the password is needed for subsequent requests from the
+     * same account. Set to zero to disable credential caching.
+     *
+     * Default: PJSIP_AUTH_SRV_CACHE_SIZE
+     */
+    unsigned	cred_count;
+
+    /**
+     * Number of seconds a cached credential is used before the lookup
+     * function is called again.
+     *
+     * Default: PJSIP_AUTH_SRV_CACHE_TTL
+     */
+    unsigned	cred_ttl;
+
+    /**
+     * Secret key to sign the nonces. Nonces are made of timestamp and
+     * HMAC of the timestamp and realm, so they can be validated without
+     * keeping any state. Servers sharing the same key accept each other's
+     * nonces. If empty, random key is read from OpenSSL when it's
+     * available, or otherwise from /dev/urandom, and the cache creation
+     * fails if neither can be used.
+     *
+     * Default: empty
+     */
+    pj_str_t	nonce_key;
+
+    /**
+     * Number of seconds a nonce is valid. Requests with expired nonce are
+     * rejected with PJSIP_EAUTHSTALENONCE, and should be challenged again
+     * with stale indication.
+     *
+     * Default: PJSIP_AUTH_SRV_NONCE_EXPIRY
+     */
+    unsigned	nonce_expiry;
+
+    /**
+     * Number of nonces which nonce-count is tracked to detect replayed
+     * requests. Set to zero to disable replay detection.
+     *
+     * Default: PJSIP_AUTH_SRV_NC_TABLE_SIZE
+     */
+    unsigned	nc_table_size;
+
+} pjsip_auth_srv_cache_setting;
+
+
 /**
  * Initialize client authentication session data structure, and set the 
  * session to use pool for its subsequent memory allocation. The argument 
@@ -416,6 +480,28 @@ PJ_DECL(pj_status_t) pjsip_auth_clt_init_req( pjsip_auth_clt_sess *sess,
 					      pjsip_tx_data *tdata );
 
 
+/**
+ * Initialize new request message with authorization header computed from
+ * a challenge received earlier, e.g. in response to another request to
+ * the same realm, so that the request doesn't need to be challenged
+ * first. Nothing is done if the request already contains authorization
+ * header with credential for the realm of the challenge, while an empty
+ * authorization header (see \a initial_auth in #pjsip_auth_clt_pref)
+ * for the realm is replaced.
+ *
+ * @param sess		The client authentication session.
+ * @param tdata		The request message to be initialized.
+ * @param chal		WWW-Authenticate or Proxy-Authenticate header.
+ *
+ * @return		PJ_SUCCESS if successfull, or PJSIP_ENOCREDENTIAL
+ *			if the session has no credential for the realm.
+ */
+PJ_DECL(pj_status_t) pjsip_auth_clt_init_req_with_chal(
+				    pjsip_auth_clt_sess *sess,
+				    pjsip_tx_data *tdata,
+				    const pjsip_www_authenticate_hdr *chal);
+
+
 /**
  * Call this function when a transaction failed with 401 or 407 response.
  * This function will reinitialize the original request message with the
@@ -526,17 +612,94 @@ PJ_DECL(pj_status_t) pjsip_auth_srv_init2(
  *			- PJSIP_EAUTHACCDISABLED
  *			- PJSIP_EAUTHINVALIDREALM
  *			- PJSIP_EAUTHINVALIDDIGEST
+ *			- PJSIP_EAUTHINNONCE (with cache)
+ *			- PJSIP_EAUTHSTALENONCE (with cache)
+ *			- PJSIP_EAUTHNCREPLAY (with cache)
  */
 PJ_DECL(pj_status_t) pjsip_auth_srv_verify( pjsip_auth_srv *auth_srv,
 					    pjsip_rx_data *rdata,
 					    int *status_code );
 
 
+/**
+ * Verify the authorization information of several requests at once. When
+ * the cache is enabled, this takes the cache lock only twice for the
+ * whole batch, instead of twice for every request.
+ *
+ * @param auth_srv	The server authentication structure.
+ * @param count		Number of requests.
+ * @param rdata		Array of incoming requests to be authenticated.
+ * @param status_code	Array to be filled with suitable status code to be
+ *			sent to the client of each request.
+ * @param result	Array to be filled with the result of each request,
+ *			see #pjsip_auth_srv_verify().
+ *
+ * @return		PJ_SUCCESS if all requests are authenticated, or the
+ *			first error otherwise.
+ */
+PJ_DECL(pj_status_t) pjsip_auth_srv_verify_batch(pjsip_auth_srv *auth_srv,
+						 unsigned count,
+						 pjsip_rx_data *rdata[],
+						 int status_code[],
+						 pj_status_t result[]);
+
+
+/**
+ * Initialize server authentication cache setting with default values.
+ *
+ * @param setting	The setting to be initialized.
+ */
+PJ_DECL(void) pjsip_auth_srv_cache_setting_default(
+				    pjsip_auth_srv_cache_setting *setting);
+
+
+/**
+ * Enable the cache for server authentication. Once enabled, the server
+ * caches the credentials, issues signed nonces when no nonce is given
+ * to #pjsip_auth_srv_challenge(), validates the nonce of incoming requests,
+ * and rejects replayed nonce-count. Application must call
+ * #pjsip_auth_srv_deinit() to release the cache.
+ *
+ * @param auth_srv	The server authentication structure.
+ * @param pool		Pool to allocate the cache.
+ * @param setting	The cache setting, or NULL to use default setting.
+ *
+ * @return		PJ_SUCCESS on success, or the appropriate error
+ *			code, e.g. when random nonce key can't be created.
+ */
+PJ_DECL(pj_status_t) pjsip_auth_srv_set_cache(
+				    pjsip_auth_srv *auth_srv,
+				    pj_pool_t *pool,
+				    const pjsip_auth_srv_cache_setting *setting);
+
+
+/**
+ * Remove cached credential, e.g. when the password of the account has been
+ * changed.
+ *
+ * @param auth_srv	The server authentication structure.
+ * @param acc_name	The account name, or NULL to remove all credentials.
+ */
+PJ_DECL(void) pjsip_auth_srv_cache_invalidate(pjsip_auth_srv *auth_srv,
+					      const pj_str_t *acc_name);
+
+
+/**
+ * Release the resources of server authentication, such as the cache.
+ *
+ * @param auth_srv	The server authentication structure.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_auth_srv_deinit(pjsip_auth_srv *auth_srv);
+
+
 /**
  * Add authentication challenge headers to the outgoing response in tdata. 
  * Application may specify its customized nonce and opaque for the challenge, 
  * or can leave the value to NULL to make the function fills them in with 
- * random characters.
+ * random characters. When the cache is enabled, the generated nonce is
+ * signed so that it can be validated later.
  *
  * @param auth_srv	The server authentication structure.
  * @param qop		Optional qop value.
@@ -145,6 +145,38 @@ typedef struct pjsip_cfg_t
 	 */
 	pj_bool_t resolve_hostname_to_get_interface;
 
+	/**
+	 * Resolve DNS AAAA records in parallel with DNS A records for the
+	 * target host and all DNS SRV targets, and try the IPv6 and IPv4
+	 * addresses alternately, starting with IPv6.
+	 *
+	 * Default is PJSIP_RESOLVE_AAAA.
+	 */
+	pj_bool_t resolve_aaaa;
+
+	/**
+	 * Connection attempt delay, in msec, when sending a request over
+	 * connection oriented transport (TCP/TLS) to a destination that has
+	 * been resolved to several addresses. If connection to the first
+	 * address is not established within this delay, connection to the
+	 * next address is started in parallel, and the first connection
+	 * to be established wins ("happy eyeballs", RFC 6555). Set to zero
+	 * to try the addresses one at a time.
+	 *
+	 * Default is PJSIP_TP_RACE_DELAY.
+	 */
+	unsigned conn_race_delay;
+
+	/**
+	 * Use the round-trip time measured by the transactions to each
+	 * destination to order the resolved addresses with the same DNS SRV
+	 * priority, so that faster servers are more likely to be tried
+	 * first and servers that have recently timed out are tried last.
+	 *
+	 * Default is PJSIP_RESOLVE_RTT_WEIGHT.
+	 */
+	pj_bool_t rtt_weight;
+
     } endpt;
 
     /** Transaction layer settings. */
@@ -175,6 +207,27 @@ typedef struct pjsip_cfg_t
 	 */
 	unsigned td;
 
+	/**
+	 * Derive the T1 of each client transaction over unreliable
+	 * transport from the retransmission timeout (RTO) measured to its
+	 * destination, as TCP does (RFC 6298). The value is bounded by
+	 * \a min_t1 and \a t2. The configured \a t1 is used for
+	 * destinations which round-trip time is not known yet.
+	 *
+	 * Default is PJSIP_TSX_ADAPTIVE_T1.
+	 */
+	pj_bool_t adaptive_t1;
+
+	/**
+	 * The lower bound of adaptive T1, in msec. By default T1 is not
+	 * lowered below the RFC 3261 value, so adaptive T1 only grows for
+	 * slow paths. A lower bound below PJSIP_T1_TIMEOUT should only be
+	 * used in closed networks with known round-trip times.
+	 *
+	 * Default is PJSIP_TSX_MIN_T1.
+	 */
+	unsigned min_t1;
+
     } tsx;
 
     /* Dialog layer settings .. TODO */
@@ -203,6 +256,34 @@ typedef struct pjsip_cfg_t
 	 */
 	pj_bool_t   add_xuid_param;
 
+	/**
+	 * Percentage of the refresh interval to randomly bring the refresh
+	 * forward, so that refreshes of registrations made at the same time
+	 * are spread over time instead of being sent at once.
+	 *
+	 * Default is PJSIP_REGISTER_CLIENT_REFRESH_JITTER.
+	 */
+	unsigned    refresh_jitter;
+
+	/**
+	 * Maximum number of outstanding REGISTER transactions of all client
+	 * registrations. Further requests are queued and sent when previous
+	 * transactions complete. Zero means unlimited.
+	 *
+	 * Default is PJSIP_REGISTER_CLIENT_MAX_PENDING.
+	 */
+	unsigned    max_pending;
+
+	/**
+	 * Specify whether authentication challenges received by a client
+	 * registration should be shared with other client registrations to
+	 * the same realm, so that they can send their credentials in the
+	 * initial REGISTER without waiting to be challenged.
+	 *
+	 * Default is PJSIP_REGISTER_CLIENT_SHARE_AUTH.
+	 */
+	pj_bool_t   share_auth;
+
     } regc;
 
 } pjsip_cfg_t;
@@ -384,6 +465,68 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #   define PJSIP_RESOLVE_HOSTNAME_TO_GET_INTERFACE  PJ_FALSE
 #endif
 
+/**
+ * Resolve DNS AAAA records together with DNS A records when resolving
+ * server addresses.
+ *
+ * This option can also be controlled at run-time by the
+ * \a resolve_aaaa setting in pjsip_cfg_t.
+ *
+ * Default is PJ_FALSE.
+ */
+#ifndef PJSIP_RESOLVE_AAAA
+#   define PJSIP_RESOLVE_AAAA			    PJ_FALSE
+#endif
+
+/**
+ * Connection attempt delay, in msec, before connection to the next
+ * resolved address is started in parallel when connecting TCP/TLS
+ * transport. Zero disables the parallel connection attempts.
+ *
+ * This option can also be controlled at run-time by the
+ * \a conn_race_delay setting in pjsip_cfg_t.
+ *
+ * Default is 250 (msec), as recommended by RFC 6555.
+ */
+#ifndef PJSIP_TP_RACE_DELAY
+#   define PJSIP_TP_RACE_DELAY			    250
+#endif
+
+/**
+ * Maximum number of connection attempts that may be running in parallel
+ * when connecting TCP/TLS transport to a destination with multiple
+ * addresses.
+ *
+ * Default is 4.
+ */
+#ifndef PJSIP_TP_RACE_MAX_CANDIDATES
+#   define PJSIP_TP_RACE_MAX_CANDIDATES	    4
+#endif
+
+/**
+ * Use measured round-trip time to order server addresses having the same
+ * DNS SRV priority.
+ *
+ * This option can also be controlled at run-time by the
+ * \a rtt_weight setting in pjsip_cfg_t.
+ *
+ * Default is PJ_FALSE, servers are selected as specified by RFC 2782.
+ */
+#ifndef PJSIP_RESOLVE_RTT_WEIGHT
+#   define PJSIP_RESOLVE_RTT_WEIGHT		    PJ_FALSE
+#endif
+
+/**
+ * Number of destinations which round-trip time is tracked by the SIP
+ * resolver. When the table is full, the entry that has not been updated
+ * for the longest time is replaced.
+ *
+ * Default is 32.
+ */
+#ifndef PJSIP_RESOLVE_RTT_TABLE_SIZE
+#   define PJSIP_RESOLVE_RTT_TABLE_SIZE	    32
+#endif
+
 /**
  * Accept call replace in early state when invite is not initiated
  * by the user agent. RFC 3891 Section 3 disallows this, however,
@@ -864,6 +1007,21 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #   define PJSIP_POOL_TSX_INC		256
 #endif
 
+/**
+ * Maximum number of released pools kept for reuse by each pool slab
+ * (see #pjsip_endpt_create_pool_slab()). Transactions, dialogs and
+ * invite sessions take their pools from slabs, which allocate the
+ * first block with the exact requested size instead of rounding it up
+ * to the pool factory's size classes, and recycle released pools
+ * without going through the factory. Set to zero to disable recycling
+ * (pools are still exactly sized and accounted).
+ *
+ * Default: 256
+ */
+#ifndef PJSIP_POOL_SLAB_MAX_CACHED
+#   define PJSIP_POOL_SLAB_MAX_CACHED	256
+#endif
+
 /**
  * Delay for non-100 1xx retransmission, in seconds.
  * Set to 0 to disable this feature.
@@ -886,9 +1044,16 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #define PJSIP_MAX_BRANCH_LEN		(PJSIP_RFC3261_BRANCH_LEN + pj_GUID_STRING_LENGTH() + 2)
 #define PJSIP_MAX_HNAME_LEN		64
 
-/* Dialog related constants. */
-#define PJSIP_POOL_LEN_DIALOG		1200
-#define PJSIP_POOL_INC_DIALOG		512
+/* Dialog related constants. The initial size must be large enough for
+ * pjsip_dialog itself, since dialog pools are allocated with the exact
+ * size by the pool slab (see PJSIP_POOL_SLAB_MAX_CACHED).
+ */
+#ifndef PJSIP_POOL_LEN_DIALOG
+#   define PJSIP_POOL_LEN_DIALOG	2048
+#endif
+#ifndef PJSIP_POOL_INC_DIALOG
+#   define PJSIP_POOL_INC_DIALOG	512
+#endif
 
 /* Maximum header types. */
 #define PJSIP_MAX_HEADER_TYPES		72
@@ -920,6 +1085,31 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #  define PJSIP_TD_TIMEOUT	32000
 #endif
 
+/**
+ * Derive T1 of client transactions from the measured round-trip time
+ * of the destination. This option can also be controlled at run-time by
+ * the \a adaptive_t1 setting in pjsip_cfg_t.
+ *
+ * Default is PJ_TRUE.
+ */
+#if !defined(PJSIP_TSX_ADAPTIVE_T1)
+#  define PJSIP_TSX_ADAPTIVE_T1	PJ_TRUE
+#endif
+
+/**
+ * The lower bound of adaptive T1, in msec. This option can also be
+ * controlled at run-time by the \a min_t1 setting in pjsip_cfg_t.
+ * By default adaptive T1 only grows for slow paths, as RFC 3261 only
+ * recommends T1 below 500 ms in closed networks, such as private
+ * networks with known round-trip times. Lower it there to let T1 follow
+ * short round-trip times too.
+ *
+ * Default is PJSIP_T1_TIMEOUT.
+ */
+#if !defined(PJSIP_TSX_MIN_T1)
+#  define PJSIP_TSX_MIN_T1	PJSIP_T1_TIMEOUT
+#endif
+
 
 /*****************************************************************************
  *  Authorization
@@ -985,6 +1175,50 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Default maximum number of credentials kept by server authentication
+ * cache. See #pjsip_auth_srv_set_cache().
+ *
+ * Default: 1024
+ */
+#ifndef PJSIP_AUTH_SRV_CACHE_SIZE
+#   define PJSIP_AUTH_SRV_CACHE_SIZE	    1024
+#endif
+
+
+/**
+ * Default number of seconds a credential is kept by server authentication
+ * cache before the lookup function is called again.
+ *
+ * Default: 300
+ */
+#ifndef PJSIP_AUTH_SRV_CACHE_TTL
+#   define PJSIP_AUTH_SRV_CACHE_TTL	    300
+#endif
+
+
+/**
+ * Default number of seconds a nonce issued by server authentication
+ * with cache enabled stays valid.
+ *
+ * Default: 300
+ */
+#ifndef PJSIP_AUTH_SRV_NONCE_EXPIRY
+#   define PJSIP_AUTH_SRV_NONCE_EXPIRY	    300
+#endif
+
+
+/**
+ * Default number of nonces which nonce-count is tracked by server
+ * authentication cache to detect replayed requests.
+ *
+ * Default: 4096
+ */
+#ifndef PJSIP_AUTH_SRV_NC_TABLE_SIZE
+#   define PJSIP_AUTH_SRV_NC_TABLE_SIZE	    4096
+#endif
+
+
 /**
  * Specify support for IMS/3GPP digest AKA authentication version 1 and 2
  * (AKAv1-MD5 and AKAv2-MD5 respectively).
@@ -1043,6 +1277,108 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Specify the percentage of the refresh interval of client registration
+ * to be randomly brought forward, to avoid registrations made at the
+ * same time (e.g. after restart) being refreshed in lockstep.
+ *
+ * This setting can be changed in run-time by setting
+ * \a regc.refresh_jitter field of pjsip_cfg().
+ *
+ * Default is 0 (no jitter).
+ */
+#ifndef PJSIP_REGISTER_CLIENT_REFRESH_JITTER
+#   define PJSIP_REGISTER_CLIENT_REFRESH_JITTER	0
+#endif
+
+
+/**
+ * Specify the maximum number of outstanding REGISTER transactions of
+ * all client registrations. REGISTER requests exceeding this limit are
+ * queued and sent when previous transactions complete.
+ *
+ * This setting can be changed in run-time by setting
+ * \a regc.max_pending field of pjsip_cfg().
+ *
+ * Default is 0 (unlimited).
+ */
+#ifndef PJSIP_REGISTER_CLIENT_MAX_PENDING
+#   define PJSIP_REGISTER_CLIENT_MAX_PENDING	0
+#endif
+
+
+/**
+ * Specify whether client registrations should share authentication
+ * challenges per realm, so that a registration can authenticate its
+ * first REGISTER request with the challenge received by another
+ * registration instead of waiting for its own 401/407 response.
+ *
+ * This setting can be changed in run-time by setting
+ * \a regc.share_auth field of pjsip_cfg().
+ *
+ * Default is 0.
+ */
+#ifndef PJSIP_REGISTER_CLIENT_SHARE_AUTH
+#   define PJSIP_REGISTER_CLIENT_SHARE_AUTH	0
+#endif
+
+
+/**
+ * Default number of shards in the binding store of the registrar module.
+ * Each shard has its own lock and hash table, so that requests for
+ * different address of records can be processed in parallel.
+ *
+ * Default: 16
+ */
+#ifndef PJSIP_REGISTRAR_SHARD_COUNT
+#   define PJSIP_REGISTRAR_SHARD_COUNT		16
+#endif
+
+
+/**
+ * Size of the address of record hash table of each registrar shard.
+ *
+ * Default: 4096
+ */
+#ifndef PJSIP_REGISTRAR_SHARD_TABLE_SIZE
+#   define PJSIP_REGISTRAR_SHARD_TABLE_SIZE	4096
+#endif
+
+
+/**
+ * Maximum number of contacts that can be bound to an address of record
+ * in the registrar module.
+ *
+ * Default: 10
+ */
+#ifndef PJSIP_REGISTRAR_MAX_CONTACTS
+#   define PJSIP_REGISTRAR_MAX_CONTACTS		10
+#endif
+
+
+/**
+ * Default minimum registration interval accepted by the registrar
+ * module. Requests with shorter interval will be rejected with
+ * 423 (Interval Too Brief) response.
+ *
+ * Default: 60 seconds
+ */
+#ifndef PJSIP_REGISTRAR_MIN_EXPIRES
+#   define PJSIP_REGISTRAR_MIN_EXPIRES		60
+#endif
+
+
+/**
+ * Default maximum registration interval granted by the registrar module.
+ *
+ * Default: 3600 seconds
+ */
+#ifndef PJSIP_REGISTRAR_MAX_EXPIRES
+#   define PJSIP_REGISTRAR_MAX_EXPIRES		3600
+#endif
+
+
+
 /*****************************************************************************
  *  SIP Event framework and presence settings.
  */
@@ -1093,6 +1429,29 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Specify the maximum size of the record of hibernated event subscription
+ * (see #pjsip_evsub_hibernate()), including the dialog state and the state
+ * saved by the package and application. Subscription whose record would
+ * be larger than this can not be hibernated.
+ *
+ * Default: 2048
+ */
+#ifndef PJSIP_EVSUB_HIB_MAX_LEN
+#   define PJSIP_EVSUB_HIB_MAX_LEN		2048
+#endif
+
+
+/**
+ * Specify the size of the hash table of hibernated event subscriptions.
+ *
+ * Default: 1023
+ */
+#ifndef PJSIP_EVSUB_HIB_TABLE_SIZE
+#   define PJSIP_EVSUB_HIB_TABLE_SIZE		1023
+#endif
+
+
 /**
  * Specify the default expiration time for presence event subscription, for
  * both client and server subscription. For client subscription, application
@@ -1138,6 +1497,31 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Specify the default throttle window of presentity (see
+ * #pjsip_presentity_create()), in milliseconds. Status changes occurring
+ * within this window after a NOTIFY fan-out are coalesced into a single
+ * fan-out at the end of the window.
+ *
+ * Default: 200
+ */
+#ifndef PJSIP_PRES_THROTTLE_MSEC
+#   define PJSIP_PRES_THROTTLE_MSEC		200
+#endif
+
+
+/**
+ * Specify the default number of worker threads used by presentity to send
+ * NOTIFY requests to its watchers. Zero means NOTIFY requests are sent by
+ * the thread that triggers the fan-out.
+ *
+ * Default: 0
+ */
+#ifndef PJSIP_PRES_FANOUT_WORKER_CNT
+#   define PJSIP_PRES_FANOUT_WORKER_CNT	0
+#endif
+
+
 /**
  * Default session interval for Session Timer (RFC 4028) extension, in
  * seconds. As specified in RFC 4028 Section 4, this value must not be 
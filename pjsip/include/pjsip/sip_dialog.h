@@ -341,6 +341,50 @@ PJ_DECL(pj_status_t) pjsip_dlg_fork(const pjsip_dialog *original_dlg,
 				    const pjsip_rx_data *rdata,
 				    pjsip_dialog **new_dlg );
 
+/**
+ * Save the identity and routing state of an established dialog (Call-ID,
+ * local and remote party with their tags, CSeq numbers, local Contact,
+ * remote target and route set) into a compact text record. The record
+ * can be used later to recreate the dialog with #pjsip_dlg_restore(),
+ * for example after the dialog has been destroyed to save memory while
+ * it was idle.
+ *
+ * Transport selector, client authentication session, remote capabilities
+ * and module data are not saved.
+ *
+ * @param dlg		    The dialog, which must be established.
+ * @param buf		    Buffer to receive the record.
+ * @param size		    Size of the buffer.
+ * @param len		    On return, it will be filled with the length
+ *			    of the record.
+ *
+ * @return		    PJ_SUCCESS on success, or PJ_ETOOSMALL if the
+ *			    buffer is not large enough.
+ */
+PJ_DECL(pj_status_t) pjsip_dlg_save( pjsip_dialog *dlg,
+				     char *buf,
+				     pj_size_t size,
+				     pj_size_t *len);
+
+/**
+ * Recreate a dialog from a record previously created with
+ * #pjsip_dlg_save(). The new dialog will be in established state, is
+ * registered to the user agent, and will continue the CSeq numbering
+ * from the values saved in the record. As with the other dialog creation
+ * functions, the session count of the dialog is initially zero.
+ *
+ * @param ua		    The user agent module instance.
+ * @param rec		    The record.
+ * @param len		    The length of the record.
+ * @param p_dlg	    	    Pointer to receive the dialog.
+ *
+ * @return		    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_dlg_restore( pjsip_user_agent *ua,
+					const char *rec,
+					pj_size_t len,
+					pjsip_dialog **p_dlg);
+
 /**
  * Forcefully terminate the dialog. Application can only call this function
  * when there is no session associated to the dialog. If there are sessions
@@ -314,6 +314,54 @@ PJ_DECL(pj_pool_t*) pjsip_endpt_create_pool( pjsip_endpoint *endpt,
 PJ_DECL(void) pjsip_endpt_release_pool( pjsip_endpoint *endpt,
 					pj_pool_t *pool );
 
+/**
+ * Opaque declaration of pool slab. A pool slab hands out pools of one
+ * fixed initial size, for objects that are created and destroyed at high
+ * rate such as transactions and dialogs. The first block of each pool is
+ * allocated with the exact requested size, released pools are reset and
+ * kept for reuse (up to #PJSIP_POOL_SLAB_MAX_CACHED), and the slab keeps
+ * track of the memory held by its live pools so that it can be reported
+ * by #pjsip_endpt_dump().
+ */
+typedef struct pjsip_pool_slab pjsip_pool_slab;
+
+/**
+ * Get the pool slab with the specified name, creating it if it doesn't
+ * exist yet. Slabs are owned by the endpoint and destroyed with it.
+ *
+ * @param endpt		The SIP endpoint.
+ * @param name		Slab name, which is also used as the default
+ *			name of the pools.
+ * @param initial	The initial size of the pools.
+ * @param increment	The resize size of the pools.
+ * @param per_call	Number of pools of this slab held by an established
+ *			and idle call (for example 1 for dialogs), used to
+ *			report the memory footprint of an idle call. Use
+ *			zero if the pools are not owned by calls.
+ * @param p_slab	Pointer to receive the slab.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_endpt_create_pool_slab(pjsip_endpoint *endpt,
+						  const char *name,
+						  pj_size_t initial,
+						  pj_size_t increment,
+						  unsigned per_call,
+						  pjsip_pool_slab **p_slab);
+
+/**
+ * Create pool from the slab. The pool is released with
+ * #pjsip_endpt_release_pool() (or pj_pool_release()) as usual.
+ *
+ * @param slab		The pool slab.
+ * @param pool_name	Name to be assigned to the pool, or NULL to use
+ *			the slab name.
+ *
+ * @return		Memory pool, or NULL on failure.
+ */
+PJ_DECL(pj_pool_t*) pjsip_pool_slab_create_pool(pjsip_pool_slab *slab,
+						const char *pool_name);
+
 /**
  * Find transaction in endpoint's transaction table by the transaction's key.
  * This function normally is only used by modules. The key for a transaction
@@ -417,6 +465,64 @@ PJ_DECL(void) pjsip_endpt_resolve( pjsip_endpoint *endpt,
 				   void *token,
 				   pjsip_resolver_callback *cb);
 
+/**
+ * Update the round-trip time estimate of the specified destination in
+ * the SIP resolver. See #pjsip_resolver_update_rtt().
+ *
+ * @param endpt	    The endpoint instance.
+ * @param addr	    The destination address.
+ * @param rtt_msec  The measured round-trip time in msec, or negative
+ *		    value to indicate failure.
+ */
+PJ_DECL(void) pjsip_endpt_update_rtt( pjsip_endpoint *endpt,
+				      const pj_sockaddr *addr,
+				      int rtt_msec);
+
+/**
+ * Get the smoothed round-trip time estimate of the specified destination.
+ * See #pjsip_resolver_get_rtt().
+ *
+ * @param endpt	    The endpoint instance.
+ * @param addr	    The destination address.
+ * @param srtt_msec Pointer to receive the smoothed round-trip time, in msec.
+ *
+ * @return	    PJ_SUCCESS if the destination has round-trip time
+ *		    estimate, or PJ_ENOTFOUND.
+ */
+PJ_DECL(pj_status_t) pjsip_endpt_get_rtt( pjsip_endpoint *endpt,
+					  const pj_sockaddr *addr,
+					  unsigned *srtt_msec);
+
+/**
+ * Get the round-trip time statistics of the specified destination.
+ * See #pjsip_resolver_get_rtt_info().
+ *
+ * @param endpt	    The endpoint instance.
+ * @param addr	    The destination address.
+ * @param info	    Pointer to receive the statistics.
+ *
+ * @return	    PJ_SUCCESS if the destination has round-trip time
+ *		    estimate, or PJ_ENOTFOUND.
+ */
+PJ_DECL(pj_status_t) pjsip_endpt_get_rtt_info( pjsip_endpoint *endpt,
+					       const pj_sockaddr *addr,
+					       pjsip_rtt_info *info);
+
+/**
+ * Enumerate the round-trip time statistics of all destinations.
+ * See #pjsip_resolver_enum_rtt().
+ *
+ * @param endpt	    The endpoint instance.
+ * @param count	    On input, the number of elements in the array.
+ *		    On output, the number of elements filled in.
+ * @param info	    Array to receive the statistics.
+ *
+ * @return	    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_endpt_enum_rtt( pjsip_endpoint *endpt,
+					   unsigned *count,
+					   pjsip_rtt_info info[]);
+
 /**
  * Get transport manager instance.
  *
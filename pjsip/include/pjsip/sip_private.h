@@ -26,7 +26,36 @@
  */ 
 
 #include <pjsip/sip_types.h>
+#include <pjsip/sip_endpoint.h>
 
+PJ_BEGIN_DECL
+
+/**
+ * Duplicate string. When the string is one of the common tokens used in
+ * SIP messages (method names, option tags, and the names and values of
+ * common parameters such as transport names), the result points to the
+ * library's shared copy of the token instead of a copy in the pool, hence
+ * it must be treated as read-only.
+ *
+ * @param pool	    Pool to allocate memory from when the string is not
+ *		    a common token.
+ * @param dst	    Destination string.
+ * @param src	    Source string.
+ */
+PJ_DECL(void) pjsip_strdup_interned(pj_pool_t *pool, pj_str_t *dst,
+				    const pj_str_t *src);
+
+/**
+ * Get the pool slab which dialogs allocate their pools from. The slab is
+ * created when the user agent module is loaded.
+ *
+ * @param ua	    The user agent module.
+ *
+ * @return	    The dialog pool slab.
+ */
+PJ_DECL(pjsip_pool_slab*) pjsip_ua_get_dlg_slab(pjsip_user_agent *ua);
+
+PJ_END_DECL
 
 #endif /* __PJSIP_PRIVATE_I_H__ */
 
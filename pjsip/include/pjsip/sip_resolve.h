@@ -103,6 +103,17 @@ PJ_BEGIN_DECL
  * These targets are returned in the #pjsip_server_addresses structure 
  * argument of the callback. 
  *
+ * When \a rtt_weight setting in #pjsip_cfg_t is enabled, the round-trip
+ * time measured by the transactions to each destination (see
+ * #pjsip_resolver_update_rtt()) is also taken into account: the weight of
+ * each address with the same priority is scaled by the inverse of its
+ * smoothed round-trip time, and addresses that have recently timed out are
+ * penalized, so that the remaining servers are tried first.
+ *
+ * When \a resolve_aaaa setting in #pjsip_cfg_t is enabled, DNS AAAA
+ * queries are issued in parallel with DNS A queries, and the IPv6 and IPv4
+ * addresses of each target are returned alternately, starting with IPv6.
+ *
  * \subsection PJSIP_SIP_RESOLVE_SIP_FEATURES SIP SRV Resolver Features
  *
  * Some features of the SIP resolver:
@@ -194,6 +205,37 @@ typedef struct pjsip_server_addresses
 } pjsip_server_addresses;
 
 
+/**
+ * Round-trip time statistics of a destination, as measured by the
+ * transaction layer.
+ */
+typedef struct pjsip_rtt_info
+{
+    /** The destination address. */
+    pj_sockaddr	addr;
+
+    /** Smoothed round-trip time, in msec. */
+    unsigned	srtt;
+
+    /** Round-trip time variation, in msec. */
+    unsigned	rttvar;
+
+    /** Retransmission timeout (srtt + 4*rttvar), in msec, or zero if no
+     *  round-trip time has been sampled yet. */
+    unsigned	rto;
+
+    /** Number of round-trip time samples. */
+    unsigned	sample_cnt;
+
+    /** Number of timeouts and transport failures. */
+    unsigned	fail_cnt;
+
+    /** Seconds since the estimate was last updated. */
+    unsigned	age;
+
+} pjsip_rtt_info;
+
+
 /**
  * The type of callback function to be called when resolver finishes the job.
  *
@@ -282,6 +324,65 @@ PJ_DECL(void) pjsip_resolve( pjsip_resolver_t *resolver,
 			     void *token,
 			     pjsip_resolver_callback *cb);
 
+/**
+ * Update the round-trip time estimate of the specified destination. This
+ * is normally called by the transaction layer when a response is received
+ * for a request that has not been retransmitted, or with negative value
+ * when the request has timed out or the transport has failed.
+ *
+ * @param resolver	The resolver engine.
+ * @param addr		The destination address.
+ * @param rtt_msec	The measured round-trip time in msec, or negative
+ *			value to indicate failure.
+ */
+PJ_DECL(void) pjsip_resolver_update_rtt(pjsip_resolver_t *resolver,
+					const pj_sockaddr *addr,
+					int rtt_msec);
+
+/**
+ * Get the smoothed round-trip time estimate of the specified destination.
+ *
+ * @param resolver	The resolver engine.
+ * @param addr		The destination address.
+ * @param srtt_msec	Pointer to receive the smoothed round-trip time,
+ *			in msec.
+ *
+ * @return		PJ_SUCCESS if the destination has round-trip time
+ *			estimate, or PJ_ENOTFOUND.
+ */
+PJ_DECL(pj_status_t) pjsip_resolver_get_rtt(pjsip_resolver_t *resolver,
+					    const pj_sockaddr *addr,
+					    unsigned *srtt_msec);
+
+/**
+ * Get the round-trip time statistics of the specified destination.
+ *
+ * @param resolver	The resolver engine.
+ * @param addr		The destination address.
+ * @param info		Pointer to receive the statistics.
+ *
+ * @return		PJ_SUCCESS if the destination has round-trip time
+ *			estimate, or PJ_ENOTFOUND.
+ */
+PJ_DECL(pj_status_t) pjsip_resolver_get_rtt_info(pjsip_resolver_t *resolver,
+						 const pj_sockaddr *addr,
+						 pjsip_rtt_info *info);
+
+/**
+ * Enumerate the round-trip time statistics of all destinations currently
+ * tracked by the resolver.
+ *
+ * @param resolver	The resolver engine.
+ * @param count		On input, the number of elements in the array.
+ *			On output, the number of elements filled in.
+ * @param info		Array to receive the statistics.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_resolver_enum_rtt(pjsip_resolver_t *resolver,
+					     unsigned *count,
+					     pjsip_rtt_info info[]);
+
 /**
  * @}
  */
@@ -136,6 +136,12 @@ struct pjsip_transaction
      */
     pjsip_tx_data	       *last_tx;        /**< Msg kept for retrans.  */
     int				retransmit_count;/**< Retransmission count. */
+    unsigned			t1;		/**< T1 of this transaction
+						     in msec, zero if not
+						     determined yet.	    */
+    pj_time_val			send_time;	/**< Time the request was
+						     first sent, to measure
+						     round-trip time.	    */
     pj_timer_entry		retransmit_timer;/**< Retransmit timer.     */
     pj_timer_entry		timeout_timer;  /**< Timeout timer.         */
 
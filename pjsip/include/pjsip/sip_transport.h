@@ -1294,6 +1294,59 @@ PJ_DECL(pj_status_t) pjsip_tpmgr_acquire_transport2(pjsip_tpmgr *mgr,
 						    pjsip_tx_data *tdata,
 						    pjsip_transport **tp);
 
+/**
+ * Type of callback to receive the result of #pjsip_tpmgr_race_transport().
+ *
+ * @param token		The token that was given when calling the function.
+ * @param tdata		The transmit data.
+ * @param status	PJ_SUCCESS if a connection has been established, or
+ *			the error of the last connection attempt if all
+ *			attempts have failed, or PJ_ECANCELLED if the
+ *			transport manager is being destroyed.
+ * @param index		Index in \a tdata->dest_info.addr of the address
+ *			that has been connected, or of the last address
+ *			tried on failure.
+ */
+typedef void (*pjsip_tp_race_callback)(void *token,
+				       pjsip_tx_data *tdata,
+				       pj_status_t status,
+				       unsigned index);
+
+/**
+ * Connect to several addresses of the destination in parallel. Starting
+ * with the current address in \a tdata->dest_info, a connection attempt
+ * is started to each of the following connection oriented (e.g. TCP or
+ * TLS) addresses after \a conn_race_delay setting in pjsip_cfg_t has
+ * elapsed without the previous attempts completing, or immediately when
+ * all previous attempts have failed. The first connection established
+ * wins, and its transport can then be acquired with
+ * #pjsip_tpmgr_acquire_transport2().
+ *
+ * The race is not started if the transport selector in \a tdata is set,
+ * if the current address is not connection oriented or not followed by
+ * other connection oriented addresses, or if connection to the current
+ * address already exists.
+ *
+ * The race progresses on the transport state notifications of the
+ * candidates (see #pjsip_transport_notify_state()), so no polling is
+ * involved. A reference to \a tdata is held until the callback returns.
+ *
+ * This is an internal function used when sending messages.
+ *
+ * @param mgr	    The transport manager instance.
+ * @param tdata	    The transmit data.
+ * @param token	    Arbitrary token to be given back to the callback.
+ * @param cb	    The callback to be called when the race finishes.
+ *
+ * @return	    PJ_EPENDING if the race has been started and the callback
+ *		    will be called later, or PJ_SUCCESS if no race is
+ *		    needed.
+ */
+PJ_DECL(pj_status_t) pjsip_tpmgr_race_transport(pjsip_tpmgr *mgr,
+					        pjsip_tx_data *tdata,
+					        void *token,
+					        pjsip_tp_race_callback cb);
+
 /**
  * Type of callback to receive notification when message or raw data
  * has been sent.
@@ -1478,6 +1531,23 @@ PJ_DECL(pjsip_tp_state_callback) pjsip_tpmgr_get_state_cb(
 					      const pjsip_tpmgr *mgr);
 
 
+/**
+ * Notify the transport manager about a change of transport state. This
+ * updates the internal users of transport state, such as connection races,
+ * then calls the callback set with #pjsip_tpmgr_set_state_cb(), if any.
+ * Transport implementations must use this function instead of calling the
+ * callback directly.
+ *
+ * @param tp	    The transport.
+ * @param state	    The new transport state.
+ * @param info	    The state info.
+ */
+PJ_DECL(void) pjsip_transport_notify_state(
+				    pjsip_transport *tp,
+				    pjsip_transport_state state,
+				    const pjsip_transport_state_info *info);
+
+
 /**
  * Add a listener to the specified transport for transport state notification.
  * 
@@ -205,6 +205,17 @@ typedef struct pjsip_tls_setting
      */
     pj_bool_t qos_ignore_error;
 
+    /**
+     * Perform the TLS handshake crypto on the secure socket handshake
+     * worker threads instead of the SIP worker thread that polls the
+     * transport, so a burst of new TLS connections doesn't delay other
+     * transports. See \a async_handshake field of #pj_ssl_sock_param
+     * for more info.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t async_handshake;
+
 } pjsip_tls_setting;
 
 
@@ -1406,14 +1406,20 @@ typedef struct pjsua_config
 {
 
     /** 
-     * Maximum calls to support (default: 4). The value specified here
-     * must be smaller than the compile time maximum settings 
-     * PJSUA_MAX_CALLS, which by default is 32. To increase this 
-     * limit, the library must be recompiled with new PJSUA_MAX_CALLS
-     * value.
+     * Maximum calls to support (default: 4). The calls table is allocated
+     * by #pjsua_init() with this many entries, so there is no compile
+     * time upper limit.
      */
     unsigned	    max_calls;
 
+    /**
+     * Maximum number of buddies to support. The buddy table is allocated
+     * by #pjsua_init() with this many entries.
+     *
+     * Default: PJSUA_MAX_BUDDIES
+     */
+    unsigned	    max_buddies;
+
     /** 
      * Number of worker threads. Normally application will want to have at
      * least one worker thread, unless when it wants to poll the library
@@ -3851,7 +3857,9 @@ PJ_DECL(pj_status_t) pjsua_acc_set_transport(pjsua_acc_id acc_id,
  */
 
 /**
- * Maximum simultaneous calls.
+ * Maximum simultaneous calls. This is only used as the upper limit of
+ * the default value of \a max_calls in #pjsua_config; the library sizes
+ * its calls table from \a max_calls at run-time.
  */
 #ifndef PJSUA_MAX_CALLS
 #   define PJSUA_MAX_CALLS	    32
@@ -4898,7 +4906,8 @@ pjsua_call_get_med_transport_info(pjsua_call_id call_id,
  */
 
 /**
- * Max buddies in buddy list.
+ * Default maximum number of buddies in buddy list. The actual limit is
+ * set at run-time with \a max_buddies in #pjsua_config.
  */
 #ifndef PJSUA_MAX_BUDDIES
 #   define PJSUA_MAX_BUDDIES	    256
@@ -112,6 +112,28 @@ typedef struct call_answer
 } call_answer;
 
 
+/**
+ * Media info of a call as reported by pjsua_call_get_info(). It is
+ * published with pjsua_call_publish_media() whenever the media of the call
+ * change, so that it can be read under the call's slot lock alone.
+ */
+typedef struct pjsua_call_media_snap
+{
+    pjsua_call_media_status media_status;   /**< First audio status.	    */
+    pjmedia_dir		    media_dir;	    /**< First audio direction.	    */
+    pjsua_conf_port_id	    conf_slot;	    /**< First audio conf slot.	    */
+    unsigned		    media_cnt;	    /**< Number of active media.    */
+    pjsua_call_media_info   media[PJMEDIA_MAX_SDP_MEDIA];
+					    /**< Active media.		    */
+    unsigned		    prov_media_cnt; /**< Number of prov. media.	    */
+    pjsua_call_media_info   prov_media[PJMEDIA_MAX_SDP_MEDIA];
+					    /**< Provisional media.	    */
+    pj_bool_t		    rem_offerer;    /**< Was remote SDP offerer?    */
+    unsigned		    rem_aud_cnt;    /**< Remote audio count.	    */
+    unsigned		    rem_vid_cnt;    /**< Remote video count.	    */
+} pjsua_call_media_snap;
+
+
 /** 
  * Structure to be attached to invite dialog. 
  * Given a dialog "dlg", application can retrieve this structure
@@ -120,6 +142,13 @@ typedef struct call_answer
 struct pjsua_call
 {
     unsigned		 index;	    /**< Index in pjsua array.		    */
+    pj_mutex_t		*lock;	    /**< Slot lock, protects inv and
+					 async_call.dlg pointers and
+					 media_snap. It is a leaf lock:
+					 no other lock may be acquired
+					 while holding it, but it may be
+					 taken while the PJSUA lock is
+					 held.				    */
     pjsua_call_setting	 opt;	    /**< Call setting.			    */
     pj_bool_t		 opt_inited;/**< Initial call setting has been set,
 					 to avoid different opt in answer.  */
@@ -144,6 +173,7 @@ struct pjsua_call
 				    /**< Array of provisional media.	    */
 
     int			 audio_idx; /**< First active audio media.	    */
+    pjsua_call_media_snap media_snap;/**< Published media info.	    */
     pj_mutex_t          *med_ch_mutex;/**< Media channel callback's mutex.  */
     pjsua_med_tp_state_cb   med_ch_cb;/**< Media channel callback.	    */
     pjsua_med_tp_state_info med_ch_info;/**< Media channel info.            */
@@ -315,6 +345,9 @@ typedef struct pjsua_buddy
     pj_str_t		 term_reason;/**< Subscription termination reason */
     pjsip_pres_status	 status;    /**< Buddy presence status.		*/
     pj_timer_entry	 timer;	    /**< Resubscription timer		*/
+    pj_str_t		 ht_key;    /**< Key in the buddy URI table.	*/
+    pj_hash_entry_buf	 ht_entry;  /**< Buddy URI table entry.		*/
+    pjsua_buddy_id	 ht_next;   /**< Next buddy with the same key.	*/
 } pjsua_buddy;
 
 
@@ -442,12 +475,21 @@ struct pjsua_data
     /* Calls: */
     pjsua_config	 ua_cfg;		/**< UA config.		*/
     unsigned		 call_cnt;		/**< Call counter.	*/
-    pjsua_call		 calls[PJSUA_MAX_CALLS];/**< Calls array.	*/
-    pjsua_call_id	 next_call_id;		/**< Next call id to use*/
+    pjsua_call		*calls;			/**< Calls table, sized
+						     by max_calls.	*/
+    pjsua_call_id	*call_free;		/**< Ring of free ids.	*/
+    pj_uint8_t		*call_queued;		/**< Id is in the ring.	*/
+    unsigned		 call_free_head;	/**< Ring read position	*/
+    unsigned		 call_free_cnt;		/**< Ids in the ring.	*/
 
     /* Buddy; */
     unsigned		 buddy_cnt;		    /**< Buddy count.	*/
-    pjsua_buddy		 buddy[PJSUA_MAX_BUDDIES];  /**< Buddy array.	*/
+    pjsua_buddy		*buddy;			    /**< Buddy table,
+							 sized by
+							 max_buddies.	*/
+    pjsua_buddy_id	*buddy_free;		    /**< Free buddy ids	*/
+    unsigned		 buddy_free_cnt;	    /**< Free id count.	*/
+    pj_hash_table_t	*buddy_ht;		    /**< Buddies by URI	*/
 
     /* Presence: */
     pj_timer_entry	 pres_timer;/**< Presence refresh timer.	*/
@@ -835,6 +877,12 @@ PJ_DECL(void) pjsua_vid_win_reset(pjsua_vid_win_id wid);
  */
 void pjsua_call_schedule_reinvite_check(pjsua_call *call, unsigned delay_ms);
 
+/*
+ * Publish the media info of the call for pjsua_call_get_info(), after the
+ * media have been changed.
+ */
+void pjsua_call_publish_media(pjsua_call *call);
+
 PJ_END_DECL
 
 #endif	/* __PJSUA_INTERNAL_H__ */
@@ -169,14 +169,19 @@ struct OnSelectAccountParam
 struct UaConfig : public PersistentObject
 {
     /**
-     * Maximum calls to support (default: 4). The value specified here
-     * must be smaller than the compile time maximum settings
-     * PJSUA_MAX_CALLS, which by default is 32. To increase this
-     * limit, the library must be recompiled with new PJSUA_MAX_CALLS
-     * value.
+     * Maximum calls to support (default: 4). The calls table is sized
+     * from this value when the library is initialized, so there is no
+     * compile time upper limit.
      */
     unsigned		maxCalls;
 
+    /**
+     * Maximum number of buddies to support.
+     *
+     * Default: PJSUA_MAX_BUDDIES
+     */
+    unsigned		maxBuddies;
+
     /**
      * Number of worker threads. Normally application will want to have at
      * least one worker thread, unless when it wants to poll the library
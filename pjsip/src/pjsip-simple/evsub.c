@@ -27,8 +27,10 @@
 #include <pjsip/sip_auth.h>
 #include <pjsip/sip_transaction.h>
 #include <pjsip/sip_event.h>
+#include <pjsip/sip_ua_layer.h>
 #include <pj/assert.h>
 #include <pj/guid.h>
+#include <pj/hash.h>
 #include <pj/log.h>
 #include <pj/os.h>
 #include <pj/pool.h>
@@ -85,6 +87,8 @@ PJ_DEF(const pjsip_method*) pjsip_get_notify_method()
  */
 static void	   mod_evsub_on_tsx_state(pjsip_transaction*, pjsip_event*);
 static pj_status_t mod_evsub_unload(void);
+static pj_bool_t   mod_evsub_hib_on_rx_request(pjsip_rx_data *rdata);
+static void	   hib_cleanup(void);
 
 
 /*
@@ -174,6 +178,18 @@ struct evpkg
 };
 
 
+/* Number of allocation size classes of hibernation record, starting
+ * from HIB_MIN_SIZE and doubling for each class.
+ */
+#define HIB_MIN_SIZE		256
+#define HIB_CLASS_CNT		10
+
+/* Maximum length of hibernation key (Call-ID, local and remote tag) */
+#define HIB_MAX_KEY_LEN		512
+
+struct evsub_hib;
+
+
 /*
  * Event subscription module (mod-evsub).
  */
@@ -185,6 +201,14 @@ static struct mod_evsub
     struct evpkg	     pkg_list;
     pjsip_allow_events_hdr  *allow_events_hdr;
 
+    /* Hibernated subscriptions: */
+    pj_pool_t		    *hib_pool;
+    pj_mutex_t		    *hib_mutex;
+    pj_hash_table_t	    *hib_table;
+    unsigned		     hib_cnt;
+    unsigned		     hib_orphan_cnt;
+    struct evsub_hib	    *hib_free[HIB_CLASS_CNT];
+
 } mod_evsub = 
 {
     {
@@ -205,6 +229,29 @@ static struct mod_evsub
 };
 
 
+/*
+ * Module to rehydrate hibernated subscription when request is received
+ * in its dialog. It must run before the user agent layer, which would
+ * otherwise reject the request since the dialog does not exist.
+ */
+static pjsip_module mod_evsub_hib =
+{
+    NULL, NULL,				    /* prev, next.		*/
+    { "mod-evsub-hib", 13 },		    /* Name.			*/
+    -1,					    /* Id			*/
+    PJSIP_MOD_PRIORITY_UA_PROXY_LAYER-1,    /* Priority			*/
+    NULL,				    /* load()			*/
+    NULL,				    /* start()			*/
+    NULL,				    /* stop()			*/
+    NULL,				    /* unload()			*/
+    &mod_evsub_hib_on_rx_request,	    /* on_rx_request()		*/
+    NULL,				    /* on_rx_response()		*/
+    NULL,				    /* on_tx_request.		*/
+    NULL,				    /* on_tx_response()		*/
+    NULL,				    /* on_tsx_state()		*/
+};
+
+
 /*
  * Event subscription session.
  */
@@ -232,6 +279,7 @@ struct pjsip_evsub
 
     pj_time_val		  refresh_time;	/**< Time to refresh.		    */
     pj_timer_entry	  timer;	/**< Internal timer.		    */
+    pj_time_val		  timer_due;	/**< When the timer elapses.	    */
     int			  pending_tsx;	/**< Number of pending transactions.*/
     pjsip_transaction	 *pending_sub;	/**< Pending UAC SUBSCRIBE tsx.	    */
 
@@ -258,6 +306,7 @@ static const pj_str_t STR_TERMINATED = { "terminated", 10 };
 static const pj_str_t STR_ACTIVE     = { "active", 6 };
 static const pj_str_t STR_PENDING    = { "pending", 7 };
 static const pj_str_t STR_TIMEOUT    = { "timeout", 7};
+static const pj_str_t STR_NORESOURCE = { "noresource", 10 };
 
 
 /*
@@ -265,6 +314,8 @@ static const pj_str_t STR_TIMEOUT    = { "timeout", 7};
  */
 static pj_status_t mod_evsub_unload(void)
 {
+    hib_cleanup();
+
     pjsip_endpt_release_pool(mod_evsub.endpt, mod_evsub.pool);
     mod_evsub.pool = NULL;
 
@@ -307,10 +358,30 @@ PJ_DEF(pj_status_t) pjsip_evsub_init_module(pjsip_endpoint *endpt)
     if (!mod_evsub.pool)
 	return PJ_ENOMEM;
 
-    /* Register module: */
-    status = pjsip_endpt_register_module(endpt, &mod_evsub.mod);
+    /* Create hibernation table: */
+    mod_evsub.hib_pool = pjsip_endpt_create_pool(endpt, "evsubhib",
+						 4000, 4000);
+    if (!mod_evsub.hib_pool) {
+	status = PJ_ENOMEM;
+	goto on_error;
+    }
+    status = pj_mutex_create_recursive(mod_evsub.hib_pool, "evsubhib",
+				       &mod_evsub.hib_mutex);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+    mod_evsub.hib_table = pj_hash_create(mod_evsub.hib_pool,
+					 PJSIP_EVSUB_HIB_TABLE_SIZE);
+
+    /* Register modules: */
+    status = pjsip_endpt_register_module(endpt, &mod_evsub_hib);
     if (status  != PJ_SUCCESS)
 	goto on_error;
+
+    status = pjsip_endpt_register_module(endpt, &mod_evsub.mod);
+    if (status  != PJ_SUCCESS) {
+	pjsip_endpt_unregister_module(endpt, &mod_evsub_hib);
+	goto on_error;
+    }
  
     /* Create Allow-Events header: */
     mod_evsub.allow_events_hdr = pjsip_allow_events_hdr_create(mod_evsub.pool);
@@ -326,6 +397,14 @@ PJ_DEF(pj_status_t) pjsip_evsub_init_module(pjsip_endpoint *endpt)
     return PJ_SUCCESS;
 
 on_error:
+    if (mod_evsub.hib_mutex) {
+	pj_mutex_destroy(mod_evsub.hib_mutex);
+	mod_evsub.hib_mutex = NULL;
+    }
+    if (mod_evsub.hib_pool) {
+	pjsip_endpt_release_pool(endpt, mod_evsub.hib_pool);
+	mod_evsub.hib_pool = NULL;
+    }
     if (mod_evsub.pool) {
 	pjsip_endpt_release_pool(endpt, mod_evsub.pool);
 	mod_evsub.pool = NULL;
@@ -376,6 +455,16 @@ PJ_DEF(void*) pjsip_evsub_get_mod_data( pjsip_evsub *sub, unsigned mod_id )
 }
 
 
+/*
+ * Get the dialog of the subscription.
+ */
+PJ_DEF(pjsip_dialog*) pjsip_evsub_get_dlg( pjsip_evsub *sub )
+{
+    PJ_ASSERT_RETURN(sub, NULL);
+    return sub->dlg;
+}
+
+
 /*
  * Find registered event package with matching name.
  */
@@ -515,6 +604,9 @@ static void set_timer( pjsip_evsub *sub, int timer_id,
 	timeout.msec = 0;
 	sub->timer.id = timer_id;
 
+	pj_gettimeofday(&sub->timer_due);
+	sub->timer_due.sec += seconds;
+
 	pjsip_endpt_schedule_timer(sub->endpt, &sub->timer, &timeout);
 
 	PJ_LOG(5,(sub->obj_name, "Timer %s scheduled in %d seconds", 
@@ -2190,3 +2282,771 @@ static void mod_evsub_on_tsx_state(pjsip_transaction *tsx, pjsip_event *event)
 }
 
 
+
+
+/*****************************************************************************
+ * Hibernation of idle subscriptions.
+ */
+
+/* Module data pointer saved in hibernation record */
+struct hib_mod_data
+{
+    unsigned		 id;
+    void		*data;
+};
+
+/*
+ * Record of hibernated subscription. The structure is followed by the
+ * saved module data pointers, the key (Call-ID, local tag and remote tag),
+ * the dialog record, the subscription record and the state saved by the
+ * on_hibernate() callback, in this order.
+ */
+struct evsub_hib
+{
+    struct evsub_hib	*next_free;	/**< Free list, when not used.	    */
+    pj_hash_entry_buf	 hbuf;		/**< Hash table entry buffer.	    */
+    pj_timer_entry	 timer;		/**< Refresh/timeout timer.	    */
+    pj_bool_t		 orphan;	/**< Record is owned by timer cb.   */
+    unsigned		 size_class;	/**< Allocation size class.	    */
+    pjsip_evsub_user	 user;		/**< Callback.			    */
+    pjsip_role_e	 role;		/**< UAC=subscriber, UAS=notifier   */
+    pjsip_evsub_state	 state;		/**< Subscription state.	    */
+    unsigned		 option;	/**< Options.			    */
+    pj_int32_t		 expires;	/**< Expires value.		    */
+    pj_time_val		 refresh_time;	/**< Time to refresh.		    */
+    int			 timer_type;	/**< Timer to restore.		    */
+    pj_time_val		 timer_due;	/**< When the timer elapses.	    */
+    unsigned		 mod_cnt;	/**< Number of module data.	    */
+    unsigned		 key_len;	/**< Length of the key.		    */
+    unsigned		 dlg_len;	/**< Length of dialog record.	    */
+    unsigned		 sub_len;	/**< Length of subscription record. */
+    unsigned		 user_len;	/**< Length of user state.	    */
+};
+
+
+/* Get the text part of hibernation record, which starts with the key. */
+static char *hib_text(struct evsub_hib *hib)
+{
+    return (char*)((struct hib_mod_data*)(hib+1) + hib->mod_cnt);
+}
+
+
+/* Allocate hibernation record. Hibernation mutex must be held. */
+static struct evsub_hib *hib_alloc(pj_size_t size)
+{
+    struct evsub_hib *hib;
+    unsigned cls;
+
+    for (cls=0; cls<HIB_CLASS_CNT && (pj_size_t)(HIB_MIN_SIZE<<cls) < size;
+	 ++cls)
+	;
+    if (cls == HIB_CLASS_CNT)
+	return NULL;
+
+    hib = mod_evsub.hib_free[cls];
+    if (hib) {
+	mod_evsub.hib_free[cls] = hib->next_free;
+    } else {
+	hib = (struct evsub_hib*)
+	      pj_pool_alloc(mod_evsub.hib_pool, HIB_MIN_SIZE << cls);
+    }
+
+    pj_bzero(hib, sizeof(struct evsub_hib));
+    hib->size_class = cls;
+    return hib;
+}
+
+
+/* Release hibernation record. Hibernation mutex must be held. */
+static void hib_release(struct evsub_hib *hib)
+{
+    hib->next_free = mod_evsub.hib_free[hib->size_class];
+    mod_evsub.hib_free[hib->size_class] = hib;
+}
+
+
+/* Create hibernation key from dialog identification. */
+static unsigned hib_make_key(char *buf, pj_size_t size,
+			     const pj_str_t *call_id,
+			     const pj_str_t *local_tag,
+			     const pj_str_t *remote_tag)
+{
+    pj_size_t len = call_id->slen + local_tag->slen + remote_tag->slen + 2;
+
+    if (len > size || len > HIB_MAX_KEY_LEN)
+	return 0;
+
+    pj_memcpy(buf, call_id->ptr, call_id->slen);
+    buf += call_id->slen;
+    *buf++ = '\n';
+    pj_memcpy(buf, local_tag->ptr, local_tag->slen);
+    buf += local_tag->slen;
+    *buf++ = '\n';
+    pj_memcpy(buf, remote_tag->ptr, remote_tag->slen);
+
+    return (unsigned)len;
+}
+
+
+/* Print "<key> <value>\n" line of subscription record. If hdr is
+ * specified, the header is printed, without its name if strip_name is set.
+ */
+static pj_bool_t hib_print_line(char **p, char *end, char key,
+				const pj_str_t *val, const void *hdr,
+				pj_bool_t strip_name)
+{
+    int len;
+
+    if (end - *p < 4)
+	return PJ_FALSE;
+
+    if (hdr) {
+	char *v;
+
+	len = pjsip_hdr_print_on((void*)hdr, *p+2, end - *p - 3);
+	if (len < 1)
+	    return PJ_FALSE;
+
+	if (strip_name) {
+	    v = (char*)pj_memchr(*p+2, ':', len);
+	    if (!v)
+		return PJ_FALSE;
+	    for (++v; *v==' '; ++v)
+		;
+	    len -= (int)(v - (*p+2));
+	    pj_memmove(*p+2, v, len);
+	}
+    } else {
+	if (val->slen > end - *p - 3)
+	    return PJ_FALSE;
+	len = (int)val->slen;
+	pj_memcpy(*p+2, val->ptr, len);
+    }
+
+    (*p)[0] = key;
+    (*p)[1] = ' ';
+    (*p)[len+2] = '\n';
+    *p += len + 3;
+    return PJ_TRUE;
+}
+
+
+/* Save subscription attributes which live in the dialog pool. */
+static pj_ssize_t hib_save_sub(pjsip_evsub *sub, char *buf, char *end)
+{
+    char *p = buf;
+    const pjsip_hdr *hdr;
+
+    if (!hib_print_line(&p, end, 'E', &sub->event->event_type, NULL, 0))
+	return -1;
+    if (sub->event->id_param.slen &&
+	!hib_print_line(&p, end, 'e', &sub->event->id_param, NULL, 0))
+    {
+	return -1;
+    }
+    if (pj_strcmp(&sub->state_str, &evsub_state_names[sub->state]) != 0 &&
+	!hib_print_line(&p, end, 'S', &sub->state_str, NULL, 0))
+    {
+	return -1;
+    }
+    if (sub->accept && sub->accept->count &&
+	!hib_print_line(&p, end, 'A', NULL, sub->accept, PJ_TRUE))
+    {
+	return -1;
+    }
+    for (hdr=sub->sub_hdr_list.next; hdr!=&sub->sub_hdr_list; hdr=hdr->next) {
+	if (!hib_print_line(&p, end, 'H', NULL, hdr, PJ_FALSE))
+	    return -1;
+    }
+
+    return p - buf;
+}
+
+
+/* Restore subscription attributes saved by hib_save_sub(). The record
+ * has been copied to the dialog pool and NULL terminated.
+ */
+static pj_status_t hib_restore_sub(pjsip_evsub *sub, char *line)
+{
+    const pj_str_t STR_ACCEPT = { "Accept", 6 };
+    char *end;
+
+    for (; *line; line = end + 1) {
+	char *val = line + 2;
+	pj_str_t name;
+	pjsip_hdr *hdr;
+
+	end = pj_ansi_strchr(line, '\n');
+	if (!end || end - line < 2)
+	    return PJ_EINVAL;
+	*end = '\0';
+
+	switch (line[0]) {
+	case 'E':
+	    break;
+	case 'e':
+	    sub->event->id_param = pj_str(val);
+	    break;
+	case 'S':
+	    sub->state_str = pj_str(val);
+	    break;
+	case 'A':
+	    hdr = (pjsip_hdr*) pjsip_parse_hdr(sub->pool, &STR_ACCEPT, val,
+					       end - val, NULL);
+	    if (!hdr)
+		return PJSIP_EINVALIDHDR;
+	    sub->accept = (pjsip_accept_hdr*) hdr;
+	    break;
+	case 'H':
+	    name.ptr = val;
+	    val = pj_ansi_strchr(val, ':');
+	    if (!val)
+		return PJSIP_EINVALIDHDR;
+	    name.slen = val - name.ptr;
+	    for (++val; *val==' '; ++val)
+		;
+	    hdr = (pjsip_hdr*) pjsip_parse_hdr(sub->pool, &name, val,
+					       end - val, NULL);
+	    if (!hdr)
+		return PJSIP_EINVALIDHDR;
+	    pj_list_push_back(&sub->sub_hdr_list, hdr);
+	    break;
+	default:
+	    return PJ_EINVAL;
+	}
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+static void hib_on_timer(pj_timer_heap_t *timer_heap,
+			 struct pj_timer_entry *entry);
+
+
+/* Remove record from the table and cancel its timer. If the timer callback
+ * is already running, it is marked as orphan and it will be released by the
+ * callback. Hibernation mutex must be held.
+ */
+static void hib_detach(struct evsub_hib *hib)
+{
+    char *key = hib_text(hib);
+
+    pj_hash_set(NULL, mod_evsub.hib_table, key, hib->key_len, 0, NULL);
+    --mod_evsub.hib_cnt;
+
+    if (hib->timer.id) {
+	hib->timer.id = 0;
+	if (pj_timer_heap_cancel(pjsip_endpt_get_timer_heap(mod_evsub.endpt),
+				 &hib->timer) == 0)
+	{
+	    hib->orphan = PJ_TRUE;
+	    ++mod_evsub.hib_orphan_cnt;
+	}
+    }
+}
+
+
+/* Tell the remote party about the end of a subscription which can not be
+ * rehydrated: the notifier sends NOTIFY with terminated state, and the
+ * subscriber unsubscribes. The dialog must be locked.
+ */
+static void hib_send_terminate(pjsip_dialog *dlg, pjsip_role_e role,
+			       const pj_str_t *event)
+{
+    pjsip_tx_data *tdata;
+    pjsip_event_hdr *event_hdr;
+    pj_status_t status;
+
+    status = pjsip_dlg_create_request(dlg, (role == PJSIP_ROLE_UAS ?
+					    &pjsip_notify_method :
+					    &pjsip_subscribe_method),
+				      -1, &tdata);
+    if (status != PJ_SUCCESS)
+	return;
+
+    event_hdr = pjsip_event_hdr_create(tdata->pool);
+    pj_strdup(tdata->pool, &event_hdr->event_type, event);
+    pjsip_msg_add_hdr(tdata->msg, (pjsip_hdr*)event_hdr);
+
+    if (role == PJSIP_ROLE_UAS) {
+	pjsip_sub_state_hdr *sub_state;
+
+	sub_state = pjsip_sub_state_hdr_create(tdata->pool);
+	sub_state->sub_state = STR_TERMINATED;
+	sub_state->reason_param = STR_NORESOURCE;
+	pjsip_msg_add_hdr(tdata->msg, (pjsip_hdr*)sub_state);
+    } else {
+	pjsip_msg_add_hdr(tdata->msg, (pjsip_hdr*)
+			  pjsip_expires_hdr_create(tdata->pool, 0));
+    }
+
+    pjsip_dlg_send_request(dlg, tdata, -1, NULL);
+}
+
+
+/* Recreate the dialog and the subscription from detached record. On
+ * success, the dialog is returned locked, and the state saved by the user
+ * has been copied to the dialog pool. Hibernation mutex must be held.
+ */
+static pj_status_t hib_wake(struct evsub_hib *hib, pjsip_evsub **p_sub,
+			    char **user_buf)
+{
+    char *key = hib_text(hib);
+    char *dlg_rec = key + hib->key_len;
+    char *sub_rec = dlg_rec + hib->dlg_len;
+    char *line;
+    const struct hib_mod_data *mod = (const struct hib_mod_data*)(hib+1);
+    pjsip_dialog *dlg;
+    pjsip_evsub *sub;
+    pj_str_t event = {NULL, 0};
+    unsigned i;
+    pj_status_t status;
+
+    status = pjsip_dlg_restore(pjsip_ua_instance(), dlg_rec, hib->dlg_len,
+			       &dlg);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    pjsip_dlg_inc_lock(dlg);
+
+    /* Copy subscription record and user state to the dialog pool */
+    line = (char*) pj_pool_alloc(dlg->pool, hib->sub_len + 1);
+    pj_memcpy(line, sub_rec, hib->sub_len);
+    line[hib->sub_len] = '\0';
+
+    *user_buf = (char*) pj_pool_alloc(dlg->pool, hib->user_len + 1);
+    pj_memcpy(*user_buf, sub_rec + hib->sub_len, hib->user_len);
+
+    /* First line is the event type */
+    if (line[0] != 'E' || !pj_ansi_strchr(line, '\n')) {
+	status = PJ_EINVAL;
+	goto on_error;
+    }
+    event.ptr = line + 2;
+    event.slen = pj_ansi_strchr(line, '\n') - event.ptr;
+
+    status = evsub_create(dlg, hib->role, &hib->user, &event, hib->option,
+			  &sub);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    status = hib_restore_sub(sub, line);
+    if (status != PJ_SUCCESS) {
+	sub->call_cb = PJ_FALSE;
+	pjsip_dlg_inc_session(dlg, &mod_evsub.mod);
+	evsub_destroy(sub);
+	goto on_error;
+    }
+
+    sub->expires->ivalue = hib->expires;
+    sub->state = hib->state;
+    if (sub->state_str.ptr == evsub_state_names[PJSIP_EVSUB_STATE_NULL].ptr)
+	sub->state_str = evsub_state_names[sub->state];
+    sub->refresh_time = hib->refresh_time;
+
+    for (i=0; i<hib->mod_cnt; ++i) {
+	if (mod[i].data)
+	    sub->mod_data[mod[i].id] = mod[i].data;
+    }
+
+    pjsip_dlg_inc_session(dlg, &mod_evsub.mod);
+
+    PJ_LOG(4,(sub->obj_name, "Subscription rehydrated, dialog %s",
+	      dlg->obj_name));
+
+    *p_sub = sub;
+    return PJ_SUCCESS;
+
+on_error:
+    /* Terminate the subscription. The dialog is destroyed when the request
+     * transaction completes.
+     */
+    if (event.slen)
+	hib_send_terminate(dlg, hib->role, &event);
+    pjsip_dlg_dec_lock(dlg);
+    return status;
+}
+
+
+/* Wake up hibernated subscription: detach the record, recreate the
+ * subscription, restart its timer (unless the timer has elapsed, in
+ * which case the caller will handle it) and call on_rehydrate() callback.
+ * Hibernation mutex must be held, and it is released by this function
+ * before calling the callback.
+ */
+static pj_status_t hib_wake_and_unlock(struct evsub_hib *hib,
+				       pj_bool_t timer_elapsed,
+				       pjsip_evsub **p_sub)
+{
+    pjsip_evsub *sub = NULL;
+    char *user_buf;
+    unsigned user_len = hib->user_len;
+    pj_status_t status;
+
+    if (!timer_elapsed)
+	hib_detach(hib);
+
+    status = hib_wake(hib, &sub, &user_buf);
+    if (status == PJ_SUCCESS && hib->timer_type != TIMER_TYPE_NONE &&
+	!timer_elapsed)
+    {
+	pj_time_val now, delay;
+
+	pj_gettimeofday(&now);
+	delay = hib->timer_due;
+	PJ_TIME_VAL_SUB(delay, now);
+	if (delay.msec)
+	    ++delay.sec;
+	set_timer(sub, hib->timer_type, delay.sec > 0 ? delay.sec : 1);
+    }
+
+    if (status != PJ_SUCCESS) {
+	char *key = hib_text(hib);
+	char *eol = (char*) pj_memchr(key, '\n', hib->key_len);
+
+	PJ_PERROR(2,(THIS_FILE, status,
+		     "Unable to rehydrate hibernated subscription, "
+		     "subscription terminated (Call-ID %.*s)",
+		     (int)(eol ? eol - key : hib->key_len), key));
+    }
+
+    if (!hib->orphan)
+	hib_release(hib);
+
+    pj_mutex_unlock(mod_evsub.hib_mutex);
+
+    if (status != PJ_SUCCESS)
+	return status;
+
+    if (sub->user.on_rehydrate)
+	(*sub->user.on_rehydrate)(sub, user_buf, user_len);
+
+    pjsip_dlg_dec_lock(sub->dlg);
+
+    if (p_sub)
+	*p_sub = sub;
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Timer callback of hibernated subscription.
+ */
+static void hib_on_timer(pj_timer_heap_t *timer_heap,
+			 struct pj_timer_entry *entry)
+{
+    struct evsub_hib *hib = (struct evsub_hib*) entry->user_data;
+    pjsip_evsub *sub;
+    int timer_type;
+
+    pj_mutex_lock(mod_evsub.hib_mutex);
+
+    if (hib->orphan) {
+	/* Subscription has been rehydrated by somebody else, or the module
+	 * is being unloaded.
+	 */
+	hib_release(hib);
+	--mod_evsub.hib_orphan_cnt;
+	pj_mutex_unlock(mod_evsub.hib_mutex);
+	return;
+    }
+
+    hib->timer.id = 0;
+    hib_detach(hib);
+    timer_type = hib->timer_type;
+
+    if (hib_wake_and_unlock(hib, PJ_TRUE, &sub) == PJ_SUCCESS) {
+	/* Process the timer as if the subscription had been awake */
+	sub->timer.id = timer_type;
+	on_timer(timer_heap, &sub->timer);
+    }
+}
+
+
+/*
+ * Rehydrate hibernated subscription when request is received in its
+ * dialog.
+ */
+static pj_bool_t mod_evsub_hib_on_rx_request(pjsip_rx_data *rdata)
+{
+    char key[HIB_MAX_KEY_LEN];
+    unsigned key_len;
+    struct evsub_hib *hib;
+
+    if (mod_evsub.hib_cnt == 0 || rdata->msg_info.to->tag.slen == 0)
+	return PJ_FALSE;
+
+    key_len = hib_make_key(key, sizeof(key), &rdata->msg_info.cid->id,
+			   &rdata->msg_info.to->tag,
+			   &rdata->msg_info.from->tag);
+    if (key_len == 0)
+	return PJ_FALSE;
+
+    pj_mutex_lock(mod_evsub.hib_mutex);
+
+    hib = (struct evsub_hib*)
+	  pj_hash_get(mod_evsub.hib_table, key, key_len, NULL);
+    if (hib == NULL) {
+	pj_mutex_unlock(mod_evsub.hib_mutex);
+	return PJ_FALSE;
+    }
+
+    PJ_LOG(5,(THIS_FILE, "Rehydrating subscription on incoming %.*s",
+	      (int)rdata->msg_info.msg->line.req.method.name.slen,
+	      rdata->msg_info.msg->line.req.method.name.ptr));
+
+    hib_wake_and_unlock(hib, PJ_FALSE, NULL);
+
+    /* Let the user agent layer dispatch the request to the dialog */
+    return PJ_FALSE;
+}
+
+
+/*
+ * Hibernate subscription.
+ */
+PJ_DEF(pj_status_t) pjsip_evsub_hibernate(pjsip_evsub *sub)
+{
+    char buf[PJSIP_EVSUB_HIB_MAX_LEN];
+    char *p = buf, *end = buf + sizeof(buf);
+    struct hib_mod_data mod[PJSIP_MAX_MODULE];
+    unsigned mod_cnt = 0;
+    pjsip_dialog *dlg;
+    struct dlgsub *dlgsub_head;
+    struct evsub_hib *hib;
+    pj_size_t dlg_len;
+    pj_ssize_t sub_len;
+    unsigned key_len, user_len = 0, i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(sub, PJ_EINVAL);
+
+    dlg = sub->dlg;
+    pjsip_dlg_inc_lock(dlg);
+
+    /* Only idle subscription which is the sole user of its dialog can be
+     * hibernated. The session count includes our own lock, and it also
+     * rejects the call when the dialog is locked by the caller, since the
+     * dialog would not be destroyed below.
+     */
+    dlgsub_head = (struct dlgsub*) dlg->mod_data[mod_evsub.mod.id];
+    if ((sub->state != PJSIP_EVSUB_STATE_PENDING &&
+	 sub->state != PJSIP_EVSUB_STATE_ACTIVE) ||
+	sub->pending_tsx || dlg->tsx_count || dlg->sess_count != 2 ||
+	dlg->usage_cnt != 1 || dlgsub_head->next->next != dlgsub_head ||
+	(sub->timer.id != TIMER_TYPE_NONE &&
+	 sub->timer.id != TIMER_TYPE_UAC_REFRESH &&
+	 sub->timer.id != TIMER_TYPE_UAS_TIMEOUT))
+    {
+	status = PJ_EBUSY;
+	goto on_return;
+    }
+
+    /* Key, dialog and subscription */
+    key_len = hib_make_key(p, end-p, &dlg->call_id->id,
+			   &dlg->local.info->tag, &dlg->remote.info->tag);
+    if (key_len == 0) {
+	status = PJ_ETOOBIG;
+	goto on_return;
+    }
+    p += key_len;
+
+    status = pjsip_dlg_save(dlg, p, end-p, &dlg_len);
+    if (status != PJ_SUCCESS) {
+	if (status == PJ_ETOOSMALL)
+	    status = PJ_ETOOBIG;
+	goto on_return;
+    }
+    p += dlg_len;
+
+    sub_len = hib_save_sub(sub, p, end);
+    if (sub_len < 0) {
+	status = PJ_ETOOBIG;
+	goto on_return;
+    }
+    p += sub_len;
+
+    /* Package and application state */
+    if (sub->user.on_hibernate) {
+	int len = (*sub->user.on_hibernate)(sub, p, (unsigned)(end-p));
+	if (len < 0 || len > end-p) {
+	    status = PJ_EBUSY;
+	    goto on_return;
+	}
+	user_len = len;
+	p += len;
+    }
+
+    for (i=0; i<PJSIP_MAX_MODULE; ++i) {
+	if (sub->mod_data[i]) {
+	    mod[mod_cnt].id = i;
+	    mod[mod_cnt].data = sub->mod_data[i];
+	    ++mod_cnt;
+	}
+    }
+
+    pj_mutex_lock(mod_evsub.hib_mutex);
+
+    hib = hib_alloc(sizeof(struct evsub_hib) + mod_cnt * sizeof(mod[0]) +
+		    (p - buf));
+    if (!hib) {
+	pj_mutex_unlock(mod_evsub.hib_mutex);
+	status = PJ_ETOOBIG;
+	goto on_return;
+    }
+
+    pj_memcpy(&hib->user, &sub->user, sizeof(pjsip_evsub_user));
+    hib->role = sub->role;
+    hib->state = sub->state;
+    hib->option = sub->option;
+    hib->expires = sub->expires->ivalue;
+    hib->refresh_time = sub->refresh_time;
+    hib->mod_cnt = mod_cnt;
+    hib->key_len = key_len;
+    hib->dlg_len = (unsigned)dlg_len;
+    hib->sub_len = (unsigned)sub_len;
+    hib->user_len = user_len;
+    pj_memcpy(hib+1, mod, mod_cnt * sizeof(mod[0]));
+    pj_memcpy(hib_text(hib), buf, p - buf);
+
+    pj_timer_entry_init(&hib->timer, 0, hib, &hib_on_timer);
+    if (sub->timer.id != TIMER_TYPE_NONE) {
+	pj_time_val now, delay;
+
+	pj_gettimeofday(&now);
+	delay = sub->timer_due;
+	PJ_TIME_VAL_SUB(delay, now);
+	if (delay.sec < 0)
+	    delay.sec = delay.msec = 0;
+
+	hib->timer_type = sub->timer.id;
+	hib->timer_due = sub->timer_due;
+	hib->timer.id = 1;
+	status = pjsip_endpt_schedule_timer(mod_evsub.endpt, &hib->timer,
+					    &delay);
+	if (status != PJ_SUCCESS) {
+	    /* Keep the subscription awake */
+	    hib->timer.id = 0;
+	    hib_release(hib);
+	    pj_mutex_unlock(mod_evsub.hib_mutex);
+	    goto on_return;
+	}
+    }
+
+    pj_hash_set_np(mod_evsub.hib_table, hib_text(hib), key_len, 0,
+		   hib->hbuf, hib);
+    ++mod_evsub.hib_cnt;
+
+    /* The hibernation is committed, let the package release the state of
+     * the old instance, and only keep the module data which is left.
+     */
+    if (sub->user.on_hibernated) {
+	struct hib_mod_data *hmod = (struct hib_mod_data*)(hib+1);
+
+	(*sub->user.on_hibernated)(sub);
+	for (i=0; i<mod_cnt; ++i)
+	    hmod[i].data = sub->mod_data[hmod[i].id];
+    }
+
+    PJ_LOG(4,(sub->obj_name, "Subscription hibernated, record length=%d",
+	      (int)(sizeof(struct evsub_hib) + mod_cnt * sizeof(mod[0]) +
+		    (p - buf))));
+
+    /* Destroy the subscription and the dialog without notifying anybody.
+     * The dialog is unregistered while the mutex is held, so the record
+     * can not be rehydrated while the old dialog still exists.
+     */
+    sub->call_cb = PJ_FALSE;
+    evsub_destroy(sub);
+    pjsip_dlg_dec_lock(dlg);
+
+    pj_mutex_unlock(mod_evsub.hib_mutex);
+    return PJ_SUCCESS;
+
+on_return:
+    pjsip_dlg_dec_lock(dlg);
+    return status;
+}
+
+
+/*
+ * Rehydrate hibernated subscription.
+ */
+PJ_DEF(pj_status_t) pjsip_evsub_rehydrate(const pj_str_t *call_id,
+					  const pj_str_t *local_tag,
+					  const pj_str_t *remote_tag,
+					  pjsip_evsub **p_evsub)
+{
+    char key[HIB_MAX_KEY_LEN];
+    unsigned key_len;
+    struct evsub_hib *hib;
+
+    PJ_ASSERT_RETURN(call_id && local_tag && remote_tag, PJ_EINVAL);
+
+    key_len = hib_make_key(key, sizeof(key), call_id, local_tag, remote_tag);
+    if (key_len == 0)
+	return PJ_ENOTFOUND;
+
+    pj_mutex_lock(mod_evsub.hib_mutex);
+
+    hib = (struct evsub_hib*)
+	  pj_hash_get(mod_evsub.hib_table, key, key_len, NULL);
+    if (hib == NULL) {
+	pj_mutex_unlock(mod_evsub.hib_mutex);
+	return PJ_ENOTFOUND;
+    }
+
+    return hib_wake_and_unlock(hib, PJ_FALSE, p_evsub);
+}
+
+
+/*
+ * Get the number of hibernated subscriptions.
+ */
+PJ_DEF(unsigned) pjsip_evsub_get_hibernated_count(void)
+{
+    return mod_evsub.hib_cnt;
+}
+
+
+/*
+ * Cancel timers of hibernated subscriptions and release the table, on
+ * module unload.
+ */
+static void hib_cleanup(void)
+{
+    pj_hash_iterator_t itbuf, *it;
+
+    if (!mod_evsub.hib_pool)
+	return;
+
+    pj_mutex_lock(mod_evsub.hib_mutex);
+
+    /* Records whose timer has already fired become orphans, to be
+     * released by the timer callback.
+     */
+    it = pj_hash_first(mod_evsub.hib_table, &itbuf);
+    while (it) {
+	struct evsub_hib *hib = (struct evsub_hib*)
+				pj_hash_this(mod_evsub.hib_table, it);
+	it = pj_hash_next(mod_evsub.hib_table, it);
+	hib_detach(hib);
+    }
+
+    /* Wait for the orphans before releasing the pool */
+    while (mod_evsub.hib_orphan_cnt) {
+	pj_mutex_unlock(mod_evsub.hib_mutex);
+	pj_thread_sleep(10);
+	pj_mutex_lock(mod_evsub.hib_mutex);
+    }
+
+    pj_mutex_unlock(mod_evsub.hib_mutex);
+
+    mod_evsub.hib_cnt = 0;
+    pj_bzero(mod_evsub.hib_free, sizeof(mod_evsub.hib_free));
+    pj_mutex_destroy(mod_evsub.hib_mutex);
+    mod_evsub.hib_mutex = NULL;
+    pjsip_endpt_release_pool(mod_evsub.endpt, mod_evsub.hib_pool);
+    mod_evsub.hib_pool = NULL;
+}
@@ -24,8 +24,12 @@
 #include <pjsip/sip_multipart.h>
 #include <pjsip/sip_endpoint.h>
 #include <pjsip/sip_dialog.h>
+#include <pjsip/sip_event.h>
+#include <pjsip/sip_transaction.h>
+#include <pjsip/sip_errno.h>
 #include <pj/assert.h>
 #include <pj/guid.h>
+#include <pj/lock.h>
 #include <pj/log.h>
 #include <pj/os.h>
 #include <pj/pool.h>
@@ -35,6 +39,9 @@
 #define THIS_FILE		    "presence.c"
 #define PRES_DEFAULT_EXPIRES	    PJSIP_PRES_DEFAULT_EXPIRES
 
+/* Number of watchers notified by a fan-out worker at a time */
+#define FANOUT_CHUNK		    64
+
 #if PJSIP_PRES_BAD_CONTENT_RESPONSE < 200 || \
     PJSIP_PRES_BAD_CONTENT_RESPONSE > 699 || \
     PJSIP_PRES_BAD_CONTENT_RESPONSE/100 == 3
@@ -72,6 +79,8 @@ typedef enum content_type_e
     CONTENT_TYPE_XPIDF,
 } content_type_e;
 
+struct pres_watcher;
+
 /*
  * This structure describe a presentity, for both subscriber and notifier.
  */
@@ -85,6 +94,8 @@ struct pjsip_pres
     pj_pool_t		*tmp_pool;	/**< Pool for tmp_status	    */
     pjsip_pres_status	 tmp_status;	/**< Temp, before NOTIFY is answred.*/
     pjsip_evsub_user	 user_cb;	/**< The user callback.		    */
+    pjsip_presentity	*presentity;	/**< Presentity, if attached.	    */
+    struct pres_watcher	*watcher;	/**< Entry in presentity.	    */
 };
 
 
@@ -111,6 +122,17 @@ static void pres_on_evsub_rx_notify( pjsip_evsub *sub,
 				     pjsip_msg_body **p_body);
 static void pres_on_evsub_client_refresh(pjsip_evsub *sub);
 static void pres_on_evsub_server_timeout(pjsip_evsub *sub);
+static int  pres_on_evsub_hibernate(pjsip_evsub *sub, char *buf,
+				    unsigned size);
+static void pres_on_evsub_hibernated(pjsip_evsub *sub);
+static void pres_on_evsub_rehydrate(pjsip_evsub *sub, const char *buf,
+				    unsigned len);
+
+static pj_status_t presentity_create_msg_body(pjsip_presentity *p,
+					      content_type_e content_type,
+					      pjsip_tx_data *tdata);
+static void presentity_detach(pjsip_pres *pres);
+static void presentity_on_notify_complete(pjsip_pres *pres);
 
 
 /*
@@ -124,6 +146,9 @@ static pjsip_evsub_user pres_user =
     &pres_on_evsub_rx_notify,
     &pres_on_evsub_client_refresh,
     &pres_on_evsub_server_timeout,
+    &pres_on_evsub_hibernate,
+    &pres_on_evsub_hibernated,
+    &pres_on_evsub_rehydrate,
 };
 
 
@@ -515,7 +540,8 @@ PJ_DEF(pj_status_t) pjsip_pres_notify( pjsip_evsub *sub,
      * and remote cancels the subscription.
      */
     PJ_ASSERT_RETURN(state==PJSIP_EVSUB_STATE_TERMINATED ||
-		     pres->status.info_cnt > 0, PJSIP_SIMPLE_ENOPRESENCEINFO);
+		     pres->status.info_cnt > 0 || pres->presentity,
+		     PJSIP_SIMPLE_ENOPRESENCEINFO);
 
 
     /* Lock object. */
@@ -530,7 +556,12 @@ PJ_DEF(pj_status_t) pjsip_pres_notify( pjsip_evsub *sub,
     /* Create message body to reflect the presence status. 
      * Only do this if we have presence status info to send (see above).
      */
-    if (pres->status.info_cnt > 0) {
+    if (pres->presentity) {
+	status = presentity_create_msg_body(pres->presentity,
+					    pres->content_type, tdata);
+	if (status != PJ_SUCCESS)
+	    goto on_return;
+    } else if (pres->status.info_cnt > 0) {
 	status = pres_create_msg_body( pres, tdata );
 	if (status != PJ_SUCCESS)
 	    goto on_return;
@@ -580,7 +611,12 @@ PJ_DEF(pj_status_t) pjsip_pres_current_notify( pjsip_evsub *sub,
 
 
     /* Create message body to reflect the presence status. */
-    if (pres->status.info_cnt > 0) {
+    if (pres->presentity) {
+	status = presentity_create_msg_body(pres->presentity,
+					    pres->content_type, tdata);
+	if (status != PJ_SUCCESS)
+	    goto on_return;
+    } else if (pres->status.info_cnt > 0) {
 	status = pres_create_msg_body( pres, tdata );
 	if (status != PJ_SUCCESS)
 	    goto on_return;
@@ -606,6 +642,824 @@ PJ_DEF(pj_status_t) pjsip_pres_send_request( pjsip_evsub *sub,
 }
 
 
+/*
+ * Presentity.
+ */
+
+/* Presence document of a presentity, encoded once for all watchers */
+typedef struct pres_doc
+{
+    pj_pool_t		*pool;
+    unsigned		 ref;		/* Protected by presentity lock	    */
+    unsigned		 gen;		/* Status generation		    */
+    pjsip_pres_status	 status;
+    pj_str_t		 body[CONTENT_TYPE_XPIDF+1];
+} pres_doc;
+
+/* Server subscription attached to presentity. The entry holds a session
+ * reference of the dialog, which is released when the entry is detached
+ * and no longer referenced by fan-out jobs.
+ */
+typedef struct pres_watcher
+{
+    PJ_DECL_LIST_MEMBER(struct pres_watcher);
+    pjsip_pres		*pres;
+    pjsip_dialog	*dlg;
+    pj_bool_t		 attached;
+    unsigned		 ref;		/* References by fan-out jobs	    */
+    unsigned		 notify_cnt;	/* Outstanding NOTIFY, dlg lock	    */
+    pj_bool_t		 stale;		/* Status changed while outstanding */
+} pres_watcher;
+
+/* State of the throttle timer of presentity, in the timer id */
+enum
+{
+    TIMER_NONE,
+    TIMER_SCHEDULED,
+    TIMER_RUNNING
+};
+
+/* NOTIFY fan-out to the watchers of a presentity */
+typedef struct fanout_job
+{
+    PJ_DECL_LIST_MEMBER(struct fanout_job);
+    pj_pool_t		*pool;
+    pres_doc		*doc;
+    unsigned		 count;
+    unsigned		 next_idx;	/* Next watcher to be taken	    */
+    unsigned		 done;
+    pres_watcher       **watchers;
+} fanout_job;
+
+struct pjsip_presentity
+{
+    pj_pool_t		*pool;
+    pjsip_endpoint	*endpt;
+    pj_lock_t		*lock;
+    pj_str_t		 entity;
+    pjsip_presentity_setting setting;
+
+    pj_pool_t		*status_pool;	/* Pool for status		    */
+    pj_pool_t		*tmp_pool;	/* Pool for new status/rendering    */
+    pjsip_pres_status	 status;	/* Latest status		    */
+    unsigned		 status_gen;	/* Incremented on status change	    */
+    pj_bool_t		 dirty;		/* Status not yet fanned out	    */
+    pres_doc		*doc;		/* Latest encoded document	    */
+    pj_time_val		 last_fanout;
+    pj_timer_entry	 timer;		/* Throttle timer, see TIMER_xxx    */
+
+    pres_watcher	 watcher_list;
+    pres_watcher	 free_watcher;
+    unsigned		 watcher_cnt;
+
+    fanout_job		 job_list;
+    pj_sem_t		*sem;
+    pj_bool_t		 quit;
+    unsigned		 thread_cnt;
+    pj_thread_t	       **threads;
+};
+
+
+/* Duplicate presence status */
+static void pres_status_dup(pj_pool_t *pool, pjsip_pres_status *dst,
+			    const pjsip_pres_status *src)
+{
+    unsigned i;
+
+    pj_bzero(dst, sizeof(*dst));
+    dst->info_cnt = src->info_cnt;
+    for (i=0; i<src->info_cnt; ++i) {
+	dst->info[i].basic_open = src->info[i].basic_open;
+	pj_strdup(pool, &dst->info[i].id, &src->info[i].id);
+	pj_strdup(pool, &dst->info[i].contact, &src->info[i].contact);
+	pjrpid_element_dup(pool, &dst->info[i].rpid, &src->info[i].rpid);
+    }
+    dst->_is_valid = PJ_TRUE;
+}
+
+/* Release document reference. Must be called with presentity lock. */
+static void pres_doc_dec_ref(pres_doc *doc)
+{
+    if (--doc->ref == 0)
+	pj_pool_release(doc->pool);
+}
+
+/* Get the document for the latest status, creating it if the status has
+ * changed. Must be called with presentity lock.
+ */
+static pres_doc *presentity_get_doc(pjsip_presentity *p)
+{
+    pres_doc *doc;
+    pj_pool_t *pool;
+
+    if (p->doc && p->doc->gen == p->status_gen)
+	return p->doc;
+    if (p->status_gen == 0)
+	return NULL;
+
+    pool = pj_pool_create(p->pool->factory, "presdoc%p", 512, 512, NULL);
+    if (!pool)
+	return NULL;
+
+    doc = PJ_POOL_ZALLOC_T(pool, pres_doc);
+    doc->pool = pool;
+    doc->ref = 1;
+    doc->gen = p->status_gen;
+    pres_status_dup(pool, &doc->status, &p->status);
+
+    if (p->doc)
+	pres_doc_dec_ref(p->doc);
+    p->doc = doc;
+
+    return doc;
+}
+
+/* Encode the document for the content type if it has not been done.
+ * Must be called with presentity lock.
+ */
+static pj_status_t pres_doc_render(pjsip_presentity *p, pres_doc *doc,
+				   content_type_e content_type)
+{
+    pjsip_msg_body *body;
+    char *buf;
+    int len;
+    pj_status_t status;
+
+    if (doc->body[content_type].slen)
+	return PJ_SUCCESS;
+
+    if (content_type == CONTENT_TYPE_PIDF) {
+	status = pjsip_pres_create_pidf(p->tmp_pool, &doc->status,
+					&p->entity, &body);
+    } else if (content_type == CONTENT_TYPE_XPIDF) {
+	status = pjsip_pres_create_xpidf(p->tmp_pool, &doc->status,
+					 &p->entity, &body);
+    } else {
+	status = PJSIP_SIMPLE_EBADCONTENT;
+    }
+    if (status != PJ_SUCCESS)
+	goto on_return;
+
+    buf = (char*) pj_pool_alloc(p->tmp_pool, PJSIP_MAX_PKT_LEN);
+    len = (*body->print_body)(body, buf, PJSIP_MAX_PKT_LEN);
+    if (len < 1) {
+	status = PJSIP_EMSGTOOLONG;
+	goto on_return;
+    }
+
+    doc->body[content_type].ptr = (char*) pj_pool_alloc(doc->pool, len);
+    pj_memcpy(doc->body[content_type].ptr, buf, len);
+    doc->body[content_type].slen = len;
+
+on_return:
+    pj_pool_reset(p->tmp_pool);
+    return status;
+}
+
+/* Attach encoded document to NOTIFY request */
+static void pres_doc_attach(const pres_doc *doc, content_type_e content_type,
+			    pjsip_tx_data *tdata)
+{
+    const pj_str_t *subtype = (content_type == CONTENT_TYPE_XPIDF) ?
+			      &STR_XPIDF_XML : &STR_PIDF_XML;
+
+    tdata->msg->body = pjsip_msg_body_create(tdata->pool, &STR_APPLICATION,
+					     subtype,
+					     &doc->body[content_type]);
+}
+
+/* Create message body for NOTIFY request of a watcher. Called with the
+ * dialog lock held.
+ */
+static pj_status_t presentity_create_msg_body(pjsip_presentity *p,
+					      content_type_e content_type,
+					      pjsip_tx_data *tdata)
+{
+    pres_doc *doc;
+    pj_status_t status = PJ_SUCCESS;
+
+    pj_lock_acquire(p->lock);
+    doc = presentity_get_doc(p);
+    if (doc) {
+	status = pres_doc_render(p, doc, content_type);
+	if (status == PJ_SUCCESS)
+	    pres_doc_attach(doc, content_type, tdata);
+    }
+    pj_lock_release(p->lock);
+
+    return status;
+}
+
+/* Release reference to watcher entry held by fan-out job */
+static void presentity_release_watcher(pjsip_presentity *p, pres_watcher *w)
+{
+    pjsip_dialog *dlg = w->dlg;
+    pj_bool_t dec_session;
+
+    pj_lock_acquire(p->lock);
+    dec_session = (--w->ref == 0 && !w->attached);
+    if (dec_session)
+	pj_list_push_back(&p->free_watcher, w);
+    pj_lock_release(p->lock);
+
+    if (dec_session)
+	pjsip_dlg_dec_session(dlg, &mod_presence);
+}
+
+/* Detach watcher from its presentity. Called with the dialog lock held. */
+static void presentity_detach(pjsip_pres *pres)
+{
+    pjsip_presentity *p = pres->presentity;
+    pres_watcher *w = pres->watcher;
+    pj_bool_t dec_session;
+
+    pj_lock_acquire(p->lock);
+    pj_list_erase(w);
+    --p->watcher_cnt;
+    w->attached = PJ_FALSE;
+    pres->presentity = NULL;
+    pres->watcher = NULL;
+    dec_session = (w->ref == 0);
+    if (dec_session)
+	pj_list_push_back(&p->free_watcher, w);
+    pj_lock_release(p->lock);
+
+    /* The caller holds the dialog lock, so this won't destroy the dialog */
+    if (dec_session)
+	pjsip_dlg_dec_session(pres->dlg, &mod_presence);
+}
+
+/* Send NOTIFY with the latest status to watcher. Called with the dialog
+ * lock held.
+ */
+static void presentity_notify_watcher(pjsip_pres *pres, const pres_doc *doc)
+{
+    pjsip_tx_data *tdata;
+    pj_status_t status;
+
+    status = pjsip_evsub_notify(pres->sub, PJSIP_EVSUB_STATE_ACTIVE,
+				NULL, NULL, &tdata);
+    if (status == PJ_SUCCESS) {
+	if (doc)
+	    pres_doc_attach(doc, pres->content_type, tdata);
+	else
+	    status = presentity_create_msg_body(pres->presentity,
+						pres->content_type, tdata);
+	if (status == PJ_SUCCESS)
+	    status = pjsip_evsub_send_request(pres->sub, tdata);
+	else
+	    pjsip_tx_data_dec_ref(tdata);
+    }
+
+    if (status == PJ_SUCCESS) {
+	++pres->watcher->notify_cnt;
+    } else {
+	PJ_PERROR(4,(THIS_FILE, status, "Error sending NOTIFY to watcher %p",
+		     pres->sub));
+    }
+}
+
+/* Called when outstanding NOTIFY of watcher completes. If the status has
+ * changed in the mean time, send the latest status now. NOTIFY requests
+ * are not sent while the previous one is outstanding, so that the watcher
+ * won't receive them out of order (RFC 6665 Section 4.2.2).
+ */
+static void presentity_on_notify_complete(pjsip_pres *pres)
+{
+    pres_watcher *w = pres->watcher;
+
+    if (w->notify_cnt)
+	--w->notify_cnt;
+
+    if (w->notify_cnt == 0 && w->stale &&
+	pjsip_evsub_get_state(pres->sub) == PJSIP_EVSUB_STATE_ACTIVE)
+    {
+	w->stale = PJ_FALSE;
+	presentity_notify_watcher(pres, NULL);
+    }
+}
+
+/* Send NOTIFY to the watchers of the job */
+static void fanout_notify(pjsip_presentity *p, fanout_job *job,
+			  unsigned first, unsigned count)
+{
+    unsigned i;
+
+    for (i=first; i<first+count; ++i) {
+	pres_watcher *w = job->watchers[i];
+	pjsip_pres *pres = w->pres;
+
+	pjsip_dlg_inc_lock(w->dlg);
+	if (w->attached &&
+	    pjsip_evsub_get_state(pres->sub) == PJSIP_EVSUB_STATE_ACTIVE &&
+	    job->doc->body[pres->content_type].slen)
+	{
+	    if (w->notify_cnt)
+		w->stale = PJ_TRUE;
+	    else
+		presentity_notify_watcher(pres, job->doc);
+	}
+	pjsip_dlg_dec_lock(w->dlg);
+
+	presentity_release_watcher(p, w);
+    }
+}
+
+static void fanout_job_destroy(pjsip_presentity *p, fanout_job *job)
+{
+    pj_lock_acquire(p->lock);
+    pres_doc_dec_ref(job->doc);
+    pj_lock_release(p->lock);
+
+    pj_pool_release(job->pool);
+}
+
+/* Take a chunk of the first job in the queue and notify the watchers.
+ * Jobs are processed one at a time, so that NOTIFY requests of a dialog
+ * are sent in order. Returns PJ_FALSE if there is nothing to take.
+ */
+static pj_bool_t fanout_process_chunk(pjsip_presentity *p)
+{
+    fanout_job *job;
+    unsigned first, count, i, chunks = 0;
+    pj_bool_t done;
+
+    pj_lock_acquire(p->lock);
+    job = p->job_list.next;
+    if (job == &p->job_list || job->next_idx == job->count) {
+	pj_lock_release(p->lock);
+	return PJ_FALSE;
+    }
+    first = job->next_idx;
+    count = job->count - first;
+    if (count > FANOUT_CHUNK)
+	count = FANOUT_CHUNK;
+    job->next_idx += count;
+    pj_lock_release(p->lock);
+
+    fanout_notify(p, job, first, count);
+
+    pj_lock_acquire(p->lock);
+    job->done += count;
+    done = (job->done == job->count);
+    if (done) {
+	pj_list_erase(job);
+	if (!pj_list_empty(&p->job_list)) {
+	    fanout_job *next = p->job_list.next;
+	    chunks = (next->count + FANOUT_CHUNK - 1) / FANOUT_CHUNK;
+	}
+    }
+    pj_lock_release(p->lock);
+
+    if (done) {
+	fanout_job_destroy(p, job);
+
+	/* Wake up workers for the next job */
+	for (i=0; i<chunks && i<p->thread_cnt; ++i)
+	    pj_sem_post(p->sem);
+    }
+
+    return PJ_TRUE;
+}
+
+static int fanout_worker_thread(void *arg)
+{
+    pjsip_presentity *p = (pjsip_presentity*) arg;
+
+    for (;;) {
+	pj_sem_wait(p->sem);
+	if (p->quit)
+	    break;
+	while (fanout_process_chunk(p))
+	    ;
+    }
+
+    return 0;
+}
+
+/* Send the latest status to all active watchers */
+static void presentity_fanout(pjsip_presentity *p)
+{
+    pres_doc *doc;
+    pres_watcher *w;
+    fanout_job *job;
+    pj_pool_t *pool;
+    unsigned i;
+
+    pj_lock_acquire(p->lock);
+
+    if (!p->dirty || p->quit) {
+	pj_lock_release(p->lock);
+	return;
+    }
+    p->dirty = PJ_FALSE;
+    pj_gettickcount(&p->last_fanout);
+
+    doc = presentity_get_doc(p);
+    if (!doc || p->watcher_cnt == 0) {
+	pj_lock_release(p->lock);
+	return;
+    }
+
+    pool = pj_pool_create(p->pool->factory, "presjob%p", 512, 512, NULL);
+    if (!pool) {
+	pj_lock_release(p->lock);
+	return;
+    }
+
+    job = PJ_POOL_ZALLOC_T(pool, fanout_job);
+    job->pool = pool;
+    job->doc = doc;
+    ++doc->ref;
+    job->watchers = (pres_watcher**)
+		    pj_pool_calloc(pool, p->watcher_cnt, sizeof(pres_watcher*));
+
+    /* Encode the document once for each content type used by watchers */
+    for (w=p->watcher_list.next; w!=&p->watcher_list; w=w->next) {
+	if (pres_doc_render(p, doc, w->pres->content_type) != PJ_SUCCESS)
+	    continue;
+	++w->ref;
+	job->watchers[job->count++] = w;
+    }
+
+    if (job->count == 0) {
+	pres_doc_dec_ref(doc);
+	pj_lock_release(p->lock);
+	pj_pool_release(pool);
+	return;
+    }
+
+    if (p->thread_cnt) {
+	unsigned chunks = (job->count + FANOUT_CHUNK - 1) / FANOUT_CHUNK;
+
+	/* Workers will be woken up when the previous job completes */
+	if (!pj_list_empty(&p->job_list))
+	    chunks = 0;
+	pj_list_push_back(&p->job_list, job);
+	pj_lock_release(p->lock);
+
+	for (i=0; i<chunks && i<p->thread_cnt; ++i)
+	    pj_sem_post(p->sem);
+    } else {
+	pj_lock_release(p->lock);
+
+	fanout_notify(p, job, 0, job->count);
+	fanout_job_destroy(p, job);
+    }
+}
+
+static void presentity_timer_cb(pj_timer_heap_t *timer_heap,
+				struct pj_timer_entry *entry)
+{
+    pjsip_presentity *p = (pjsip_presentity*) entry->user_data;
+
+    PJ_UNUSED_ARG(timer_heap);
+
+    pj_lock_acquire(p->lock);
+    if (p->quit) {
+	/* Presentity is being destroyed and waiting for us */
+	entry->id = TIMER_NONE;
+	pj_lock_release(p->lock);
+	return;
+    }
+    entry->id = TIMER_RUNNING;
+    pj_lock_release(p->lock);
+
+    presentity_fanout(p);
+
+    pj_lock_acquire(p->lock);
+    if (entry->id == TIMER_RUNNING)
+	entry->id = TIMER_NONE;
+    pj_lock_release(p->lock);
+}
+
+
+PJ_DEF(void) pjsip_presentity_setting_default(
+				    pjsip_presentity_setting *setting)
+{
+    pj_bzero(setting, sizeof(*setting));
+    setting->throttle_msec = PJSIP_PRES_THROTTLE_MSEC;
+    setting->worker_cnt = PJSIP_PRES_FANOUT_WORKER_CNT;
+}
+
+
+PJ_DEF(pj_status_t) pjsip_presentity_create(pjsip_endpoint *endpt,
+				    const pj_str_t *entity,
+				    const pjsip_presentity_setting *setting,
+				    pjsip_presentity **p_pres)
+{
+    pj_pool_t *pool;
+    pjsip_presentity *p;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(endpt && entity && entity->slen && p_pres, PJ_EINVAL);
+
+    pool = pjsip_endpt_create_pool(endpt, "presentity%p", 512, 512);
+    PJ_ASSERT_RETURN(pool != NULL, PJ_ENOMEM);
+
+    p = PJ_POOL_ZALLOC_T(pool, pjsip_presentity);
+    p->pool = pool;
+    p->endpt = endpt;
+    pj_strdup(pool, &p->entity, entity);
+    if (setting)
+	pj_memcpy(&p->setting, setting, sizeof(*setting));
+    else
+	pjsip_presentity_setting_default(&p->setting);
+    pj_list_init(&p->watcher_list);
+    pj_list_init(&p->free_watcher);
+    pj_list_init(&p->job_list);
+    pj_timer_entry_init(&p->timer, TIMER_NONE, p, &presentity_timer_cb);
+
+    p->status_pool = pj_pool_create(pool->factory, "presst%p", 512, 512,
+				    NULL);
+    p->tmp_pool = pj_pool_create(pool->factory, "prestmp%p", 512, 512,
+				 NULL);
+    if (!p->status_pool || !p->tmp_pool) {
+	status = PJ_ENOMEM;
+	goto on_error;
+    }
+
+    status = pj_lock_create_simple_mutex(pool, "presentity", &p->lock);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    if (p->setting.worker_cnt) {
+	status = pj_sem_create(pool, "presentity", 0,
+			       p->setting.worker_cnt + FANOUT_CHUNK,
+			       &p->sem);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+
+	p->threads = (pj_thread_t**)
+		     pj_pool_calloc(pool, p->setting.worker_cnt,
+				    sizeof(pj_thread_t*));
+	for (i=0; i<p->setting.worker_cnt; ++i) {
+	    status = pj_thread_create(pool, "presfan%p",
+				      &fanout_worker_thread, p, 0, 0,
+				      &p->threads[i]);
+	    if (status != PJ_SUCCESS)
+		goto on_error;
+	    ++p->thread_cnt;
+	}
+    }
+
+    *p_pres = p;
+    return PJ_SUCCESS;
+
+on_error:
+    pjsip_presentity_destroy(p);
+    return status;
+}
+
+
+PJ_DEF(pj_status_t) pjsip_presentity_destroy(pjsip_presentity *p)
+{
+    unsigned i;
+
+    PJ_ASSERT_RETURN(p, PJ_EINVAL);
+
+    /* Cancel the throttle timer. If the timer has already fired, wait
+     * until the callback has finished with the presentity.
+     */
+    if (p->lock) {
+	pj_lock_acquire(p->lock);
+	p->quit = PJ_TRUE;
+	if (p->timer.id == TIMER_SCHEDULED &&
+	    pj_timer_heap_cancel(pjsip_endpt_get_timer_heap(p->endpt),
+				 &p->timer) > 0)
+	{
+	    p->timer.id = TIMER_NONE;
+	}
+	while (p->timer.id != TIMER_NONE) {
+	    pj_lock_release(p->lock);
+	    pj_thread_sleep(10);
+	    pj_lock_acquire(p->lock);
+	}
+	pj_lock_release(p->lock);
+    } else {
+	p->quit = PJ_TRUE;
+    }
+
+    /* Stop workers */
+    for (i=0; i<p->thread_cnt; ++i)
+	pj_sem_post(p->sem);
+    for (i=0; i<p->thread_cnt; ++i) {
+	pj_thread_join(p->threads[i]);
+	pj_thread_destroy(p->threads[i]);
+    }
+    p->thread_cnt = 0;
+
+    /* Drop jobs which haven't been processed */
+    while (!pj_list_empty(&p->job_list)) {
+	fanout_job *job = p->job_list.next;
+
+	pj_list_erase(job);
+	job->done += job->count - job->next_idx;
+	for (i=job->next_idx; i<job->count; ++i)
+	    presentity_release_watcher(p, job->watchers[i]);
+	fanout_job_destroy(p, job);
+    }
+
+    /* Detach watchers */
+    if (p->lock) {
+	for (;;) {
+	    pres_watcher *w;
+	    pjsip_dialog *dlg;
+
+	    pj_lock_acquire(p->lock);
+	    if (pj_list_empty(&p->watcher_list)) {
+		pj_lock_release(p->lock);
+		break;
+	    }
+	    w = p->watcher_list.next;
+	    ++w->ref;
+	    dlg = w->dlg;
+	    pj_lock_release(p->lock);
+
+	    pjsip_dlg_inc_lock(dlg);
+	    if (w->attached)
+		presentity_detach(w->pres);
+	    pjsip_dlg_dec_lock(dlg);
+
+	    presentity_release_watcher(p, w);
+	}
+    }
+
+    if (p->doc) {
+	pres_doc_dec_ref(p->doc);
+	p->doc = NULL;
+    }
+    if (p->sem)
+	pj_sem_destroy(p->sem);
+    if (p->lock)
+	pj_lock_destroy(p->lock);
+    if (p->tmp_pool)
+	pj_pool_release(p->tmp_pool);
+    if (p->status_pool)
+	pj_pool_release(p->status_pool);
+    pjsip_endpt_release_pool(p->endpt, p->pool);
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pjsip_presentity_add_watcher(pjsip_presentity *p,
+						  pjsip_evsub *sub)
+{
+    pjsip_pres *pres;
+    pres_watcher *w;
+
+    PJ_ASSERT_RETURN(p && sub, PJ_EINVAL);
+
+    pres = (pjsip_pres*) pjsip_evsub_get_mod_data(sub, mod_presence.id);
+    PJ_ASSERT_RETURN(pres != NULL, PJSIP_SIMPLE_ENOPRESENCE);
+
+    pjsip_dlg_inc_lock(pres->dlg);
+
+    if (pres->presentity ||
+	pjsip_evsub_get_state(sub) == PJSIP_EVSUB_STATE_TERMINATED)
+    {
+	pjsip_dlg_dec_lock(pres->dlg);
+	return PJ_EINVALIDOP;
+    }
+
+    /* Keep the dialog while it's referenced by the presentity */
+    pjsip_dlg_inc_session(pres->dlg, &mod_presence);
+
+    pj_lock_acquire(p->lock);
+    if (!pj_list_empty(&p->free_watcher)) {
+	w = p->free_watcher.next;
+	pj_list_erase(w);
+    } else {
+	w = PJ_POOL_ALLOC_T(p->pool, pres_watcher);
+    }
+    pj_bzero(w, sizeof(*w));
+    w->pres = pres;
+    w->dlg = pres->dlg;
+    w->attached = PJ_TRUE;
+    pj_list_push_back(&p->watcher_list, w);
+    ++p->watcher_cnt;
+    pj_lock_release(p->lock);
+
+    pres->presentity = p;
+    pres->watcher = w;
+
+    pjsip_dlg_dec_lock(pres->dlg);
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pjsip_presentity_remove_watcher(pjsip_presentity *p,
+						     pjsip_evsub *sub)
+{
+    pjsip_pres *pres;
+    pj_status_t status = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(p && sub, PJ_EINVAL);
+
+    pres = (pjsip_pres*) pjsip_evsub_get_mod_data(sub, mod_presence.id);
+    PJ_ASSERT_RETURN(pres != NULL, PJSIP_SIMPLE_ENOPRESENCE);
+
+    pjsip_dlg_inc_lock(pres->dlg);
+    if (pres->presentity == p)
+	presentity_detach(pres);
+    else
+	status = PJ_ENOTFOUND;
+    pjsip_dlg_dec_lock(pres->dlg);
+
+    return status;
+}
+
+
+PJ_DEF(unsigned) pjsip_presentity_get_watcher_count(pjsip_presentity *p)
+{
+    unsigned count;
+
+    PJ_ASSERT_RETURN(p, 0);
+
+    pj_lock_acquire(p->lock);
+    count = p->watcher_cnt;
+    pj_lock_release(p->lock);
+
+    return count;
+}
+
+
+PJ_DEF(pj_status_t) pjsip_presentity_set_status(pjsip_presentity *p,
+					    const pjsip_pres_status *status)
+{
+    pjsip_pres_status prev;
+    pj_pool_t *tmp;
+    pj_time_val now;
+    unsigned i;
+
+    PJ_ASSERT_RETURN(p && status, PJ_EINVAL);
+    PJ_ASSERT_RETURN(status->info_cnt > 0 &&
+		     status->info_cnt <= PJSIP_PRES_STATUS_MAX_INFO,
+		     PJSIP_SIMPLE_ENOPRESENCEINFO);
+
+    pj_lock_acquire(p->lock);
+
+    /* Copy the status, keeping the tuple ids of the previous status */
+    pj_memcpy(&prev, &p->status, sizeof(prev));
+    pres_status_dup(p->tmp_pool, &p->status, status);
+    for (i=0; i<status->info_cnt && i<prev.info_cnt; ++i) {
+	if (p->status.info[i].id.slen == 0)
+	    pj_strdup(p->tmp_pool, &p->status.info[i].id, &prev.info[i].id);
+    }
+
+    /* Swap pools */
+    tmp = p->tmp_pool;
+    p->tmp_pool = p->status_pool;
+    p->status_pool = tmp;
+    pj_pool_reset(p->tmp_pool);
+
+    ++p->status_gen;
+    p->dirty = PJ_TRUE;
+
+    /* Coalesce with the pending fan-out */
+    if (p->timer.id == TIMER_SCHEDULED) {
+	pj_lock_release(p->lock);
+	return PJ_SUCCESS;
+    }
+
+    /* Delay the fan-out until the end of the throttle window */
+    pj_gettickcount(&now);
+    if (p->setting.throttle_msec &&
+	(p->last_fanout.sec || p->last_fanout.msec))
+    {
+	pj_time_val delay = now;
+
+	PJ_TIME_VAL_SUB(delay, p->last_fanout);
+	if (PJ_TIME_VAL_MSEC(delay) < (long)p->setting.throttle_msec) {
+	    long msec = p->setting.throttle_msec - PJ_TIME_VAL_MSEC(delay);
+
+	    delay.sec = msec / 1000;
+	    delay.msec = msec % 1000;
+
+	    /* Schedule with the lock held, so that the destroy can see
+	     * whether the timer has been scheduled.
+	     */
+	    if (pjsip_endpt_schedule_timer(p->endpt, &p->timer,
+					   &delay) == PJ_SUCCESS)
+	    {
+		p->timer.id = TIMER_SCHEDULED;
+		pj_lock_release(p->lock);
+		return PJ_SUCCESS;
+	    }
+	}
+    }
+
+    pj_lock_release(p->lock);
+
+    presentity_fanout(p);
+
+    return PJ_SUCCESS;
+}
+
+
 /*
  * This callback is called by event subscription when subscription
  * state has changed.
@@ -617,6 +1471,13 @@ static void pres_on_evsub_state( pjsip_evsub *sub, pjsip_event *event)
     pres = (pjsip_pres*) pjsip_evsub_get_mod_data(sub, mod_presence.id);
     PJ_ASSERT_ON_FAIL(pres!=NULL, {return;});
 
+    /* Stop receiving status updates from presentity */
+    if (pres->presentity &&
+	pjsip_evsub_get_state(sub) == PJSIP_EVSUB_STATE_TERMINATED)
+    {
+	presentity_detach(pres);
+    }
+
     if (pres->user_cb.on_evsub_state)
 	(*pres->user_cb.on_evsub_state)(sub, event);
 
@@ -643,6 +1504,16 @@ static void pres_on_evsub_tsx_state( pjsip_evsub *sub, pjsip_transaction *tsx,
     pres = (pjsip_pres*) pjsip_evsub_get_mod_data(sub, mod_presence.id);
     PJ_ASSERT_ON_FAIL(pres!=NULL, {return;});
 
+    /* Track NOTIFY requests sent on behalf of presentity */
+    if (pres->watcher && tsx->role == PJSIP_ROLE_UAC &&
+	pjsip_method_cmp(&tsx->method, &pjsip_notify_method)==0 &&
+	(tsx->state == PJSIP_TSX_STATE_COMPLETED ||
+	 (tsx->state == PJSIP_TSX_STATE_TERMINATED &&
+	  event->body.tsx_state.prev_state != PJSIP_TSX_STATE_COMPLETED)))
+    {
+	presentity_on_notify_complete(pres);
+    }
+
     if (pres->user_cb.on_tsx_state)
 	(*pres->user_cb.on_tsx_state)(sub, tsx, event);
 }
@@ -939,3 +1810,164 @@ static void pres_on_evsub_server_timeout(pjsip_evsub *sub)
     }
 }
 
+
+
+/*
+ * Presence state saved in hibernated subscription. It is followed by the
+ * presence status as PIDF document and the state saved by application.
+ */
+typedef struct pres_hib_state
+{
+    content_type_e	 content_type;
+    pjsip_evsub_user	 user_cb;
+    unsigned		 status_len;
+} pres_hib_state;
+
+
+/*
+ * Called when subscription is being hibernated.
+ */
+static int pres_on_evsub_hibernate(pjsip_evsub *sub, char *buf,
+				   unsigned size)
+{
+    pjsip_pres *pres;
+    pres_hib_state st;
+    char *p = buf + sizeof(st), *end = buf + size;
+
+    pres = (pjsip_pres*) pjsip_evsub_get_mod_data(sub, mod_presence.id);
+    PJ_ASSERT_RETURN(pres!=NULL, -1);
+
+    /* Watchers of presentity are notified by the presentity */
+    if (pres->presentity || size < sizeof(st))
+	return -1;
+
+    st.content_type = pres->content_type;
+    pj_memcpy(&st.user_cb, &pres->user_cb, sizeof(pjsip_evsub_user));
+    st.status_len = 0;
+
+    if (pres->status.info_cnt) {
+	pj_pool_t *pool;
+	pjsip_msg_body *body;
+	pj_str_t entity;
+	int len = -1;
+
+	pool = pj_pool_create(pres->dlg->pool->factory, "preshib",
+			      512, 512, NULL);
+	entity.ptr = (char*) pj_pool_alloc(pool, PJSIP_MAX_URL_SIZE);
+	entity.slen = pjsip_uri_print(PJSIP_URI_IN_REQ_URI,
+				      pres->dlg->local.info->uri,
+				      entity.ptr, PJSIP_MAX_URL_SIZE);
+	if (entity.slen > 0 &&
+	    pjsip_pres_create_pidf(pool, &pres->status, &entity,
+				   &body) == PJ_SUCCESS)
+	{
+	    len = body->print_body(body, p, end - p);
+	}
+	pj_pool_release(pool);
+
+	if (len < 0)
+	    return -1;
+	st.status_len = len;
+	p += len;
+    }
+
+    if (pres->user_cb.on_hibernate) {
+	int len = (*pres->user_cb.on_hibernate)(sub, p, (unsigned)(end - p));
+	if (len < 0)
+	    return -1;
+	p += len;
+    }
+
+    pj_memcpy(buf, &st, sizeof(st));
+
+    return (int)(p - buf);
+}
+
+
+/*
+ * Called when the subscription has been hibernated, before it is
+ * destroyed.
+ */
+static void pres_on_evsub_hibernated(pjsip_evsub *sub)
+{
+    pjsip_pres *pres;
+
+    pres = (pjsip_pres*) pjsip_evsub_get_mod_data(sub, mod_presence.id);
+    PJ_ASSERT_ON_FAIL(pres!=NULL, {return;});
+
+    if (pres->user_cb.on_hibernated)
+	(*pres->user_cb.on_hibernated)(sub);
+
+    /* The presence instance lives in the dialog pool, and it is created
+     * again when the subscription is rehydrated.
+     */
+    if (pres->status_pool) {
+	pj_pool_release(pres->status_pool);
+	pres->status_pool = NULL;
+    }
+    if (pres->tmp_pool) {
+	pj_pool_release(pres->tmp_pool);
+	pres->tmp_pool = NULL;
+    }
+    pjsip_evsub_set_mod_data(sub, mod_presence.id, NULL);
+}
+
+
+/*
+ * Called when hibernated subscription has been rehydrated.
+ */
+static void pres_on_evsub_rehydrate(pjsip_evsub *sub, const char *buf,
+				    unsigned len)
+{
+    pjsip_dialog *dlg = pjsip_evsub_get_dlg(sub);
+    pjsip_pres *pres;
+    pres_hib_state st;
+    char obj_name[PJ_MAX_OBJ_NAME];
+    unsigned i;
+
+    PJ_ASSERT_ON_FAIL(len >= sizeof(st), return);
+    pj_memcpy(&st, buf, sizeof(st));
+    buf += sizeof(st);
+    len -= sizeof(st);
+
+    pres = PJ_POOL_ZALLOC_T(dlg->pool, pjsip_pres);
+    pres->dlg = dlg;
+    pres->sub = sub;
+    pres->content_type = st.content_type;
+    pj_memcpy(&pres->user_cb, &st.user_cb, sizeof(pjsip_evsub_user));
+
+    pj_ansi_snprintf(obj_name, PJ_MAX_OBJ_NAME, "pres%p", dlg->pool);
+    pres->status_pool = pj_pool_create(dlg->pool->factory, obj_name, 
+				       512, 512, NULL);
+    pj_ansi_snprintf(obj_name, PJ_MAX_OBJ_NAME, "tmpres%p", dlg->pool);
+    pres->tmp_pool = pj_pool_create(dlg->pool->factory, obj_name, 
+				    512, 512, NULL);
+
+    if (st.status_len && st.status_len <= len) {
+	char *body = (char*) pj_pool_alloc(pres->status_pool,
+					   st.status_len + 1);
+	pj_memcpy(body, buf, st.status_len);
+	body[st.status_len] = '\0';
+
+	if (pjsip_pres_parse_pidf2(body, st.status_len, pres->status_pool,
+				   &pres->status) == PJ_SUCCESS)
+	{
+	    /* Tuple ids must survive pool swap in pjsip_pres_set_status() */
+	    for (i=0; i<pres->status.info_cnt; ++i) {
+		pj_str_t id = pres->status.info[i].id;
+		pj_strdup(dlg->pool, &pres->status.info[i].id, &id);
+	    }
+	    pres->status._is_valid = PJ_TRUE;
+	} else {
+	    pj_bzero(&pres->status, sizeof(pres->status));
+	}
+
+	buf += st.status_len;
+	len -= st.status_len;
+    }
+
+    pjsip_evsub_set_mod_data(sub, mod_presence.id, pres);
+
+    if (pres->user_cb.on_rehydrate)
+	(*pres->user_cb.on_rehydrate)(sub, buf, len);
+}
@@ -131,6 +131,7 @@ static struct mod_inv
     pjsip_module	 mod;
     pjsip_endpoint	*endpt;
     pjsip_inv_callback	 cb;
+    pjsip_pool_slab	*slab;
 } mod_inv = 
 {
     {
@@ -733,6 +734,14 @@ PJ_DEF(pj_status_t) pjsip_inv_usage_init( pjsip_endpoint *endpt,
 
     mod_inv.endpt = endpt;
 
+    /* Get the slab for the flip-flop pools, two of which are held by
+     * each session.
+     */
+    status = pjsip_endpt_create_pool_slab(endpt, "inv", POOL_INIT_SIZE,
+					  POOL_INC_SIZE, 2, &mod_inv.slab);
+    if (status != PJ_SUCCESS)
+	return status;
+
     /* Register the module. */
     status = pjsip_endpt_register_module(endpt, &mod_inv.mod);
     if (status != PJ_SUCCESS)
@@ -810,10 +819,9 @@ PJ_DEF(pj_status_t) pjsip_inv_create_uac( pjsip_dialog *dlg,
     /* Create flip-flop pool (see ticket #877) */
     /* (using inv->obj_name as temporary variable for pool names */
     pj_ansi_snprintf(inv->obj_name, PJ_MAX_OBJ_NAME, "inv%p", dlg->pool);
-    inv->pool_prov = pjsip_endpt_create_pool(dlg->endpt, inv->obj_name,
-					     POOL_INIT_SIZE, POOL_INC_SIZE);
-    inv->pool_active = pjsip_endpt_create_pool(dlg->endpt, inv->obj_name,
-					       POOL_INIT_SIZE, POOL_INC_SIZE);
+    inv->pool_prov = pjsip_pool_slab_create_pool(mod_inv.slab, inv->obj_name);
+    inv->pool_active = pjsip_pool_slab_create_pool(mod_inv.slab,
+						   inv->obj_name);
 
     /* Object name will use the same dialog pointer. */
     pj_ansi_snprintf(inv->obj_name, PJ_MAX_OBJ_NAME, "inv%p", dlg);
@@ -1400,10 +1408,9 @@ PJ_DEF(pj_status_t) pjsip_inv_create_uas( pjsip_dialog *dlg,
     /* Create flip-flop pool (see ticket #877) */
     /* (using inv->obj_name as temporary variable for pool names */
     pj_ansi_snprintf(inv->obj_name, PJ_MAX_OBJ_NAME, "inv%p", dlg->pool);
-    inv->pool_prov = pjsip_endpt_create_pool(dlg->endpt, inv->obj_name,
-					     POOL_INIT_SIZE, POOL_INC_SIZE);
-    inv->pool_active = pjsip_endpt_create_pool(dlg->endpt, inv->obj_name,
-					       POOL_INIT_SIZE, POOL_INC_SIZE);
+    inv->pool_prov = pjsip_pool_slab_create_pool(mod_inv.slab, inv->obj_name);
+    inv->pool_active = pjsip_pool_slab_create_pool(mod_inv.slab,
+						   inv->obj_name);
 
     /* Object name will use the same dialog pointer. */
     pj_ansi_snprintf(inv->obj_name, PJ_MAX_OBJ_NAME, "inv%p", dlg);
@@ -50,6 +50,12 @@ enum { NOEXP = 0x1FFFFFFF };
 static const pj_str_t XUID_PARAM_NAME = { "x-uid", 5 };
 
 
+/* Maximum number of authentication challenges shared among client
+ * registrations, see PJSIP_REGISTER_CLIENT_SHARE_AUTH.
+ */
+#define MAX_SHARED_CHAL		16
+
+
 /* Current/pending operation */
 enum regc_op
 {
@@ -58,6 +64,13 @@ enum regc_op
     REGC_UNREGISTERING
 };
 
+/* Entry in the list of registrations waiting to send REGISTER request */
+struct regc_wait
+{
+    PJ_DECL_LIST_MEMBER(struct regc_wait);
+    pjsip_regc			*regc;
+};
+
 /**
  * SIP client registration structure.
  */
@@ -110,8 +123,339 @@ struct pjsip_regc
      * it open.
      */
     pjsip_transport		*last_transport;
+
+    /* Pending transaction limit, see PJSIP_REGISTER_CLIENT_MAX_PENDING. */
+    struct regc_sched		*sched;
+    pj_bool_t			 holds_slot;
+    pjsip_tx_data		*queued_tdata;
+    struct regc_wait		 wait_node;
+};
+
+
+/* Authentication challenge shared among client registrations. */
+struct shared_chal
+{
+    pj_pool_t			*pool;
+    pjsip_www_authenticate_hdr	*hdr;
+    pj_uint32_t			 last_update;
 };
 
+/* State shared by the client registrations of an endpoint, to limit the
+ * number of outstanding REGISTER transactions and to share authentication
+ * challenges.
+ */
+struct regc_sched
+{
+    PJ_DECL_LIST_MEMBER(struct regc_sched);
+    pjsip_endpoint		*endpt;
+    pj_pool_t			*pool;
+    pj_lock_t			*lock;
+    unsigned			 pending;
+    struct regc_wait		 wait_list;
+    pj_uint32_t			 chal_seq;
+    struct shared_chal		 chal[MAX_SHARED_CHAL];
+};
+
+/* List of the schedulers, one for each endpoint with client registration.
+ * Protected by pj_enter_critical_section().
+ */
+static struct regc_sched sched_list = { &sched_list, &sched_list };
+
+
+static struct regc_sched *sched_find(pjsip_endpoint *endpt)
+{
+    struct regc_sched *sched;
+
+    for (sched=sched_list.next; sched!=&sched_list; sched=sched->next) {
+	if (sched->endpt == endpt)
+	    return sched;
+    }
+    return NULL;
+}
+
+static void sched_deinit(pjsip_endpoint *endpt)
+{
+    struct regc_sched *sched;
+    unsigned i;
+
+    pj_enter_critical_section();
+    sched = sched_find(endpt);
+    if (sched)
+	pj_list_erase(sched);
+    pj_leave_critical_section();
+
+    if (!sched)
+	return;
+
+    for (i=0; i<MAX_SHARED_CHAL; ++i) {
+	if (sched->chal[i].pool)
+	    pjsip_endpt_release_pool(endpt, sched->chal[i].pool);
+    }
+    pj_lock_destroy(sched->lock);
+    pjsip_endpt_release_pool(endpt, sched->pool);
+}
+
+/* Get the scheduler of the endpoint, creating it if it doesn't exist. */
+static pj_status_t sched_init(pjsip_endpoint *endpt,
+			      struct regc_sched **p_sched)
+{
+    struct regc_sched *sched, *found;
+    pj_pool_t *pool;
+    pj_status_t status;
+
+    pj_enter_critical_section();
+    found = sched_find(endpt);
+    pj_leave_critical_section();
+
+    if (found) {
+	*p_sched = found;
+	return PJ_SUCCESS;
+    }
+
+    pool = pjsip_endpt_create_pool(endpt, "regcsched", 512, 512);
+    PJ_ASSERT_RETURN(pool != NULL, PJ_ENOMEM);
+
+    sched = PJ_POOL_ZALLOC_T(pool, struct regc_sched);
+    sched->endpt = endpt;
+    sched->pool = pool;
+    pj_list_init(&sched->wait_list);
+
+    status = pj_lock_create_simple_mutex(pool, "regcsched", &sched->lock);
+    if (status != PJ_SUCCESS) {
+	pjsip_endpt_release_pool(endpt, pool);
+	return status;
+    }
+
+    pj_enter_critical_section();
+    found = sched_find(endpt);
+    if (!found)
+	pj_list_push_back(&sched_list, sched);
+    pj_leave_critical_section();
+
+    if (found) {
+	/* Somebody else has created it */
+	pj_lock_destroy(sched->lock);
+	pjsip_endpt_release_pool(endpt, pool);
+	*p_sched = found;
+	return PJ_SUCCESS;
+    }
+
+    status = pjsip_endpt_atexit(endpt, &sched_deinit);
+    if (status != PJ_SUCCESS) {
+	sched_deinit(endpt);
+	return status;
+    }
+
+    *p_sched = sched;
+    return PJ_SUCCESS;
+}
+
+/* Take a pending transaction slot, or queue the request if the limit
+ * has been reached. Called with regc lock held.
+ */
+static pj_bool_t sched_acquire(pjsip_regc *regc, pjsip_tx_data *tdata)
+{
+    struct regc_sched *sched = regc->sched;
+    pj_bool_t acquired = PJ_TRUE;
+    unsigned max_pending = pjsip_cfg()->regc.max_pending;
+
+    pj_lock_acquire(sched->lock);
+    if (max_pending == 0 || sched->pending < max_pending) {
+	++sched->pending;
+    } else {
+	regc->queued_tdata = tdata;
+	regc->wait_node.regc = regc;
+	pj_list_push_back(&sched->wait_list, &regc->wait_node);
+	acquired = PJ_FALSE;
+    }
+    pj_lock_release(sched->lock);
+
+    return acquired;
+}
+
+static pj_status_t send_tdata(pjsip_regc *regc, pjsip_tx_data *tdata,
+			      pj_bool_t *release_slot);
+static void call_callback(pjsip_regc *regc, pj_status_t status, int st_code,
+			  const pj_str_t *reason, pjsip_rx_data *rdata,
+			  pj_int32_t expiration, int contact_cnt,
+			  pjsip_contact_hdr *contact[]);
+
+/* Send request which has been queued by sched_acquire(). The slot has
+ * been taken on behalf of the registration. Returns PJ_TRUE if the slot
+ * should be released.
+ */
+static pj_bool_t send_queued(pjsip_regc *regc)
+{
+    pjsip_tx_data *tdata;
+    pj_bool_t release_slot = PJ_FALSE;
+    pj_status_t status;
+
+    pj_lock_acquire(regc->lock);
+
+    tdata = regc->queued_tdata;
+    regc->queued_tdata = NULL;
+
+    if (regc->_delete_flag) {
+	/* Registration has been destroyed while waiting */
+	regc->has_tsx = PJ_FALSE;
+	regc->current_op = REGC_IDLE;
+	pjsip_tx_data_dec_ref(tdata);
+	pjsip_tx_data_dec_ref(tdata);
+	release_slot = PJ_TRUE;
+    } else {
+	regc->holds_slot = PJ_TRUE;
+	status = send_tdata(regc, tdata, &release_slot);
+
+	/* Report the error if the transaction was not even created, since
+	 * the application was told that the request had been sent.
+	 */
+	if (status != PJ_SUCCESS && regc->has_tsx) {
+	    char errmsg[PJ_ERR_MSG_SIZE];
+	    pj_str_t reason = pj_strerror(status, errmsg, sizeof(errmsg));
+
+	    regc->has_tsx = PJ_FALSE;
+	    regc->current_op = REGC_IDLE;
+	    if (regc->cb) {
+		pj_lock_release(regc->lock);
+		call_callback(regc, status, 400, &reason, NULL, -1, 0, NULL);
+		pj_lock_acquire(regc->lock);
+	    }
+	}
+    }
+
+    pj_lock_release(regc->lock);
+
+    /* Release the reference held while the request was queued */
+    if (pj_atomic_dec_and_get(regc->busy_ctr)==0 && regc->_delete_flag) {
+	pjsip_regc_destroy(regc);
+    }
+
+    return release_slot;
+}
+
+/* Release a pending transaction slot and send queued requests. Must not
+ * be called with any regc lock held.
+ */
+static void sched_release(struct regc_sched *sched)
+{
+    pj_bool_t release_slot = PJ_TRUE;
+
+    for (;;) {
+	unsigned max_pending = pjsip_cfg()->regc.max_pending;
+	pjsip_regc *next = NULL;
+
+	pj_lock_acquire(sched->lock);
+	if (release_slot && sched->pending)
+	    --sched->pending;
+	if (!pj_list_empty(&sched->wait_list) &&
+	    (max_pending == 0 || sched->pending < max_pending))
+	{
+	    struct regc_wait *node = sched->wait_list.next;
+	    pj_list_erase(node);
+	    next = node->regc;
+	    ++sched->pending;
+	}
+	pj_lock_release(sched->lock);
+
+	if (!next)
+	    break;
+
+	release_slot = send_queued(next);
+    }
+}
+
+/* Save the challenges in 401/407 response for other registrations. */
+static void sched_save_chal(struct regc_sched *sched, pjsip_rx_data *rdata)
+{
+    const pjsip_hdr *hdr;
+    const pjsip_hdr *end = &rdata->msg_info.msg->hdr;
+
+    pj_lock_acquire(sched->lock);
+
+    for (hdr=end->next; hdr!=end; hdr=hdr->next) {
+	const pjsip_www_authenticate_hdr *h;
+	struct shared_chal *chal = NULL;
+	unsigned i;
+
+	if (hdr->type != PJSIP_H_WWW_AUTHENTICATE &&
+	    hdr->type != PJSIP_H_PROXY_AUTHENTICATE)
+	{
+	    continue;
+	}
+	h = (const pjsip_www_authenticate_hdr*)hdr;
+
+	/* Find the entry for the realm, or reuse the oldest one */
+	for (i=0; i<MAX_SHARED_CHAL; ++i) {
+	    struct shared_chal *c = &sched->chal[i];
+
+	    if (c->hdr && c->hdr->type == h->type &&
+		pj_stricmp(&c->hdr->challenge.common.realm,
+			   &h->challenge.common.realm)==0)
+	    {
+		chal = c;
+		break;
+	    }
+	    if (!chal || !c->hdr ||
+		(chal->hdr && c->last_update < chal->last_update))
+	    {
+		chal = c;
+	    }
+	}
+
+	if (chal->pool) {
+	    pj_pool_reset(chal->pool);
+	} else {
+	    chal->pool = pjsip_endpt_create_pool(sched->endpt, "regcchal",
+						 512, 512);
+	    if (!chal->pool)
+		break;
+	}
+	chal->hdr = (pjsip_www_authenticate_hdr*)
+		    pjsip_hdr_clone(chal->pool, h);
+	chal->last_update = ++sched->chal_seq;
+    }
+
+    pj_lock_release(sched->lock);
+}
+
+/* Add authorization from challenges received by other registrations to
+ * realms for which we have credential.
+ */
+static void sched_apply_chal(pjsip_regc *regc, pjsip_tx_data *tdata)
+{
+    struct regc_sched *sched = regc->sched;
+    pjsip_www_authenticate_hdr *hchal[MAX_SHARED_CHAL];
+    unsigned i, j, cnt = 0;
+
+    if (regc->auth_sess.cred_cnt == 0)
+	return;
+
+    pj_lock_acquire(sched->lock);
+    for (i=0; i<MAX_SHARED_CHAL; ++i) {
+	const pjsip_www_authenticate_hdr *h = sched->chal[i].hdr;
+
+	if (!h)
+	    continue;
+
+	for (j=0; j<regc->auth_sess.cred_cnt; ++j) {
+	    const pj_str_t *realm = &regc->auth_sess.cred_info[j].realm;
+
+	    if (pj_stricmp(realm, &h->challenge.common.realm)==0 ||
+		pj_strcmp2(realm, "*")==0)
+	    {
+		hchal[cnt++] = (pjsip_www_authenticate_hdr*)
+			       pjsip_hdr_clone(tdata->pool, h);
+		break;
+	    }
+	}
+    }
+    pj_lock_release(sched->lock);
+
+    for (i=0; i<cnt; ++i)
+	pjsip_auth_clt_init_req_with_chal(&regc->auth_sess, tdata, hchal[i]);
+}
+
+
 
 PJ_DEF(pj_status_t) pjsip_regc_create( pjsip_endpoint *endpt, void *token,
 				       pjsip_regc_cb *cb,
@@ -119,11 +463,16 @@ PJ_DEF(pj_status_t) pjsip_regc_create( pjsip_endpoint *endpt, void *token,
 {
     pj_pool_t *pool;
     pjsip_regc *regc;
+    struct regc_sched *sched;
     pj_status_t status;
 
     /* Verify arguments. */
     PJ_ASSERT_RETURN(endpt && cb && p_regc, PJ_EINVAL);
 
+    status = sched_init(endpt, &sched);
+    if (status != PJ_SUCCESS)
+	return status;
+
     pool = pjsip_endpt_create_pool(endpt, "regc%p", 1024, 1024);
     PJ_ASSERT_RETURN(pool != NULL, PJ_ENOMEM);
 
@@ -131,6 +480,7 @@ PJ_DEF(pj_status_t) pjsip_regc_create( pjsip_endpoint *endpt, void *token,
 
     regc->pool = pool;
     regc->endpt = endpt;
+    regc->sched = sched;
     regc->token = token;
     regc->cb = cb;
     regc->expires = PJSIP_REGC_EXPIRATION_NOT_SPECIFIED;
@@ -499,6 +849,10 @@ static pj_status_t create_request(pjsip_regc *regc,
     /* Add cached authorization headers. */
     pjsip_auth_clt_init_req( &regc->auth_sess, tdata );
 
+    /* Authenticate with challenges received by other registrations */
+    if (pjsip_cfg()->regc.share_auth)
+	sched_apply_chal(regc, tdata);
+
     /* Add Route headers from route set, ideally after Via header */
     if (!pj_list_empty(&regc->route_set)) {
 	pjsip_hdr *route_pos;
@@ -812,13 +1166,36 @@ static void schedule_registration ( pjsip_regc *regc, pj_int32_t expiration )
         }
         if (delay.sec < DELAY_BEFORE_REFRESH) 
             delay.sec = DELAY_BEFORE_REFRESH;
+
+        /* Randomly bring the refresh forward, to spread refreshes of
+         * registrations made at the same time.
+         */
+        if (pjsip_cfg()->regc.refresh_jitter &&
+            delay.sec > DELAY_BEFORE_REFRESH)
+        {
+            unsigned pct = pjsip_cfg()->regc.refresh_jitter;
+            pj_uint32_t range, msec;
+
+            if (pct > 100)
+                pct = 100;
+
+            range = (pj_uint32_t)delay.sec * 10 * pct;
+            msec = (pj_uint32_t)delay.sec * 1000 -
+                   ((((pj_uint32_t)pj_rand() << 16) ^ pj_rand()) %
+                    (range + 1));
+            if (msec < DELAY_BEFORE_REFRESH * 1000)
+                msec = DELAY_BEFORE_REFRESH * 1000;
+            delay.sec = msec / 1000;
+            delay.msec = msec % 1000;
+        }
+
         regc->timer.cb = &regc_refresh_timer_cb;
         regc->timer.id = REFRESH_TIMER;
         regc->timer.user_data = regc;
         pjsip_endpt_schedule_timer( regc->endpt, &regc->timer, &delay);
         pj_gettimeofday(&regc->last_reg);
         regc->next_reg = regc->last_reg;
-        regc->next_reg.sec += delay.sec;
+        PJ_TIME_VAL_ADD(regc->next_reg, delay);
     }
 }
 
@@ -1054,6 +1431,7 @@ static void regc_tsx_callback(void *token, pjsip_event *event)
     pjsip_transaction *tsx = event->body.tsx_state.tsx;
     pj_bool_t handled = PJ_TRUE;
     pj_bool_t update_contact = PJ_FALSE;
+    pj_bool_t release_slot = PJ_FALSE;
 
     pj_atomic_inc(regc->busy_ctr);
     pj_lock_acquire(regc->lock);
@@ -1128,6 +1506,10 @@ static void regc_tsx_callback(void *token, pjsip_event *event)
 	/* reset current op */
 	regc->current_op = REGC_IDLE;
 
+	/* Let other registrations use the challenge */
+	if (pjsip_cfg()->regc.share_auth)
+	    sched_save_chal(regc->sched, rdata);
+
         if (update_contact) {
             pjsip_msg *msg;
             pjsip_hdr *hdr, *ins_hdr;
@@ -1334,8 +1716,19 @@ handle_err:
 	pj_lock_acquire(regc->lock);
     }
 
+    /* Release the pending transaction slot, unless it has been used to
+     * send another request (e.g. authentication retry).
+     */
+    if (regc->holds_slot && !regc->has_tsx) {
+	regc->holds_slot = PJ_FALSE;
+	release_slot = PJ_TRUE;
+    }
+
     pj_lock_release(regc->lock);
 
+    if (release_slot)
+	sched_release(regc->sched);
+
     /* Delete the record if user destroy regc during the callback. */
     if (pj_atomic_dec_and_get(regc->busy_ctr)==0 && regc->_delete_flag) {
 	pjsip_regc_destroy(regc);
@@ -1348,6 +1741,7 @@ PJ_DEF(pj_status_t) pjsip_regc_send(pjsip_regc *regc, pjsip_tx_data *tdata)
     pjsip_cseq_hdr *cseq_hdr;
     pjsip_expires_hdr *expires_hdr;
     pj_uint32_t cseq;
+    pj_bool_t release_slot = PJ_FALSE;
 
     pj_atomic_inc(regc->busy_ctr);
     pj_lock_acquire(regc->lock);
@@ -1399,6 +1793,42 @@ PJ_DEF(pj_status_t) pjsip_regc_send(pjsip_regc *regc, pjsip_tx_data *tdata)
         tdata->via_tp = regc->via_tp;
     }
 
+    /* Queue the request if there are too many pending transactions. The
+     * busy counter is kept incremented until the request is sent.
+     */
+    if (!regc->holds_slot) {
+	if (!sched_acquire(regc, tdata)) {
+	    PJ_LOG(5,(THIS_FILE, "Request queued, too many pending "
+				 "REGISTER transactions"));
+	    pj_lock_release(regc->lock);
+	    return PJ_SUCCESS;
+	}
+	regc->holds_slot = PJ_TRUE;
+    }
+
+    status = send_tdata(regc, tdata, &release_slot);
+
+    pj_lock_release(regc->lock);
+
+    if (release_slot)
+	sched_release(regc->sched);
+
+    /* Delete the record if user destroy regc during the callback. */
+    if (pj_atomic_dec_and_get(regc->busy_ctr)==0 && regc->_delete_flag) {
+	pjsip_regc_destroy(regc);
+    }
+
+    return status;
+}
+
+/* Send the request. Called with regc lock held, and returns with the
+ * lock held.
+ */
+static pj_status_t send_tdata(pjsip_regc *regc, pjsip_tx_data *tdata,
+			      pj_bool_t *release_slot)
+{
+    pj_status_t status;
+
     /* Need to unlock the regc temporarily while sending the message to
      * prevent deadlock (https://trac.pjsip.org/repos/ticket/1247).
      * It should be safe to do this since the regc's refcount has been
@@ -1431,17 +1861,14 @@ PJ_DEF(pj_status_t) pjsip_regc_send(pjsip_regc *regc, pjsip_tx_data *tdata)
 	}
     }
 
+    /* Release the slot if the transaction callback hasn't done so */
+    if (status != PJ_SUCCESS && regc->holds_slot) {
+	regc->holds_slot = PJ_FALSE;
+	*release_slot = PJ_TRUE;
+    }
+
     /* Release tdata */
     pjsip_tx_data_dec_ref(tdata);
 
-    pj_lock_release(regc->lock);
-
-    /* Delete the record if user destroy regc during the callback. */
-    if (pj_atomic_dec_and_get(regc->busy_ctr)==0 && regc->_delete_flag) {
-	pjsip_regc_destroy(regc);
-    }
-
     return status;
 }
-
-
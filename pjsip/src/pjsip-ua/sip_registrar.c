@@ -0,0 +1,1466 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pjsip-ua/sip_registrar.h>
+#include <pjsip/sip_endpoint.h>
+#include <pjsip/sip_errno.h>
+#include <pjsip/sip_module.h>
+#include <pjsip/sip_parser.h>
+#include <pjsip/sip_transaction.h>
+#include <pjsip/sip_util.h>
+#include <pj/assert.h>
+#include <pj/ctype.h>
+#include <pj/file_access.h>
+#include <pj/file_io.h>
+#include <pj/hash.h>
+#include <pj/list.h>
+#include <pj/lock.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+
+#define THIS_FILE	"sip_registrar.c"
+
+/* Maximum length of strings kept in the binding store */
+#define MAX_AOR_LEN	128
+#define MAX_CONTACT_LEN	256
+#define MAX_CALLID_LEN	128
+
+/* Maximum length of a snapshot record */
+#define MAX_LINE_LEN	(MAX_AOR_LEN + MAX_CONTACT_LEN + MAX_CALLID_LEN + 64)
+
+
+/* A contact binding */
+typedef struct binding
+{
+    PJ_DECL_LIST_MEMBER(struct binding);
+    char		contact[MAX_CONTACT_LEN];
+    unsigned		contact_len;
+    char		call_id[MAX_CALLID_LEN];
+    unsigned		call_id_len;
+    pj_int32_t		cseq;
+    int			q1000;
+    pj_uint32_t		expire;	    /* Absolute time, in seconds	*/
+} binding;
+
+struct shard;
+
+/* An address of record */
+typedef struct aor_entry
+{
+    PJ_DECL_LIST_MEMBER(struct aor_entry);
+    struct shard       *shard;
+    pj_hash_entry_buf	hbuf;
+    pj_uint32_t		hval;
+    char		aor[MAX_AOR_LEN];
+    unsigned		aor_len;
+    binding		bindings;
+    unsigned		count;
+    pj_timer_entry	timer;
+    pj_uint32_t		timer_expire;
+} aor_entry;
+
+/* A shard of the binding store */
+typedef struct shard
+{
+    pjsip_registrar    *reg;
+    pj_pool_t	       *pool;
+    pj_lock_t	       *lock;
+    pj_hash_table_t    *table;
+    aor_entry		free_aor;
+    binding		free_binding;
+    unsigned		aor_cnt;
+    unsigned		binding_cnt;
+    pj_bool_t		shutting_down;
+    unsigned		cb_pending;	/* Timer callbacks to wait for	*/
+} shard;
+
+/* Contact in the REGISTER request */
+typedef struct req_contact
+{
+    pjsip_contact_hdr  *hdr;
+    const pjsip_uri    *b_uri;
+    pj_str_t		uri;
+    unsigned		expires;
+} req_contact;
+
+struct pjsip_registrar
+{
+    pjsip_endpoint	    *endpt;
+    pj_pool_t		    *pool;
+    pjsip_registrar_setting  setting;
+    pjsip_registrar_cb	     cb;
+    shard		    *shards;
+    pj_bool_t		     shutting_down;
+
+    /* Snapshot */
+    char		    *snapshot_file;
+    pj_lock_t		    *log_lock;
+    pj_oshandle_t	     log;
+};
+
+
+static pj_bool_t mod_registrar_on_rx_request(pjsip_rx_data *rdata);
+
+/* The registrar module */
+static struct mod_registrar
+{
+    pjsip_module	 mod;
+    pjsip_registrar	*reg;
+} mod_registrar =
+{
+    {
+	NULL, NULL,			    /* prev, next.		*/
+	{ "mod-registrar", 13 },	    /* Name.			*/
+	-1,				    /* Id			*/
+	PJSIP_MOD_PRIORITY_APPLICATION,	    /* Priority			*/
+	NULL,				    /* load()			*/
+	NULL,				    /* start()			*/
+	NULL,				    /* stop()			*/
+	NULL,				    /* unload()			*/
+	&mod_registrar_on_rx_request,	    /* on_rx_request()		*/
+	NULL,				    /* on_rx_response()		*/
+	NULL,				    /* on_tx_request.		*/
+	NULL,				    /* on_tx_response()		*/
+	NULL,				    /* on_tsx_state()		*/
+    },
+    NULL
+};
+
+static const pj_str_t STR_CONTACT = { "Contact", 7 };
+static const pj_str_t STR_MIN_EXPIRES = { "Min-Expires", 11 };
+
+
+static void aor_timer_cb(pj_timer_heap_t *timer_heap,
+			 struct pj_timer_entry *entry);
+
+
+/*
+ * Initialize registrar setting with default values.
+ */
+PJ_DEF(void) pjsip_registrar_setting_default(pjsip_registrar_setting *setting)
+{
+    pj_bzero(setting, sizeof(*setting));
+    setting->shard_count = PJSIP_REGISTRAR_SHARD_COUNT;
+    setting->max_contacts = PJSIP_REGISTRAR_MAX_CONTACTS;
+    setting->min_expires = PJSIP_REGISTRAR_MIN_EXPIRES;
+    setting->max_expires = PJSIP_REGISTRAR_MAX_EXPIRES;
+    setting->default_expires = PJSIP_REGISTRAR_MAX_EXPIRES;
+    setting->priority = PJSIP_MOD_PRIORITY_APPLICATION;
+}
+
+
+/* Get the current time in seconds */
+static pj_uint32_t now_sec(void)
+{
+    pj_time_val now;
+
+    pj_gettimeofday(&now);
+    return (pj_uint32_t)now.sec;
+}
+
+
+/* Get the shard of an address of record */
+static shard *get_shard(pjsip_registrar *reg, const pj_str_t *aor,
+			pj_uint32_t *hval)
+{
+    *hval = pj_hash_calc(0, aor->ptr, (unsigned)aor->slen);
+    return &reg->shards[*hval % reg->setting.shard_count];
+}
+
+
+/* Find address of record. Must be called with the shard lock held. */
+static aor_entry *find_aor(shard *sh, const pj_str_t *aor, pj_uint32_t hval)
+{
+    return (aor_entry*) pj_hash_get(sh->table, aor->ptr,
+				    (unsigned)aor->slen, &hval);
+}
+
+
+/* Add address of record. Must be called with the shard lock held. */
+static aor_entry *add_aor(shard *sh, const pj_str_t *aor, pj_uint32_t hval)
+{
+    aor_entry *e;
+
+    if (!pj_list_empty(&sh->free_aor)) {
+	e = sh->free_aor.next;
+	pj_list_erase(e);
+    } else {
+	e = PJ_POOL_ZALLOC_T(sh->pool, aor_entry);
+	e->shard = sh;
+	pj_list_init(&e->bindings);
+	pj_timer_entry_init(&e->timer, 0, e, &aor_timer_cb);
+    }
+
+    pj_memcpy(e->aor, aor->ptr, aor->slen);
+    e->aor_len = (unsigned)aor->slen;
+    e->hval = hval;
+    e->count = 0;
+    e->timer_expire = 0;
+
+    pj_hash_set_np(sh->table, e->aor, e->aor_len, hval, e->hbuf, e);
+    ++sh->aor_cnt;
+
+    return e;
+}
+
+
+/* Release address of record which has no more bindings. Must be called
+ * with the shard lock held.
+ */
+static void free_aor(shard *sh, aor_entry *e)
+{
+    pj_assert(e->count == 0);
+
+    /* If the timer has already fired, its callback clears the id */
+    if (e->timer.id &&
+	pj_timer_heap_cancel(pjsip_endpt_get_timer_heap(sh->reg->endpt),
+			     &e->timer) == 1)
+    {
+	e->timer.id = 0;
+    }
+
+    pj_hash_set_np(sh->table, e->aor, e->aor_len, e->hval, NULL, NULL);
+    pj_list_push_back(&sh->free_aor, e);
+    --sh->aor_cnt;
+}
+
+
+/* Find binding of the contact. The printed contact is looked up first,
+ * then when the parsed URI is given, the bindings are compared with it
+ * using the URI comparison rules of RFC 3261 Section 19.1.4.
+ */
+static binding *find_binding(aor_entry *e, const pj_str_t *contact,
+			     const pjsip_uri *uri, pj_pool_t *pool)
+{
+    binding *b;
+
+    for (b=e->bindings.next; b!=&e->bindings; b=b->next) {
+	if (b->contact_len == (unsigned)contact->slen &&
+	    pj_memcmp(b->contact, contact->ptr, contact->slen) == 0)
+	{
+	    return b;
+	}
+    }
+
+    if (!uri)
+	return NULL;
+
+    for (b=e->bindings.next; b!=&e->bindings; b=b->next) {
+	pjsip_uri *b_uri;
+	char *buf;
+
+	/* The parser needs NULL terminated input */
+	buf = (char*) pj_pool_alloc(pool, b->contact_len + 1);
+	pj_memcpy(buf, b->contact, b->contact_len);
+	buf[b->contact_len] = '\0';
+
+	b_uri = pjsip_parse_uri(pool, buf, b->contact_len, 0);
+	if (b_uri &&
+	    pjsip_uri_cmp(PJSIP_URI_IN_CONTACT_HDR, pjsip_uri_get_uri(b_uri),
+			  uri) == PJ_SUCCESS)
+	{
+	    return b;
+	}
+    }
+
+    return NULL;
+}
+
+
+/* Find binding of a contact in the request */
+static binding *find_req_binding(aor_entry *e, const req_contact *rc,
+				 pj_pool_t *pool)
+{
+    return e ? find_binding(e, &rc->uri, rc->b_uri, pool) : NULL;
+}
+
+
+/* Fill in public binding info */
+static void get_binding_info(const aor_entry *e, const binding *b,
+			     pj_uint32_t now, pjsip_registrar_binding *info)
+{
+    info->aor.ptr = (char*)e->aor;
+    info->aor.slen = e->aor_len;
+    info->contact.ptr = (char*)b->contact;
+    info->contact.slen = b->contact_len;
+    info->call_id.ptr = (char*)b->call_id;
+    info->call_id.slen = b->call_id_len;
+    info->cseq = b->cseq;
+    info->q1000 = b->q1000;
+    info->expires = (b->expire > now) ? b->expire - now : 0;
+}
+
+
+/* Append a binding record to the snapshot file. Must be called with the
+ * shard lock held.
+ */
+static void log_binding(pjsip_registrar *reg, const aor_entry *e,
+			const binding *b, pj_bool_t removed)
+{
+    char line[MAX_LINE_LEN];
+    pj_ssize_t len;
+
+    if (!reg->log)
+	return;
+
+    if (removed) {
+	len = pj_ansi_snprintf(line, sizeof(line), "-\t%.*s\t%.*s\n",
+			       (int)e->aor_len, e->aor,
+			       (int)b->contact_len, b->contact);
+    } else {
+	len = pj_ansi_snprintf(line, sizeof(line),
+			       "+\t%.*s\t%.*s\t%.*s\t%d\t%u\t%d\n",
+			       (int)e->aor_len, e->aor,
+			       (int)b->contact_len, b->contact,
+			       (int)b->call_id_len, b->call_id,
+			       b->cseq, b->expire, b->q1000);
+    }
+
+    if (len < 0 || len >= (pj_ssize_t)sizeof(line))
+	return;
+
+    pj_lock_acquire(reg->log_lock);
+    if (reg->log)
+	pj_file_write(reg->log, line, &len);
+    pj_lock_release(reg->log_lock);
+}
+
+
+/* Add or update binding. Must be called with the shard lock held. */
+static binding *set_binding(pjsip_registrar *reg, aor_entry *e,
+			    binding *b, const pj_str_t *contact,
+			    const pj_str_t *call_id, pj_int32_t cseq,
+			    int q1000, pj_uint32_t expire,
+			    pj_bool_t log)
+{
+    shard *sh = e->shard;
+    pj_bool_t added = PJ_FALSE;
+
+    if (!b) {
+	if (!pj_list_empty(&sh->free_binding)) {
+	    b = sh->free_binding.next;
+	    pj_list_erase(b);
+	} else {
+	    b = PJ_POOL_ALLOC_T(sh->pool, binding);
+	}
+	pj_memcpy(b->contact, contact->ptr, contact->slen);
+	b->contact_len = (unsigned)contact->slen;
+	b->call_id_len = 0;
+	pj_list_push_back(&e->bindings, b);
+	++e->count;
+	++sh->binding_cnt;
+	added = PJ_TRUE;
+    }
+
+    if (b->call_id_len != (unsigned)call_id->slen ||
+	pj_memcmp(b->call_id, call_id->ptr, call_id->slen) != 0)
+    {
+	pj_memcpy(b->call_id, call_id->ptr, call_id->slen);
+	b->call_id_len = (unsigned)call_id->slen;
+    }
+    b->cseq = cseq;
+    b->q1000 = q1000;
+    b->expire = expire;
+
+    if (log)
+	log_binding(reg, e, b, PJ_FALSE);
+
+    if (added && reg->cb.on_binding_changed) {
+	pjsip_registrar_binding info;
+
+	get_binding_info(e, b, now_sec(), &info);
+	(*reg->cb.on_binding_changed)(reg, &info, PJ_FALSE);
+    }
+
+    return b;
+}
+
+
+/* Remove binding. Must be called with the shard lock held. */
+static void remove_binding(pjsip_registrar *reg, aor_entry *e, binding *b,
+			   pj_bool_t log)
+{
+    shard *sh = e->shard;
+
+    if (log)
+	log_binding(reg, e, b, PJ_TRUE);
+
+    if (reg->cb.on_binding_changed) {
+	pjsip_registrar_binding info;
+
+	get_binding_info(e, b, now_sec(), &info);
+	(*reg->cb.on_binding_changed)(reg, &info, PJ_TRUE);
+    }
+
+    pj_list_erase(b);
+    pj_list_push_back(&sh->free_binding, b);
+    --e->count;
+    --sh->binding_cnt;
+}
+
+
+/* Schedule the expiration timer of the address of record. Must be called
+ * with the shard lock held.
+ */
+static void schedule_expiry(pjsip_registrar *reg, aor_entry *e,
+			    pj_uint32_t now)
+{
+    pj_uint32_t earliest = 0xFFFFFFFF;
+    pj_time_val delay;
+    binding *b;
+
+    for (b=e->bindings.next; b!=&e->bindings; b=b->next) {
+	if (b->expire < earliest)
+	    earliest = b->expire;
+    }
+
+    /* Refreshes only extend the bindings, so an earlier timer can be left
+     * running. It will reschedule itself when it fires. The same goes for
+     * a timer which has fired and is waiting for the lock.
+     */
+    if (e->timer.id) {
+	if (e->timer_expire <= earliest ||
+	    pj_timer_heap_cancel(pjsip_endpt_get_timer_heap(reg->endpt),
+				 &e->timer) == 0)
+	{
+	    return;
+	}
+	e->timer.id = 0;
+    }
+
+    delay.sec = (earliest > now) ? earliest - now : 0;
+    delay.msec = 0;
+    e->timer_expire = earliest;
+    e->timer.id = 1;
+    if (pjsip_endpt_schedule_timer(reg->endpt, &e->timer, &delay) != 0)
+	e->timer.id = 0;
+}
+
+
+/* Remove expired bindings. Must be called with the shard lock held.
+ * Return PJ_TRUE if the address of record has been released.
+ */
+static pj_bool_t purge_expired(pjsip_registrar *reg, aor_entry *e,
+			       pj_uint32_t now)
+{
+    binding *b = e->bindings.next;
+
+    while (b != &e->bindings) {
+	binding *next = b->next;
+
+	if (b->expire <= now)
+	    remove_binding(reg, e, b, PJ_TRUE);
+	b = next;
+    }
+
+    if (e->count == 0) {
+	free_aor(e->shard, e);
+	return PJ_TRUE;
+    }
+
+    return PJ_FALSE;
+}
+
+
+/* Timer callback to remove expired bindings */
+static void aor_timer_cb(pj_timer_heap_t *timer_heap,
+			 struct pj_timer_entry *entry)
+{
+    aor_entry *e = (aor_entry*) entry->user_data;
+    shard *sh = e->shard;
+    pjsip_registrar *reg = sh->reg;
+    pj_uint32_t now;
+
+    PJ_UNUSED_ARG(timer_heap);
+
+    pj_lock_acquire(sh->lock);
+    entry->id = 0;
+
+    /* Registrar destroy is waiting for us */
+    if (sh->shutting_down) {
+	--sh->cb_pending;
+	pj_lock_release(sh->lock);
+	return;
+    }
+
+    /* The entry may have been released while we were waiting for the
+     * lock.
+     */
+    if (e->count == 0) {
+	pj_lock_release(sh->lock);
+	return;
+    }
+
+    now = now_sec();
+    if (!purge_expired(reg, e, now))
+	schedule_expiry(reg, e, now);
+
+    pj_lock_release(sh->lock);
+}
+
+
+/* Build the address of record from the To URI */
+static pj_status_t get_aor(const pjsip_uri *to_uri, char *buf,
+			   pj_size_t size, pj_str_t *aor)
+{
+    const pjsip_sip_uri *sip_uri;
+    char *p = buf, *end = buf + size;
+    int len;
+
+    if (!PJSIP_URI_SCHEME_IS_SIP(to_uri) && !PJSIP_URI_SCHEME_IS_SIPS(to_uri))
+	return PJSIP_EINVALIDSCHEME;
+
+    sip_uri = (const pjsip_sip_uri*) pjsip_uri_get_uri(to_uri);
+
+    len = pj_ansi_snprintf(p, size, "%s:%.*s%s",
+			   PJSIP_URI_SCHEME_IS_SIPS(to_uri) ? "sips" : "sip",
+			   (int)sip_uri->user.slen, sip_uri->user.ptr,
+			   sip_uri->user.slen ? "@" : "");
+    if (len < 0 || len >= end - p)
+	return PJSIP_EURITOOLONG;
+    p += len;
+
+    if (sip_uri->host.slen >= end - p)
+	return PJSIP_EURITOOLONG;
+    for (len=0; len<sip_uri->host.slen; ++len)
+	*p++ = (char)pj_tolower(sip_uri->host.ptr[len]);
+
+    if (sip_uri->port) {
+	len = pj_ansi_snprintf(p, end - p, ":%d", sip_uri->port);
+	if (len < 0 || len >= end - p)
+	    return PJSIP_EURITOOLONG;
+	p += len;
+    }
+
+    aor->ptr = buf;
+    aor->slen = p - buf;
+    return PJ_SUCCESS;
+}
+
+
+/* Add Contact headers of the current bindings to the response. Must be
+ * called with the shard lock held.
+ */
+static void add_contact_hdrs(aor_entry *e, pj_uint32_t now,
+			     pjsip_tx_data *tdata)
+{
+    binding *b;
+
+    if (!e)
+	return;
+
+    for (b=e->bindings.next; b!=&e->bindings; b=b->next) {
+	pjsip_generic_string_hdr *h;
+	pj_str_t value;
+	int size = b->contact_len + 48;
+	int len, q_len;
+
+	value.ptr = (char*) pj_pool_alloc(tdata->pool, size);
+	len = pj_ansi_snprintf(value.ptr, size, "<%.*s>;expires=%u",
+			       (int)b->contact_len, b->contact,
+			       (b->expire > now) ? b->expire - now : 0);
+	if (len < 0 || len >= size) {
+	    PJ_LOG(2,(THIS_FILE, "Contact of %.*s is too long",
+		      (int)e->aor_len, e->aor));
+	    continue;
+	}
+
+	if (b->q1000) {
+	    q_len = pj_ansi_snprintf(value.ptr + len, size - len,
+				     ";q=%d.%03d", b->q1000 / 1000,
+				     b->q1000 % 1000);
+	    if (q_len > 0 && q_len < size - len)
+		len += q_len;
+	}
+	value.slen = len;
+
+	h = pjsip_generic_string_hdr_create(tdata->pool, &STR_CONTACT, &value);
+	pjsip_msg_add_hdr(tdata->msg, (pjsip_hdr*)h);
+    }
+}
+
+
+/* Send the response, statelessly or statefully */
+static void send_response(pjsip_registrar *reg, pjsip_rx_data *rdata,
+			  pjsip_tx_data *tdata, pj_bool_t stateful)
+{
+    pj_status_t status;
+
+    if (stateful) {
+	pjsip_transaction *tsx;
+
+	status = pjsip_tsx_create_uas(NULL, rdata, &tsx);
+	if (status != PJ_SUCCESS) {
+	    pjsip_tx_data_dec_ref(tdata);
+	    return;
+	}
+	pjsip_tsx_recv_msg(tsx, rdata);
+	status = pjsip_tsx_send_msg(tsx, tdata);
+    } else {
+	status = pjsip_endpt_send_response2(reg->endpt, rdata, tdata,
+					    NULL, NULL);
+    }
+
+    if (status != PJ_SUCCESS) {
+	PJ_PERROR(4,(THIS_FILE, status, "Error sending REGISTER response"));
+    }
+}
+
+
+/* Send error response */
+static void respond_error(pjsip_registrar *reg, pjsip_rx_data *rdata,
+			  int code, pjsip_tx_data *tdata)
+{
+    if (tdata) {
+	tdata->msg->line.status.code = code;
+	tdata->msg->line.status.reason = *pjsip_get_status_text(code);
+	send_response(reg, rdata, tdata, PJ_FALSE);
+    } else {
+	pjsip_endpt_respond_stateless(reg->endpt, rdata, code, NULL,
+				      NULL, NULL);
+    }
+}
+
+
+/* Process incoming REGISTER request */
+static void handle_register(pjsip_registrar *reg, pjsip_rx_data *rdata)
+{
+    pjsip_msg *msg = rdata->msg_info.msg;
+    req_contact contacts[PJSIP_REGISTRAR_MAX_CONTACTS];
+    unsigned i, count = 0;
+    pjsip_contact_hdr *h_contact;
+    pjsip_expires_hdr *h_expires;
+    pj_bool_t wildcard = PJ_FALSE;
+    char aor_buf[MAX_AOR_LEN];
+    pj_str_t aor;
+    pj_str_t *call_id = &rdata->msg_info.cid->id;
+    pj_pool_t *pool = rdata->tp_info.pool;
+    pj_int32_t cseq = rdata->msg_info.cseq->cseq;
+    pjsip_tx_data *tdata;
+    pj_uint32_t hval, now;
+    shard *sh;
+    aor_entry *e;
+    pj_bool_t refresh, stateful = PJ_TRUE;
+    int code = PJSIP_SC_OK;
+    pj_status_t status;
+
+    /* Authenticate the request */
+    if (reg->setting.auth_srv) {
+	status = pjsip_auth_srv_verify(reg->setting.auth_srv, rdata, &code);
+	if (status != PJ_SUCCESS) {
+	    status = pjsip_endpt_create_response(reg->endpt, rdata, code,
+						 NULL, &tdata);
+	    if (status != PJ_SUCCESS)
+		return;
+
+	    if (code == PJSIP_SC_UNAUTHORIZED ||
+		code == PJSIP_SC_PROXY_AUTHENTICATION_REQUIRED)
+	    {
+		pjsip_auth_srv_challenge(reg->setting.auth_srv, NULL, NULL,
+					 NULL,
+					 (status == PJSIP_EAUTHSTALENONCE),
+					 tdata);
+	    }
+	    send_response(reg, rdata, tdata, PJ_FALSE);
+	    return;
+	}
+    }
+
+    /* Get the address of record */
+    status = get_aor(rdata->msg_info.to->uri, aor_buf, sizeof(aor_buf),
+		     &aor);
+    if (status != PJ_SUCCESS) {
+	respond_error(reg, rdata, (status == PJSIP_EINVALIDSCHEME ?
+				   PJSIP_SC_NOT_FOUND :
+				   PJSIP_SC_BAD_REQUEST), NULL);
+	return;
+    }
+
+    if (call_id->slen > MAX_CALLID_LEN) {
+	respond_error(reg, rdata, PJSIP_SC_BAD_REQUEST, NULL);
+	return;
+    }
+
+    /* Get the contacts */
+    h_expires = (pjsip_expires_hdr*)
+		pjsip_msg_find_hdr(msg, PJSIP_H_EXPIRES, NULL);
+    h_contact = (pjsip_contact_hdr*)
+		pjsip_msg_find_hdr(msg, PJSIP_H_CONTACT, NULL);
+    while (h_contact) {
+	req_contact *rc;
+	pj_int32_t expires;
+	int len;
+
+	if (h_contact->star) {
+	    wildcard = PJ_TRUE;
+	} else if (count >= reg->setting.max_contacts ||
+		   count >= PJ_ARRAY_SIZE(contacts))
+	{
+	    respond_error(reg, rdata, PJSIP_SC_FORBIDDEN, NULL);
+	    return;
+	} else {
+	    rc = &contacts[count++];
+	    rc->hdr = h_contact;
+
+	    if (h_contact->expires >= 0)
+		expires = h_contact->expires;
+	    else if (h_expires)
+		expires = h_expires->ivalue;
+	    else
+		expires = reg->setting.default_expires;
+
+	    if (expires > 0 && (unsigned)expires < reg->setting.min_expires) {
+		pjsip_generic_string_hdr *h;
+		pjsip_hdr hdr_list;
+		char buf[16];
+		pj_str_t value;
+
+		pj_list_init(&hdr_list);
+		value.ptr = buf;
+		value.slen = pj_ansi_snprintf(buf, sizeof(buf), "%u",
+					      reg->setting.min_expires);
+		h = pjsip_generic_string_hdr_create(pool,
+						    &STR_MIN_EXPIRES, &value);
+		pj_list_push_back(&hdr_list, h);
+		pjsip_endpt_respond_stateless(reg->endpt, rdata,
+					      PJSIP_SC_INTERVAL_TOO_BRIEF,
+					      NULL, &hdr_list, NULL);
+		return;
+	    }
+	    if ((unsigned)expires > reg->setting.max_expires)
+		expires = reg->setting.max_expires;
+	    rc->expires = expires;
+
+	    rc->b_uri = (const pjsip_uri*) pjsip_uri_get_uri(h_contact->uri);
+	    rc->uri.ptr = (char*) pj_pool_alloc(pool, MAX_CONTACT_LEN);
+	    len = pjsip_uri_print(PJSIP_URI_IN_CONTACT_HDR, rc->b_uri,
+				  rc->uri.ptr, MAX_CONTACT_LEN);
+	    if (len < 1) {
+		respond_error(reg, rdata, PJSIP_SC_BAD_REQUEST, NULL);
+		return;
+	    }
+	    rc->uri.slen = len;
+	}
+
+	h_contact = h_contact->next;
+	if (h_contact == (void*)&msg->hdr)
+	    break;
+	h_contact = (pjsip_contact_hdr*)
+		    pjsip_msg_find_hdr(msg, PJSIP_H_CONTACT, h_contact);
+    }
+
+    /* Wildcard must be the only contact, with zero expiration */
+    if (wildcard && (count || !h_expires || h_expires->ivalue != 0)) {
+	respond_error(reg, rdata, PJSIP_SC_BAD_REQUEST, NULL);
+	return;
+    }
+
+    status = pjsip_endpt_create_response(reg->endpt, rdata, PJSIP_SC_OK,
+					 NULL, &tdata);
+    if (status != PJ_SUCCESS)
+	return;
+
+    now = now_sec();
+    sh = get_shard(reg, &aor, &hval);
+
+    pj_lock_acquire(sh->lock);
+
+    e = find_aor(sh, &aor, hval);
+
+    /* Check if this is a refresh that doesn't change the bindings. These
+     * may be retransmitted when processed statelessly, so same CSeq is
+     * accepted too.
+     */
+    refresh = (e && !wildcard && count);
+    for (i=0; i<count && refresh; ++i) {
+	binding *b = find_req_binding(e, &contacts[i], pool);
+
+	if (!b || contacts[i].expires == 0 ||
+	    b->call_id_len != (unsigned)call_id->slen ||
+	    pj_memcmp(b->call_id, call_id->ptr, call_id->slen) != 0 ||
+	    cseq < b->cseq)
+	{
+	    refresh = PJ_FALSE;
+	}
+    }
+
+    if (refresh && reg->setting.stateless_refresh) {
+	stateful = PJ_FALSE;
+	for (i=0; i<count; ++i) {
+	    binding *b = find_req_binding(e, &contacts[i], pool);
+
+	    if (cseq == b->cseq)
+		continue;
+
+	    set_binding(reg, e, b, &contacts[i].uri, call_id, cseq,
+			contacts[i].hdr->q1000, now + contacts[i].expires,
+			PJ_TRUE);
+	}
+
+    } else if (wildcard) {
+	binding *b;
+
+	for (b=e?e->bindings.next:NULL; e && b!=&e->bindings; b=b->next) {
+	    if (b->call_id_len == (unsigned)call_id->slen &&
+		pj_memcmp(b->call_id, call_id->ptr, call_id->slen) == 0 &&
+		cseq <= b->cseq)
+	    {
+		code = PJSIP_SC_INTERNAL_SERVER_ERROR;
+		goto on_return;
+	    }
+	}
+
+	while (e && e->count)
+	    remove_binding(reg, e, e->bindings.next, PJ_TRUE);
+
+    } else {
+	unsigned new_count = e ? e->count : 0;
+
+	/* Check the requests against existing bindings */
+	for (i=0; i<count; ++i) {
+	    binding *b = find_req_binding(e, &contacts[i], pool);
+
+	    if (!b) {
+		if (contacts[i].expires)
+		    ++new_count;
+	    } else if (b->call_id_len == (unsigned)call_id->slen &&
+		       pj_memcmp(b->call_id, call_id->ptr,
+				 call_id->slen) == 0 &&
+		       cseq <= b->cseq)
+	    {
+		code = PJSIP_SC_INTERNAL_SERVER_ERROR;
+		goto on_return;
+	    } else if (contacts[i].expires == 0) {
+		--new_count;
+	    }
+	}
+
+	if (new_count > reg->setting.max_contacts) {
+	    code = PJSIP_SC_FORBIDDEN;
+	    goto on_return;
+	}
+
+	/* Update the bindings */
+	for (i=0; i<count; ++i) {
+	    binding *b = find_req_binding(e, &contacts[i], pool);
+
+	    if (contacts[i].expires == 0) {
+		if (b)
+		    remove_binding(reg, e, b, PJ_TRUE);
+		continue;
+	    }
+
+	    if (!e)
+		e = add_aor(sh, &aor, hval);
+
+	    set_binding(reg, e, b, &contacts[i].uri, call_id, cseq,
+			contacts[i].hdr->q1000, now + contacts[i].expires,
+			PJ_TRUE);
+	}
+    }
+
+    /* Return the current bindings */
+    add_contact_hdrs(e, now, tdata);
+
+    if (e) {
+	if (e->count == 0)
+	    free_aor(sh, e);
+	else
+	    schedule_expiry(reg, e, now);
+    }
+
+on_return:
+    pj_lock_release(sh->lock);
+
+    if (code != PJSIP_SC_OK) {
+	respond_error(reg, rdata, code, tdata);
+	return;
+    }
+
+    send_response(reg, rdata, tdata, stateful);
+}
+
+
+/* Callback to receive incoming requests */
+static pj_bool_t mod_registrar_on_rx_request(pjsip_rx_data *rdata)
+{
+    pjsip_registrar *reg = mod_registrar.reg;
+    pjsip_msg *msg = rdata->msg_info.msg;
+
+    if (!reg || reg->shutting_down ||
+	pjsip_method_cmp(&msg->line.req.method, &pjsip_register_method) != 0)
+    {
+	return PJ_FALSE;
+    }
+
+    /* Check the domain */
+    if (reg->setting.domain.slen) {
+	const pjsip_sip_uri *req_uri;
+
+	if (!PJSIP_URI_SCHEME_IS_SIP(msg->line.req.uri) &&
+	    !PJSIP_URI_SCHEME_IS_SIPS(msg->line.req.uri))
+	{
+	    return PJ_FALSE;
+	}
+
+	req_uri = (const pjsip_sip_uri*)
+		  pjsip_uri_get_uri(msg->line.req.uri);
+	if (pj_stricmp(&req_uri->host, &reg->setting.domain) != 0)
+	    return PJ_FALSE;
+    }
+
+    handle_register(reg, rdata);
+    return PJ_TRUE;
+}
+
+
+/* Split snapshot record at tab character */
+static pj_bool_t next_field(char **p, char *end, pj_str_t *field)
+{
+    char *tab;
+
+    if (*p >= end)
+	return PJ_FALSE;
+
+    tab = (char*) pj_memchr(*p, '\t', end - *p);
+    if (!tab)
+	tab = end;
+
+    field->ptr = *p;
+    field->slen = tab - *p;
+    *p = tab + 1;
+    return PJ_TRUE;
+}
+
+
+/* Restore bindings from the snapshot file */
+static pj_status_t load_snapshot(pjsip_registrar *reg)
+{
+    pj_pool_t *pool;
+    pj_oshandle_t fd;
+    pj_off_t size;
+    pj_ssize_t len;
+    char *buf, *line, *end;
+    pj_uint32_t now = now_sec();
+    unsigned i;
+    pj_status_t status;
+
+    if (!pj_file_exists(reg->snapshot_file))
+	return PJ_SUCCESS;
+
+    size = pj_file_size(reg->snapshot_file);
+    if (size <= 0)
+	return PJ_SUCCESS;
+
+    pool = pjsip_endpt_create_pool(reg->endpt, "regsnap",
+				   (pj_size_t)size + 512, 512);
+    if (!pool)
+	return PJ_ENOMEM;
+
+    buf = (char*) pj_pool_alloc(pool, (pj_size_t)size);
+    len = (pj_ssize_t)size;
+
+    status = pj_file_open(pool, reg->snapshot_file, PJ_O_RDONLY, &fd);
+    if (status == PJ_SUCCESS) {
+	status = pj_file_read(fd, buf, &len);
+	pj_file_close(fd);
+    }
+    if (status != PJ_SUCCESS) {
+	pj_pool_release(pool);
+	return status;
+    }
+
+    line = buf;
+    end = buf + len;
+    while (line < end) {
+	char *eol = (char*) pj_memchr(line, '\n', end - line);
+	pj_str_t op, aor, contact, call_id, cseq, expire, q;
+	pj_uint32_t hval;
+	shard *sh;
+	aor_entry *e;
+	binding *b;
+
+	if (!eol)
+	    break;
+
+	if (!next_field(&line, eol, &op) ||
+	    !next_field(&line, eol, &aor) ||
+	    !next_field(&line, eol, &contact) ||
+	    aor.slen > MAX_AOR_LEN || contact.slen > MAX_CONTACT_LEN)
+	{
+	    line = eol + 1;
+	    continue;
+	}
+
+	sh = get_shard(reg, &aor, &hval);
+	e = find_aor(sh, &aor, hval);
+	b = e ? find_binding(e, &contact, NULL, NULL) : NULL;
+
+	if (op.slen == 1 && *op.ptr == '+') {
+	    if (!next_field(&line, eol, &call_id) ||
+		!next_field(&line, eol, &cseq) ||
+		!next_field(&line, eol, &expire) ||
+		!next_field(&line, eol, &q) ||
+		call_id.slen > MAX_CALLID_LEN)
+	    {
+		line = eol + 1;
+		continue;
+	    }
+
+	    if (!e)
+		e = add_aor(sh, &aor, hval);
+	    set_binding(reg, e, b, &contact, &call_id,
+			(pj_int32_t)pj_strtol(&cseq), (int)pj_strtol(&q),
+			(pj_uint32_t)pj_strtoul(&expire), PJ_FALSE);
+
+	} else if (op.slen == 1 && *op.ptr == '-' && b) {
+	    remove_binding(reg, e, b, PJ_FALSE);
+	    if (e->count == 0)
+		free_aor(sh, e);
+	}
+
+	line = eol + 1;
+    }
+
+    pj_pool_release(pool);
+
+    /* Drop bindings that expired while we're away, and start the timers
+     * of the remaining.
+     */
+    for (i=0; i<reg->setting.shard_count; ++i) {
+	shard *sh = &reg->shards[i];
+	pj_hash_iterator_t it_buf, *it;
+
+	it = pj_hash_first(sh->table, &it_buf);
+	while (it) {
+	    aor_entry *e = (aor_entry*) pj_hash_this(sh->table, it);
+
+	    it = pj_hash_next(sh->table, it);
+	    if (!purge_expired(reg, e, now))
+		schedule_expiry(reg, e, now);
+	}
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+/* Write all bindings to a new snapshot file and reopen it for appending.
+ * Must be called with all shard locks and the log lock held.
+ */
+static pj_status_t write_snapshot(pjsip_registrar *reg)
+{
+    char tmp_file[PJ_MAXPATH];
+    pj_oshandle_t fd;
+    unsigned i;
+    pj_status_t status;
+
+    if (reg->log) {
+	pj_file_close(reg->log);
+	reg->log = NULL;
+    }
+
+    pj_ansi_snprintf(tmp_file, sizeof(tmp_file), "%s.tmp",
+		     reg->snapshot_file);
+
+    status = pj_file_open(reg->pool, tmp_file, PJ_O_WRONLY, &fd);
+    if (status != PJ_SUCCESS)
+	goto on_return;
+
+    for (i=0; i<reg->setting.shard_count; ++i) {
+	shard *sh = &reg->shards[i];
+	pj_hash_iterator_t it_buf, *it;
+
+	it = pj_hash_first(sh->table, &it_buf);
+	for (; it; it = pj_hash_next(sh->table, it)) {
+	    aor_entry *e = (aor_entry*) pj_hash_this(sh->table, it);
+	    binding *b;
+
+	    for (b=e->bindings.next; b!=&e->bindings; b=b->next) {
+		char line[MAX_LINE_LEN];
+		pj_ssize_t len;
+
+		len = pj_ansi_snprintf(line, sizeof(line),
+				       "+\t%.*s\t%.*s\t%.*s\t%d\t%u\t%d\n",
+				       (int)e->aor_len, e->aor,
+				       (int)b->contact_len, b->contact,
+				       (int)b->call_id_len, b->call_id,
+				       b->cseq, b->expire, b->q1000);
+		if (len > 0 && len < (pj_ssize_t)sizeof(line))
+		    pj_file_write(fd, line, &len);
+	    }
+	}
+    }
+
+    status = pj_file_close(fd);
+    if (status == PJ_SUCCESS)
+	status = pj_file_move(tmp_file, reg->snapshot_file);
+
+on_return:
+    if (status != PJ_SUCCESS) {
+	PJ_PERROR(2,(THIS_FILE, status, "Error writing snapshot %s",
+		     reg->snapshot_file));
+    }
+
+    /* Continue appending even when compaction has failed */
+    if (!reg->shutting_down) {
+	pj_status_t status2;
+
+	status2 = pj_file_open(reg->pool, reg->snapshot_file,
+			       PJ_O_WRONLY | PJ_O_APPEND, &reg->log);
+	if (status2 != PJ_SUCCESS) {
+	    reg->log = NULL;
+	    PJ_PERROR(2,(THIS_FILE, status2, "Error opening snapshot %s",
+			 reg->snapshot_file));
+	    if (status == PJ_SUCCESS)
+		status = status2;
+	}
+    }
+
+    return status;
+}
+
+
+/*
+ * Rewrite the snapshot file.
+ */
+PJ_DEF(pj_status_t) pjsip_registrar_save_snapshot(pjsip_registrar *reg)
+{
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(reg, PJ_EINVAL);
+
+    if (!reg->snapshot_file)
+	return PJ_EINVALIDOP;
+
+    /* Lock order is shard then log lock */
+    for (i=0; i<reg->setting.shard_count; ++i)
+	pj_lock_acquire(reg->shards[i].lock);
+    pj_lock_acquire(reg->log_lock);
+
+    status = write_snapshot(reg);
+
+    pj_lock_release(reg->log_lock);
+    for (i=reg->setting.shard_count; i>0; --i)
+	pj_lock_release(reg->shards[i-1].lock);
+
+    return status;
+}
+
+
+/*
+ * Create the registrar.
+ */
+PJ_DEF(pj_status_t) pjsip_registrar_create(pjsip_endpoint *endpt,
+					   const pjsip_registrar_setting *setting,
+					   const pjsip_registrar_cb *cb,
+					   pjsip_registrar **p_reg)
+{
+    pj_pool_t *pool;
+    pjsip_registrar *reg;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(endpt && p_reg, PJ_EINVAL);
+    PJ_ASSERT_RETURN(mod_registrar.reg == NULL, PJ_EEXISTS);
+
+    pool = pjsip_endpt_create_pool(endpt, "registrar", 1000, 1000);
+    PJ_ASSERT_RETURN(pool, PJ_ENOMEM);
+
+    reg = PJ_POOL_ZALLOC_T(pool, pjsip_registrar);
+    reg->endpt = endpt;
+    reg->pool = pool;
+    if (setting)
+	pj_memcpy(&reg->setting, setting, sizeof(*setting));
+    else
+	pjsip_registrar_setting_default(&reg->setting);
+    if (cb)
+	pj_memcpy(&reg->cb, cb, sizeof(*cb));
+
+    if (reg->setting.shard_count == 0)
+	reg->setting.shard_count = 1;
+    if (reg->setting.max_contacts == 0 ||
+	reg->setting.max_contacts > PJSIP_REGISTRAR_MAX_CONTACTS)
+    {
+	reg->setting.max_contacts = PJSIP_REGISTRAR_MAX_CONTACTS;
+    }
+    if (reg->setting.default_expires == 0)
+	reg->setting.default_expires = reg->setting.max_expires;
+    pj_strdup(pool, &reg->setting.domain, &reg->setting.domain);
+
+    /* Create the shards */
+    reg->shards = (shard*) pj_pool_calloc(pool, reg->setting.shard_count,
+					  sizeof(shard));
+    for (i=0; i<reg->setting.shard_count; ++i) {
+	shard *sh = &reg->shards[i];
+
+	sh->reg = reg;
+	pj_list_init(&sh->free_aor);
+	pj_list_init(&sh->free_binding);
+
+	sh->pool = pjsip_endpt_create_pool(endpt, "regshard%p", 4000, 4000);
+	if (!sh->pool) {
+	    status = PJ_ENOMEM;
+	    goto on_error;
+	}
+
+	sh->table = pj_hash_create(sh->pool,
+				   PJSIP_REGISTRAR_SHARD_TABLE_SIZE);
+
+	status = pj_lock_create_simple_mutex(sh->pool, NULL, &sh->lock);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+    }
+
+    /* Restore bindings from the snapshot */
+    if (reg->setting.snapshot_file.slen) {
+	if (reg->setting.snapshot_file.slen >= PJ_MAXPATH - 4) {
+	    status = PJ_ENAMETOOLONG;
+	    goto on_error;
+	}
+
+	reg->snapshot_file = (char*)
+			     pj_pool_alloc(pool,
+					   reg->setting.snapshot_file.slen+1);
+	pj_memcpy(reg->snapshot_file, reg->setting.snapshot_file.ptr,
+		  reg->setting.snapshot_file.slen);
+	reg->snapshot_file[reg->setting.snapshot_file.slen] = '\0';
+	pj_strset(&reg->setting.snapshot_file, reg->snapshot_file,
+		  reg->setting.snapshot_file.slen);
+
+	status = pj_lock_create_simple_mutex(pool, "regsnap", &reg->log_lock);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+
+	status = load_snapshot(reg);
+	if (status != PJ_SUCCESS) {
+	    PJ_PERROR(2,(THIS_FILE, status, "Error loading snapshot %s",
+			 reg->snapshot_file));
+	}
+
+	status = write_snapshot(reg);
+	if (reg->log == NULL)
+	    goto on_error;
+    }
+
+    /* Register the module */
+    mod_registrar.mod.priority = reg->setting.priority;
+    mod_registrar.reg = reg;
+    status = pjsip_endpt_register_module(endpt, &mod_registrar.mod);
+    if (status != PJ_SUCCESS) {
+	mod_registrar.reg = NULL;
+	goto on_error;
+    }
+
+    PJ_LOG(4,(THIS_FILE, "Registrar created with %u shard(s)",
+	      reg->setting.shard_count));
+
+    *p_reg = reg;
+    return PJ_SUCCESS;
+
+on_error:
+    reg->shutting_down = PJ_TRUE;
+    pjsip_registrar_destroy(reg);
+    return status;
+}
+
+
+/* Cancel the timer of an address of record on shutdown. Must be called
+ * with the shard lock held.
+ */
+static void cancel_aor_timer(pjsip_registrar *reg, aor_entry *e)
+{
+    if (!e->timer.id)
+	return;
+
+    if (pj_timer_heap_cancel(pjsip_endpt_get_timer_heap(reg->endpt),
+			     &e->timer) == 1)
+    {
+	e->timer.id = 0;
+    } else {
+	/* Timer has fired and the callback is waiting for the lock */
+	++e->shard->cb_pending;
+    }
+}
+
+
+/*
+ * Destroy the registrar.
+ */
+PJ_DEF(pj_status_t) pjsip_registrar_destroy(pjsip_registrar *reg)
+{
+    unsigned i;
+
+    PJ_ASSERT_RETURN(reg, PJ_EINVAL);
+
+    if (mod_registrar.reg == reg) {
+	pjsip_endpt_unregister_module(reg->endpt, &mod_registrar.mod);
+	mod_registrar.reg = NULL;
+    }
+
+    /* Compact the snapshot once more */
+    if (reg->log && !reg->shutting_down)
+	pjsip_registrar_save_snapshot(reg);
+
+    reg->shutting_down = PJ_TRUE;
+
+    /* Mark the shards shutting down before cancelling the timers, so that
+     * the timer callbacks which have already fired see it once they get
+     * the lock. Released entries are included, their timer may have fired
+     * too.
+     */
+    for (i=0; i<reg->setting.shard_count; ++i) {
+	shard *sh = &reg->shards[i];
+	pj_hash_iterator_t it_buf, *it;
+	aor_entry *e;
+
+	if (!sh->lock)
+	    continue;
+
+	pj_lock_acquire(sh->lock);
+	sh->shutting_down = PJ_TRUE;
+	it = pj_hash_first(sh->table, &it_buf);
+	for (; it; it = pj_hash_next(sh->table, it)) {
+	    e = (aor_entry*) pj_hash_this(sh->table, it);
+	    cancel_aor_timer(reg, e);
+	}
+	for (e=sh->free_aor.next; e!=&sh->free_aor; e=e->next)
+	    cancel_aor_timer(reg, e);
+	pj_lock_release(sh->lock);
+    }
+
+    /* Wait for the timer callbacks that are still running */
+    for (i=0; i<reg->setting.shard_count; ++i) {
+	shard *sh = &reg->shards[i];
+
+	if (!sh->lock)
+	    continue;
+
+	for (;;) {
+	    unsigned pending;
+
+	    pj_lock_acquire(sh->lock);
+	    pending = sh->cb_pending;
+	    pj_lock_release(sh->lock);
+
+	    if (pending == 0)
+		break;
+	    pj_thread_sleep(10);
+	}
+    }
+
+    for (i=0; i<reg->setting.shard_count; ++i) {
+	shard *sh = &reg->shards[i];
+
+	if (sh->lock)
+	    pj_lock_destroy(sh->lock);
+	if (sh->pool)
+	    pj_pool_release(sh->pool);
+    }
+
+    if (reg->log) {
+	pj_file_close(reg->log);
+	reg->log = NULL;
+    }
+    if (reg->log_lock)
+	pj_lock_destroy(reg->log_lock);
+
+    pj_pool_release(reg->pool);
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Get the bindings of an address of record.
+ */
+PJ_DEF(pj_status_t) pjsip_registrar_lookup(pjsip_registrar *reg,
+					   const pj_str_t *aor,
+					   pj_pool_t *pool,
+					   unsigned *count,
+					   pjsip_registrar_binding bindings[])
+{
+    pj_uint32_t hval, now;
+    shard *sh;
+    aor_entry *e;
+    binding *b;
+    unsigned n = 0;
+
+    PJ_ASSERT_RETURN(reg && aor && pool && count && bindings, PJ_EINVAL);
+
+    now = now_sec();
+    sh = get_shard(reg, aor, &hval);
+
+    pj_lock_acquire(sh->lock);
+
+    e = find_aor(sh, aor, hval);
+    if (!e) {
+	pj_lock_release(sh->lock);
+	*count = 0;
+	return PJ_ENOTFOUND;
+    }
+
+    for (b=e->bindings.next; b!=&e->bindings && n<*count; b=b->next) {
+	pjsip_registrar_binding info;
+
+	if (b->expire <= now)
+	    continue;
+
+	get_binding_info(e, b, now, &info);
+	pj_strdup(pool, &bindings[n].aor, &info.aor);
+	pj_strdup(pool, &bindings[n].contact, &info.contact);
+	pj_strdup(pool, &bindings[n].call_id, &info.call_id);
+	bindings[n].cseq = info.cseq;
+	bindings[n].q1000 = info.q1000;
+	bindings[n].expires = info.expires;
+	++n;
+    }
+
+    pj_lock_release(sh->lock);
+
+    *count = n;
+    return n ? PJ_SUCCESS : PJ_ENOTFOUND;
+}
+
+
+/*
+ * Get the number of address of records and bindings.
+ */
+PJ_DEF(void) pjsip_registrar_get_count(pjsip_registrar *reg,
+				       unsigned *aor_cnt,
+				       unsigned *binding_cnt)
+{
+    unsigned i, acnt = 0, bcnt = 0;
+
+    PJ_ASSERT_ON_FAIL(reg, return);
+
+    for (i=0; i<reg->setting.shard_count; ++i) {
+	pj_lock_acquire(reg->shards[i].lock);
+	acnt += reg->shards[i].aor_cnt;
+	bcnt += reg->shards[i].binding_cnt;
+	pj_lock_release(reg->shards[i].lock);
+    }
+
+    if (aor_cnt)
+	*aor_cnt = acnt;
+    if (binding_cnt)
+	*binding_cnt = bcnt;
+}
@@ -450,6 +450,30 @@ static pjsip_cached_auth *find_cached_auth( pjsip_auth_clt_sess *sess,
     return NULL;
 }
 
+/* Find cached authentication for the realm of the challenge, or create
+ * a new one if not present.
+ */
+static pjsip_cached_auth *get_cached_auth(pjsip_auth_clt_sess *sess,
+				const pjsip_www_authenticate_hdr *hchal)
+{
+    pjsip_cached_auth *cached_auth;
+
+    cached_auth = find_cached_auth(sess, &hchal->challenge.common.realm );
+    if (!cached_auth) {
+	cached_auth = PJ_POOL_ZALLOC_T( sess->pool, pjsip_cached_auth);
+	pj_strdup( sess->pool, &cached_auth->realm, &hchal->challenge.common.realm);
+	cached_auth->is_proxy = (hchal->type == PJSIP_H_PROXY_AUTHENTICATE);
+#	if (PJSIP_AUTH_HEADER_CACHING)
+	{
+	    pj_list_init(&cached_auth->cached_hdr);
+	}
+#	endif
+	pj_list_insert_before( &sess->cached_auth, cached_auth );
+    }
+
+    return cached_auth;
+}
+
 /* Find credential to use for the specified realm and auth scheme. */
 static const pjsip_cred_info* auth_find_cred( const pjsip_auth_clt_sess *sess,
 					      const pj_str_t *realm,
@@ -961,6 +985,66 @@ PJ_DEF(pj_status_t) pjsip_auth_clt_init_req( pjsip_auth_clt_sess *sess,
 }
 
 
+/* Initialize outgoing request with a challenge received previously. */
+PJ_DEF(pj_status_t) pjsip_auth_clt_init_req_with_chal(
+				    pjsip_auth_clt_sess *sess,
+				    pjsip_tx_data *tdata,
+				    const pjsip_www_authenticate_hdr *chal)
+{
+    const pj_str_t *realm;
+    pjsip_hdr_e htype;
+    pjsip_authorization_hdr *hauth;
+    const pjsip_cred_info *cred;
+    pjsip_cached_auth *cached_auth;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(sess && tdata && chal, PJ_EINVAL);
+    PJ_ASSERT_RETURN(sess->pool, PJSIP_ENOTINITIALIZED);
+    PJ_ASSERT_RETURN(tdata->msg->type==PJSIP_REQUEST_MSG,
+		     PJSIP_ENOTREQUESTMSG);
+    PJ_ASSERT_RETURN(chal->type == PJSIP_H_WWW_AUTHENTICATE ||
+		     chal->type == PJSIP_H_PROXY_AUTHENTICATE, PJ_EINVAL);
+
+    realm = &chal->challenge.common.realm;
+    htype = (chal->type == PJSIP_H_PROXY_AUTHENTICATE) ?
+	    PJSIP_H_PROXY_AUTHORIZATION : PJSIP_H_AUTHORIZATION;
+
+    /* Nothing to do if the request already has credential for the realm,
+     * but remove the empty one added for initial authentication.
+     */
+    hauth = (pjsip_authorization_hdr*)
+	    pjsip_msg_find_hdr(tdata->msg, htype, NULL);
+    while (hauth) {
+	pjsip_authorization_hdr *next;
+
+	next = (pjsip_authorization_hdr*)
+	       pjsip_msg_find_hdr(tdata->msg, htype, hauth->next);
+	if (pj_stricmp(&hauth->credential.digest.realm, realm)==0) {
+	    if (hauth->credential.digest.response.slen)
+		return PJ_SUCCESS;
+	    pj_list_erase(hauth);
+	}
+	hauth = next;
+    }
+
+    cred = auth_find_cred(sess, realm, &chal->scheme);
+    if (!cred)
+	return PJSIP_ENOCREDENTIAL;
+
+    cached_auth = get_cached_auth(sess, chal);
+    status = auth_respond( tdata->pool, chal, tdata->msg->line.req.uri,
+			   cred, &tdata->msg->line.req.method,
+			   sess->pool, cached_auth, &hauth);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    pjsip_msg_add_hdr(tdata->msg, (pjsip_hdr*)hauth);
+    pjsip_tx_data_invalidate_msg(tdata);
+
+    return PJ_SUCCESS;
+}
+
+
 /* Process authorization challenge */
 static pj_status_t process_auth( pj_pool_t *req_pool,
 				 const pjsip_www_authenticate_hdr *hchal,
@@ -1132,18 +1216,7 @@ PJ_DEF(pj_status_t) pjsip_auth_clt_reinit_req(	pjsip_auth_clt_sess *sess,
 	/* Find authentication session for this realm, create a new one
 	 * if not present.
 	 */
-	cached_auth = find_cached_auth(sess, &hchal->challenge.common.realm );
-	if (!cached_auth) {
-	    cached_auth = PJ_POOL_ZALLOC_T( sess->pool, pjsip_cached_auth);
-	    pj_strdup( sess->pool, &cached_auth->realm, &hchal->challenge.common.realm);
-	    cached_auth->is_proxy = (hchal->type == PJSIP_H_PROXY_AUTHENTICATE);
-#	    if (PJSIP_AUTH_HEADER_CACHING)
-	    {
-		pj_list_init(&cached_auth->cached_hdr);
-	    }
-#	    endif
-	    pj_list_insert_before( &sess->cached_auth, cached_auth );
-	}
+	cached_auth = get_cached_auth(sess, hchal);
 
 	/* Create authorization header for this challenge, and update
 	 * authorization session.
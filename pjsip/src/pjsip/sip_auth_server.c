@@ -23,8 +23,89 @@
 #include <pjsip/sip_auth_msg.h>
 #include <pjsip/sip_errno.h>
 #include <pjsip/sip_transport.h>
-#include <pj/string.h>
+#include <pjlib-util/hmac_md5.h>
+#include <pjlib-util/md5.h>
 #include <pj/assert.h>
+#include <pj/ctype.h>
+#include <pj/errno.h>
+#include <pj/file_io.h>
+#include <pj/guid.h>
+#include <pj/hash.h>
+#include <pj/list.h>
+#include <pj/lock.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+
+#if defined(PJ_HAS_SSL_SOCK) && PJ_HAS_SSL_SOCK != 0
+#   include <openssl/rand.h>
+#endif
+
+#define THIS_FILE	"sip_auth_server.c"
+
+
+/* Length of signed nonce: 8 hex digits timestamp and 32 hex digits HMAC */
+#define NONCE_LEN	40
+
+/* Maximum account name length to be cached */
+#define MAX_USER_LEN	64
+
+/* Number of nonce-count values tracked below the highest one */
+#define NC_WINDOW	32
+
+
+/* Cached credential */
+typedef struct cred_entry
+{
+    PJ_DECL_LIST_MEMBER(struct cred_entry);
+    pj_hash_entry_buf	hbuf;
+    char		user[MAX_USER_LEN];
+    unsigned		user_len;
+    char		ha1[PJSIP_MD5STRLEN];
+    pj_time_val		expire;
+} cred_entry;
+
+/* Nonce-count tracking of a nonce. The nonce may be shared by several
+ * clients, each counting with its own cnonce.
+ */
+typedef struct nc_entry
+{
+    char		nonce[NONCE_LEN];
+    pj_uint32_t		cnonce_hash;
+    pj_uint32_t		max_nc;
+    pj_uint32_t		window;	    /* Bit n is set if max_nc-n is seen */
+} nc_entry;
+
+/* Server authentication cache */
+struct pjsip_auth_srv_cache
+{
+    pj_lock_t		*lock;
+    pjsip_auth_srv_cache_setting setting;
+    pj_uint8_t		 key[32];
+    unsigned		 key_len;
+
+    /* Credentials */
+    pj_hash_table_t	*cred_table;
+    cred_entry		 cred_lru;	/* Most recently used first */
+    cred_entry		 cred_free;
+
+    /* Nonce-count tracking */
+    nc_entry		*nc_table;
+};
+
+/* State of a request being verified */
+typedef struct verify_job
+{
+    pjsip_rx_data	       *rdata;
+    pjsip_authorization_hdr    *h_auth;
+    pj_bool_t			has_ha1;
+    pj_bool_t			ha1_cached;
+    pj_bool_t			ha1_stale;
+    char			ha1[PJSIP_MD5STRLEN];
+    int				code;
+    pj_status_t			status;
+} verify_job;
 
 
 /*
@@ -116,31 +197,16 @@ static pj_status_t pjsip_auth_verify( const pjsip_authorization_hdr *hdr,
 }
 
 
-/*
- * Request the authorization server framework to verify the authorization 
- * information in the specified request in rdata.
- */
-PJ_DEF(pj_status_t) pjsip_auth_srv_verify( pjsip_auth_srv *auth_srv,
-					   pjsip_rx_data *rdata,
-					   int *status_code)
+/* Find Authorization/Proxy-Authorization header for our realm. */
+static pjsip_authorization_hdr *find_auth_hdr(pjsip_auth_srv *auth_srv,
+					      pjsip_msg *msg)
 {
     pjsip_authorization_hdr *h_auth;
-    pjsip_msg *msg = rdata->msg_info.msg;
     pjsip_hdr_e htype;
-    pj_str_t acc_name;
-    pjsip_cred_info cred_info;
-    pj_status_t status;
-
-    PJ_ASSERT_RETURN(auth_srv && rdata, PJ_EINVAL);
-    PJ_ASSERT_RETURN(msg->type == PJSIP_REQUEST_MSG, PJSIP_ENOTREQUESTMSG);
 
     htype = auth_srv->is_proxy ? PJSIP_H_PROXY_AUTHORIZATION : 
 				 PJSIP_H_AUTHORIZATION;
 
-    /* Initialize status with 200. */
-    *status_code = 200;
-
-    /* Find authorization header for our realm. */
     h_auth = (pjsip_authorization_hdr*) pjsip_msg_find_hdr(msg, htype, NULL);
     while (h_auth) {
 	if (!pj_stricmp(&h_auth->credential.common.realm, &auth_srv->realm))
@@ -155,48 +221,631 @@ PJ_DEF(pj_status_t) pjsip_auth_srv_verify( pjsip_auth_srv *auth_srv,
 	h_auth=(pjsip_authorization_hdr*)pjsip_msg_find_hdr(msg,htype,h_auth);
     }
 
-    if (!h_auth) {
-	*status_code = auth_srv->is_proxy ? 407 : 401;
-	return PJSIP_EAUTHNOAUTH;
-    }
+    return h_auth;
+}
 
-    /* Check authorization scheme. */
-    if (pj_stricmp(&h_auth->scheme, &pjsip_DIGEST_STR) == 0)
-	acc_name = h_auth->credential.digest.username;
-    else {
-	*status_code = auth_srv->is_proxy ? 407 : 401;
-	return PJSIP_EINVALIDAUTHSCHEME;
-    }
 
-    /* Find the credential information for the account. */
+/* Call the lookup function for the account. */
+static pj_status_t lookup_cred(pjsip_auth_srv *auth_srv,
+			       pjsip_rx_data *rdata,
+			       const pj_str_t *acc_name,
+			       pjsip_cred_info *cred_info)
+{
     if (auth_srv->lookup2) {
 	pjsip_auth_lookup_cred_param param;
 
 	pj_bzero(&param, sizeof(param));
 	param.realm = auth_srv->realm;
-	param.acc_name = acc_name;
+	param.acc_name = *acc_name;
 	param.rdata = rdata;
-	status = (*auth_srv->lookup2)(rdata->tp_info.pool, &param, &cred_info);
-	if (status != PJ_SUCCESS) {
-	    *status_code = PJSIP_SC_FORBIDDEN;
-	    return status;
+	return (*auth_srv->lookup2)(rdata->tp_info.pool, &param, cred_info);
+    } else {
+	return (*auth_srv->lookup)(rdata->tp_info.pool, &auth_srv->realm,
+				   acc_name, cred_info);
+    }
+}
+
+
+/* Convert binary digest to lowercase hex string. */
+static void digest2str(const pj_uint8_t *digest, unsigned len, char *str)
+{
+    static const char hex[] = "0123456789abcdef";
+    unsigned i;
+
+    for (i=0; i<len; ++i) {
+	*str++ = hex[digest[i] >> 4];
+	*str++ = hex[digest[i] & 0x0F];
+    }
+}
+
+
+/* Create signed nonce for the specified timestamp. */
+static void create_nonce(pjsip_auth_srv_cache *cache,
+			 const pj_str_t *realm,
+			 pj_uint32_t ts,
+			 char nonce[NONCE_LEN])
+{
+    pj_hmac_md5_context ctx;
+    pj_uint8_t digest[16];
+    unsigned i;
+
+    for (i=0; i<4; ++i)
+	pj_val_to_hex_digit((ts >> (24 - i*8)) & 0xFF, nonce + i*2);
+
+    pj_hmac_md5_init(&ctx, cache->key, cache->key_len);
+    pj_hmac_md5_update(&ctx, (const pj_uint8_t*)nonce, 8);
+    pj_hmac_md5_update(&ctx, (const pj_uint8_t*)":", 1);
+    pj_hmac_md5_update(&ctx, (const pj_uint8_t*)realm->ptr,
+		       (unsigned)realm->slen);
+    pj_hmac_md5_final(&ctx, digest);
+
+    digest2str(digest, sizeof(digest), nonce + 8);
+}
+
+
+/* Validate nonce signature and age. */
+static pj_status_t check_nonce(pjsip_auth_srv_cache *cache,
+			       const pj_str_t *realm,
+			       const pj_str_t *nonce)
+{
+    char expected[NONCE_LEN];
+    pj_uint32_t ts = 0;
+    pj_time_val now;
+    unsigned i, diff = 0;
+
+    if (nonce->slen != NONCE_LEN)
+	return PJSIP_EAUTHINNONCE;
+
+    for (i=0; i<8; ++i) {
+	if (!pj_isxdigit(nonce->ptr[i]))
+	    return PJSIP_EAUTHINNONCE;
+	ts = (ts << 4) | pj_hex_digit_to_val(nonce->ptr[i]);
+    }
+
+    create_nonce(cache, realm, ts, expected);
+    for (i=8; i<NONCE_LEN; ++i)
+	diff |= (pj_tolower(nonce->ptr[i]) ^ expected[i]);
+    if (diff)
+	return PJSIP_EAUTHINNONCE;
+
+    pj_gettimeofday(&now);
+    if ((pj_uint32_t)now.sec - ts > cache->setting.nonce_expiry)
+	return PJSIP_EAUTHSTALENONCE;
+
+    return PJ_SUCCESS;
+}
+
+
+/* Check and record the nonce-count. Must be called with the lock held. */
+static pj_status_t check_nc(pjsip_auth_srv_cache *cache,
+			    const pjsip_digest_credential *dig)
+{
+    nc_entry *e;
+    pj_uint32_t nc, hval, idx;
+
+    if (!cache->nc_table || dig->qop.slen == 0)
+	return PJ_SUCCESS;
+
+    nc = (pj_uint32_t) pj_strtoul2(&dig->nc, NULL, 16);
+    if (nc == 0)
+	return PJSIP_EAUTHNCREPLAY;
+
+    hval = pj_hash_calc(0, dig->cnonce.ptr, (unsigned)dig->cnonce.slen);
+    idx = pj_hash_calc(hval, dig->nonce.ptr, NONCE_LEN) %
+	  cache->setting.nc_table_size;
+    e = &cache->nc_table[idx];
+
+    if (e->cnonce_hash != hval ||
+	pj_memcmp(e->nonce, dig->nonce.ptr, NONCE_LEN) != 0)
+    {
+	/* First use of this nonce, or the slot was used by other nonce */
+	pj_memcpy(e->nonce, dig->nonce.ptr, NONCE_LEN);
+	e->cnonce_hash = hval;
+	e->max_nc = nc;
+	e->window = 1;
+	return PJ_SUCCESS;
+    }
+
+    if (nc > e->max_nc) {
+	pj_uint32_t shift = nc - e->max_nc;
+
+	e->window = (shift >= NC_WINDOW) ? 0 : (e->window << shift);
+	e->window |= 1;
+	e->max_nc = nc;
+	return PJ_SUCCESS;
+    } else {
+	pj_uint32_t diff = e->max_nc - nc;
+
+	if (diff >= NC_WINDOW || (e->window & ((pj_uint32_t)1 << diff)))
+	    return PJSIP_EAUTHNCREPLAY;
+
+	e->window |= ((pj_uint32_t)1 << diff);
+	return PJ_SUCCESS;
+    }
+}
+
+
+/* Find cached credential. Must be called with the lock held. */
+static cred_entry *find_cred(pjsip_auth_srv_cache *cache,
+			     const pj_str_t *acc_name)
+{
+    if (!cache->cred_table || acc_name->slen > MAX_USER_LEN)
+	return NULL;
+
+    return (cred_entry*) pj_hash_get(cache->cred_table, acc_name->ptr,
+				     (unsigned)acc_name->slen, NULL);
+}
+
+
+/* Remove cached credential. Must be called with the lock held. */
+static void remove_cred(pjsip_auth_srv_cache *cache, cred_entry *e)
+{
+    pj_hash_set_np(cache->cred_table, e->user, e->user_len, 0, NULL, NULL);
+    pj_list_erase(e);
+    pj_list_push_back(&cache->cred_free, e);
+}
+
+
+/* Add credential to the cache. Must be called with the lock held. */
+static void add_cred(pjsip_auth_srv_cache *cache,
+		     const pj_str_t *acc_name,
+		     const char ha1[PJSIP_MD5STRLEN])
+{
+    cred_entry *e;
+
+    if (!cache->cred_table || acc_name->slen > MAX_USER_LEN)
+	return;
+
+    e = find_cred(cache, acc_name);
+    if (e) {
+	remove_cred(cache, e);
+    } else if (pj_list_empty(&cache->cred_free)) {
+	/* Evict the least recently used */
+	remove_cred(cache, cache->cred_lru.prev);
+    }
+
+    e = cache->cred_free.next;
+    pj_list_erase(e);
+
+    pj_memcpy(e->user, acc_name->ptr, acc_name->slen);
+    e->user_len = (unsigned)acc_name->slen;
+    pj_memcpy(e->ha1, ha1, PJSIP_MD5STRLEN);
+    pj_gettickcount(&e->expire);
+    e->expire.sec += cache->setting.cred_ttl;
+
+    pj_hash_set_np(cache->cred_table, e->user, e->user_len, 0, e->hbuf, e);
+    pj_list_push_front(&cache->cred_lru, e);
+}
+
+
+/* Calculate H(A1) of the credential. */
+static pj_bool_t calc_ha1(const pjsip_cred_info *cred_info,
+			  char ha1[PJSIP_MD5STRLEN])
+{
+    if (cred_info->data_type == PJSIP_CRED_DATA_PLAIN_PASSWD) {
+	pj_md5_context ctx;
+	pj_uint8_t digest[16];
+
+	pj_md5_init(&ctx);
+	pj_md5_update(&ctx, (pj_uint8_t*)cred_info->username.ptr,
+		      (unsigned)cred_info->username.slen);
+	pj_md5_update(&ctx, (pj_uint8_t*)":", 1);
+	pj_md5_update(&ctx, (pj_uint8_t*)cred_info->realm.ptr,
+		      (unsigned)cred_info->realm.slen);
+	pj_md5_update(&ctx, (pj_uint8_t*)":", 1);
+	pj_md5_update(&ctx, (pj_uint8_t*)cred_info->data.ptr,
+		      (unsigned)cred_info->data.slen);
+	pj_md5_final(&ctx, digest);
+	digest2str(digest, sizeof(digest), ha1);
+	return PJ_TRUE;
+
+    } else if (cred_info->data_type == PJSIP_CRED_DATA_DIGEST &&
+	       cred_info->data.slen == PJSIP_MD5STRLEN)
+    {
+	pj_memcpy(ha1, cred_info->data.ptr, PJSIP_MD5STRLEN);
+	return PJ_TRUE;
+    }
+
+    /* Other credential types can't be cached */
+    return PJ_FALSE;
+}
+
+
+/* Verify the request digest against H(A1). */
+static pj_bool_t verify_ha1(const pjsip_authorization_hdr *h_auth,
+			    const pj_str_t *method,
+			    const char ha1[PJSIP_MD5STRLEN])
+{
+    const pjsip_digest_credential *dig = &h_auth->credential.digest;
+    pjsip_cred_info cred_info;
+    char digest_buf[PJSIP_MD5STRLEN];
+    pj_str_t digest;
+
+    pj_bzero(&cred_info, sizeof(cred_info));
+    cred_info.realm = dig->realm;
+    cred_info.username = dig->username;
+    cred_info.data_type = PJSIP_CRED_DATA_DIGEST;
+    cred_info.data.ptr = (char*)ha1;
+    cred_info.data.slen = PJSIP_MD5STRLEN;
+
+    digest.ptr = digest_buf;
+    digest.slen = PJSIP_MD5STRLEN;
+
+    pjsip_auth_create_digest(&digest, &dig->nonce, &dig->nc, &dig->cnonce,
+			     &dig->qop, &dig->uri, &dig->realm, &cred_info,
+			     method);
+
+    return pj_stricmp(&digest, &dig->response) == 0;
+}
+
+
+/* Check the headers of the request, and for cached verification, the
+ * nonce. This doesn't need the lock.
+ */
+static void verify_prepare(pjsip_auth_srv *auth_srv, verify_job *job)
+{
+    pjsip_msg *msg = job->rdata->msg_info.msg;
+    int chal_code = auth_srv->is_proxy ? 407 : 401;
+
+    job->code = 200;
+    job->status = PJ_SUCCESS;
+
+    if (msg->type != PJSIP_REQUEST_MSG) {
+	pj_assert(!"Not a request");
+	job->code = PJSIP_SC_INTERNAL_SERVER_ERROR;
+	job->status = PJSIP_ENOTREQUESTMSG;
+	return;
+    }
+
+    /* Find authorization header for our realm. */
+    job->h_auth = find_auth_hdr(auth_srv, msg);
+    if (!job->h_auth) {
+	job->code = chal_code;
+	job->status = PJSIP_EAUTHNOAUTH;
+	return;
+    }
+
+    /* Check authorization scheme. */
+    if (pj_stricmp(&job->h_auth->scheme, &pjsip_DIGEST_STR) != 0) {
+	job->code = chal_code;
+	job->status = PJSIP_EINVALIDAUTHSCHEME;
+	return;
+    }
+
+    /* Check the nonce issued by us. */
+    if (auth_srv->cache) {
+	job->status = check_nonce(auth_srv->cache, &auth_srv->realm,
+				  &job->h_auth->credential.digest.nonce);
+	if (job->status != PJ_SUCCESS)
+	    job->code = chal_code;
+    }
+}
+
+
+/* Lookup the credential when it's not cached, and verify the digest. This
+ * doesn't need the lock.
+ */
+static void verify_digest(pjsip_auth_srv *auth_srv, verify_job *job)
+{
+    pjsip_msg *msg = job->rdata->msg_info.msg;
+    const pj_str_t *acc_name = &job->h_auth->credential.digest.username;
+    pjsip_cred_info cred_info;
+
+    if (job->has_ha1) {
+	if (verify_ha1(job->h_auth, &msg->line.req.method.name, job->ha1))
+	    return;
+
+	/* The password may have changed, try again with fresh credential */
+	job->has_ha1 = job->ha1_cached = PJ_FALSE;
+	job->ha1_stale = PJ_TRUE;
+    }
+
+    /* Find the credential information for the account. */
+    job->status = lookup_cred(auth_srv, job->rdata, acc_name, &cred_info);
+    if (job->status != PJ_SUCCESS) {
+	job->code = PJSIP_SC_FORBIDDEN;
+	return;
+    }
+
+    if (auth_srv->cache && calc_ha1(&cred_info, job->ha1)) {
+	job->has_ha1 = PJ_TRUE;
+	if (!verify_ha1(job->h_auth, &msg->line.req.method.name, job->ha1)) {
+	    job->status = PJSIP_EAUTHINVALIDDIGEST;
+	    job->code = PJSIP_SC_FORBIDDEN;
 	}
+	return;
+    }
+
+    /* Authenticate with the specified credential. */
+    job->status = pjsip_auth_verify(job->h_auth, &msg->line.req.method.name,
+				    &cred_info);
+    if (job->status != PJ_SUCCESS)
+	job->code = PJSIP_SC_FORBIDDEN;
+}
+
+
+/*
+ * Verify the authorization information of several requests at once.
+ */
+PJ_DEF(pj_status_t) pjsip_auth_srv_verify_batch(pjsip_auth_srv *auth_srv,
+						unsigned count,
+						pjsip_rx_data *rdata[],
+						int status_code[],
+						pj_status_t result[])
+{
+    pjsip_auth_srv_cache *cache;
+    verify_job job_buf[16];
+    verify_job *jobs = job_buf;
+    pj_status_t status = PJ_SUCCESS;
+    pj_time_val now;
+    unsigned i;
+
+    PJ_ASSERT_RETURN(auth_srv && rdata && status_code && result, PJ_EINVAL);
+
+    if (count == 0)
+	return PJ_SUCCESS;
+
+    cache = auth_srv->cache;
+
+    if (count > PJ_ARRAY_SIZE(job_buf)) {
+	jobs = (verify_job*) pj_pool_calloc(rdata[0]->tp_info.pool, count,
+					    sizeof(verify_job));
+    } else {
+	pj_bzero(job_buf, sizeof(job_buf));
+    }
+
+    for (i=0; i<count; ++i) {
+	jobs[i].rdata = rdata[i];
+	verify_prepare(auth_srv, &jobs[i]);
+    }
+
+    /* Get the cached credentials */
+    if (cache && cache->cred_table) {
+	pj_gettickcount(&now);
+	pj_lock_acquire(cache->lock);
+	for (i=0; i<count; ++i) {
+	    cred_entry *e;
+
+	    if (jobs[i].status != PJ_SUCCESS)
+		continue;
+
+	    e = find_cred(cache, &jobs[i].h_auth->credential.digest.username);
+	    if (e && PJ_TIME_VAL_GT(e->expire, now)) {
+		pj_memcpy(jobs[i].ha1, e->ha1, PJSIP_MD5STRLEN);
+		jobs[i].has_ha1 = jobs[i].ha1_cached = PJ_TRUE;
+
+		/* Move to the front of LRU list */
+		pj_list_erase(e);
+		pj_list_push_front(&cache->cred_lru, e);
+	    }
+	}
+	pj_lock_release(cache->lock);
+    }
+
+    for (i=0; i<count; ++i) {
+	if (jobs[i].status == PJ_SUCCESS)
+	    verify_digest(auth_srv, &jobs[i]);
+    }
+
+    /* Update the cache and check for replays */
+    if (cache) {
+	pj_lock_acquire(cache->lock);
+	for (i=0; i<count; ++i) {
+	    if (jobs[i].status != PJ_SUCCESS) {
+		cred_entry *e;
+
+		if (!jobs[i].ha1_stale)
+		    continue;
+
+		e = find_cred(cache,
+			      &jobs[i].h_auth->credential.digest.username);
+		if (e)
+		    remove_cred(cache, e);
+		continue;
+	    }
+
+	    if (jobs[i].has_ha1 && !jobs[i].ha1_cached) {
+		add_cred(cache, &jobs[i].h_auth->credential.digest.username,
+			 jobs[i].ha1);
+	    }
+
+	    jobs[i].status = check_nc(cache,
+				      &jobs[i].h_auth->credential.digest);
+	    if (jobs[i].status != PJ_SUCCESS)
+		jobs[i].code = PJSIP_SC_FORBIDDEN;
+	}
+	pj_lock_release(cache->lock);
+    }
+
+    for (i=0; i<count; ++i) {
+	status_code[i] = jobs[i].code;
+	result[i] = jobs[i].status;
+	if (status == PJ_SUCCESS)
+	    status = jobs[i].status;
+    }
+
+    return status;
+}
+
+
+/*
+ * Request the authorization server framework to verify the authorization 
+ * information in the specified request in rdata.
+ */
+PJ_DEF(pj_status_t) pjsip_auth_srv_verify( pjsip_auth_srv *auth_srv,
+					   pjsip_rx_data *rdata,
+					   int *status_code)
+{
+    pj_status_t result;
+    int code;
+
+    PJ_ASSERT_RETURN(auth_srv && rdata, PJ_EINVAL);
+    PJ_ASSERT_RETURN(rdata->msg_info.msg->type == PJSIP_REQUEST_MSG,
+		     PJSIP_ENOTREQUESTMSG);
+
+    pjsip_auth_srv_verify_batch(auth_srv, 1, &rdata, &code, &result);
+    if (status_code)
+	*status_code = code;
+
+    return result;
+}
+
+
+/* Fill the nonce key with cryptographically secure random bytes. The key
+ * must not be guessable, otherwise anyone could forge our nonces, so
+ * pj_rand() is not good enough here.
+ */
+static pj_status_t create_nonce_key(pj_pool_t *pool, pj_uint8_t *key,
+				    unsigned len)
+{
+    pj_oshandle_t fd;
+    pj_ssize_t size;
+    pj_status_t status;
+
+#if defined(PJ_HAS_SSL_SOCK) && PJ_HAS_SSL_SOCK != 0
+    if (RAND_bytes(key, (int)len) == 1)
+	return PJ_SUCCESS;
+#endif
+
+    status = pj_file_open(pool, "/dev/urandom", PJ_O_RDONLY, &fd);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    size = len;
+    status = pj_file_read(fd, key, &size);
+    pj_file_close(fd);
+    if (status == PJ_SUCCESS && size != (pj_ssize_t)len)
+	status = PJ_ETOOSMALL;
+
+    return status;
+}
+
+
+/*
+ * Initialize server authentication cache setting with default values.
+ */
+PJ_DEF(void) pjsip_auth_srv_cache_setting_default(
+				    pjsip_auth_srv_cache_setting *setting)
+{
+    pj_bzero(setting, sizeof(*setting));
+    setting->cred_count = PJSIP_AUTH_SRV_CACHE_SIZE;
+    setting->cred_ttl = PJSIP_AUTH_SRV_CACHE_TTL;
+    setting->nonce_expiry = PJSIP_AUTH_SRV_NONCE_EXPIRY;
+    setting->nc_table_size = PJSIP_AUTH_SRV_NC_TABLE_SIZE;
+}
+
+
+/*
+ * Enable the cache for server authentication.
+ */
+PJ_DEF(pj_status_t) pjsip_auth_srv_set_cache(
+				    pjsip_auth_srv *auth_srv,
+				    pj_pool_t *pool,
+				    const pjsip_auth_srv_cache_setting *setting)
+{
+    pjsip_auth_srv_cache *cache;
+    pj_status_t status;
+    unsigned i;
+
+    PJ_ASSERT_RETURN(auth_srv && pool, PJ_EINVAL);
+    PJ_ASSERT_RETURN(auth_srv->cache == NULL, PJ_EINVALIDOP);
+
+    cache = PJ_POOL_ZALLOC_T(pool, pjsip_auth_srv_cache);
+    if (setting)
+	pj_memcpy(&cache->setting, setting, sizeof(*setting));
+    else
+	pjsip_auth_srv_cache_setting_default(&cache->setting);
+
+    /* Nonce key */
+    if (cache->setting.nonce_key.slen) {
+	pj_md5_context ctx;
+
+	/* Keys longer than MD5 block are hashed anyway, so just keep the
+	 * hash of the key.
+	 */
+	pj_md5_init(&ctx);
+	pj_md5_update(&ctx, (pj_uint8_t*)cache->setting.nonce_key.ptr,
+		      (unsigned)cache->setting.nonce_key.slen);
+	pj_md5_final(&ctx, cache->key);
+	cache->key_len = 16;
     } else {
-	status = (*auth_srv->lookup)(rdata->tp_info.pool, &auth_srv->realm,
-				     &acc_name, &cred_info);
+	status = create_nonce_key(pool, cache->key, sizeof(cache->key));
 	if (status != PJ_SUCCESS) {
-	    *status_code = PJSIP_SC_FORBIDDEN;
+	    PJ_PERROR(1,(THIS_FILE, status,
+			 "Unable to create random nonce key, nonce_key "
+			 "must be specified in the setting"));
 	    return status;
 	}
+	cache->key_len = sizeof(cache->key);
+    }
+    cache->setting.nonce_key.slen = 0;
+
+    /* Credential cache */
+    pj_list_init(&cache->cred_lru);
+    pj_list_init(&cache->cred_free);
+    if (cache->setting.cred_count) {
+	cred_entry *entries;
+
+	cache->cred_table = pj_hash_create(pool, cache->setting.cred_count);
+	entries = (cred_entry*) pj_pool_calloc(pool, cache->setting.cred_count,
+					       sizeof(cred_entry));
+	for (i=0; i<cache->setting.cred_count; ++i)
+	    pj_list_push_back(&cache->cred_free, &entries[i]);
     }
 
-    /* Authenticate with the specified credential. */
-    status = pjsip_auth_verify(h_auth, &msg->line.req.method.name, 
-			       &cred_info);
-    if (status != PJ_SUCCESS) {
-	*status_code = PJSIP_SC_FORBIDDEN;
+    /* Nonce-count table */
+    if (cache->setting.nc_table_size) {
+	cache->nc_table = (nc_entry*)
+			  pj_pool_calloc(pool, cache->setting.nc_table_size,
+					 sizeof(nc_entry));
     }
-    return status;
+
+    status = pj_lock_create_simple_mutex(pool, "authsrv", &cache->lock);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    auth_srv->cache = cache;
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Remove cached credential.
+ */
+PJ_DEF(void) pjsip_auth_srv_cache_invalidate(pjsip_auth_srv *auth_srv,
+					     const pj_str_t *acc_name)
+{
+    pjsip_auth_srv_cache *cache = auth_srv->cache;
+
+    if (!cache || !cache->cred_table)
+	return;
+
+    pj_lock_acquire(cache->lock);
+    if (acc_name) {
+	cred_entry *e = find_cred(cache, acc_name);
+	if (e)
+	    remove_cred(cache, e);
+    } else {
+	while (!pj_list_empty(&cache->cred_lru))
+	    remove_cred(cache, cache->cred_lru.next);
+    }
+    pj_lock_release(cache->lock);
+}
+
+
+/*
+ * Release the resources of server authentication.
+ */
+PJ_DEF(pj_status_t) pjsip_auth_srv_deinit(pjsip_auth_srv *auth_srv)
+{
+    PJ_ASSERT_RETURN(auth_srv, PJ_EINVAL);
+
+    if (auth_srv->cache) {
+	pj_lock_destroy(auth_srv->cache->lock);
+	auth_srv->cache = NULL;
+    }
+
+    return PJ_SUCCESS;
 }
 
 
@@ -235,6 +884,15 @@ PJ_DEF(pj_status_t) pjsip_auth_srv_challenge(  pjsip_auth_srv *auth_srv,
     hdr->challenge.digest.algorithm = pjsip_MD5_STR;
     if (nonce) {
 	pj_strdup(tdata->pool, &hdr->challenge.digest.nonce, nonce);
+    } else if (auth_srv->cache) {
+	pj_time_val now;
+	char *buf = (char*) pj_pool_alloc(tdata->pool, NONCE_LEN);
+
+	pj_gettimeofday(&now);
+	create_nonce(auth_srv->cache, &auth_srv->realm, (pj_uint32_t)now.sec,
+		     buf);
+	hdr->challenge.digest.nonce.ptr = buf;
+	hdr->challenge.digest.nonce.slen = NONCE_LEN;
     } else {
 	pj_create_random_string(nonce_buf, sizeof(nonce_buf));
 	pj_strdup(tdata->pool, &hdr->challenge.digest.nonce, &random);
@@ -33,7 +33,10 @@ pjsip_cfg_t pjsip_sip_cfg_var =
        PJSIP_DONT_SWITCH_TO_TLS,
        PJSIP_FOLLOW_EARLY_MEDIA_FORK,
        PJSIP_REQ_HAS_VIA_ALIAS,
-       PJSIP_RESOLVE_HOSTNAME_TO_GET_INTERFACE
+       PJSIP_RESOLVE_HOSTNAME_TO_GET_INTERFACE,
+       PJSIP_RESOLVE_AAAA,
+       PJSIP_TP_RACE_DELAY,
+       PJSIP_RESOLVE_RTT_WEIGHT
     },
 
     /* Transaction settings */
@@ -42,12 +45,18 @@ pjsip_cfg_t pjsip_sip_cfg_var =
        PJSIP_T1_TIMEOUT,
        PJSIP_T2_TIMEOUT,
        PJSIP_T4_TIMEOUT,
-       PJSIP_TD_TIMEOUT
+       PJSIP_TD_TIMEOUT,
+       PJSIP_TSX_ADAPTIVE_T1,
+       PJSIP_TSX_MIN_T1
     },
 
     /* Client registration client */
     {
-	PJSIP_REGISTER_CLIENT_CHECK_CONTACT
+	PJSIP_REGISTER_CLIENT_CHECK_CONTACT,
+	PJSIP_REGISTER_CLIENT_ADD_XUID_PARAM,
+	PJSIP_REGISTER_CLIENT_REFRESH_JITTER,
+	PJSIP_REGISTER_CLIENT_MAX_PENDING,
+	PJSIP_REGISTER_CLIENT_SHARE_AUTH
     }
 };
 
@@ -25,6 +25,7 @@
 #include <pjsip/sip_module.h>
 #include <pjsip/sip_util.h>
 #include <pjsip/sip_transaction.h>
+#include <pjsip/sip_private.h>
 #include <pj/assert.h>
 #include <pj/os.h>
 #include <pj/string.h>
@@ -73,9 +74,8 @@ static pj_status_t create_dialog( pjsip_user_agent *ua,
     if (!endpt)
 	return PJ_EINVALIDOP;
 
-    pool = pjsip_endpt_create_pool(endpt, "dlg%p",
-				   PJSIP_POOL_LEN_DIALOG,
-				   PJSIP_POOL_INC_DIALOG);
+    /* Dialog pools come from the user agent's slab, one per call. */
+    pool = pjsip_pool_slab_create_pool(pjsip_ua_get_dlg_slab(ua), "dlg%p");
     if (!pool)
 	return PJ_ENOMEM;
 
@@ -730,6 +730,284 @@ on_error:
 }
 
 
+/*
+ * Print one "<key> <value>\n" line of dialog record. The header is printed
+ * in full and the header name is then stripped.
+ */
+static pj_bool_t save_hdr_line(char **p, char *end, char key,
+			       const void *hdr)
+{
+    char *val;
+    int len;
+
+    if (end - *p < 4)
+	return PJ_FALSE;
+
+    len = pjsip_hdr_print_on((void*)hdr, *p+2, end - *p - 3);
+    if (len < 1)
+	return PJ_FALSE;
+
+    val = (char*)pj_memchr(*p+2, ':', len);
+    if (!val)
+	return PJ_FALSE;
+    for (++val; *val==' '; ++val)
+	;
+
+    len -= (int)(val - (*p+2));
+    pj_memmove(*p+2, val, len);
+    (*p)[0] = key;
+    (*p)[1] = ' ';
+    (*p)[len+2] = '\n';
+    *p += len + 3;
+    return PJ_TRUE;
+}
+
+
+/*
+ * Save dialog state into a record.
+ */
+PJ_DEF(pj_status_t) pjsip_dlg_save( pjsip_dialog *dlg,
+				    char *buf,
+				    pj_size_t size,
+				    pj_size_t *len)
+{
+    char *p = buf, *end = buf + size;
+    const pjsip_route_hdr *r;
+    int n;
+    pj_status_t status = PJ_ETOOSMALL;
+
+    PJ_ASSERT_RETURN(dlg && buf && len, PJ_EINVAL);
+    PJ_ASSERT_RETURN(dlg->state == PJSIP_DIALOG_STATE_ESTABLISHED,
+		     PJ_EINVALIDOP);
+
+    pjsip_dlg_inc_lock(dlg);
+
+    n = pj_ansi_snprintf(p, end-p, "D %d %d %d %d %d %d %d %d\nI %.*s\n",
+			 dlg->role, dlg->secure, dlg->uac_has_2xx,
+			 dlg->route_set_frozen,
+			 dlg->local.first_cseq, dlg->local.cseq,
+			 dlg->remote.first_cseq, dlg->remote.cseq,
+			 (int)dlg->call_id->id.slen, dlg->call_id->id.ptr);
+    if (n < 0 || n >= end-p)
+	goto on_return;
+    p += n;
+
+    if (!save_hdr_line(&p, end, 'L', dlg->local.info) ||
+	!save_hdr_line(&p, end, 'R', dlg->remote.info) ||
+	!save_hdr_line(&p, end, 'C', dlg->local.contact))
+    {
+	goto on_return;
+    }
+
+    if (end - p < 4)
+	goto on_return;
+    n = pjsip_uri_print(PJSIP_URI_IN_OTHER, dlg->target, p+2, end-p-3);
+    if (n < 1)
+	goto on_return;
+    p[0] = 'T';
+    p[1] = ' ';
+    p[n+2] = '\n';
+    p += n + 3;
+
+    for (r=dlg->route_set.next; r!=&dlg->route_set; r=r->next) {
+	if (!save_hdr_line(&p, end, 'O', r))
+	    goto on_return;
+    }
+
+    *len = p - buf;
+    status = PJ_SUCCESS;
+
+on_return:
+    pjsip_dlg_dec_lock(dlg);
+    return status;
+}
+
+
+/* Get next integer of the "D" line in dialog record */
+static int restore_next_int(char **p)
+{
+    pj_str_t s;
+
+    while (**p == ' ')
+	++*p;
+    s.ptr = *p;
+    while (**p && **p != ' ')
+	++*p;
+    s.slen = *p - s.ptr;
+    return (int)pj_strtol(&s);
+}
+
+
+/*
+ * Recreate dialog from record.
+ */
+PJ_DEF(pj_status_t) pjsip_dlg_restore( pjsip_user_agent *ua,
+				       const char *rec,
+				       pj_size_t len,
+				       pjsip_dialog **p_dlg)
+{
+    const pj_str_t HFROM = { "From", 4 };
+    const pj_str_t HROUTE = { "Route", 5 };
+    pjsip_dialog *dlg;
+    char *line, *end;
+    pj_bool_t has_dlg_info = PJ_FALSE;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(ua && rec && len && p_dlg, PJ_EINVAL);
+
+    status = create_dialog(ua, &dlg);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    pj_list_init(&dlg->route_set);
+
+    /* Parse a copy of the record, one NULL terminated line at a time */
+    line = (char*) pj_pool_alloc(dlg->pool, len + 1);
+    pj_memcpy(line, rec, len);
+    line[len] = '\0';
+
+    for (; *line; line = end + 1) {
+	char *val = line + 2;
+	pj_size_t vlen;
+	pjsip_hdr *hdr;
+
+	end = pj_ansi_strchr(line, '\n');
+	if (!end || end - line < 2) {
+	    status = PJ_EINVAL;
+	    goto on_error;
+	}
+	*end = '\0';
+	vlen = end - val;
+
+	switch (line[0]) {
+	case 'D':
+	    dlg->role = (pjsip_role_e) restore_next_int(&val);
+	    dlg->secure = restore_next_int(&val);
+	    dlg->uac_has_2xx = restore_next_int(&val);
+	    dlg->route_set_frozen = restore_next_int(&val);
+	    dlg->local.first_cseq = restore_next_int(&val);
+	    dlg->local.cseq = restore_next_int(&val);
+	    dlg->remote.first_cseq = restore_next_int(&val);
+	    dlg->remote.cseq = restore_next_int(&val);
+	    has_dlg_info = PJ_TRUE;
+	    break;
+	case 'I':
+	    dlg->call_id = pjsip_cid_hdr_create(dlg->pool);
+	    dlg->call_id->id = pj_str(val);
+	    break;
+	case 'L':
+	case 'R':
+	    hdr = (pjsip_hdr*) pjsip_parse_hdr(dlg->pool, &HFROM, val, vlen,
+					       NULL);
+	    if (!hdr) {
+		status = PJSIP_EINVALIDHDR;
+		goto on_error;
+	    }
+	    if (line[0] == 'L')
+		dlg->local.info = (pjsip_fromto_hdr*) hdr;
+	    else
+		dlg->remote.info = (pjsip_fromto_hdr*) hdr;
+	    break;
+	case 'C':
+	    dlg->local.contact = (pjsip_contact_hdr*)
+				 pjsip_parse_hdr(dlg->pool, &HCONTACT, val,
+						 vlen, NULL);
+	    if (!dlg->local.contact) {
+		status = PJSIP_EINVALIDURI;
+		goto on_error;
+	    }
+	    break;
+	case 'T':
+	    dlg->target = pjsip_parse_uri(dlg->pool, val, vlen, 0);
+	    if (!dlg->target) {
+		status = PJSIP_EINVALIDURI;
+		goto on_error;
+	    }
+	    break;
+	case 'O':
+	    hdr = (pjsip_hdr*) pjsip_parse_hdr(dlg->pool, &HROUTE, val, vlen,
+					       NULL);
+	    if (!hdr) {
+		status = PJSIP_EINVALIDHDR;
+		goto on_error;
+	    }
+	    pj_list_push_back(&dlg->route_set, hdr);
+	    break;
+	default:
+	    status = PJ_EINVAL;
+	    goto on_error;
+	}
+    }
+
+    if (!has_dlg_info || !dlg->call_id || !dlg->local.info ||
+	!dlg->remote.info || !dlg->local.contact || !dlg->target ||
+	dlg->local.info->tag.slen == 0)
+    {
+	status = PJ_EINVAL;
+	goto on_error;
+    }
+
+    /* Local party is the From header for UAC dialog and the To header
+     * for UAS dialog.
+     */
+    if (dlg->role == PJSIP_ROLE_UAC) {
+	pjsip_fromto_hdr_set_from(dlg->local.info);
+	pjsip_fromto_hdr_set_to(dlg->remote.info);
+    } else {
+	pjsip_fromto_hdr_set_to(dlg->local.info);
+	pjsip_fromto_hdr_set_from(dlg->remote.info);
+    }
+
+    /* Info strings and tag hashes */
+    dlg->local.info_str.ptr = (char*)
+			      pj_pool_alloc(dlg->pool, PJSIP_MAX_URL_SIZE);
+    dlg->local.info_str.slen = pjsip_uri_print(PJSIP_URI_IN_FROMTO_HDR,
+					       dlg->local.info->uri,
+					       dlg->local.info_str.ptr,
+					       PJSIP_MAX_URL_SIZE);
+    dlg->remote.info_str.ptr = (char*)
+			       pj_pool_alloc(dlg->pool, PJSIP_MAX_URL_SIZE);
+    dlg->remote.info_str.slen = pjsip_uri_print(PJSIP_URI_IN_FROMTO_HDR,
+						dlg->remote.info->uri,
+						dlg->remote.info_str.ptr,
+						PJSIP_MAX_URL_SIZE);
+    if (dlg->local.info_str.slen < 1 || dlg->remote.info_str.slen < 1) {
+	status = PJSIP_EURITOOLONG;
+	goto on_error;
+    }
+
+    dlg->local.tag_hval = pj_hash_calc_tolower(0, NULL,
+					       &dlg->local.info->tag);
+    dlg->remote.tag_hval = pj_hash_calc_tolower(0, NULL,
+						&dlg->remote.info->tag);
+
+    if (dlg->role == PJSIP_ROLE_UAC)
+	pjsip_target_set_add_uri(&dlg->target_set, dlg->pool, dlg->target, 0);
+
+    dlg->state = PJSIP_DIALOG_STATE_ESTABLISHED;
+
+    /* Init client authentication session. */
+    status = pjsip_auth_clt_init(&dlg->auth_sess, dlg->endpt,
+				 dlg->pool, 0);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    /* Register this dialog to user agent. */
+    status = pjsip_ua_register_dlg(ua, dlg);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    *p_dlg = dlg;
+
+    PJ_LOG(5,(dlg->obj_name, "Dialog restored"));
+    return PJ_SUCCESS;
+
+on_error:
+    destroy_dialog(dlg);
+    return status;
+}
+
+
 /*
  * Destroy dialog.
  */
@@ -2177,6 +2455,8 @@ PJ_DEF(pj_status_t) pjsip_dlg_set_remote_cap_hdr(
 				    const pjsip_generic_array_hdr *cap_hdr)
 {
     pjsip_generic_array_hdr *hdr;
+    pj_size_t hdr_size;
+    unsigned i;
 
     /* Check arguments. */
     PJ_ASSERT_RETURN(dlg && cap_hdr, PJ_EINVAL);
@@ -2189,7 +2469,6 @@ PJ_DEF(pj_status_t) pjsip_dlg_set_remote_cap_hdr(
 
     /* Quick compare if the capability is up to date */
     if (hdr && hdr->count == cap_hdr->count) {
-	unsigned i;
 	pj_bool_t uptodate = PJ_TRUE;
 
 	for (i=0; i<hdr->count; ++i) {
@@ -2208,10 +2487,21 @@ PJ_DEF(pj_status_t) pjsip_dlg_set_remote_cap_hdr(
     if (hdr)
 	pj_list_erase(hdr);
 
-    /* Add the new capability header */
-    hdr = (pjsip_generic_array_hdr*) pjsip_hdr_clone(dlg->pool, cap_hdr);
+    /* Add the new capability header. The header is kept for the lifetime
+     * of the dialog and never modified, so only allocate the used part of
+     * the values array, and share the common tokens.
+     */
+    hdr_size = sizeof(pjsip_generic_array_hdr) -
+	       (PJSIP_GENERIC_ARRAY_MAX_COUNT - cap_hdr->count) *
+	       sizeof(pj_str_t);
+    hdr = (pjsip_generic_array_hdr*) pj_pool_alloc(dlg->pool, hdr_size);
+    pj_memcpy(hdr, cap_hdr, hdr_size);
+    for (i=0; i<cap_hdr->count; ++i) {
+	pjsip_strdup_interned(dlg->pool, &hdr->values[i], &cap_hdr->values[i]);
+    }
     hdr->type = cap_hdr->type;
     pj_strdup(dlg->pool, &hdr->name, &cap_hdr->name);
+    hdr->sname = hdr->name;
     pj_list_push_back(&dlg->rem_cap_hdr, hdr);
 
     pjsip_dlg_dec_lock(dlg);
@@ -49,6 +49,26 @@ typedef struct exit_cb
 } exit_cb;
 
 
+/* Pool slab. The factory must be the first member, since the factory
+ * callbacks get back to the slab by casting the factory pointer.
+ */
+struct pjsip_pool_slab
+{
+    pj_pool_factory	 factory;	/**< Factory of the slab pools.	    */
+    pjsip_pool_slab	*next;		/**< Next slab in endpoint.	    */
+    pjsip_endpoint	*endpt;		/**< The endpoint.		    */
+    pj_mutex_t		*mutex;		/**< Protects the lists below.	    */
+    char		 name[PJ_MAX_OBJ_NAME]; /**< Slab/pool name.	    */
+    pj_size_t		 initial;	/**< Initial size of the pools.	    */
+    pj_size_t		 increment;	/**< Increment size of the pools.   */
+    unsigned		 per_call;	/**< Pools held by an idle call.    */
+    pj_list		 live_list;	/**< Pools in use.		    */
+    unsigned		 live_cnt;	/**< Number of pools in use.	    */
+    pj_list		 free_list;	/**< Recycled pools.		    */
+    unsigned		 free_cnt;	/**< Number of recycled pools.	    */
+};
+
+
 /**
  * The SIP endpoint.
  */
@@ -98,6 +118,9 @@ struct pjsip_endpoint
 
     /** List of exit callback. */
     exit_cb		 exit_cb_list;
+
+    /** Pool slabs. */
+    pjsip_pool_slab	*slab_list;
 };
 
 
@@ -120,6 +143,7 @@ static pj_status_t endpt_on_tx_msg( pjsip_endpoint *endpt,
 				    pjsip_tx_data *tdata );
 static pj_status_t unload_module(pjsip_endpoint *endpt,
 				 pjsip_module *mod);
+static void destroy_pool_slabs(pjsip_endpoint *endpt);
 
 /* Defined in sip_parser.c */
 void init_sip_parser(void);
@@ -619,6 +643,9 @@ PJ_DEF(void) pjsip_endpt_destroy(pjsip_endpoint *endpt)
 	ecb = ecb->next;
     }
 
+    /* Destroy pool slabs */
+    destroy_pool_slabs(endpt);
+
     /* Delete endpoint mutex. */
     pj_mutex_destroy(endpt->mutex);
 
@@ -694,6 +721,245 @@ PJ_DEF(void) pjsip_endpt_release_pool( pjsip_endpoint *endpt, pj_pool_t *pool )
 }
 
 
+#if !PJ_HAS_POOL_ALT_API
+/*
+ * Pool slab factory: create pool.
+ */
+static pj_pool_t* slab_create_pool(pj_pool_factory *pf,
+				   const char *name,
+				   pj_size_t initial_size,
+				   pj_size_t increment_sz,
+				   pj_pool_callback *callback)
+{
+    pjsip_pool_slab *slab = (pjsip_pool_slab*)pf;
+    pj_pool_t *pool;
+
+    /* Pools of other sizes, e.g. the group lock pool which is created
+     * from the factory of the object's pool, go to endpoint's factory.
+     */
+    if (initial_size != slab->initial || increment_sz != slab->increment) {
+	return pj_pool_create(slab->endpt->pf, name, initial_size,
+			      increment_sz, callback);
+    }
+
+    pj_mutex_lock(slab->mutex);
+
+    if (!pj_list_empty(&slab->free_list)) {
+	/* Reuse the most recently released pool */
+	pool = (pj_pool_t*) slab->free_list.next;
+	pj_list_erase(pool);
+	--slab->free_cnt;
+
+	pj_pool_init_int(pool, name, increment_sz, callback);
+
+    } else {
+	/* Allocate the first block with the exact size requested */
+	pool = pj_pool_create_int(pf, name, initial_size, increment_sz,
+				  callback);
+	if (!pool) {
+	    pj_mutex_unlock(slab->mutex);
+	    return NULL;
+	}
+    }
+
+    pj_list_insert_before(&slab->live_list, pool);
+    ++slab->live_cnt;
+
+    pj_mutex_unlock(slab->mutex);
+
+    return pool;
+}
+
+/*
+ * Pool slab factory: release pool.
+ */
+static void slab_release_pool(pj_pool_factory *pf, pj_pool_t *pool)
+{
+    pjsip_pool_slab *slab = (pjsip_pool_slab*)pf;
+
+    pj_mutex_lock(slab->mutex);
+
+    pj_list_erase(pool);
+    --slab->live_cnt;
+
+    if (slab->free_cnt < PJSIP_POOL_SLAB_MAX_CACHED) {
+	pj_pool_reset(pool);
+	pj_list_insert_after(&slab->free_list, pool);
+	++slab->free_cnt;
+    } else {
+	pj_pool_destroy_int(pool);
+    }
+
+    pj_mutex_unlock(slab->mutex);
+}
+
+/* Get memory held by the live pools of the slab. */
+static unsigned slab_get_usage(pjsip_pool_slab *slab, pj_size_t *capacity,
+			       pj_size_t *used, unsigned *free_cnt)
+{
+    pj_pool_t *pool;
+    unsigned live_cnt;
+
+    *capacity = *used = 0;
+
+    pj_mutex_lock(slab->mutex);
+
+    pool = (pj_pool_t*) slab->live_list.next;
+    while (pool != (pj_pool_t*) &slab->live_list) {
+	*capacity += pj_pool_get_capacity(pool);
+	*used += pj_pool_get_used_size(pool);
+	pool = pool->next;
+    }
+    live_cnt = slab->live_cnt;
+    *free_cnt = slab->free_cnt;
+
+    pj_mutex_unlock(slab->mutex);
+
+    return live_cnt;
+}
+
+/*
+ * Pool slab factory: dump status.
+ */
+static void slab_dump_status(pj_pool_factory *pf, pj_bool_t detail)
+{
+#if PJ_LOG_MAX_LEVEL >= 3
+    pjsip_pool_slab *slab = (pjsip_pool_slab*)pf;
+    pj_size_t capacity, used;
+    unsigned live_cnt, free_cnt;
+
+    PJ_UNUSED_ARG(detail);
+
+    live_cnt = slab_get_usage(slab, &capacity, &used, &free_cnt);
+
+    PJ_LOG(3,(THIS_FILE, " Slab %s: %u pools in use, capacity=%u, "
+	      "used_size=%u (%u bytes per pool), %u pools cached",
+	      slab->name, live_cnt, (unsigned)capacity, (unsigned)used,
+	      (unsigned)(live_cnt ? capacity / live_cnt : slab->initial),
+	      free_cnt));
+#else
+    PJ_UNUSED_ARG(pf);
+    PJ_UNUSED_ARG(detail);
+#endif
+}
+#endif	/* !PJ_HAS_POOL_ALT_API */
+
+/*
+ * Get or create pool slab.
+ */
+PJ_DEF(pj_status_t) pjsip_endpt_create_pool_slab(pjsip_endpoint *endpt,
+						 const char *name,
+						 pj_size_t initial,
+						 pj_size_t increment,
+						 unsigned per_call,
+						 pjsip_pool_slab **p_slab)
+{
+    pjsip_pool_slab *slab;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(endpt && name && p_slab, PJ_EINVAL);
+    PJ_ASSERT_RETURN(initial >= sizeof(pj_pool_t)+sizeof(pj_pool_block),
+		     PJ_EINVAL);
+
+    pj_mutex_lock(endpt->mutex);
+
+    for (slab=endpt->slab_list; slab; slab=slab->next) {
+	if (pj_ansi_strcmp(slab->name, name)==0 &&
+	    slab->initial == initial && slab->increment == increment)
+	{
+	    break;
+	}
+    }
+
+    if (slab == NULL) {
+	slab = PJ_POOL_ZALLOC_T(endpt->pool, pjsip_pool_slab);
+	slab->endpt = endpt;
+	pj_ansi_strncpy(slab->name, name, sizeof(slab->name));
+	slab->name[sizeof(slab->name)-1] = '\0';
+	slab->initial = initial;
+	slab->increment = increment;
+	slab->per_call = per_call;
+	pj_list_init(&slab->live_list);
+	pj_list_init(&slab->free_list);
+
+#if !PJ_HAS_POOL_ALT_API
+	pj_memcpy(&slab->factory.policy, &endpt->pf->policy,
+		  sizeof(slab->factory.policy));
+	slab->factory.create_pool = &slab_create_pool;
+	slab->factory.release_pool = &slab_release_pool;
+	slab->factory.dump_status = &slab_dump_status;
+#endif
+
+	status = pj_mutex_create_simple(endpt->pool, slab->name,
+					&slab->mutex);
+	if (status != PJ_SUCCESS) {
+	    pj_mutex_unlock(endpt->mutex);
+	    return status;
+	}
+
+	slab->next = endpt->slab_list;
+	endpt->slab_list = slab;
+    }
+
+    pj_mutex_unlock(endpt->mutex);
+
+    *p_slab = slab;
+    return PJ_SUCCESS;
+}
+
+/*
+ * Create pool from the slab.
+ */
+PJ_DEF(pj_pool_t*) pjsip_pool_slab_create_pool(pjsip_pool_slab *slab,
+					       const char *pool_name)
+{
+    pj_pool_t *pool;
+
+    PJ_ASSERT_RETURN(slab, NULL);
+
+    if (!pool_name)
+	pool_name = slab->name;
+
+#if !PJ_HAS_POOL_ALT_API
+    pool = pj_pool_create(&slab->factory, pool_name, slab->initial,
+			  slab->increment, &pool_callback);
+    if (!pool) {
+	PJ_LOG(4, (THIS_FILE, "Unable to create pool %s!", pool_name));
+    }
+#else
+    pool = pjsip_endpt_create_pool(slab->endpt, pool_name, slab->initial,
+				   slab->increment);
+#endif
+
+    return pool;
+}
+
+/* Destroy all pool slabs of the endpoint. */
+static void destroy_pool_slabs(pjsip_endpoint *endpt)
+{
+    pjsip_pool_slab *slab;
+
+    for (slab=endpt->slab_list; slab; slab=slab->next) {
+#if !PJ_HAS_POOL_ALT_API
+	while (!pj_list_empty(&slab->free_list)) {
+	    pj_pool_t *pool = (pj_pool_t*) slab->free_list.next;
+	    pj_list_erase(pool);
+	    pj_pool_destroy_int(pool);
+	}
+	slab->free_cnt = 0;
+
+	if (slab->live_cnt) {
+	    PJ_LOG(4,(THIS_FILE, "Slab %s still has %u pools in use",
+		      slab->name, slab->live_cnt));
+	}
+#endif
+	pj_mutex_destroy(slab->mutex);
+	slab->mutex = NULL;
+    }
+    endpt->slab_list = NULL;
+}
+
+
 PJ_DEF(pj_status_t) pjsip_endpt_handle_events2(pjsip_endpoint *endpt,
 					       const pj_time_val *max_timeout,
 					       unsigned *p_count)
@@ -1148,6 +1414,46 @@ PJ_DEF(void) pjsip_endpt_resolve( pjsip_endpoint *endpt,
     pjsip_resolve( endpt->resolver, pool, target, token, cb);
 }
 
+/*
+ * Update round-trip time estimate of a destination.
+ */
+PJ_DEF(void) pjsip_endpt_update_rtt( pjsip_endpoint *endpt,
+				     const pj_sockaddr *addr,
+				     int rtt_msec)
+{
+    pjsip_resolver_update_rtt(endpt->resolver, addr, rtt_msec);
+}
+
+/*
+ * Get round-trip time estimate of a destination.
+ */
+PJ_DEF(pj_status_t) pjsip_endpt_get_rtt( pjsip_endpoint *endpt,
+					 const pj_sockaddr *addr,
+					 unsigned *srtt_msec)
+{
+    return pjsip_resolver_get_rtt(endpt->resolver, addr, srtt_msec);
+}
+
+/*
+ * Get round-trip time statistics of a destination.
+ */
+PJ_DEF(pj_status_t) pjsip_endpt_get_rtt_info( pjsip_endpoint *endpt,
+					      const pj_sockaddr *addr,
+					      pjsip_rtt_info *info)
+{
+    return pjsip_resolver_get_rtt_info(endpt->resolver, addr, info);
+}
+
+/*
+ * Enumerate round-trip time statistics of all destinations.
+ */
+PJ_DEF(pj_status_t) pjsip_endpt_enum_rtt( pjsip_endpoint *endpt,
+					  unsigned *count,
+					  pjsip_rtt_info info[])
+{
+    return pjsip_resolver_enum_rtt(endpt->resolver, count, info);
+}
+
 /*
  * Get transport manager.
  */
@@ -1275,6 +1581,50 @@ PJ_DEF(void) pjsip_endpt_dump( pjsip_endpoint *endpt, pj_bool_t detail )
      */
     pjsip_tpmgr_dump_transports( endpt->transport_mgr );
 
+    /* Round-trip time estimates. */
+    if (detail) {
+	pjsip_rtt_info rtt[PJSIP_RESOLVE_RTT_TABLE_SIZE];
+	unsigned i, rtt_cnt = PJ_ARRAY_SIZE(rtt);
+
+	pjsip_resolver_enum_rtt(endpt->resolver, &rtt_cnt, rtt);
+	PJ_LOG(3, (THIS_FILE, " Round-trip time estimates: %u", rtt_cnt));
+	for (i=0; i<rtt_cnt; ++i) {
+	    char addr[PJ_INET6_ADDRSTRLEN+10];
+
+	    PJ_LOG(3, (THIS_FILE, "  %s: srtt=%ums rttvar=%ums rto=%ums "
+				  "samples=%u failures=%u age=%us",
+		       pj_sockaddr_print(&rtt[i].addr, addr, sizeof(addr), 3),
+		       rtt[i].srtt, rtt[i].rttvar, rtt[i].rto,
+		       rtt[i].sample_cnt, rtt[i].fail_cnt, rtt[i].age));
+	}
+    }
+
+    /* Pool slabs and the memory held by an idle call. */
+    if (endpt->slab_list) {
+	pjsip_pool_slab *slab;
+	pj_size_t call_size = 0;
+
+	for (slab=endpt->slab_list; slab; slab=slab->next) {
+#if !PJ_HAS_POOL_ALT_API
+	    pj_size_t capacity, used;
+	    unsigned live_cnt, free_cnt;
+
+	    slab_dump_status(&slab->factory, detail);
+
+	    live_cnt = slab_get_usage(slab, &capacity, &used, &free_cnt);
+	    call_size += slab->per_call *
+			 (live_cnt ? capacity / live_cnt : slab->initial);
+#else
+	    call_size += slab->per_call * slab->initial;
+#endif
+	}
+
+	if (call_size) {
+	    PJ_LOG(3, (THIS_FILE, " Memory per idle call: %u bytes",
+		       (unsigned)call_size));
+	}
+    }
+
     /* Timer. */
 #if PJ_TIMER_DEBUG
     pj_timer_heap_dump(endpt->timer_heap);
@@ -107,6 +107,8 @@ static const struct
     PJ_BUILD_ERR( PJSIP_EAUTHINNONCE,	   "Invalid nonce value in authentication challenge"),
     PJ_BUILD_ERR( PJSIP_EAUTHINAKACRED,	   "Invalid AKA credential"),
     PJ_BUILD_ERR( PJSIP_EAUTHNOCHAL,	   "No challenge is found"),
+    PJ_BUILD_ERR( PJSIP_EAUTHSTALENONCE,   "Nonce has expired"),
+    PJ_BUILD_ERR( PJSIP_EAUTHNCREPLAY,	   "Nonce count has been used before"),
 
     /* UA/dialog layer. */
     PJ_BUILD_ERR( PJSIP_EMISSINGTAG,	"Missing From/To tag parameter" ),
@@ -21,6 +21,7 @@
 #include <pjsip/sip_parser.h>
 #include <pjsip/print_util.h>
 #include <pjsip/sip_errno.h>
+#include <pjsip/sip_private.h>
 #include <pj/ctype.h>
 #include <pj/guid.h>
 #include <pj/string.h>
@@ -873,6 +874,11 @@ static pjsip_generic_array_hdr* pjsip_generic_array_hdr_clone( pj_pool_t *pool,
 static pjsip_generic_array_hdr* pjsip_generic_array_hdr_shallow_clone( pj_pool_t *pool, 
 						 const pjsip_generic_array_hdr *hdr);
 
+/* Size of generic array header with the specified number of values. */
+#define GENERIC_ARRAY_HDR_SIZE(cnt) \
+	    (sizeof(pjsip_generic_array_hdr) - \
+	     (PJSIP_GENERIC_ARRAY_MAX_COUNT - (cnt)) * sizeof(pj_str_t))
+
 static pjsip_hdr_vptr generic_array_hdr_vptr = 
 {
     (pjsip_hdr_clone_fptr) &pjsip_generic_array_hdr_clone,
@@ -932,9 +938,12 @@ static pjsip_generic_array_hdr* pjsip_generic_array_hdr_clone( pj_pool_t *pool,
     unsigned i;
     pjsip_generic_array_hdr *hdr = PJ_POOL_ALLOC_T(pool, pjsip_generic_array_hdr);
 
-    pj_memcpy(hdr, rhs, sizeof(*hdr));
+    /* Only copy the used part of the array, since the source may be a
+     * compact copy (see pjsip_dlg_set_remote_cap_hdr()).
+     */
+    pj_memcpy(hdr, rhs, GENERIC_ARRAY_HDR_SIZE(rhs->count));
     for (i=0; i<rhs->count; ++i) {
-	pj_strdup(pool, &hdr->values[i], &rhs->values[i]);
+	pjsip_strdup_interned(pool, &hdr->values[i], &rhs->values[i]);
     }
 
     return hdr;
@@ -945,7 +954,7 @@ static pjsip_generic_array_hdr* pjsip_generic_array_hdr_shallow_clone( pj_pool_t
 						 const pjsip_generic_array_hdr *rhs)
 {
     pjsip_generic_array_hdr *hdr = PJ_POOL_ALLOC_T(pool, pjsip_generic_array_hdr);
-    pj_memcpy(hdr, rhs, sizeof(*hdr));
+    pj_memcpy(hdr, rhs, GENERIC_ARRAY_HDR_SIZE(rhs->count));
     return hdr;
 }
 
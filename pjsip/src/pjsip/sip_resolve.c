@@ -26,7 +26,9 @@
 #include <pj/array.h>
 #include <pj/assert.h>
 #include <pj/ctype.h>
+#include <pj/lock.h>
 #include <pj/log.h>
+#include <pj/os.h>
 #include <pj/pool.h>
 #include <pj/rand.h>
 #include <pj/string.h>
@@ -36,6 +38,11 @@
 
 #define ADDR_MAX_COUNT	    8
 
+/* Round-trip time estimate that has not been updated for this long (in
+ * seconds) is considered unknown.
+ */
+#define RTT_MAX_AGE	    300
+
 struct naptr_target
 {
     pj_str_t		    res_type;	    /**< e.g. "_sip._udp"   */
@@ -49,12 +56,21 @@ struct query
 {
     char		    *objname;
 
+    pjsip_resolver_t	    *resolver;
     pj_dns_type		     query_type;
     void		    *token;
     pjsip_resolver_callback *cb;
     pj_dns_async_query	    *object;
+    pj_dns_async_query	    *object6;
     pj_status_t		     last_error;
 
+    /* Results of parallel DNS A and AAAA queries: */
+    unsigned		     pending;
+    unsigned		     addr_cnt;
+    pj_in_addr		     addr[ADDR_MAX_COUNT];
+    unsigned		     addr6_cnt;
+    pj_in6_addr		     addr6[ADDR_MAX_COUNT];
+
     /* Original request: */
     struct {
 	pjsip_host_info	     target;
@@ -67,9 +83,26 @@ struct query
 };
 
 
+/* Round-trip time estimate of a destination */
+struct rtt_entry
+{
+    pj_sockaddr		     addr;	    /**< Destination address.	    */
+    unsigned		     srtt;	    /**< Smoothed RTT, in msec.	    */
+    unsigned		     rttvar;	    /**< RTT variation, in msec.    */
+    unsigned		     rto;	    /**< Retransmission timeout.    */
+    unsigned		     sample_cnt;    /**< Number of RTT samples.	    */
+    unsigned		     fail_cnt;	    /**< Number of failures.	    */
+    pj_time_val		     last_update;   /**< Last update time.	    */
+};
+
 struct pjsip_resolver_t
 {
     pj_dns_resolver *res;
+    pj_lock_t	    *lock;
+
+    /* Round-trip time table: */
+    unsigned	     rtt_cnt;
+    struct rtt_entry rtt[PJSIP_RESOLVE_RTT_TABLE_SIZE];
 };
 
 
@@ -79,6 +112,9 @@ static void srv_resolver_cb(void *user_data,
 static void dns_a_callback(void *user_data,
 			   pj_status_t status,
 			   pj_dns_parsed_packet *response);
+static void dns_aaaa_callback(void *user_data,
+			      pj_status_t status,
+			      pj_dns_parsed_packet *response);
 
 
 /*
@@ -88,9 +124,15 @@ PJ_DEF(pj_status_t) pjsip_resolver_create( pj_pool_t *pool,
 					   pjsip_resolver_t **p_res)
 {
     pjsip_resolver_t *resolver;
+    pj_status_t status;
 
     PJ_ASSERT_RETURN(pool && p_res, PJ_EINVAL);
     resolver = PJ_POOL_ZALLOC_T(pool, pjsip_resolver_t);
+
+    status = pj_lock_create_simple_mutex(pool, "sipres%p", &resolver->lock);
+    if (status != PJ_SUCCESS)
+	return status;
+
     *p_res = resolver;
 
     return PJ_SUCCESS;
@@ -135,6 +177,327 @@ PJ_DEF(void) pjsip_resolver_destroy(pjsip_resolver_t *resolver)
 #endif
 	resolver->res = NULL;
     }
+
+    if (resolver->lock) {
+	pj_lock_destroy(resolver->lock);
+	resolver->lock = NULL;
+    }
+}
+
+
+/* Find round-trip time entry of the destination. Must be called with
+ * the resolver lock held.
+ */
+static struct rtt_entry *find_rtt(pjsip_resolver_t *resolver,
+				  const pj_sockaddr *addr)
+{
+    unsigned i;
+
+    for (i=0; i<resolver->rtt_cnt; ++i) {
+	if (pj_sockaddr_cmp(&resolver->rtt[i].addr, addr) == 0)
+	    return &resolver->rtt[i];
+    }
+
+    return NULL;
+}
+
+
+/* Clear the estimates of a round-trip time entry. */
+static void reset_rtt(struct rtt_entry *e)
+{
+    e->srtt = e->rttvar = e->rto = 0;
+    e->sample_cnt = e->fail_cnt = 0;
+}
+
+
+/* Copy round-trip time entry to public info. */
+static void get_rtt_info(const struct rtt_entry *e, const pj_time_val *now,
+			 pjsip_rtt_info *info)
+{
+    pj_sockaddr_cp(&info->addr, &e->addr);
+    info->srtt = e->srtt;
+    info->rttvar = e->rttvar;
+    info->rto = e->rto;
+    info->sample_cnt = e->sample_cnt;
+    info->fail_cnt = e->fail_cnt;
+    info->age = now->sec - e->last_update.sec;
+}
+
+
+/*
+ * Public API to update round-trip time estimate of a destination.
+ */
+PJ_DEF(void) pjsip_resolver_update_rtt(pjsip_resolver_t *resolver,
+				       const pj_sockaddr *addr,
+				       int rtt_msec)
+{
+    struct rtt_entry *e;
+    unsigned max_rtt = 64 * pjsip_cfg()->tsx.t1;
+    pj_time_val now;
+
+    PJ_ASSERT_ON_FAIL(resolver && addr, return);
+
+    pj_gettickcount(&now);
+    pj_lock_acquire(resolver->lock);
+
+    e = find_rtt(resolver, addr);
+    if (e == NULL) {
+	if (resolver->rtt_cnt < PJ_ARRAY_SIZE(resolver->rtt)) {
+	    e = &resolver->rtt[resolver->rtt_cnt++];
+	} else {
+	    /* Replace the entry that has not been updated for the longest
+	     * time.
+	     */
+	    unsigned i;
+
+	    e = &resolver->rtt[0];
+	    for (i=1; i<resolver->rtt_cnt; ++i) {
+		if (PJ_TIME_VAL_LT(resolver->rtt[i].last_update,
+				   e->last_update))
+		{
+		    e = &resolver->rtt[i];
+		}
+	    }
+	}
+	pj_sockaddr_cp(&e->addr, addr);
+	reset_rtt(e);
+    } else if (now.sec - e->last_update.sec > RTT_MAX_AGE) {
+	/* Start over with an old estimate */
+	reset_rtt(e);
+    }
+
+    if (rtt_msec >= 0) {
+	/* Smoothed round-trip time, round-trip time variation and
+	 * retransmission timeout as per RFC 6298.
+	 */
+	if (e->sample_cnt == 0) {
+	    e->srtt = rtt_msec;
+	    e->rttvar = rtt_msec / 2;
+	} else {
+	    unsigned delta = (e->srtt > (unsigned)rtt_msec) ?
+			     e->srtt - rtt_msec : rtt_msec - e->srtt;
+
+	    e->rttvar = (3 * e->rttvar + delta) / 4;
+	    e->srtt = (7 * e->srtt + rtt_msec) / 8;
+	}
+	e->rto = e->srtt + (e->rttvar ? 4 * e->rttvar : 1);
+	++e->sample_cnt;
+    } else {
+	/* Failure, penalize the destination by doubling the estimate.
+	 * The retransmission timeout is left alone: the transaction has
+	 * already backed off its own retransmissions, and the next sample
+	 * will tell whether the path has actually become slower.
+	 */
+	if (e->srtt == 0)
+	    e->srtt = 2 * pjsip_cfg()->tsx.t1;
+	else
+	    e->srtt *= 2;
+	++e->fail_cnt;
+    }
+
+    if (e->srtt < 1)
+	e->srtt = 1;
+    else if (e->srtt > max_rtt)
+	e->srtt = max_rtt;
+    if (e->rto > max_rtt)
+	e->rto = max_rtt;
+
+    e->last_update = now;
+
+    pj_lock_release(resolver->lock);
+}
+
+
+/*
+ * Public API to get round-trip time estimate of a destination.
+ */
+PJ_DEF(pj_status_t) pjsip_resolver_get_rtt(pjsip_resolver_t *resolver,
+					   const pj_sockaddr *addr,
+					   unsigned *srtt_msec)
+{
+    struct rtt_entry *e;
+    pj_time_val now;
+    pj_status_t status = PJ_ENOTFOUND;
+
+    PJ_ASSERT_RETURN(resolver && addr && srtt_msec, PJ_EINVAL);
+
+    pj_gettickcount(&now);
+    pj_lock_acquire(resolver->lock);
+
+    e = find_rtt(resolver, addr);
+    if (e && e->srtt && now.sec - e->last_update.sec <= RTT_MAX_AGE) {
+	*srtt_msec = e->srtt;
+	status = PJ_SUCCESS;
+    }
+
+    pj_lock_release(resolver->lock);
+
+    return status;
+}
+
+
+/*
+ * Public API to get the round-trip time statistics of a destination.
+ */
+PJ_DEF(pj_status_t) pjsip_resolver_get_rtt_info(pjsip_resolver_t *resolver,
+						const pj_sockaddr *addr,
+						pjsip_rtt_info *info)
+{
+    struct rtt_entry *e;
+    pj_time_val now;
+    pj_status_t status = PJ_ENOTFOUND;
+
+    PJ_ASSERT_RETURN(resolver && addr && info, PJ_EINVAL);
+
+    pj_gettickcount(&now);
+    pj_lock_acquire(resolver->lock);
+
+    e = find_rtt(resolver, addr);
+    if (e && e->srtt && now.sec - e->last_update.sec <= RTT_MAX_AGE) {
+	get_rtt_info(e, &now, info);
+	status = PJ_SUCCESS;
+    }
+
+    pj_lock_release(resolver->lock);
+
+    return status;
+}
+
+
+/*
+ * Public API to enumerate the round-trip time statistics of all
+ * destinations.
+ */
+PJ_DEF(pj_status_t) pjsip_resolver_enum_rtt(pjsip_resolver_t *resolver,
+					    unsigned *count,
+					    pjsip_rtt_info info[])
+{
+    pj_time_val now;
+    unsigned i, n = 0;
+
+    PJ_ASSERT_RETURN(resolver && count && (info || *count==0), PJ_EINVAL);
+
+    pj_gettickcount(&now);
+    pj_lock_acquire(resolver->lock);
+
+    for (i=0; i<resolver->rtt_cnt && n<*count; ++i) {
+	const struct rtt_entry *e = &resolver->rtt[i];
+
+	if (e->srtt && now.sec - e->last_update.sec <= RTT_MAX_AGE)
+	    get_rtt_info(e, &now, &info[n++]);
+    }
+
+    pj_lock_release(resolver->lock);
+
+    *count = n;
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Order server addresses with the same priority by their weight scaled
+ * with the inverse of the round-trip time, using the selection procedure
+ * of RFC 2782. Groups where no round-trip time is known are left as is.
+ */
+static void sort_by_rtt(pjsip_resolver_t *resolver,
+			pjsip_server_addresses *srv)
+{
+    unsigned start, end;
+
+    if (!pjsip_cfg()->endpt.rtt_weight || srv->count < 2)
+	return;
+
+    for (start=0; start < srv->count; start = end) {
+	unsigned rtt[PJSIP_MAX_RESOLVED_ADDRESSES];
+	unsigned w[PJSIP_MAX_RESOLVED_ADDRESSES];
+	unsigned i, known = 0, sum_rtt = 0, avg_rtt;
+
+	for (end=start; end < srv->count &&
+			srv->entry[end].priority == srv->entry[start].priority;
+	     ++end)
+	{
+	    if (pjsip_resolver_get_rtt(resolver, &srv->entry[end].addr,
+				       &rtt[end]) == PJ_SUCCESS)
+	    {
+		sum_rtt += rtt[end];
+		++known;
+	    } else {
+		rtt[end] = 0;
+	    }
+	}
+
+	if (end - start < 2 || known == 0)
+	    continue;
+
+	/* Destinations without estimate are assumed to be average */
+	avg_rtt = sum_rtt / known;
+	if (avg_rtt == 0)
+	    avg_rtt = 1;
+
+	for (i=start; i<end; ++i) {
+	    unsigned r = rtt[i] ? rtt[i] : avg_rtt;
+	    w[i] = (srv->entry[i].weight + 1) * 1000 / r;
+	    if (w[i] == 0)
+		w[i] = 1;
+	}
+
+	/* Pick the entries one by one, with probability proportional to
+	 * their weight.
+	 */
+	for (i=start; i<end-1; ++i) {
+	    unsigned j, total = 0, r;
+
+	    for (j=i; j<end; ++j)
+		total += w[j];
+
+	    r = pj_rand() % total;
+	    for (j=i; j<end-1; ++j) {
+		if (r < w[j])
+		    break;
+		r -= w[j];
+	    }
+
+	    if (j != i) {
+		unsigned tmp_w = w[i];
+		pj_uint8_t tmp[sizeof(srv->entry[0])];
+
+		pj_memcpy(tmp, &srv->entry[i], sizeof(srv->entry[0]));
+		pj_memcpy(&srv->entry[i], &srv->entry[j], sizeof(srv->entry[0]));
+		pj_memcpy(&srv->entry[j], tmp, sizeof(srv->entry[0]));
+		w[i] = w[j];
+		w[j] = tmp_w;
+	    }
+	}
+    }
+}
+
+
+/* Add server address entry, if there is still room. */
+static void add_server_entry(pjsip_server_addresses *srv,
+			     pjsip_transport_type_e type,
+			     unsigned priority,
+			     unsigned weight,
+			     int af,
+			     const void *ip,
+			     pj_uint16_t port)
+{
+    unsigned i = srv->count;
+
+    if (i >= PJ_ARRAY_SIZE(srv->entry))
+	return;
+
+    if (af == pj_AF_INET6())
+	type = (pjsip_transport_type_e)((int)type | PJSIP_TRANSPORT_IPV6);
+
+    srv->entry[i].type = type;
+    srv->entry[i].priority = priority;
+    srv->entry[i].weight = weight;
+    pj_sockaddr_init(af, &srv->entry[i].addr, NULL, port);
+    pj_memcpy(pj_sockaddr_get_addr(&srv->entry[i].addr), ip,
+	      pj_sockaddr_get_addr_len(&srv->entry[i].addr));
+    srv->entry[i].addr_len = pj_sockaddr_get_len(&srv->entry[i].addr);
+
+    ++srv->count;
 }
 
 /*
@@ -315,6 +678,7 @@ PJ_DEF(void) pjsip_resolve( pjsip_resolver_t *resolver,
     /* Build the query state */
     query = PJ_POOL_ZALLOC_T(pool, struct query);
     query->objname = THIS_FILE;
+    query->resolver = resolver;
     query->token = token;
     query->cb = cb;
     query->req.target = *target;
@@ -375,12 +739,24 @@ PJ_DEF(void) pjsip_resolve( pjsip_resolver_t *resolver,
 
     if (query->query_type == PJ_DNS_TYPE_SRV) {
 
+	unsigned option = PJ_DNS_SRV_FALLBACK_A;
+
+	if (pjsip_cfg()->endpt.resolve_aaaa)
+	    option |= PJ_DNS_SRV_RESOLVE_AAAA;
+
 	status = pj_dns_srv_resolve(&query->naptr[0].name,
 				    &query->naptr[0].res_type,
 				    query->req.def_port, pool, resolver->res,
-				    PJ_TRUE, query, &srv_resolver_cb, NULL);
+				    option, query, &srv_resolver_cb, NULL);
 
     } else if (query->query_type == PJ_DNS_TYPE_A) {
+	pj_bool_t has_aaaa = pjsip_cfg()->endpt.resolve_aaaa;
+
+	/* DNS A and AAAA queries are started in parallel. Set the number
+	 * of pending queries first since the callback may be called
+	 * immediately when the response is in the cache.
+	 */
+	query->pending = has_aaaa ? 2 : 1;
 
 	status = pj_dns_resolver_start_query(resolver->res, 
 					     &query->naptr[0].name,
@@ -388,6 +764,20 @@ PJ_DEF(void) pjsip_resolve( pjsip_resolver_t *resolver,
 					     &dns_a_callback,
     					     query, &query->object);
 
+	if (status == PJ_SUCCESS && has_aaaa) {
+	    pj_status_t status6;
+
+	    status6 = pj_dns_resolver_start_query(resolver->res, 
+						  &query->naptr[0].name,
+						  PJ_DNS_TYPE_AAAA, 0, 
+						  &dns_aaaa_callback,
+						  query, &query->object6);
+	    if (status6 != PJ_SUCCESS) {
+		/* Just continue with the DNS A query */
+		dns_aaaa_callback(query, status6, NULL);
+	    }
+	}
+
     } else {
 	pj_assert(!"Unexpected");
 	status = PJ_EBUG;
@@ -419,6 +809,46 @@ on_error:
 
 #if PJSIP_HAS_RESOLVER
 
+/*
+ * This is called when both DNS A and AAAA queries have completed.
+ */
+static void a_query_complete(struct query *query)
+{
+    pjsip_server_addresses srv;
+    unsigned i;
+
+    if (query->addr_cnt == 0 && query->addr6_cnt == 0) {
+	pj_status_t status = query->last_error;
+
+	if (status == PJ_SUCCESS)
+	    status = PJLIB_UTIL_EDNSNOANSWERREC;
+
+	/* Call the callback */
+	(*query->cb)(status, query->token, NULL);
+	return;
+    }
+
+    /* Build server addresses, alternating IPv6 and IPv4 addresses */
+    srv.count = 0;
+    for (i=0; i<query->addr_cnt || i<query->addr6_cnt; ++i) {
+	if (i < query->addr6_cnt) {
+	    add_server_entry(&srv, query->naptr[0].type, 0, 0, pj_AF_INET6(),
+			     &query->addr6[i],
+			     (pj_uint16_t)query->req.def_port);
+	}
+	if (i < query->addr_cnt) {
+	    add_server_entry(&srv, query->naptr[0].type, 0, 0, pj_AF_INET(),
+			     &query->addr[i],
+			     (pj_uint16_t)query->req.def_port);
+	}
+    }
+
+    sort_by_rtt(query->resolver, &srv);
+
+    /* Call the callback */
+    (*query->cb)(PJ_SUCCESS, query->token, &srv);
+}
+
 /* 
  * This callback is called when target is resolved with DNS A query.
  */
@@ -427,8 +857,8 @@ static void dns_a_callback(void *user_data,
 			   pj_dns_parsed_packet *pkt)
 {
     struct query *query = (struct query*) user_data;
-    pjsip_server_addresses srv;
     pj_dns_a_record rec;
+    pj_bool_t done;
     unsigned i;
 
     rec.addr_count = 0;
@@ -445,29 +875,67 @@ static void dns_a_callback(void *user_data,
 	pj_strerror(status, errmsg, sizeof(errmsg));
 	PJ_LOG(4,(query->objname, "DNS A record resolution failed: %s", 
 		  errmsg));
+    }
 
-	/* Call the callback */
-	(*query->cb)(status, query->token, NULL);
-	return;
+    pj_lock_acquire(query->resolver->lock);
+
+    query->object = NULL;
+    if (status != PJ_SUCCESS)
+	query->last_error = status;
+
+    for (i=0; i<rec.addr_count && query->addr_cnt < ADDR_MAX_COUNT; ++i)
+	query->addr[query->addr_cnt++] = rec.addr[i];
+
+    done = (--query->pending == 0);
+
+    pj_lock_release(query->resolver->lock);
+
+    if (done)
+	a_query_complete(query);
+}
+
+
+/* 
+ * This callback is called when target is resolved with DNS AAAA query.
+ */
+static void dns_aaaa_callback(void *user_data,
+			      pj_status_t status,
+			      pj_dns_parsed_packet *pkt)
+{
+    struct query *query = (struct query*) user_data;
+    pj_bool_t done;
+    unsigned i;
+
+    if (status != PJ_SUCCESS) {
+	char errmsg[PJ_ERR_MSG_SIZE];
+
+	/* Log error */
+	pj_strerror(status, errmsg, sizeof(errmsg));
+	PJ_LOG(5,(query->objname, "DNS AAAA record resolution failed: %s", 
+		  errmsg));
     }
 
-    /* Build server addresses and call callback */
-    srv.count = 0;
-    for (i=0; i<rec.addr_count; ++i) {
-	srv.entry[srv.count].type = query->naptr[0].type;
-	srv.entry[srv.count].priority = 0;
-	srv.entry[srv.count].weight = 0;
-	srv.entry[srv.count].addr_len = sizeof(pj_sockaddr_in);
-	pj_sockaddr_in_init(&srv.entry[srv.count].addr.ipv4,
-			    0, (pj_uint16_t)query->req.def_port);
-	srv.entry[srv.count].addr.ipv4.sin_addr.s_addr =
-	    rec.addr[i].s_addr;
-
-	++srv.count;
+    pj_lock_acquire(query->resolver->lock);
+
+    query->object6 = NULL;
+
+    /* Any CNAME records have been followed by the nameserver, so take
+     * all AAAA records in the answer.
+     */
+    for (i=0; status==PJ_SUCCESS && i<pkt->hdr.anscount &&
+	      query->addr6_cnt < ADDR_MAX_COUNT; ++i)
+    {
+	if (pkt->ans[i].type == PJ_DNS_TYPE_AAAA) {
+	    query->addr6[query->addr6_cnt++] = pkt->ans[i].rdata.aaaa.ip_addr;
+	}
     }
 
-    /* Call the callback */
-    (*query->cb)(PJ_SUCCESS, query->token, &srv);
+    done = (--query->pending == 0);
+
+    pj_lock_release(query->resolver->lock);
+
+    if (done)
+	a_query_complete(query);
 }
 
 
@@ -493,25 +961,35 @@ static void srv_resolver_cb(void *user_data,
 	return;
     }
 
-    /* Build server addresses and call callback */
+    /* Build server addresses and call callback. IPv6 and IPv4 addresses
+     * of each target are alternated, starting with IPv6.
+     */
     srv.count = 0;
     for (i=0; i<rec->count; ++i) {
 	unsigned j;
 
-	for (j=0; j<rec->entry[i].server.addr_count; ++j) {
-	    srv.entry[srv.count].type = query->naptr[0].type;
-	    srv.entry[srv.count].priority = rec->entry[i].priority;
-	    srv.entry[srv.count].weight = rec->entry[i].weight;
-	    srv.entry[srv.count].addr_len = sizeof(pj_sockaddr_in);
-	    pj_sockaddr_in_init(&srv.entry[srv.count].addr.ipv4,
-				0, (pj_uint16_t)rec->entry[i].port);
-	    srv.entry[srv.count].addr.ipv4.sin_addr.s_addr =
-		rec->entry[i].server.addr[j].s_addr;
-
-	    ++srv.count;
+	for (j=0; j<rec->entry[i].server.addr_count ||
+		  j<rec->entry[i].addr6_count; ++j)
+	{
+	    if (j < rec->entry[i].addr6_count) {
+		add_server_entry(&srv, query->naptr[0].type,
+				 rec->entry[i].priority,
+				 rec->entry[i].weight,
+				 pj_AF_INET6(), &rec->entry[i].addr6[j],
+				 (pj_uint16_t)rec->entry[i].port);
+	    }
+	    if (j < rec->entry[i].server.addr_count) {
+		add_server_entry(&srv, query->naptr[0].type,
+				 rec->entry[i].priority,
+				 rec->entry[i].weight,
+				 pj_AF_INET(), &rec->entry[i].server.addr[j],
+				 (pj_uint16_t)rec->entry[i].port);
+	    }
 	}
     }
 
+    sort_by_rtt(query->resolver, &srv);
+
     /* Call the callback */
     (*query->cb)(PJ_SUCCESS, query->token, &srv);
 }
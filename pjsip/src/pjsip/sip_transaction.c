@@ -24,6 +24,7 @@
 #include <pjsip/sip_errno.h>
 #include <pjsip/sip_event.h>
 #include <pjlib-util/errno.h>
+#include <pj/ctype.h>
 #include <pj/hash.h>
 #include <pj/pool.h>
 #include <pj/os.h>
@@ -75,6 +76,7 @@ static struct mod_tsx_layer
     pjsip_endpoint	*endpt;
     pj_mutex_t		*mutex;
     pj_hash_table_t	*htable;
+    pjsip_pool_slab	*slab;
 } mod_tsx_layer = 
 {   {
 	NULL, NULL,			/* List's prev and next.    */
@@ -122,8 +124,6 @@ enum
 };
 
 /* Timer timeout value constants */
-static pj_time_val t1_timer_val = { PJSIP_T1_TIMEOUT/1000, 
-                                    PJSIP_T1_TIMEOUT%1000 };
 static pj_time_val t2_timer_val = { PJSIP_T2_TIMEOUT/1000, 
                                     PJSIP_T2_TIMEOUT%1000 };
 static pj_time_val t4_timer_val = { PJSIP_T4_TIMEOUT/1000, 
@@ -241,105 +241,131 @@ PJ_DEF(const char *) pjsip_role_name(pjsip_role_e role)
 
 
 /*
- * Create transaction key for RFC2543 compliant messages, which don't have
- * unique branch parameter in the top most Via header.
+ * Transaction key.
  *
- * INVITE requests matches a transaction if the following attributes
- * match the original request:
- *	- Request-URI
- *	- To tag
- *	- From tag
- *	- Call-ID
- *	- CSeq
- *	- top Via header
+ * The key is a binary string made of the fixed size header below, followed
+ * by the method name for methods other than INVITE/ACK, then by:
+ *  - the branch parameter of the top Via, for messages from RFC 3261
+ *    compliant agents, or
+ *  - the From tag, Call-ID and sent-by host of the top Via for RFC 2543
+ *    messages, which don't have unique branch parameter. INVITE requests
+ *    match a transaction if the Request-URI, To tag, From tag, Call-ID,
+ *    CSeq and top Via match the original request. CANCEL and ACK match
+ *    similarly, except that the CSeq method differs and the To tag is not
+ *    matched (CANCEL) or is matched to the response sent by the server
+ *    transaction (ACK). The key is made of the common components, and
+ *    additional comparison is needed to fully match a transaction.
  *
- * CANCEL matching is done similarly as INVITE, except:
- *	- CSeq method will differ
- *	- To tag is not matched.
- *
- * ACK matching is done similarly, except that:
- *	- method of the CSeq will differ,
- *	- To tag is matched to the response sent by the server transaction.
- *
- * The transaction key is constructed from the common components of above
- * components. Additional comparison is needed to fully match a transaction.
+ * The variable part is lowercased when the key is built, so that the keys
+ * are hashed and compared as binary in the hash table. ACK is keyed as
+ * INVITE so that it matches the INVITE transaction.
  */
-static pj_status_t create_tsx_key_2543( pj_pool_t *pool,
-			                pj_str_t *str,
-			                pjsip_role_e role,
-			                const pjsip_method *method,
-			                const pjsip_rx_data *rdata )
-{
-#define SEPARATOR   '$'
-    char *key, *p;
-    pj_ssize_t len;
-    pj_size_t len_required;
-    pj_str_t *host;
-
-    PJ_ASSERT_RETURN(pool && str && method && rdata, PJ_EINVAL);
-    PJ_ASSERT_RETURN(rdata->msg_info.msg, PJ_EINVAL);
-    PJ_ASSERT_RETURN(rdata->msg_info.via, PJSIP_EMISSINGHDR);
-    PJ_ASSERT_RETURN(rdata->msg_info.cseq, PJSIP_EMISSINGHDR);
-    PJ_ASSERT_RETURN(rdata->msg_info.from, PJSIP_EMISSINGHDR);
-
-    host = &rdata->msg_info.via->sent_by.host;
-
-    /* Calculate length required. */
-    len_required = 9 +			    /* CSeq number */
-		   rdata->msg_info.from->tag.slen +   /* From tag. */
-		   rdata->msg_info.cid->id.slen +    /* Call-ID */
-		   host->slen +		    /* Via host. */
-		   9 +			    /* Via port. */
-		   16;			    /* Separator+Allowance. */
-    key = p = (char*) pj_pool_alloc(pool, len_required);
-
-    /* Add role. */
-    *p++ = (char)(role==PJSIP_ROLE_UAC ? 'c' : 's');
-    *p++ = SEPARATOR;
-
-    /* Add method, except when method is INVITE or ACK. */
-    if (method->id != PJSIP_INVITE_METHOD && method->id != PJSIP_ACK_METHOD) {
-	pj_memcpy(p, method->name.ptr, method->name.slen);
-	p += method->name.slen;
-	*p++ = '$';
-    }
-
-    /* Add CSeq (only the number). */
-    len = pj_utoa(rdata->msg_info.cseq->cseq, p);
-    p += len;
-    *p++ = SEPARATOR;
-
-    /* Add From tag. */
-    len = rdata->msg_info.from->tag.slen;
-    pj_memcpy( p, rdata->msg_info.from->tag.ptr, len);
-    p += len;
-    *p++ = SEPARATOR;
-
-    /* Add Call-ID. */
-    len = rdata->msg_info.cid->id.slen;
-    pj_memcpy( p, rdata->msg_info.cid->id.ptr, len );
-    p += len;
-    *p++ = SEPARATOR;
-
-    /* Add top Via header. 
-     * We don't really care whether the port contains the real port (because
-     * it can be omited if default port is used). Anyway this function is 
-     * only used to match request retransmission, and we expect that the 
-     * request retransmissions will contain the same port.
-     */
-    pj_memcpy(p, host->ptr, host->slen);
-    p += host->slen;
-    *p++ = ':';
+typedef struct tsx_key_hdr
+{
+    char	 role;		/**< 'c' for UAC or 's' for UAS.	    */
+    char	 rfc;		/**< '3' for RFC 3261 or '2' for RFC 2543.  */
+    pj_uint16_t	 method_id;	/**< Method id.				    */
+    pj_uint16_t	 method_len;	/**< Method name length, other methods.	    */
+    pj_uint16_t	 port;		/**< Via sent-by port (RFC 2543).	    */
+    pj_uint32_t	 cseq;		/**< CSeq number (RFC 2543).		    */
+    pj_uint16_t	 tag_len;	/**< From tag length (RFC 2543).	    */
+    pj_uint16_t	 cid_len;	/**< Call-ID length (RFC 2543).		    */
+} tsx_key_hdr;
+
+/* Size of stack buffer to build the key of incoming messages. Keys that
+ * don't fit are allocated from the rdata pool.
+ */
+#define TSX_KEY_BUF_LEN	    256
 
-    len = pj_utoa(rdata->msg_info.via->sent_by.port, p);
-    p += len;
-    *p++ = SEPARATOR;
-    
-    *p++ = '\0';
+/* Printable part of the key, for logging. */
+#define TSX_KEY_INFO_LEN(key)	((int)((key)->slen - sizeof(tsx_key_hdr)))
+#define TSX_KEY_INFO(key)	((key)->ptr + sizeof(tsx_key_hdr))
+
+/* Append lowercased string to the key. */
+static char *tsx_key_add(char *p, const pj_str_t *str)
+{
+    const char *src = str->ptr, *end = str->ptr + str->slen;
+
+    while (src != end)
+	*p++ = (char)pj_tolower(*src++);
+
+    return p;
+}
+
+/*
+ * Build transaction key into buf, or into memory allocated from the pool
+ * if buf is NULL or too small. The RFC 3261 key is built when branch is
+ * specified, otherwise the RFC 2543 key is built from rdata.
+ */
+static pj_status_t build_tsx_key( pj_pool_t *pool,
+				  char *buf,
+				  pj_size_t buf_len,
+				  pj_str_t *key,
+				  pjsip_role_e role,
+				  const pjsip_method *method,
+				  const pj_str_t *branch,
+				  const pjsip_rx_data *rdata )
+{
+    tsx_key_hdr hdr;
+    const pj_str_t *host = NULL;
+    pj_size_t len;
+    char *p;
+
+    pj_bzero(&hdr, sizeof(hdr));
+    hdr.role = (char)(role==PJSIP_ROLE_UAC ? 'c' : 's');
+    hdr.method_id = (pj_uint16_t)(method->id==PJSIP_ACK_METHOD ?
+				  PJSIP_INVITE_METHOD : method->id);
+    if (method->id == PJSIP_OTHER_METHOD)
+	hdr.method_len = (pj_uint16_t)method->name.slen;
+
+    len = sizeof(hdr) + hdr.method_len;
+
+    if (branch) {
+	hdr.rfc = '3';
+	len += branch->slen;
+    } else {
+	PJ_ASSERT_RETURN(rdata->msg_info.msg, PJ_EINVAL);
+	PJ_ASSERT_RETURN(rdata->msg_info.via, PJSIP_EMISSINGHDR);
+	PJ_ASSERT_RETURN(rdata->msg_info.cseq, PJSIP_EMISSINGHDR);
+	PJ_ASSERT_RETURN(rdata->msg_info.from, PJSIP_EMISSINGHDR);
+	PJ_ASSERT_RETURN(rdata->msg_info.cid, PJSIP_EMISSINGHDR);
+
+	host = &rdata->msg_info.via->sent_by.host;
+
+	hdr.rfc = '2';
+	hdr.cseq = (pj_uint32_t)rdata->msg_info.cseq->cseq;
+	/* We don't really care whether the port contains the real port
+	 * (because it can be omited if default port is used). Anyway this
+	 * key is only used to match request retransmission, and we expect
+	 * that the request retransmissions will contain the same port.
+	 */
+	hdr.port = (pj_uint16_t)rdata->msg_info.via->sent_by.port;
+	hdr.tag_len = (pj_uint16_t)rdata->msg_info.from->tag.slen;
+	hdr.cid_len = (pj_uint16_t)rdata->msg_info.cid->id.slen;
+	len += hdr.tag_len + hdr.cid_len + host->slen;
+    }
+
+    if (buf == NULL || len > buf_len) {
+	PJ_ASSERT_RETURN(pool, PJ_EINVAL);
+	buf = (char*) pj_pool_alloc(pool, len);
+    }
+
+    pj_memcpy(buf, &hdr, sizeof(hdr));
+    p = buf + sizeof(hdr);
 
-    /* Done. */
-    str->ptr = key;
-    str->slen = p-key;
+    if (hdr.method_len)
+	p = tsx_key_add(p, &method->name);
+
+    if (branch) {
+	p = tsx_key_add(p, branch);
+    } else {
+	p = tsx_key_add(p, &rdata->msg_info.from->tag);
+	p = tsx_key_add(p, &rdata->msg_info.cid->id);
+	p = tsx_key_add(p, host);
+    }
+
+    key->ptr = buf;
+    key->slen = p - buf;
 
     return PJ_SUCCESS;
 }
@@ -353,58 +379,41 @@ static pj_status_t create_tsx_key_3261( pj_pool_t *pool,
 		                        const pjsip_method *method,
 		                        const pj_str_t *branch)
 {
-    char *p;
-
     PJ_ASSERT_RETURN(pool && key && method && branch, PJ_EINVAL);
 
-    p = key->ptr = (char*) 
-    		   pj_pool_alloc(pool, branch->slen + method->name.slen + 4 );
-    
-    /* Add role. */
-    *p++ = (char)(role==PJSIP_ROLE_UAC ? 'c' : 's');
-    *p++ = SEPARATOR;
-
-    /* Add method, except when method is INVITE or ACK. */
-    if (method->id != PJSIP_INVITE_METHOD && method->id != PJSIP_ACK_METHOD) {
-	pj_memcpy(p, method->name.ptr, method->name.slen);
-	p += method->name.slen;
-	*p++ = '$';
-    }
-
-    /* Add branch ID. */
-    pj_memcpy(p, branch->ptr, branch->slen);
-    p += branch->slen;
-
-    /* Set length */
-    key->slen = p - key->ptr;
-
-    return PJ_SUCCESS;
+    return build_tsx_key(pool, NULL, 0, key, role, method, branch, NULL);
 }
 
 /*
- * Create key from the incoming data, to be used to search the transaction
- * in the transaction hash table.
+ * Build the key of incoming message into buf (see build_tsx_key()).
  */
-PJ_DEF(pj_status_t) pjsip_tsx_create_key( pj_pool_t *pool, pj_str_t *key, 
-				          pjsip_role_e role, 
-				          const pjsip_method *method, 
-				          const pjsip_rx_data *rdata)
+static pj_status_t create_rx_tsx_key( pj_pool_t *pool,
+				      char *buf,
+				      pj_size_t buf_len,
+				      pj_str_t *key,
+				      pjsip_role_e role,
+				      const pjsip_method *method,
+				      const pjsip_rx_data *rdata)
 {
     pj_str_t rfc3261_branch = {PJSIP_RFC3261_BRANCH_ID, 
                                PJSIP_RFC3261_BRANCH_LEN};
+    const pj_str_t *branch;
 
+    PJ_ASSERT_RETURN(key && method && rdata, PJ_EINVAL);
+    PJ_ASSERT_RETURN(rdata->msg_info.via, PJSIP_EMISSINGHDR);
 
     /* Get the branch parameter in the top-most Via.
      * If branch parameter is started with "z9hG4bK", then the message was
      * generated by agent compliant with RFC3261. Otherwise, it will be
      * handled as RFC2543.
      */
-    const pj_str_t *branch = &rdata->msg_info.via->branch_param;
+    branch = &rdata->msg_info.via->branch_param;
 
     if (pj_strnicmp(branch,&rfc3261_branch,PJSIP_RFC3261_BRANCH_LEN)==0) {
 
 	/* Create transaction key. */
-	return create_tsx_key_3261(pool, key, role, method, branch);
+	return build_tsx_key(pool, buf, buf_len, key, role, method,
+			     branch, NULL);
 
     } else {
 	/* Create the key for the message. This key will be matched up 
@@ -412,10 +421,25 @@ PJ_DEF(pj_status_t) pjsip_tsx_create_key( pj_pool_t *pool, pj_str_t *key,
          * transaction key was created by the same function, so it will 
          * match the message.
 	 */
-	return create_tsx_key_2543( pool, key, role, method, rdata );
+	return build_tsx_key(pool, buf, buf_len, key, role, method,
+			     NULL, rdata);
     }
 }
 
+/*
+ * Create key from the incoming data, to be used to search the transaction
+ * in the transaction hash table.
+ */
+PJ_DEF(pj_status_t) pjsip_tsx_create_key( pj_pool_t *pool, pj_str_t *key, 
+				          pjsip_role_e role, 
+				          const pjsip_method *method, 
+				          const pjsip_rx_data *rdata)
+{
+    PJ_ASSERT_RETURN(pool, PJ_EINVAL);
+
+    return create_rx_tsx_key(pool, NULL, 0, key, role, method, rdata);
+}
+
 /*****************************************************************************
  **
  ** Transaction layer module
@@ -434,8 +458,6 @@ PJ_DEF(pj_status_t) pjsip_tsx_layer_init_module(pjsip_endpoint *endpt)
     PJ_ASSERT_RETURN(mod_tsx_layer.endpt==NULL, PJ_EINVALIDOP);
 
     /* Initialize timer values */
-    t1_timer_val.sec  = pjsip_cfg()->tsx.t1 / 1000;
-    t1_timer_val.msec = pjsip_cfg()->tsx.t1 % 1000;
     t2_timer_val.sec  = pjsip_cfg()->tsx.t2 / 1000;
     t2_timer_val.msec = pjsip_cfg()->tsx.t2 % 1000;
     t4_timer_val.sec  = pjsip_cfg()->tsx.t4 / 1000;
@@ -480,6 +502,16 @@ PJ_DEF(pj_status_t) pjsip_tsx_layer_init_module(pjsip_endpoint *endpt)
 	return status;
     }
 
+    /* Get the slab for transaction pools. */
+    status = pjsip_endpt_create_pool_slab(endpt, "tsx", PJSIP_POOL_TSX_LEN,
+					  PJSIP_POOL_TSX_INC, 0,
+					  &mod_tsx_layer.slab);
+    if (status != PJ_SUCCESS) {
+	pj_mutex_destroy(mod_tsx_layer.mutex);
+	pjsip_endpt_release_pool(endpt, pool);
+	return status;
+    }
+
     /*
      * Register transaction layer module to endpoint.
      */
@@ -539,10 +571,10 @@ static pj_status_t mod_tsx_layer_register_tsx( pjsip_transaction *tsx)
      * Do not use PJ_ASSERT_RETURN since it evaluates the expression
      * twice!
      */
-    if(pj_hash_get_lower(mod_tsx_layer.htable, 
-		         tsx->transaction_key.ptr,
-		         (unsigned)tsx->transaction_key.slen, 
-		         NULL))
+    if(pj_hash_get(mod_tsx_layer.htable, 
+		   tsx->transaction_key.ptr,
+		   (unsigned)tsx->transaction_key.slen, 
+		   &tsx->hashed_key))
     {
 	pj_mutex_unlock(mod_tsx_layer.mutex);
 	PJ_LOG(2,(THIS_FILE, 
@@ -554,19 +586,19 @@ static pj_status_t mod_tsx_layer_register_tsx( pjsip_transaction *tsx)
 
     TSX_TRACE_((THIS_FILE, 
 		"Transaction %p registered with hkey=0x%p and key=%.*s",
-		tsx, tsx->hashed_key, tsx->transaction_key.slen,
-		tsx->transaction_key.ptr));
+		tsx, tsx->hashed_key, TSX_KEY_INFO_LEN(&tsx->transaction_key),
+		TSX_KEY_INFO(&tsx->transaction_key)));
 
     /* Register the transaction to the hash table. */
 #ifdef PRECALC_HASH
-    pj_hash_set_lower( tsx->pool, mod_tsx_layer.htable,
-                       tsx->transaction_key.ptr,
-    		       (unsigned)tsx->transaction_key.slen, 
-		       tsx->hashed_key, tsx);
+    pj_hash_set( tsx->pool, mod_tsx_layer.htable,
+                 tsx->transaction_key.ptr,
+    		 (unsigned)tsx->transaction_key.slen, 
+		 tsx->hashed_key, tsx);
 #else
-    pj_hash_set_lower( tsx->pool, mod_tsx_layer.htable,
-                       tsx->transaction_key.ptr,
-    		       tsx->transaction_key.slen, 0, tsx);
+    pj_hash_set( tsx->pool, mod_tsx_layer.htable,
+                 tsx->transaction_key.ptr,
+    		 (unsigned)tsx->transaction_key.slen, 0, tsx);
 #endif
 
     /* Unlock mutex. */
@@ -598,18 +630,18 @@ static void mod_tsx_layer_unregister_tsx( pjsip_transaction *tsx)
 
     /* Register the transaction to the hash table. */
 #ifdef PRECALC_HASH
-    pj_hash_set_lower( NULL, mod_tsx_layer.htable, tsx->transaction_key.ptr,
-    		       (unsigned)tsx->transaction_key.slen, tsx->hashed_key, 
-		       NULL);
+    pj_hash_set( NULL, mod_tsx_layer.htable, tsx->transaction_key.ptr,
+    		 (unsigned)tsx->transaction_key.slen, tsx->hashed_key, 
+		 NULL);
 #else
-    pj_hash_set_lower( NULL, mod_tsx_layer.htable, tsx->transaction_key.ptr,
-    		       tsx->transaction_key.slen, 0, NULL);
+    pj_hash_set( NULL, mod_tsx_layer.htable, tsx->transaction_key.ptr,
+    		 (unsigned)tsx->transaction_key.slen, 0, NULL);
 #endif
 
     TSX_TRACE_((THIS_FILE, 
 		"Transaction %p unregistered, hkey=0x%p and key=%.*s",
-		tsx, tsx->hashed_key, tsx->transaction_key.slen,
-		tsx->transaction_key.ptr));
+		tsx, tsx->hashed_key, TSX_KEY_INFO_LEN(&tsx->transaction_key),
+		TSX_KEY_INFO(&tsx->transaction_key)));
 
     /* Unlock mutex. */
     pj_mutex_unlock(mod_tsx_layer.mutex);
@@ -646,8 +678,8 @@ PJ_DEF(pjsip_transaction*) pjsip_tsx_layer_find_tsx( const pj_str_t *key,
 
     pj_mutex_lock(mod_tsx_layer.mutex);
     tsx = (pjsip_transaction*)
-    	  pj_hash_get_lower( mod_tsx_layer.htable, key->ptr, 
-			     (unsigned)key->slen, &hval );
+    	  pj_hash_get( mod_tsx_layer.htable, key->ptr, 
+		       (unsigned)key->slen, &hval );
     
     /* Prevent the transaction to get deleted before we have chance to lock it.
      */
@@ -658,7 +690,7 @@ PJ_DEF(pjsip_transaction*) pjsip_tsx_layer_find_tsx( const pj_str_t *key,
 
     TSX_TRACE_((THIS_FILE, 
 		"Finding tsx with hkey=0x%p and key=%.*s: found %p",
-		hval, key->slen, key->ptr, tsx));
+		hval, TSX_KEY_INFO_LEN(key), TSX_KEY_INFO(key), tsx));
 
     /* Simulate race condition! */
     PJ_RACE_ME(5);
@@ -735,8 +767,9 @@ static void tsx_layer_destroy(pjsip_endpoint *endpt)
     /* Release pool. */
     pjsip_endpt_release_pool(mod_tsx_layer.endpt, mod_tsx_layer.pool);
 
-    /* Mark as unregistered. */
+    /* Mark as unregistered. The slab belongs to the endpoint. */
     mod_tsx_layer.endpt = NULL;
+    mod_tsx_layer.slab = NULL;
 
     PJ_LOG(4,(THIS_FILE, "Transaction layer module destroyed"));
 }
@@ -774,24 +807,27 @@ static pj_status_t mod_tsx_layer_unload(void)
  */
 static pj_bool_t mod_tsx_layer_on_rx_request(pjsip_rx_data *rdata)
 {
+    char key_buf[TSX_KEY_BUF_LEN];
     pj_str_t key;
-    pj_uint32_t hval = 0;
+    pj_uint32_t hval;
     pjsip_transaction *tsx;
 
-    pjsip_tsx_create_key(rdata->tp_info.pool, &key, PJSIP_ROLE_UAS,
-			 &rdata->msg_info.cseq->method, rdata);
+    /* Build the key on the stack and hash it before taking the lock. */
+    create_rx_tsx_key(rdata->tp_info.pool, key_buf, sizeof(key_buf), &key,
+		      PJSIP_ROLE_UAS, &rdata->msg_info.cseq->method, rdata);
+    hval = pj_hash_calc(0, key.ptr, (unsigned)key.slen);
 
     /* Find transaction. */
     pj_mutex_lock( mod_tsx_layer.mutex );
 
     tsx = (pjsip_transaction*) 
-    	  pj_hash_get_lower( mod_tsx_layer.htable, key.ptr, (unsigned)key.slen, 
-			     &hval );
+    	  pj_hash_get( mod_tsx_layer.htable, key.ptr, (unsigned)key.slen, 
+		       &hval );
 
 
     TSX_TRACE_((THIS_FILE, 
 		"Finding tsx for request, hkey=0x%p and key=%.*s, found %p",
-		hval, key.slen, key.ptr, tsx));
+		hval, TSX_KEY_INFO_LEN(&key), TSX_KEY_INFO(&key), tsx));
 
 
     if (tsx == NULL || tsx->state == PJSIP_TSX_STATE_TERMINATED) {
@@ -828,24 +864,27 @@ static pj_bool_t mod_tsx_layer_on_rx_request(pjsip_rx_data *rdata)
  */
 static pj_bool_t mod_tsx_layer_on_rx_response(pjsip_rx_data *rdata)
 {
+    char key_buf[TSX_KEY_BUF_LEN];
     pj_str_t key;
-    pj_uint32_t hval = 0;
+    pj_uint32_t hval;
     pjsip_transaction *tsx;
 
-    pjsip_tsx_create_key(rdata->tp_info.pool, &key, PJSIP_ROLE_UAC,
-			 &rdata->msg_info.cseq->method, rdata);
+    /* Build the key on the stack and hash it before taking the lock. */
+    create_rx_tsx_key(rdata->tp_info.pool, key_buf, sizeof(key_buf), &key,
+		      PJSIP_ROLE_UAC, &rdata->msg_info.cseq->method, rdata);
+    hval = pj_hash_calc(0, key.ptr, (unsigned)key.slen);
 
     /* Find transaction. */
     pj_mutex_lock( mod_tsx_layer.mutex );
 
     tsx = (pjsip_transaction*) 
-    	  pj_hash_get_lower( mod_tsx_layer.htable, key.ptr, (unsigned)key.slen, 
-			     &hval );
+    	  pj_hash_get( mod_tsx_layer.htable, key.ptr, (unsigned)key.slen, 
+		       &hval );
 
 
     TSX_TRACE_((THIS_FILE, 
 		"Finding tsx for response, hkey=0x%p and key=%.*s, found %p",
-		hval, key.slen, key.ptr, tsx));
+		hval, TSX_KEY_INFO_LEN(&key), TSX_KEY_INFO(&key), tsx));
 
 
     if (tsx == NULL || tsx->state == PJSIP_TSX_STATE_TERMINATED) {
@@ -972,6 +1011,54 @@ static int tsx_cancel_timer(pjsip_transaction *tsx,
     return pj_timer_heap_cancel_if_active(timer_heap, entry, TIMER_INACTIVE);
 }
 
+/* Get T1 of the transaction, in msec. When adaptive T1 is enabled, this
+ * is the retransmission timeout measured to the destination bounded by
+ * min_t1 and T2. The value used for the first timer is kept for the life
+ * of the transaction, so that the retransmission schedule stays
+ * consistent.
+ */
+static unsigned tsx_get_t1(pjsip_transaction *tsx)
+{
+    pjsip_rtt_info info;
+    unsigned t1;
+
+    if (tsx->t1)
+	return tsx->t1;
+
+    t1 = pjsip_cfg()->tsx.t1;
+
+    if (pjsip_cfg()->tsx.adaptive_t1 && tsx->addr_len && !tsx->is_reliable &&
+	pjsip_endpt_get_rtt_info(tsx->endpt, &tsx->addr,
+				 &info) == PJ_SUCCESS && info.rto)
+    {
+	t1 = info.rto;
+	if (t1 < pjsip_cfg()->tsx.min_t1)
+	    t1 = pjsip_cfg()->tsx.min_t1;
+	if (t1 > pjsip_cfg()->tsx.t2)
+	    t1 = pjsip_cfg()->tsx.t2;
+
+	if (t1 != pjsip_cfg()->tsx.t1) {
+	    PJ_LOG(5,(tsx->obj_name, "Using adaptive T1=%ums (srtt=%ums, "
+		      "rttvar=%ums)", t1, info.srtt, info.rttvar));
+	}
+    }
+
+    tsx->t1 = t1;
+    return t1;
+}
+
+/* Schedule the first retransmission of the transaction at T1. */
+static void tsx_schedule_t1(pjsip_transaction *tsx)
+{
+    unsigned t1 = tsx_get_t1(tsx);
+    pj_time_val delay;
+
+    delay.sec = t1 / 1000;
+    delay.msec = t1 % 1000;
+    tsx_schedule_timer(tsx, &tsx->retransmit_timer, &delay,
+		       RETRANSMIT_TIMER);
+}
+
 /* Create and initialize basic transaction structure.
  * This function is called by both UAC and UAS creation.
  */
@@ -983,8 +1070,7 @@ static pj_status_t tsx_create( pjsip_module *tsx_user,
     pjsip_transaction *tsx;
     pj_status_t status;
 
-    pool = pjsip_endpt_create_pool( mod_tsx_layer.endpt, "tsx", 
-				    PJSIP_POOL_TSX_LEN, PJSIP_POOL_TSX_INC );
+    pool = pjsip_pool_slab_create_pool(mod_tsx_layer.slab, "tsx");
     if (!pool)
 	return PJ_ENOMEM;
 
@@ -1354,11 +1440,13 @@ PJ_DEF(pj_status_t) pjsip_tsx_create_uac2(pjsip_module *tsx_user,
 
     /* Calculate hashed key value. */
 #ifdef PRECALC_HASH
-    tsx->hashed_key = pj_hash_calc_tolower(0, NULL, &tsx->transaction_key);
+    tsx->hashed_key = pj_hash_calc(0, tsx->transaction_key.ptr,
+				   (unsigned)tsx->transaction_key.slen);
 #endif
 
-    PJ_LOG(6, (tsx->obj_name, "tsx_key=%.*s", tsx->transaction_key.slen,
-	       tsx->transaction_key.ptr));
+    PJ_LOG(6, (tsx->obj_name, "tsx_key=%.*s",
+	       TSX_KEY_INFO_LEN(&tsx->transaction_key),
+	       TSX_KEY_INFO(&tsx->transaction_key)));
 
     /* Begin with State_Null.
      * Manually set-up the state becase we don't want to call the callback.
@@ -1493,15 +1581,17 @@ PJ_DEF(pj_status_t) pjsip_tsx_create_uas2(pjsip_module *tsx_user,
 
     /* Calculate hashed key value. */
 #ifdef PRECALC_HASH
-    tsx->hashed_key = pj_hash_calc_tolower(0, NULL, &tsx->transaction_key);
+    tsx->hashed_key = pj_hash_calc(0, tsx->transaction_key.ptr,
+				   (unsigned)tsx->transaction_key.slen);
 #endif
 
     /* Duplicate branch parameter for transaction. */
     branch = &rdata->msg_info.via->branch_param;
     pj_strdup(tsx->pool, &tsx->branch, branch);
 
-    PJ_LOG(6, (tsx->obj_name, "tsx_key=%.*s", tsx->transaction_key.slen,
-	       tsx->transaction_key.ptr));
+    PJ_LOG(6, (tsx->obj_name, "tsx_key=%.*s",
+	       TSX_KEY_INFO_LEN(&tsx->transaction_key),
+	       TSX_KEY_INFO(&tsx->transaction_key)));
 
 
     /* Begin with state NULL.
@@ -1812,6 +1902,15 @@ static void send_msg_callback( pjsip_send_state *send_state,
 	    tsx->is_reliable = PJSIP_TRANSPORT_IS_RELIABLE(tsx->transport);
 	}
 
+	/* Round-trip time is measured from the first successful
+	 * transmission of the request.
+	 */
+	if (tsx->role == PJSIP_ROLE_UAC && tsx->retransmit_count == 0 &&
+	    tsx->state <= PJSIP_TSX_STATE_CALLING)
+	{
+	    pj_gettickcount(&tsx->send_time);
+	}
+
 	/* Clear pending transport flag. */
 	tsx->transport_flag &= ~(TSX_HAS_PENDING_TRANSPORT);
 
@@ -1852,6 +1951,17 @@ static void send_msg_callback( pjsip_send_state *send_state,
 	if (send_state->cur_transport==tsx->transport)
 	    tsx_update_transport(tsx, NULL);
 
+	/* Penalize the round-trip time estimate of the failed destination
+	 * so that it will be tried later next time.
+	 */
+	if (tsx->role == PJSIP_ROLE_UAC &&
+	    tdata->dest_info.cur_addr < tdata->dest_info.addr.count)
+	{
+	    pjsip_endpt_update_rtt(tsx->endpt,
+		&tdata->dest_info.addr.entry[tdata->dest_info.cur_addr].addr,
+		-1);
+	}
+
 	/* Also stop processing if transaction has been flagged with
 	 * pending destroy (http://trac.pjsip.org/repos/ticket/906)
 	 */
@@ -2193,7 +2303,7 @@ static void tsx_resched_retransmission( pjsip_transaction *tsx )
     if (tsx->role==PJSIP_ROLE_UAC && tsx->status_code >= 100)
 	msec_time = pjsip_cfg()->tsx.t2;
     else
-	msec_time = (1 << (tsx->retransmit_count)) * pjsip_cfg()->tsx.t1;
+	msec_time = (1 << (tsx->retransmit_count)) * tsx_get_t1(tsx);
 
     if (tsx->role == PJSIP_ROLE_UAC) {
 	pj_assert(tsx->status_code < 200);
@@ -2346,6 +2456,7 @@ static pj_status_t tsx_on_state_null( pjsip_transaction *tsx,
 	}
 
 	/* Send the message. */
+	pj_gettickcount(&tsx->send_time);
         status = tsx_send_msg( tsx, tdata);
 	if (status != PJ_SUCCESS) {
 	    return status;
@@ -2368,8 +2479,7 @@ static pj_status_t tsx_on_state_null( pjsip_transaction *tsx,
 	    if (tsx->transport_flag & TSX_HAS_PENDING_TRANSPORT) {
 		tsx->transport_flag |= TSX_HAS_PENDING_RESCHED;
 	    } else {
-		tsx_schedule_timer(tsx, &tsx->retransmit_timer,
-		                   &t1_timer_val, RETRANSMIT_TIMER);
+		tsx_schedule_t1(tsx);
 	    }
 	}
 
@@ -2411,6 +2521,10 @@ static pj_status_t tsx_on_state_calling( pjsip_transaction *tsx,
 
 	tsx->transport_flag &= ~(TSX_HAS_PENDING_RESCHED);
 
+	/* Penalize the round-trip time estimate of the destination */
+	if (tsx->addr_len)
+	    pjsip_endpt_update_rtt(tsx->endpt, &tsx->addr, -1);
+
 	/* Set status code */
 	tsx_set_status_code(tsx, PJSIP_SC_TSX_TIMEOUT, NULL);
 
@@ -2434,6 +2548,21 @@ static pj_status_t tsx_on_state_calling( pjsip_transaction *tsx,
 
 	code = msg->line.status.code;
 
+	/* Update round-trip time estimate of the destination, but only
+	 * when the request has not been retransmitted since the response
+	 * would be ambiguous otherwise (Karn's algorithm).
+	 */
+	if (tsx->retransmit_count == 0 && tsx->addr_len &&
+	    tsx->send_time.sec)
+	{
+	    pj_time_val now;
+
+	    pj_gettickcount(&now);
+	    PJ_TIME_VAL_SUB(now, tsx->send_time);
+	    pjsip_endpt_update_rtt(tsx->endpt, &tsx->addr,
+				   PJ_TIME_VAL_MSEC(now));
+	}
+
 	/* If the response is final, cancel both retransmission and timeout
 	 * timer.
 	 */
@@ -2663,8 +2792,7 @@ static pj_status_t tsx_on_state_proceeding_uas( pjsip_transaction *tsx,
 		    if (tsx->transport_flag & TSX_HAS_PENDING_TRANSPORT) {
 			tsx->transport_flag |= TSX_HAS_PENDING_RESCHED;
 		    } else {
-			tsx_schedule_timer( tsx, &tsx->retransmit_timer,
-					    &t1_timer_val, RETRANSMIT_TIMER);
+			tsx_schedule_t1(tsx);
 		    }
 		}
 
@@ -2759,8 +2887,7 @@ static pj_status_t tsx_on_state_proceeding_uas( pjsip_transaction *tsx,
 		    if (tsx->transport_flag & TSX_HAS_PENDING_TRANSPORT) {
 			tsx->transport_flag |= TSX_HAS_PENDING_RESCHED;
 		    } else {
-			tsx_schedule_timer(tsx, &tsx->retransmit_timer,
-					   &t1_timer_val, RETRANSMIT_TIMER);
+			tsx_schedule_t1(tsx);
 		    }
 		}
 	    }
@@ -77,6 +77,35 @@ static pjsip_module mod_msg_print =
     NULL,				/* on_tsx_state()		    */
 };
 
+/*
+ * Parallel connection attempts to the addresses of a destination.
+ */
+typedef struct tp_race
+{
+    PJ_DECL_LIST_MEMBER(struct tp_race);
+
+    pjsip_tpmgr		    *mgr;
+    pjsip_tx_data	    *tdata;
+    void		    *token;
+    pjsip_tp_race_callback   cb;
+    pj_timer_entry	     timer;
+
+    unsigned		     cnt;	    /* Number of candidates.	    */
+    unsigned		     started;	    /* Attempts started so far.	    */
+    int			     winner;	    /* Winning candidate or -1.	    */
+    pj_status_t		     last_err;	    /* Last connection error.	    */
+    pj_time_val		     next_attempt;  /* Time to start next attempt.  */
+    pj_bool_t		     in_timer;	    /* Timer callback is running.   */
+
+    struct {
+	unsigned	     index;	    /* Index in dest_info.addr.	    */
+	pjsip_transport	    *tp;	    /* Transport being connected.   */
+	pj_bool_t	     failed;	    /* Connection has failed.	    */
+    } cand[PJSIP_TP_RACE_MAX_CANDIDATES];
+} tp_race;
+
+static void race_finish(tp_race *race);
+
 /*
  * Transport manager.
  */
@@ -97,6 +126,9 @@ struct pjsip_tpmgr
      * is destroyed.
      */
     pjsip_tx_data    tdata_list;
+
+    /* List of connection races in progress. */
+    tp_race	     race_list;
 };
 
 
@@ -1091,7 +1123,6 @@ PJ_DEF(pj_status_t) pjsip_transport_shutdown(pjsip_transport *tp)
 {
     pjsip_tpmgr *mgr;
     pj_status_t status;
-    pjsip_tp_state_callback state_cb;
 
     TRACE_((THIS_FILE, "Transport %s shutting down", tp->obj_name));
 
@@ -1114,13 +1145,12 @@ PJ_DEF(pj_status_t) pjsip_transport_shutdown(pjsip_transport *tp)
 	status = tp->do_shutdown(tp);
 
     /* Notify application of transport shutdown */
-    state_cb = pjsip_tpmgr_get_state_cb(tp->tpmgr);
-    if (state_cb) {
+    {
 	pjsip_transport_state_info state_info;
 
 	pj_bzero(&state_info, sizeof(state_info));
 	state_info.status = status;
-        (*state_cb)(tp, PJSIP_TP_STATE_SHUTDOWN, &state_info);
+	pjsip_transport_notify_state(tp, PJSIP_TP_STATE_SHUTDOWN, &state_info);
     }
 
     if (status == PJ_SUCCESS)
@@ -1144,18 +1174,15 @@ PJ_DEF(pj_status_t) pjsip_transport_shutdown(pjsip_transport *tp)
  */
 PJ_DEF(pj_status_t) pjsip_transport_destroy( pjsip_transport *tp)
 {
-    pjsip_tp_state_callback state_cb;
-
     /* Must have no user. */
     PJ_ASSERT_RETURN(pj_atomic_get(tp->ref_cnt) == 0, PJSIP_EBUSY);
 
     /* Notify application of transport destroy */
-    state_cb = pjsip_tpmgr_get_state_cb(tp->tpmgr);
-    if (state_cb) {
+    {
 	pjsip_transport_state_info state_info;
 
 	pj_bzero(&state_info, sizeof(state_info));
-        (*state_cb)(tp, PJSIP_TP_STATE_DESTROY, &state_info);
+	pjsip_transport_notify_state(tp, PJSIP_TP_STATE_DESTROY, &state_info);
     }
 
     /* Destroy. */
@@ -1258,6 +1285,7 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_create( pj_pool_t *pool,
     mgr->on_tx_msg = tx_cb;
     pj_list_init(&mgr->factory_list);
     pj_list_init(&mgr->tdata_list);
+    pj_list_init(&mgr->race_list);
 
     mgr->table = pj_hash_create(pool, PJSIP_TPMGR_HTABLE_SIZE);
     if (!mgr->table)
@@ -1525,6 +1553,26 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_destroy( pjsip_tpmgr *mgr )
 
     pj_lock_acquire(mgr->lock);
 
+    /*
+     * Cancel connection races in progress, their callbacks are called
+     * without the lock.
+     */
+    while (!pj_list_empty(&mgr->race_list)) {
+	tp_race *race = mgr->race_list.next;
+
+	if (race->timer.id) {
+	    pjsip_endpt_cancel_timer(endpt, &race->timer);
+	    race->timer.id = PJ_FALSE;
+	}
+	pj_list_erase(race);
+	race->winner = -1;
+	race->last_err = PJ_ECANCELLED;
+
+	pj_lock_release(mgr->lock);
+	race_finish(race);
+	pj_lock_acquire(mgr->lock);
+    }
+
     /*
      * Destroy all transports.
      */
@@ -2095,6 +2143,358 @@ static void init_tp_data(pjsip_transport *tp)
 }
 
 
+/* Have the race timer re-evaluate the race as soon as possible. This is
+ * called with the manager lock held.
+ */
+static void race_kick(tp_race *race)
+{
+    pj_time_val delay = {0, 0};
+
+    /* The running timer callback will pick up the change */
+    if (race->in_timer)
+	return;
+
+    if (race->timer.id) {
+	/* Timer has been popped from the heap and is about to run */
+	if (pj_timer_heap_cancel(pjsip_endpt_get_timer_heap(race->mgr->endpt),
+				 &race->timer) == 0)
+	{
+	    return;
+	}
+    }
+
+    race->timer.id = PJ_TRUE;
+    pjsip_endpt_schedule_timer(race->mgr->endpt, &race->timer, &delay);
+}
+
+/* Update connection races with the state of the transport. */
+static void race_on_tp_state(pjsip_transport *tp,
+			     pjsip_transport_state state,
+			     const pjsip_transport_state_info *info)
+{
+    pjsip_tpmgr *mgr = tp->tpmgr;
+    tp_race *race;
+
+    if (!mgr)
+	return;
+
+    pj_lock_acquire(mgr->lock);
+
+    for (race=mgr->race_list.next; race!=&mgr->race_list; race=race->next) {
+	unsigned i;
+
+	if (race->winner >= 0)
+	    continue;
+
+	for (i=0; i<race->started; ++i) {
+	    unsigned idx = race->cand[i].index;
+	    const pjsip_server_addresses *addr = &race->tdata->dest_info.addr;
+
+	    if (race->cand[i].failed || addr->entry[idx].type != tp->key.type ||
+		pj_sockaddr_cmp(&addr->entry[idx].addr, &tp->key.rem_addr) != 0)
+	    {
+		continue;
+	    }
+
+	    if (state == PJSIP_TP_STATE_CONNECTED) {
+		race->winner = i;
+	    } else {
+		race->cand[i].failed = PJ_TRUE;
+		race->last_err = info->status ? info->status :
+						PJSIP_ETPNOTAVAIL;
+	    }
+	    race_kick(race);
+	    break;
+	}
+    }
+
+    pj_lock_release(mgr->lock);
+}
+
+/*
+ * Notify about transport state change.
+ */
+PJ_DEF(void) pjsip_transport_notify_state(
+				    pjsip_transport *tp,
+				    pjsip_transport_state state,
+				    const pjsip_transport_state_info *info)
+{
+    pjsip_tp_state_callback state_cb;
+
+    PJ_ASSERT_ON_FAIL(tp && info, return);
+
+    /* Update connection races in progress, if any */
+    race_on_tp_state(tp, state, info);
+
+    state_cb = pjsip_tpmgr_get_state_cb(tp->tpmgr);
+    if (state_cb)
+	(*state_cb)(tp, state, info);
+}
+
+/* Find existing transport to the destination. */
+static pjsip_transport *find_transport(pjsip_tpmgr *mgr,
+				       pjsip_transport_type_e type,
+				       const pj_sockaddr_t *remote,
+				       int addr_len)
+{
+    pjsip_transport_key key;
+    pjsip_transport *tp;
+
+    pj_bzero(&key, sizeof(key));
+    key.type = type;
+    pj_memcpy(&key.rem_addr, remote, addr_len);
+
+    tp = (pjsip_transport*)
+	 pj_hash_get(mgr->table, &key, sizeof(key.type) + addr_len, NULL);
+    if (tp && tp->is_shutdown)
+	tp = NULL;
+
+    return tp;
+}
+
+/* Start connecting to the next candidate of the race. */
+static void race_start_attempt(tp_race *race)
+{
+    pjsip_tpmgr *mgr = race->mgr;
+    const pjsip_server_addresses *addr = &race->tdata->dest_info.addr;
+    char addr_str[PJ_INET6_ADDRSTRLEN+10];
+    pjsip_transport *tp;
+    unsigned i, idx;
+    pj_status_t status;
+
+    pj_lock_acquire(mgr->lock);
+
+    i = race->started++;
+    idx = race->cand[i].index;
+
+    /* Connection may have been established by someone else */
+    tp = find_transport(mgr, addr->entry[idx].type, &addr->entry[idx].addr,
+			addr->entry[idx].addr_len);
+    if (tp) {
+	pjsip_transport_add_ref(tp);
+	race->cand[i].tp = tp;
+	race->winner = i;
+	pj_lock_release(mgr->lock);
+	return;
+    }
+
+    pj_gettickcount(&race->next_attempt);
+    race->next_attempt.msec += pjsip_cfg()->endpt.conn_race_delay;
+    pj_time_val_normalize(&race->next_attempt);
+
+    pj_lock_release(mgr->lock);
+
+    PJ_LOG(5,(THIS_FILE, "Racing connection to %s (candidate %d)",
+	      pj_sockaddr_print(&addr->entry[idx].addr, addr_str,
+				sizeof(addr_str), 3),
+	      i));
+
+    /* Transport callbacks may be called from inside this function, so it
+     * must not be called with the lock held.
+     */
+    status = pjsip_tpmgr_acquire_transport2(mgr, addr->entry[idx].type,
+					    &addr->entry[idx].addr,
+					    addr->entry[idx].addr_len,
+					    &race->tdata->tp_sel,
+					    race->tdata, &tp);
+
+    pj_lock_acquire(mgr->lock);
+    if (status == PJ_SUCCESS) {
+	race->cand[i].tp = tp;
+    } else {
+	race->cand[i].failed = PJ_TRUE;
+	race->last_err = status;
+    }
+    pj_lock_release(mgr->lock);
+}
+
+/* Finish the race and report the result. */
+static void race_finish(tp_race *race)
+{
+    pjsip_tx_data *tdata = race->tdata;
+    pjsip_transport *winner_tp = NULL;
+    pj_status_t status;
+    unsigned i, index;
+
+    /* Release the losers. Those still connecting will be destroyed by the
+     * idle timer, or when the connection fails.
+     */
+    for (i=0; i<race->started; ++i) {
+	if (!race->cand[i].tp)
+	    continue;
+	if ((int)i == race->winner)
+	    winner_tp = race->cand[i].tp;
+	else
+	    pjsip_transport_dec_ref(race->cand[i].tp);
+    }
+
+    if (race->winner >= 0) {
+	status = PJ_SUCCESS;
+	index = race->cand[race->winner].index;
+    } else {
+	status = race->last_err ? race->last_err : PJSIP_ETPNOTAVAIL;
+	index = race->cand[race->started ? race->started-1 : 0].index;
+    }
+
+    PJ_LOG(5,(THIS_FILE, "Connection race for %s finished: %s",
+	      pjsip_tx_data_get_info(tdata),
+	      (race->winner >= 0 ? "connected" : "failed")));
+
+    (*race->cb)(race->token, tdata, status, index);
+
+    /* The winner is kept until the callback has acquired it. */
+    if (winner_tp)
+	pjsip_transport_dec_ref(winner_tp);
+
+    /* The race lives in the tdata pool, so this must be done last. */
+    pjsip_tx_data_dec_ref(tdata);
+}
+
+/* Timer callback to drive the connection race. Besides staggering the
+ * attempts, it is scheduled whenever the state of a candidate changes.
+ */
+static void race_timer_cb(pj_timer_heap_t *timer_heap,
+			  struct pj_timer_entry *entry)
+{
+    tp_race *race = (tp_race*) entry->user_data;
+    pjsip_tpmgr *mgr = race->mgr;
+    pj_time_val now;
+
+    PJ_UNUSED_ARG(timer_heap);
+
+    pj_lock_acquire(mgr->lock);
+    entry->id = PJ_FALSE;
+    race->in_timer = PJ_TRUE;
+
+    for (;;) {
+	unsigned i, failed = 0;
+
+	for (i=0; i<race->started; ++i) {
+	    if (race->cand[i].failed)
+		++failed;
+	}
+
+	if (race->winner >= 0 || failed == race->cnt) {
+	    pj_list_erase(race);
+	    pj_lock_release(mgr->lock);
+	    race_finish(race);
+	    return;
+	}
+
+	if (race->started == race->cnt)
+	    break;
+
+	/* Start next attempt when all attempts so far have failed or when
+	 * they take too long.
+	 */
+	pj_gettickcount(&now);
+	if (failed < race->started &&
+	    PJ_TIME_VAL_LT(now, race->next_attempt))
+	{
+	    break;
+	}
+
+	pj_lock_release(mgr->lock);
+	race_start_attempt(race);
+	pj_lock_acquire(mgr->lock);
+    }
+
+    /* Wake up for the next attempt. Otherwise the pending attempts will
+     * report their result with transport state events.
+     */
+    if (race->started < race->cnt) {
+	pj_time_val delay = race->next_attempt;
+
+	pj_gettickcount(&now);
+	PJ_TIME_VAL_SUB(delay, now);
+	if (delay.sec < 0)
+	    delay.sec = delay.msec = 0;
+	entry->id = PJ_TRUE;
+	pjsip_endpt_schedule_timer(mgr->endpt, entry, &delay);
+    }
+
+    race->in_timer = PJ_FALSE;
+    pj_lock_release(mgr->lock);
+}
+
+/*
+ * Start parallel connection attempts.
+ */
+PJ_DEF(pj_status_t) pjsip_tpmgr_race_transport(pjsip_tpmgr *mgr,
+					       pjsip_tx_data *tdata,
+					       void *token,
+					       pjsip_tp_race_callback cb)
+{
+    const pjsip_server_addresses *addr = &tdata->dest_info.addr;
+    unsigned start = tdata->dest_info.cur_addr;
+    unsigned i, cnt;
+    tp_race *race;
+    pj_time_val delay;
+
+    PJ_ASSERT_RETURN(mgr && tdata && cb, PJ_EINVAL);
+
+    if (pjsip_cfg()->endpt.conn_race_delay == 0 ||
+	tdata->tp_sel.type != PJSIP_TPSELECTOR_NONE ||
+	start >= addr->count)
+    {
+	return PJ_SUCCESS;
+    }
+
+    /* Only consecutive connection oriented addresses take part */
+    for (cnt=0; start+cnt < addr->count &&
+		cnt < PJSIP_TP_RACE_MAX_CANDIDATES; ++cnt)
+    {
+	unsigned flag;
+
+	flag = pjsip_transport_get_flag_from_type(addr->entry[start+cnt].type);
+	if ((flag & PJSIP_TRANSPORT_RELIABLE) == 0)
+	    break;
+    }
+    if (cnt < 2)
+	return PJ_SUCCESS;
+
+    /* No need to race if we already have connection to the first one */
+    pj_lock_acquire(mgr->lock);
+    if (find_transport(mgr, addr->entry[start].type,
+		       &addr->entry[start].addr,
+		       addr->entry[start].addr_len))
+    {
+	pj_lock_release(mgr->lock);
+	return PJ_SUCCESS;
+    }
+
+    race = PJ_POOL_ZALLOC_T(tdata->pool, tp_race);
+    race->mgr = mgr;
+    race->tdata = tdata;
+    race->token = token;
+    race->cb = cb;
+    race->cnt = cnt;
+    race->winner = -1;
+    for (i=0; i<cnt; ++i)
+	race->cand[i].index = start + i;
+    pj_timer_entry_init(&race->timer, PJ_FALSE, race, &race_timer_cb);
+
+    /* Keep the tdata (and the race with it) until the race completes.
+     * Events are not acted upon until the timer is scheduled below.
+     */
+    pjsip_tx_data_add_ref(tdata);
+    race->in_timer = PJ_TRUE;
+    pj_list_push_back(&mgr->race_list, race);
+    pj_lock_release(mgr->lock);
+
+    race_start_attempt(race);
+
+    pj_lock_acquire(mgr->lock);
+    delay.sec = delay.msec = 0;
+    race->in_timer = PJ_FALSE;
+    race->timer.id = PJ_TRUE;
+    pjsip_endpt_schedule_timer(mgr->endpt, &race->timer, &delay);
+    pj_lock_release(mgr->lock);
+
+    return PJ_EPENDING;
+}
+
+
 static void tp_state_callback(pjsip_transport *tp,
 			      pjsip_transport_state state,
 			      const pjsip_transport_state_info *info)
@@ -171,8 +171,6 @@ static void sockaddr_to_host_port( pj_pool_t *pool,
 
 static void tcp_init_shutdown(struct tcp_transport *tcp, pj_status_t status)
 {
-    pjsip_tp_state_callback state_cb;
-
     if (tcp->close_reason == PJ_SUCCESS)
 	tcp->close_reason = status;
 
@@ -186,13 +184,13 @@ static void tcp_init_shutdown(struct tcp_transport *tcp, pj_status_t status)
     pjsip_transport_add_ref(&tcp->base);
 
     /* Notify application of transport disconnected state */
-    state_cb = pjsip_tpmgr_get_state_cb(tcp->base.tpmgr);
-    if (state_cb) {
+    {
 	pjsip_transport_state_info state_info;
 
 	pj_bzero(&state_info, sizeof(state_info));
 	state_info.status = tcp->close_reason;
-	(*state_cb)(&tcp->base, PJSIP_TP_STATE_DISCONNECTED, &state_info);
+	pjsip_transport_notify_state(&tcp->base, PJSIP_TP_STATE_DISCONNECTED,
+				     &state_info);
     }
 
     /* check again */
@@ -1011,7 +1009,6 @@ static pj_bool_t on_accept_complete(pj_activesock_t *asock,
     struct tcp_listener *listener;
     struct tcp_transport *tcp;
     char addr[PJ_INET6_ADDRSTRLEN+10];
-    pjsip_tp_state_callback state_cb;
     pj_sockaddr tmp_src_addr;
     pj_status_t status;
 
@@ -1066,12 +1063,13 @@ static pj_bool_t on_accept_complete(pj_activesock_t *asock,
 	    }
 
 	    /* Notify application of transport state accepted */
-	    state_cb = pjsip_tpmgr_get_state_cb(tcp->base.tpmgr);
-	    if (state_cb) {
+	    {
 		pjsip_transport_state_info state_info;
             
 		pj_bzero(&state_info, sizeof(state_info));
-		(*state_cb)(&tcp->base, PJSIP_TP_STATE_CONNECTED, &state_info);
+		pjsip_transport_notify_state(&tcp->base,
+					     PJSIP_TP_STATE_CONNECTED,
+					     &state_info);
 	    }
 	}
     }
@@ -1337,7 +1335,6 @@ static pj_bool_t on_connect_complete(pj_activesock_t *asock,
     struct tcp_transport *tcp;
     pj_sockaddr addr;
     int addrlen;
-    pjsip_tp_state_callback state_cb;
 
     tcp = (struct tcp_transport*) pj_activesock_get_user_data(asock);
 
@@ -1401,12 +1398,12 @@ static pj_bool_t on_connect_complete(pj_activesock_t *asock,
     }
 
     /* Notify application of transport state connected */
-    state_cb = pjsip_tpmgr_get_state_cb(tcp->base.tpmgr);
-    if (state_cb) {
+    {
 	pjsip_transport_state_info state_info;
     
 	pj_bzero(&state_info, sizeof(state_info));
-	(*state_cb)(&tcp->base, PJSIP_TP_STATE_CONNECTED, &state_info);
+	pjsip_transport_notify_state(&tcp->base, PJSIP_TP_STATE_CONNECTED,
+				     &state_info);
     }
 
     /* Flush all pending send operations */
@@ -178,8 +178,6 @@ static void sockaddr_to_host_port( pj_pool_t *pool,
 
 static void tls_init_shutdown(struct tls_transport *tls, pj_status_t status)
 {
-    pjsip_tp_state_callback state_cb;
-
     if (tls->close_reason == PJ_SUCCESS)
 	tls->close_reason = status;
 
@@ -193,8 +191,7 @@ static void tls_init_shutdown(struct tls_transport *tls, pj_status_t status)
     pjsip_transport_add_ref(&tls->base);
 
     /* Notify application of transport disconnected state */
-    state_cb = pjsip_tpmgr_get_state_cb(tls->base.tpmgr);
-    if (state_cb) {
+    {
 	pjsip_transport_state_info state_info;
 	pjsip_tls_state_info tls_info;
 	pj_ssl_sock_info ssl_info;
@@ -211,7 +208,8 @@ static void tls_init_shutdown(struct tls_transport *tls, pj_status_t status)
 	    state_info.ext_info = &tls_info;
 	}
 
-	(*state_cb)(&tls->base, PJSIP_TP_STATE_DISCONNECTED, &state_info);
+	pjsip_transport_notify_state(&tls->base, PJSIP_TP_STATE_DISCONNECTED,
+				     &state_info);
     }
 
     /* check again */
@@ -348,6 +346,10 @@ PJ_DEF(pj_status_t) pjsip_tls_transport_start2( pjsip_endpoint *endpt,
     ssock_param.qos_ignore_error = listener->tls_setting.qos_ignore_error;
     pj_memcpy(&ssock_param.qos_params, &listener->tls_setting.qos_params,
 	      sizeof(ssock_param.qos_params));
+    if (listener->tls_setting.async_handshake) {
+	ssock_param.async_handshake = PJ_TRUE;
+	ssock_param.timer_heap = pjsip_endpt_get_timer_heap(endpt);
+    }
 
     has_listener = PJ_FALSE;
 
@@ -952,6 +954,10 @@ static pj_status_t lis_create_transport(pjsip_tpfactory *factory,
     ssock_param.qos_ignore_error = listener->tls_setting.qos_ignore_error;
     pj_memcpy(&ssock_param.qos_params, &listener->tls_setting.qos_params,
 	      sizeof(ssock_param.qos_params));
+    if (listener->tls_setting.async_handshake) {
+	ssock_param.async_handshake = PJ_TRUE;
+	ssock_param.timer_heap = pjsip_endpt_get_timer_heap(listener->endpt);
+    }
 
     switch(listener->tls_setting.method) {
     case PJSIP_TLSV1_METHOD:
@@ -1069,7 +1075,6 @@ static pj_bool_t on_accept_complete(pj_ssl_sock_t *ssock,
     struct tls_transport *tls;
     pj_ssl_sock_info ssl_info;
     char addr[PJ_INET6_ADDRSTRLEN+10];
-    pjsip_tp_state_callback state_cb;
     pj_sockaddr tmp_src_addr;
     pj_bool_t is_shutdown;
     pj_status_t status;
@@ -1131,8 +1136,7 @@ static pj_bool_t on_accept_complete(pj_ssl_sock_t *ssock,
     }
 
     /* Notify transport state to application */
-    state_cb = pjsip_tpmgr_get_state_cb(tls->base.tpmgr);
-    if (state_cb) {
+    {
 	pjsip_transport_state_info state_info;
 	pjsip_tls_state_info tls_info;
 	pjsip_transport_state tp_state;
@@ -1153,7 +1157,7 @@ static pj_bool_t on_accept_complete(pj_ssl_sock_t *ssock,
 	    state_info.status = PJ_SUCCESS;
 	}
 
-	(*state_cb)(&tls->base, tp_state, &state_info);
+	pjsip_transport_notify_state(&tls->base, tp_state, &state_info);
     }
 
     /* Release transport reference. If transport is shutting down, it may
@@ -1443,7 +1447,6 @@ static pj_bool_t on_connect_complete(pj_ssl_sock_t *ssock,
     struct tls_transport *tls;
     pj_ssl_sock_info ssl_info;
     pj_sockaddr addr, *tp_addr;
-    pjsip_tp_state_callback state_cb;
     pj_bool_t is_shutdown;
 
     tls = (struct tls_transport*) pj_ssl_sock_get_user_data(ssock);
@@ -1557,8 +1560,7 @@ static pj_bool_t on_connect_complete(pj_ssl_sock_t *ssock,
     }
 
     /* Notify transport state to application */
-    state_cb = pjsip_tpmgr_get_state_cb(tls->base.tpmgr);
-    if (state_cb) {
+    {
 	pjsip_transport_state_info state_info;
 	pjsip_tls_state_info tls_info;
 	pjsip_transport_state tp_state;
@@ -1579,7 +1581,7 @@ static pj_bool_t on_connect_complete(pj_ssl_sock_t *ssock,
 	    state_info.status = PJ_SUCCESS;
 	}
 
-	(*state_cb)(&tls->base, tp_state, &state_info);
+	pjsip_transport_notify_state(&tls->base, tp_state, &state_info);
     }
 
     /* Release transport reference. If transport is shutting down, it may
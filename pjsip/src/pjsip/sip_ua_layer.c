@@ -23,6 +23,7 @@
 #include <pjsip/sip_endpoint.h>
 #include <pjsip/sip_errno.h>
 #include <pjsip/sip_transaction.h>
+#include <pjsip/sip_private.h>
 #include <pj/os.h>
 #include <pj/hash.h>
 #include <pj/assert.h>
@@ -80,6 +81,7 @@ static struct user_agent
     pjsip_endpoint	*endpt;
     pj_mutex_t		*mutex;
     pj_hash_table_t	*dlg_table;
+    pjsip_pool_slab	*dlg_slab;
     pjsip_ua_init_param  param;
     struct dlg_set	 free_dlgset_nodes;
 
@@ -128,6 +130,15 @@ static pj_status_t mod_ua_load(pjsip_endpoint *endpt)
 
     pj_list_init(&mod_ua.free_dlgset_nodes);
 
+    /* Get the slab for dialog pools, one of which is held by each call.
+     * The slab belongs to the endpoint.
+     */
+    status = pjsip_endpt_create_pool_slab(endpt, "dlg", PJSIP_POOL_LEN_DIALOG,
+					  PJSIP_POOL_INC_DIALOG, 1,
+					  &mod_ua.dlg_slab);
+    if (status != PJ_SUCCESS)
+	return status;
+
     /* Initialize dialog lock. */
     status = pj_thread_local_alloc(&pjsip_dlg_lock_tls_id);
     if (status != PJ_SUCCESS)
@@ -148,6 +159,7 @@ static pj_status_t mod_ua_unload(void)
 {
     pj_thread_local_free(pjsip_dlg_lock_tls_id);
     pj_mutex_destroy(mod_ua.mutex);
+    mod_ua.dlg_slab = NULL;
 
     /* Release pool */
     if (mod_ua.pool) {
@@ -220,6 +232,16 @@ PJ_DEF(pjsip_endpoint*) pjsip_ua_get_endpt(pjsip_user_agent *ua)
     return mod_ua.endpt;
 }
 
+/*
+ * Get the slab for dialog pools.
+ */
+PJ_DEF(pjsip_pool_slab*) pjsip_ua_get_dlg_slab(pjsip_user_agent *ua)
+{
+    PJ_UNUSED_ARG(ua);
+    pj_assert(ua == &mod_ua.mod);
+    return mod_ua.dlg_slab;
+}
+
 
 /*
  * Destroy the user agent layer.
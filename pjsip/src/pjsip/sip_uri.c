@@ -22,6 +22,7 @@
 #include <pjsip/sip_parser.h>
 #include <pjsip/print_util.h>
 #include <pjsip/sip_errno.h>
+#include <pjsip/sip_private.h>
 #include <pjlib-util/string.h>
 #include <pj/string.h>
 #include <pj/pool.h>
@@ -68,6 +69,95 @@ PJ_DEF(int) pjsip_param_cmp( const pjsip_param *param_list1,
     return 0;
 }
 
+/*
+ * Common tokens which clones share instead of duplicating them in their own
+ * pool: method names and option tags (mostly found in Allow and Supported
+ * headers), and common parameter names and values. The tokens are grouped
+ * by length so that a lookup only compares the few tokens of the same
+ * length.
+ */
+static const pj_str_t interned_1[] = { { "q", 1 } };
+static const pj_str_t interned_2[] =
+{
+    { "lr", 2 }, { "ob", 2 }, { "ws", 2 }, { "ip", 2 }
+};
+static const pj_str_t interned_3[] =
+{
+    { "ACK", 3 }, { "BYE", 3 }, { "ttl", 3 }, { "tag", 3 }, { "udp", 3 },
+    { "tcp", 3 }, { "tls", 3 }, { "wss", 3 }, { "UDP", 3 }, { "TCP", 3 },
+    { "TLS", 3 }
+};
+static const pj_str_t interned_4[] =
+{
+    { "INFO", 4 }, { "path", 4 }, { "gruu", 4 }, { "user", 4 }, { "sctp", 4 }
+};
+static const pj_str_t interned_5[] =
+{
+    { "PRACK", 5 }, { "REFER", 5 }, { "timer", 5 }, { "maddr", 5 },
+    { "rport", 5 }, { "phone", 5 }
+};
+static const pj_str_t interned_6[] =
+{
+    { "INVITE", 6 }, { "CANCEL", 6 }, { "UPDATE", 6 }, { "NOTIFY", 6 },
+    { "100rel", 6 }, { "method", 6 }, { "branch", 6 }, { "reg-id", 6 }
+};
+static const pj_str_t interned_7[] =
+{
+    { "OPTIONS", 7 }, { "MESSAGE", 7 }, { "PUBLISH", 7 }, { "expires", 7 }
+};
+static const pj_str_t interned_8[] =
+{
+    { "REGISTER", 8 }, { "replaces", 8 }, { "outbound", 8 }, { "received", 8 }
+};
+static const pj_str_t interned_9[] =
+{
+    { "SUBSCRIBE", 9 }, { "transport", 9 }
+};
+static const pj_str_t interned_10[] = { { "norefersub", 10 } };
+static const pj_str_t interned_13[] = { { "+sip.instance", 13 } };
+
+static const struct
+{
+    const pj_str_t  *str;
+    unsigned	     cnt;
+} interned_str[] =
+{
+    { NULL, 0 },
+    { interned_1, PJ_ARRAY_SIZE(interned_1) },
+    { interned_2, PJ_ARRAY_SIZE(interned_2) },
+    { interned_3, PJ_ARRAY_SIZE(interned_3) },
+    { interned_4, PJ_ARRAY_SIZE(interned_4) },
+    { interned_5, PJ_ARRAY_SIZE(interned_5) },
+    { interned_6, PJ_ARRAY_SIZE(interned_6) },
+    { interned_7, PJ_ARRAY_SIZE(interned_7) },
+    { interned_8, PJ_ARRAY_SIZE(interned_8) },
+    { interned_9, PJ_ARRAY_SIZE(interned_9) },
+    { interned_10, PJ_ARRAY_SIZE(interned_10) },
+    { NULL, 0 },
+    { NULL, 0 },
+    { interned_13, PJ_ARRAY_SIZE(interned_13) }
+};
+
+PJ_DEF(void) pjsip_strdup_interned(pj_pool_t *pool, pj_str_t *dst,
+				   const pj_str_t *src)
+{
+    if (src->slen > 0 && src->slen < (pj_ssize_t)PJ_ARRAY_SIZE(interned_str)) {
+	const pj_str_t *token = interned_str[src->slen].str;
+	unsigned i, cnt = interned_str[src->slen].cnt;
+
+	for (i=0; i<cnt; ++i, ++token) {
+	    if (token->ptr[0] == src->ptr[0] &&
+		pj_memcmp(token->ptr, src->ptr, src->slen)==0)
+	    {
+		*dst = *token;
+		return;
+	    }
+	}
+    }
+
+    pj_strdup(pool, dst, src);
+}
+
 PJ_DEF(void) pjsip_param_clone( pj_pool_t *pool, pjsip_param *dst_list,
 				const pjsip_param *src_list)
 {
@@ -76,8 +166,8 @@ PJ_DEF(void) pjsip_param_clone( pj_pool_t *pool, pjsip_param *dst_list,
     pj_list_init(dst_list);
     while (p && p != src_list) {
 	pjsip_param *new_param = PJ_POOL_ALLOC_T(pool, pjsip_param);
-	pj_strdup(pool, &new_param->name, &p->name);
-	pj_strdup(pool, &new_param->value, &p->value);
+	pjsip_strdup_interned(pool, &new_param->name, &p->name);
+	pjsip_strdup_interned(pool, &new_param->value, &p->value);
 	pj_list_insert_before(dst_list, new_param);
 	p = p->next;
     }
@@ -510,9 +600,9 @@ PJ_DEF(void) pjsip_sip_uri_assign(pj_pool_t *pool, pjsip_sip_uri *url,
     pj_strdup( pool, &url->passwd, &rhs->passwd);
     pj_strdup( pool, &url->host, &rhs->host);
     url->port = rhs->port;
-    pj_strdup( pool, &url->user_param, &rhs->user_param);
+    pjsip_strdup_interned( pool, &url->user_param, &rhs->user_param);
     pj_strdup( pool, &url->method_param, &rhs->method_param);
-    pj_strdup( pool, &url->transport_param, &rhs->transport_param);
+    pjsip_strdup_interned( pool, &url->transport_param, &rhs->transport_param);
     url->ttl_param = rhs->ttl_param;
     pj_strdup( pool, &url->maddr_param, &rhs->maddr_param);
     pjsip_param_clone(pool, &url->other_param, &rhs->other_param);
@@ -1089,6 +1089,31 @@ PJ_DEF(void) pjsip_restore_strict_route_set(pjsip_tx_data *tdata)
  * This is one of the most bizzare function in pjsip, so
  * good luck if you happen to debug this function!!
  */
+static void stateless_send_transport_cb( void *token,
+					 pjsip_tx_data *tdata,
+					 pj_ssize_t sent );
+
+/* Connection race callback for stateless send. */
+static void stateless_send_race_cb( void *token,
+				    pjsip_tx_data *tdata,
+				    pj_status_t status,
+				    unsigned index )
+{
+    tdata->dest_info.cur_addr = index;
+
+    /* Transport manager is shutting down, don't try other addresses */
+    if (status == PJ_ECANCELLED)
+	tdata->dest_info.cur_addr = tdata->dest_info.addr.count - 1;
+
+    if (status == PJ_SUCCESS) {
+	/* Continue with the address that has been connected */
+	stateless_send_transport_cb(token, tdata, -PJ_EPENDING);
+    } else {
+	/* Continue with the address after the failed ones */
+	stateless_send_transport_cb(token, tdata, -status);
+    }
+}
+
 static void stateless_send_transport_cb( void *token,
 					 pjsip_tx_data *tdata,
 					 pj_ssize_t sent )
@@ -1168,6 +1193,17 @@ static void stateless_send_transport_cb( void *token,
 	cur_addr_type = tdata->dest_info.addr.entry[tdata->dest_info.cur_addr].type;
 	cur_addr_len = tdata->dest_info.addr.entry[tdata->dest_info.cur_addr].addr_len;
 
+	/* Race connections to the following addresses if this is
+	 * a new connection (RFC 6555).
+	 */
+	status = pjsip_tpmgr_race_transport(
+			pjsip_endpt_get_tpmgr(stateless_data->endpt),
+			tdata, stateless_data, &stateless_send_race_cb);
+	if (status == PJ_EPENDING) {
+	    /* stateless_send_race_cb() will be called later. */
+	    return;
+	}
+
 	/* Acquire transport. */
 	status = pjsip_endpt_acquire_transport2(stateless_data->endpt,
 						cur_addr_type,
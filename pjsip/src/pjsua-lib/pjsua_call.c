@@ -111,16 +111,38 @@ static void reinv_timer_cb(pj_timer_heap_t *th, pj_timer_entry *entry);
 /* Check and send reinvite for lock codec and ICE update */
 static pj_status_t process_pending_reinvite(pjsua_call *call);
 
+/* Return a call id to the free ring */
+static void release_call_id(pjsua_call_id cid);
+
+/*
+ * Detach the invite session and dialog from the call slot. This must be
+ * done before the dialog can be destroyed, since acquire_call() and
+ * pjsua_call_get_info() only hold the slot lock (not the PJSUA lock)
+ * while they dereference the dialog.
+ */
+static void detach_call(pjsua_call *call)
+{
+    pj_mutex_lock(call->lock);
+    call->inv = NULL;
+    call->async_call.dlg = NULL;
+    pj_mutex_unlock(call->lock);
+}
+
 /*
  * Reset call descriptor.
  */
 static void reset_call(pjsua_call_id id)
 {
     pjsua_call *call = &pjsua_var.calls[id];
+    pj_mutex_t *lock = call->lock;
     unsigned i;
 
+    /* pjsua_call_get_info() may be reading the slot */
+    pj_mutex_lock(lock);
+
     pj_bzero(call, sizeof(*call));
     call->index = id;
+    call->lock = lock;
     call->last_text.ptr = call->last_text_buf_;
     for (i=0; i<PJ_ARRAY_SIZE(call->media); ++i) {
 	pjsua_call_media *call_med = &call->media[i];
@@ -132,9 +154,12 @@ static void reset_call(pjsua_call_id id)
 	call_med->idx = i;
 	call_med->tp_auto_del = PJ_TRUE;
     }
+    call->media_snap.conf_slot = PJSUA_INVALID_ID;
     pjsua_call_setting_default(&call->opt);
     pj_timer_entry_init(&call->reinv_timer, PJ_FALSE,
 			(void*)(pj_size_t)id, &reinv_timer_cb);
+
+    pj_mutex_unlock(lock);
 }
 
 
@@ -148,16 +173,37 @@ pj_status_t pjsua_call_subsys_init(const pjsua_config *cfg)
     const pj_str_t str_norefersub = { "norefersub", 10 };
     pj_status_t status;
 
-    /* Init calls array. */
-    for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.calls); ++i)
-	reset_call(i);
-
     /* Copy config */
     pjsua_config_dup(pjsua_var.pool, &pjsua_var.ua_cfg, cfg);
 
     /* Verify settings */
-    if (pjsua_var.ua_cfg.max_calls >= PJSUA_MAX_CALLS) {
-	pjsua_var.ua_cfg.max_calls = PJSUA_MAX_CALLS;
+    if (pjsua_var.ua_cfg.max_calls == 0)
+	pjsua_var.ua_cfg.max_calls = 1;
+
+    /* Create calls table and the free call id ring. */
+    pjsua_var.calls = (pjsua_call*)
+		      pj_pool_calloc(pjsua_var.pool, pjsua_var.ua_cfg.max_calls,
+				     sizeof(pjsua_call));
+    pjsua_var.call_free = (pjsua_call_id*)
+			  pj_pool_calloc(pjsua_var.pool,
+					 pjsua_var.ua_cfg.max_calls,
+					 sizeof(pjsua_call_id));
+    pjsua_var.call_queued = (pj_uint8_t*)
+			    pj_pool_zalloc(pjsua_var.pool,
+					   pjsua_var.ua_cfg.max_calls);
+    pjsua_var.call_free_head = pjsua_var.call_free_cnt = 0;
+
+    for (i=0; i<pjsua_var.ua_cfg.max_calls; ++i) {
+	char name[PJ_MAX_OBJ_NAME];
+
+	pj_ansi_snprintf(name, sizeof(name), "call%d", i);
+	status = pj_mutex_create_simple(pjsua_var.pool, name,
+					&pjsua_var.calls[i].lock);
+	if (status != PJ_SUCCESS)
+	    return status;
+
+	reset_call(i);
+	release_call_id(i);
     }
 
     /* Check the route URI's and force loose route if required */
@@ -249,49 +295,48 @@ PJ_DEF(pj_status_t) pjsua_enum_calls( pjsua_call_id ids[],
 }
 
 
-/* Allocate one call id */
+/* Allocate one call id. Free ids are kept in a FIFO ring, so the
+ * least recently released slot is handed out first (the same
+ * round-robin behavior as the old linear scan, without the scan).
+ */
 static pjsua_call_id alloc_call_id(void)
 {
-    pjsua_call_id cid;
+    unsigned max = pjsua_var.ua_cfg.max_calls;
 
-#if 1
-    /* New algorithm: round-robin */
-    if (pjsua_var.next_call_id >= (int)pjsua_var.ua_cfg.max_calls ||
-	pjsua_var.next_call_id < 0)
-    {
-	pjsua_var.next_call_id = 0;
-    }
+    while (pjsua_var.call_free_cnt) {
+	pjsua_call_id cid = pjsua_var.call_free[pjsua_var.call_free_head];
 
-    for (cid=pjsua_var.next_call_id;
-	 cid<(int)pjsua_var.ua_cfg.max_calls;
-	 ++cid)
-    {
-	if (pjsua_var.calls[cid].inv == NULL &&
-            pjsua_var.calls[cid].async_call.dlg == NULL)
-        {
-	    ++pjsua_var.next_call_id;
-	    return cid;
-	}
-    }
+	pjsua_var.call_free_head = (pjsua_var.call_free_head + 1) % max;
+	--pjsua_var.call_free_cnt;
+	pjsua_var.call_queued[cid] = 0;
 
-    for (cid=0; cid < pjsua_var.next_call_id; ++cid) {
 	if (pjsua_var.calls[cid].inv == NULL &&
-            pjsua_var.calls[cid].async_call.dlg == NULL)
-        {
-	    ++pjsua_var.next_call_id;
+	    pjsua_var.calls[cid].async_call.dlg == NULL)
+	{
 	    return cid;
 	}
     }
 
-#else
-    /* Old algorithm */
-    for (cid=0; cid<(int)pjsua_var.ua_cfg.max_calls; ++cid) {
-	if (pjsua_var.calls[cid].inv == NULL)
-	    return cid;
+    return PJSUA_INVALID_ID;
+}
+
+/* Return a call id to the free ring once its slot is no longer used. */
+static void release_call_id(pjsua_call_id cid)
+{
+    unsigned max = pjsua_var.ua_cfg.max_calls;
+
+    if (pjsua_var.call_queued[cid] ||
+	pjsua_var.calls[cid].inv != NULL ||
+	pjsua_var.calls[cid].async_call.dlg != NULL)
+    {
+	return;
     }
-#endif
 
-    return PJSUA_INVALID_ID;
+    pj_assert(pjsua_var.call_free_cnt < max);
+    pjsua_var.call_free[(pjsua_var.call_free_head +
+			 pjsua_var.call_free_cnt) % max] = cid;
+    ++pjsua_var.call_free_cnt;
+    pjsua_var.call_queued[cid] = 1;
 }
 
 /* Get signaling secure level.
@@ -525,6 +570,9 @@ on_error:
         (*pjsua_var.ua_cfg.cb.on_call_state)(call_id, &user_event);
     }
 
+    if (call_id != -1)
+	detach_call(&pjsua_var.calls[call_id]);
+
     if (dlg) {
 	/* This may destroy the dialog */
 	pjsip_dlg_dec_lock(dlg);
@@ -537,6 +585,7 @@ on_error:
     if (call_id != -1) {
 	pjsua_media_channel_deinit(call_id);
 	reset_call(call_id);
+	release_call_id(call_id);
     }
 
     call->med_ch_cb = NULL;
@@ -795,6 +844,9 @@ PJ_DEF(pj_status_t) pjsua_call_make_call(pjsua_acc_id acc_id,
 
 
 on_error:
+    if (call_id != -1)
+	detach_call(&pjsua_var.calls[call_id]);
+
     if (dlg) {
 	/* This may destroy the dialog */
 	pjsip_dlg_dec_lock(dlg);
@@ -803,6 +855,7 @@ on_error:
     if (call_id != -1) {
 	pjsua_media_channel_deinit(call_id);
 	reset_call(call_id);
+	release_call_id(call_id);
     }
 
     pjsua_check_snd_dev_idle();
@@ -1381,17 +1434,15 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
 		 * a response message and terminate the invite here.
 		 */
 		pjsip_dlg_respond(dlg, rdata, sip_err_code, NULL, NULL, NULL);
-		pjsip_inv_terminate(call->inv, sip_err_code, PJ_FALSE);
-		call->inv = NULL;
-		call->async_call.dlg = NULL;
+		detach_call(call);
+		pjsip_inv_terminate(inv, sip_err_code, PJ_FALSE);
 		goto on_return;
 	    }
 	} else if (status != PJ_EPENDING) {
 	    pjsua_perror(THIS_FILE, "Error initializing media channel", status);
 	    pjsip_dlg_respond(dlg, rdata, sip_err_code, NULL, NULL, NULL);
-	    pjsip_inv_terminate(call->inv, sip_err_code, PJ_FALSE);
-	    call->inv = NULL;
-	    call->async_call.dlg = NULL;
+	    detach_call(call);
+	    pjsip_inv_terminate(inv, sip_err_code, PJ_FALSE);
 	    goto on_return;
 	}
     }
@@ -1414,11 +1465,10 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
     if (status != PJ_SUCCESS) {
 	pjsua_perror(THIS_FILE, "Session Timer init failed", status);
         pjsip_dlg_respond(dlg, rdata, PJSIP_SC_INTERNAL_SERVER_ERROR, NULL, NULL, NULL);
+	detach_call(call);
 	pjsip_inv_terminate(inv, PJSIP_SC_INTERNAL_SERVER_ERROR, PJ_FALSE);
 
 	pjsua_media_channel_deinit(call->index);
-	call->inv = NULL;
-	call->async_call.dlg = NULL;
 
 	goto on_return;
     }
@@ -1446,6 +1496,7 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
     status = pjsip_inv_initial_answer(inv, rdata,
 				      100, NULL, NULL, &response);
     if (status != PJ_SUCCESS) {
+	detach_call(call);
 	if (response == NULL) {
 	    pjsua_perror(THIS_FILE, "Unable to send answer to incoming INVITE",
 			 status);
@@ -1457,8 +1508,6 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
 				PJ_FALSE);
 	}
 	pjsua_media_channel_deinit(call->index);
-	call->inv = NULL;
-	call->async_call.dlg = NULL;
 	goto on_return;
 
     } else {
@@ -1466,8 +1515,7 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
 	if (status != PJ_SUCCESS) {
 	    pjsua_perror(THIS_FILE, "Unable to send 100 response", status);
 	    pjsua_media_channel_deinit(call->index);
-	    call->inv = NULL;
-	    call->async_call.dlg = NULL;
+	    detach_call(call);
 	    goto on_return;
 	}
     }
@@ -1507,6 +1555,10 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
 
     /* This INVITE request has been handled. */
 on_return:
+    /* Give the slot back if the call did not get established */
+    if (call_id != PJSUA_INVALID_ID)
+	release_call_id(call_id);
+
     pj_log_pop_indent();
     PJSUA_UNLOCK();
     return PJ_TRUE;
@@ -1534,8 +1586,7 @@ pj_status_t acquire_call(const char *title,
 				pjsip_dialog **p_dlg)
 {
     unsigned retry;
-    pjsua_call *call = NULL;
-    pj_bool_t has_pjsua_lock = PJ_FALSE;
+    pjsua_call *call = &pjsua_var.calls[call_id];
     pj_status_t status = PJ_SUCCESS;
     pj_time_val time_start, timeout;
     pjsip_dialog *dlg = NULL;
@@ -1545,6 +1596,13 @@ pj_status_t acquire_call(const char *title,
     timeout.msec = PJSUA_ACQUIRE_CALL_TIMEOUT;
     pj_time_val_normalize(&timeout);
 
+    /* Only the slot lock of this call is needed to keep the dialog
+     * alive while we try to lock it, so callers working on different
+     * calls do not contend with each other (nor with the PJSUA lock).
+     * The dialog lock is only tried while holding the slot lock, since
+     * the slot lock is taken inside the dialog lock when the call is
+     * detached.
+     */
     for (retry=0; ; ++retry) {
 
         if (retry % 10 == 9) {
@@ -1556,48 +1614,34 @@ pj_status_t acquire_call(const char *title,
                 break;
         }
 
-	has_pjsua_lock = PJ_FALSE;
-
-	status = PJSUA_TRY_LOCK();
-	if (status != PJ_SUCCESS) {
-	    pj_thread_sleep(retry/10);
-	    continue;
-	}
+	pj_mutex_lock(call->lock);
 
-	has_pjsua_lock = PJ_TRUE;
-	call = &pjsua_var.calls[call_id];
         if (call->inv)
             dlg = call->inv->dlg;
         else
             dlg = call->async_call.dlg;
 
 	if (dlg == NULL) {
-	    PJSUA_UNLOCK();
+	    pj_mutex_unlock(call->lock);
 	    PJ_LOG(3,(THIS_FILE, "Invalid call_id %d in %s", call_id, title));
 	    return PJSIP_ESESSIONTERMINATED;
 	}
 
 	status = pjsip_dlg_try_inc_lock(dlg);
+	pj_mutex_unlock(call->lock);
+
 	if (status != PJ_SUCCESS) {
-	    PJSUA_UNLOCK();
 	    pj_thread_sleep(retry/10);
 	    continue;
 	}
 
-	PJSUA_UNLOCK();
-
 	break;
     }
 
     if (status != PJ_SUCCESS) {
-	if (has_pjsua_lock == PJ_FALSE)
-	    PJ_LOG(1,(THIS_FILE, "Timed-out trying to acquire PJSUA mutex "
-				 "(possibly system has deadlocked) in %s",
-				 title));
-	else
-	    PJ_LOG(1,(THIS_FILE, "Timed-out trying to acquire dialog mutex "
-				 "(possibly system has deadlocked) in %s",
-				 title));
+	PJ_LOG(1,(THIS_FILE, "Timed-out trying to acquire dialog mutex "
+			     "(possibly system has deadlocked) in %s",
+			     title));
 	return PJ_ETIMEDOUT;
     }
 
@@ -1616,22 +1660,24 @@ PJ_DEF(pj_status_t) pjsua_call_get_info( pjsua_call_id call_id,
 {
     pjsua_call *call;
     pjsip_dialog *dlg;
-    unsigned mi;
+    const pjsua_call_media_snap *snap;
 
     PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
 		     PJ_EINVAL);
 
     pj_bzero(info, sizeof(*info));
 
-    /* Use PJSUA_LOCK() instead of acquire_call():
-     *  https://trac.pjsip.org/repos/ticket/1371
+    /* Don't use acquire_call() here (see
+     *  https://trac.pjsip.org/repos/ticket/1371), only hold the slot
+     * lock, which keeps the dialog from being destroyed while we copy
+     * from it without contending with other calls.
      */
-    PJSUA_LOCK();
-
     call = &pjsua_var.calls[call_id];
+    pj_mutex_lock(call->lock);
+
     dlg = (call->inv ? call->inv->dlg : call->async_call.dlg);
     if (!dlg) {
-	PJSUA_UNLOCK();
+	pj_mutex_unlock(call->lock);
 	return PJSIP_ESESSIONTERMINATED;
     }
 
@@ -1706,80 +1752,6 @@ PJ_DEF(pj_status_t) pjsua_call_get_info( pjsua_call_id call_id,
 		   sizeof(info->buf_.last_status_text));
     }
 
-    /* Audio & video count offered by remote */
-    info->rem_offerer   = call->rem_offerer;
-    if (call->rem_offerer) {
-	info->rem_aud_cnt = call->rem_aud_cnt;
-	info->rem_vid_cnt = call->rem_vid_cnt;
-    }
-
-    /* Build array of active media info */
-    info->media_cnt = 0;
-    for (mi=0; mi < call->med_cnt &&
-	       info->media_cnt < PJ_ARRAY_SIZE(info->media); ++mi)
-    {
-	pjsua_call_media *call_med = &call->media[mi];
-
-	info->media[info->media_cnt].index = mi;
-	info->media[info->media_cnt].status = call_med->state;
-	info->media[info->media_cnt].dir = call_med->dir;
-	info->media[info->media_cnt].type = call_med->type;
-
-	if (call_med->type == PJMEDIA_TYPE_AUDIO) {
-	    info->media[info->media_cnt].stream.aud.conf_slot =
-						call_med->strm.a.conf_slot;
-	} else if (call_med->type == PJMEDIA_TYPE_VIDEO) {
-	    pjmedia_vid_dev_index cap_dev = PJMEDIA_VID_INVALID_DEV;
-
-	    info->media[info->media_cnt].stream.vid.win_in =
-						call_med->strm.v.rdr_win_id;
-
-	    if (call_med->strm.v.cap_win_id != PJSUA_INVALID_ID) {
-		cap_dev = call_med->strm.v.cap_dev;
-	    }
-	    info->media[info->media_cnt].stream.vid.cap_dev = cap_dev;
-	} else {
-	    continue;
-	}
-	++info->media_cnt;
-    }
-
-    if (call->audio_idx != -1) {
-	info->media_status = call->media[call->audio_idx].state;
-	info->media_dir = call->media[call->audio_idx].dir;
-	info->conf_slot = call->media[call->audio_idx].strm.a.conf_slot;
-    }
-
-    /* Build array of provisional media info */
-    info->prov_media_cnt = 0;
-    for (mi=0; mi < call->med_prov_cnt &&
-	       info->prov_media_cnt < PJ_ARRAY_SIZE(info->prov_media); ++mi)
-    {
-	pjsua_call_media *call_med = &call->media_prov[mi];
-
-	info->prov_media[info->prov_media_cnt].index = mi;
-	info->prov_media[info->prov_media_cnt].status = call_med->state;
-	info->prov_media[info->prov_media_cnt].dir = call_med->dir;
-	info->prov_media[info->prov_media_cnt].type = call_med->type;
-	if (call_med->type == PJMEDIA_TYPE_AUDIO) {
-	    info->prov_media[info->prov_media_cnt].stream.aud.conf_slot =
-						call_med->strm.a.conf_slot;
-	} else if (call_med->type == PJMEDIA_TYPE_VIDEO) {
-	    pjmedia_vid_dev_index cap_dev = PJMEDIA_VID_INVALID_DEV;
-
-	    info->prov_media[info->prov_media_cnt].stream.vid.win_in =
-						call_med->strm.v.rdr_win_id;
-
-	    if (call_med->strm.v.cap_win_id != PJSUA_INVALID_ID) {
-		cap_dev = call_med->strm.v.cap_dev;
-	    }
-	    info->prov_media[info->prov_media_cnt].stream.vid.cap_dev=cap_dev;
-	} else {
-	    continue;
-	}
-	++info->prov_media_cnt;
-    }
-
     /* calculate duration */
     if (info->state >= PJSIP_INV_STATE_DISCONNECTED) {
 
@@ -1804,11 +1776,103 @@ PJ_DEF(pj_status_t) pjsua_call_get_info( pjsua_call_id call_id,
 	PJ_TIME_VAL_SUB(info->total_duration, call->start_time);
     }
 
-    PJSUA_UNLOCK();
+    /* Media info published by pjsua_media.c */
+    snap = &call->media_snap;
+    info->rem_offerer = snap->rem_offerer;
+    if (snap->rem_offerer) {
+	info->rem_aud_cnt = snap->rem_aud_cnt;
+	info->rem_vid_cnt = snap->rem_vid_cnt;
+    }
+    info->media_status = snap->media_status;
+    info->media_dir = snap->media_dir;
+    info->conf_slot = snap->conf_slot;
+    info->media_cnt = snap->media_cnt;
+    pj_memcpy(info->media, snap->media,
+	      snap->media_cnt * sizeof(info->media[0]));
+    info->prov_media_cnt = snap->prov_media_cnt;
+    pj_memcpy(info->prov_media, snap->prov_media,
+	      snap->prov_media_cnt * sizeof(info->prov_media[0]));
+
+    pj_mutex_unlock(call->lock);
 
     return PJ_SUCCESS;
 }
 
+/* Fill in the info of a media of the call. Return PJ_FALSE if the media
+ * is not to be reported.
+ */
+static pj_bool_t get_media_info(const pjsua_call_media *call_med,
+				unsigned index, pjsua_call_media_info *mi)
+{
+    mi->index = index;
+    mi->status = call_med->state;
+    mi->dir = call_med->dir;
+    mi->type = call_med->type;
+
+    if (call_med->type == PJMEDIA_TYPE_AUDIO) {
+	mi->stream.aud.conf_slot = call_med->strm.a.conf_slot;
+    } else if (call_med->type == PJMEDIA_TYPE_VIDEO) {
+	pjmedia_vid_dev_index cap_dev = PJMEDIA_VID_INVALID_DEV;
+
+	mi->stream.vid.win_in = call_med->strm.v.rdr_win_id;
+
+	if (call_med->strm.v.cap_win_id != PJSUA_INVALID_ID) {
+	    cap_dev = call_med->strm.v.cap_dev;
+	}
+	mi->stream.vid.cap_dev = cap_dev;
+    } else {
+	return PJ_FALSE;
+    }
+
+    return PJ_TRUE;
+}
+
+/*
+ * Publish the media info of the call for pjsua_call_get_info(). This is
+ * called by the media code, which modifies the media with PJSUA lock held.
+ */
+void pjsua_call_publish_media(pjsua_call *call)
+{
+    pjsua_call_media_snap snap;
+    unsigned mi;
+
+    pj_bzero(&snap, sizeof(snap));
+
+    /* Audio & video count offered by remote */
+    snap.rem_offerer = call->rem_offerer;
+    snap.rem_aud_cnt = call->rem_aud_cnt;
+    snap.rem_vid_cnt = call->rem_vid_cnt;
+
+    /* Build array of active media info */
+    for (mi=0; mi < call->med_cnt &&
+	       snap.media_cnt < PJ_ARRAY_SIZE(snap.media); ++mi)
+    {
+	if (get_media_info(&call->media[mi], mi, &snap.media[snap.media_cnt]))
+	    ++snap.media_cnt;
+    }
+
+    if (call->audio_idx != -1) {
+	snap.media_status = call->media[call->audio_idx].state;
+	snap.media_dir = call->media[call->audio_idx].dir;
+	snap.conf_slot = call->media[call->audio_idx].strm.a.conf_slot;
+    }
+
+    /* Build array of provisional media info */
+    for (mi=0; mi < call->med_prov_cnt &&
+	       snap.prov_media_cnt < PJ_ARRAY_SIZE(snap.prov_media); ++mi)
+    {
+	if (get_media_info(&call->media_prov[mi], mi,
+			   &snap.prov_media[snap.prov_media_cnt]))
+	{
+	    ++snap.prov_media_cnt;
+	}
+    }
+
+    pj_mutex_lock(call->lock);
+    pj_memcpy(&call->media_snap, &snap, sizeof(snap));
+    pj_mutex_unlock(call->lock);
+}
+
 /*
  * Check if call remote peer support the specified capability.
  */
@@ -2943,7 +3007,7 @@ PJ_DEF(void) pjsua_call_hangup_all(void)
     // This may deadlock, see https://trac.pjsip.org/repos/ticket/1305
     //PJSUA_LOCK();
 
-    for (i=0; i<pjsua_var.ua_cfg.max_calls; ++i) {
+    for (i=0; pjsua_var.calls && i<pjsua_var.ua_cfg.max_calls; ++i) {
 	if (pjsua_var.calls[i].inv)
 	    pjsua_call_hangup(i, 0, NULL, NULL);
     }
@@ -3574,13 +3638,14 @@ static void pjsua_call_on_state_changed(pjsip_inv_session *inv,
 	pjsua_media_channel_deinit(call->index);
 
 	/* Free call */
-	call->inv = NULL;
+	detach_call(call);
 
 	pj_assert(pjsua_var.call_cnt > 0);
 	--pjsua_var.call_cnt;
 
 	/* Reset call */
 	reset_call(call->index);
+	release_call_id(call->index);
 
 	pjsua_check_snd_dev_idle();
 
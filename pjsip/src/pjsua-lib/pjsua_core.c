@@ -103,6 +103,7 @@ PJ_DEF(void) pjsua_config_default(pjsua_config *cfg)
     pj_bzero(cfg, sizeof(*cfg));
 
     cfg->max_calls = ((PJSUA_MAX_CALLS) < 4) ? (PJSUA_MAX_CALLS) : 4;
+    cfg->max_buddies = PJSUA_MAX_BUDDIES;
     cfg->thread_cnt = 1;
     cfg->nat_type_in_sdp = 1;
     cfg->stun_ignore_failure = PJ_TRUE;
@@ -1558,7 +1559,7 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
 	}
 
 	/* Deinit media channel of all calls (see #1717) */
-	for (i=0; i<(int)pjsua_var.ua_cfg.max_calls; ++i) {
+	for (i=0; pjsua_var.calls && i<(int)pjsua_var.ua_cfg.max_calls; ++i) {
 	    /* TODO: check if we're not allowed to send to network in the
 	     *       "flags", and if so do not do TURN allocation...
 	     */
@@ -1691,7 +1692,7 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
 	pjsua_var.endpt = NULL;
 
 	/* Destroy pool in the buddy object */
-	for (i=0; i<(int)PJ_ARRAY_SIZE(pjsua_var.buddy); ++i) {
+	for (i=0; pjsua_var.buddy && i<(int)pjsua_var.ua_cfg.max_buddies; ++i) {
 	    if (pjsua_var.buddy[i].pool) {
 		pj_pool_release(pjsua_var.buddy[i].pool);
 		pjsua_var.buddy[i].pool = NULL;
@@ -1707,6 +1708,14 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
 	}
     }
 
+    /* Destroy call slot locks */
+    for (i=0; pjsua_var.calls && i<(int)pjsua_var.ua_cfg.max_calls; ++i) {
+	if (pjsua_var.calls[i].lock) {
+	    pj_mutex_destroy(pjsua_var.calls[i].lock);
+	    pjsua_var.calls[i].lock = NULL;
+	}
+    }
+
     /* Destroy mutex */
     if (pjsua_var.mutex) {
 	pj_mutex_destroy(pjsua_var.mutex);
@@ -655,6 +655,8 @@ static void on_ice_complete(pjmedia_transport *tp,
         } else {
 	    call_med->state = PJSUA_CALL_MEDIA_ERROR;
 	    call_med->dir = PJMEDIA_DIR_NONE;
+	    if (call)
+		pjsua_call_publish_media(call);
 	    if (call && pjsua_var.ua_cfg.cb.on_call_media_state) {
 		/* Defer the callback to a timer */
 		pjsua_schedule_timer2(&ice_failed_nego_cb,
@@ -1506,6 +1508,8 @@ static pj_status_t media_channel_init_cb(pjsua_call_id call_id,
     call->med_ch_info.status = PJ_SUCCESS;
 
 on_return:
+    pjsua_call_publish_media(call);
+
     if (call->med_ch_cb)
         (*call->med_ch_cb)(call->index, &call->med_ch_info);
 
@@ -1844,6 +1848,7 @@ pj_status_t pjsua_media_channel_init(pjsua_call_id call_id,
         /* We shouldn't use temporary pool anymore. */
         call->async_call.pool_prov = NULL;
         /* We have a pending media transport initialization. */
+        pjsua_call_publish_media(call);
         pj_log_pop_indent();
         return PJ_EPENDING;
     }
@@ -2190,6 +2195,7 @@ pj_status_t pjsua_media_channel_create_sdp(pjsua_call_id call_id,
 #endif
 
     call->rem_offerer = (rem_sdp != NULL);
+    pjsua_call_publish_media(call);
 
     /* Notify application */
     if (pjsua_var.ua_cfg.cb.on_call_sdp_created) {
@@ -2310,6 +2316,7 @@ pj_status_t pjsua_media_channel_deinit(pjsua_call_id call_id)
         call_med->tp_orig = NULL;
     }
 
+    pjsua_call_publish_media(call);
     pj_log_pop_indent();
 
     return PJ_SUCCESS;
@@ -2937,10 +2944,12 @@ pj_status_t pjsua_media_channel_update(pjsua_call_id call_id,
 	    goto on_error;
     }
 
+    pjsua_call_publish_media(call);
     pj_log_pop_indent();
     return (got_media? PJ_SUCCESS : PJMEDIA_SDPNEG_ENOMEDIA);
 
 on_error:
+    pjsua_call_publish_media(call);
     pj_log_pop_indent();
     return status;
 }
@@ -28,13 +28,100 @@ static void subscribe_buddy_presence(pjsua_buddy_id buddy_id);
 static void unsubscribe_buddy_presence(pjsua_buddy_id buddy_id);
 
 
+/*
+ * Build the buddy URI table key. Port zero is treated as 5060.
+ */
+static int make_buddy_key(char *buf, unsigned size, const pj_str_t *user,
+			  const pj_str_t *host, unsigned port)
+{
+    int len;
+
+    len = pj_ansi_snprintf(buf, size, "%.*s@%.*s:%u",
+			   (int)user->slen, user->ptr,
+			   (int)host->slen, host->ptr,
+			   (port ? port : 5060));
+    if (len < 0 || len >= (int)size)
+	return -1;
+    return len;
+}
+
+
+/*
+ * Add buddy to the buddy URI table. Buddies sharing the same URI are
+ * chained behind the one that is registered in the table.
+ */
+static void buddy_ht_add(pjsua_buddy_id id)
+{
+    pjsua_buddy *b = &pjsua_var.buddy[id];
+    pjsua_buddy *head;
+    char key[PJSIP_MAX_URL_SIZE];
+    int len;
+
+    b->ht_next = PJSUA_INVALID_ID;
+
+    len = make_buddy_key(key, sizeof(key), &b->name, &b->host, b->port);
+    if (len < 0)
+	return;
+    pj_strdup2(b->pool, &b->ht_key, key);
+
+    head = (pjsua_buddy*) pj_hash_get_lower(pjsua_var.buddy_ht,
+					    b->ht_key.ptr,
+					    (unsigned)b->ht_key.slen, NULL);
+    if (head) {
+	while (head->ht_next != PJSUA_INVALID_ID)
+	    head = &pjsua_var.buddy[head->ht_next];
+	head->ht_next = id;
+    } else {
+	pj_hash_set_np_lower(pjsua_var.buddy_ht, b->ht_key.ptr,
+			     (unsigned)b->ht_key.slen, 0, b->ht_entry, b);
+    }
+}
+
+
+/*
+ * Remove buddy from the buddy URI table.
+ */
+static void buddy_ht_remove(pjsua_buddy_id id)
+{
+    pjsua_buddy *b = &pjsua_var.buddy[id];
+    pjsua_buddy *head;
+
+    if (b->ht_key.slen == 0)
+	return;
+
+    head = (pjsua_buddy*) pj_hash_get_lower(pjsua_var.buddy_ht,
+					    b->ht_key.ptr,
+					    (unsigned)b->ht_key.slen, NULL);
+    if (head == b) {
+	/* Replace the table entry with the next buddy in the chain */
+	pj_hash_set_np_lower(pjsua_var.buddy_ht, b->ht_key.ptr,
+			     (unsigned)b->ht_key.slen, 0, b->ht_entry, NULL);
+	if (b->ht_next != PJSUA_INVALID_ID) {
+	    pjsua_buddy *next = &pjsua_var.buddy[b->ht_next];
+	    pj_hash_set_np_lower(pjsua_var.buddy_ht, next->ht_key.ptr,
+				 (unsigned)next->ht_key.slen, 0,
+				 next->ht_entry, next);
+	}
+    } else if (head) {
+	while (head->ht_next != PJSUA_INVALID_ID && head->ht_next != (int)id)
+	    head = &pjsua_var.buddy[head->ht_next];
+	if (head->ht_next == (int)id)
+	    head->ht_next = b->ht_next;
+    }
+
+    b->ht_key.slen = 0;
+    b->ht_next = PJSUA_INVALID_ID;
+}
+
+
 /*
  * Find buddy.
  */
 static pjsua_buddy_id find_buddy(const pjsip_uri *uri)
 {
     const pjsip_sip_uri *sip_uri;
-    unsigned i;
+    char key[PJSIP_MAX_URL_SIZE];
+    int len;
 
     uri = (const pjsip_uri*) pjsip_uri_get_uri((pjsip_uri*)uri);
 
@@ -43,19 +130,16 @@ static pjsua_buddy_id find_buddy(const pjsip_uri *uri)
 
     sip_uri = (const pjsip_sip_uri*) uri;
 
-    for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.buddy); ++i) {
-	const pjsua_buddy *b = &pjsua_var.buddy[i];
+    /* Lookup the buddy URI table with "user@host:port" key */
+    len = make_buddy_key(key, sizeof(key), &sip_uri->user, &sip_uri->host,
+			 sip_uri->port);
+    if (len > 0) {
+	pjsua_buddy *b;
 
-	if (!pjsua_buddy_is_valid(i))
-	    continue;
-
-	if (pj_stricmp(&sip_uri->user, &b->name)==0 &&
-	    pj_stricmp(&sip_uri->host, &b->host)==0 &&
-	    (sip_uri->port==(int)b->port || (sip_uri->port==0 && b->port==5060)))
-	{
-	    /* Match */
-	    return i;
-	}
+	b = (pjsua_buddy*) pj_hash_get_lower(pjsua_var.buddy_ht, key, len,
+					     NULL);
+	if (b)
+	    return b->index;
     }
 
     return PJSUA_INVALID_ID;
@@ -185,7 +269,7 @@ PJ_DEF(pjsua_buddy_id) pjsua_buddy_find(const pj_str_t *uri_str)
  */
 PJ_DEF(pj_bool_t) pjsua_buddy_is_valid(pjsua_buddy_id buddy_id)
 {
-    return buddy_id>=0 && buddy_id<(int)PJ_ARRAY_SIZE(pjsua_var.buddy) &&
+    return buddy_id>=0 && buddy_id<(int)pjsua_var.ua_cfg.max_buddies &&
 	   pjsua_var.buddy[buddy_id].uri.slen != 0;
 }
 
@@ -202,7 +286,7 @@ PJ_DEF(pj_status_t) pjsua_enum_buddies( pjsua_buddy_id ids[],
 
     PJSUA_LOCK();
 
-    for (i=0, c=0; c<*count && i<PJ_ARRAY_SIZE(pjsua_var.buddy); ++i) {
+    for (i=0, c=0; c<*count && i<pjsua_var.ua_cfg.max_buddies; ++i) {
 	if (!pjsua_var.buddy[i].uri.slen)
 	    continue;
 	ids[c] = i;
@@ -386,7 +470,7 @@ PJ_DEF(pj_status_t) pjsua_buddy_add( const pjsua_buddy_config *cfg,
     pj_str_t tmp;
 
     PJ_ASSERT_RETURN(pjsua_var.buddy_cnt <= 
-			PJ_ARRAY_SIZE(pjsua_var.buddy),
+			pjsua_var.ua_cfg.max_buddies,
 		     PJ_ETOOMANY);
 
     PJ_LOG(4,(THIS_FILE, "Adding buddy: %.*s",
@@ -395,20 +479,13 @@ PJ_DEF(pj_status_t) pjsua_buddy_add( const pjsua_buddy_config *cfg,
 
     PJSUA_LOCK();
 
-    /* Find empty slot */
-    for (index=0; index<(int)PJ_ARRAY_SIZE(pjsua_var.buddy); ++index) {
-	if (pjsua_var.buddy[index].uri.slen == 0)
-	    break;
-    }
-
-    /* Expect to find an empty slot */
-    if (index == PJ_ARRAY_SIZE(pjsua_var.buddy)) {
+    /* Take an empty slot from the free list */
+    if (pjsua_var.buddy_free_cnt == 0) {
 	PJSUA_UNLOCK();
-	/* This shouldn't happen */
-	pj_assert(!"index < PJ_ARRAY_SIZE(pjsua_var.buddy)");
 	pj_log_pop_indent();
 	return PJ_ETOOMANY;
     }
+    index = pjsua_var.buddy_free[--pjsua_var.buddy_free_cnt];
 
     buddy = &pjsua_var.buddy[index];
 
@@ -435,6 +512,7 @@ PJ_DEF(pj_status_t) pjsua_buddy_add( const pjsua_buddy_config *cfg,
 	pjsua_perror(THIS_FILE, "Unable to add buddy", PJSIP_EINVALIDURI);
 	pj_pool_release(buddy->pool);
 	buddy->pool = NULL;
+	pjsua_var.buddy_free[pjsua_var.buddy_free_cnt++] = index;
 	PJSUA_UNLOCK();
 	pj_log_pop_indent();
 	return PJSIP_EINVALIDURI;
@@ -444,6 +522,7 @@ PJ_DEF(pj_status_t) pjsua_buddy_add( const pjsua_buddy_config *cfg,
     if (!PJSIP_URI_SCHEME_IS_SIP(url) && !PJSIP_URI_SCHEME_IS_SIPS(url)) {
 	pj_pool_release(buddy->pool);
 	buddy->pool = NULL;
+	pjsua_var.buddy_free[pjsua_var.buddy_free_cnt++] = index;
 	PJSUA_UNLOCK();
 	pj_log_pop_indent();
 	return PJSIP_EINVALIDSCHEME;
@@ -466,6 +545,9 @@ PJ_DEF(pj_status_t) pjsua_buddy_add( const pjsua_buddy_config *cfg,
     if (pjsua_var.buddy[index].port == 0)
 	pjsua_var.buddy[index].port = 5060;
 
+    /* Register to the buddy URI table */
+    buddy_ht_add(index);
+
     /* Save user data */
     pjsua_var.buddy[index].user_data = (void*)cfg->user_data;
 
@@ -494,7 +576,7 @@ PJ_DEF(pj_status_t) pjsua_buddy_del(pjsua_buddy_id buddy_id)
     pj_status_t status;
 
     PJ_ASSERT_RETURN(buddy_id>=0 && 
-			buddy_id<(int)PJ_ARRAY_SIZE(pjsua_var.buddy),
+			buddy_id<(int)pjsua_var.ua_cfg.max_buddies,
 		     PJ_EINVAL);
 
     if (pjsua_var.buddy[buddy_id].uri.slen == 0) {
@@ -518,6 +600,7 @@ PJ_DEF(pj_status_t) pjsua_buddy_del(pjsua_buddy_id buddy_id)
     }
 
     /* Remove buddy */
+    buddy_ht_remove(buddy_id);
     pjsua_var.buddy[buddy_id].uri.slen = 0;
     pjsua_var.buddy_cnt--;
 
@@ -529,6 +612,7 @@ PJ_DEF(pj_status_t) pjsua_buddy_del(pjsua_buddy_id buddy_id)
 
     /* Reset buddy struct */
     reset_buddy(buddy_id);
+    pjsua_var.buddy_free[pjsua_var.buddy_free_cnt++] = buddy_id;
 
     unlock_buddy(&lck);
     pj_log_pop_indent();
@@ -645,7 +729,7 @@ PJ_DEF(void) pjsua_pres_dump(pj_bool_t verbose)
 
 	count = 0;
 
-	for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.buddy); ++i) {
+	for (i=0; i<pjsua_var.ua_cfg.max_buddies; ++i) {
 	    if (pjsua_var.buddy[i].uri.slen == 0)
 		continue;
 	    if (pjsua_var.buddy[i].sub) {
@@ -703,7 +787,7 @@ PJ_DEF(void) pjsua_pres_dump(pj_bool_t verbose)
 	PJ_LOG(3,(THIS_FILE, "  - no buddy list - "));
 
     } else {
-	for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.buddy); ++i) {
+	for (i=0; i<pjsua_var.ua_cfg.max_buddies; ++i) {
 
 	    if (pjsua_var.buddy[i].uri.slen == 0)
 		continue;
@@ -1964,7 +2048,7 @@ static pj_status_t refresh_client_subscriptions(void)
     unsigned i;
     pj_status_t status;
 
-    for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.buddy); ++i) {
+    for (i=0; i<pjsua_var.ua_cfg.max_buddies; ++i) {
 	struct buddy_lock lck;
 
 	if (!pjsua_buddy_is_valid(i))
@@ -2397,8 +2481,24 @@ pj_status_t pjsua_pres_init()
 		     status);
     }
 
-    for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.buddy); ++i) {
-	reset_buddy(i);
+    /* Create the buddy table. The free list is filled backwards so that
+     * the lowest index is handed out first.
+     */
+    pjsua_var.buddy = (pjsua_buddy*)
+		      pj_pool_calloc(pjsua_var.pool,
+				     pjsua_var.ua_cfg.max_buddies,
+				     sizeof(pjsua_buddy));
+    pjsua_var.buddy_free = (pjsua_buddy_id*)
+			   pj_pool_calloc(pjsua_var.pool,
+					  pjsua_var.ua_cfg.max_buddies,
+					  sizeof(pjsua_buddy_id));
+    pjsua_var.buddy_ht = pj_hash_create(pjsua_var.pool,
+					pjsua_var.ua_cfg.max_buddies);
+    pjsua_var.buddy_free_cnt = 0;
+
+    for (i=pjsua_var.ua_cfg.max_buddies; i>0; --i) {
+	reset_buddy(i-1);
+	pjsua_var.buddy_free[pjsua_var.buddy_free_cnt++] = i-1;
     }
 
     return status;
@@ -2453,7 +2553,7 @@ void pjsua_pres_shutdown(unsigned flags)
 	pjsua_pres_delete_acc(i, flags);
     }
 
-    for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.buddy); ++i) {
+    for (i=0; i<pjsua_var.ua_cfg.max_buddies; ++i) {
 	pjsua_var.buddy[i].monitor = 0;
     }
 
@@ -26,7 +26,7 @@
 #if PJSUA_HAS_VIDEO
 
 #define ENABLE_EVENT	    	1
-#define VID_TEE_MAX_PORT    	(PJSUA_MAX_CALLS + 1)
+#define VID_TEE_MAX_PORT    	(pjsua_var.ua_cfg.max_calls + 1)
 
 #define PJSUA_SHOW_WINDOW	1
 #define PJSUA_HIDE_WINDOW	0
@@ -2133,6 +2133,8 @@ PJ_DEF(pj_status_t) pjsua_call_set_vid_strm (
 	break;
     }
 
+    pjsua_call_publish_media(call);
+
 on_return:
     if (dlg) pjsip_dlg_dec_lock(dlg);
     pj_log_pop_indent();
@@ -58,6 +58,7 @@ void UaConfig::fromPj(const pjsua_config &ua_cfg)
     unsigned i;
 
     this->maxCalls = ua_cfg.max_calls;
+    this->maxBuddies = ua_cfg.max_buddies;
     this->threadCnt = ua_cfg.thread_cnt;
     this->userAgent = pj2Str(ua_cfg.user_agent);
 
@@ -82,6 +83,7 @@ pjsua_config UaConfig::toPj() const
     pjsua_config_default(&pua_cfg);
 
     pua_cfg.max_calls = this->maxCalls;
+    pua_cfg.max_buddies = this->maxBuddies;
     pua_cfg.thread_cnt = this->threadCnt;
     pua_cfg.user_agent = str2Pj(this->userAgent);
 
@@ -110,6 +112,7 @@ void UaConfig::readObject(const ContainerNode &node) throw(Error)
     ContainerNode this_node = node.readContainer("UaConfig");
 
     NODE_READ_UNSIGNED( this_node, maxCalls);
+    NODE_READ_UNSIGNED( this_node, maxBuddies);
     NODE_READ_UNSIGNED( this_node, threadCnt);
     NODE_READ_BOOL    ( this_node, mainThreadOnly);
     NODE_READ_STRINGV ( this_node, nameserver);
@@ -125,6 +128,7 @@ void UaConfig::writeObject(ContainerNode &node) const throw(Error)
     ContainerNode this_node = node.writeNewContainer("UaConfig");
 
     NODE_WRITE_UNSIGNED( this_node, maxCalls);
+    NODE_WRITE_UNSIGNED( this_node, maxBuddies);
     NODE_WRITE_UNSIGNED( this_node, threadCnt);
     NODE_WRITE_BOOL    ( this_node, mainThreadOnly);
     NODE_WRITE_STRINGV ( this_node, nameserver);
@@ -0,0 +1,509 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+#include <pjsip.h>
+#include <pjlib-util.h>
+#include <pjlib.h>
+
+#define THIS_FILE   "auth_test.c"
+
+#define REALM	    "example.com"
+#define NONCE_KEY   "secret"
+#define NONCE_LEN   40
+
+
+/* Accounts known to the lookup function */
+static struct account
+{
+    const char	*user;
+    const char	*passwd;
+} accounts[] =
+{
+    { "alice", "alice-pwd" },
+    { "bob", "bob-pwd" },
+    { "carol", "carol-pwd" },
+};
+
+static unsigned lookup_cnt;
+static unsigned cnonce_cnt;
+
+
+static pj_status_t lookup(pj_pool_t *pool,
+			  const pj_str_t *realm,
+			  const pj_str_t *acc_name,
+			  pjsip_cred_info *cred_info)
+{
+    unsigned i;
+
+    ++lookup_cnt;
+
+    for (i=0; i<PJ_ARRAY_SIZE(accounts); ++i) {
+	if (pj_strcmp2(acc_name, accounts[i].user) == 0) {
+	    pj_bzero(cred_info, sizeof(*cred_info));
+	    pj_strdup(pool, &cred_info->realm, realm);
+	    pj_strdup(pool, &cred_info->username, acc_name);
+	    cred_info->data_type = PJSIP_CRED_DATA_PLAIN_PASSWD;
+	    pj_strdup2(pool, &cred_info->data, accounts[i].passwd);
+	    return PJ_SUCCESS;
+	}
+    }
+
+    return PJSIP_EAUTHACCNOTFOUND;
+}
+
+
+/* Create authentication server with cache. */
+static pj_status_t create_srv(pj_pool_t *pool, pjsip_auth_srv *srv,
+			      const char *nonce_key, unsigned cred_count)
+{
+    pjsip_auth_srv_cache_setting setting;
+    pj_str_t realm = pj_str(REALM);
+    pj_status_t status;
+
+    status = pjsip_auth_srv_init(pool, srv, &realm, &lookup, 0);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    pjsip_auth_srv_cache_setting_default(&setting);
+    if (nonce_key)
+	setting.nonce_key = pj_str((char*)nonce_key);
+    setting.cred_count = cred_count;
+
+    return pjsip_auth_srv_set_cache(srv, pool, &setting);
+}
+
+
+/* Get the nonce of a new challenge. */
+static int get_nonce(pjsip_auth_srv *srv, char nonce[NONCE_LEN+1])
+{
+    pj_str_t qop = pj_str("auth");
+    pjsip_tx_data *tdata;
+    pjsip_www_authenticate_hdr *hdr;
+    const pj_str_t *str;
+    pj_status_t status;
+
+    status = pjsip_endpt_create_tdata(endpt, &tdata);
+    if (status != PJ_SUCCESS)
+	return -10;
+
+    pjsip_tx_data_add_ref(tdata);
+    tdata->msg = pjsip_msg_create(tdata->pool, PJSIP_RESPONSE_MSG);
+    status = pjsip_auth_srv_challenge(srv, &qop, NULL, NULL, PJ_FALSE,
+				      tdata);
+    if (status != PJ_SUCCESS) {
+	pjsip_tx_data_dec_ref(tdata);
+	return -20;
+    }
+
+    hdr = (pjsip_www_authenticate_hdr*)
+	  pjsip_msg_find_hdr(tdata->msg, PJSIP_H_WWW_AUTHENTICATE, NULL);
+    str = &hdr->challenge.digest.nonce;
+    if (str->slen != NONCE_LEN) {
+	pjsip_tx_data_dec_ref(tdata);
+	return -30;
+    }
+
+    pj_memcpy(nonce, str->ptr, NONCE_LEN);
+    nonce[NONCE_LEN] = '\0';
+    pjsip_tx_data_dec_ref(tdata);
+    return 0;
+}
+
+
+/* Create the nonce for the timestamp the way the server signs them. */
+static void sign_nonce(pj_uint32_t ts, char nonce[NONCE_LEN+1])
+{
+    static const char hex[] = "0123456789abcdef";
+    pj_md5_context md5;
+    pj_hmac_md5_context ctx;
+    pj_uint8_t key[16], digest[16];
+    unsigned i;
+
+    pj_md5_init(&md5);
+    pj_md5_update(&md5, (const pj_uint8_t*)NONCE_KEY,
+		  (unsigned)strlen(NONCE_KEY));
+    pj_md5_final(&md5, key);
+
+    for (i=0; i<4; ++i)
+	pj_val_to_hex_digit((ts >> (24 - i*8)) & 0xFF, nonce + i*2);
+
+    pj_hmac_md5_init(&ctx, key, sizeof(key));
+    pj_hmac_md5_update(&ctx, (const pj_uint8_t*)nonce, 8);
+    pj_hmac_md5_update(&ctx, (const pj_uint8_t*)":" REALM,
+		       (unsigned)strlen(":" REALM));
+    pj_hmac_md5_final(&ctx, digest);
+
+    for (i=0; i<sizeof(digest); ++i) {
+	nonce[8 + i*2] = hex[digest[i] >> 4];
+	nonce[8 + i*2 + 1] = hex[digest[i] & 0x0F];
+    }
+    nonce[NONCE_LEN] = '\0';
+}
+
+
+/* Verify REGISTER request with the specified credential. When cnonce is
+ * NULL, a new cnonce is used.
+ */
+static pj_status_t verify(pjsip_auth_srv *srv, pj_pool_t *pool,
+			  const char *user, const char *passwd,
+			  const char *nonce, unsigned nc,
+			  const char *cnonce, int *code)
+{
+    char cnonce_buf[16], nc_buf[9], digest_buf[PJSIP_MD5STRLEN];
+    pj_str_t s_nonce, s_nc, s_cnonce, s_qop, s_uri, s_realm, s_method;
+    pj_str_t digest;
+    pjsip_cred_info cred_info;
+    pjsip_rx_data *rdata;
+    char *msg;
+    int len;
+
+    if (!cnonce) {
+	pj_ansi_snprintf(cnonce_buf, sizeof(cnonce_buf), "c%u",
+			 ++cnonce_cnt);
+	cnonce = cnonce_buf;
+    }
+    pj_ansi_snprintf(nc_buf, sizeof(nc_buf), "%08x", nc);
+
+    pj_bzero(&cred_info, sizeof(cred_info));
+    cred_info.realm = pj_str(REALM);
+    cred_info.username = pj_str((char*)user);
+    cred_info.data_type = PJSIP_CRED_DATA_PLAIN_PASSWD;
+    cred_info.data = pj_str((char*)passwd);
+
+    s_nonce = pj_str((char*)nonce);
+    s_nc = pj_str(nc_buf);
+    s_cnonce = pj_str((char*)cnonce);
+    s_qop = pj_str("auth");
+    s_uri = pj_str("sip:" REALM);
+    s_realm = pj_str(REALM);
+    s_method = pj_str("REGISTER");
+
+    digest.ptr = digest_buf;
+    digest.slen = PJSIP_MD5STRLEN;
+    pjsip_auth_create_digest(&digest, &s_nonce, &s_nc, &s_cnonce, &s_qop,
+			     &s_uri, &s_realm, &cred_info, &s_method);
+
+    msg = (char*) pj_pool_alloc(pool, 1024);
+    len = pj_ansi_snprintf(msg, 1024,
+	"REGISTER sip:" REALM " SIP/2.0\r\n"
+	"Via: SIP/2.0/UDP 127.0.0.1:5060;branch=z9hG4bKauthtest\r\n"
+	"From: <sip:%s@" REALM ">;tag=1234\r\n"
+	"To: <sip:%s@" REALM ">\r\n"
+	"Call-ID: auth-test\r\n"
+	"CSeq: 1 REGISTER\r\n"
+	"Authorization: Digest username=\"%s\", realm=\"" REALM "\", "
+	"nonce=\"%s\", uri=\"sip:" REALM "\", response=\"%.*s\", "
+	"algorithm=MD5, qop=auth, nc=%s, cnonce=\"%s\"\r\n"
+	"Content-Length: 0\r\n"
+	"\r\n",
+	user, user, user, nonce, (int)digest.slen, digest.ptr, nc_buf,
+	cnonce);
+
+    rdata = PJ_POOL_ZALLOC_T(pool, pjsip_rx_data);
+    rdata->tp_info.pool = pool;
+    rdata->msg_info.msg = pjsip_parse_msg(pool, msg, len, NULL);
+    if (!rdata->msg_info.msg)
+	return PJSIP_EINVALIDMSG;
+
+    return pjsip_auth_srv_verify(srv, rdata, code);
+}
+
+
+/* Nonce generation and validation. */
+static int nonce_test(pj_pool_t *pool)
+{
+    pjsip_auth_srv srv1, srv2, rnd1, rnd2;
+    char nonce[NONCE_LEN+1], nonce2[NONCE_LEN+1], signed_nonce[NONCE_LEN+1];
+    pj_uint32_t ts = 0;
+    pj_time_val now;
+    pj_status_t status;
+    int code, rc = 0;
+    unsigned i;
+
+    PJ_LOG(3,(THIS_FILE, "  nonce test"));
+
+    if (create_srv(pool, &srv1, NONCE_KEY, 0) != PJ_SUCCESS ||
+	create_srv(pool, &srv2, NONCE_KEY, 0) != PJ_SUCCESS ||
+	create_srv(pool, &rnd1, NULL, 0) != PJ_SUCCESS ||
+	create_srv(pool, &rnd2, NULL, 0) != PJ_SUCCESS)
+    {
+	return -100;
+    }
+
+    /* Nonce is timestamp and its signature */
+    if (get_nonce(&srv1, nonce) != 0) {
+	rc = -110;
+	goto on_return;
+    }
+    for (i=0; i<8; ++i)
+	ts = (ts << 4) | pj_hex_digit_to_val(nonce[i]);
+    sign_nonce(ts, signed_nonce);
+    if (pj_ansi_strcmp(nonce, signed_nonce) != 0) {
+	PJ_LOG(3,(THIS_FILE, "   error: nonce %s, expecting %s", nonce,
+		  signed_nonce));
+	rc = -120;
+	goto on_return;
+    }
+
+    status = verify(&srv1, pool, "alice", "alice-pwd", nonce, 1, NULL,
+		    &code);
+    if (status != PJ_SUCCESS || code != 200) {
+	rc = -130;
+	goto on_return;
+    }
+
+    /* Servers sharing the key accept each other's nonce */
+    status = verify(&srv2, pool, "alice", "alice-pwd", nonce, 1, NULL,
+		    &code);
+    if (status != PJ_SUCCESS || code != 200) {
+	rc = -140;
+	goto on_return;
+    }
+
+    /* Tampered signature */
+    pj_ansi_strcpy(nonce2, nonce);
+    nonce2[NONCE_LEN-1] = (char)(nonce2[NONCE_LEN-1] == '0' ? '1' : '0');
+    status = verify(&srv1, pool, "alice", "alice-pwd", nonce2, 1, NULL,
+		    &code);
+    if (status != PJSIP_EAUTHINNONCE || code != 401) {
+	rc = -150;
+	goto on_return;
+    }
+
+    /* Tampered timestamp */
+    pj_ansi_strcpy(nonce2, nonce);
+    nonce2[7] = (char)(nonce2[7] == '0' ? '1' : '0');
+    status = verify(&srv1, pool, "alice", "alice-pwd", nonce2, 1, NULL,
+		    &code);
+    if (status != PJSIP_EAUTHINNONCE || code != 401) {
+	rc = -160;
+	goto on_return;
+    }
+
+    /* Expired nonce */
+    pj_gettimeofday(&now);
+    sign_nonce((pj_uint32_t)now.sec - PJSIP_AUTH_SRV_NONCE_EXPIRY - 5,
+	       nonce2);
+    status = verify(&srv1, pool, "alice", "alice-pwd", nonce2, 1, NULL,
+		    &code);
+    if (status != PJSIP_EAUTHSTALENONCE || code != 401) {
+	rc = -170;
+	goto on_return;
+    }
+
+    /* Random keys are different, and the nonce of one server is
+     * rejected by the other.
+     */
+    if (get_nonce(&rnd1, nonce) != 0 || get_nonce(&rnd2, nonce2) != 0) {
+	rc = -180;
+	goto on_return;
+    }
+    if (pj_ansi_strcmp(nonce, nonce2) == 0) {
+	rc = -190;
+	goto on_return;
+    }
+    status = verify(&rnd1, pool, "alice", "alice-pwd", nonce, 1, NULL,
+		    &code);
+    if (status != PJ_SUCCESS) {
+	rc = -200;
+	goto on_return;
+    }
+    status = verify(&rnd2, pool, "alice", "alice-pwd", nonce, 1, NULL,
+		    &code);
+    if (status != PJSIP_EAUTHINNONCE) {
+	rc = -210;
+	goto on_return;
+    }
+
+on_return:
+    pjsip_auth_srv_deinit(&srv1);
+    pjsip_auth_srv_deinit(&srv2);
+    pjsip_auth_srv_deinit(&rnd1);
+    pjsip_auth_srv_deinit(&rnd2);
+    return rc;
+}
+
+
+/* Nonce-count replay detection. */
+static int nc_test(pj_pool_t *pool)
+{
+    static struct nc_entry
+    {
+	const char	*cnonce;
+	unsigned	 nc;
+	pj_status_t	 status;
+    } entries[] =
+    {
+	{ "c1", 1, PJ_SUCCESS },
+	{ "c1", 1, PJSIP_EAUTHNCREPLAY },	/* Replayed */
+	{ "c1", 3, PJ_SUCCESS },
+	{ "c1", 2, PJ_SUCCESS },		/* Out of order */
+	{ "c1", 2, PJSIP_EAUTHNCREPLAY },
+	{ "c1", 0, PJSIP_EAUTHNCREPLAY },	/* Invalid */
+	{ "c2", 1, PJ_SUCCESS },		/* Other client */
+	{ "c1", 40, PJ_SUCCESS },
+	{ "c1", 9, PJ_SUCCESS },		/* Oldest in the window */
+	{ "c1", 9, PJSIP_EAUTHNCREPLAY },
+	{ "c1", 8, PJSIP_EAUTHNCREPLAY },	/* Below the window */
+	{ "c1", 41, PJ_SUCCESS },
+	{ "c1", 40, PJSIP_EAUTHNCREPLAY },
+	{ "c2", 2, PJ_SUCCESS },
+	{ "c2", 2, PJSIP_EAUTHNCREPLAY },
+    };
+    pjsip_auth_srv srv;
+    char nonce[NONCE_LEN+1];
+    int code, rc = 0;
+    unsigned i;
+
+    PJ_LOG(3,(THIS_FILE, "  nonce-count test"));
+
+    if (create_srv(pool, &srv, NONCE_KEY, 0) != PJ_SUCCESS)
+	return -300;
+
+    if (get_nonce(&srv, nonce) != 0) {
+	rc = -310;
+	goto on_return;
+    }
+
+    for (i=0; i<PJ_ARRAY_SIZE(entries); ++i) {
+	pj_status_t status;
+
+	status = verify(&srv, pool, "alice", "alice-pwd", nonce,
+			entries[i].nc, entries[i].cnonce, &code);
+	if (status != entries[i].status) {
+	    PJ_LOG(3,(THIS_FILE, "   error: cnonce %s nc %u: status %d, "
+		      "expecting %d", entries[i].cnonce, entries[i].nc,
+		      status, entries[i].status));
+	    rc = -320 - i;
+	    goto on_return;
+	}
+	if (status != PJ_SUCCESS && code != PJSIP_SC_FORBIDDEN) {
+	    rc = -360;
+	    goto on_return;
+	}
+    }
+
+on_return:
+    pjsip_auth_srv_deinit(&srv);
+    return rc;
+}
+
+
+/* Credential cache. */
+static int cred_test(pj_pool_t *pool)
+{
+    pjsip_auth_srv srv;
+    char nonce[NONCE_LEN+1];
+    pj_str_t carol = pj_str("carol");
+    pj_status_t status;
+    unsigned nc = 0;
+    int code, rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  credential cache test"));
+
+    if (create_srv(pool, &srv, NONCE_KEY, 2) != PJ_SUCCESS)
+	return -400;
+
+    if (get_nonce(&srv, nonce) != 0) {
+	rc = -410;
+	goto on_return;
+    }
+
+#define VERIFY(user, passwd, exp_status, exp_lookup_cnt, err) \
+    do { \
+	status = verify(&srv, pool, user, passwd, nonce, ++nc, "cred", \
+			&code); \
+	if (status != exp_status || lookup_cnt != exp_lookup_cnt) { \
+	    PJ_LOG(3,(THIS_FILE, "   error: %s: status %d, lookup count %u",\
+		      user, status, lookup_cnt)); \
+	    rc = err; \
+	    goto on_return; \
+	} \
+    } while (0)
+
+    lookup_cnt = 0;
+
+    /* Credential is cached after the first lookup */
+    VERIFY("alice", "alice-pwd", PJ_SUCCESS, 1, -420);
+    VERIFY("alice", "alice-pwd", PJ_SUCCESS, 1, -430);
+
+    /* Wrong password doesn't use cached credential */
+    VERIFY("alice", "wrong", PJSIP_EAUTHINVALIDDIGEST, 2, -440);
+    if (code != PJSIP_SC_FORBIDDEN) {
+	rc = -450;
+	goto on_return;
+    }
+
+    /* The mismatch removes the cached credential */
+    VERIFY("alice", "alice-pwd", PJ_SUCCESS, 3, -460);
+    VERIFY("alice", "alice-pwd", PJ_SUCCESS, 3, -470);
+
+    /* Least recently used is evicted */
+    VERIFY("bob", "bob-pwd", PJ_SUCCESS, 4, -480);
+    VERIFY("carol", "carol-pwd", PJ_SUCCESS, 5, -490);
+    VERIFY("carol", "carol-pwd", PJ_SUCCESS, 5, -500);
+    VERIFY("alice", "alice-pwd", PJ_SUCCESS, 6, -510);
+    VERIFY("carol", "carol-pwd", PJ_SUCCESS, 6, -520);
+    VERIFY("bob", "bob-pwd", PJ_SUCCESS, 7, -530);
+
+    /* Changed password is picked up by the lookup */
+    accounts[2].passwd = "carol-new";
+    VERIFY("carol", "carol-new", PJ_SUCCESS, 8, -540);
+    VERIFY("carol", "carol-new", PJ_SUCCESS, 8, -550);
+    accounts[2].passwd = "carol-pwd";
+
+    /* Invalidated credential */
+    pjsip_auth_srv_cache_invalidate(&srv, &carol);
+    VERIFY("carol", "carol-pwd", PJ_SUCCESS, 9, -560);
+
+    /* Unknown account */
+    VERIFY("dave", "dave-pwd", PJSIP_EAUTHACCNOTFOUND, 10, -570);
+    if (code != PJSIP_SC_FORBIDDEN) {
+	rc = -580;
+	goto on_return;
+    }
+
+#undef VERIFY
+
+on_return:
+    accounts[2].passwd = "carol-pwd";
+    pjsip_auth_srv_deinit(&srv);
+    return rc;
+}
+
+
+int auth_test(void)
+{
+    pj_pool_t *pool;
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "Server authentication test"));
+
+    pool = pjsip_endpt_create_pool(endpt, "authtest", 4000, 4000);
+
+    rc = nonce_test(pool);
+    if (rc == 0)
+	rc = nc_test(pool);
+    if (rc == 0)
+	rc = cred_test(pool);
+
+    pjsip_endpt_release_pool(endpt, pool);
+    return rc;
+}
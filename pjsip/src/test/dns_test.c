@@ -467,6 +467,74 @@ static int round_robin_test(pj_pool_t *pool)
 }
 
 
+/*
+ * Round-trip time weighting test. The fastest server of the same priority
+ * must be selected first most of the time, even when its SRV weight is
+ * lower.
+ */
+static int rtt_weight_test(pj_pool_t *pool)
+{
+    enum { COUNT = 200, MIN_PCT = 90 };
+    pjsip_cfg_t *cfg = pjsip_cfg();
+    pj_bool_t orig_rtt_weight = cfg->endpt.rtt_weight;
+    pj_sockaddr addr2, addr3;
+    pj_str_t tmp;
+    unsigned i, hits = 0;
+
+    PJ_LOG(3,(THIS_FILE, " Performing RTT weight test.."));
+
+    pj_sockaddr_in_init(&addr2.ipv4, pj_cstr(&tmp, "2.2.2.2"), 5060);
+    pj_sockaddr_in_init(&addr3.ipv4, pj_cstr(&tmp, "3.3.3.3"), 5060);
+
+    /* 2.2.2.2 has the highest weight, but is much slower than 3.3.3.3 */
+    pjsip_endpt_update_rtt(endpt, &addr2, 1000);
+    pjsip_endpt_update_rtt(endpt, &addr3, 10);
+
+    cfg->endpt.rtt_weight = PJ_TRUE;
+
+    for (i=0; i<COUNT; ++i) {
+	pjsip_host_info dest;
+	struct result result;
+
+	dest.type = PJSIP_TRANSPORT_UDP;
+	dest.flag = pjsip_transport_get_flag_from_type(PJSIP_TRANSPORT_UDP);
+	dest.addr.host = pj_str("example.com");
+	dest.addr.port = 0;
+
+	result.status = 0x12345678;
+
+	pjsip_endpt_resolve(endpt, pool, &dest, &result, &cb);
+
+	while (result.status == 0x12345678) {
+	    pj_time_val timeout = { 1, 0 };
+	    pjsip_endpt_handle_events(endpt, &timeout);
+	}
+
+	if (result.status != PJ_SUCCESS) {
+	    cfg->endpt.rtt_weight = orig_rtt_weight;
+	    return 10;
+	}
+
+	if (pj_sockaddr_cmp(&result.servers.entry[0].addr, &addr3) == 0)
+	    ++hits;
+    }
+
+    cfg->endpt.rtt_weight = orig_rtt_weight;
+
+    PJ_LOG(3,(THIS_FILE, " ..Server 3.3.3.3 was selected first %d%% times",
+	      hits * 100 / COUNT));
+
+    if (hits * 100 / COUNT < MIN_PCT) {
+	PJ_LOG(1,(THIS_FILE, "..rtt_weight_test() error 20: fastest "
+		  "server is selected first less than %d%% times",
+		  MIN_PCT));
+	return 20;
+    }
+
+    return PJ_SUCCESS;
+}
+
+
 #define C(expr)	    status = expr; \
 		    if (status != PJ_SUCCESS) app_perror(THIS_FILE, "Error", status);
 
@@ -606,6 +674,12 @@ int resolve_test(void)
     if (round_robin_test(pool) != 0)
 	return -170;
 
+    /* Round-trip time weighting test, after the round robin test which
+     * needs the plain RFC 2782 selection.
+     */
+    if (rtt_weight_test(pool) != 0)
+	return -175;
+
     /* Timeout test */
     {
 	status = test_resolve("timeout test", pool, PJSIP_TRANSPORT_UNSPECIFIED, "an.invalid.address", 0, NULL);
@@ -0,0 +1,434 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "test.h"
+#include <pjsua-lib/pjsua.h>
+#include <pjsip.h>
+#include <pjlib.h>
+
+#define THIS_FILE   "pjsua_test.c"
+#define PORT	    5076
+
+/* More than the compile time defaults */
+#define CALL_CNT    (PJSUA_MAX_CALLS + 8)
+#define BUDDY_CNT   (PJSUA_MAX_BUDDIES + 8)
+
+/* Calls that are actually made. Each call slot keeps its own RTP and
+ * RTCP sockets, so this is limited by the handles the ioqueue can hold.
+ */
+#define CALL_TEST_CNT	8
+
+
+/************************************************************************/
+/* Incoming INVITE handling, before pjsua sees it */
+static enum
+{
+    INVITE_DROP,
+    INVITE_REJECT
+} invite_action;
+
+static pj_bool_t on_rx_request(pjsip_rx_data *rdata)
+{
+    switch (rdata->msg_info.msg->line.req.method.id) {
+    case PJSIP_INVITE_METHOD:
+	if (invite_action == INVITE_REJECT) {
+	    pjsip_endpt_respond_stateless(pjsua_get_pjsip_endpt(), rdata,
+					  PJSIP_SC_BUSY_HERE, NULL, NULL,
+					  NULL);
+	}
+	return PJ_TRUE;
+
+    case PJSIP_ACK_METHOD:
+	return PJ_TRUE;
+
+    default:
+	return PJ_FALSE;
+    }
+}
+
+static pjsip_module mod_pjsua_test =
+{
+    NULL, NULL,			    /* prev, next.		*/
+    { "mod-pjsua-test", 14 },	    /* Name.			*/
+    -1,				    /* Id			*/
+    PJSIP_MOD_PRIORITY_APPLICATION-1,/* Priority		*/
+    NULL,			    /* load()			*/
+    NULL,			    /* start()			*/
+    NULL,			    /* stop()			*/
+    NULL,			    /* unload()			*/
+    &on_rx_request,		    /* on_rx_request()		*/
+    NULL,			    /* on_rx_response()		*/
+    NULL,			    /* on_tx_request.		*/
+    NULL,			    /* on_tx_response()		*/
+    NULL,			    /* on_tsx_state()		*/
+};
+
+
+/************************************************************************/
+static pjsua_acc_id acc_id;
+
+/* Call ourselves */
+static pj_status_t make_call(pjsua_call_id *p_call_id)
+{
+    char buf[64];
+    pj_str_t uri;
+    pjsua_call_setting opt;
+
+    pj_ansi_snprintf(buf, sizeof(buf), "sip:test@127.0.0.1:%d", PORT);
+    uri = pj_str(buf);
+
+    pjsua_call_setting_default(&opt);
+    opt.vid_cnt = 0;
+
+    return pjsua_call_make_call(acc_id, &uri, &opt, NULL, NULL, p_call_id);
+}
+
+/* Wait until the number of calls drops to the specified count */
+static int wait_call_cnt(unsigned cnt)
+{
+    unsigned i;
+
+    for (i=0; i<500 && pjsua_call_get_count() != cnt; ++i)
+	pjsua_handle_events(10);
+
+    if (pjsua_call_get_count() != cnt) {
+	PJ_LOG(3,(THIS_FILE, "    error: %d calls, expecting %d",
+		  pjsua_call_get_count(), cnt));
+	return -1;
+    }
+    return 0;
+}
+
+/* Released call ids are handed out again in least recently used order */
+static int call_ring_test(void)
+{
+    unsigned i;
+
+    PJ_LOG(3,(THIS_FILE, "  call id ring"));
+
+    invite_action = INVITE_REJECT;
+
+    for (i=0; i<CALL_TEST_CNT*2; ++i) {
+	pjsua_call_id call_id;
+	pj_status_t status;
+
+	status = make_call(&call_id);
+	if (status != PJ_SUCCESS) {
+	    app_perror("    error: unable to make call", status);
+	    return -100;
+	}
+
+	if (call_id != (pjsua_call_id)(i % CALL_TEST_CNT)) {
+	    PJ_LOG(3,(THIS_FILE, "    error: got call id %d, expecting %d",
+		      call_id, i % CALL_TEST_CNT));
+	    return -110;
+	}
+
+	if (wait_call_cnt(0) != 0)
+	    return -120;
+    }
+
+    return 0;
+}
+
+/* The calls table holds max_calls concurrent calls, no more */
+static int call_capacity_test(void)
+{
+    pj_uint8_t used[CALL_TEST_CNT];
+    pjsua_call_id call_id;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  %d concurrent calls", CALL_TEST_CNT));
+
+    invite_action = INVITE_DROP;
+    pj_bzero(used, sizeof(used));
+
+    for (i=0; i<CALL_TEST_CNT; ++i) {
+	status = make_call(&call_id);
+	if (status != PJ_SUCCESS) {
+	    app_perror("    error: unable to make call", status);
+	    return -200;
+	}
+
+	if (call_id < 0 || call_id >= CALL_TEST_CNT || used[call_id]) {
+	    PJ_LOG(3,(THIS_FILE, "    error: invalid call id %d", call_id));
+	    return -210;
+	}
+	used[call_id] = 1;
+    }
+
+    if (pjsua_call_get_count() != CALL_TEST_CNT)
+	return -220;
+
+    /* The media info published for the call must be reported */
+    {
+	pjsua_call_info ci;
+
+	status = pjsua_call_get_info(call_id, &ci);
+	if (status != PJ_SUCCESS || ci.prov_media_cnt != 1 ||
+	    ci.prov_media[0].type != PJMEDIA_TYPE_AUDIO || ci.rem_offerer)
+	{
+	    PJ_LOG(3,(THIS_FILE, "    error: invalid media info of call %d",
+		      call_id));
+	    return -225;
+	}
+    }
+
+    status = make_call(&call_id);
+    if (status != PJ_ETOOMANY) {
+	PJ_LOG(3,(THIS_FILE, "    error: expecting PJ_ETOOMANY when the "
+		  "calls table is full"));
+	return -230;
+    }
+
+    /* The calls are left for pjsua_destroy() to clean up, since they
+     * have not received any response to CANCEL.
+     */
+    return 0;
+}
+
+
+/************************************************************************/
+static pj_str_t buddy_uri(char *buf, unsigned size, const char *fmt,
+			  unsigned i)
+{
+    pj_ansi_snprintf(buf, size, fmt, i);
+    return pj_str(buf);
+}
+
+static pj_status_t add_buddy(unsigned i, pjsua_buddy_id *p_buddy_id)
+{
+    char buf[64];
+    pjsua_buddy_config cfg;
+
+    pjsua_buddy_config_default(&cfg);
+    cfg.uri = buddy_uri(buf, sizeof(buf), "sip:user%d@example.com", i);
+    cfg.subscribe = PJ_FALSE;
+
+    return pjsua_buddy_add(&cfg, p_buddy_id);
+}
+
+static pjsua_buddy_id find_buddy(const char *fmt, unsigned i)
+{
+    char buf[64];
+    pj_str_t uri = buddy_uri(buf, sizeof(buf), fmt, i);
+
+    return pjsua_buddy_find(&uri);
+}
+
+/* Buddy lookup with the URI table, and reuse of the free buddy slots */
+static int buddy_table_test(void)
+{
+    pjsua_buddy_id ids[BUDDY_CNT], id, dup;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  %d buddies", BUDDY_CNT));
+
+    for (i=0; i<BUDDY_CNT; ++i) {
+	status = add_buddy(i, &ids[i]);
+	if (status != PJ_SUCCESS) {
+	    app_perror("    error: unable to add buddy", status);
+	    return -300;
+	}
+    }
+
+    if (pjsua_get_buddy_count() != BUDDY_CNT)
+	return -310;
+
+    if (add_buddy(BUDDY_CNT, &id) != PJ_ETOOMANY) {
+	PJ_LOG(3,(THIS_FILE, "    error: expecting PJ_ETOOMANY when the "
+		  "buddy table is full"));
+	return -320;
+    }
+
+    /* Default port and host case do not matter */
+    for (i=0; i<BUDDY_CNT; ++i) {
+	if (find_buddy("sip:user%d@example.com", i) != ids[i] ||
+	    find_buddy("sip:user%d@Example.COM:5060", i) != ids[i] ||
+	    find_buddy("<sip:user%d@example.com;transport=udp>", i) != ids[i])
+	{
+	    PJ_LOG(3,(THIS_FILE, "    error: buddy %d is not found", i));
+	    return -330;
+	}
+    }
+
+    if (find_buddy("sip:user%d@example.com", BUDDY_CNT) != PJSUA_INVALID_ID ||
+	find_buddy("sip:user%d@example.com:5070", 0) != PJSUA_INVALID_ID)
+    {
+	PJ_LOG(3,(THIS_FILE, "    error: unknown buddy is found"));
+	return -340;
+    }
+
+    /* Buddies with the same URI: the next one is found once the first
+     * has been deleted.
+     */
+    if (pjsua_buddy_del(ids[BUDDY_CNT-1]) != PJ_SUCCESS)
+	return -350;
+    if (add_buddy(0, &dup) != PJ_SUCCESS)
+	return -360;
+    if (find_buddy("sip:user%d@example.com", 0) != ids[0])
+	return -370;
+    if (pjsua_buddy_del(ids[0]) != PJ_SUCCESS)
+	return -380;
+    if (find_buddy("sip:user%d@example.com", 0) != dup)
+	return -390;
+    if (pjsua_buddy_del(dup) != PJ_SUCCESS)
+	return -400;
+    if (find_buddy("sip:user%d@example.com", 0) != PJSUA_INVALID_ID)
+	return -410;
+
+    /* Deleted buddies' slots are reused */
+    ids[0] = ids[BUDDY_CNT-1] = PJSUA_INVALID_ID;
+    for (i=0; i<2; ++i) {
+	if (add_buddy(BUDDY_CNT+i, &id) != PJ_SUCCESS)
+	    return -420;
+	if (find_buddy("sip:user%d@example.com", BUDDY_CNT+i) != id)
+	    return -430;
+	if (pjsua_buddy_del(id) != PJ_SUCCESS)
+	    return -440;
+    }
+
+    for (i=1; i<BUDDY_CNT-1; ++i) {
+	if (pjsua_buddy_del(ids[i]) != PJ_SUCCESS)
+	    return -450;
+    }
+
+    if (pjsua_get_buddy_count() != 0)
+	return -460;
+
+    return 0;
+}
+
+
+/************************************************************************/
+/* Create and start pjsua with the specified table sizes */
+static int init_pjsua(unsigned max_calls, unsigned max_buddies)
+{
+    pjsua_config cfg;
+    pjsua_logging_config log_cfg;
+    pjsua_media_config media_cfg;
+    pjsua_transport_config tp_cfg;
+    pjsua_transport_id tp_id;
+    pj_status_t status;
+
+    status = pjsua_create();
+    if (status != PJ_SUCCESS)
+	return -1;
+
+    pjsua_config_default(&cfg);
+    cfg.max_calls = max_calls;
+    cfg.max_buddies = max_buddies;
+    cfg.thread_cnt = 0;
+
+    pjsua_logging_config_default(&log_cfg);
+    log_cfg.level = log_cfg.console_level = pj_log_get_level();
+    log_cfg.decor = pj_log_get_decor();
+
+    pjsua_media_config_default(&media_cfg);
+    media_cfg.thread_cnt = 0;
+
+    status = pjsua_init(&cfg, &log_cfg, &media_cfg);
+    if (status != PJ_SUCCESS)
+	return -2;
+
+    pjsua_set_null_snd_dev();
+
+    status = pjsip_endpt_register_module(pjsua_get_pjsip_endpt(),
+					 &mod_pjsua_test);
+    if (status != PJ_SUCCESS)
+	return -3;
+
+    pjsua_transport_config_default(&tp_cfg);
+    tp_cfg.port = PORT;
+    status = pjsua_transport_create(PJSIP_TRANSPORT_UDP, &tp_cfg, &tp_id);
+    if (status != PJ_SUCCESS)
+	return -4;
+
+    status = pjsua_acc_add_local(tp_id, PJ_TRUE, &acc_id);
+    if (status != PJ_SUCCESS)
+	return -5;
+
+    status = pjsua_start();
+    if (status != PJ_SUCCESS)
+	return -6;
+
+    if (pjsua_call_get_max_count() != max_calls)
+	return -7;
+
+    return 0;
+}
+
+/* pjsua redirects logging to itself, and stops logging once destroyed */
+static void destroy_pjsua(pj_log_func *log_func)
+{
+    int level = pj_log_get_level();
+    unsigned decor = pj_log_get_decor();
+
+    pjsua_destroy();
+
+    pj_log_set_log_func(log_func);
+    pj_log_set_level(level);
+    pj_log_set_decor(decor);
+}
+
+/*
+ * pjsua creates its own endpoint, hence this test must be run after the
+ * test endpoint has been destroyed.
+ */
+int pjsua_test(void)
+{
+    pj_log_func *log_func = pj_log_get_log_func();
+    int rc;
+
+    /* Tables larger than the compile time defaults */
+    rc = init_pjsua(CALL_CNT, BUDDY_CNT);
+    if (rc != 0)
+	goto on_return;
+
+    if (pjsua_call_is_active(CALL_CNT-1)) {
+	rc = -10;
+	goto on_return;
+    }
+
+    rc = buddy_table_test();
+    if (rc != 0)
+	goto on_return;
+
+    destroy_pjsua(log_func);
+
+    /* Calls */
+    rc = init_pjsua(CALL_TEST_CNT, PJSUA_MAX_BUDDIES);
+    if (rc != 0)
+	goto on_return;
+
+    rc = call_ring_test();
+    if (rc != 0)
+	goto on_return;
+
+    rc = call_capacity_test();
+    if (rc != 0)
+	goto on_return;
+
+on_return:
+    destroy_pjsua(log_func);
+    return rc;
+}
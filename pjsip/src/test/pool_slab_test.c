@@ -0,0 +1,258 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "test.h"
+#include <pjsip.h>
+#include <pjsip/sip_private.h>
+#include <pjlib.h>
+
+
+#define THIS_FILE   "pool_slab_test.c"
+
+#define SLAB_LEN    1000
+#define SLAB_INC    500
+#define POOL_CNT    8
+
+
+/*
+ * Slabs are shared by name and size, and the first block of their pools
+ * has the exact requested size.
+ */
+static int slab_create_test(void)
+{
+    pjsip_pool_slab *slab, *slab2;
+    pj_pool_t *pool, *other;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  slab creation"));
+
+    status = pjsip_endpt_create_pool_slab(endpt, "slabtest", SLAB_LEN,
+					  SLAB_INC, 0, &slab);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to create slab", status);
+	return -10;
+    }
+
+    status = pjsip_endpt_create_pool_slab(endpt, "slabtest", SLAB_LEN,
+					  SLAB_INC, 0, &slab2);
+    if (status != PJ_SUCCESS || slab2 != slab) {
+	PJ_LOG(3,(THIS_FILE, "   error: slab with same name and size is not "
+		  "shared"));
+	return -20;
+    }
+
+    status = pjsip_endpt_create_pool_slab(endpt, "slabtest", SLAB_LEN*2,
+					  SLAB_INC, 0, &slab2);
+    if (status != PJ_SUCCESS || slab2 == slab) {
+	PJ_LOG(3,(THIS_FILE, "   error: slab with different size is shared"));
+	return -30;
+    }
+
+    pool = pjsip_pool_slab_create_pool(slab, NULL);
+    if (!pool) {
+	PJ_LOG(3,(THIS_FILE, "   error: unable to create pool from slab"));
+	return -40;
+    }
+
+    if (pj_pool_get_capacity(pool) != SLAB_LEN) {
+	PJ_LOG(3,(THIS_FILE, "   error: pool capacity is %u instead of %u",
+		  (unsigned)pj_pool_get_capacity(pool), SLAB_LEN));
+	pj_pool_release(pool);
+	return -50;
+    }
+
+    /* Pools of other sizes created from the slab's factory, such as the
+     * group lock pool of a transaction, still work.
+     */
+    other = pj_pool_create(pool->factory, "other", 4000, 4000, NULL);
+    if (!other) {
+	PJ_LOG(3,(THIS_FILE, "   error: unable to create pool of other size"));
+	pj_pool_release(pool);
+	return -60;
+    }
+    if (pj_pool_alloc(other, 3000) == NULL) {
+	pj_pool_release(other);
+	pj_pool_release(pool);
+	return -70;
+    }
+    pj_pool_release(other);
+
+    /* Growing beyond the initial size adds blocks of the increment size */
+    if (pj_pool_alloc(pool, SLAB_LEN) == NULL ||
+	pj_pool_get_capacity(pool) <= SLAB_LEN)
+    {
+	PJ_LOG(3,(THIS_FILE, "   error: slab pool doesn't grow"));
+	pj_pool_release(pool);
+	return -80;
+    }
+
+    pj_pool_release(pool);
+    return 0;
+}
+
+/*
+ * Released pools are reset and reused.
+ */
+static int slab_reuse_test(void)
+{
+    pjsip_pool_slab *slab;
+    pj_pool_t *pool[POOL_CNT];
+    pj_size_t empty_size;
+    unsigned i, j;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  slab pool reuse"));
+
+    status = pjsip_endpt_create_pool_slab(endpt, "slabtest", SLAB_LEN,
+					  SLAB_INC, 0, &slab);
+    if (status != PJ_SUCCESS)
+	return -100;
+
+    for (i=0; i<POOL_CNT; ++i) {
+	pool[i] = pjsip_pool_slab_create_pool(slab, "slab%p");
+	if (!pool[i]) {
+	    while (i)
+		pj_pool_release(pool[--i]);
+	    return -110;
+	}
+    }
+    empty_size = pj_pool_get_used_size(pool[0]);
+
+    for (i=0; i<POOL_CNT; ++i) {
+	pj_pool_alloc(pool[i], SLAB_LEN + i*100);
+	pj_pool_release(pool[i]);
+    }
+
+    /* The most recently released pool is handed out first, reset to
+     * its initial state.
+     */
+    for (i=POOL_CNT; i>0; --i) {
+	pj_pool_t *p = pjsip_pool_slab_create_pool(slab, "slab%p");
+
+	if (p != pool[i-1]) {
+	    PJ_LOG(3,(THIS_FILE, "   error: released pool is not reused"));
+	    if (p) pj_pool_release(p);
+	    for (j=i; j<POOL_CNT; ++j)
+		pj_pool_release(pool[j]);
+	    return -120;
+	}
+	if (pj_pool_get_used_size(p) != empty_size ||
+	    pj_pool_get_capacity(p) != SLAB_LEN)
+	{
+	    PJ_LOG(3,(THIS_FILE, "   error: reused pool is not reset "
+		      "(used=%u, capacity=%u)",
+		      (unsigned)pj_pool_get_used_size(p),
+		      (unsigned)pj_pool_get_capacity(p)));
+	    for (j=i-1; j<POOL_CNT; ++j)
+		pj_pool_release(pool[j]);
+	    return -130;
+	}
+    }
+
+    for (i=0; i<POOL_CNT; ++i)
+	pj_pool_release(pool[i]);
+
+    return 0;
+}
+
+/*
+ * Dialogs take their pools from the user agent's slab.
+ */
+static int slab_dlg_test(void)
+{
+    pj_str_t uri = pj_str("sip:slab@127.0.0.1");
+    pjsip_pool_slab *slab;
+    pjsip_dialog *dlg;
+    pj_pool_t *pool, *dlg_pool;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  dialog pools"));
+
+    slab = pjsip_ua_get_dlg_slab(pjsip_ua_instance());
+    if (!slab) {
+	PJ_LOG(3,(THIS_FILE, "   error: user agent has no dialog slab"));
+	return -200;
+    }
+
+    pool = pjsip_pool_slab_create_pool(slab, NULL);
+    if (!pool || pj_pool_get_capacity(pool) != PJSIP_POOL_LEN_DIALOG)
+	return -210;
+
+    status = pjsip_dlg_create_uac(pjsip_ua_instance(), &uri, &uri, &uri,
+				  &uri, &dlg);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to create dialog", status);
+	pj_pool_release(pool);
+	return -220;
+    }
+
+    dlg_pool = dlg->pool;
+    if (dlg_pool->factory != pool->factory) {
+	PJ_LOG(3,(THIS_FILE, "   error: dialog pool is not from the slab"));
+	pjsip_dlg_terminate(dlg);
+	pj_pool_release(pool);
+	return -230;
+    }
+    pj_pool_release(pool);
+
+    /* The pool of the destroyed dialog is used by the next dialog */
+    pjsip_dlg_terminate(dlg);
+
+    status = pjsip_dlg_create_uac(pjsip_ua_instance(), &uri, &uri, &uri,
+				  &uri, &dlg);
+    if (status != PJ_SUCCESS)
+	return -240;
+
+    if (dlg->pool != dlg_pool) {
+	PJ_LOG(3,(THIS_FILE, "   error: dialog pool is not reused"));
+	pjsip_dlg_terminate(dlg);
+	return -250;
+    }
+
+    pjsip_dlg_terminate(dlg);
+    return 0;
+}
+
+
+int pool_slab_test(void)
+{
+    int rc;
+
+    /* Init UA layer */
+    if (pjsip_ua_instance()->id == -1) {
+	pjsip_ua_init_param ua_param;
+	pj_bzero(&ua_param, sizeof(ua_param));
+	pjsip_ua_init_module(endpt, &ua_param);
+    }
+
+    rc = slab_create_test();
+    if (rc != 0)
+	return rc;
+
+    rc = slab_reuse_test();
+    if (rc != 0)
+	return rc;
+
+    rc = slab_dlg_test();
+    if (rc != 0)
+	return rc;
+
+    return 0;
+}
@@ -0,0 +1,938 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "test.h"
+#include <pjsip_simple.h>
+#include <pjsip_ua.h>
+#include <pjsip.h>
+#include <pjlib.h>
+
+#define THIS_FILE   "pres_test.c"
+#define PORT	    5072
+#define CONTACT	    "sip:127.0.0.1:5072"
+#define TCP_PORT    5074
+#define TCP_CONTACT "sip:127.0.0.1:5074;transport=tcp"
+
+/* More than one fan-out chunk */
+#define WATCHER_CNT 80
+
+
+/************************************************************************/
+/* Watchers, i.e. the client subscriptions */
+struct watcher
+{
+    pjsip_evsub	    *sub;
+    unsigned	     notify_cnt;
+};
+
+static struct
+{
+    pjsip_presentity	*presentity;
+    struct watcher	 w[WATCHER_CNT];
+} presentity_test;
+
+/* Subscriptions of the hibernation test */
+static struct
+{
+    pjsip_evsub		*uas;
+    pj_bool_t		 refuse;
+    unsigned		 rehydrate_cnt;
+} hib_test;
+
+static pjsip_module mod_pres_test;
+
+
+static void uac_on_evsub_state(pjsip_evsub *sub, pjsip_event *event)
+{
+    struct watcher *w;
+
+    PJ_UNUSED_ARG(event);
+
+    w = (struct watcher*) pjsip_evsub_get_mod_data(sub, mod_pres_test.id);
+    if (!w)
+	return;
+
+    if (pjsip_evsub_get_state(sub) == PJSIP_EVSUB_STATE_TERMINATED) {
+	pjsip_evsub_set_mod_data(sub, mod_pres_test.id, NULL);
+	w->sub = NULL;
+    }
+}
+
+static void uac_on_rx_notify(pjsip_evsub *sub, pjsip_rx_data *rdata,
+			     int *p_st_code, pj_str_t **p_st_text,
+			     pjsip_hdr *res_hdr, pjsip_msg_body **p_body)
+{
+    struct watcher *w;
+
+    PJ_UNUSED_ARG(rdata);
+    PJ_UNUSED_ARG(p_st_text);
+    PJ_UNUSED_ARG(res_hdr);
+    PJ_UNUSED_ARG(p_body);
+
+    w = (struct watcher*) pjsip_evsub_get_mod_data(sub, mod_pres_test.id);
+    if (w)
+	++w->notify_cnt;
+
+    *p_st_code = 200;
+}
+
+static void uac_on_rehydrate(pjsip_evsub *sub, const char *buf,
+			     unsigned len)
+{
+    struct watcher *w;
+
+    PJ_UNUSED_ARG(buf);
+    PJ_UNUSED_ARG(len);
+
+    w = (struct watcher*) pjsip_evsub_get_mod_data(sub, mod_pres_test.id);
+    if (w)
+	w->sub = sub;
+    ++hib_test.rehydrate_cnt;
+}
+
+static int uas_on_hibernate(pjsip_evsub *sub, char *buf, unsigned size)
+{
+    PJ_UNUSED_ARG(sub);
+    PJ_UNUSED_ARG(buf);
+    PJ_UNUSED_ARG(size);
+
+    return hib_test.refuse ? -1 : 0;
+}
+
+static void uas_on_rehydrate(pjsip_evsub *sub, const char *buf,
+			     unsigned len)
+{
+    PJ_UNUSED_ARG(buf);
+    PJ_UNUSED_ARG(len);
+
+    hib_test.uas = sub;
+    ++hib_test.rehydrate_cnt;
+}
+
+static pjsip_evsub_user uac_cb;
+static pjsip_evsub_user uas_cb;
+
+
+/* Create the server subscription for incoming SUBSCRIBE and attach it
+ * to the presentity, if there is one.
+ */
+static pj_bool_t on_rx_request(pjsip_rx_data *rdata)
+{
+    pjsip_dialog *dlg;
+    pjsip_evsub *sub;
+    pjsip_tx_data *tdata;
+    pj_str_t contact;
+    pj_status_t status;
+
+    if (pjsip_method_cmp(&rdata->msg_info.msg->line.req.method,
+			 &pjsip_subscribe_method) != 0)
+    {
+	return PJ_FALSE;
+    }
+
+    if (rdata->tp_info.transport->key.type == PJSIP_TRANSPORT_TCP)
+	contact = pj_str(TCP_CONTACT);
+    else
+	contact = pj_str(CONTACT);
+
+    status = pjsip_dlg_create_uas(pjsip_ua_instance(), rdata, &contact,
+				  &dlg);
+    pj_assert(status == PJ_SUCCESS);
+
+    status = pjsip_pres_create_uas(dlg, &uas_cb, rdata, &sub);
+    pj_assert(status == PJ_SUCCESS);
+
+    status = pjsip_pres_accept(sub, rdata, 200, NULL);
+    pj_assert(status == PJ_SUCCESS);
+
+    if (presentity_test.presentity) {
+	status = pjsip_presentity_add_watcher(presentity_test.presentity,
+					      sub);
+	pj_assert(status == PJ_SUCCESS);
+    } else {
+	pjsip_pres_status st;
+
+	pj_bzero(&st, sizeof(st));
+	st.info_cnt = 1;
+	st.info[0].basic_open = PJ_TRUE;
+	st.info[0].rpid.type = PJRPID_ELEMENT_TYPE_PERSON;
+	st.info[0].rpid.note = pj_str("hib");
+	status = pjsip_pres_set_status(sub, &st);
+	pj_assert(status == PJ_SUCCESS);
+
+	hib_test.uas = sub;
+    }
+
+    status = pjsip_pres_notify(sub, PJSIP_EVSUB_STATE_ACTIVE, NULL, NULL,
+			       &tdata);
+    pj_assert(status == PJ_SUCCESS);
+
+    status = pjsip_pres_send_request(sub, tdata);
+    pj_assert(status == PJ_SUCCESS);
+
+    return PJ_TRUE;
+}
+
+static pjsip_module mod_pres_test =
+{
+    NULL, NULL,			    /* prev, next.		*/
+    { "mod-pres-test", 13 },	    /* Name.			*/
+    -1,				    /* Id			*/
+    PJSIP_MOD_PRIORITY_APPLICATION, /* Priority			*/
+    NULL,			    /* load()			*/
+    NULL,			    /* start()			*/
+    NULL,			    /* stop()			*/
+    NULL,			    /* unload()			*/
+    &on_rx_request,		    /* on_rx_request()		*/
+    NULL,			    /* on_rx_response()		*/
+    NULL,			    /* on_tx_request.		*/
+    NULL,			    /* on_tx_response()		*/
+    NULL,			    /* on_tsx_state()		*/
+};
+
+
+/************************************************************************/
+/* Set the status of the presentity. The note identifies the status
+ * received by the watchers.
+ */
+static pj_status_t set_status(pj_bool_t open, const char *note)
+{
+    pjsip_pres_status st;
+
+    pj_bzero(&st, sizeof(st));
+    st.info_cnt = 1;
+    st.info[0].basic_open = open;
+    st.info[0].rpid.type = PJRPID_ELEMENT_TYPE_PERSON;
+    st.info[0].rpid.note = pj_str((char*)note);
+
+    return pjsip_presentity_set_status(presentity_test.presentity, &st);
+}
+
+/* Check that the last status received by the watcher has the note */
+static pj_bool_t has_note(const struct watcher *w, const char *note)
+{
+    pjsip_pres_status st;
+
+    if (!w->sub || pjsip_pres_get_status(w->sub, &st) != PJ_SUCCESS ||
+	st.info_cnt == 0)
+    {
+	return PJ_FALSE;
+    }
+
+    return pj_strcmp2(&st.info[0].rpid.note, note) == 0;
+}
+
+/* Wait until all watchers have received the note */
+static int wait_note(const char *note)
+{
+    unsigned i, j;
+
+    for (i=0; i<500; ++i) {
+	pj_time_val delay = {0, 10};
+
+	for (j=0; j<WATCHER_CNT && has_note(&presentity_test.w[j], note); ++j)
+	    ;
+	if (j == WATCHER_CNT)
+	    return 0;
+
+	pjsip_endpt_handle_events(endpt, &delay);
+    }
+
+    PJ_LOG(3,(THIS_FILE, "    error: watchers have not received \"%s\"",
+	      note));
+    return -1;
+}
+
+/* Check the number of NOTIFY received by each watcher */
+static int check_notify_cnt(unsigned expected)
+{
+    unsigned i;
+
+    for (i=0; i<WATCHER_CNT; ++i) {
+	if (presentity_test.w[i].notify_cnt != expected) {
+	    PJ_LOG(3,(THIS_FILE, "    error: watcher %d got %d NOTIFY, "
+		      "expecting %d", i, presentity_test.w[i].notify_cnt,
+		      expected));
+	    return -1;
+	}
+    }
+    return 0;
+}
+
+static void reset_notify_cnt(void)
+{
+    unsigned i;
+
+    for (i=0; i<WATCHER_CNT; ++i)
+	presentity_test.w[i].notify_cnt = 0;
+}
+
+
+/* Create the presentity and subscribe all watchers to it */
+static int subscribe_all(const pjsip_presentity_setting *setting)
+{
+    pj_str_t uri = pj_str(CONTACT);
+    unsigned i;
+    pj_status_t status;
+
+    pj_bzero(&presentity_test, sizeof(presentity_test));
+
+    status = pjsip_presentity_create(endpt, &uri, setting,
+				     &presentity_test.presentity);
+    if (status != PJ_SUCCESS)
+	return -10;
+
+    if (set_status(PJ_TRUE, "initial") != PJ_SUCCESS)
+	return -20;
+
+    for (i=0; i<WATCHER_CNT; ++i) {
+	pjsip_dialog *dlg;
+	pjsip_tx_data *tdata;
+
+	status = pjsip_dlg_create_uac(pjsip_ua_instance(), &uri, &uri,
+				      &uri, &uri, &dlg);
+	if (status != PJ_SUCCESS)
+	    return -30;
+
+	status = pjsip_pres_create_uac(dlg, &uac_cb, 0, &presentity_test.w[i].sub);
+	if (status != PJ_SUCCESS)
+	    return -40;
+
+	pjsip_evsub_set_mod_data(presentity_test.w[i].sub, mod_pres_test.id,
+				 &presentity_test.w[i]);
+
+	status = pjsip_pres_initiate(presentity_test.w[i].sub, 600, &tdata);
+	if (status == PJ_SUCCESS)
+	    status = pjsip_pres_send_request(presentity_test.w[i].sub, tdata);
+	if (status != PJ_SUCCESS)
+	    return -50;
+    }
+
+    if (wait_note("initial") != 0)
+	return -60;
+
+    if (pjsip_presentity_get_watcher_count(presentity_test.presentity) !=
+	WATCHER_CNT)
+    {
+	PJ_LOG(3,(THIS_FILE, "    error: expecting %d watchers, got %d",
+		  WATCHER_CNT,
+		  pjsip_presentity_get_watcher_count(presentity_test.presentity)));
+	return -70;
+    }
+
+    /* Let the initial NOTIFY transactions complete */
+    flush_events(100);
+    reset_notify_cnt();
+
+    return 0;
+}
+
+/* Unsubscribe all watchers and destroy the presentity */
+static int unsubscribe_all(void)
+{
+    unsigned i, j;
+    int rc = 0;
+
+    for (i=0; i<WATCHER_CNT; ++i) {
+	pjsip_tx_data *tdata;
+
+	if (!presentity_test.w[i].sub)
+	    continue;
+
+	if (pjsip_pres_initiate(presentity_test.w[i].sub, 0, &tdata)==PJ_SUCCESS)
+	    pjsip_pres_send_request(presentity_test.w[i].sub, tdata);
+    }
+
+    for (i=0; i<500; ++i) {
+	pj_time_val delay = {0, 10};
+
+	for (j=0; j<WATCHER_CNT && presentity_test.w[j].sub==NULL; ++j)
+	    ;
+	if (j == WATCHER_CNT)
+	    break;
+
+	pjsip_endpt_handle_events(endpt, &delay);
+    }
+
+    if (j != WATCHER_CNT) {
+	PJ_LOG(3,(THIS_FILE, "    error: watchers are not terminated"));
+	rc = -800;
+    } else if (pjsip_presentity_get_watcher_count(presentity_test.presentity)) {
+	PJ_LOG(3,(THIS_FILE, "    error: watchers are still attached"));
+	rc = -810;
+    }
+
+    pjsip_presentity_destroy(presentity_test.presentity);
+    presentity_test.presentity = NULL;
+
+    return rc;
+}
+
+
+/************************************************************************/
+/* Every status change is sent to every watcher */
+static int fanout_test(unsigned worker_cnt)
+{
+    pjsip_presentity_setting setting;
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "  fan-out to %d watchers, %d workers",
+	      WATCHER_CNT, worker_cnt));
+
+    pjsip_presentity_setting_default(&setting);
+    setting.throttle_msec = 0;
+    setting.worker_cnt = worker_cnt;
+
+    rc = subscribe_all(&setting);
+    if (rc != 0)
+	goto on_return;
+
+    if (set_status(PJ_FALSE, "away") != PJ_SUCCESS) {
+	rc = -100;
+	goto on_return;
+    }
+    if (wait_note("away") != 0) {
+	rc = -110;
+	goto on_return;
+    }
+    if (check_notify_cnt(1) != 0) {
+	rc = -120;
+	goto on_return;
+    }
+
+    /* Let the NOTIFY transactions complete before the next change, so
+     * that each watcher gets its own NOTIFY for it.
+     */
+    flush_events(100);
+
+    if (set_status(PJ_TRUE, "back") != PJ_SUCCESS) {
+	rc = -130;
+	goto on_return;
+    }
+    if (wait_note("back") != 0) {
+	rc = -140;
+	goto on_return;
+    }
+    if (check_notify_cnt(2) != 0) {
+	rc = -150;
+	goto on_return;
+    }
+
+on_return:
+    if (presentity_test.presentity) {
+	int rc2 = unsubscribe_all();
+	if (rc == 0)
+	    rc = rc2;
+    }
+    return rc;
+}
+
+/* Status changes within the throttle window are coalesced */
+static int coalesce_test(void)
+{
+    enum { THROTTLE = 300 };
+    pjsip_presentity_setting setting;
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "  coalescing status changes"));
+
+    pjsip_presentity_setting_default(&setting);
+    setting.throttle_msec = THROTTLE;
+    setting.worker_cnt = 0;
+
+    rc = subscribe_all(&setting);
+    if (rc != 0)
+	goto on_return;
+
+    /* Past the throttle window, the first change is sent right away */
+    pj_thread_sleep(THROTTLE);
+
+    if (set_status(PJ_FALSE, "1") != PJ_SUCCESS) {
+	rc = -200;
+	goto on_return;
+    }
+    if (wait_note("1") != 0) {
+	rc = -210;
+	goto on_return;
+    }
+
+    /* The next changes are within the window */
+    if (set_status(PJ_TRUE, "2") != PJ_SUCCESS ||
+	set_status(PJ_FALSE, "3") != PJ_SUCCESS)
+    {
+	rc = -220;
+	goto on_return;
+    }
+    if (wait_note("3") != 0) {
+	rc = -230;
+	goto on_return;
+    }
+    if (check_notify_cnt(2) != 0) {
+	rc = -240;
+	goto on_return;
+    }
+
+on_return:
+    if (presentity_test.presentity) {
+	int rc2 = unsubscribe_all();
+	if (rc == 0)
+	    rc = rc2;
+    }
+    return rc;
+}
+
+
+/************************************************************************/
+/* Destroy the presentity while its throttle timer is being processed by
+ * another thread.
+ */
+static pj_bool_t poll_quit;
+
+static int poll_thread(void *arg)
+{
+    PJ_UNUSED_ARG(arg);
+
+    while (!poll_quit) {
+	pj_time_val delay = {0, 1};
+	pjsip_endpt_handle_events(endpt, &delay);
+    }
+    return 0;
+}
+
+static int destroy_race_test(void)
+{
+    enum { THROTTLE = 5, LOOP = 50 };
+    pjsip_presentity_setting setting;
+    pj_str_t uri = pj_str(CONTACT);
+    pj_pool_t *pool;
+    pj_thread_t *thread;
+    unsigned i;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  destroy with pending throttle timer"));
+
+    pool = pjsip_endpt_create_pool(endpt, "prestest", 512, 512);
+    if (!pool)
+	return -300;
+
+    poll_quit = PJ_FALSE;
+    if (pj_thread_create(pool, "prestest", &poll_thread, NULL, 0, 0,
+			 &thread) != PJ_SUCCESS)
+    {
+	pjsip_endpt_release_pool(endpt, pool);
+	return -310;
+    }
+
+    pjsip_presentity_setting_default(&setting);
+    setting.throttle_msec = THROTTLE;
+    setting.worker_cnt = 0;
+
+    for (i=0; i<LOOP; ++i) {
+	pj_bzero(&presentity_test, sizeof(presentity_test));
+	if (pjsip_presentity_create(endpt, &uri, &setting,
+				    &presentity_test.presentity) != PJ_SUCCESS)
+	{
+	    rc = -320;
+	    break;
+	}
+
+	/* The second change schedules the throttle timer */
+	set_status(PJ_TRUE, "1");
+	set_status(PJ_FALSE, "2");
+
+	/* Destroy before, while or after the timer fires */
+	pj_thread_sleep(i % (THROTTLE * 2));
+
+	if (pjsip_presentity_destroy(presentity_test.presentity) != PJ_SUCCESS) {
+	    rc = -330;
+	    break;
+	}
+	presentity_test.presentity = NULL;
+    }
+
+    poll_quit = PJ_TRUE;
+    pj_thread_join(thread);
+    pj_thread_destroy(thread);
+    pjsip_endpt_release_pool(endpt, pool);
+
+    return rc;
+}
+
+
+/************************************************************************/
+/* Dialog state which must survive hibernation */
+typedef struct dlg_state
+{
+    char	call_id[128];
+    char	local_tag[64];
+    char	remote_tag[64];
+    pj_int32_t	local_cseq;
+    pj_int32_t	remote_cseq;
+    unsigned	route_cnt;
+    char	route[128];
+} dlg_state;
+
+static void copy_str(char *dst, unsigned size, const pj_str_t *src)
+{
+    unsigned len = (unsigned)src->slen < size-1 ? (unsigned)src->slen : size-1;
+
+    pj_memcpy(dst, src->ptr, len);
+    dst[len] = '\0';
+}
+
+static void get_dlg_state(pjsip_dialog *dlg, dlg_state *st)
+{
+    const pjsip_route_hdr *r;
+    int len;
+
+    pj_bzero(st, sizeof(*st));
+    copy_str(st->call_id, sizeof(st->call_id), &dlg->call_id->id);
+    copy_str(st->local_tag, sizeof(st->local_tag), &dlg->local.info->tag);
+    copy_str(st->remote_tag, sizeof(st->remote_tag), &dlg->remote.info->tag);
+    st->local_cseq = dlg->local.cseq;
+    st->remote_cseq = dlg->remote.cseq;
+
+    for (r=dlg->route_set.next; r!=&dlg->route_set; r=r->next)
+	++st->route_cnt;
+    if (st->route_cnt) {
+	r = dlg->route_set.next;
+	len = pjsip_uri_print(PJSIP_URI_IN_ROUTING_HDR, r->name_addr.uri,
+			      st->route, sizeof(st->route)-1);
+	if (len > 0)
+	    st->route[len] = '\0';
+    }
+}
+
+/* Compare the state of rehydrated dialog with the state before it was
+ * hibernated, after the specified number of requests have been sent and
+ * received in the dialog.
+ */
+static int check_dlg_state(pjsip_dialog *dlg, const dlg_state *old,
+			   int sent, int received)
+{
+    dlg_state st;
+
+    get_dlg_state(dlg, &st);
+
+    if (strcmp(st.call_id, old->call_id) ||
+	strcmp(st.local_tag, old->local_tag) ||
+	strcmp(st.remote_tag, old->remote_tag))
+    {
+	PJ_LOG(3,(THIS_FILE, "    error: dialog id changed"));
+	return -1;
+    }
+    if (st.local_cseq != old->local_cseq + sent ||
+	st.remote_cseq != old->remote_cseq + received)
+    {
+	PJ_LOG(3,(THIS_FILE, "    error: CSeq local=%d remote=%d, "
+		  "expecting local=%d remote=%d",
+		  st.local_cseq, st.remote_cseq,
+		  old->local_cseq + sent, old->remote_cseq + received));
+	return -2;
+    }
+    if (st.route_cnt != old->route_cnt || strcmp(st.route, old->route)) {
+	PJ_LOG(3,(THIS_FILE, "    error: route set changed"));
+	return -3;
+    }
+    return 0;
+}
+
+/* Hibernate subscription, waiting until it's idle */
+static pj_status_t hibernate(pjsip_evsub *sub)
+{
+    unsigned i;
+    pj_status_t status = PJ_EBUSY;
+
+    for (i=0; i<100 && status == PJ_EBUSY; ++i) {
+	status = pjsip_evsub_hibernate(sub);
+	if (status == PJ_EBUSY)
+	    flush_events(10);
+    }
+    return status;
+}
+
+/* Wait until the subscription has been rehydrated and the watcher has
+ * received the NOTIFY.
+ */
+static int wait_rehydrate(const struct watcher *w, unsigned notify_cnt)
+{
+    unsigned i;
+
+    for (i=0; i<500; ++i) {
+	pj_time_val delay = {0, 10};
+
+	if (hib_test.rehydrate_cnt && w->notify_cnt >= notify_cnt)
+	    return 0;
+	pjsip_endpt_handle_events(endpt, &delay);
+    }
+
+    PJ_LOG(3,(THIS_FILE, "    error: subscription is not rehydrated"));
+    return -1;
+}
+
+/* Hibernate both sides of a subscription, and wake them up with incoming
+ * SUBSCRIBE and NOTIFY requests. TCP is used so that the transactions
+ * terminate right away, and the initial SUBSCRIBE carries Record-Route
+ * to have route set in both dialogs.
+ */
+static int hibernate_test(void)
+{
+    pj_str_t uri = pj_str(TCP_CONTACT);
+    pj_str_t rr_uri = pj_str("<sip:127.0.0.1:5074;transport=tcp;lr>");
+    const pj_str_t STR_RR = { "Record-Route", 12 };
+    struct watcher *w = &presentity_test.w[0];
+    pjsip_dialog *dlg;
+    pjsip_tx_data *tdata;
+    pjsip_generic_string_hdr *rr;
+    pjsip_pres_status st;
+    dlg_state old;
+    unsigned i;
+    int rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  hibernation"));
+
+    pj_bzero(&presentity_test, sizeof(presentity_test));
+    pj_bzero(&hib_test, sizeof(hib_test));
+
+    status = pjsip_dlg_create_uac(pjsip_ua_instance(), &uri, &uri, &uri,
+				  &uri, &dlg);
+    if (status != PJ_SUCCESS)
+	return -400;
+
+    status = pjsip_pres_create_uac(dlg, &uac_cb, 0, &w->sub);
+    if (status != PJ_SUCCESS)
+	return -410;
+    pjsip_evsub_set_mod_data(w->sub, mod_pres_test.id, w);
+
+    status = pjsip_pres_initiate(w->sub, 600, &tdata);
+    if (status != PJ_SUCCESS)
+	return -420;
+    rr = pjsip_generic_string_hdr_create(tdata->pool, &STR_RR, &rr_uri);
+    pjsip_msg_add_hdr(tdata->msg, (pjsip_hdr*)rr);
+    status = pjsip_pres_send_request(w->sub, tdata);
+    if (status != PJ_SUCCESS)
+	return -430;
+
+    for (i=0; i<500 && !has_note(w, "hib"); ++i)
+	flush_events(10);
+    if (!has_note(w, "hib") || !hib_test.uas) {
+	PJ_LOG(3,(THIS_FILE, "    error: subscription is not active"));
+	rc = -440;
+	goto on_return;
+    }
+
+    /* Refused hibernation must leave the subscription intact */
+    flush_events(100);
+    hib_test.refuse = PJ_TRUE;
+    status = pjsip_evsub_hibernate(hib_test.uas);
+    hib_test.refuse = PJ_FALSE;
+    if (status == PJ_SUCCESS) {
+	PJ_LOG(3,(THIS_FILE, "    error: hibernation is not refused"));
+	rc = -450;
+	goto on_return;
+    }
+    if (pjsip_pres_get_status(hib_test.uas, &st) != PJ_SUCCESS ||
+	st.info_cnt != 1 || pj_strcmp2(&st.info[0].rpid.note, "hib"))
+    {
+	PJ_LOG(3,(THIS_FILE, "    error: status lost after refusal"));
+	rc = -460;
+	goto on_return;
+    }
+
+    /* Hibernate notifier, and wake it up with refreshing SUBSCRIBE */
+    get_dlg_state(pjsip_evsub_get_dlg(hib_test.uas), &old);
+    if (old.route_cnt != 1) {
+	PJ_LOG(3,(THIS_FILE, "    error: expecting route set"));
+	rc = -470;
+	goto on_return;
+    }
+    status = hibernate(hib_test.uas);
+    if (status != PJ_SUCCESS) {
+	app_perror("    error: unable to hibernate notifier", status);
+	rc = -480;
+	goto on_return;
+    }
+    hib_test.uas = NULL;
+    if (pjsip_evsub_get_hibernated_count() != 1) {
+	rc = -490;
+	goto on_return;
+    }
+
+    w->notify_cnt = 0;
+    status = pjsip_pres_initiate(w->sub, 600, &tdata);
+    if (status == PJ_SUCCESS)
+	status = pjsip_pres_send_request(w->sub, tdata);
+    if (status != PJ_SUCCESS) {
+	rc = -500;
+	goto on_return;
+    }
+    if (wait_rehydrate(w, 1) != 0 || !hib_test.uas) {
+	rc = -510;
+	goto on_return;
+    }
+    if (pjsip_evsub_get_hibernated_count() != 0) {
+	rc = -520;
+	goto on_return;
+    }
+    /* SUBSCRIBE received, NOTIFY sent */
+    rc = check_dlg_state(pjsip_evsub_get_dlg(hib_test.uas), &old, 1, 1);
+    if (rc != 0) {
+	rc = -530 + rc;
+	goto on_return;
+    }
+    if (!has_note(w, "hib")) {
+	PJ_LOG(3,(THIS_FILE, "    error: status is not restored"));
+	rc = -540;
+	goto on_return;
+    }
+
+    /* Hibernate subscriber, and wake it up with NOTIFY */
+    get_dlg_state(pjsip_evsub_get_dlg(w->sub), &old);
+    status = hibernate(w->sub);
+    if (status != PJ_SUCCESS) {
+	app_perror("    error: unable to hibernate subscriber", status);
+	rc = -550;
+	goto on_return;
+    }
+    w->sub = NULL;
+
+    hib_test.rehydrate_cnt = 0;
+    w->notify_cnt = 0;
+    status = pjsip_pres_current_notify(hib_test.uas, &tdata);
+    if (status == PJ_SUCCESS)
+	status = pjsip_pres_send_request(hib_test.uas, tdata);
+    if (status != PJ_SUCCESS) {
+	rc = -560;
+	goto on_return;
+    }
+    if (wait_rehydrate(w, 1) != 0 || !w->sub) {
+	rc = -570;
+	goto on_return;
+    }
+    /* NOTIFY received */
+    rc = check_dlg_state(pjsip_evsub_get_dlg(w->sub), &old, 0, 1);
+    if (rc != 0) {
+	rc = -580 + rc;
+	goto on_return;
+    }
+
+on_return:
+    /* Unsubscribe */
+    if (w->sub) {
+	status = pjsip_pres_initiate(w->sub, 0, &tdata);
+	if (status == PJ_SUCCESS)
+	    pjsip_pres_send_request(w->sub, tdata);
+	for (i=0; i<500 && w->sub; ++i)
+	    flush_events(10);
+    }
+    return rc;
+}
+
+
+/************************************************************************/
+static pjsip_dialog* on_dlg_forked(pjsip_dialog *first_set, pjsip_rx_data *res)
+{
+    PJ_UNUSED_ARG(first_set);
+    PJ_UNUSED_ARG(res);
+
+    return NULL;
+}
+
+int pres_test(void)
+{
+    int rc;
+
+    /* Init UA layer */
+    if (pjsip_ua_instance()->id == -1) {
+	pjsip_ua_init_param ua_param;
+	pj_bzero(&ua_param, sizeof(ua_param));
+	ua_param.on_dlg_forked = &on_dlg_forked;
+	pjsip_ua_init_module(endpt, &ua_param);
+    }
+
+    /* Init event subscription and presence */
+    if (pjsip_evsub_init_module(endpt) != PJ_SUCCESS ||
+	pjsip_pres_init_module(endpt, pjsip_evsub_instance()) != PJ_SUCCESS)
+    {
+	return -1;
+    }
+
+    uac_cb.on_evsub_state = &uac_on_evsub_state;
+    uac_cb.on_rx_notify = &uac_on_rx_notify;
+    uac_cb.on_rehydrate = &uac_on_rehydrate;
+    uas_cb.on_hibernate = &uas_on_hibernate;
+    uas_cb.on_rehydrate = &uas_on_rehydrate;
+
+    if (pjsip_endpt_register_module(endpt, &mod_pres_test) != PJ_SUCCESS)
+	return -2;
+
+    /* Create SIP UDP transport */
+    {
+	pj_sockaddr_in addr;
+	pjsip_transport *tp;
+	pj_status_t status;
+
+	pj_sockaddr_in_init(&addr, NULL, PORT);
+	status = pjsip_udp_transport_start(endpt, &addr, NULL, 1, &tp);
+	if (status != PJ_SUCCESS) {
+	    rc = -3;
+	    goto on_return;
+	}
+    }
+
+    /* Create SIP TCP transport */
+    {
+	pj_sockaddr_in addr;
+	pjsip_tpfactory *tpfactory;
+	pj_status_t status;
+
+	pj_sockaddr_in_init(&addr, NULL, TCP_PORT);
+	status = pjsip_tcp_transport_start(endpt, &addr, 1, &tpfactory);
+	if (status != PJ_SUCCESS) {
+	    rc = -4;
+	    goto on_return;
+	}
+    }
+
+    rc = fanout_test(0);
+    if (rc != 0)
+	goto on_return;
+
+    rc = fanout_test(2);
+    if (rc != 0)
+	goto on_return;
+
+    rc = coalesce_test();
+    if (rc != 0)
+	goto on_return;
+
+    rc = destroy_race_test();
+    if (rc != 0)
+	goto on_return;
+
+    rc = hibernate_test();
+    if (rc != 0)
+	goto on_return;
+
+on_return:
+    pjsip_endpt_unregister_module(endpt, &mod_pres_test);
+    return rc;
+}
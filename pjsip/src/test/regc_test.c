@@ -733,6 +733,205 @@ static int auth_send_error(const pj_str_t *registrar_uri,
 };
 
 
+/* Create a registration session and send the initial REGISTER */
+static int sched_send(const pj_str_t *registrar_uri,
+		      struct client *client,
+		      pj_bool_t auth,
+		      pjsip_regc **p_regc)
+{
+    const pj_str_t aor = pj_str("<sip:regc-test@pjsip.org>");
+    pj_str_t contact = pj_str("<sip:c@C>");
+    pjsip_regc *regc;
+    pjsip_tx_data *tdata;
+    pj_status_t status;
+
+    pj_bzero(client, sizeof(*client));
+
+    status = pjsip_regc_create(endpt, client, &client_cb, &regc);
+    if (status != PJ_SUCCESS)
+	return -800;
+
+    status = pjsip_regc_init(regc, registrar_uri, &aor, &aor, 1,
+			     &contact, 60);
+    if (status != PJ_SUCCESS) {
+	pjsip_regc_destroy(regc);
+	return -810;
+    }
+
+    if (auth) {
+	pjsip_cred_info cred;
+
+	pj_bzero(&cred, sizeof(cred));
+	cred.realm = pj_str("*");
+	cred.scheme = pj_str("digest");
+	cred.username = pj_str("user");
+	cred.data_type = PJSIP_CRED_DATA_PLAIN_PASSWD;
+	cred.data = pj_str("password");
+
+	status = pjsip_regc_set_credentials(regc, 1, &cred);
+	if (status != PJ_SUCCESS) {
+	    pjsip_regc_destroy(regc);
+	    return -820;
+	}
+    }
+
+    status = pjsip_regc_register(regc, PJ_TRUE, &tdata);
+    if (status == PJ_SUCCESS)
+	status = pjsip_regc_send(regc, tdata);
+    if (status != PJ_SUCCESS) {
+	pjsip_regc_destroy(regc);
+	return -830;
+    }
+
+    *p_regc = regc;
+    return 0;
+}
+
+/* Wait until all clients have got their final response */
+static int sched_wait(struct client client[], unsigned cnt)
+{
+    unsigned i, j;
+
+    for (i=0; i<600; ++i) {
+	for (j=0; j<cnt && client[j].done; ++j)
+	    ;
+	if (j == cnt)
+	    break;
+	flush_events(100);
+    }
+
+    for (j=0; j<cnt; ++j) {
+	if (!client[j].done) {
+	    PJ_LOG(3,(THIS_FILE, "    error: test has timed out"));
+	    return -900;
+	}
+	if (client[j].error || client[j].code != 200) {
+	    PJ_LOG(3,(THIS_FILE, "    error: client %d got err=%d, code=%d",
+		      j, client[j].error, client[j].code));
+	    return -910;
+	}
+    }
+
+    return 0;
+}
+
+/* Only max_pending REGISTER transactions may be outstanding, the rest
+ * must be queued and sent as the pending ones complete.
+ */
+static int max_pending_test(const pj_str_t *registrar_uri)
+{
+    enum { COUNT = 3 };
+    struct registrar_cfg server_cfg = 
+	/* respond	code	auth	  contact  exp_prm expires more_contacts */
+	{ PJ_TRUE,	200,	PJ_FALSE, EXACT,   60,	    0,	    {NULL, 0}};
+    struct client client[COUNT];
+    pjsip_regc *regc[COUNT];
+    unsigned i, n = 0, old_max_pending;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  max pending transactions"));
+
+    pj_memcpy(&registrar.cfg, &server_cfg, sizeof(server_cfg));
+    old_max_pending = pjsip_cfg()->regc.max_pending;
+    pjsip_cfg()->regc.max_pending = 1;
+    send_mod.count = 0;
+
+    for (n=0; n<COUNT; ++n) {
+	rc = sched_send(registrar_uri, &client[n], PJ_FALSE, &regc[n]);
+	if (rc != 0)
+	    goto on_return;
+    }
+
+    /* Only the first REGISTER may have been sent */
+    if (send_mod.count != 1) {
+	PJ_LOG(3,(THIS_FILE, "    error: expecting 1 request sent, got %d",
+		  send_mod.count));
+	rc = -1000;
+	goto on_return;
+    }
+
+    rc = sched_wait(client, COUNT);
+    if (rc != 0)
+	goto on_return;
+
+    if (send_mod.count != COUNT) {
+	PJ_LOG(3,(THIS_FILE, "    error: expecting %d requests sent, got %d",
+		  COUNT, send_mod.count));
+	rc = -1010;
+	goto on_return;
+    }
+
+on_return:
+    for (i=0; i<n; ++i)
+	pjsip_regc_destroy(regc[i]);
+    pjsip_cfg()->regc.max_pending = old_max_pending;
+    return rc;
+}
+
+/* Challenge received by one registration must be reused by the next
+ * one to authenticate its initial REGISTER.
+ */
+static int share_auth_test(const pj_str_t *registrar_uri)
+{
+    struct registrar_cfg server_cfg = 
+	/* respond	code	auth	  contact  exp_prm expires more_contacts */
+	{ PJ_TRUE,	200,	PJ_TRUE,  EXACT,   60,	    0,	    {NULL, 0}};
+    struct client client[2];
+    pjsip_regc *regc[2];
+    unsigned i, n = 0;
+    pj_bool_t old_share_auth;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  shared authentication challenge"));
+
+    pj_memcpy(&registrar.cfg, &server_cfg, sizeof(server_cfg));
+    old_share_auth = pjsip_cfg()->regc.share_auth;
+    pjsip_cfg()->regc.share_auth = PJ_TRUE;
+
+    /* First registration gets challenged */
+    send_mod.count = 0;
+    rc = sched_send(registrar_uri, &client[n], PJ_TRUE, &regc[n]);
+    if (rc != 0)
+	goto on_return;
+    ++n;
+
+    rc = sched_wait(client, n);
+    if (rc != 0)
+	goto on_return;
+
+    if (send_mod.count != 2) {
+	PJ_LOG(3,(THIS_FILE, "    error: expecting 2 requests sent, got %d",
+		  send_mod.count));
+	rc = -1100;
+	goto on_return;
+    }
+
+    /* Second registration authenticates right away */
+    send_mod.count = 0;
+    rc = sched_send(registrar_uri, &client[n], PJ_TRUE, &regc[n]);
+    if (rc != 0)
+	goto on_return;
+    ++n;
+
+    rc = sched_wait(&client[1], 1);
+    if (rc != 0)
+	goto on_return;
+
+    if (send_mod.count != 1) {
+	PJ_LOG(3,(THIS_FILE, "    error: expecting 1 request sent, got %d",
+		  send_mod.count));
+	rc = -1110;
+	goto on_return;
+    }
+
+on_return:
+    for (i=0; i<n; ++i)
+	pjsip_regc_destroy(regc[i]);
+    pjsip_cfg()->regc.share_auth = old_share_auth;
+    return rc;
+}
+
+
 
 
 /************************************************************************/
@@ -1148,6 +1347,16 @@ int regc_test(void)
     if (rc != 0)
 	goto on_return;
 
+    /* Pending transaction limit */
+    rc = max_pending_test(&registrar_uri);
+    if (rc != 0)
+	goto on_return;
+
+    /* Shared authentication challenge */
+    rc = share_auth_test(&registrar_uri);
+    if (rc != 0)
+	goto on_return;
+
 on_return:
     if (registrar.mod.id != -1) {
 	pjsip_endpt_unregister_module(endpt, &registrar.mod);
@@ -0,0 +1,387 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+#include <pjsip_ua.h>
+#include <pjsip.h>
+#include <pjlib.h>
+
+#define THIS_FILE   "registrar_test.c"
+
+#define AOR	    "sip:alice@example.com"
+#define MIN_EXPIRES 60
+#define MAX_EXPIRES 3600
+#define DEF_EXPIRES 1800
+#define MAX_CONTACTS 3
+
+
+/* Result of a REGISTER request */
+static struct result
+{
+    pj_bool_t	done;
+    int		code;
+    unsigned	contact_cnt;
+    int		min_expires;
+} result;
+
+
+static void send_cb(void *token, pjsip_event *e)
+{
+    pjsip_transaction *tsx = e->body.tsx_state.tsx;
+
+    PJ_UNUSED_ARG(token);
+
+    result.code = tsx->status_code;
+    result.contact_cnt = 0;
+    result.min_expires = -1;
+
+    if (e->body.tsx_state.type == PJSIP_EVENT_RX_MSG) {
+	pjsip_msg *msg = e->body.tsx_state.src.rdata->msg_info.msg;
+	pjsip_min_expires_hdr *h_min;
+	pjsip_hdr *h;
+
+	for (h=msg->hdr.next; h!=&msg->hdr; h=h->next) {
+	    if (h->type == PJSIP_H_CONTACT)
+		++result.contact_cnt;
+	}
+
+	h_min = (pjsip_min_expires_hdr*)
+		pjsip_msg_find_hdr(msg, PJSIP_H_MIN_EXPIRES, NULL);
+	if (h_min)
+	    result.min_expires = h_min->ivalue;
+    }
+
+    result.done = PJ_TRUE;
+}
+
+
+/* Send REGISTER request and wait for the response. */
+static int send_register(const pj_str_t *registrar_uri,
+			 const char *call_id, int cseq, int expires,
+			 const char *contacts[])
+{
+    pj_str_t from = pj_str("<" AOR ">");
+    pj_str_t to = pj_str("<" AOR ">");
+    pj_str_t s_call_id = pj_str((char*)call_id);
+    const pj_str_t STR_CONTACT = { "Contact", 7 };
+    pjsip_tx_data *tdata;
+    pj_time_val timeout;
+    unsigned i;
+    pj_status_t status;
+
+    status = pjsip_endpt_create_request(endpt, &pjsip_register_method,
+					registrar_uri, &from, &to, NULL,
+					&s_call_id, cseq, NULL, &tdata);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error creating request", status);
+	return -10;
+    }
+
+    for (i=0; contacts[i]; ++i) {
+	pj_size_t len = pj_ansi_strlen(contacts[i]);
+	char *buf = (char*) pj_pool_alloc(tdata->pool, len + 1);
+	pjsip_hdr *h;
+
+	pj_memcpy(buf, contacts[i], len + 1);
+	h = (pjsip_hdr*) pjsip_parse_hdr(tdata->pool, &STR_CONTACT, buf, len,
+					 NULL);
+	if (!h) {
+	    pjsip_tx_data_dec_ref(tdata);
+	    return -20;
+	}
+	pjsip_msg_add_hdr(tdata->msg, h);
+    }
+
+    if (expires >= 0) {
+	pjsip_msg_add_hdr(tdata->msg, (pjsip_hdr*)
+			  pjsip_expires_hdr_create(tdata->pool, expires));
+    }
+
+    pj_bzero(&result, sizeof(result));
+    status = pjsip_endpt_send_request(endpt, tdata, -1, NULL, &send_cb);
+    if (status != PJ_SUCCESS)
+	return -30;
+
+    pj_gettickcount(&timeout);
+    timeout.sec += 5;
+    while (!result.done) {
+	pj_time_val now, delay = { 0, 10 };
+
+	pjsip_endpt_handle_events(endpt, &delay);
+	pj_gettickcount(&now);
+	if (PJ_TIME_VAL_GTE(now, timeout))
+	    return -40;
+    }
+
+    return 0;
+}
+
+
+/* Get the remaining expiration of a binding, or -1 if it's not found. */
+static int get_expires(pjsip_registrar *reg, pj_pool_t *pool,
+		       const char *contact)
+{
+    pj_str_t aor = pj_str(AOR);
+    pjsip_registrar_binding bindings[MAX_CONTACTS];
+    unsigned i, count = PJ_ARRAY_SIZE(bindings);
+
+    if (pjsip_registrar_lookup(reg, &aor, pool, &count, bindings) !=
+	PJ_SUCCESS)
+    {
+	return -1;
+    }
+
+    for (i=0; i<count; ++i) {
+	if (pj_strcmp2(&bindings[i].contact, contact) == 0)
+	    return (int)bindings[i].expires;
+    }
+
+    return -1;
+}
+
+
+/* Number of bindings of the address of record. */
+static unsigned get_binding_cnt(pjsip_registrar *reg, pj_pool_t *pool)
+{
+    pj_str_t aor = pj_str(AOR);
+    pjsip_registrar_binding bindings[MAX_CONTACTS];
+    unsigned count = PJ_ARRAY_SIZE(bindings);
+
+    if (pjsip_registrar_lookup(reg, &aor, pool, &count, bindings) !=
+	PJ_SUCCESS)
+    {
+	return 0;
+    }
+
+    return count;
+}
+
+
+/* REGISTER processing of RFC 3261 Section 10.3, in sequence. */
+static struct test_step
+{
+    const char	*title;
+    const char	*call_id;
+    int		 cseq;
+    int		 expires;	    /* Expires header, or -1		*/
+    const char	*contacts[3];
+    int		 code;		    /* Expected response		*/
+    unsigned	 binding_cnt;	    /* Expected bindings afterwards	*/
+    const char	*check_contact;	    /* Binding to check, if any		*/
+    int		 check_expires;	    /* Its expected expiration		*/
+} test_steps[] =
+{
+    {
+	"expiration is reduced to maximum",
+	"call-a", 1, 7200, { "<sip:alice@10.0.0.1>" },
+	200, 1, "sip:alice@10.0.0.1", MAX_EXPIRES
+    },
+    {
+	"expires parameter overrides Expires header",
+	"call-a", 2, 7200, { "<sip:alice@10.0.0.2>;expires=120" },
+	200, 2, "sip:alice@10.0.0.2", 120
+    },
+    {
+	"default expiration",
+	"call-a", 3, -1, { "<sip:alice@10.0.0.3>" },
+	200, 3, "sip:alice@10.0.0.3", DEF_EXPIRES
+    },
+    {
+	"interval too brief",
+	"call-a", 4, 30, { "<sip:alice@10.0.0.4>" },
+	423, 3, NULL, 0
+    },
+    {
+	"too many contacts",
+	"call-a", 5, 600, { "<sip:alice@10.0.0.4>" },
+	403, 3, NULL, 0
+    },
+    {
+	"same Call-ID with same CSeq",
+	"call-a", 3, 600, { "<sip:alice@10.0.0.3>" },
+	500, 3, "sip:alice@10.0.0.3", DEF_EXPIRES
+    },
+    {
+	"same Call-ID with lower CSeq",
+	"call-a", 2, 600, { "<sip:alice@10.0.0.3>" },
+	500, 3, "sip:alice@10.0.0.3", DEF_EXPIRES
+    },
+    {
+	"other Call-ID with lower CSeq",
+	"call-b", 1, 600, { "<sip:alice@10.0.0.1>" },
+	200, 3, "sip:alice@10.0.0.1", 600
+    },
+    {
+	"equivalent URI updates the binding",
+	"call-b", 2, 300, { "<sip:alice@10.0.0.1;foo=bar>" },
+	200, 3, "sip:alice@10.0.0.1", 300
+    },
+    {
+	"binding removed with zero expiration",
+	"call-b", 3, -1, { "<sip:alice@10.0.0.2>;expires=0" },
+	200, 2, "sip:alice@10.0.0.2", -1
+    },
+    {
+	"query without Contact",
+	"call-b", 4, -1, { NULL },
+	200, 2, "sip:alice@10.0.0.3", DEF_EXPIRES
+    },
+    {
+	"wildcard with non-zero Expires",
+	"call-b", 5, 600, { "*" },
+	400, 2, NULL, 0
+    },
+    {
+	"wildcard without Expires",
+	"call-b", 6, -1, { "*" },
+	400, 2, NULL, 0
+    },
+    {
+	"wildcard with other contacts",
+	"call-b", 7, 0, { "*", "<sip:alice@10.0.0.5>" },
+	400, 2, NULL, 0
+    },
+    {
+	"wildcard with old CSeq",
+	"call-b", 1, 0, { "*" },
+	500, 2, NULL, 0
+    },
+    {
+	"wildcard removes all bindings",
+	"call-c", 1, 0, { "*" },
+	200, 0, "sip:alice@10.0.0.1", -1
+    },
+};
+
+
+int registrar_test(void)
+{
+    pjsip_registrar_setting setting;
+    pjsip_registrar *reg = NULL;
+    pjsip_transport *udp = NULL;
+    pj_sockaddr_in addr;
+    pj_uint16_t port;
+    pj_pool_t *pool;
+    char uri_buf[80];
+    pj_str_t registrar_uri;
+    unsigned i;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "Registrar test"));
+
+    pool = pjsip_endpt_create_pool(endpt, "regtest", 1000, 1000);
+
+    /* Acquire existing transport, if any */
+    pj_sockaddr_in_init(&addr, 0, 0);
+    rc = pjsip_endpt_acquire_transport(endpt, PJSIP_TRANSPORT_UDP, &addr,
+				       sizeof(addr), NULL, &udp);
+    if (rc == PJ_SUCCESS) {
+	port = pj_sockaddr_get_port(&udp->local_addr);
+	pjsip_transport_dec_ref(udp);
+	udp = NULL;
+    } else {
+	rc = pjsip_udp_transport_start(endpt, NULL, NULL, 1, &udp);
+	if (rc != PJ_SUCCESS) {
+	    app_perror("   error creating UDP transport", rc);
+	    rc = -100;
+	    goto on_return;
+	}
+	port = pj_sockaddr_get_port(&udp->local_addr);
+    }
+
+    pj_ansi_snprintf(uri_buf, sizeof(uri_buf), "sip:127.0.0.1:%d",
+		     (int)port);
+    registrar_uri = pj_str(uri_buf);
+
+    pjsip_registrar_setting_default(&setting);
+    setting.max_contacts = MAX_CONTACTS;
+    setting.min_expires = MIN_EXPIRES;
+    setting.max_expires = MAX_EXPIRES;
+    setting.default_expires = DEF_EXPIRES;
+
+    rc = pjsip_registrar_create(endpt, &setting, NULL, &reg);
+    if (rc != PJ_SUCCESS) {
+	app_perror("   error creating registrar", rc);
+	rc = -110;
+	goto on_return;
+    }
+
+    for (i=0; i<PJ_ARRAY_SIZE(test_steps); ++i) {
+	struct test_step *t = &test_steps[i];
+	unsigned cnt;
+
+	PJ_LOG(3,(THIS_FILE, "  %s", t->title));
+
+	rc = send_register(&registrar_uri, t->call_id, t->cseq, t->expires,
+			   t->contacts);
+	if (rc != 0) {
+	    rc = -200 - i*10 + rc/10;
+	    goto on_return;
+	}
+
+	if (result.code != t->code) {
+	    PJ_LOG(3,(THIS_FILE, "   error: got %d, expecting %d",
+		      result.code, t->code));
+	    rc = -201 - i*10;
+	    goto on_return;
+	}
+
+	/* Response to successful request contains all current bindings */
+	cnt = get_binding_cnt(reg, pool);
+	if (cnt != t->binding_cnt ||
+	    (t->code == 200 && result.contact_cnt != cnt))
+	{
+	    PJ_LOG(3,(THIS_FILE, "   error: %u bindings, %u in response, "
+		      "expecting %u", cnt, result.contact_cnt,
+		      t->binding_cnt));
+	    rc = -202 - i*10;
+	    goto on_return;
+	}
+
+	if (t->code == 423 && result.min_expires != MIN_EXPIRES) {
+	    rc = -203 - i*10;
+	    goto on_return;
+	}
+
+	if (t->check_contact) {
+	    int expires = get_expires(reg, pool, t->check_contact);
+
+	    /* Allow a second to pass since the request */
+	    if (expires > t->check_expires ||
+		expires < t->check_expires - (t->check_expires > 0))
+	    {
+		PJ_LOG(3,(THIS_FILE, "   error: %s expires in %d, "
+			  "expecting %d", t->check_contact, expires,
+			  t->check_expires));
+		rc = -204 - i*10;
+		goto on_return;
+	    }
+	}
+    }
+
+    rc = 0;
+
+on_return:
+    if (reg)
+	pjsip_registrar_destroy(reg);
+    if (udp)
+	pjsip_transport_dec_ref(udp);
+    pjsip_endpt_release_pool(endpt, pool);
+    return rc;
+}
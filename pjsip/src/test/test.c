@@ -309,6 +309,10 @@ int test_main(void)
     DO_TEST(txdata_test());
 #endif
 
+#if INCLUDE_AUTH_TEST
+    DO_TEST(auth_test());
+#endif
+
 #if INCLUDE_TSX_BENCH
     DO_TEST(tsx_bench());
 #endif
@@ -365,10 +369,22 @@ int test_main(void)
     DO_TEST(inv_offer_answer_test());
 #endif
 
+#if INCLUDE_PRES_TEST
+    DO_TEST(pres_test());
+#endif
+
+#if INCLUDE_POOL_SLAB_TEST
+    DO_TEST(pool_slab_test());
+#endif
+
 #if INCLUDE_REGC_TEST
     DO_TEST(regc_test());
 #endif
 
+#if INCLUDE_REGISTRAR_TEST
+    DO_TEST(registrar_test());
+#endif
+
     /*
      * Better be last because it recreates the endpt
      */
@@ -386,6 +402,17 @@ on_return:
     pjsip_endpt_destroy(endpt);
     pj_caching_pool_destroy(&caching_pool);
 
+    /* pjsua creates its own endpoint, so it can only be tested once
+     * ours has been destroyed.
+     */
+#if INCLUDE_PJSUA_TEST
+    if (rc == 0) {
+	PJ_LOG(3, (THIS_FILE, "Running pjsua_test()..."));
+	rc = pjsua_test();
+	PJ_LOG(3, (THIS_FILE, "%s(%d)", (rc ? "..ERROR" : "..success"), rc));
+    }
+#endif
+
     PJ_LOG(3,(THIS_FILE, ""));
  
     pj_thread_get_stack_info(pj_thread_this(), &filename, &line);
@@ -59,6 +59,7 @@ extern pj_caching_pool caching_pool;
 #define INCLUDE_MSG_TEST	INCLUDE_MESSAGING_GROUP
 #define INCLUDE_MULTIPART_TEST	INCLUDE_MESSAGING_GROUP
 #define INCLUDE_TXDATA_TEST	INCLUDE_MESSAGING_GROUP
+#define INCLUDE_AUTH_TEST	INCLUDE_MESSAGING_GROUP
 #define INCLUDE_TSX_BENCH	INCLUDE_MESSAGING_GROUP
 #define INCLUDE_UDP_TEST	INCLUDE_TRANSPORT_GROUP
 #define INCLUDE_LOOP_TEST	INCLUDE_TRANSPORT_GROUP
@@ -67,7 +68,11 @@ extern pj_caching_pool caching_pool;
 #define INCLUDE_TSX_TEST	INCLUDE_TSX_GROUP
 #define INCLUDE_TSX_DESTROY_TEST INCLUDE_TSX_GROUP
 #define INCLUDE_INV_OA_TEST	INCLUDE_INV_GROUP
+#define INCLUDE_PRES_TEST	INCLUDE_INV_GROUP
+#define INCLUDE_POOL_SLAB_TEST	INCLUDE_INV_GROUP
+#define INCLUDE_PJSUA_TEST	INCLUDE_INV_GROUP
 #define INCLUDE_REGC_TEST	INCLUDE_REGC_GROUP
+#define INCLUDE_REGISTRAR_TEST	INCLUDE_REGC_GROUP
 
 
 /* The tests */
@@ -76,6 +81,7 @@ int msg_test(void);
 int msg_err_test(void);
 int multipart_test(void);
 int txdata_test(void);
+int auth_test(void);
 int tsx_bench(void);
 int tsx_destroy_test(void);
 int transport_udp_test(void);
@@ -83,6 +89,7 @@ int transport_loop_test(void);
 int transport_tcp_test(void);
 int resolve_test(void);
 int regc_test(void);
+int registrar_test(void);
 
 struct tsx_test_param
 {
@@ -110,6 +117,15 @@ int transport_load_test(char *target_url);
 /* Invite session */
 int inv_offer_answer_test(void);
 
+/* Presence */
+int pres_test(void);
+
+/* Pool slabs */
+int pool_slab_test(void);
+
+/* pjsua-lib */
+int pjsua_test(void);
+
 /* Test main entry */
 int  test_main(void);
 
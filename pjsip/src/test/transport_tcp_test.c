@@ -25,10 +25,97 @@
 #define THIS_FILE   "transport_tcp_test.c"
 
 
+#if PJ_HAS_TCP
+
+static struct race_result
+{
+    pj_bool_t	    done;
+    pj_status_t	    status;
+    unsigned	    index;
+} race_result;
+
+static void on_race_complete(void *token, pjsip_tx_data *tdata,
+			     pj_status_t status, unsigned index)
+{
+    PJ_UNUSED_ARG(token);
+    PJ_UNUSED_ARG(tdata);
+
+    race_result.status = status;
+    race_result.index = index;
+    race_result.done = PJ_TRUE;
+}
+
+/*
+ * Connection race: the first address refuses the connection, so the
+ * race must be won by the second address, which is the TCP listener.
+ */
+static int tcp_race_test(const pj_sockaddr_in *listener)
+{
+    pjsip_tx_data *tdata;
+    pjsip_server_addresses *addr;
+    pj_str_t target, from, tmp;
+    pj_time_val timeout, now;
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "   connection race test"));
+
+    target = pj_str("sip:race@127.0.0.1;transport=tcp");
+    from = pj_str("sip:tcp_race_test@127.0.0.1");
+    status = pjsip_endpt_create_request(endpt, &pjsip_options_method,
+					&target, &from, &target, NULL, NULL,
+					-1, NULL, &tdata);
+    if (status != PJ_SUCCESS)
+	return -200;
+
+    addr = &tdata->dest_info.addr;
+    addr->count = 2;
+    addr->entry[0].type = PJSIP_TRANSPORT_TCP;
+    addr->entry[0].addr_len = sizeof(pj_sockaddr_in);
+    pj_sockaddr_in_init(&addr->entry[0].addr.ipv4,
+			pj_cstr(&tmp, "127.0.0.1"), 1);
+    addr->entry[1].type = PJSIP_TRANSPORT_TCP;
+    addr->entry[1].addr_len = sizeof(pj_sockaddr_in);
+    pj_memcpy(&addr->entry[1].addr, listener, sizeof(*listener));
+    tdata->dest_info.cur_addr = 0;
+
+    pj_bzero(&race_result, sizeof(race_result));
+    status = pjsip_tpmgr_race_transport(pjsip_endpt_get_tpmgr(endpt), tdata,
+					NULL, &on_race_complete);
+    if (status != PJ_EPENDING) {
+	rc = -210;
+	goto on_return;
+    }
+
+    pj_gettickcount(&timeout);
+    timeout.sec += 5;
+    do {
+	pj_time_val delay = {0, 10};
+	pjsip_endpt_handle_events(endpt, &delay);
+	pj_gettickcount(&now);
+    } while (!race_result.done && PJ_TIME_VAL_LT(now, timeout));
+
+    if (!race_result.done) {
+	PJ_LOG(3,(THIS_FILE, "   error: race has not finished"));
+	rc = -220;
+	goto on_return;
+    }
+    if (race_result.status != PJ_SUCCESS || race_result.index != 1) {
+	PJ_LOG(3,(THIS_FILE, "   error: race result status=%d index=%d",
+		  race_result.status, race_result.index));
+	rc = -230;
+	goto on_return;
+    }
+
+on_return:
+    pjsip_tx_data_dec_ref(tdata);
+    return rc;
+}
+
+
 /*
  * TCP transport test.
  */
-#if PJ_HAS_TCP
 int transport_tcp_test(void)
 {
     enum { SEND_RECV_LOOP = 8 };
@@ -60,6 +147,11 @@ int transport_tcp_test(void)
 		    pj_inet_ntoa(rem_addr.sin_addr),
 		    pj_ntohs(rem_addr.sin_port));
 
+    /* Race to the listener. The connection is then reused below. */
+    status = tcp_race_test(&rem_addr);
+    if (status != 0)
+	return status;
+
 
     /* Acquire one TCP transport. */
     status = pjsip_endpt_acquire_transport(endpt, PJSIP_TRANSPORT_TCP, 
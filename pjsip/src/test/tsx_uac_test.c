@@ -74,6 +74,10 @@
  ** TEST9_BRANCH_ID
  **	Test failed INVITE transaction with provisional response.
  **
+ ** TEST10_BRANCH_ID
+ **	Test that retransmission interval follows the round-trip time
+ **	measured to the destination when adaptive T1 is enabled.
+ **
  **	
  *****************************************************************************
  */
@@ -87,10 +91,12 @@ static char *TEST6_BRANCH_ID = PJSIP_RFC3261_BRANCH_ID "-UAC-Test6";
 static char *TEST7_BRANCH_ID = PJSIP_RFC3261_BRANCH_ID "-UAC-Test7";
 static char *TEST8_BRANCH_ID = PJSIP_RFC3261_BRANCH_ID "-UAC-Test8";
 static char *TEST9_BRANCH_ID = PJSIP_RFC3261_BRANCH_ID "-UAC-Test9";
+static char *TEST10_BRANCH_ID = PJSIP_RFC3261_BRANCH_ID "-UAC-Test10";
 
 #define      TEST1_ALLOWED_DIFF	    (150)
 #define      TEST4_RETRANSMIT_CNT   3
 #define	     TEST5_RETRANSMIT_CNT   3
+#define	     TEST10_RETRANSMIT_CNT  2
 
 static char TARGET_URI[128];
 static char FROM_URI[128];
@@ -141,6 +147,9 @@ static int recv_count;
 static pj_time_val recv_last;
 static pj_bool_t test_complete;
 
+/* T1 expected by TEST10_BRANCH_ID. */
+static unsigned test10_t1;
+
 /* Loop transport instance. */
 static pjsip_transport *loop;
 
@@ -536,6 +545,25 @@ static void tsx_user_on_tsx_state(pjsip_transaction *tsx, pjsip_event *e)
 
 	}
 
+    } else if (pj_stricmp2(&tsx->branch, TEST10_BRANCH_ID)==0) {
+	/*
+	 * Transaction is terminated by the message receiver after checking
+	 * the retransmission interval.
+	 */
+	if (tsx->state == PJSIP_TSX_STATE_TERMINATED) {
+
+	    /* Must use the T1 derived from the round-trip time */
+	    if (tsx->t1 != test10_t1) {
+		PJ_LOG(3,(THIS_FILE,
+			  "    error: T1 is %u ms instead of %u ms",
+			  tsx->t1, test10_t1));
+		test_complete = -770;
+	    }
+
+	    if (test_complete == 0)
+		test_complete = 1;
+	}
+
     }
 }
 
@@ -705,6 +733,58 @@ static pj_bool_t msg_receiver_on_rx_request(pjsip_rx_data *rdata)
 
 	return PJ_TRUE;
 
+    } else
+    if (pj_stricmp2(&rdata->msg_info.via->branch_param, TEST10_BRANCH_ID) == 0) {
+	/*
+	 * The TEST10_BRANCH_ID test checks that the retransmissions follow
+	 * the adaptive T1, then terminates the transaction.
+	 */
+	if (recv_count == 0) {
+	    recv_last = rdata->pkt_info.timestamp;
+	} else {
+	    pj_time_val now = rdata->pkt_info.timestamp;
+	    unsigned msec_expected, msec_elapsed;
+
+	    PJ_TIME_VAL_SUB(now, recv_last);
+	    msec_elapsed = now.sec*1000 + now.msec;
+	    msec_expected = (1<<(recv_count-1)) * test10_t1;
+	    if (msec_expected > pjsip_cfg()->tsx.t2)
+		msec_expected = pjsip_cfg()->tsx.t2;
+
+	    if (DIFF(msec_expected, msec_elapsed) > TEST1_ALLOWED_DIFF) {
+		PJ_LOG(3,(THIS_FILE,
+			  "    error: expecting retransmission no. %d in %d "
+			  "ms, received in %d ms",
+			  recv_count, msec_expected, msec_elapsed));
+		test_complete = -640;
+	    }
+	    recv_last = rdata->pkt_info.timestamp;
+	}
+	recv_count++;
+
+	if (recv_count == TEST10_RETRANSMIT_CNT+1) {
+	    pj_str_t key;
+	    pjsip_transaction *tsx;
+
+	    pjsip_tsx_create_key( rdata->tp_info.pool, &key, PJSIP_ROLE_UAC,
+				  &rdata->msg_info.msg->line.req.method, rdata);
+	    tsx = pjsip_tsx_layer_find_tsx(&key, PJ_TRUE);
+	    if (tsx) {
+		pjsip_tsx_terminate(tsx, PJSIP_SC_REQUEST_TERMINATED);
+		pj_grp_lock_release(tsx->grp_lock);
+	    } else {
+		PJ_LOG(3,(THIS_FILE, "    error: uac transaction not found!"));
+		test_complete = -641;
+	    }
+
+	} else if (recv_count > TEST10_RETRANSMIT_CNT+1) {
+	    PJ_LOG(3,(THIS_FILE,"   error: not expecting %d-th packet!",
+		      recv_count));
+	    test_complete = -642;
+	}
+
+	return PJ_TRUE;
+
     } else
     if (pj_stricmp2(&rdata->msg_info.via->branch_param, TEST6_BRANCH_ID) == 0) {
 	/*
@@ -1087,6 +1167,7 @@ static int perform_tsx_test(int dummy, char *target_uri, char *from_uri,
 static int tsx_uac_retransmit_test(void)
 {
     int status = 0, enabled;
+    pj_bool_t adaptive_t1;
     int i;
     struct {
 	const pjsip_method *method;
@@ -1107,6 +1188,12 @@ static int tsx_uac_retransmit_test(void)
      */
     enabled = msg_logger_set_enabled(0);
 
+    /* This test checks the RFC 3261 retransmission schedule, which is
+     * only used when T1 is not derived from the round-trip time.
+     */
+    adaptive_t1 = pjsip_cfg()->tsx.adaptive_t1;
+    pjsip_cfg()->tsx.adaptive_t1 = PJ_FALSE;
+
     for (i=0; i<(int)PJ_ARRAY_SIZE(sub_test); ++i) {
 
 	PJ_LOG(3,(THIS_FILE, 
@@ -1133,6 +1220,9 @@ static int tsx_uac_retransmit_test(void)
     /* Restore msg logger. */
     msg_logger_set_enabled(enabled);
 
+    /* Restore adaptive T1. */
+    pjsip_cfg()->tsx.adaptive_t1 = adaptive_t1;
+
     /* Done. */
     return status;
 }
@@ -1293,6 +1383,73 @@ static int tsx_terminate_after_retransmit_test(void)
 }
 
 
+/*****************************************************************************
+ **
+ ** TEST10_BRANCH_ID: Adaptive T1
+ **
+ ** Feed the round-trip time estimate of the destination, then check that
+ ** the retransmission interval of a new transaction follows it.
+ **
+ *****************************************************************************
+ */
+static int tsx_adaptive_t1_test(void)
+{
+    unsigned rtt[] = { 20, 1000 };
+    pj_bool_t adaptive_t1;
+    unsigned min_t1;
+    pj_sockaddr addr;
+    pj_str_t host = pj_str("127.0.0.1");
+    int i, status = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  test10: adaptive T1"));
+
+    pj_sockaddr_init(pj_AF_INET(), &addr, &host,
+		     (pj_uint16_t)test_param->port);
+
+    /* Let T1 go below the default too, as in closed networks */
+    adaptive_t1 = pjsip_cfg()->tsx.adaptive_t1;
+    min_t1 = pjsip_cfg()->tsx.min_t1;
+    pjsip_cfg()->tsx.adaptive_t1 = PJ_TRUE;
+    pjsip_cfg()->tsx.min_t1 = 100;
+
+    for (i=0; i<(int)PJ_ARRAY_SIZE(rtt); ++i) {
+	pjsip_rtt_info info;
+	unsigned j;
+
+	/* Let the estimate settle on the round-trip time */
+	for (j=0; j<64; ++j)
+	    pjsip_endpt_update_rtt(endpt, &addr, rtt[i]);
+
+	status = pjsip_endpt_get_rtt_info(endpt, &addr, &info);
+	if (status != PJ_SUCCESS) {
+	    app_perror("   error: no round-trip time estimate", status);
+	    status = -1300;
+	    break;
+	}
+
+	test10_t1 = info.rto;
+	if (test10_t1 < pjsip_cfg()->tsx.min_t1)
+	    test10_t1 = pjsip_cfg()->tsx.min_t1;
+	if (test10_t1 > pjsip_cfg()->tsx.t2)
+	    test10_t1 = pjsip_cfg()->tsx.t2;
+
+	PJ_LOG(3,(THIS_FILE, "   variant %c: %u ms round-trip time, "
+		  "expecting T1=%u ms", ('a'+i), rtt[i], test10_t1));
+
+	status = perform_tsx_test(-1300, TARGET_URI, FROM_URI,
+				  TEST10_BRANCH_ID, 5, &pjsip_options_method);
+	if (status != 0)
+	    break;
+    }
+
+    pjsip_cfg()->tsx.adaptive_t1 = adaptive_t1;
+    pjsip_cfg()->tsx.min_t1 = min_t1;
+
+    /* Done. */
+    return status;
+}
+
+
 /*****************************************************************************
  **
  ** TEST6_BRANCH_ID: Successfull non-invite transaction
@@ -1308,9 +1465,16 @@ static int perform_generic_test( const char *title,
 {
     int i, status = 0;
     unsigned delay[] = { 1, 200 };
+    pj_bool_t adaptive_t1;
 
     PJ_LOG(3,(THIS_FILE, "  %s", title));
 
+    /* The transport delay changes between variants, while T1 derived
+     * from the round-trip time would only catch up after some samples.
+     */
+    adaptive_t1 = pjsip_cfg()->tsx.adaptive_t1;
+    pjsip_cfg()->tsx.adaptive_t1 = PJ_FALSE;
+
     /* Do the test. */
     for (i=0; i<(int)PJ_ARRAY_SIZE(delay); ++i) {
 	
@@ -1324,13 +1488,14 @@ static int perform_generic_test( const char *title,
 	status = perform_tsx_test(-1200, TARGET_URI, FROM_URI,
 				  branch_id, 10, method);
 	if (status != 0)
-	    return status;
+	    break;
 
 	if (test_param->type != PJSIP_TRANSPORT_LOOP_DGRAM)
 	    break;
     }
 
     pjsip_loop_set_delay(loop, 0);
+    pjsip_cfg()->tsx.adaptive_t1 = adaptive_t1;
 
     /* Done. */
     return status;
@@ -1439,6 +1604,15 @@ int tsx_uac_test(struct tsx_test_param *param)
     if (status != 0)
 	return status;
 
+    /* TEST10_BRANCH_ID: Adaptive T1.
+     *			 Only applicable to non-reliable transports.
+     */
+    if ((tp_flag & PJSIP_TRANSPORT_RELIABLE) == 0) {
+	status = tsx_adaptive_t1_test();
+	if (status != 0)
+	    return status;
+    }
+
     pjsip_transport_dec_ref(loop);
     flush_events(500);
 
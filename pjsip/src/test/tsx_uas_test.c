@@ -1398,8 +1398,15 @@ static int tsx_retransmit_last_response_test(const char *title,
  */
 static int tsx_final_response_retransmission_test(void)
 {
+    pj_bool_t adaptive_t1;
     int status;
 
+    /* These tests check the RFC 3261 retransmission schedule, which is
+     * only used when T1 is not derived from the round-trip time.
+     */
+    adaptive_t1 = pjsip_cfg()->tsx.adaptive_t1;
+    pjsip_cfg()->tsx.adaptive_t1 = PJ_FALSE;
+
     PJ_LOG(3,(THIS_FILE,
 	      "  test7: INVITE non-2xx final response retransmission"));
 
@@ -1407,7 +1414,7 @@ static int tsx_final_response_retransmission_test(void)
 			  33, /* Test duration must be greater than 32 secs */
 			  &pjsip_invite_method, 1, 0, 0);
     if (status != 0)
-	return status;
+	goto on_return;
 
     PJ_LOG(3,(THIS_FILE,
 	      "  test8: INVITE 2xx final response retransmission"));
@@ -1415,10 +1422,10 @@ static int tsx_final_response_retransmission_test(void)
     status = perform_test(TARGET_URI, FROM_URI, TEST8_BRANCH_ID,
 			  33, /* Test duration must be greater than 32 secs */
 			  &pjsip_invite_method, 1, 0, 0);
-    if (status != 0)
-	return status;
 
-    return 0;
+on_return:
+    pjsip_cfg()->tsx.adaptive_t1 = adaptive_t1;
+    return status;
 }
 
 
@@ -1431,19 +1438,23 @@ static int tsx_final_response_retransmission_test(void)
  */
 static int tsx_ack_test(void)
 {
+    pj_bool_t adaptive_t1;
     int status;
 
     PJ_LOG(3,(THIS_FILE,
 	      "  test9: receiving ACK for non-2xx final response"));
 
+    /* Retransmissions are checked against the RFC 3261 schedule */
+    adaptive_t1 = pjsip_cfg()->tsx.adaptive_t1;
+    pjsip_cfg()->tsx.adaptive_t1 = PJ_FALSE;
+
     status = perform_test(TARGET_URI, FROM_URI, TEST9_BRANCH_ID,
 			  20, /* allow 5 retransmissions */
 			  &pjsip_invite_method, 1, 0, 0);
-    if (status != 0)
-	return status;
 
+    pjsip_cfg()->tsx.adaptive_t1 = adaptive_t1;
 
-    return 0;
+    return status;
 }
 
 
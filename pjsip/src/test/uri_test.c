@@ -19,6 +19,7 @@
  */
 #include "test.h"
 #include <pjsip.h>
+#include <pjsip/sip_private.h>
 #include <pjlib.h>
 
 #define THIS_FILE   "uri_test.c"
@@ -955,6 +956,117 @@ static int simple_uri_test(void)
     return 0;
 }
 
+/* Check if the string lies in the pool's memory. */
+static pj_bool_t str_in_pool(pj_pool_t *pool, const pj_str_t *str)
+{
+    pj_pool_block *b = pool->block_list.next;
+
+    while (b != &pool->block_list) {
+	if (str->ptr >= (char*)b->buf && str->ptr < (char*)b->end)
+	    return PJ_TRUE;
+	b = b->next;
+    }
+    return PJ_FALSE;
+}
+
+/*
+ * Common tokens are shared by clones instead of being copied.
+ */
+static int interned_test(void)
+{
+    static const char *tokens[] =
+    {
+	"q", "lr", "ACK", "TLS", "INFO", "sctp", "PRACK", "phone",
+	"INVITE", "reg-id", "OPTIONS", "expires", "REGISTER", "received",
+	"SUBSCRIBE", "transport", "norefersub", "+sip.instance"
+    };
+    static const char *others[] =
+    {
+	"Q", "lR", "ack", "Tls", "info", "prac", "invite2", "transpor",
+	"+sip.instancE", "+sip.instance2", "somethingelse", "x"
+    };
+    const char *uri_str = "sip:alice@example.com;transport=tcp;lr;foo=bar";
+    pj_pool_t *pool, *pool2;
+    pjsip_sip_uri *uri, *clone;
+    pjsip_param *p, *p2;
+    pj_str_t src, dst, dst2;
+    unsigned i;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  interned strings"));
+
+    pool = pjsip_endpt_create_pool(endpt, "", POOL_SIZE, POOL_SIZE);
+    pool2 = pjsip_endpt_create_pool(endpt, "", POOL_SIZE, POOL_SIZE);
+
+    for (i=0; i<PJ_ARRAY_SIZE(tokens); ++i) {
+	/* Use a copy so that the source is not the token itself */
+	pj_strdup2(pool, &src, tokens[i]);
+	pjsip_strdup_interned(pool, &dst, &src);
+	pjsip_strdup_interned(pool2, &dst2, &src);
+	if (pj_strcmp(&dst, &src) != 0 || dst.ptr != dst2.ptr ||
+	    str_in_pool(pool, &dst))
+	{
+	    PJ_LOG(3,(THIS_FILE, "   error: %s is not interned", tokens[i]));
+	    rc = -500;
+	    goto on_return;
+	}
+    }
+
+    for (i=0; i<PJ_ARRAY_SIZE(others); ++i) {
+	pj_strdup2(pool, &src, others[i]);
+	pjsip_strdup_interned(pool2, &dst, &src);
+	if (pj_strcmp(&dst, &src) != 0 || !str_in_pool(pool2, &dst)) {
+	    PJ_LOG(3,(THIS_FILE, "   error: %s is interned", others[i]));
+	    rc = -510;
+	    goto on_return;
+	}
+    }
+
+    /* Empty string */
+    src.ptr = NULL;
+    src.slen = 0;
+    pjsip_strdup_interned(pool, &dst, &src);
+    if (dst.slen != 0) {
+	rc = -520;
+	goto on_return;
+    }
+
+    /* URI clone shares the transport and parameter names, but not the
+     * other parameters.
+     */
+    uri = (pjsip_sip_uri*) pjsip_parse_uri(pool, (char*)uri_str,
+					   pj_ansi_strlen(uri_str), 0);
+    if (!uri) {
+	rc = -530;
+	goto on_return;
+    }
+    clone = (pjsip_sip_uri*) pjsip_uri_clone(pool2, uri);
+    if (pjsip_uri_cmp(PJSIP_URI_IN_REQ_URI, uri, clone) != 0 ||
+	str_in_pool(pool2, &clone->transport_param) ||
+	!str_in_pool(pool2, &clone->host))
+    {
+	PJ_LOG(3,(THIS_FILE, "   error: URI transport is not interned"));
+	rc = -540;
+	goto on_return;
+    }
+
+    p = uri->other_param.next;
+    p2 = clone->other_param.next;
+    if (p == &uri->other_param || p2 == &clone->other_param ||
+	pj_strcmp2(&p2->name, "foo") != 0 || !str_in_pool(pool2, &p2->name) ||
+	!str_in_pool(pool2, &p2->value) || pj_strcmp(&p->value, &p2->value))
+    {
+	PJ_LOG(3,(THIS_FILE, "   error: other parameter is interned"));
+	rc = -550;
+	goto on_return;
+    }
+
+on_return:
+    pjsip_endpt_release_pool(endpt, pool2);
+    pjsip_endpt_release_pool(endpt, pool);
+    return rc;
+}
+
 #if INCLUDE_BENCHMARKS
 static int uri_benchmark(unsigned *p_parse, unsigned *p_print, unsigned *p_cmp)
 {
@@ -1068,6 +1180,10 @@ int uri_test(void)
     if (status != PJ_SUCCESS)
 	return status;
 
+    status = interned_test();
+    if (status != PJ_SUCCESS)
+	return status;
+
 #if INCLUDE_BENCHMARKS
     for (i=0; i<COUNT; ++i) {
 	PJ_LOG(3,(THIS_FILE, "  benchmarking (%d of %d)...", i+1, COUNT));